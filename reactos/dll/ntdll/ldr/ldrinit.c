@@ -81,6 +81,7 @@ VOID NTAPI RtlpInitializeVectoredExceptionHandling(VOID);
 VOID NTAPI RtlpInitDeferedCriticalSection(VOID);
 VOID NTAPI RtlInitializeHeapManager(VOID);
 extern BOOLEAN RtlpPageHeapEnabled;
+extern BOOLEAN RtlpLowFragHeapEnabled;
 
 ULONG RtlpDisableHeapLookaside; // TODO: Move to heap.c
 ULONG RtlpShutdownProcessFlags; // TODO: Use it
@@ -1336,6 +1337,7 @@ LdrpInitializeExecutionOptions(PUNICODE_STRING ImagePathName, PPEB Peb, PHANDLE
     NTSTATUS Status;
     HANDLE KeyHandle;
     ULONG ExecuteOptions, MinimumStackCommit = 0, GlobalFlag;
+    ULONG FrontEndHeapDebugOptions = 0;
 
     /* Return error if we were not provided a pointer where to save the options key handle */
     if (!OptionsKey) return STATUS_INVALID_HANDLE;
@@ -1390,6 +1392,17 @@ LdrpInitializeExecutionOptions(PUNICODE_STRING ImagePathName, PPEB Peb, PHANDLE
                                    sizeof(RtlpDisableHeapLookaside),
                                    NULL);
 
+        LdrQueryImageFileKeyOption(KeyHandle,
+                                   L"FrontEndHeapDebugOptions",
+                                   REG_DWORD,
+                                   &FrontEndHeapDebugOptions,
+                                   sizeof(FrontEndHeapDebugOptions),
+                                   NULL);
+
+        /* Put the low fragmentation front end on every heap if requested */
+        if ((FrontEndHeapDebugOptions & 0x08) && !RtlpDisableHeapLookaside)
+            RtlpLowFragHeapEnabled = TRUE;
+
         LdrQueryImageFileKeyOption(KeyHandle,
                                    L"ShutdownFlags",
                                    REG_DWORD,
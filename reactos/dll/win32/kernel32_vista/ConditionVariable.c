@@ -0,0 +1,100 @@
+
+#include "k32_vista.h"
+
+#include <ndk/rtlfuncs.h>
+
+static
+PLARGE_INTEGER
+GetConditionVariableTimeOut(PLARGE_INTEGER TimeOut,
+                            DWORD Milliseconds)
+{
+    if (Milliseconds == INFINITE)
+        return NULL;
+
+    /* Relative, in 100ns units */
+    TimeOut->QuadPart = UInt32x32To64(Milliseconds, -10000);
+    return TimeOut;
+}
+
+static
+BOOL
+ConditionVariableSleepResult(NTSTATUS Status)
+{
+    if (Status == STATUS_SUCCESS)
+        return TRUE;
+
+    if (Status == STATUS_TIMEOUT)
+        SetLastError(ERROR_TIMEOUT);
+    else
+        SetLastError(RtlNtStatusToDosError(Status));
+
+    return FALSE;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+InitializeConditionVariable(PCONDITION_VARIABLE ConditionVariable)
+{
+    RtlInitializeConditionVariable(ConditionVariable);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WakeConditionVariable(PCONDITION_VARIABLE ConditionVariable)
+{
+    RtlWakeConditionVariable(ConditionVariable);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WakeAllConditionVariable(PCONDITION_VARIABLE ConditionVariable)
+{
+    RtlWakeAllConditionVariable(ConditionVariable);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+SleepConditionVariableCS(PCONDITION_VARIABLE ConditionVariable,
+                         PCRITICAL_SECTION CriticalSection,
+                         DWORD Timeout)
+{
+    LARGE_INTEGER Time;
+    NTSTATUS Status;
+
+    Status = RtlSleepConditionVariableCS(ConditionVariable,
+                                         (PRTL_CRITICAL_SECTION)CriticalSection,
+                                         GetConditionVariableTimeOut(&Time, Timeout));
+    return ConditionVariableSleepResult(Status);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+SleepConditionVariableSRW(PCONDITION_VARIABLE ConditionVariable,
+                          PSRWLOCK SRWLock,
+                          DWORD Timeout,
+                          ULONG Flags)
+{
+    LARGE_INTEGER Time;
+    NTSTATUS Status;
+
+    Status = RtlSleepConditionVariableSRW(ConditionVariable,
+                                          SRWLock,
+                                          GetConditionVariableTimeOut(&Time, Timeout),
+                                          Flags);
+    return ConditionVariableSleepResult(Status);
+}
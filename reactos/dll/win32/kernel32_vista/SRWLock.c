@@ -0,0 +1,54 @@
+
+#include "k32_vista.h"
+
+#include <ndk/rtlfuncs.h>
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+InitializeSRWLock(PSRWLOCK Lock)
+{
+    RtlInitializeSRWLock(Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+AcquireSRWLockExclusive(PSRWLOCK Lock)
+{
+    RtlAcquireSRWLockExclusive(Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+AcquireSRWLockShared(PSRWLOCK Lock)
+{
+    RtlAcquireSRWLockShared(Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseSRWLockExclusive(PSRWLOCK Lock)
+{
+    RtlReleaseSRWLockExclusive(Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseSRWLockShared(PSRWLOCK Lock)
+{
+    RtlReleaseSRWLockShared(Lock);
+}
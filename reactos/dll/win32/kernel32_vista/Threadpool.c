@@ -0,0 +1,502 @@
+
+#include "k32_vista.h"
+
+#include <ndk/rtlfuncs.h>
+
+typedef struct _K32_THREADPOOL_IO
+{
+    PTP_WIN32_IO_CALLBACK Callback;
+    PVOID Context;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CancelCallback;
+} K32_THREADPOOL_IO, *PK32_THREADPOOL_IO;
+
+static
+PVOID
+ThreadpoolObjectOrError(NTSTATUS Status,
+                        PVOID Object)
+{
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Object;
+}
+
+static
+VOID
+NTAPI
+ThreadpoolIoCallback(PTP_CALLBACK_INSTANCE Instance,
+                     PVOID Context,
+                     PVOID ApcContext,
+                     PIO_STATUS_BLOCK IoStatusBlock,
+                     PTP_IO Io)
+{
+    PK32_THREADPOOL_IO IoContext = Context;
+
+    /* Win32 callbacks get the OVERLAPPED and a DOS error code */
+    IoContext->Callback(Instance,
+                        IoContext->Context,
+                        ApcContext,
+                        RtlNtStatusToDosError(IoStatusBlock->Status),
+                        IoStatusBlock->Information,
+                        Io);
+}
+
+static
+VOID
+NTAPI
+ThreadpoolIoFinalization(PTP_CALLBACK_INSTANCE Instance,
+                         PVOID Context)
+{
+    PK32_THREADPOOL_IO IoContext = Context;
+
+    if (IoContext->FinalizationCallback)
+        IoContext->FinalizationCallback(Instance, IoContext->Context);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, IoContext);
+}
+
+static
+VOID
+NTAPI
+ThreadpoolIoCancel(PVOID ObjectContext,
+                   PVOID CleanupContext)
+{
+    PK32_THREADPOOL_IO IoContext = ObjectContext;
+
+    if (IoContext->CancelCallback)
+        IoContext->CancelCallback(IoContext->Context, CleanupContext);
+}
+
+/*
+ * @implemented
+ */
+PTP_POOL
+WINAPI
+CreateThreadpool(PVOID reserved)
+{
+    PTP_POOL Pool = NULL;
+
+    return ThreadpoolObjectOrError(TpAllocPool(&Pool, reserved), Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpool(PTP_POOL ptpp)
+{
+    TpReleasePool(ptpp);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolThreadMaximum(PTP_POOL ptpp,
+                           DWORD cthrdMost)
+{
+    TpSetPoolMaxThreads(ptpp, cthrdMost);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+SetThreadpoolThreadMinimum(PTP_POOL ptpp,
+                           DWORD cthrdMic)
+{
+    NTSTATUS Status;
+
+    Status = TpSetPoolMinThreads(ptpp, cthrdMic);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * @implemented
+ */
+PTP_CLEANUP_GROUP
+WINAPI
+CreateThreadpoolCleanupGroup(VOID)
+{
+    PTP_CLEANUP_GROUP CleanupGroup = NULL;
+
+    return ThreadpoolObjectOrError(TpAllocCleanupGroup(&CleanupGroup), CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolCleanupGroup(PTP_CLEANUP_GROUP ptpcg)
+{
+    TpReleaseCleanupGroup(ptpcg);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolCleanupGroupMembers(PTP_CLEANUP_GROUP ptpcg,
+                                   BOOL fCancelPendingCallbacks,
+                                   PVOID pvCleanupContext)
+{
+    TpReleaseCleanupGroupMembers(ptpcg, fCancelPendingCallbacks != FALSE, pvCleanupContext);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfns,
+                            PVOID pv,
+                            PTP_CALLBACK_ENVIRON pcbe)
+{
+    NTSTATUS Status;
+
+    Status = TpSimpleTryPost(pfns, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * @implemented
+ */
+PTP_WORK
+WINAPI
+CreateThreadpoolWork(PTP_WORK_CALLBACK pfnwk,
+                     PVOID pv,
+                     PTP_CALLBACK_ENVIRON pcbe)
+{
+    PTP_WORK Work = NULL;
+
+    return ThreadpoolObjectOrError(TpAllocWork(&Work, pfnwk, pv, pcbe), Work);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SubmitThreadpoolWork(PTP_WORK pwk)
+{
+    TpPostWork(pwk);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolWorkCallbacks(PTP_WORK pwk,
+                               BOOL fCancelPendingCallbacks)
+{
+    TpWaitForWork(pwk, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolWork(PTP_WORK pwk)
+{
+    TpReleaseWork(pwk);
+}
+
+/*
+ * @implemented
+ */
+PTP_TIMER
+WINAPI
+CreateThreadpoolTimer(PTP_TIMER_CALLBACK pfnti,
+                      PVOID pv,
+                      PTP_CALLBACK_ENVIRON pcbe)
+{
+    PTP_TIMER Timer = NULL;
+
+    return ThreadpoolObjectOrError(TpAllocTimer(&Timer, pfnti, pv, pcbe), Timer);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolTimer(PTP_TIMER pti,
+                   PFILETIME pftDueTime,
+                   DWORD msPeriod,
+                   DWORD msWindowLength)
+{
+    /* A FILETIME has the layout of a LARGE_INTEGER, negative is relative */
+    TpSetTimer(pti, (PLARGE_INTEGER)pftDueTime, msPeriod, msWindowLength);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+IsThreadpoolTimerSet(PTP_TIMER pti)
+{
+    return TpIsTimerSet(pti);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolTimerCallbacks(PTP_TIMER pti,
+                                BOOL fCancelPendingCallbacks)
+{
+    TpWaitForTimer(pti, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolTimer(PTP_TIMER pti)
+{
+    TpReleaseTimer(pti);
+}
+
+/*
+ * @implemented
+ */
+PTP_WAIT
+WINAPI
+CreateThreadpoolWait(PTP_WAIT_CALLBACK pfnwa,
+                     PVOID pv,
+                     PTP_CALLBACK_ENVIRON pcbe)
+{
+    PTP_WAIT Wait = NULL;
+
+    return ThreadpoolObjectOrError(TpAllocWait(&Wait, pfnwa, pv, pcbe), Wait);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolWait(PTP_WAIT pwa,
+                  HANDLE h,
+                  PFILETIME pftTimeout)
+{
+    TpSetWait(pwa, h, (PLARGE_INTEGER)pftTimeout);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolWaitCallbacks(PTP_WAIT pwa,
+                               BOOL fCancelPendingCallbacks)
+{
+    TpWaitForWait(pwa, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolWait(PTP_WAIT pwa)
+{
+    TpReleaseWait(pwa);
+}
+
+/*
+ * @implemented
+ */
+PTP_IO
+WINAPI
+CreateThreadpoolIo(HANDLE fl,
+                   PTP_WIN32_IO_CALLBACK pfnio,
+                   PVOID pv,
+                   PTP_CALLBACK_ENVIRON pcbe)
+{
+    PK32_THREADPOOL_IO IoContext;
+    TP_CALLBACK_ENVIRON CallbackEnviron;
+    PTP_IO Io;
+    NTSTATUS Status;
+
+    IoContext = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*IoContext));
+    if (!IoContext)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    IoContext->Callback = pfnio;
+    IoContext->Context = pv;
+    IoContext->FinalizationCallback = NULL;
+    IoContext->CancelCallback = NULL;
+
+    /* The user callbacks see their own context, and ours goes with the object */
+    if (pcbe)
+    {
+        CallbackEnviron = *pcbe;
+        IoContext->FinalizationCallback = pcbe->FinalizationCallback;
+        IoContext->CancelCallback = pcbe->CleanupGroupCancelCallback;
+        if (CallbackEnviron.CleanupGroupCancelCallback)
+            CallbackEnviron.CleanupGroupCancelCallback = ThreadpoolIoCancel;
+    }
+    else
+    {
+        TpInitializeCallbackEnviron(&CallbackEnviron);
+    }
+    CallbackEnviron.FinalizationCallback = ThreadpoolIoFinalization;
+
+    Status = TpAllocIoCompletion(&Io, fl, ThreadpoolIoCallback, IoContext, &CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, IoContext);
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Io;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+StartThreadpoolIo(PTP_IO pio)
+{
+    TpStartAsyncIoOperation(pio);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CancelThreadpoolIo(PTP_IO pio)
+{
+    TpCancelAsyncIoOperation(pio);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolIoCallbacks(PTP_IO pio,
+                             BOOL fCancelPendingCallbacks)
+{
+    TpWaitForIoCompletion(pio, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolIo(PTP_IO pio)
+{
+    TpReleaseIoCompletion(pio);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+CallbackMayRunLong(PTP_CALLBACK_INSTANCE pci)
+{
+    /* No extra thread could be spared, this is not an error */
+    return NT_SUCCESS(TpCallbackMayRunLong(pci));
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+DisassociateCurrentThreadFromCallback(PTP_CALLBACK_INSTANCE pci)
+{
+    TpDisassociateCallback(pci);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetEventWhenCallbackReturns(PTP_CALLBACK_INSTANCE pci,
+                            HANDLE evt)
+{
+    TpCallbackSetEventOnCompletion(pci, evt);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseSemaphoreWhenCallbackReturns(PTP_CALLBACK_INSTANCE pci,
+                                    HANDLE sem,
+                                    DWORD crel)
+{
+    TpCallbackReleaseSemaphoreOnCompletion(pci, sem, crel);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseMutexWhenCallbackReturns(PTP_CALLBACK_INSTANCE pci,
+                                HANDLE mut)
+{
+    TpCallbackReleaseMutexOnCompletion(pci, mut);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+LeaveCriticalSectionWhenCallbackReturns(PTP_CALLBACK_INSTANCE pci,
+                                        PCRITICAL_SECTION pcs)
+{
+    TpCallbackLeaveCriticalSectionOnCompletion(pci, (PRTL_CRITICAL_SECTION)pcs);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+FreeLibraryWhenCallbackReturns(PTP_CALLBACK_INSTANCE pci,
+                               HMODULE mod)
+{
+    TpCallbackUnloadDllOnCompletion(pci, mod);
+}
@@ -2,3 +2,46 @@
 @ stdcall InitOnceExecuteOnce(ptr ptr ptr ptr)
 @ stdcall GetFileInformationByHandleEx(long long ptr long)
 @ stdcall -ret64 GetTickCount64()
+@ stdcall InitializeConditionVariable(ptr)
+@ stdcall SleepConditionVariableCS(ptr ptr long)
+@ stdcall SleepConditionVariableSRW(ptr ptr long long)
+@ stdcall WakeAllConditionVariable(ptr)
+@ stdcall WakeConditionVariable(ptr)
+@ stdcall InitializeSRWLock(ptr)
+@ stdcall AcquireSRWLockExclusive(ptr)
+@ stdcall AcquireSRWLockShared(ptr)
+@ stdcall ReleaseSRWLockExclusive(ptr)
+@ stdcall ReleaseSRWLockShared(ptr)
+@ stdcall CreateThreadpool(ptr)
+@ stdcall CloseThreadpool(ptr)
+@ stdcall SetThreadpoolThreadMaximum(ptr long)
+@ stdcall SetThreadpoolThreadMinimum(ptr long)
+@ stdcall CreateThreadpoolCleanupGroup()
+@ stdcall CloseThreadpoolCleanupGroup(ptr)
+@ stdcall CloseThreadpoolCleanupGroupMembers(ptr long ptr)
+@ stdcall TrySubmitThreadpoolCallback(ptr ptr ptr)
+@ stdcall CreateThreadpoolWork(ptr ptr ptr)
+@ stdcall SubmitThreadpoolWork(ptr)
+@ stdcall WaitForThreadpoolWorkCallbacks(ptr long)
+@ stdcall CloseThreadpoolWork(ptr)
+@ stdcall CreateThreadpoolTimer(ptr ptr ptr)
+@ stdcall SetThreadpoolTimer(ptr ptr long long)
+@ stdcall IsThreadpoolTimerSet(ptr)
+@ stdcall WaitForThreadpoolTimerCallbacks(ptr long)
+@ stdcall CloseThreadpoolTimer(ptr)
+@ stdcall CreateThreadpoolWait(ptr ptr ptr)
+@ stdcall SetThreadpoolWait(ptr long ptr)
+@ stdcall WaitForThreadpoolWaitCallbacks(ptr long)
+@ stdcall CloseThreadpoolWait(ptr)
+@ stdcall CreateThreadpoolIo(long ptr ptr ptr)
+@ stdcall StartThreadpoolIo(ptr)
+@ stdcall CancelThreadpoolIo(ptr)
+@ stdcall WaitForThreadpoolIoCallbacks(ptr long)
+@ stdcall CloseThreadpoolIo(ptr)
+@ stdcall CallbackMayRunLong(ptr)
+@ stdcall DisassociateCurrentThreadFromCallback(ptr)
+@ stdcall SetEventWhenCallbackReturns(ptr long)
+@ stdcall ReleaseSemaphoreWhenCallbackReturns(ptr long long)
+@ stdcall ReleaseMutexWhenCallbackReturns(ptr long)
+@ stdcall LeaveCriticalSectionWhenCallbackReturns(ptr ptr)
+@ stdcall FreeLibraryWhenCallbackReturns(ptr long)
@@ -884,6 +884,7 @@ FATDelEntry(
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        TruncateClusterRuns(pFcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
@@ -951,6 +952,7 @@ FATXDelEntry(
     /* In case of moving, don't delete data */
     if (MoveContext == NULL)
     {
+        TruncateClusterRuns(pFcb, 0);
         while (CurrentCluster && CurrentCluster != 0xffffffff)
         {
             GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
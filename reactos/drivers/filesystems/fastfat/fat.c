@@ -413,7 +413,11 @@ FAT12CountAvailableClusters(
         }
 
         if (Entry == 0)
+        {
             ulCount++;
+            if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+        }
     }
 
     CcUnpinData(Context);
@@ -464,7 +468,11 @@ FAT16CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if (*Block == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -520,7 +528,11 @@ FAT32CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if ((*Block & 0x0fffffff) == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -557,6 +569,231 @@ CountAvailableClusters(
 }
 
 
+/*
+ * FUNCTION: Builds the in-memory bitmap of the clusters in use, along
+ *           with the free cluster count, so that clusters can be allocated
+ *           without scanning the FAT
+ */
+NTSTATUS
+BuildFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    ULONG BitmapSize;
+    PULONG BitmapBuffer;
+    LARGE_INTEGER Clusters;
+    NTSTATUS Status;
+
+    BitmapSize = DeviceExt->FatInfo.NumberOfClusters + 2;
+    BitmapBuffer = ExAllocatePoolWithTag(PagedPool,
+                                         ROUND_UP(BitmapSize, 32) / 8,
+                                         TAG_BITMAP);
+    if (BitmapBuffer == NULL)
+    {
+        /* Not fatal, we'll scan the FAT instead */
+        DPRINT1("No memory for the free cluster bitmap of %lu clusters\n", BitmapSize);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    /* Clusters 0 and 1 don't exist, the others are cleared while counting */
+    RtlInitializeBitMap(&DeviceExt->FreeClusterBitmap, BitmapBuffer, BitmapSize);
+    RtlSetAllBits(&DeviceExt->FreeClusterBitmap);
+
+    DeviceExt->AvailableClustersValid = FALSE;
+    Status = CountAvailableClusters(DeviceExt, &Clusters);
+    if (!NT_SUCCESS(Status))
+    {
+        ReleaseFreeClusterBitmap(DeviceExt);
+        return Status;
+    }
+
+    DPRINT("%lu free clusters out of %lu\n", Clusters.u.LowPart, DeviceExt->FatInfo.NumberOfClusters);
+    return STATUS_SUCCESS;
+}
+
+VOID
+ReleaseFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+    {
+        ExFreePoolWithTag(DeviceExt->FreeClusterBitmap.Buffer, TAG_BITMAP);
+        RtlZeroMemory(&DeviceExt->FreeClusterBitmap, sizeof(RTL_BITMAP));
+    }
+}
+
+/*
+ * FUNCTION: Allocates a run of free clusters and chains them, the last one
+ *           being marked as the end of the file
+ */
+static
+NTSTATUS
+AllocateClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG RunStart,
+    ULONG RunLength)
+{
+    ULONG Cluster, OldValue;
+    NTSTATUS Status;
+
+    for (Cluster = RunStart; Cluster < RunStart + RunLength; Cluster++)
+    {
+        Status = DeviceExt->WriteCluster(DeviceExt,
+                                         Cluster,
+                                         Cluster + 1 < RunStart + RunLength ? Cluster + 1 : 0xffffffff,
+                                         &OldValue);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Give back what couldn't be chained */
+            while (Cluster-- > RunStart)
+            {
+                DeviceExt->WriteCluster(DeviceExt, Cluster, 0, &OldValue);
+            }
+            return Status;
+        }
+        ASSERT(OldValue == 0);
+    }
+
+    RtlSetBits(&DeviceExt->FreeClusterBitmap, RunStart, RunLength);
+    DeviceExt->AvailableClusters -= RunLength;
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * FUNCTION: Gives back the clusters of a chain that was just allocated
+ */
+static
+VOID
+FreeClusterChain(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG Cluster)
+{
+    ULONG NextCluster;
+    NTSTATUS Status;
+
+    while (Cluster > 1 && Cluster != 0xffffffff)
+    {
+        Status = DeviceExt->GetNextCluster(DeviceExt, Cluster, &NextCluster);
+        WriteCluster(DeviceExt, Cluster, 0);
+        if (!NT_SUCCESS(Status))
+            break;
+        Cluster = NextCluster;
+    }
+}
+
+/*
+ * FUNCTION: Appends ClusterCount new clusters to the chain ending with
+ *           LastCluster, or starts a new chain if LastCluster is 0.
+ *           Contiguous runs of clusters are preferred.
+ */
+NTSTATUS
+ExtendClusterChain(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG LastCluster,
+    ULONG ClusterCount,
+    PULONG FirstNewCluster,
+    PULONG LastNewCluster)
+{
+    ULONG RunStart, RunLength;
+    ULONG Cluster, OriginalLastCluster = LastCluster;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    ASSERT(ClusterCount != 0);
+
+    ExAcquireResourceExclusiveLite(&DeviceExt->FatResource, TRUE);
+
+    *FirstNewCluster = 0;
+
+    if (DeviceExt->FreeClusterBitmap.Buffer == NULL)
+    {
+        /* No bitmap, scan the FAT for every cluster */
+        while (ClusterCount-- > 0)
+        {
+            Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &Cluster);
+            if (!NT_SUCCESS(Status))
+                break;
+
+            if (LastCluster != 0)
+            {
+                Status = WriteCluster(DeviceExt, LastCluster, Cluster);
+                if (!NT_SUCCESS(Status))
+                {
+                    WriteCluster(DeviceExt, Cluster, 0);
+                    break;
+                }
+            }
+            if (*FirstNewCluster == 0)
+                *FirstNewCluster = Cluster;
+            LastCluster = Cluster;
+        }
+
+        goto Done;
+    }
+
+    /* Don't allocate anything if it can't be allocated entirely */
+    if (DeviceExt->AvailableClusters < ClusterCount)
+    {
+        ExReleaseResourceLite(&DeviceExt->FatResource);
+        return STATUS_DISK_FULL;
+    }
+
+    while (ClusterCount > 0)
+    {
+        RunLength = ClusterCount;
+        RunStart = RtlFindClearBits(&DeviceExt->FreeClusterBitmap,
+                                    RunLength,
+                                    DeviceExt->LastAvailableCluster);
+        if (RunStart == MAXULONG)
+        {
+            /* Too fragmented, make do with the longest run there is */
+            RunLength = RtlFindLongestRunClear(&DeviceExt->FreeClusterBitmap, &RunStart);
+            if (RunLength == 0)
+            {
+                Status = STATUS_DISK_FULL;
+                break;
+            }
+            RunLength = min(RunLength, ClusterCount);
+        }
+
+        DPRINT("Allocating %lu clusters at 0x%x\n", RunLength, RunStart);
+
+        Status = AllocateClusterRun(DeviceExt, RunStart, RunLength);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        if (LastCluster != 0)
+        {
+            Status = WriteCluster(DeviceExt, LastCluster, RunStart);
+            if (!NT_SUCCESS(Status))
+            {
+                FreeClusterChain(DeviceExt, RunStart);
+                break;
+            }
+        }
+        if (*FirstNewCluster == 0)
+            *FirstNewCluster = RunStart;
+        LastCluster = RunStart + RunLength - 1;
+
+        DeviceExt->LastAvailableCluster = LastCluster + 1;
+        ClusterCount -= RunLength;
+    }
+
+Done:
+    if (!NT_SUCCESS(Status) && *FirstNewCluster != 0)
+    {
+        /* Don't leave a partial chain behind, end the file where it was */
+        if (OriginalLastCluster != 0)
+            WriteCluster(DeviceExt, OriginalLastCluster, 0xffffffff);
+        FreeClusterChain(DeviceExt, *FirstNewCluster);
+        *FirstNewCluster = 0;
+        LastCluster = OriginalLastCluster;
+    }
+
+    *LastNewCluster = LastCluster;
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+    return Status;
+}
+
 /*
  * FUNCTION: Writes a cluster to the FAT12 physical and in-memory tables
  */
@@ -713,6 +950,13 @@ WriteCluster(
         else if (OldValue == 0 && NewValue)
             InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
     }
+    if (NT_SUCCESS(Status) && DeviceExt->FreeClusterBitmap.Buffer != NULL && ClusterToWrite >= 2)
+    {
+        if (NewValue == 0)
+            RtlClearBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+        else
+            RtlSetBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+    }
     ExReleaseResourceLite(&DeviceExt->FatResource);
     return Status;
 }
@@ -782,16 +1026,9 @@ GetNextClusterExtend(
      */
     if (CurrentCluster == 0)
     {
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
-        if (!NT_SUCCESS(Status))
-        {
-            ExReleaseResourceLite(&DeviceExt->FatResource);
-            return Status;
-        }
-
-        *NextCluster = NewCluster;
+        Status = ExtendClusterChain(DeviceExt, 0, 1, NextCluster, &NewCluster);
         ExReleaseResourceLite(&DeviceExt->FatResource);
-        return STATUS_SUCCESS;
+        return Status;
     }
 
     Status = DeviceExt->GetNextCluster(DeviceExt, CurrentCluster, NextCluster);
@@ -799,19 +1036,7 @@ GetNextClusterExtend(
     if ((*NextCluster) == 0xFFFFFFFF)
     {
         /* We are after last existing cluster, we must add one to file */
-        /* Firstly, find the next available open allocation unit and
-           mark it as end of file */
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
-        if (!NT_SUCCESS(Status))
-        {
-            ExReleaseResourceLite(&DeviceExt->FatResource);
-            return Status;
-        }
-
-        /* Now, write the AU of the LastCluster with the value of the newly
-           found AU */
-        WriteCluster(DeviceExt, CurrentCluster, NewCluster);
-        *NextCluster = NewCluster;
+        Status = ExtendClusterChain(DeviceExt, CurrentCluster, 1, NextCluster, &NewCluster);
     }
 
     ExReleaseResourceLite(&DeviceExt->FatResource);
@@ -716,6 +716,9 @@ VfatMount(
     DeviceExt->LastAvailableCluster = 2;
     ExInitializeResourceLite(&DeviceExt->FatResource);
 
+    /* Without it, free clusters are looked for in the FAT itself */
+    BuildFreeClusterBitmap(DeviceExt);
+
     InitializeListHead(&DeviceExt->FcbListHead);
 
     VolumeFcb = vfatNewFCB(DeviceExt, &VolumeNameU);
@@ -772,6 +775,8 @@ ByeBye:
     if (!NT_SUCCESS(Status))
     {
         /* Cleanup */
+        if (DeviceExt)
+            ReleaseFreeClusterBitmap(DeviceExt);
         if (DeviceExt && DeviceExt->FATFileObject)
             ObDereferenceObject (DeviceExt->FATFileObject);
         if (DeviceExt && DeviceExt->SpareVPB)
@@ -909,7 +914,8 @@ VfatGetRetrievalPointers(
     PDEVICE_EXTENSION DeviceExt;
     ULONG FirstCluster;
     ULONG CurrentCluster;
-    ULONG LastCluster;
+    ULONG RunLength;
+    ULONGLONG ClusterCount;
     NTSTATUS Status;
 
     DPRINT("VfatGetRetrievalPointers(IrpContext %p)\n", IrpContext);
@@ -944,40 +950,39 @@ VfatGetRetrievalPointers(
         goto ByeBye;
     }
 
-    CurrentCluster = FirstCluster = vfatDirEntryGetFirstCluster(DeviceExt, &Fcb->entry);
-    Status = OffsetToCluster(DeviceExt, FirstCluster,
-                             Vcn.u.LowPart * DeviceExt->FatInfo.BytesPerCluster,
-                             &CurrentCluster, FALSE);
-    if (!NT_SUCCESS(Status))
+    FirstCluster = vfatDirEntryGetFirstCluster(DeviceExt, &Fcb->entry);
+    if (FirstCluster == 1)
     {
+        /* The root of FAT12/16 has no clusters */
+        Status = STATUS_INVALID_PARAMETER;
         goto ByeBye;
     }
 
+    ClusterCount = Fcb->RFCB.AllocationSize.QuadPart / DeviceExt->FatInfo.BytesPerCluster;
+
     RetrievalPointers->StartingVcn = Vcn;
     RetrievalPointers->ExtentCount = 0;
-    RetrievalPointers->Extents[0].Lcn.u.HighPart = 0;
-    RetrievalPointers->Extents[0].Lcn.u.LowPart = CurrentCluster - 2;
-    LastCluster = 0;
-    while (CurrentCluster != 0xffffffff && RetrievalPointers->ExtentCount < MaxExtentCount)
+    while (Vcn.QuadPart < ClusterCount && RetrievalPointers->ExtentCount < MaxExtentCount)
     {
-        LastCluster = CurrentCluster;
-        Status = NextCluster(DeviceExt, CurrentCluster, &CurrentCluster, FALSE);
-        Vcn.QuadPart++;
+        /* One extent per run of contiguous clusters */
+        Status = OffsetToClusterRun(DeviceExt, Fcb, FirstCluster,
+                                    Vcn.u.LowPart * DeviceExt->FatInfo.BytesPerCluster,
+                                    &CurrentCluster, &RunLength);
         if (!NT_SUCCESS(Status))
         {
             goto ByeBye;
         }
 
-        if (LastCluster + 1 != CurrentCluster)
+        if (CurrentCluster == 0xffffffff)
         {
-            RetrievalPointers->Extents[RetrievalPointers->ExtentCount].NextVcn = Vcn;
-            RetrievalPointers->ExtentCount++;
-            if (RetrievalPointers->ExtentCount < MaxExtentCount)
-            {
-                RetrievalPointers->Extents[RetrievalPointers->ExtentCount].Lcn.u.HighPart = 0;
-                RetrievalPointers->Extents[RetrievalPointers->ExtentCount].Lcn.u.LowPart = CurrentCluster - 2;
-            }
+            break;
         }
+
+        Vcn.QuadPart += RunLength;
+        RetrievalPointers->Extents[RetrievalPointers->ExtentCount].NextVcn = Vcn;
+        RetrievalPointers->Extents[RetrievalPointers->ExtentCount].Lcn.u.HighPart = 0;
+        RetrievalPointers->Extents[RetrievalPointers->ExtentCount].Lcn.u.LowPart = CurrentCluster - 2;
+        RetrievalPointers->ExtentCount++;
     }
 
     IrpContext->Irp->IoStatus.Information = sizeof(RETRIEVAL_POINTERS_BUFFER) + (sizeof(RetrievalPointers->Extents[0]) * (RetrievalPointers->ExtentCount - 1));
@@ -1181,6 +1186,7 @@ VfatDismountVolume(
     /* Release a few resources and quit, we're done */
     ExDeleteResourceLite(&DeviceExt->DirResource);
     ExDeleteResourceLite(&DeviceExt->FatResource);
+    ReleaseFreeClusterBitmap(DeviceExt);
     ObDereferenceObject(DeviceExt->FATFileObject);
 
     return STATUS_SUCCESS;
@@ -15,8 +15,8 @@
 #include <debug.h>
 
 /*
- * Uncomment to enable strict verification of cluster/offset pair
- * caching. If this option is enabled you lose all the benefits of
+ * Uncomment to enable strict verification of the cluster runs cached
+ * in the FCB. If this option is enabled you lose all the benefits of
  * the caching and the read/write operations will actually be
  * slower. It's meant only for debugging!!!
  * - Filip Navara, 26/07/2004
@@ -59,6 +59,8 @@ OffsetToCluster(
     BOOLEAN Extend)
 {
     ULONG CurrentCluster;
+    ULONG NextCluster;
+    ULONG ClusterCount;
     ULONG i;
     NTSTATUS Status;
 /*
@@ -84,11 +86,22 @@ OffsetToCluster(
         CurrentCluster = FirstCluster;
         if (Extend)
         {
-            for (i = 0; i < FileOffset / DeviceExt->FatInfo.BytesPerCluster; i++)
+            ClusterCount = FileOffset / DeviceExt->FatInfo.BytesPerCluster;
+            for (i = 0; i < ClusterCount; i++)
             {
-                Status = GetNextClusterExtend (DeviceExt, CurrentCluster, &CurrentCluster);
+                Status = GetNextCluster (DeviceExt, CurrentCluster, &NextCluster);
                 if (!NT_SUCCESS(Status))
                     return Status;
+                if (NextCluster == 0xffffffff)
+                {
+                    /* End of the chain, allocate all the missing clusters at once */
+                    Status = ExtendClusterChain (DeviceExt, CurrentCluster, ClusterCount - i,
+                                                 &NextCluster, &CurrentCluster);
+                    if (!NT_SUCCESS(Status))
+                        return Status;
+                    break;
+                }
+                CurrentCluster = NextCluster;
             }
             *Cluster = CurrentCluster;
         }
@@ -106,6 +119,137 @@ OffsetToCluster(
    }
 }
 
+/*
+ * FUNCTION: Maps a file offset to the cluster holding it, and returns how
+ * many clusters follow it contiguously on the disk. The runs come from the
+ * FCB when known, otherwise the FAT chain is walked from the end of the
+ * last known run and the runs found on the way are added to the FCB.
+ * Cluster is 0xffffffff when the offset is past the end of the chain.
+ */
+NTSTATUS
+OffsetToClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG FileOffset,
+    PULONG Cluster,
+    PULONG ClusterCount)
+{
+    LONGLONG Lcn, RunLength;
+    ULONG Vcn, MappedClusters;
+    ULONG CurrentVcn, CurrentCluster, NextCluster;
+    ULONG RunVcn, RunCluster;
+    NTSTATUS Status;
+
+    /* The root of FAT12/16 isn't a cluster chain */
+    ASSERT(FirstCluster != 1);
+
+    Vcn = FileOffset / DeviceExt->FatInfo.BytesPerCluster;
+
+    ExAcquireFastMutex(&Fcb->McbLock);
+    MappedClusters = Fcb->MappedClusters;
+
+    if (Vcn < MappedClusters)
+    {
+        if (FsRtlLookupLargeMcbEntry(&Fcb->Mcb, Vcn, &Lcn, &RunLength, NULL, NULL, NULL) &&
+            Lcn != -1)
+        {
+            ExReleaseFastMutex(&Fcb->McbLock);
+            *Cluster = (ULONG)Lcn;
+            *ClusterCount = (ULONG)RunLength;
+#ifdef DEBUG_VERIFY_OFFSET_CACHING
+            /* DEBUG VERIFICATION */
+            {
+                ULONG CorrectCluster;
+                OffsetToCluster(DeviceExt, FirstCluster, FileOffset,
+                                &CorrectCluster, FALSE);
+                if (CorrectCluster != *Cluster)
+                    KeBugCheck(FAT_FILE_SYSTEM);
+            }
+#endif
+            return STATUS_SUCCESS;
+        }
+
+        /* The runs got truncated meanwhile, start over */
+        MappedClusters = 0;
+    }
+
+    /* Resume the walk right after the last known run */
+    Lcn = -1;
+    if (MappedClusters > 0 &&
+        !(FsRtlLookupLargeMcbEntry(&Fcb->Mcb, MappedClusters - 1, &Lcn, NULL, NULL, NULL, NULL) &&
+          Lcn != -1))
+    {
+        MappedClusters = 0;
+    }
+
+    /* Don't hold the lock while reading the FAT */
+    ExReleaseFastMutex(&Fcb->McbLock);
+
+    CurrentCluster = FirstCluster;
+    if (MappedClusters > 0)
+    {
+        Status = GetNextCluster(DeviceExt, (ULONG)Lcn, &CurrentCluster);
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    CurrentVcn = RunVcn = MappedClusters;
+    RunCluster = CurrentCluster;
+    while (CurrentCluster >= 2 && CurrentCluster != 0xffffffff)
+    {
+        Status = GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
+        if (!NT_SUCCESS(Status))
+            return Status;
+        CurrentVcn++;
+
+        if (NextCluster != CurrentCluster + 1)
+        {
+            /* End of a run, remember it. Another reader may have walked
+               the same runs meanwhile, the MCB takes them twice just fine */
+            ExAcquireFastMutex(&Fcb->McbLock);
+            if (RunVcn <= Fcb->MappedClusters &&
+                FsRtlAddLargeMcbEntry(&Fcb->Mcb, RunVcn, RunCluster, CurrentVcn - RunVcn) &&
+                CurrentVcn > Fcb->MappedClusters)
+            {
+                Fcb->MappedClusters = CurrentVcn;
+            }
+            ExReleaseFastMutex(&Fcb->McbLock);
+
+            if (Vcn < CurrentVcn)
+            {
+                *Cluster = RunCluster + (Vcn - RunVcn);
+                *ClusterCount = CurrentVcn - Vcn;
+                return STATUS_SUCCESS;
+            }
+
+            RunVcn = CurrentVcn;
+            RunCluster = NextCluster;
+        }
+        CurrentCluster = NextCluster;
+    }
+
+    *Cluster = 0xffffffff;
+    *ClusterCount = 0;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * FUNCTION: Forgets the cluster runs of the FCB past ClusterCount clusters,
+ * to be called before they get freed.
+ */
+VOID
+TruncateClusterRuns(
+    PVFATFCB Fcb,
+    ULONG ClusterCount)
+{
+    ExAcquireFastMutex(&Fcb->McbLock);
+    if (Fcb->MappedClusters > ClusterCount)
+        Fcb->MappedClusters = ClusterCount;
+    FsRtlTruncateLargeMcb(&Fcb->Mcb, ClusterCount);
+    ExReleaseFastMutex(&Fcb->McbLock);
+}
+
 /*
  * FUNCTION: Reads data from a file
  */
@@ -117,20 +261,16 @@ VfatReadFileData(
     LARGE_INTEGER ReadOffset,
     PULONG LengthRead)
 {
-    ULONG CurrentCluster;
     ULONG FirstCluster;
     ULONG StartCluster;
     ULONG ClusterCount;
     LARGE_INTEGER StartOffset;
     PDEVICE_EXTENSION DeviceExt;
-    BOOLEAN First = TRUE;
     PVFATFCB Fcb;
     NTSTATUS Status;
     ULONG BytesDone;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -187,8 +327,7 @@ VfatReadFileData(
     }
 
     /* Find the first cluster */
-    FirstCluster =
-    CurrentCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
+    FirstCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
 
     if (FirstCluster == 1)
     {
@@ -208,87 +347,26 @@ VfatReadFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
-    /* Find the cluster to start the read from */
-    if (LastCluster > 0 && ReadOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
-    if (!NT_SUCCESS(Status))
-    {
-        return Status;
-    }
-
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (ReadOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     KeInitializeEvent(&IrpContext->Event, NotificationEvent, FALSE);
     IrpContext->RefCount = 1;
 
-    while (Length > 0 && CurrentCluster != 0xffffffff)
+    while (Length > 0)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        /* Find the run of clusters the data starts in */
+        Status = OffsetToClusterRun(DeviceExt, Fcb, FirstCluster,
+                                    ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
+                                    &StartCluster, &ClusterCount);
+        if (!NT_SUCCESS(Status) || StartCluster == 0xffffffff)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (ReadOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += ReadOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            break;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
 
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector +
+                               ReadOffset.u.LowPart % BytesPerCluster;
+        BytesDone = (ULONG)min((ULONGLONG)Length,
+                               (ULONGLONG)ClusterCount * BytesPerCluster - ReadOffset.u.LowPart % BytesPerCluster);
+        DPRINT("start %08x, count %u, bytes %u\n",
+               StartCluster, ClusterCount, BytesDone);
 
         /* Fire up the read command */
         Status = VfatReadDiskPartial (IrpContext, &StartOffset, BytesDone, *LengthRead, FALSE);
@@ -332,18 +410,14 @@ VfatWriteFileData(
     PVFATFCB Fcb;
     ULONG Count;
     ULONG FirstCluster;
-    ULONG CurrentCluster;
     ULONG BytesDone;
     ULONG StartCluster;
     ULONG ClusterCount;
     NTSTATUS Status = STATUS_SUCCESS;
-    BOOLEAN First = TRUE;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
     LARGE_INTEGER StartOffset;
     ULONG BufferOffset;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -408,8 +482,7 @@ VfatWriteFileData(
     /*
      * Find the first cluster
      */
-    FirstCluster =
-    CurrentCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
+    FirstCluster = vfatDirEntryGetFirstCluster (DeviceExt, &Fcb->entry);
 
     if (FirstCluster == 1)
     {
@@ -421,89 +494,26 @@ VfatWriteFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
-    /*
-     * Find the cluster to start the write from
-     */
-    if (LastCluster > 0 && WriteOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
-    if (!NT_SUCCESS(Status))
-    {
-        return Status;
-    }
-
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (WriteOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     IrpContext->RefCount = 1;
     BufferOffset = 0;
 
-    while (Length > 0 && CurrentCluster != 0xffffffff)
+    while (Length > 0)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        /* Find the run of clusters the data starts in */
+        Status = OffsetToClusterRun(DeviceExt, Fcb, FirstCluster,
+                                    ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
+                                    &StartCluster, &ClusterCount);
+        if (!NT_SUCCESS(Status) || StartCluster == 0xffffffff)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (WriteOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += WriteOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            break;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
 
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector +
+                               WriteOffset.u.LowPart % BytesPerCluster;
+        BytesDone = (ULONG)min((ULONGLONG)Length,
+                               (ULONGLONG)ClusterCount * BytesPerCluster - WriteOffset.u.LowPart % BytesPerCluster);
+        DPRINT("start %08x, count %u, bytes %u\n",
+               StartCluster, ClusterCount, BytesDone);
 
         // Fire up the write command
         Status = VfatWriteDiskPartial (IrpContext, &StartOffset, BytesDone, BufferOffset, FALSE);
@@ -711,6 +721,23 @@ VfatRead(
     else
     {
         // non cached read
+        if (!PagingIo && !IsVolume &&
+            Fcb->SectionObjectPointers.DataSectionObject != NULL)
+        {
+            /* The disk must have what the cache holds before we read it */
+            if (!CanWait)
+            {
+                Status = STATUS_PENDING;
+                goto ByeBye;
+            }
+            CcFlushCache(&Fcb->SectionObjectPointers, &ByteOffset, Length, &IrpContext->Irp->IoStatus);
+            Status = IrpContext->Irp->IoStatus.Status;
+            if (!NT_SUCCESS(Status))
+            {
+                goto ByeBye;
+            }
+        }
+
         Status = VfatLockUserBuffer(IrpContext->Irp, Length, IoWriteAccess);
         if (!NT_SUCCESS(Status))
         {
@@ -991,6 +1018,24 @@ VfatWrite(
     else
     {
         // non cached write
+        if (!PagingIo && !IsVolume && !IsFAT &&
+            Fcb->SectionObjectPointers.DataSectionObject != NULL)
+        {
+            /* Write back the cached range and drop it, so nobody reads stale data */
+            if (!CanWait)
+            {
+                Status = STATUS_PENDING;
+                goto ByeBye;
+            }
+            CcFlushCache(&Fcb->SectionObjectPointers, &ByteOffset, Length, &IrpContext->Irp->IoStatus);
+            Status = IrpContext->Irp->IoStatus.Status;
+            if (!NT_SUCCESS(Status))
+            {
+                goto ByeBye;
+            }
+            CcPurgeCacheSection(&Fcb->SectionObjectPointers, &ByteOffset, Length, FALSE);
+        }
+
         Status = VfatLockUserBuffer(IrpContext->Irp, Length, IoReadAccess);
         if (!NT_SUCCESS(Status))
         {
@@ -306,6 +306,8 @@ typedef struct DEVICE_EXTENSION
     ULONG LastAvailableCluster;
     ULONG AvailableClusters;
     BOOLEAN AvailableClustersValid;
+    /* Set bits are the clusters in use, see BuildFreeClusterBitmap */
+    RTL_BITMAP FreeClusterBitmap;
     ULONG Flags;
     struct _VFATFCB *VolumeFcb;
 
@@ -477,13 +479,15 @@ typedef struct _VFATFCB
     FILE_LOCK FileLock;
 
     /*
-     * Optimization: caching of last read/write cluster+offset pair. Can't
-     * be in VFATCCB because it must be reset everytime the allocated clusters
-     * change.
+     * Runs of the cluster chain (file cluster -> disk cluster), filled in
+     * order as the chain gets walked: the first MappedClusters clusters of
+     * the file are in it. Must be truncated everytime the allocated clusters
+     * get freed. Readers holding the resources shared extend it concurrently,
+     * so MappedClusters is only changed with McbLock held.
      */
-    FAST_MUTEX LastMutex;
-    ULONG LastCluster;
-    ULONG LastOffset;
+    LARGE_MCB Mcb;
+    ULONG MappedClusters;
+    FAST_MUTEX McbLock;
 } VFATFCB, *PVFATFCB;
 
 typedef struct _VFATCCB
@@ -499,6 +503,7 @@ typedef struct _VFATCCB
 #define TAG_FCB  'BCFV'
 #define TAG_IRP  'PRIV'
 #define TAG_VFAT 'TAFV'
+#define TAG_BITMAP 'MBFV'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -845,6 +850,22 @@ WriteCluster(
     ULONG ClusterToWrite,
     ULONG NewValue);
 
+NTSTATUS
+BuildFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+VOID
+ReleaseFreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+NTSTATUS
+ExtendClusterChain(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG LastCluster,
+    ULONG ClusterCount,
+    PULONG FirstNewCluster,
+    PULONG LastNewCluster);
+
 /* fcb.c */
 
 PVFATFCB
@@ -1038,6 +1059,20 @@ NextCluster(
     PULONG CurrentCluster,
     BOOLEAN Extend);
 
+NTSTATUS
+OffsetToClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG FileOffset,
+    PULONG Cluster,
+    PULONG ClusterCount);
+
+VOID
+TruncateClusterRuns(
+    PVFATFCB Fcb,
+    ULONG ClusterCount);
+
 /* shutdown.c */
 
 DRIVER_DISPATCH
@@ -16,8 +16,217 @@
 BOOLEAN CcPfEnablePrefetcher;
 PFSN_PREFETCHER_GLOBALS CcPfGlobals;
 
+/* Reported through SystemPerformanceInformation */
+ULONG CcReadAheadIos;
+
+/* Private cache maps waiting for the read ahead thread */
+static LIST_ENTRY CcReadAheadQueue;
+static KSPIN_LOCK CcReadAheadQueueLock;
+static KEVENT CcReadAheadEvent;
+
+/* Never read ahead more than that at once */
+#define CC_MAXIMUM_READ_AHEAD (8 * VACB_MAPPING_GRANULARITY)
+
 /* FUNCTIONS *****************************************************************/
 
+static
+VOID
+CcRosPerformReadAhead(
+    PFILE_OBJECT FileObject,
+    LONGLONG FileOffset,
+    ULONG Length)
+/*
+ * FUNCTION: Maps the views covering the range and reads in those that
+ * aren't valid yet.
+ */
+{
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    LONGLONG CurrentOffset;
+    PVOID BaseAddress;
+    PROS_VACB Vacb;
+    BOOLEAN Valid;
+    NTSTATUS Status;
+
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+    ASSERT(SharedCacheMap);
+
+    if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, TRUE))
+    {
+        return;
+    }
+
+    for (CurrentOffset = ROUND_DOWN(FileOffset, VACB_MAPPING_GRANULARITY);
+         CurrentOffset < FileOffset + Length &&
+         CurrentOffset < SharedCacheMap->FileSize.QuadPart;
+         CurrentOffset += VACB_MAPPING_GRANULARITY)
+    {
+        Status = CcRosRequestVacb(SharedCacheMap,
+                                  CurrentOffset,
+                                  &BaseAddress,
+                                  &Valid,
+                                  &Vacb);
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
+
+        if (!Valid)
+        {
+            Status = CcReadVirtualAddress(Vacb);
+            Valid = NT_SUCCESS(Status);
+            CcReadAheadIos++;
+        }
+
+        CcRosReleaseVacb(SharedCacheMap, Vacb, Valid, FALSE, FALSE);
+
+        /* Don't insist, the reader will get the error if it matters */
+        if (!Valid)
+        {
+            DPRINT("Read ahead failed at %I64x with %lx\n", CurrentOffset, Status);
+            break;
+        }
+    }
+
+    SharedCacheMap->Callbacks->ReleaseFromReadAhead(SharedCacheMap->LazyWriteContext);
+}
+
+static
+VOID
+NTAPI
+CcReadAheadThread(
+    PVOID Context)
+{
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
+    PFILE_OBJECT FileObject;
+    LARGE_INTEGER FileOffset;
+    ULONG Length;
+    BOOLEAN Closed;
+    KIRQL OldIrql;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (;;)
+    {
+        KeWaitForSingleObject(&CcReadAheadEvent,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+        for (;;)
+        {
+            KeAcquireSpinLock(&CcReadAheadQueueLock, &OldIrql);
+            if (IsListEmpty(&CcReadAheadQueue))
+            {
+                KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+                break;
+            }
+            PrivateCacheMap = CONTAINING_RECORD(RemoveHeadList(&CcReadAheadQueue),
+                                                ROS_PRIVATE_CACHE_MAP,
+                                                ReadAheadLinks);
+            FileObject = PrivateCacheMap->FileObject;
+            FileOffset = PrivateCacheMap->ReadAheadOffset;
+            Length = PrivateCacheMap->ReadAheadLength;
+            Closed = PrivateCacheMap->Closed;
+            KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+
+            /* Nobody is going to read it if the file object was closed meanwhile */
+            if (!Closed)
+            {
+                CcRosPerformReadAhead(FileObject, FileOffset.QuadPart, Length);
+            }
+
+            KeAcquireSpinLock(&CcReadAheadQueueLock, &OldIrql);
+            PrivateCacheMap->ReadAheadActive = FALSE;
+            Closed = PrivateCacheMap->Closed;
+            KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+
+            /* CcRosFreePrivateCacheMap left it to us */
+            if (Closed)
+            {
+                ExFreePoolWithTag(PrivateCacheMap, TAG_PRIVATE_CACHE_MAP);
+            }
+
+            /* Drop the references taken by CcScheduleReadAhead */
+            CcRosDereferenceCache(FileObject);
+            ObDereferenceObject(FileObject);
+        }
+    }
+}
+
+static
+BOOLEAN
+NTAPI
+INIT_FUNCTION
+CcInitializeReadAhead(VOID)
+{
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+
+    InitializeListHead(&CcReadAheadQueue);
+    KeInitializeSpinLock(&CcReadAheadQueueLock);
+    KeInitializeEvent(&CcReadAheadEvent, SynchronizationEvent, FALSE);
+
+    Status = PsCreateSystemThread(&ThreadHandle,
+                                  THREAD_ALL_ACCESS,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  CcReadAheadThread,
+                                  NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to create the read ahead thread: %lx\n", Status);
+        return FALSE;
+    }
+
+    ObCloseHandle(ThreadHandle, KernelMode);
+    return TRUE;
+}
+
+PROS_PRIVATE_CACHE_MAP
+NTAPI
+CcRosAllocatePrivateCacheMap(
+    PFILE_OBJECT FileObject)
+{
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
+
+    PrivateCacheMap = ExAllocatePoolWithTag(NonPagedPool,
+                                            sizeof(*PrivateCacheMap),
+                                            TAG_PRIVATE_CACHE_MAP);
+    if (PrivateCacheMap == NULL)
+    {
+        return NULL;
+    }
+
+    RtlZeroMemory(PrivateCacheMap, sizeof(*PrivateCacheMap));
+    PrivateCacheMap->FileObject = FileObject;
+    PrivateCacheMap->ReadAheadMask = PAGE_SIZE - 1;
+    KeInitializeSpinLock(&PrivateCacheMap->ReadAheadSpinLock);
+
+    return PrivateCacheMap;
+}
+
+VOID
+NTAPI
+CcRosFreePrivateCacheMap(
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap)
+{
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&CcReadAheadQueueLock, &OldIrql);
+    if (PrivateCacheMap->ReadAheadActive)
+    {
+        /* The read ahead thread still uses it, it will free it when done */
+        PrivateCacheMap->Closed = TRUE;
+        KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+        return;
+    }
+    KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+
+    ExFreePoolWithTag(PrivateCacheMap, TAG_PRIVATE_CACHE_MAP);
+}
+
 VOID
 NTAPI
 INIT_FUNCTION
@@ -42,7 +251,7 @@ INIT_FUNCTION
 CcInitializeCacheManager(VOID)
 {
     CcInitView();
-    return TRUE;
+    return CcInitializeReadAhead() && CcInitializeLazyWriter();
 }
 
 /*
@@ -77,18 +286,125 @@ CcRemapBcb (
     return 0;
 }
 
+FORCEINLINE
+BOOLEAN
+CcRosIsReadContinuing(
+    _In_ PROS_PRIVATE_CACHE_MAP PrivateCacheMap,
+    _In_ LONGLONG PreviousOffset,
+    _In_ LONGLONG PreviousEnd,
+    _In_ LONGLONG FileOffset)
+{
+    /* A read continues the previous one if it starts within a read ahead
+     * granule of where the previous one ended, without going backwards */
+    return (FileOffset >= PreviousOffset &&
+            (FileOffset & ~(LONGLONG)PrivateCacheMap->ReadAheadMask) <= PreviousEnd);
+}
+
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
 CcScheduleReadAhead (
-	IN	PFILE_OBJECT		FileObject,
-	IN	PLARGE_INTEGER		FileOffset,
-	IN	ULONG			Length
-	)
+    IN PFILE_OBJECT FileObject,
+    IN PLARGE_INTEGER FileOffset,
+    IN ULONG Length)
 {
-	UNIMPLEMENTED;
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    LONGLONG ReadAheadStart, ReadAheadEnd, ReadAheadLength;
+    BOOLEAN Sequential, Queue;
+    KIRQL OldIrql;
+
+    CCTRACE(CC_API_DEBUG, "FileObject=%p FileOffset=%I64d Length=%lu\n",
+        FileObject, FileOffset->QuadPart, Length);
+
+    PrivateCacheMap = FileObject->PrivateCacheMap;
+    if (PrivateCacheMap == NULL || Length == 0)
+    {
+        return;
+    }
+
+    /* The file system or the opener told us not to bother */
+    SharedCacheMap = PrivateCacheMap->SharedCacheMap;
+    if (SharedCacheMap->ReadAheadDisabled ||
+        BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
+    {
+        return;
+    }
+
+    KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
+
+    /* Sequential means both this read and the previous one continue their predecessor */
+    Sequential = BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY) ||
+                 (CcRosIsReadContinuing(PrivateCacheMap,
+                                        PrivateCacheMap->FileOffset2.QuadPart,
+                                        PrivateCacheMap->BeyondLastByte2.QuadPart,
+                                        FileOffset->QuadPart) &&
+                  CcRosIsReadContinuing(PrivateCacheMap,
+                                        PrivateCacheMap->FileOffset1.QuadPart,
+                                        PrivateCacheMap->BeyondLastByte1.QuadPart,
+                                        PrivateCacheMap->FileOffset2.QuadPart));
+
+    /* Update the history */
+    PrivateCacheMap->FileOffset1 = PrivateCacheMap->FileOffset2;
+    PrivateCacheMap->BeyondLastByte1 = PrivateCacheMap->BeyondLastByte2;
+    PrivateCacheMap->FileOffset2.QuadPart = FileOffset->QuadPart;
+    PrivateCacheMap->BeyondLastByte2.QuadPart = FileOffset->QuadPart + Length;
+
+    if (!Sequential)
+    {
+        /* Start over when the pattern comes back */
+        PrivateCacheMap->ReadAheadEnd.QuadPart = 0;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
+    }
+
+    /* Read ahead at least a granule, twice as much if we were promised sequential access */
+    ReadAheadLength = max(Length, PrivateCacheMap->ReadAheadMask + 1);
+    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+    {
+        ReadAheadLength *= 2;
+    }
+    ReadAheadLength = min(ReadAheadLength, CC_MAXIMUM_READ_AHEAD);
+
+    /* The read ahead thread works with whole views, and skips what was already scheduled */
+    ReadAheadStart = max(FileOffset->QuadPart + Length, PrivateCacheMap->ReadAheadEnd.QuadPart);
+    ReadAheadEnd = ROUND_UP(FileOffset->QuadPart + Length + ReadAheadLength, VACB_MAPPING_GRANULARITY);
+    ReadAheadEnd = min(ReadAheadEnd, SharedCacheMap->FileSize.QuadPart);
+
+    Queue = FALSE;
+    if (ReadAheadStart < ReadAheadEnd)
+    {
+        /* Only one at a time per file object, the next read will pick up the rest */
+        KeAcquireSpinLockAtDpcLevel(&CcReadAheadQueueLock);
+        if (!PrivateCacheMap->ReadAheadActive)
+        {
+            PrivateCacheMap->ReadAheadActive = TRUE;
+            PrivateCacheMap->ReadAheadOffset.QuadPart = ReadAheadStart;
+            PrivateCacheMap->ReadAheadLength = (ULONG)(ReadAheadEnd - ReadAheadStart);
+            PrivateCacheMap->ReadAheadEnd.QuadPart = ReadAheadEnd;
+            Queue = TRUE;
+        }
+        KeReleaseSpinLockFromDpcLevel(&CcReadAheadQueueLock);
+    }
+
+    KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+
+    if (!Queue)
+    {
+        return;
+    }
+
+    /* Keep the file object and its cache around until the read ahead is done */
+    ObReferenceObject(FileObject);
+    CcRosReferenceCache(FileObject);
+
+    KeAcquireSpinLock(&CcReadAheadQueueLock, &OldIrql);
+    InsertTailList(&CcReadAheadQueue, &PrivateCacheMap->ReadAheadLinks);
+    KeReleaseSpinLock(&CcReadAheadQueueLock, OldIrql);
+
+    KeSetEvent(&CcReadAheadEvent, IO_NO_INCREMENT, FALSE);
 }
 
 /*
@@ -102,10 +418,18 @@ CcSetAdditionalCacheAttributes (
 	IN	BOOLEAN		DisableWriteBehind
 	)
 {
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+
     CCTRACE(CC_API_DEBUG, "FileObject=%p DisableReadAhead=%d DisableWriteBehind=%d\n",
         FileObject, DisableReadAhead, DisableWriteBehind);
 
-	UNIMPLEMENTED;
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+    SharedCacheMap->ReadAheadDisabled = DisableReadAhead;
+
+    if (DisableWriteBehind)
+    {
+        UNIMPLEMENTED;
+    }
 }
 
 /*
@@ -149,7 +473,7 @@ CcSetDirtyPageThreshold (
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
@@ -158,8 +482,15 @@ CcSetReadAheadGranularity (
 	IN	ULONG		Granularity
 	)
 {
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
+
     CCTRACE(CC_API_DEBUG, "FileObject=%p Granularity=%lu\n",
         FileObject, Granularity);
 
-	UNIMPLEMENTED;
+    /* It must be a power of 2, and at least a page */
+    ASSERT(Granularity >= PAGE_SIZE);
+    ASSERT((Granularity & (Granularity - 1)) == 0);
+
+    PrivateCacheMap = FileObject->PrivateCacheMap;
+    PrivateCacheMap->ReadAheadMask = Granularity - 1;
 }
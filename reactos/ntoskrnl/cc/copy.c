@@ -167,6 +167,86 @@ CcWriteVirtualAddress (
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+NTAPI
+CcWriteVacbCluster (
+    PROS_VACB *Vacbs,
+    ULONG VacbCount)
+/*
+ * FUNCTION: Writes consecutive views of a file with a single paging I/O.
+ * The views follow each other in the file but not in memory, so the MDL
+ * describes their pages one view after the other.
+ */
+{
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    LONGLONG EndOffset;
+    ULONG Size, VacbSize, i, j;
+    PPFN_NUMBER MdlPages;
+    PMDL Mdl;
+    NTSTATUS Status;
+    IO_STATUS_BLOCK IoStatus;
+    KEVENT Event;
+
+    if (VacbCount == 1)
+    {
+        return CcWriteVirtualAddress(Vacbs[0]);
+    }
+
+    SharedCacheMap = Vacbs[0]->SharedCacheMap;
+    EndOffset = min(SharedCacheMap->SectionSize.QuadPart,
+                    Vacbs[VacbCount - 1]->FileOffset.QuadPart + VACB_MAPPING_GRANULARITY);
+    Size = (ULONG)(EndOffset - Vacbs[0]->FileOffset.QuadPart);
+
+    Mdl = IoAllocateMdl(Vacbs[0]->BaseAddress, Size, FALSE, FALSE, NULL);
+    if (!Mdl)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    MdlPages = MmGetMdlPfnArray(Mdl);
+    for (i = 0; i < VacbCount; i++)
+    {
+        ASSERT(Vacbs[i]->SharedCacheMap == SharedCacheMap);
+        ASSERT(Vacbs[i]->FileOffset.QuadPart ==
+               Vacbs[0]->FileOffset.QuadPart + (LONGLONG)i * VACB_MAPPING_GRANULARITY);
+
+        Vacbs[i]->Dirty = FALSE;
+        VacbSize = min(Size - i * VACB_MAPPING_GRANULARITY, VACB_MAPPING_GRANULARITY);
+        for (j = 0; j < BYTES_TO_PAGES(VacbSize); j++)
+        {
+            *MdlPages++ = MmGetPfnForProcess(NULL, (PVOID)((ULONG_PTR)Vacbs[i]->BaseAddress + (j << PAGE_SHIFT)));
+        }
+    }
+    Mdl->MdlFlags |= MDL_PAGES_LOCKED | MDL_IO_PAGE_READ;
+
+    KeInitializeEvent(&Event, NotificationEvent, FALSE);
+    Status = IoSynchronousPageWrite(SharedCacheMap->FileObject, Mdl, &Vacbs[0]->FileOffset, &Event, &IoStatus);
+    if (Status == STATUS_PENDING)
+    {
+        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+        Status = IoStatus.Status;
+    }
+
+    /* Unlike with a single view, the driver had to map the pages itself */
+    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    {
+        MmUnmapLockedPages(Mdl->MappedSystemVa, Mdl);
+    }
+    IoFreeMdl(Mdl);
+
+    if (!NT_SUCCESS(Status) && (Status != STATUS_END_OF_FILE))
+    {
+        DPRINT1("IoPageWrite failed, Status %x\n", Status);
+        for (i = 0; i < VacbCount; i++)
+        {
+            Vacbs[i]->Dirty = TRUE;
+        }
+        return Status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS
 ReadWriteOrZero(
     _Inout_ PVOID BaseAddress,
@@ -214,7 +294,8 @@ CcCopyData (
     ULONG BytesCopied;
     KIRQL OldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
-    PLIST_ENTRY ListEntry;
+    LONGLONG ViewOffset;
+    PROS_VACB *Slot;
     PROS_VACB Vacb;
     ULONG PartialLength;
     PVOID BaseAddress;
@@ -229,25 +310,18 @@ CcCopyData (
         /* test if the requested data is available */
         KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
         /* FIXME: this loop doesn't take into account areas that don't have
-         * a VACB in the list yet */
-        ListEntry = SharedCacheMap->CacheMapVacbListHead.Flink;
-        while (ListEntry != &SharedCacheMap->CacheMapVacbListHead)
+         * a VACB in the index yet */
+        for (ViewOffset = ROUND_DOWN(CurrentOffset, VACB_MAPPING_GRANULARITY);
+             ViewOffset < CurrentOffset + Length;
+             ViewOffset += VACB_MAPPING_GRANULARITY)
         {
-            Vacb = CONTAINING_RECORD(ListEntry,
-                                     ROS_VACB,
-                                     CacheMapVacbListEntry);
-            ListEntry = ListEntry->Flink;
-            if (!Vacb->Valid &&
-                DoRangesIntersect(Vacb->FileOffset.QuadPart,
-                                  VACB_MAPPING_GRANULARITY,
-                                  CurrentOffset, Length))
+            Slot = CcRosGetVacbIndexSlot(SharedCacheMap, ViewOffset);
+            if (Slot != NULL && *Slot != NULL && !(*Slot)->Valid)
             {
                 KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
                 /* data not available */
                 return FALSE;
             }
-            if (Vacb->FileOffset.QuadPart >= CurrentOffset + Length)
-                break;
         }
         KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
     }
@@ -332,23 +406,6 @@ CcCopyData (
     return TRUE;
 }
 
-/*
- * @unimplemented
- */
-BOOLEAN
-NTAPI
-CcCanIWrite (
-    IN PFILE_OBJECT FileObject,
-    IN ULONG BytesToWrite,
-    IN BOOLEAN Wait,
-    IN BOOLEAN Retrying)
-{
-    CCTRACE(CC_API_DEBUG, "FileObject=%p BytesToWrite=%lu Wait=%d Retrying=%d\n",
-        FileObject, BytesToWrite, Wait, Retrying);
-
-    return TRUE;
-}
-
 /*
  * @implemented
  */
@@ -370,13 +427,20 @@ CcCopyRead (
            FileObject, FileOffset->QuadPart, Length, Wait,
            Buffer, IoStatus);
 
-    return CcCopyData(FileObject,
-                      FileOffset->QuadPart,
-                      Buffer,
-                      Length,
-                      CcOperationRead,
-                      Wait,
-                      IoStatus);
+    if (!CcCopyData(FileObject,
+                    FileOffset->QuadPart,
+                    Buffer,
+                    Length,
+                    CcOperationRead,
+                    Wait,
+                    IoStatus))
+    {
+        return FALSE;
+    }
+
+    /* Get the next views ready if the file is being read sequentially */
+    CcScheduleReadAhead(FileObject, FileOffset, Length);
+    return TRUE;
 }
 
 /*
@@ -409,25 +473,6 @@ CcCopyWrite (
                       &IoStatus);
 }
 
-/*
- * @unimplemented
- */
-VOID
-NTAPI
-CcDeferWrite (
-    IN PFILE_OBJECT FileObject,
-    IN PCC_POST_DEFERRED_WRITE PostRoutine,
-    IN PVOID Context1,
-    IN PVOID Context2,
-    IN ULONG BytesToWrite,
-    IN BOOLEAN Retrying)
-{
-    CCTRACE(CC_API_DEBUG, "FileObject=%p PostRoutine=%p Context1=%p Context2=%p BytesToWrite=%lu Retrying=%d\n",
-        FileObject, PostRoutine, Context1, Context2, BytesToWrite, Retrying);
-
-    PostRoutine(Context1, Context2);
-}
-
 /*
  * @unimplemented
  */
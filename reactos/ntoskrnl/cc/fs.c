@@ -20,7 +20,6 @@
 /* GLOBALS   *****************************************************************/
 
 extern KGUARDED_MUTEX ViewLock;
-extern ULONG DirtyPageCount;
 
 NTSTATUS CcRosInternalFreeVacb(PROS_VACB Vacb);
 
@@ -177,7 +176,8 @@ CcPurgeCacheSection (
         Vacb = CONTAINING_RECORD(ListEntry, ROS_VACB, CacheMapVacbListEntry);
         ListEntry = ListEntry->Flink;
 
-        /* Skip VACBs outside the range, or only partially in range */
+        /* Skip VACBs outside the range, or only partially in range.
+         * The list isn't sorted, so look at all of them */
         if (Vacb->FileOffset.QuadPart < StartOffset)
         {
             continue;
@@ -186,7 +186,7 @@ CcPurgeCacheSection (
                       SharedCacheMap->SectionSize.QuadPart);
         if (ViewEnd >= EndOffset)
         {
-            break;
+            continue;
         }
 
         ASSERT((Vacb->ReferenceCount == 0) ||
@@ -199,11 +199,12 @@ CcPurgeCacheSection (
             RemoveEntryList(&Vacb->DirtyVacbListEntry);
             DirtyPageCount -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
         }
-        RemoveEntryList(&Vacb->CacheMapVacbListEntry);
+        CcRosRemoveVacbFromIndex(Vacb);
         InsertHeadList(&FreeList, &Vacb->CacheMapVacbListEntry);
     }
     KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
     KeReleaseGuardedMutex(&ViewLock);
+    CcRosDirtyPagesWritten();
 
     while (!IsListEmpty(&FreeList))
     {
@@ -0,0 +1,329 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS kernel
+ * FILE:            ntoskrnl/cc/lazywrite.c
+ * PURPOSE:         Lazy writer and write throttling
+ *
+ * PROGRAMMERS:
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS *******************************************************************/
+
+/* Writers get throttled once that many pages are dirty in the cache */
+ULONG CcDirtyPageThreshold;
+
+/* Reported through SystemPerformanceInformation */
+ULONG CcLazyWriteIos;
+ULONG CcLazyWritePages;
+ULONG CcDataFlushes;
+ULONG CcDataPages;
+
+/* Writes waiting for the dirty pages to be written, oldest first */
+static LIST_ENTRY CcDeferredWrites;
+static KSPIN_LOCK CcDeferredWriteSpinLock;
+
+static KEVENT CcLazyWriteEvent;
+static KTIMER CcLazyWriteTimer;
+
+/* The lazy writer runs at least that often (ms), and right away when
+ * writers are waiting and dirty pages get written */
+#define CC_LAZY_WRITE_PERIOD    1000
+
+/* Share of the dirty pages written by a periodic pass */
+#define CC_LAZY_WRITE_FRACTION  8
+
+/* FUNCTIONS *****************************************************************/
+
+FORCEINLINE
+BOOLEAN
+CcRosCanDirtyPages(
+    _In_ ULONG Pages)
+{
+    /* Let a write through when nothing is dirty, however large it is */
+    return (DirtyPageCount == 0 ||
+            DirtyPageCount + Pages <= CcDirtyPageThreshold);
+}
+
+static
+VOID
+CcPostDeferredWrites(
+    BOOLEAN Force)
+/*
+ * FUNCTION: Lets the waiting writes go, in order, as long as what they
+ * are going to dirty fits below the threshold.
+ * ARGUMENTS:
+ *       Force - Lets the first one go regardless, for when the dirty
+ *               pages can't be written at the moment.
+ */
+{
+    PROS_DEFERRED_WRITE DeferredWrite;
+    ULONG PendingPages = 0;
+    ULONG Pages;
+    KIRQL OldIrql;
+
+    for (;;)
+    {
+        KeAcquireSpinLock(&CcDeferredWriteSpinLock, &OldIrql);
+        if (IsListEmpty(&CcDeferredWrites))
+        {
+            KeReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+            break;
+        }
+
+        DeferredWrite = CONTAINING_RECORD(CcDeferredWrites.Flink,
+                                          ROS_DEFERRED_WRITE,
+                                          DeferredWriteLinks);
+        Pages = BYTES_TO_PAGES(DeferredWrite->BytesToWrite);
+        if (!Force && !CcRosCanDirtyPages(PendingPages + Pages))
+        {
+            KeReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+            break;
+        }
+        RemoveEntryList(&DeferredWrite->DeferredWriteLinks);
+        KeReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+
+        /* The writes let go haven't dirtied anything yet, account for them */
+        PendingPages += Pages;
+        Force = FALSE;
+
+        if (DeferredWrite->Event != NULL)
+        {
+            /* A CcCanIWrite caller, the entry lives on its stack */
+            KeSetEvent(DeferredWrite->Event, IO_NO_INCREMENT, FALSE);
+            continue;
+        }
+
+        DeferredWrite->PostRoutine(DeferredWrite->Context1,
+                                   DeferredWrite->Context2);
+        ObDereferenceObject(DeferredWrite->FileObject);
+        ExFreePoolWithTag(DeferredWrite, TAG_DEFERRED_WRITE);
+    }
+}
+
+static
+VOID
+NTAPI
+CcLazyWriteThread(
+    PVOID Context)
+{
+    PVOID WaitObjects[2];
+    ULONG Target, Written, Dirty;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    WaitObjects[0] = &CcLazyWriteEvent;
+    WaitObjects[1] = &CcLazyWriteTimer;
+
+    for (;;)
+    {
+        KeWaitForMultipleObjects(2,
+                                 WaitObjects,
+                                 WaitAny,
+                                 Executive,
+                                 KernelMode,
+                                 FALSE,
+                                 NULL,
+                                 NULL);
+
+        do
+        {
+            /* Let go whatever fits already, someone else may have written */
+            CcPostDeferredWrites(FALSE);
+
+            /* Write a share of the dirty pages on every pass so that nothing
+             * stays dirty for long, and everything above the threshold */
+            Dirty = DirtyPageCount;
+            Target = Dirty / CC_LAZY_WRITE_FRACTION;
+            if (Dirty > CcDirtyPageThreshold)
+            {
+                Target = max(Target, Dirty - CcDirtyPageThreshold);
+            }
+            else if (Target == 0)
+            {
+                Target = Dirty;
+            }
+
+            Written = 0;
+            if (Target != 0)
+            {
+                CcRosFlushDirtyPages(Target, &Written, FALSE);
+            }
+
+            DPRINT("Lazy writer: %lu dirty pages, %lu written\n", Dirty, Written);
+
+            /* Don't leave writers stuck behind dirty pages that are in use */
+            CcPostDeferredWrites(Written == 0);
+
+            /* Writers still waiting don't wait for the timer while we make progress */
+        } while (Written != 0 && !IsListEmpty(&CcDeferredWrites));
+    }
+}
+
+VOID
+NTAPI
+CcRosDirtyPagesWritten(VOID)
+/*
+ * FUNCTION: Wakes the lazy writer when dirty pages got written or dropped
+ * behind its back, so that waiting writers go as soon as there's room.
+ */
+{
+    if (!IsListEmpty(&CcDeferredWrites) &&
+        DirtyPageCount < CcDirtyPageThreshold)
+    {
+        KeSetEvent(&CcLazyWriteEvent, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+BOOLEAN
+NTAPI
+INIT_FUNCTION
+CcInitializeLazyWriter(VOID)
+{
+    LARGE_INTEGER DueTime;
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+
+    /* An eighth of the memory, but enough for a few clustered writes */
+    CcDirtyPageThreshold = max((ULONG)(MmNumberOfPhysicalPages / 8),
+                               2 * CC_LAZY_WRITE_CLUSTER * (VACB_MAPPING_GRANULARITY / PAGE_SIZE));
+
+    InitializeListHead(&CcDeferredWrites);
+    KeInitializeSpinLock(&CcDeferredWriteSpinLock);
+    KeInitializeEvent(&CcLazyWriteEvent, SynchronizationEvent, FALSE);
+
+    KeInitializeTimerEx(&CcLazyWriteTimer, SynchronizationTimer);
+    DueTime.QuadPart = -(LONGLONG)CC_LAZY_WRITE_PERIOD * 10000;
+    KeSetTimerEx(&CcLazyWriteTimer, DueTime, CC_LAZY_WRITE_PERIOD, NULL);
+
+    Status = PsCreateSystemThread(&ThreadHandle,
+                                  THREAD_ALL_ACCESS,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  CcLazyWriteThread,
+                                  NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to create the lazy writer thread: %lx\n", Status);
+        KeCancelTimer(&CcLazyWriteTimer);
+        return FALSE;
+    }
+
+    ObCloseHandle(ThreadHandle, KernelMode);
+    return TRUE;
+}
+
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+CcCanIWrite (
+    IN PFILE_OBJECT FileObject,
+    IN ULONG BytesToWrite,
+    IN BOOLEAN Wait,
+    IN BOOLEAN Retrying)
+{
+    ROS_DEFERRED_WRITE DeferredWrite;
+    KEVENT Event;
+    KIRQL OldIrql;
+
+    CCTRACE(CC_API_DEBUG, "FileObject=%p BytesToWrite=%lu Wait=%d Retrying=%d\n",
+        FileObject, BytesToWrite, Wait, Retrying);
+
+    /* Don't overtake the writes already waiting, unless retrying one of them */
+    if ((Retrying || IsListEmpty(&CcDeferredWrites)) &&
+        CcRosCanDirtyPages(BYTES_TO_PAGES(BytesToWrite)))
+    {
+        return TRUE;
+    }
+
+    /* Get the dirty pages written */
+    KeSetEvent(&CcLazyWriteEvent, IO_NO_INCREMENT, FALSE);
+
+    if (!Wait)
+    {
+        return FALSE;
+    }
+
+    /* Queue up and wait for the lazy writer to let us go */
+    KeInitializeEvent(&Event, NotificationEvent, FALSE);
+    DeferredWrite.FileObject = FileObject;
+    DeferredWrite.BytesToWrite = BytesToWrite;
+    DeferredWrite.Event = &Event;
+    DeferredWrite.PostRoutine = NULL;
+
+    KeAcquireSpinLock(&CcDeferredWriteSpinLock, &OldIrql);
+    if (Retrying)
+        InsertHeadList(&CcDeferredWrites, &DeferredWrite.DeferredWriteLinks);
+    else
+        InsertTailList(&CcDeferredWrites, &DeferredWrite.DeferredWriteLinks);
+    KeReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+
+    KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+    return TRUE;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+CcDeferWrite (
+    IN PFILE_OBJECT FileObject,
+    IN PCC_POST_DEFERRED_WRITE PostRoutine,
+    IN PVOID Context1,
+    IN PVOID Context2,
+    IN ULONG BytesToWrite,
+    IN BOOLEAN Retrying)
+{
+    PROS_DEFERRED_WRITE DeferredWrite;
+    KIRQL OldIrql;
+
+    CCTRACE(CC_API_DEBUG, "FileObject=%p PostRoutine=%p Context1=%p Context2=%p BytesToWrite=%lu Retrying=%d\n",
+        FileObject, PostRoutine, Context1, Context2, BytesToWrite, Retrying);
+
+    DeferredWrite = ExAllocatePoolWithTag(NonPagedPool,
+                                          sizeof(*DeferredWrite),
+                                          TAG_DEFERRED_WRITE);
+    if (DeferredWrite == NULL)
+    {
+        /* Better write now than never */
+        PostRoutine(Context1, Context2);
+        return;
+    }
+
+    ObReferenceObject(FileObject);
+    DeferredWrite->FileObject = FileObject;
+    DeferredWrite->BytesToWrite = BytesToWrite;
+    DeferredWrite->Event = NULL;
+    DeferredWrite->PostRoutine = PostRoutine;
+    DeferredWrite->Context1 = Context1;
+    DeferredWrite->Context2 = Context2;
+
+    KeAcquireSpinLock(&CcDeferredWriteSpinLock, &OldIrql);
+    if (Retrying)
+        InsertHeadList(&CcDeferredWrites, &DeferredWrite->DeferredWriteLinks);
+    else
+        InsertTailList(&CcDeferredWrites, &DeferredWrite->DeferredWriteLinks);
+    KeReleaseSpinLock(&CcDeferredWriteSpinLock, OldIrql);
+
+    /* Post it right away if there's room already, otherwise the lazy
+     * writer will once it has written enough */
+    if (CcRosCanDirtyPages(BYTES_TO_PAGES(BytesToWrite)))
+    {
+        CcPostDeferredWrites(FALSE);
+    }
+    else
+    {
+        KeSetEvent(&CcLazyWriteEvent, IO_NO_INCREMENT, FALSE);
+    }
+}
+
+/* EOF */
@@ -51,30 +51,49 @@ NPAGED_LOOKASIDE_LIST iBcbLookasideList;
 static NPAGED_LOOKASIDE_LIST SharedCacheMapLookasideList;
 static NPAGED_LOOKASIDE_LIST VacbLookasideList;
 
+/*
+ * Locking rules:
+ * - ViewLock protects the global LRU and dirty lists, DirtyPageCount and
+ *   the lifetime of the shared cache maps. It is never needed to look up
+ *   or release a VACB that's already there.
+ * - The CacheMapLock of a shared cache map protects its VACB index and
+ *   list. A VACB is only removed from them with this lock held and its
+ *   ReferenceCount at 0, so a VACB found in the index can be referenced
+ *   safely while the lock is held.
+ * - The VACB mutex serializes the users of a view and guards its Dirty
+ *   and MappedCount fields against concurrent changes. The clean to dirty
+ *   transition additionally needs ViewLock, for the dirty list.
+ * When both are needed, ViewLock is acquired before a CacheMapLock.
+ */
 #if DBG
 static void CcRosVacbIncRefCount_(PROS_VACB vacb, const char* file, int line)
 {
-    ++vacb->ReferenceCount;
+    ULONG Refs;
+
+    Refs = InterlockedIncrement((PLONG)&vacb->ReferenceCount);
     if (vacb->SharedCacheMap->Trace)
     {
         DbgPrint("(%s:%i) VACB %p ++RefCount=%lu, Dirty %u, PageOut %lu\n",
-                 file, line, vacb, vacb->ReferenceCount, vacb->Dirty, vacb->PageOut);
+                 file, line, vacb, Refs, vacb->Dirty, vacb->PageOut);
     }
 }
 static void CcRosVacbDecRefCount_(PROS_VACB vacb, const char* file, int line)
 {
-    --vacb->ReferenceCount;
-    if (vacb->SharedCacheMap->Trace)
+    BOOLEAN Trace = vacb->SharedCacheMap->Trace;
+    ULONG Refs;
+
+    Refs = InterlockedDecrement((PLONG)&vacb->ReferenceCount);
+    if (Trace)
     {
-        DbgPrint("(%s:%i) VACB %p --RefCount=%lu, Dirty %u, PageOut %lu\n",
-                 file, line, vacb, vacb->ReferenceCount, vacb->Dirty, vacb->PageOut);
+        DbgPrint("(%s:%i) VACB %p --RefCount=%lu\n",
+                 file, line, vacb, Refs);
     }
 }
 #define CcRosVacbIncRefCount(vacb) CcRosVacbIncRefCount_(vacb,__FILE__,__LINE__)
 #define CcRosVacbDecRefCount(vacb) CcRosVacbDecRefCount_(vacb,__FILE__,__LINE__)
 #else
-#define CcRosVacbIncRefCount(vacb) (++((vacb)->ReferenceCount))
-#define CcRosVacbDecRefCount(vacb) (--((vacb)->ReferenceCount))
+#define CcRosVacbIncRefCount(vacb) InterlockedIncrement((PLONG)&(vacb)->ReferenceCount)
+#define CcRosVacbDecRefCount(vacb) InterlockedDecrement((PLONG)&(vacb)->ReferenceCount)
 #endif
 
 NTSTATUS
@@ -129,32 +148,111 @@ CcRosTraceCacheMap (
 #endif
 }
 
+static
 NTSTATUS
-NTAPI
-CcRosFlushVacb (
-    PROS_VACB Vacb)
+CcRosFlushVacbCluster (
+    PROS_VACB *Vacbs,
+    ULONG VacbCount)
+/*
+ * FUNCTION: Writes consecutive dirty views of a file and marks them clean.
+ * The caller holds their locks.
+ */
 {
     NTSTATUS Status;
-    KIRQL oldIrql;
+    ULONG i;
 
-    Status = CcWriteVirtualAddress(Vacb);
+    Status = CcWriteVacbCluster(Vacbs, VacbCount);
     if (NT_SUCCESS(Status))
     {
         KeAcquireGuardedMutex(&ViewLock);
-        KeAcquireSpinLock(&Vacb->SharedCacheMap->CacheMapLock, &oldIrql);
 
-        Vacb->Dirty = FALSE;
-        RemoveEntryList(&Vacb->DirtyVacbListEntry);
-        DirtyPageCount -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
-        CcRosVacbDecRefCount(Vacb);
+        for (i = 0; i < VacbCount; i++)
+        {
+            Vacbs[i]->Dirty = FALSE;
+            RemoveEntryList(&Vacbs[i]->DirtyVacbListEntry);
+            DirtyPageCount -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+            CcRosVacbDecRefCount(Vacbs[i]);
+        }
 
-        KeReleaseSpinLock(&Vacb->SharedCacheMap->CacheMapLock, oldIrql);
         KeReleaseGuardedMutex(&ViewLock);
+        CcRosDirtyPagesWritten();
     }
 
     return Status;
 }
 
+NTSTATUS
+NTAPI
+CcRosFlushVacb (
+    PROS_VACB Vacb)
+{
+    return CcRosFlushVacbCluster(&Vacb, 1);
+}
+
+static
+ULONG
+CcRosGatherDirtyVacbs (
+    PROS_VACB FirstVacb,
+    PROS_VACB *Cluster)
+/*
+ * FUNCTION: Collects the dirty views that directly follow FirstVacb in its
+ * file, so that they can be written along with it.
+ * RETURNS: The number of views in the cluster, FirstVacb included. The
+ * views added to it are referenced and locked.
+ * NOTE: Called with ViewLock held, so no view can become dirty meanwhile.
+ */
+{
+    PROS_SHARED_CACHE_MAP SharedCacheMap = FirstVacb->SharedCacheMap;
+    LARGE_INTEGER ZeroTimeout;
+    LONGLONG FileOffset;
+    PROS_VACB *Slot;
+    PROS_VACB Vacb;
+    ULONG VacbCount;
+    KIRQL oldIrql;
+
+    ZeroTimeout.QuadPart = 0;
+    Cluster[0] = FirstVacb;
+
+    for (VacbCount = 1; VacbCount < CC_LAZY_WRITE_CLUSTER; VacbCount++)
+    {
+        FileOffset = FirstVacb->FileOffset.QuadPart + (LONGLONG)VacbCount * VACB_MAPPING_GRANULARITY;
+        if (FileOffset >= SharedCacheMap->SectionSize.QuadPart)
+        {
+            break;
+        }
+
+        KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+        Slot = CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset);
+        Vacb = (Slot != NULL) ? *Slot : NULL;
+        if (Vacb == NULL || !Vacb->Dirty)
+        {
+            KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+            break;
+        }
+        CcRosVacbIncRefCount(Vacb);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+
+        /* Never wait for a view in use, just end the cluster there */
+        if (CcRosAcquireVacbLock(Vacb, &ZeroTimeout) != STATUS_SUCCESS)
+        {
+            CcRosVacbDecRefCount(Vacb);
+            break;
+        }
+
+        /* Same rule as CcRosFlushDirtyPages for the first view */
+        if (!Vacb->Dirty || Vacb->ReferenceCount > 2)
+        {
+            CcRosReleaseVacbLock(Vacb);
+            CcRosVacbDecRefCount(Vacb);
+            break;
+        }
+
+        Cluster[VacbCount] = Vacb;
+    }
+
+    return VacbCount;
+}
+
 NTSTATUS
 NTAPI
 CcRosFlushDirtyPages (
@@ -164,6 +262,8 @@ CcRosFlushDirtyPages (
 {
     PLIST_ENTRY current_entry;
     PROS_VACB current;
+    PROS_VACB Cluster[CC_LAZY_WRITE_CLUSTER];
+    ULONG ClusterCount, ClusterPages, i;
     BOOLEAN Locked;
     NTSTATUS Status;
     LARGE_INTEGER ZeroTimeout;
@@ -221,16 +321,26 @@ CcRosFlushDirtyPages (
             continue;
         }
 
+        /* Write the dirty views that follow along with this one */
+        ClusterCount = CcRosGatherDirtyVacbs(current, Cluster);
+        ClusterPages = ClusterCount * (VACB_MAPPING_GRANULARITY / PAGE_SIZE);
+
         KeReleaseGuardedMutex(&ViewLock);
 
-        Status = CcRosFlushVacb(current);
+        Status = CcRosFlushVacbCluster(Cluster, ClusterCount);
 
-        CcRosReleaseVacbLock(current);
+        for (i = 0; i < ClusterCount; i++)
+        {
+            CcRosReleaseVacbLock(Cluster[i]);
+        }
         current->SharedCacheMap->Callbacks->ReleaseFromLazyWrite(
             current->SharedCacheMap->LazyWriteContext);
 
         KeAcquireGuardedMutex(&ViewLock);
-        CcRosVacbDecRefCount(current);
+        for (i = 0; i < ClusterCount; i++)
+        {
+            CcRosVacbDecRefCount(Cluster[i]);
+        }
 
         if (!NT_SUCCESS(Status) && (Status != STATUS_END_OF_FILE) &&
             (Status != STATUS_MEDIA_WRITE_PROTECTED))
@@ -239,8 +349,11 @@ CcRosFlushDirtyPages (
         }
         else
         {
-            (*Count) += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
-            Target -= VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+            (*Count) += ClusterPages;
+            Target -= min(Target, ClusterPages);
+
+            CcLazyWriteIos++;
+            CcLazyWritePages += ClusterPages;
         }
 
         current_entry = DirtyVacbListHead.Flink;
@@ -293,6 +406,13 @@ retry:
                                     VacbLruListEntry);
         current_entry = current_entry->Flink;
 
+        /* Give the views used since the last pass a second chance */
+        if (current->Accessed)
+        {
+            current->Accessed = FALSE;
+            continue;
+        }
+
         KeAcquireSpinLock(&current->SharedCacheMap->CacheMapLock, &oldIrql);
 
         /* Reference the VACB */
@@ -327,7 +447,7 @@ retry:
             ASSERT(!current->Dirty);
             ASSERT(!current->MappedCount);
 
-            RemoveEntryList(&current->CacheMapVacbListEntry);
+            CcRosRemoveVacbFromIndex(current);
             RemoveEntryList(&current->VacbLruListEntry);
             InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
 
@@ -384,46 +504,40 @@ CcRosReleaseVacb (
     BOOLEAN Dirty,
     BOOLEAN Mapped)
 {
-    BOOLEAN WasDirty;
-    KIRQL oldIrql;
-
     ASSERT(SharedCacheMap);
 
     DPRINT("CcRosReleaseVacb(SharedCacheMap 0x%p, Vacb 0x%p, Valid %u)\n",
            SharedCacheMap, Vacb, Valid);
 
-    KeAcquireGuardedMutex(&ViewLock);
-    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
-
     Vacb->Valid = Valid;
 
-    WasDirty = Vacb->Dirty;
-    Vacb->Dirty = Vacb->Dirty || Dirty;
-
-    if (!WasDirty && Vacb->Dirty)
+    /* The VACB lock is held, so only the dirty list needs a lock */
+    if (Dirty && !Vacb->Dirty)
     {
+        KeAcquireGuardedMutex(&ViewLock);
+        Vacb->Dirty = TRUE;
         InsertTailList(&DirtyVacbListHead, &Vacb->DirtyVacbListEntry);
         DirtyPageCount += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+        KeReleaseGuardedMutex(&ViewLock);
+
+        /* Reference held by the dirty list */
+        CcRosVacbIncRefCount(Vacb);
     }
 
     if (Mapped)
     {
         Vacb->MappedCount++;
-    }
-    CcRosVacbDecRefCount(Vacb);
-    if (Mapped && (Vacb->MappedCount == 1))
-    {
-        CcRosVacbIncRefCount(Vacb);
-    }
-    if (!WasDirty && Vacb->Dirty)
-    {
-        CcRosVacbIncRefCount(Vacb);
+        if (Vacb->MappedCount == 1)
+        {
+            CcRosVacbIncRefCount(Vacb);
+        }
     }
 
-    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-    KeReleaseGuardedMutex(&ViewLock);
     CcRosReleaseVacbLock(Vacb);
 
+    /* Drop the caller's reference last, the VACB can go away after that */
+    CcRosVacbDecRefCount(Vacb);
+
     return STATUS_SUCCESS;
 }
 
@@ -434,8 +548,8 @@ CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
-    PROS_VACB current;
+    PROS_VACB *Slot;
+    PROS_VACB current = NULL;
     KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
@@ -443,34 +557,26 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    KeAcquireGuardedMutex(&ViewLock);
     KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset);
+    if (Slot != NULL && *Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-            KeReleaseGuardedMutex(&ViewLock);
-            CcRosAcquireVacbLock(current, NULL);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        current = *Slot;
+        ASSERT(IsPointInRange(current->FileOffset.QuadPart,
+                              VACB_MAPPING_GRANULARITY,
+                              FileOffset));
+        CcRosVacbIncRefCount(current);
     }
 
     KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-    KeReleaseGuardedMutex(&ViewLock);
 
-    return NULL;
+    if (current != NULL)
+    {
+        CcRosAcquireVacbLock(current, NULL);
+    }
+
+    return current;
 }
 
 NTSTATUS
@@ -480,7 +586,6 @@ CcRosMarkDirtyVacb (
     LONGLONG FileOffset)
 {
     PROS_VACB Vacb;
-    KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
 
@@ -493,27 +598,22 @@ CcRosMarkDirtyVacb (
         KeBugCheck(CACHE_MANAGER);
     }
 
-    KeAcquireGuardedMutex(&ViewLock);
-    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
-
     if (!Vacb->Dirty)
     {
+        /* The lookup reference becomes the dirty list one */
+        KeAcquireGuardedMutex(&ViewLock);
+        Vacb->Dirty = TRUE;
         InsertTailList(&DirtyVacbListHead, &Vacb->DirtyVacbListEntry);
         DirtyPageCount += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+        KeReleaseGuardedMutex(&ViewLock);
     }
     else
     {
         CcRosVacbDecRefCount(Vacb);
     }
 
-    /* Move to the tail of the LRU list */
-    RemoveEntryList(&Vacb->VacbLruListEntry);
-    InsertTailList(&VacbLruListHead, &Vacb->VacbLruListEntry);
+    Vacb->Accessed = TRUE;
 
-    Vacb->Dirty = TRUE;
-
-    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-    KeReleaseGuardedMutex(&ViewLock);
     CcRosReleaseVacbLock(Vacb);
 
     return STATUS_SUCCESS;
@@ -528,7 +628,6 @@ CcRosUnmapVacb (
 {
     PROS_VACB Vacb;
     BOOLEAN WasDirty;
-    KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
 
@@ -541,34 +640,30 @@ CcRosUnmapVacb (
         return STATUS_UNSUCCESSFUL;
     }
 
-    KeAcquireGuardedMutex(&ViewLock);
-    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
-
     WasDirty = Vacb->Dirty;
-    Vacb->Dirty = Vacb->Dirty || NowDirty;
-
-    Vacb->MappedCount--;
-
     if (!WasDirty && NowDirty)
     {
+        /* The lookup reference becomes the dirty list one */
+        KeAcquireGuardedMutex(&ViewLock);
+        Vacb->Dirty = TRUE;
         InsertTailList(&DirtyVacbListHead, &Vacb->DirtyVacbListEntry);
         DirtyPageCount += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+        KeReleaseGuardedMutex(&ViewLock);
     }
 
-    CcRosVacbDecRefCount(Vacb);
-    if (!WasDirty && NowDirty)
-    {
-        CcRosVacbIncRefCount(Vacb);
-    }
+    Vacb->MappedCount--;
     if (Vacb->MappedCount == 0)
     {
         CcRosVacbDecRefCount(Vacb);
     }
 
-    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-    KeReleaseGuardedMutex(&ViewLock);
     CcRosReleaseVacbLock(Vacb);
 
+    if (WasDirty || !NowDirty)
+    {
+        CcRosVacbDecRefCount(Vacb);
+    }
+
     return STATUS_SUCCESS;
 }
 
@@ -629,6 +724,125 @@ CcRosMapVacb(
     return STATUS_SUCCESS;
 }
 
+static
+NTSTATUS
+CcRosAllocateVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+/*
+ * FUNCTION: Makes sure the index of a shared cache map has a slot for
+ * the view at FileOffset. Must be called at PASSIVE_LEVEL.
+ */
+{
+    PROS_VACB_INDEX_LEAF *NewIndex = NULL;
+    PROS_VACB_INDEX_LEAF *OldIndex = NULL;
+    PROS_VACB_INDEX_LEAF NewLeaf = NULL;
+    ULONG Leaf, Leaves;
+    KIRQL oldIrql;
+
+    Leaf = (ULONG)(((ULONGLONG)FileOffset / VACB_MAPPING_GRANULARITY) >> VACB_INDEX_LEAF_SHIFT);
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+    if (CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset) != NULL)
+    {
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+        return STATUS_SUCCESS;
+    }
+    Leaves = SharedCacheMap->VacbIndexLeaves;
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+
+    /* Size the directory for the whole section, so that it rarely grows */
+    if (Leaf >= Leaves)
+    {
+        Leaves = (ULONG)(((ULONGLONG)SharedCacheMap->SectionSize.QuadPart +
+                          (VACB_MAPPING_GRANULARITY << VACB_INDEX_LEAF_SHIFT) - 1) /
+                         (VACB_MAPPING_GRANULARITY << VACB_INDEX_LEAF_SHIFT));
+        Leaves = max(Leaves, Leaf + 1);
+
+        NewIndex = ExAllocatePoolWithTag(NonPagedPool,
+                                         Leaves * sizeof(PROS_VACB_INDEX_LEAF),
+                                         TAG_VACB);
+        if (NewIndex == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        RtlZeroMemory(NewIndex, Leaves * sizeof(PROS_VACB_INDEX_LEAF));
+    }
+
+    NewLeaf = ExAllocatePoolWithTag(NonPagedPool, sizeof(ROS_VACB_INDEX_LEAF), TAG_VACB);
+    if (NewLeaf == NULL)
+    {
+        if (NewIndex != NULL)
+        {
+            ExFreePoolWithTag(NewIndex, TAG_VACB);
+        }
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    RtlZeroMemory(NewLeaf, sizeof(ROS_VACB_INDEX_LEAF));
+
+    /* Someone else may have done the job in the meantime */
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+    if (NewIndex != NULL && Leaves > SharedCacheMap->VacbIndexLeaves)
+    {
+        if (SharedCacheMap->VacbIndex != NULL)
+        {
+            RtlCopyMemory(NewIndex,
+                          SharedCacheMap->VacbIndex,
+                          SharedCacheMap->VacbIndexLeaves * sizeof(PROS_VACB_INDEX_LEAF));
+        }
+        OldIndex = SharedCacheMap->VacbIndex;
+        SharedCacheMap->VacbIndex = NewIndex;
+        SharedCacheMap->VacbIndexLeaves = Leaves;
+        NewIndex = NULL;
+    }
+    if (Leaf < SharedCacheMap->VacbIndexLeaves && SharedCacheMap->VacbIndex[Leaf] == NULL)
+    {
+        SharedCacheMap->VacbIndex[Leaf] = NewLeaf;
+        NewLeaf = NULL;
+    }
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+
+    if (OldIndex != NULL)
+    {
+        ExFreePoolWithTag(OldIndex, TAG_VACB);
+    }
+    if (NewIndex != NULL)
+    {
+        ExFreePoolWithTag(NewIndex, TAG_VACB);
+    }
+    if (NewLeaf != NULL)
+    {
+        ExFreePoolWithTag(NewLeaf, TAG_VACB);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+CcRosFreeVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap)
+{
+    ULONG i;
+
+    if (SharedCacheMap->VacbIndex == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < SharedCacheMap->VacbIndexLeaves; i++)
+    {
+        if (SharedCacheMap->VacbIndex[i] != NULL)
+        {
+            ExFreePoolWithTag(SharedCacheMap->VacbIndex[i], TAG_VACB);
+        }
+    }
+
+    ExFreePoolWithTag(SharedCacheMap->VacbIndex, TAG_VACB);
+    SharedCacheMap->VacbIndex = NULL;
+    SharedCacheMap->VacbIndexLeaves = 0;
+}
+
 static
 NTSTATUS
 CcRosCreateVacb (
@@ -637,8 +851,7 @@ CcRosCreateVacb (
     PROS_VACB *Vacb)
 {
     PROS_VACB current;
-    PROS_VACB previous;
-    PLIST_ENTRY current_entry;
+    PROS_VACB *Slot;
     NTSTATUS Status;
     KIRQL oldIrql;
 
@@ -652,11 +865,19 @@ CcRosCreateVacb (
         return STATUS_INVALID_PARAMETER;
     }
 
+    Status = CcRosAllocateVacbIndex(SharedCacheMap, FileOffset);
+    if (!NT_SUCCESS(Status))
+    {
+        *Vacb = NULL;
+        return Status;
+    }
+
     current = ExAllocateFromNPagedLookasideList(&VacbLookasideList);
     current->BaseAddress = NULL;
     current->Valid = FALSE;
     current->Dirty = FALSE;
     current->PageOut = FALSE;
+    current->Accessed = FALSE;
     current->FileOffset.QuadPart = ROUND_DOWN(FileOffset, VACB_MAPPING_GRANULARITY);
     current->SharedCacheMap = SharedCacheMap;
 #if DBG
@@ -681,55 +902,33 @@ CcRosCreateVacb (
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosGetVacbIndexSlot(SharedCacheMap, FileOffset);
+    ASSERT(Slot != NULL);
+    if (*Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+        current = *Slot;
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
-#endif
-            CcRosReleaseVacbLock(*Vacb);
-            KeReleaseGuardedMutex(&ViewLock);
-            ExFreeToNPagedLookasideList(&VacbLookasideList, *Vacb);
-            *Vacb = current;
-            CcRosAcquireVacbLock(current, NULL);
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
+        if (SharedCacheMap->Trace)
         {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
         }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+#endif
+        CcRosReleaseVacbLock(*Vacb);
+        KeReleaseGuardedMutex(&ViewLock);
+        ExFreeToNPagedLookasideList(&VacbLookasideList, *Vacb);
+        *Vacb = current;
+        CcRosAcquireVacbLock(current, NULL);
+        return STATUS_SUCCESS;
     }
     /* There was no existing VACB. */
     current = *Vacb;
-    if (previous)
-    {
-        InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
-    }
-    else
-    {
-        InsertHeadList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
-    }
+    *Slot = current;
+    InsertTailList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
     KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
     InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
     KeReleaseGuardedMutex(&ViewLock);
@@ -749,8 +948,12 @@ CcRosCreateVacb (
     Status = CcRosMapVacb(current);
     if (!NT_SUCCESS(Status))
     {
-        RemoveEntryList(&current->CacheMapVacbListEntry);
+        KeAcquireGuardedMutex(&ViewLock);
+        KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+        CcRosRemoveVacbFromIndex(current);
         RemoveEntryList(&current->VacbLruListEntry);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+        KeReleaseGuardedMutex(&ViewLock);
         CcRosReleaseVacbLock(current);
         ExFreeToNPagedLookasideList(&VacbLookasideList, current);
     }
@@ -791,13 +994,9 @@ CcRosGetVacb (
         }
     }
 
-    KeAcquireGuardedMutex(&ViewLock);
-
-    /* Move to the tail of the LRU list */
-    RemoveEntryList(&current->VacbLruListEntry);
-    InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
-
-    KeReleaseGuardedMutex(&ViewLock);
+    /* Let the trimmer know the view is in use, rather than reordering
+     * the global LRU list (and taking ViewLock) on every access */
+    current->Accessed = TRUE;
 
     /*
      * Return information about the VACB to the caller.
@@ -901,7 +1100,6 @@ CcFlushCache (
     LONGLONG RemainingLength;
     PROS_VACB current;
     NTSTATUS Status;
-    KIRQL oldIrql;
 
     CCTRACE(CC_API_DEBUG, "SectionObjectPointers=%p FileOffset=%p Length=%lu\n",
         SectionObjectPointers, FileOffset, Length);
@@ -938,19 +1136,19 @@ CcFlushCache (
                 if (current->Dirty)
                 {
                     Status = CcRosFlushVacb(current);
-                    if (!NT_SUCCESS(Status) && IoStatus != NULL)
+                    if (NT_SUCCESS(Status))
+                    {
+                        CcDataFlushes++;
+                        CcDataPages += VACB_MAPPING_GRANULARITY / PAGE_SIZE;
+                    }
+                    else if (IoStatus != NULL)
                     {
                         IoStatus->Status = Status;
                     }
                 }
 
                 CcRosReleaseVacbLock(current);
-
-                KeAcquireGuardedMutex(&ViewLock);
-                KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
                 CcRosVacbDecRefCount(current);
-                KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-                KeReleaseGuardedMutex(&ViewLock);
             }
 
             Offset.QuadPart += VACB_MAPPING_GRANULARITY;
@@ -1000,8 +1198,9 @@ CcRosDeleteFileCache (
         KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
         while (!IsListEmpty(&SharedCacheMap->CacheMapVacbListHead))
         {
-            current_entry = RemoveTailList(&SharedCacheMap->CacheMapVacbListHead);
+            current_entry = SharedCacheMap->CacheMapVacbListHead.Blink;
             current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
+            CcRosRemoveVacbFromIndex(current);
             RemoveEntryList(&current->VacbLruListEntry);
             if (current->Dirty)
             {
@@ -1017,6 +1216,7 @@ CcRosDeleteFileCache (
         KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
         KeReleaseGuardedMutex(&ViewLock);
+        CcRosDirtyPagesWritten();
         ObDereferenceObject(SharedCacheMap->FileObject);
 
         while (!IsListEmpty(&FreeList))
@@ -1025,6 +1225,7 @@ CcRosDeleteFileCache (
             current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
             CcRosInternalFreeVacb(current);
         }
+        CcRosFreeVacbIndex(SharedCacheMap);
         ExFreeToNPagedLookasideList(&SharedCacheMapLookasideList, SharedCacheMap);
         KeAcquireGuardedMutex(&ViewLock);
     }
@@ -1093,6 +1294,7 @@ CcRosReleaseFileCache (
  */
 {
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
 
     KeAcquireGuardedMutex(&ViewLock);
 
@@ -1101,7 +1303,9 @@ CcRosReleaseFileCache (
         SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
         if (FileObject->PrivateCacheMap != NULL)
         {
+            PrivateCacheMap = FileObject->PrivateCacheMap;
             FileObject->PrivateCacheMap = NULL;
+            CcRosFreePrivateCacheMap(PrivateCacheMap);
             if (SharedCacheMap->OpenCount > 0)
             {
                 SharedCacheMap->OpenCount--;
@@ -1123,8 +1327,16 @@ CcTryToInitializeFileCache (
     PFILE_OBJECT FileObject)
 {
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
     NTSTATUS Status;
 
+    /* Allocate it up front, so that nothing can fail once ViewLock is held */
+    PrivateCacheMap = CcRosAllocatePrivateCacheMap(FileObject);
+    if (PrivateCacheMap == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
     KeAcquireGuardedMutex(&ViewLock);
 
     ASSERT(FileObject->SectionObjectPointer);
@@ -1137,13 +1349,20 @@ CcTryToInitializeFileCache (
     {
         if (FileObject->PrivateCacheMap == NULL)
         {
-            FileObject->PrivateCacheMap = SharedCacheMap;
+            PrivateCacheMap->SharedCacheMap = SharedCacheMap;
+            FileObject->PrivateCacheMap = PrivateCacheMap;
+            PrivateCacheMap = NULL;
             SharedCacheMap->OpenCount++;
         }
         Status = STATUS_SUCCESS;
     }
     KeReleaseGuardedMutex(&ViewLock);
 
+    if (PrivateCacheMap != NULL)
+    {
+        CcRosFreePrivateCacheMap(PrivateCacheMap);
+    }
+
     return Status;
 }
 
@@ -1161,11 +1380,18 @@ CcRosInitializeFileCache (
  */
 {
     PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap;
 
     SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
     DPRINT("CcRosInitializeFileCache(FileObject 0x%p, SharedCacheMap 0x%p)\n",
            FileObject, SharedCacheMap);
 
+    PrivateCacheMap = CcRosAllocatePrivateCacheMap(FileObject);
+    if (PrivateCacheMap == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
     KeAcquireGuardedMutex(&ViewLock);
     if (SharedCacheMap == NULL)
     {
@@ -1173,6 +1399,7 @@ CcRosInitializeFileCache (
         if (SharedCacheMap == NULL)
         {
             KeReleaseGuardedMutex(&ViewLock);
+            CcRosFreePrivateCacheMap(PrivateCacheMap);
             return STATUS_INSUFFICIENT_RESOURCES;
         }
         RtlZeroMemory(SharedCacheMap, sizeof(*SharedCacheMap));
@@ -1192,11 +1419,18 @@ CcRosInitializeFileCache (
     }
     if (FileObject->PrivateCacheMap == NULL)
     {
-        FileObject->PrivateCacheMap = SharedCacheMap;
+        PrivateCacheMap->SharedCacheMap = SharedCacheMap;
+        FileObject->PrivateCacheMap = PrivateCacheMap;
+        PrivateCacheMap = NULL;
         SharedCacheMap->OpenCount++;
     }
     KeReleaseGuardedMutex(&ViewLock);
 
+    if (PrivateCacheMap != NULL)
+    {
+        CcRosFreePrivateCacheMap(PrivateCacheMap);
+    }
+
     return STATUS_SUCCESS;
 }
 
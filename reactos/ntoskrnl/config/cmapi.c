@@ -83,7 +83,6 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
 {
     PLIST_ENTRY NextEntry;
     PCMHIVE Hive;
-    NTSTATUS Status;
     BOOLEAN Result = TRUE;
 
     /* Make sure that the registry isn't read-only now */
@@ -116,11 +115,8 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
             /* Only sync if we are forced to or if it won't cause a hive shrink */
             if ((ForceFlush) || (!HvHiveWillShrink(&Hive->Hive)))
             {
-                /* Do the sync */
-                Status = HvSyncHive(&Hive->Hive);
-
-                /* If something failed - set the flag and continue looping */
-                if (!NT_SUCCESS(Status)) Result = FALSE;
+                /* Do the sync, if something failed - set the flag and continue looping */
+                if (!HvSyncHive(&Hive->Hive)) Result = FALSE;
             }
             else
             {
@@ -557,7 +557,7 @@ INIT_FUNCTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
     {
         L"Session Manager\\Kernel",
         L"DpcQueueDepth",
-        &DummyData,
+        &KiMaximumDpcQueueDepth,
         NULL,
         NULL
     },
@@ -565,7 +565,7 @@ INIT_FUNCTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
     {
         L"Session Manager\\Kernel",
         L"MinimumDpcRate",
-        &DummyData,
+        &KiMinimumDpcRate,
         NULL,
         NULL
     },
@@ -573,7 +573,7 @@ INIT_FUNCTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
     {
         L"Session Manager\\Kernel",
         L"AdjustDpcThreshold",
-        &DummyData,
+        &KiAdjustDpcThreshold,
         NULL,
         NULL
     },
@@ -581,7 +581,15 @@ INIT_FUNCTION CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
     {
         L"Session Manager\\Kernel",
         L"IdealDpcRate",
-        &DummyData,
+        &KiIdealDpcRate,
+        NULL,
+        NULL
+    },
+
+    {
+        L"Session Manager\\Kernel",
+        L"ThreadDpcEnable",
+        &KeThreadDpcEnable,
         NULL,
         NULL
     },
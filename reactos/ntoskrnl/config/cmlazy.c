@@ -35,7 +35,6 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                    _Out_ PBOOLEAN Error,
                    _Out_ PULONG DirtyCount)
 {
-    NTSTATUS Status;
     PLIST_ENTRY NextEntry;
     PCMHIVE CmHive;
     BOOLEAN Result;
@@ -64,28 +63,31 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
             /* Great sucess! */
             Result = TRUE;
 
-            /* One less to flush */
-            HiveCount--;
-
             /* Ignore clean or volatile hives */
             if ((!CmHive->Hive.DirtyCount && !ForceFlush) ||
                 (CmHive->Hive.HiveFlags & HIVE_VOLATILE))
             {
-                /* Don't do anything but do update the count */
+                /*
+                 * Don't do anything but do update the count. Clean hives
+                 * cost nothing, so they don't count against this pass.
+                 */
                 CmHive->FlushCount = CmpLazyFlushCount;
                 DPRINT("Hive %wZ is clean.\n", &CmHive->FileFullPath);
             }
             else
             {
-                /* Do the sync */
-                DPRINT("Flushing: %wZ\n", &CmHive->FileFullPath);
+                /* One less to flush */
+                HiveCount--;
+
+                /* Do the sync, this only writes out the dirty bins */
+                DPRINT("Flushing: %wZ (%lu dirty blocks)\n",
+                       &CmHive->FileFullPath, CmHive->Hive.DirtyCount);
                 DPRINT("Handle: %p\n", CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
-                Status = HvSyncHive(&CmHive->Hive);
-                if(!NT_SUCCESS(Status))
+                if (!HvSyncHive(&CmHive->Hive))
                 {
                     /* Let them know we failed */
-                    DPRINT1("Failed to flush %wZ on handle %p (status 0x%08lx)\n",
-                        &CmHive->FileFullPath,  CmHive->FileHandles[HFILE_TYPE_PRIMARY], Status);
+                    DPRINT1("Failed to flush %wZ on handle %p\n",
+                        &CmHive->FileFullPath,  CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
                     *Error = TRUE;
                     Result = FALSE;
                     break;
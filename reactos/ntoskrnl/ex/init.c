@@ -657,6 +657,9 @@ NTAPI
 INIT_FUNCTION
 ExpInitSystemPhase1(VOID)
 {
+    /* All the processors are started, give them their own pool lookasides */
+    ExpInitProcessorLookasideLists();
+
     /* Initialize worker threads */
     ExpInitializeWorkerThreads();
 
@@ -24,8 +24,12 @@ LIST_ENTRY ExpPagedLookasideListHead;
 KSPIN_LOCK ExpPagedLookasideListLock;
 LIST_ENTRY ExSystemLookasideListHead;
 LIST_ENTRY ExPoolLookasideListHead;
-GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
-GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
+GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+
+/* Depth tuning, done every second by the balance set manager */
+#define MINIMUM_LOOKASIDE_DEPTH     4
+#define LOOKASIDE_ACTIVE_ALLOCATES  75
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
@@ -57,43 +61,61 @@ ExInitializeSystemLookasideList(IN PGENERAL_LOOKASIDE List,
     List->LastAllocateHits = 0;
 }
 
+static
 VOID
-NTAPI
 INIT_FUNCTION
-ExInitPoolLookasidePointers(VOID)
+ExpInitializePoolLookasideLists(IN PGENERAL_LOOKASIDE NonPagedLists,
+                                IN PGENERAL_LOOKASIDE PagedLists)
 {
     ULONG i;
-    PKPRCB Prcb = KeGetCurrentPrcb();
-    PGENERAL_LOOKASIDE Entry;
 
-    /* Loop for all pool lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    /* One list per block size, they show up in SystemLookasideInformation */
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
         /* Initialize the non-paged list */
-        Entry = &ExpSmallNPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
-
-        /* Bind to PRCB */
-        Prcb->PPNPagedLookasideList[i].P = Entry;
-        Prcb->PPNPagedLookasideList[i].L = Entry;
+        ExInitializeSystemLookasideList(&NonPagedLists[i],
+                                        NonPagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
 
         /* Initialize the paged list */
-        Entry = &ExpSmallPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
-
-        /* Bind to PRCB */
-        Prcb->PPPagedLookasideList[i].P = Entry;
-        Prcb->PPPagedLookasideList[i].L = Entry;
+        ExInitializeSystemLookasideList(&PagedLists[i],
+                                        PagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
     }
 }
 
 VOID
 NTAPI
 INIT_FUNCTION
-ExpInitLookasideLists(VOID)
+ExInitPoolLookasidePointers(VOID)
 {
     ULONG i;
+    PKPRCB Prcb = KeGetCurrentPrcb();
+
+    /*
+     * Bind the global lists to PRCB, the processors get their own ones
+     * once they have all been started, see ExpInitProcessorLookasideLists
+     */
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+    {
+        Prcb->PPNPagedLookasideList[i].P = &ExpSmallNPagedPoolLookasideLists[i];
+        Prcb->PPNPagedLookasideList[i].L = &ExpSmallNPagedPoolLookasideLists[i];
+        Prcb->PPPagedLookasideList[i].P = &ExpSmallPagedPoolLookasideLists[i];
+        Prcb->PPPagedLookasideList[i].L = &ExpSmallPagedPoolLookasideLists[i];
+    }
+}
 
+VOID
+NTAPI
+INIT_FUNCTION
+ExpInitLookasideLists(VOID)
+{
     /* Initialize locks and lists */
     InitializeListHead(&ExpNonPagedLookasideListHead);
     InitializeListHead(&ExpPagedLookasideListHead);
@@ -103,28 +125,144 @@ ExpInitLookasideLists(VOID)
     KeInitializeSpinLock(&ExpPagedLookasideListLock);
 
     /* Initialize the system lookaside lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    ExpInitializePoolLookasideLists(ExpSmallNPagedPoolLookasideLists,
+                                    ExpSmallPagedPoolLookasideLists);
+}
+
+VOID
+NTAPI
+INIT_FUNCTION
+ExpInitProcessorLookasideLists(VOID)
+{
+    PGENERAL_LOOKASIDE CurrentList;
+    PKPRCB Prcb;
+    ULONG i, j;
+
+    /* Allocate the lists of all processors at once */
+    CurrentList = ExAllocatePoolWithTag(NonPagedPool,
+                                        2 * NUMBER_POOL_LOOKASIDE_LISTS *
+                                        KeNumberProcessors *
+                                        sizeof(GENERAL_LOOKASIDE),
+                                        'looP');
+    if (!CurrentList)
     {
-        /* Initialize the non-paged list */
-        ExInitializeSystemLookasideList(&ExpSmallNPagedPoolLookasideLists[i],
-                                        NonPagedPool,
-                                        (i + 1) * 8,
-                                        'looP',
-                                        256,
-                                        &ExPoolLookasideListHead);
+        /* Keep sharing the global lists then */
+        DPRINT1("No per-processor pool lookaside lists\n");
+        return;
+    }
 
-        /* Initialize the paged list */
-        ExInitializeSystemLookasideList(&ExpSmallPagedPoolLookasideLists[i],
-                                        PagedPool,
-                                        (i + 1) * 8,
-                                        'looP',
-                                        256,
-                                        &ExPoolLookasideListHead);
+    /* Loop all processors */
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        /* Get the PRCB for this CPU */
+        Prcb = KiProcessorBlock[i];
+        ExpInitializePoolLookasideLists(CurrentList,
+                                        CurrentList + NUMBER_POOL_LOOKASIDE_LISTS);
+
+        /* Free blocks go there first, then to the global lists */
+        for (j = 0; j < NUMBER_POOL_LOOKASIDE_LISTS; j++)
+        {
+            Prcb->PPNPagedLookasideList[j].P = &CurrentList[j];
+            Prcb->PPPagedLookasideList[j].P = &CurrentList[NUMBER_POOL_LOOKASIDE_LISTS + j];
+        }
+
+        CurrentList += 2 * NUMBER_POOL_LOOKASIDE_LISTS;
+    }
+}
+
+static
+USHORT
+ExpComputeLookasideDepth(IN ULONG Allocates,
+                         IN ULONG Misses,
+                         IN USHORT Depth,
+                         IN USHORT MaximumDepth)
+{
+    ULONG MissRatio, Change;
+
+    /* Shrink the lists that are barely used, their entries are wasted */
+    if (Allocates < LOOKASIDE_ACTIVE_ALLOCATES)
+    {
+        return (USHORT)max(Depth - 10, MINIMUM_LOOKASIDE_DEPTH);
+    }
+
+    /* Misses per thousand allocations */
+    MissRatio = (ULONG)(((ULONGLONG)Misses * 1000) / Allocates);
+    if (MissRatio < 5)
+    {
+        /* Almost always hits, it can do with a bit less */
+        return (USHORT)max(Depth - 1, MINIMUM_LOOKASIDE_DEPTH);
+    }
+
+    /* Grow it by the share of the room left that was missed */
+    Change = ((MissRatio - 5) * (MaximumDepth - min(Depth, MaximumDepth))) / 2000 + 5;
+    return (USHORT)min(Depth + Change, MaximumDepth);
+}
+
+static
+VOID
+ExpScanLookasideList(IN PLIST_ENTRY ListHead,
+                     IN BOOLEAN ListUsesMisses)
+{
+    PGENERAL_LOOKASIDE Lookaside;
+    PLIST_ENTRY ListEntry;
+    ULONG Allocates, Misses, Hits;
+
+    for (ListEntry = ListHead->Flink;
+         ListEntry != ListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Lookaside = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
+
+        /* Get what happened since the last scan */
+        Allocates = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates;
+        Lookaside->LastTotalAllocates = Lookaside->TotalAllocates;
+
+        /* The pool lists count hits, the others misses */
+        if (ListUsesMisses)
+        {
+            Misses = Lookaside->AllocateMisses - Lookaside->LastAllocateMisses;
+            Lookaside->LastAllocateMisses = Lookaside->AllocateMisses;
+        }
+        else
+        {
+            Hits = Lookaside->AllocateHits - Lookaside->LastAllocateHits;
+            Lookaside->LastAllocateHits = Lookaside->AllocateHits;
+
+            /* The counters aren't synchronized, don't go negative */
+            Misses = (Hits < Allocates) ? Allocates - Hits : 0;
+        }
+
+        Lookaside->Depth = ExpComputeLookasideDepth(Allocates,
+                                                    min(Misses, Allocates),
+                                                    Lookaside->Depth,
+                                                    Lookaside->MaximumDepth);
     }
 }
 
 /* PUBLIC FUNCTIONS **********************************************************/
 
+/*
+ * @implemented
+ */
+VOID
+ExAdjustLookasideDepth(VOID)
+{
+    KIRQL OldIrql;
+
+    /* The pool and system lists never go away */
+    ExpScanLookasideList(&ExPoolLookasideListHead, FALSE);
+    ExpScanLookasideList(&ExSystemLookasideListHead, TRUE);
+
+    /* The driver lists can, scan them under their lock */
+    KeAcquireSpinLock(&ExpNonPagedLookasideListLock, &OldIrql);
+    ExpScanLookasideList(&ExpNonPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpNonPagedLookasideListLock, OldIrql);
+
+    KeAcquireSpinLock(&ExpPagedLookasideListLock, &OldIrql);
+    ExpScanLookasideList(&ExpPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpPagedLookasideListLock, OldIrql);
+}
+
 /*
  * @implemented
  */
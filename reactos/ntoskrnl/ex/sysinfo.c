@@ -594,6 +594,7 @@ QSI_DEF(SystemProcessorInformation)
 /* Class 2 - Performance Information */
 QSI_DEF(SystemPerformanceInformation)
 {
+    LONG i;
     ULONG IdleUser, IdleKernel;
     PSYSTEM_PERFORMANCE_INFORMATION Spi
         = (PSYSTEM_PERFORMANCE_INFORMATION) Buffer;
@@ -636,17 +637,25 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->CommitLimit = MmNumberOfPhysicalPages + MiFreeSwapPages + MiUsedSwapPages;
 
     Spi->PeakCommitment = 0; /* FIXME */
-    Spi->PageFaultCount = 0; /* FIXME */
-    Spi->CopyOnWriteCount = 0; /* FIXME */
-    Spi->TransitionCount = 0; /* FIXME */
-    Spi->CacheTransitionCount = 0; /* FIXME */
-    Spi->DemandZeroCount = 0; /* FIXME */
-    Spi->PageReadCount = 0; /* FIXME */
-    Spi->PageReadIoCount = 0; /* FIXME */
+    Spi->PageFaultCount = 0;
+    Spi->CopyOnWriteCount = 0;
+    Spi->TransitionCount = 0;
+    Spi->CacheTransitionCount = 0;
+    Spi->DemandZeroCount = 0;
+    for (i = 0; i < KeNumberProcessors; i++)
+    {
+        Spi->PageFaultCount += KiProcessorBlock[i]->MmPageFaultCount;
+        Spi->CopyOnWriteCount += KiProcessorBlock[i]->MmCopyOnWriteCount;
+        Spi->TransitionCount += KiProcessorBlock[i]->MmTransitionCount;
+        Spi->CacheTransitionCount += KiProcessorBlock[i]->MmCacheTransitionCount;
+        Spi->DemandZeroCount += KiProcessorBlock[i]->MmDemandZeroCount;
+    }
+    Spi->PageReadCount = MiPageFileReadCount;
+    Spi->PageReadIoCount = MiPageFileReadIoCount;
     Spi->CacheReadCount = 0; /* FIXME */
     Spi->CacheIoCount = 0; /* FIXME */
-    Spi->DirtyPagesWriteCount = 0; /* FIXME */
-    Spi->DirtyWriteIoCount = 0; /* FIXME */
+    Spi->DirtyPagesWriteCount = MiPageFileWriteCount;
+    Spi->DirtyWriteIoCount = MiPageFileWriteIoCount;
     Spi->MappedPagesWriteCount = 0; /* FIXME */
     Spi->MappedWriteIoCount = 0; /* FIXME */
 
@@ -706,15 +715,34 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->CcMdlReadWait = 0; /* FIXME */
     Spi->CcMdlReadNoWaitMiss = 0; /* FIXME */
     Spi->CcMdlReadWaitMiss = 0; /* FIXME */
-    Spi->CcReadAheadIos = 0; /* FIXME */
-    Spi->CcLazyWriteIos = 0; /* FIXME */
-    Spi->CcLazyWritePages = 0; /* FIXME */
-    Spi->CcDataFlushes = 0; /* FIXME */
-    Spi->CcDataPages = 0; /* FIXME */
-    Spi->ContextSwitches = 0; /* FIXME */
+    Spi->CcReadAheadIos = CcReadAheadIos;
+    Spi->CcLazyWriteIos = CcLazyWriteIos;
+    Spi->CcLazyWritePages = CcLazyWritePages;
+    Spi->CcDataFlushes = CcDataFlushes;
+    Spi->CcDataPages = CcDataPages;
+    Spi->ContextSwitches = 0;
+    Spi->SystemCalls = 0;
+    for (i = 0; i < KeNumberProcessors; i++)
+    {
+        Spi->ContextSwitches += KeGetContextSwitches(KiProcessorBlock[i]);
+        Spi->SystemCalls += KiProcessorBlock[i]->KeSystemCalls;
+    }
     Spi->FirstLevelTbFills = 0; /* FIXME */
     Spi->SecondLevelTbFills = 0; /* FIXME */
-    Spi->SystemCalls = 0; /* FIXME */
+
+    /* Newer callers also get the dirty page counts, following SystemCalls:
+     * CcTotalDirtyPages, CcDirtyPageThreshold, ResidentAvailablePages and
+     * SharedCommittedPages */
+    if (Size >= sizeof(SYSTEM_PERFORMANCE_INFORMATION) + 4 * sizeof(ULONGLONG))
+    {
+        PULONGLONG Extended = (PULONGLONG)(Spi + 1);
+
+        Extended[0] = DirtyPageCount;
+        Extended[1] = CcDirtyPageThreshold;
+        Extended[2] = MmResidentAvailablePages;
+        Extended[3] = 0; /* FIXME */
+        *ReqSize += 4 * sizeof(ULONGLONG);
+    }
 
     return STATUS_SUCCESS;
 }
@@ -1423,7 +1451,8 @@ QSI_DEF(SystemInterruptInformation)
     {
         Prcb = KiProcessorBlock[i];
         sii->ContextSwitches = KeGetContextSwitches(Prcb);
-        sii->DpcCount = Prcb->DpcData[0].DpcCount;
+        sii->DpcCount = Prcb->DpcData[DPC_NORMAL].DpcCount +
+                        Prcb->DpcData[DPC_THREADED].DpcCount;
         sii->DpcRate = Prcb->DpcRequestRate;
         sii->TimeIncrement = ti;
         sii->DpcBypassCount = 0;
@@ -1437,16 +1466,56 @@ QSI_DEF(SystemInterruptInformation)
 /* Class 24 - DPC Behaviour Information */
 QSI_DEF(SystemDpcBehaviourInformation)
 {
-    /* FIXME */
-    DPRINT1("NtQuerySystemInformation - SystemDpcBehaviourInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PSYSTEM_DPC_BEHAVIOR_INFORMATION sdbi = (PSYSTEM_DPC_BEHAVIOR_INFORMATION)Buffer;
+    PKPRCB Prcb;
+    ULONG QueueDepth = 0;
+    LONG i;
+
+    *ReqSize = sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION);
+
+    if (Size != sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* ReactOS uses the spare field for the DPCs queued right now on all processors */
+    for (i = 0; i < KeNumberProcessors; i++)
+    {
+        Prcb = KiProcessorBlock[i];
+        QueueDepth += Prcb->DpcData[DPC_NORMAL].DpcQueueDepth +
+                      Prcb->DpcData[DPC_THREADED].DpcQueueDepth;
+    }
+
+    sdbi->Spare = QueueDepth;
+    sdbi->DpcQueueDepth = KiMaximumDpcQueueDepth;
+    sdbi->MinimumDpcRate = KiMinimumDpcRate;
+    sdbi->AdjustDpcThreshold = KiAdjustDpcThreshold;
+    sdbi->IdealDpcRate = KiIdealDpcRate;
+
+    return STATUS_SUCCESS;
 }
 
 SSI_DEF(SystemDpcBehaviourInformation)
 {
-    /* FIXME */
-    DPRINT1("NtSetSystemInformation - SystemDpcBehaviourInformation not implemented\n");
-    return STATUS_NOT_IMPLEMENTED;
+    PSYSTEM_DPC_BEHAVIOR_INFORMATION sdbi = (PSYSTEM_DPC_BEHAVIOR_INFORMATION)Buffer;
+
+    if (Size != sizeof(SYSTEM_DPC_BEHAVIOR_INFORMATION))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    if (!SeSinglePrivilegeCheck(SeLoadDriverPrivilege, ExGetPreviousMode()))
+    {
+        return STATUS_PRIVILEGE_NOT_HELD;
+    }
+
+    /* The clock interrupt picks up the new values on its next adjustment */
+    KiMaximumDpcQueueDepth = max(sdbi->DpcQueueDepth, 1);
+    KiMinimumDpcRate = sdbi->MinimumDpcRate;
+    KiAdjustDpcThreshold = max(sdbi->AdjustDpcThreshold, 1);
+    KiIdealDpcRate = sdbi->IdealDpcRate;
+
+    return STATUS_SUCCESS;
 }
 
 /* Class 25 - Full Memory Information */
@@ -2373,6 +2442,38 @@ QSI_DEF(SystemNumaAvailableMemory)
 }
 
 
+/* Class 80 - Memory List Information */
+QSI_DEF(SystemMemoryListInformation)
+{
+    PSYSTEM_MEMORY_LIST_INFORMATION Mli = (PSYSTEM_MEMORY_LIST_INFORMATION)Buffer;
+    ULONG i;
+
+    *ReqSize = sizeof(SYSTEM_MEMORY_LIST_INFORMATION);
+
+    /* Check user buffer's size */
+    if (Size < sizeof(SYSTEM_MEMORY_LIST_INFORMATION))
+    {
+        return STATUS_INFO_LENGTH_MISMATCH;
+    }
+
+    /* Only a snapshot, no need for the PFN lock */
+    Mli->ZeroPageCount = MmZeroedPageListHead.Total;
+    Mli->FreePageCount = MmFreePageListHead.Total;
+    Mli->ModifiedPageCount = MmModifiedPageListHead.Total;
+    Mli->ModifiedNoWritePageCount = MmModifiedNoWritePageListHead.Total;
+    Mli->BadPageCount = MmBadPageListHead.Total;
+    for (i = 0; i < RTL_NUMBER_OF(Mli->PageCountByPriority); i++)
+    {
+        Mli->PageCountByPriority[i] = MmStandbyPageListByPriority[i].Total;
+
+        /* Pages are only ever taken from the free and zeroed lists, never repurposed from standby */
+        Mli->RepurposedPagesByPriority[i] = 0;
+    }
+    Mli->ModifiedPageCountPageFile = MmTotalPagesForPagingFile;
+
+    return STATUS_SUCCESS;
+}
+
 /* Query/Set Calls Table */
 typedef
 struct _QSSI_CALLS
@@ -2455,10 +2556,31 @@ CallQS [] =
     SI_QX(SystemExtendedProcessInformation),
     SI_QX(SystemRecommendedSharedDataAlignment),
     SI_XX(SystemComPlusPackage),
-    SI_QX(SystemNumaAvailableMemory)
+    SI_QX(SystemNumaAvailableMemory),
+    SI_XX(SystemProcessorPowerInformation),
+    SI_XX(SystemEmulationBasicInformation),
+    SI_XX(SystemEmulationProcessorInformation),
+    SI_XX(SystemExtendedHandleInformation),
+    SI_XX(SystemLostDelayedWriteInformation),
+    SI_XX(SystemBigPoolInformation),
+    SI_XX(SystemSessionPoolTagInformation),
+    SI_XX(SystemSessionMappedViewInformation),
+    SI_XX(SystemHotpatchInformation),
+    SI_XX(SystemObjectSecurityMode),
+    SI_XX(SystemWatchDogTimerHandler),
+    SI_XX(SystemWatchDogTimerInformation),
+    SI_XX(SystemLogicalProcessorInformation),
+    SI_XX(SystemWow64SharedInformationObsolete),
+    SI_XX(SystemRegisterFirmwareTableInformationHandler),
+    SI_XX(SystemFirmwareTableInformation),
+    SI_XX(SystemModuleInformationEx),
+    SI_XX(SystemVerifierTriageInformation),
+    SI_XX(SystemSuperfetchInformation),
+    SI_QX(SystemMemoryListInformation)
 };
 
 C_ASSERT(SystemBasicInformation == 0);
+C_ASSERT(sizeof(CallQS) / sizeof(CallQS[0]) == SystemMemoryListInformation + 1);
 #define MIN_SYSTEM_INFO_CLASS (SystemBasicInformation)
 #define MAX_SYSTEM_INFO_CLASS (sizeof(CallQS) / sizeof(CallQS[0]))
 
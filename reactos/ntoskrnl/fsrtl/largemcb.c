@@ -512,9 +512,40 @@ FsRtlLookupBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     BOOLEAN Result = FALSE;
     ULONG i;
     LONGLONG LastVbn = 0, LastLbn = 0, Count = 0;   // the last values we've found during traversal
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    LARGE_MCB_MAPPING_ENTRY NeedleRun;
+    PLARGE_MCB_MAPPING_ENTRY Run;
 
     DPRINT("FsRtlLookupBaseMcbEntry(%p, %I64d, %p, %p, %p, %p, %p)\n", OpaqueMcb, Vbn, Lbn, SectorCountFromLbn, StartingLbn, SectorCountFromStartingLbn, Index);
 
+    /* Most lookups hit a mapped run and don't care about its index:
+     * find it in the tree rather than walking all the runs before it */
+    if (!Index)
+    {
+        NeedleRun.RunStartVbn.QuadPart = Vbn;
+        NeedleRun.RunEndVbn.QuadPart = Vbn + 1;
+        NeedleRun.StartingLbn.QuadPart = ~0ULL;
+        Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
+        Run = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun);
+        Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
+
+        if (Run)
+        {
+            if (Lbn)
+                *Lbn = Run->StartingLbn.QuadPart + (Vbn - Run->RunStartVbn.QuadPart);
+            if (SectorCountFromLbn)
+                *SectorCountFromLbn = Run->RunEndVbn.QuadPart - Vbn;
+            if (StartingLbn)
+                *StartingLbn = Run->StartingLbn.QuadPart;
+            if (SectorCountFromStartingLbn)
+                *SectorCountFromStartingLbn = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+
+            Result = TRUE;
+            goto quit;
+        }
+    }
+
+    /* Holes aren't stored, they have to be found by walking the runs */
     for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &LastVbn, &LastLbn, &Count); i++)
     {
         // have we reached the target mapping?
@@ -40,6 +40,13 @@
 // Global Cc Data
 //
 extern ULONG CcRosTraceLevel;
+extern ULONG DirtyPageCount;
+extern ULONG CcDirtyPageThreshold;
+extern ULONG CcReadAheadIos;
+extern ULONG CcLazyWriteIos;
+extern ULONG CcLazyWritePages;
+extern ULONG CcDataFlushes;
+extern ULONG CcDataPages;
 
 typedef struct _PF_SCENARIO_ID
 {
@@ -142,9 +149,30 @@ typedef struct _PFSN_PREFETCHER_GLOBALS
     LONG ActivePrefetches;
 } PFSN_PREFETCHER_GLOBALS, *PPFSN_PREFETCHER_GLOBALS;
 
+/* Maximum number of adjacent dirty views written with a single I/O */
+#define CC_LAZY_WRITE_CLUSTER   4
+
+/*
+ * The VACBs of a shared cache map are indexed by view number, that is
+ * FileOffset / VACB_MAPPING_GRANULARITY. The index is a directory of
+ * leaves, each one covering VACB_INDEX_LEAF_SIZE consecutive views, and
+ * leaves are only allocated for the parts of the file that get mapped.
+ */
+#define VACB_INDEX_LEAF_SHIFT   7
+#define VACB_INDEX_LEAF_SIZE    (1 << VACB_INDEX_LEAF_SHIFT)
+
+typedef struct _ROS_VACB_INDEX_LEAF
+{
+    struct _ROS_VACB *Vacbs[VACB_INDEX_LEAF_SIZE];
+} ROS_VACB_INDEX_LEAF, *PROS_VACB_INDEX_LEAF;
+
 typedef struct _ROS_SHARED_CACHE_MAP
 {
+    /* All the VACBs of this cache map, in no particular order. */
     LIST_ENTRY CacheMapVacbListHead;
+    /* Index of the VACBs by view number, protected by CacheMapLock. */
+    PROS_VACB_INDEX_LEAF *VacbIndex;
+    ULONG VacbIndexLeaves;
     ULONG TimeStamp;
     PFILE_OBJECT FileObject;
     LARGE_INTEGER SectionSize;
@@ -154,11 +182,49 @@ typedef struct _ROS_SHARED_CACHE_MAP
     PVOID LazyWriteContext;
     KSPIN_LOCK CacheMapLock;
     ULONG OpenCount;
+    /* Set through CcSetAdditionalCacheAttributes */
+    BOOLEAN ReadAheadDisabled;
 #if DBG
     BOOLEAN Trace; /* enable extra trace output for this cache map and it's VACBs */
 #endif
 } ROS_SHARED_CACHE_MAP, *PROS_SHARED_CACHE_MAP;
 
+typedef struct _ROS_PRIVATE_CACHE_MAP
+{
+    PFILE_OBJECT FileObject;
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    /* Read ahead granularity - 1, see CcSetReadAheadGranularity */
+    ULONG ReadAheadMask;
+    /* The last two reads, used to detect sequential access. */
+    LARGE_INTEGER FileOffset1;
+    LARGE_INTEGER BeyondLastByte1;
+    LARGE_INTEGER FileOffset2;
+    LARGE_INTEGER BeyondLastByte2;
+    /* Read ahead has been scheduled up to this offset. */
+    LARGE_INTEGER ReadAheadEnd;
+    /* The read ahead to perform, once queued. */
+    LARGE_INTEGER ReadAheadOffset;
+    ULONG ReadAheadLength;
+    /* The following are protected by the read ahead queue lock. */
+    BOOLEAN ReadAheadActive;
+    BOOLEAN Closed;
+    LIST_ENTRY ReadAheadLinks;
+    KSPIN_LOCK ReadAheadSpinLock;
+} ROS_PRIVATE_CACHE_MAP, *PROS_PRIVATE_CACHE_MAP;
+
+/* A write waiting for the dirty page count to go down, see CcDeferWrite */
+typedef struct _ROS_DEFERRED_WRITE
+{
+    LIST_ENTRY DeferredWriteLinks;
+    PFILE_OBJECT FileObject;
+    ULONG BytesToWrite;
+    /* Set for the CcCanIWrite callers, who wait on it */
+    PKEVENT Event;
+    PCC_POST_DEFERRED_WRITE PostRoutine;
+    PVOID Context1;
+    PVOID Context2;
+} ROS_DEFERRED_WRITE, *PROS_DEFERRED_WRITE;
+
 typedef struct _ROS_VACB
 {
     /* Base address of the region where the view's data is mapped. */
@@ -171,6 +237,8 @@ typedef struct _ROS_VACB
     BOOLEAN Dirty;
     /* Page out in progress */
     BOOLEAN PageOut;
+    /* Was the view used since the last trim pass. */
+    BOOLEAN Accessed;
     ULONG MappedCount;
     /* Entry in the list of VACBs for this shared cache map. */
     LIST_ENTRY CacheMapVacbListEntry;
@@ -182,7 +250,7 @@ typedef struct _ROS_VACB
     LARGE_INTEGER FileOffset;
     /* Mutex */
     KMUTEX Mutex;
-    /* Number of references. */
+    /* Number of references, only updated with interlocked operations. */
     ULONG ReferenceCount;
     /* How many times was it pinned? */
     _Guarded_by_(Mutex)
@@ -251,10 +319,37 @@ NTSTATUS
 NTAPI
 CcWriteVirtualAddress(PROS_VACB Vacb);
 
+NTSTATUS
+NTAPI
+CcWriteVacbCluster(
+    PROS_VACB *Vacbs,
+    ULONG VacbCount
+);
+
 BOOLEAN
 NTAPI
 CcInitializeCacheManager(VOID);
 
+BOOLEAN
+NTAPI
+CcInitializeLazyWriter(VOID);
+
+VOID
+NTAPI
+CcRosDirtyPagesWritten(VOID);
+
+PROS_PRIVATE_CACHE_MAP
+NTAPI
+CcRosAllocatePrivateCacheMap(
+    PFILE_OBJECT FileObject
+);
+
+VOID
+NTAPI
+CcRosFreePrivateCacheMap(
+    PROS_PRIVATE_CACHE_MAP PrivateCacheMap
+);
+
 NTSTATUS
 NTAPI
 CcRosUnmapVacb(
@@ -388,3 +483,36 @@ IsPointInRange(
 {
     return DoRangesIntersect(Offset1, Length1, Point, 1);
 }
+
+/* Must be called with the CacheMapLock held */
+FORCEINLINE
+PROS_VACB *
+CcRosGetVacbIndexSlot(
+    _In_ PROS_SHARED_CACHE_MAP SharedCacheMap,
+    _In_ LONGLONG FileOffset)
+{
+    ULONGLONG View = (ULONGLONG)FileOffset / VACB_MAPPING_GRANULARITY;
+    ULONGLONG Leaf = View >> VACB_INDEX_LEAF_SHIFT;
+
+    if (Leaf >= SharedCacheMap->VacbIndexLeaves ||
+        SharedCacheMap->VacbIndex[Leaf] == NULL)
+    {
+        return NULL;
+    }
+
+    return &SharedCacheMap->VacbIndex[Leaf]->Vacbs[View & (VACB_INDEX_LEAF_SIZE - 1)];
+}
+
+/* Must be called with the CacheMapLock held */
+FORCEINLINE
+VOID
+CcRosRemoveVacbFromIndex(
+    _In_ PROS_VACB Vacb)
+{
+    PROS_VACB *Slot;
+
+    Slot = CcRosGetVacbIndexSlot(Vacb->SharedCacheMap, Vacb->FileOffset.QuadPart);
+    ASSERT(Slot != NULL && *Slot == Vacb);
+    *Slot = NULL;
+    RemoveEntryList(&Vacb->CacheMapVacbListEntry);
+}
@@ -257,6 +257,10 @@ VOID
 NTAPI
 ExInitPoolLookasidePointers(VOID);
 
+VOID
+NTAPI
+ExpInitProcessorLookasideLists(VOID);
+
 /* Callback Functions ********************************************************/
 
 VOID
@@ -108,7 +108,7 @@ extern ULONG KiMaximumDpcQueueDepth;
 extern ULONG KiMinimumDpcRate;
 extern ULONG KiAdjustDpcThreshold;
 extern ULONG KiIdealDpcRate;
-extern BOOLEAN KeThreadDpcEnable;
+extern ULONG KeThreadDpcEnable;
 extern LARGE_INTEGER KiTimeIncrementReciprocal;
 extern UCHAR KiTimeIncrementShiftCount;
 extern ULONG KiTimeLimitIsrMicroseconds;
@@ -991,6 +991,12 @@ KiSaveProcessorState(
     IN PKEXCEPTION_FRAME ExceptionFrame
 );
 
+VOID
+NTAPI
+KiExecuteDpc(
+    IN PVOID Context
+);
+
 VOID
 FASTCALL
 KiRetireDpcList(
@@ -9,6 +9,10 @@ struct _EPROCESS;
 extern PMMSUPPORT MmKernelAddressSpace;
 extern PFN_COUNT MiFreeSwapPages;
 extern PFN_COUNT MiUsedSwapPages;
+extern ULONG MiPageFileReadCount;
+extern ULONG MiPageFileReadIoCount;
+extern ULONG MiPageFileWriteCount;
+extern ULONG MiPageFileWriteIoCount;
 extern PFN_COUNT MmNumberOfPhysicalPages;
 extern UCHAR MmDisablePagingExecutive;
 extern PFN_NUMBER MmLowestPhysicalPage;
@@ -379,6 +383,9 @@ extern MMPFNLIST MmFreePageListHead;
 extern MMPFNLIST MmStandbyPageListHead;
 extern MMPFNLIST MmModifiedPageListHead;
 extern MMPFNLIST MmModifiedNoWritePageListHead;
+extern MMPFNLIST MmBadPageListHead;
+extern MMPFNLIST MmStandbyPageListByPriority[8];
+extern ULONG MmTotalPagesForPagingFile;
 
 typedef struct _MM_MEMORY_CONSUMER
 {
@@ -630,6 +637,10 @@ MmWriteToSwapPage(
     PFN_NUMBER Page
 );
 
+VOID
+NTAPI
+MmFlushSwapPages(VOID);
+
 VOID
 NTAPI
 MmShowOutOfSpaceMessagePagingFile(VOID);
@@ -1017,6 +1017,290 @@ IopGetFileMode(IN PFILE_OBJECT FileObject)
     return Mode;
 }
 
+static
+NTSTATUS
+IopReadWriteSegments(IN HANDLE FileHandle,
+                     IN HANDLE Event OPTIONAL,
+                     IN PIO_APC_ROUTINE ApcRoutine OPTIONAL,
+                     IN PVOID ApcContext OPTIONAL,
+                     OUT PIO_STATUS_BLOCK IoStatusBlock,
+                     IN FILE_SEGMENT_ELEMENT SegmentArray[],
+                     IN ULONG Length,
+                     IN PLARGE_INTEGER ByteOffset OPTIONAL,
+                     IN PULONG Key OPTIONAL,
+                     IN BOOLEAN Write)
+{
+    NTSTATUS Status;
+    PFILE_OBJECT FileObject;
+    PIRP Irp;
+    PDEVICE_OBJECT DeviceObject;
+    PIO_STACK_LOCATION StackPtr;
+    KPROCESSOR_MODE PreviousMode = KeGetPreviousMode();
+    PKEVENT EventObject = NULL;
+    LARGE_INTEGER CapturedByteOffset;
+    ULONG CapturedKey = 0;
+    BOOLEAN Synchronous = FALSE;
+    PFILE_SEGMENT_ELEMENT Segments = NULL;
+    ULONG PageCount, SectorSize, i;
+    OBJECT_HANDLE_INFORMATION ObjectHandleInfo;
+    ACCESS_MASK RequiredAccess;
+    PMDL Mdl;
+
+    PAGED_CODE();
+    CapturedByteOffset.QuadPart = 0;
+    IOTRACE(IO_API_DEBUG, "FileHandle: %p\n", FileHandle);
+
+    /* Each segment describes one page of the transfer */
+    PageCount = BYTES_TO_PAGES(Length);
+
+    /* Get File Object */
+    Status = ObReferenceObjectByHandle(FileHandle,
+                                       0,
+                                       IoFileObjectType,
+                                       PreviousMode,
+                                       (PVOID*)&FileObject,
+                                       &ObjectHandleInfo);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    /* Check the handle was opened for this kind of transfer */
+    RequiredAccess = Write ? FILE_WRITE_DATA : FILE_READ_DATA;
+    if ((PreviousMode != KernelMode) &&
+        !(ObjectHandleInfo.GrantedAccess & RequiredAccess))
+    {
+        ObDereferenceObject(FileObject);
+        return STATUS_ACCESS_DENIED;
+    }
+
+    /* The pages go straight to the device, there is no cache to go through */
+    DeviceObject = IoGetRelatedDeviceObject(FileObject);
+    SectorSize = DeviceObject->SectorSize;
+    if (!(FileObject->Flags & FO_NO_INTERMEDIATE_BUFFERING) ||
+        (DeviceObject->Flags & DO_BUFFERED_IO) ||
+        (SectorSize && (Length & (SectorSize - 1))))
+    {
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Keep our own copy of the segments, we validate them */
+    if (PageCount)
+    {
+        Segments = ExAllocatePoolWithTag(PagedPool,
+                                         PageCount * sizeof(FILE_SEGMENT_ELEMENT),
+                                         TAG_IO);
+        if (!Segments)
+        {
+            ObDereferenceObject(FileObject);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    /* Validate User-Mode Buffers */
+    _SEH2_TRY
+    {
+        if (PreviousMode != KernelMode)
+        {
+            /* Probe the status block and the segment array */
+            ProbeForWriteIoStatusBlock(IoStatusBlock);
+            ProbeForRead(SegmentArray,
+                         PageCount * sizeof(FILE_SEGMENT_ELEMENT),
+                         sizeof(ULONG));
+
+            /* Capture and probe the byte offset and the key */
+            if (ByteOffset) CapturedByteOffset = ProbeForReadLargeInteger(ByteOffset);
+            if (Key) CapturedKey = ProbeForReadUlong(Key);
+        }
+        else
+        {
+            /* Kernel mode: capture directly */
+            if (ByteOffset) CapturedByteOffset = *ByteOffset;
+            if (Key) CapturedKey = *Key;
+        }
+
+        if (PageCount)
+        {
+            RtlCopyMemory(Segments,
+                          SegmentArray,
+                          PageCount * sizeof(FILE_SEGMENT_ELEMENT));
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        /* Get the exception code */
+        Status = _SEH2_GetExceptionCode();
+    }
+    _SEH2_END;
+
+    /* Every segment must be a whole page we can address */
+    for (i = 0; NT_SUCCESS(Status) && (i < PageCount); i++)
+    {
+        if ((Segments[i].Alignment & (PAGE_SIZE - 1)) ||
+            (Segments[i].Alignment != (ULONG_PTR)Segments[i].Alignment))
+        {
+            Status = STATUS_DATATYPE_MISALIGNMENT;
+        }
+    }
+
+    /* So is the offset, when the caller gave one */
+    if (NT_SUCCESS(Status) && ByteOffset && SectorSize &&
+        (CapturedByteOffset.u.LowPart & (SectorSize - 1)) &&
+        !((CapturedByteOffset.u.LowPart == FILE_USE_FILE_POINTER_POSITION) &&
+          (CapturedByteOffset.u.HighPart == -1)))
+    {
+        Status = STATUS_INVALID_PARAMETER;
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        if (Segments) ExFreePoolWithTag(Segments, TAG_IO);
+        ObDereferenceObject(FileObject);
+        return Status;
+    }
+
+    /* Check for event */
+    if (Event)
+    {
+        /* Reference it */
+        Status = ObReferenceObjectByHandle(Event,
+                                           EVENT_MODIFY_STATE,
+                                           ExEventObjectType,
+                                           PreviousMode,
+                                           (PVOID*)&EventObject,
+                                           NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Fail */
+            if (Segments) ExFreePoolWithTag(Segments, TAG_IO);
+            ObDereferenceObject(FileObject);
+            return Status;
+        }
+
+        /* Otherwise reset the event */
+        KeClearEvent(EventObject);
+    }
+
+    /* Check if we should use Sync IO or not */
+    if (FileObject->Flags & FO_SYNCHRONOUS_IO)
+    {
+        /* Lock the file object */
+        IopLockFileObject(FileObject);
+
+        /* Check if we don't have a byte offset available */
+        if (!(ByteOffset) ||
+            ((CapturedByteOffset.u.LowPart == FILE_USE_FILE_POINTER_POSITION) &&
+             (CapturedByteOffset.u.HighPart == -1)))
+        {
+            /* Use the Current Byte Offset instead */
+            CapturedByteOffset = FileObject->CurrentByteOffset;
+        }
+
+        /* Remember we are sync */
+        Synchronous = TRUE;
+    }
+    else if (!ByteOffset)
+    {
+        /* Otherwise, this was async I/O without a byte offset, so fail */
+        if (EventObject) ObDereferenceObject(EventObject);
+        if (Segments) ExFreePoolWithTag(Segments, TAG_IO);
+        ObDereferenceObject(FileObject);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Clear the File Object's event */
+    KeClearEvent(&FileObject->Event);
+
+    /* Allocate the IRP */
+    Irp = IoAllocateIrp(DeviceObject->StackSize, FALSE);
+    if (!Irp)
+    {
+        if (Segments) ExFreePoolWithTag(Segments, TAG_IO);
+        return IopCleanupFailedIrp(FileObject, EventObject, NULL);
+    }
+
+    /* Set the IRP */
+    Irp->Tail.Overlay.OriginalFileObject = FileObject;
+    Irp->Tail.Overlay.Thread = PsGetCurrentThread();
+    Irp->RequestorMode = PreviousMode;
+    Irp->Overlay.AsynchronousParameters.UserApcRoutine = ApcRoutine;
+    Irp->Overlay.AsynchronousParameters.UserApcContext = ApcContext;
+    Irp->UserIosb = IoStatusBlock;
+    Irp->UserEvent = EventObject;
+    Irp->PendingReturned = FALSE;
+    Irp->Cancel = FALSE;
+    Irp->CancelRoutine = NULL;
+    Irp->AssociatedIrp.SystemBuffer = NULL;
+    Irp->MdlAddress = NULL;
+    Irp->UserBuffer = NULL;
+    Irp->Flags = Write ? IRP_WRITE_OPERATION : IRP_READ_OPERATION;
+    Irp->Flags |= IRP_DEFER_IO_COMPLETION;
+    if (FileObject->Flags & FO_NO_INTERMEDIATE_BUFFERING) Irp->Flags |= IRP_NOCACHE;
+
+    /* Set the Stack Data, reads and writes share the same layout */
+    StackPtr = IoGetNextIrpStackLocation(Irp);
+    StackPtr->FileObject = FileObject;
+    if (Write)
+    {
+        StackPtr->MajorFunction = IRP_MJ_WRITE;
+        StackPtr->Flags = FileObject->Flags & FO_WRITE_THROUGH ?
+                          SL_WRITE_THROUGH : 0;
+        StackPtr->Parameters.Write.Key = CapturedKey;
+        StackPtr->Parameters.Write.Length = Length;
+        StackPtr->Parameters.Write.ByteOffset = CapturedByteOffset;
+    }
+    else
+    {
+        StackPtr->MajorFunction = IRP_MJ_READ;
+        StackPtr->Parameters.Read.Key = CapturedKey;
+        StackPtr->Parameters.Read.Length = Length;
+        StackPtr->Parameters.Read.ByteOffset = CapturedByteOffset;
+    }
+
+    /*
+     * Describe all the segments with a single MDL. Its virtual range starts
+     * at the first segment, so partial MDLs built by the drivers still pick
+     * the right pages, while the PFN array holds the page of every segment.
+     */
+    if (PageCount)
+    {
+        _SEH2_TRY
+        {
+            Mdl = IoAllocateMdl((PVOID)(ULONG_PTR)Segments[0].Alignment,
+                                Length,
+                                FALSE,
+                                TRUE,
+                                Irp);
+            if (!Mdl)
+                ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
+            MmProbeAndLockSelectedPages(Mdl,
+                                        Segments,
+                                        PreviousMode,
+                                        Write ? IoReadAccess : IoWriteAccess);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            /* Locking failed, clean up and return the exception code */
+            ExFreePoolWithTag(Segments, TAG_IO);
+            IopCleanupAfterException(FileObject, Irp, EventObject, NULL);
+            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+        }
+        _SEH2_END;
+
+        /* Drivers not using the MDL get the same address it starts at */
+        Irp->UserBuffer = (PVOID)(ULONG_PTR)Segments[0].Alignment;
+        ExFreePoolWithTag(Segments, TAG_IO);
+    }
+
+    /* Perform the call */
+    return IopPerformSynchronousRequest(DeviceObject,
+                                        Irp,
+                                        FileObject,
+                                        TRUE,
+                                        PreviousMode,
+                                        Synchronous,
+                                        Write ? IopWriteTransfer :
+                                                IopReadTransfer);
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -2768,7 +3052,7 @@ NtReadFile(IN HANDLE FileHandle,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS
 NTAPI
@@ -2782,8 +3066,17 @@ NtReadFileScatter(IN HANDLE FileHandle,
                   IN PLARGE_INTEGER  ByteOffset,
                   IN PULONG Key OPTIONAL)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    /* Read into the segments with a single IRP */
+    return IopReadWriteSegments(FileHandle,
+                                Event,
+                                UserApcRoutine,
+                                UserApcContext,
+                                UserIoStatusBlock,
+                                BufferDescription,
+                                BufferLength,
+                                ByteOffset,
+                                Key,
+                                FALSE);
 }
 
 /*
@@ -3780,6 +4073,9 @@ NtWriteFile(IN HANDLE FileHandle,
                                         IopWriteTransfer);
 }
 
+/*
+ * @implemented
+ */
 NTSTATUS
 NTAPI
 NtWriteFileGather(IN HANDLE FileHandle,
@@ -3792,8 +4088,17 @@ NtWriteFileGather(IN HANDLE FileHandle,
                   IN PLARGE_INTEGER ByteOffset,
                   IN PULONG Key OPTIONAL)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    /* Write the segments out with a single IRP */
+    return IopReadWriteSegments(FileHandle,
+                                Event,
+                                UserApcRoutine,
+                                UserApcContext,
+                                UserIoStatusBlock,
+                                BufferDescription,
+                                BufferLength,
+                                ByteOffset,
+                                Key,
+                                TRUE);
 }
 
 /*
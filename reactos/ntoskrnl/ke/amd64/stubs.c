@@ -82,8 +82,46 @@ FASTCALL
 KeZeroPages(IN PVOID Address,
             IN ULONG Size)
 {
-    /* Not using XMMI in this routine */
-    RtlZeroMemory(Address, Size);
+    PULONG64 Current, End;
+
+    /* Callers pass whole pages, anything else gets a plain fill */
+    if (!(Size) || (Size & 63))
+    {
+        RtlZeroMemory(Address, Size);
+        return;
+    }
+
+    /* Use non-temporal stores so the zeroed pages do not pollute the cache */
+    Current = Address;
+    End = (PULONG64)((ULONG_PTR)Address + Size);
+    while (Current < End)
+    {
+#ifdef __GNUC__
+        asm volatile("movnti %1, 0(%0)\n\t"
+                     "movnti %1, 8(%0)\n\t"
+                     "movnti %1, 16(%0)\n\t"
+                     "movnti %1, 24(%0)\n\t"
+                     "movnti %1, 32(%0)\n\t"
+                     "movnti %1, 40(%0)\n\t"
+                     "movnti %1, 48(%0)\n\t"
+                     "movnti %1, 56(%0)\n\t"
+                     :
+                     : "r" (Current), "r" (0ULL)
+                     : "memory");
+#else
+        _mm_stream_si64x((PLONG64)&Current[0], 0);
+        _mm_stream_si64x((PLONG64)&Current[1], 0);
+        _mm_stream_si64x((PLONG64)&Current[2], 0);
+        _mm_stream_si64x((PLONG64)&Current[3], 0);
+        _mm_stream_si64x((PLONG64)&Current[4], 0);
+        _mm_stream_si64x((PLONG64)&Current[5], 0);
+        _mm_stream_si64x((PLONG64)&Current[6], 0);
+        _mm_stream_si64x((PLONG64)&Current[7], 0);
+#endif
+        Current += 8;
+    }
+
+    _mm_sfence();
 }
 
 PVOID
@@ -127,7 +165,8 @@ KiIdleLoop(VOID)
         /* Check for pending timers, pending DPCs, or pending ready threads */
         if ((Prcb->DpcData[0].DpcQueueDepth) ||
             (Prcb->TimerRequest) ||
-            (Prcb->DeferredReadyListHead.Next))
+            (Prcb->DeferredReadyListHead.Next) ||
+            (Prcb->DpcSetEventRequest))
         {
             /* Quiesce the DPC software interrupt */
             HalClearSoftwareInterrupt(DISPATCH_LEVEL);
@@ -142,6 +181,20 @@ KiIdleLoop(VOID)
             /* Enable interrupts */
             _enable();
 
+            /* Do the swap at SYNCH_LEVEL */
+            KfRaiseIrql(SYNCH_LEVEL);
+
+#ifdef CONFIG_SMP
+            /* Another processor may have taken it back, check under the lock */
+            KiAcquirePrcbLock(Prcb);
+            if (!Prcb->NextThread)
+            {
+                KiReleasePrcbLock(Prcb);
+                KeLowerIrql(DISPATCH_LEVEL);
+                continue;
+            }
+#endif
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -153,8 +206,10 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
-            /* Do the swap at SYNCH_LEVEL */
-            KfRaiseIrql(SYNCH_LEVEL);
+#ifdef CONFIG_SMP
+            /* Everybody sees the new thread running now, let them in */
+            KiReleasePrcbLock(Prcb);
+#endif
 
             /* Switch away from the idle thread */
             KiSwapContext(APC_LEVEL, OldThread);
@@ -162,6 +217,14 @@ KiIdleLoop(VOID)
             /* Go back to DISPATCH_LEVEL */
             KeLowerIrql(DISPATCH_LEVEL);
         }
+#ifdef CONFIG_SMP
+        else if (Prcb->IdleSchedule)
+        {
+            /* Enable interrupts and try to pull work from busier processors */
+            _enable();
+            KiIdleSchedule(Prcb);
+        }
+#endif
         else
         {
             /* Continue staying idle. Note the HAL returns with interrupts on */
@@ -20,7 +20,7 @@ ULONG KiMaximumDpcQueueDepth = 4;
 ULONG KiMinimumDpcRate = 3;
 ULONG KiAdjustDpcThreshold = 20;
 ULONG KiIdealDpcRate = 20;
-BOOLEAN KeThreadDpcEnable;
+ULONG KeThreadDpcEnable = TRUE;
 FAST_MUTEX KiGenericCallDpcMutex;
 KDPC KiTimerExpireDpc;
 ULONG KiTimeLimitIsrMicroseconds;
@@ -652,6 +652,18 @@ KiRetireDpcList(IN PKPRCB Prcb)
         Prcb->DpcRoutineActive = FALSE;
         Prcb->DpcInterruptRequested = FALSE;
 
+        /* Check if the DPC thread needs to be woken up */
+        if (Prcb->DpcSetEventRequest)
+        {
+            /* Signal it with interrupts enabled */
+            _enable();
+            if (InterlockedExchange(&Prcb->DpcSetEventRequest, 0))
+            {
+                KeSetEvent(&Prcb->DpcEvent, 0, FALSE);
+            }
+            _disable();
+        }
+
 #ifdef CONFIG_SMP
         /* Check if we have deferred threads */
         if (Prcb->DeferredReadyListHead.Next)
@@ -672,6 +684,90 @@ KiRetireDpcList(IN PKPRCB Prcb)
     } while (DpcData->DpcQueueDepth != 0);
 }
 
+VOID
+NTAPI
+KiExecuteDpc(IN PVOID Context)
+{
+    PKPRCB Prcb = Context;
+    PKDPC_DATA DpcData;
+    PLIST_ENTRY ListHead, DpcEntry;
+    PKDPC Dpc;
+    PKDEFERRED_ROUTINE DeferredRoutine;
+    PVOID DeferredContext, SystemArgument1, SystemArgument2;
+    BOOLEAN Enable;
+
+    /* Stay on our processor, above every regular thread */
+    KeSetSystemAffinityThread(AFFINITY_MASK(Prcb->Number));
+    KeSetPriorityThread(KeGetCurrentThread(), HIGH_PRIORITY);
+    ASSERT(Prcb == KeGetCurrentPrcb());
+
+    /* Get data and list variables and let threaded DPCs be queued to us */
+    DpcData = &Prcb->DpcData[DPC_THREADED];
+    ListHead = &DpcData->DpcListHead;
+    Prcb->DpcThread = KeGetCurrentThread();
+    Prcb->ThreadDpcEnable = TRUE;
+
+    /* Main outer loop */
+    for (;;)
+    {
+        /* Wait for KeInsertQueueDpc to request us */
+        KeWaitForSingleObject(&Prcb->DpcEvent,
+                              Executive,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+        /* Set us as active */
+        Prcb->DpcThreadActive = TRUE;
+
+        /* Loop while we have entries in the queue */
+        for (;;)
+        {
+            /* Lock the DPC data the same way the insertion code does */
+            Enable = KeDisableInterrupts();
+            KiAcquireSpinLock(&DpcData->DpcLock);
+            DpcEntry = ListHead->Flink;
+
+            /* Check if the queue is empty */
+            if (DpcEntry == ListHead)
+            {
+                /* It is, go back to sleep while still holding the lock */
+                ASSERT(DpcData->DpcQueueDepth == 0);
+                Prcb->DpcThreadActive = FALSE;
+                Prcb->DpcThreadRequested = FALSE;
+                KiReleaseSpinLock(&DpcData->DpcLock);
+                if (Enable) _enable();
+                break;
+            }
+
+            /* Remove the DPC from the list */
+            RemoveEntryList(DpcEntry);
+            Dpc = CONTAINING_RECORD(DpcEntry, KDPC, DpcListEntry);
+
+            /* Clear its DPC data and save its parameters */
+            Dpc->DpcData = NULL;
+            DeferredRoutine = Dpc->DeferredRoutine;
+            DeferredContext = Dpc->DeferredContext;
+            SystemArgument1 = Dpc->SystemArgument1;
+            SystemArgument2 = Dpc->SystemArgument2;
+
+            /* Decrease the queue depth */
+            DpcData->DpcQueueDepth--;
+
+            /* Release the lock and re-enable interrupts */
+            KiReleaseSpinLock(&DpcData->DpcLock);
+            if (Enable) _enable();
+
+            /* Call the DPC */
+            DeferredRoutine(Dpc,
+                            DeferredContext,
+                            SystemArgument1,
+                            SystemArgument2);
+            ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
+        }
+    }
+}
+
 VOID
 NTAPI
 KiInitializeDpc(IN PKDPC Dpc,
@@ -796,8 +892,17 @@ KeInsertQueueDpc(IN PKDPC Dpc,
             /* Make sure a threaded DPC isn't already active */
             if (!(Prcb->DpcThreadActive) && !(Prcb->DpcThreadRequested))
             {
-                /* FIXME: Setup Threaded DPC */
-                UNIMPLEMENTED_FATAL("Threaded DPC not supported\n");
+                /*
+                 * Ask for the DPC thread to be signaled. This happens either
+                 * at quantum end or when the DPC list is retired, the latter
+                 * is what wakes us up out of the idle loop.
+                 */
+                InterlockedExchange(&Prcb->DpcSetEventRequest, TRUE);
+                Prcb->DpcThreadRequested = TRUE;
+                Prcb->QuantumEnd = TRUE;
+
+                /* Set DPC inserted */
+                DpcInserted = TRUE;
             }
         }
         else
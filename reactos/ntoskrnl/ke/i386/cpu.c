@@ -1134,8 +1134,73 @@ FASTCALL
 KeZeroPages(IN PVOID Address,
             IN ULONG Size)
 {
-    /* Not using XMMI in this routine */
-    RtlZeroMemory(Address, Size);
+    /* Without SSE2 there is no way around the cache, use a plain fill */
+    if (!(KeFeatureBits & KF_XMMI64) || !(Size) || (Size & 63))
+    {
+        RtlZeroMemory(Address, Size);
+        return;
+    }
+
+    /*
+     * Use non-temporal stores, 64 bytes at a time. The pages are usually
+     * zeroed long before anyone touches them, so there is no point in
+     * evicting useful data from the cache to make room for them.
+     */
+#ifdef __GNUC__
+    asm volatile("xorl %%eax, %%eax\n\t"
+                 "1:\n\t"
+                 "movnti %%eax, 0(%0)\n\t"
+                 "movnti %%eax, 4(%0)\n\t"
+                 "movnti %%eax, 8(%0)\n\t"
+                 "movnti %%eax, 12(%0)\n\t"
+                 "movnti %%eax, 16(%0)\n\t"
+                 "movnti %%eax, 20(%0)\n\t"
+                 "movnti %%eax, 24(%0)\n\t"
+                 "movnti %%eax, 28(%0)\n\t"
+                 "movnti %%eax, 32(%0)\n\t"
+                 "movnti %%eax, 36(%0)\n\t"
+                 "movnti %%eax, 40(%0)\n\t"
+                 "movnti %%eax, 44(%0)\n\t"
+                 "movnti %%eax, 48(%0)\n\t"
+                 "movnti %%eax, 52(%0)\n\t"
+                 "movnti %%eax, 56(%0)\n\t"
+                 "movnti %%eax, 60(%0)\n\t"
+                 "addl $64, %0\n\t"
+                 "subl $64, %1\n\t"
+                 "jnz 1b\n\t"
+                 "sfence\n\t"
+                 : "+r" (Address), "+r" (Size)
+                 :
+                 : "eax", "memory", "cc");
+#else
+    __asm
+    {
+        mov edx, [Address]
+        mov ecx, [Size]
+        xor eax, eax
+    ZeroLoop:
+        movnti [edx], eax
+        movnti [edx + 4], eax
+        movnti [edx + 8], eax
+        movnti [edx + 12], eax
+        movnti [edx + 16], eax
+        movnti [edx + 20], eax
+        movnti [edx + 24], eax
+        movnti [edx + 28], eax
+        movnti [edx + 32], eax
+        movnti [edx + 36], eax
+        movnti [edx + 40], eax
+        movnti [edx + 44], eax
+        movnti [edx + 48], eax
+        movnti [edx + 52], eax
+        movnti [edx + 56], eax
+        movnti [edx + 60], eax
+        add edx, 64
+        sub ecx, 64
+        jnz ZeroLoop
+        sfence
+    };
+#endif
 }
 
 VOID
@@ -282,7 +282,8 @@ KiIdleLoop(VOID)
         /* Check for pending timers, pending DPCs, or pending ready threads */
         if ((Prcb->DpcData[0].DpcQueueDepth) ||
             (Prcb->TimerRequest) ||
-            (Prcb->DeferredReadyListHead.Next))
+            (Prcb->DeferredReadyListHead.Next) ||
+            (Prcb->DpcSetEventRequest))
         {
             /* Quiesce the DPC software interrupt */
             HalClearSoftwareInterrupt(DISPATCH_LEVEL);
@@ -297,6 +298,16 @@ KiIdleLoop(VOID)
             /* Enable interrupts */
             _enable();
 
+#ifdef CONFIG_SMP
+            /* Another processor may have taken it back, check under the lock */
+            KiAcquirePrcbLock(Prcb);
+            if (!Prcb->NextThread)
+            {
+                KiReleasePrcbLock(Prcb);
+                continue;
+            }
+#endif
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -308,9 +319,22 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
+#ifdef CONFIG_SMP
+            /* Everybody sees the new thread running now, let them in */
+            KiReleasePrcbLock(Prcb);
+#endif
+
             /* Switch away from the idle thread */
             KiSwapContext(APC_LEVEL, OldThread);
         }
+#ifdef CONFIG_SMP
+        else if (Prcb->IdleSchedule)
+        {
+            /* Enable interrupts and try to pull work from busier processors */
+            _enable();
+            KiIdleSchedule(Prcb);
+        }
+#endif
         else
         {
             /* Continue staying idle. Note the HAL returns with interrupts on */
@@ -34,8 +34,31 @@ FASTCALL
 KiIpiSend(IN KAFFINITY TargetProcessors,
           IN ULONG IpiRequest)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("Not yet implemented\n", FALSE);
+#ifdef CONFIG_SMP
+    ULONG Processor;
+    KAFFINITY Current;
+
+    /*
+     * Flag the request on every target, the service routine picks it up.
+     * HalRequestIpi takes a processor number rather than a set, so the
+     * targets are interrupted one at a time.
+     */
+    for (Processor = 0, Current = 1;
+         Processor < (ULONG)KeNumberProcessors;
+         Processor++, Current <<= 1)
+    {
+        if (TargetProcessors & Current)
+        {
+            InterlockedBitTestAndSet((PLONG)&KiProcessorBlock[Processor]->IpiFrozen,
+                                     IpiRequest);
+            HalRequestIpi(Processor);
+        }
+    }
+#else
+    /* There is nobody else to interrupt on UP */
+    UNREFERENCED_PARAMETER(TargetProcessors);
+    UNREFERENCED_PARAMETER(IpiRequest);
+#endif
 }
 
 VOID
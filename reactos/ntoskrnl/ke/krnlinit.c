@@ -292,11 +292,39 @@ NTAPI
 INIT_FUNCTION
 KeInitSystem(VOID)
 {
+    NTSTATUS Status;
+    HANDLE ThreadHandle;
+    PKPRCB Prcb;
+    LONG i;
+
     /* Check if Threaded DPCs are enabled */
     if (KeThreadDpcEnable)
     {
-        /* FIXME: TODO */
-        DPRINT1("Threaded DPCs not yet supported\n");
+        /* Start a DPC thread on every processor */
+        for (i = 0; i < KeNumberProcessors; i++)
+        {
+            /* Initialize the event the DPC thread waits on */
+            Prcb = KiProcessorBlock[i];
+            KeInitializeEvent(&Prcb->DpcEvent, SynchronizationEvent, FALSE);
+
+            /* Create the thread, it enables threaded DPCs once it runs */
+            Status = PsCreateSystemThread(&ThreadHandle,
+                                          THREAD_ALL_ACCESS,
+                                          NULL,
+                                          NULL,
+                                          NULL,
+                                          KiExecuteDpc,
+                                          Prcb);
+            if (!NT_SUCCESS(Status))
+            {
+                /* Threaded DPCs will just run as regular ones on this CPU */
+                DPRINT1("Failed to create the DPC thread for CPU %ld: 0x%lx\n", i, Status);
+                continue;
+            }
+
+            /* We don't need the handle */
+            ObCloseHandle(ThreadHandle, KernelMode);
+        }
     }
 
     /* Initialize non-portable parts of the kernel */
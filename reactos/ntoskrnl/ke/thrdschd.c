@@ -15,9 +15,17 @@
 #ifdef _WIN64
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr64((PLONG64)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd64((PLONG64)Destination, SetMember);
+# define BitScanForwardAffinity(Index, Mask) \
+    BitScanForward64(Index, Mask)
 #else
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr((PLONG)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd((PLONG)Destination, SetMember);
+# define BitScanForwardAffinity(Index, Mask) \
+    BitScanForward(Index, Mask)
 #endif
 
 /* GLOBALS *******************************************************************/
@@ -25,15 +33,159 @@
 ULONG_PTR KiIdleSummary;
 ULONG_PTR KiIdleSMTSummary;
 
+/* PRIVATE FUNCTIONS *********************************************************/
+
+#ifdef CONFIG_SMP
+static
+ULONG
+KiSelectProcessorForThread(IN PKTHREAD Thread,
+                           IN KAFFINITY Set)
+{
+    ULONG Processor;
+
+    /* The ideal processor keeps the thread's cache warm, use it if we can */
+    Processor = Thread->IdealProcessor;
+    if (Set & AFFINITY_MASK(Processor)) return Processor;
+
+    /* Otherwise try the processor it last ran on */
+    Processor = Thread->NextProcessor;
+    if (Set & AFFINITY_MASK(Processor)) return Processor;
+
+    /* Then the current one, which avoids sending an IPI */
+    Processor = KeGetCurrentProcessorNumber();
+    if (Set & AFFINITY_MASK(Processor)) return Processor;
+
+    /* Fall back to the lowest numbered processor in the set */
+    BitScanForwardAffinity(&Processor, Set);
+    return Processor;
+}
+
+static
+VOID
+KiAcquireTwoPrcbLocks(IN PKPRCB FirstPrcb,
+                      IN PKPRCB SecondPrcb)
+{
+    /* Always lock the lower PRCB first so that two stealers can't deadlock */
+    if (FirstPrcb < SecondPrcb)
+    {
+        KiAcquirePrcbLock(FirstPrcb);
+        KiAcquirePrcbLock(SecondPrcb);
+    }
+    else
+    {
+        KiAcquirePrcbLock(SecondPrcb);
+        KiAcquirePrcbLock(FirstPrcb);
+    }
+}
+
+static
+PKTHREAD
+KiSelectStealableThread(IN PKPRCB SourcePrcb,
+                        IN PKPRCB Prcb)
+{
+    ULONG PrioritySet;
+    ULONG HighPriority;
+    PLIST_ENTRY ListHead, ListEntry;
+    PKTHREAD Thread;
+
+    /* Walk the ready queues of the source CPU from the highest priority down */
+    PrioritySet = SourcePrcb->ReadySummary;
+    while (PrioritySet)
+    {
+        BitScanReverse(&HighPriority, PrioritySet);
+        PrioritySet ^= PRIORITY_MASK(HighPriority);
+
+        /* Look for the first thread that is allowed to run on our CPU */
+        ListHead = &SourcePrcb->DispatcherReadyListHead[HighPriority];
+        for (ListEntry = ListHead->Flink;
+             ListEntry != ListHead;
+             ListEntry = ListEntry->Flink)
+        {
+            Thread = CONTAINING_RECORD(ListEntry, KTHREAD, WaitListEntry);
+            ASSERT(Thread->State == Ready);
+            ASSERT(Thread->NextProcessor == SourcePrcb->Number);
+            if (!(Thread->Affinity & Prcb->SetMember)) continue;
+
+            /* Take it off the source CPU's queue */
+            if (RemoveEntryList(&Thread->WaitListEntry))
+            {
+                /* The list is empty now, reset the ready summary */
+                SourcePrcb->ReadySummary ^= PRIORITY_MASK(HighPriority);
+            }
+
+            return Thread;
+        }
+    }
+
+    /* Nothing here can run on our CPU */
+    return NULL;
+}
+#endif
+
 /* FUNCTIONS *****************************************************************/
 
 PKTHREAD
 FASTCALL
 KiIdleSchedule(IN PKPRCB Prcb)
 {
-    /* FIXME: TODO */
-    ASSERTMSG("SMP: Not yet implemented\n", FALSE);
+#ifdef CONFIG_SMP
+    PKPRCB SourcePrcb;
+    PKTHREAD Thread = NULL;
+    ULONG Index, Count;
+    KIRQL OldIrql;
+
+    /* Sanity check */
+    ASSERT(Prcb == KeGetCurrentPrcb());
+
+    /* Raise to synch level and clear the request, we only try once per idle */
+    OldIrql = KeRaiseIrqlToSynchLevel();
+    Prcb->IdleSchedule = FALSE;
+
+    /* Start after our own CPU so that pulled work spreads evenly */
+    Count = KeNumberProcessors;
+    for (Index = 1; Index < Count; Index++)
+    {
+        /* Skip processors without anything ready */
+        SourcePrcb = KiProcessorBlock[(Prcb->Number + Index) % Count];
+        if (!(SourcePrcb) || !(SourcePrcb->ReadySummary)) continue;
+
+        /* Lock both processors and make sure nobody scheduled us meanwhile */
+        KiAcquireTwoPrcbLocks(Prcb, SourcePrcb);
+        if (!Prcb->NextThread)
+        {
+            /* Try to pull a thread over */
+            Thread = KiSelectStealableThread(SourcePrcb, Prcb);
+            if (Thread)
+            {
+                /* Move it to our CPU and set it up to run next */
+                Thread->NextProcessor = (UCHAR)Prcb->Number;
+                Thread->State = Standby;
+                Prcb->NextThread = Thread;
+
+                /* We're not idle anymore */
+                InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+            }
+        }
+        else
+        {
+            /* Someone else gave us work, use that instead */
+            Thread = Prcb->NextThread;
+        }
+
+        /* Release the locks and stop once we have something to run */
+        KiReleasePrcbLock(SourcePrcb);
+        KiReleasePrcbLock(Prcb);
+        if (Thread) break;
+    }
+
+    /* Lower IRQL back and return the thread we found, if any */
+    KeLowerIrql(OldIrql);
+    return Thread;
+#else
+    /* There is nobody to take work from on UP */
+    UNREFERENCED_PARAMETER(Prcb);
     return NULL;
+#endif
 }
 
 VOID
@@ -83,6 +235,9 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     ULONG Processor = 0;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+#ifdef CONFIG_SMP
+    KAFFINITY IdleSet;
+#endif
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,6 +383,41 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
+#ifdef CONFIG_SMP
+    /* Check if any of the processors this thread can run on is idle */
+    IdleSet = KiIdleSummary & Thread->Affinity;
+    while (IdleSet)
+    {
+        /* Pick one, preferring the processors the thread ran on before */
+        Processor = KiSelectProcessorForThread(Thread, IdleSet);
+        Prcb = KiProcessorBlock[Processor];
+        KiAcquirePrcbLock(Prcb);
+
+        /* Make sure it is still idle now that we own its lock */
+        if ((KiIdleSummary & Prcb->SetMember) && !(Prcb->NextThread))
+        {
+            /* Take it out of the idle set and make this thread the next one */
+            InterlockedAndSetMember(&KiIdleSummary, ~Prcb->SetMember);
+            Thread->NextProcessor = (UCHAR)Processor;
+            Thread->State = Standby;
+            Prcb->NextThread = Thread;
+
+            /* Unlock the PRCB and wake the processor up if it isn't us */
+            KiReleasePrcbLock(Prcb);
+            KiRescheduleThread(TRUE, Processor);
+            return;
+        }
+
+        /* Somebody got there first, try the next idle processor */
+        KiReleasePrcbLock(Prcb);
+        IdleSet &= ~AFFINITY_MASK(Processor);
+    }
+
+    /* Nobody is idle, so compete for the ideal or last processor instead */
+    Processor = KiSelectProcessorForThread(Thread, Thread->Affinity);
+    Prcb = KiProcessorBlock[Processor];
+    KiAcquirePrcbLock(Prcb);
+#else
     /* Queue the thread on CPU 0 and get the PRCB and lock it */
     Thread->NextProcessor = 0;
     Prcb = KiProcessorBlock[0];
@@ -245,6 +435,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
         KiReleasePrcbLock(Prcb);
         return;
     }
+#endif
 
     /* Set the CPU number */
     Thread->NextProcessor = (UCHAR)Processor;
@@ -336,12 +527,9 @@ KiSelectNextThread(IN PKPRCB Prcb)
         /* Didn't find any, get the current idle thread */
         Thread = Prcb->IdleThread;
 
-        /* Enable idle scheduling */
+        /* Set the idle summary and look for work elsewhere once idle */
         InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
         Prcb->IdleSchedule = TRUE;
-
-        /* FIXME: SMT support */
-        ASSERTMSG("SMP: Not yet implemented\n", FALSE);
     }
 
     /* Sanity checks and return the thread */
@@ -385,8 +573,9 @@ KiSwapThread(IN PKTHREAD CurrentThread,
         }
         else
         {
-            /* Set the idle summary */
+            /* Set the idle summary and look for work elsewhere once idle */
             InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+            Prcb->IdleSchedule = TRUE;
 
             /* Schedule the idle thread */
             NextThread = Prcb->IdleThread;
@@ -664,9 +853,11 @@ KiSetPriorityThread(IN PKTHREAD Thread,
             }
             else if (Thread->State == DeferredReady)
             {
-                /* FIXME: TODO */
-                DPRINT1("Deferred state not yet supported\n");
-                ASSERT(FALSE);
+                /*
+                 * The thread sits on a deferred ready list and will be queued
+                 * at whatever priority it has once that list is processed.
+                 */
+                Thread->Priority = (SCHAR)Priority;
             }
             else
             {
@@ -686,6 +877,12 @@ KiSetAffinityThread(IN PKTHREAD Thread,
                     IN KAFFINITY Affinity)
 {
     KAFFINITY OldAffinity;
+#ifdef CONFIG_SMP
+    PKPRCB Prcb;
+    ULONG Processor;
+    PKTHREAD NewThread;
+    BOOLEAN RequestInterrupt;
+#endif
 
     /* Get the current affinity */
     OldAffinity = Thread->UserAffinity;
@@ -705,8 +902,121 @@ KiSetAffinityThread(IN PKTHREAD Thread,
     if (!Thread->SystemAffinityActive)
     {
 #ifdef CONFIG_SMP
-        /* FIXME: TODO */
-        DPRINT1("Affinity support disabled!\n");
+        /* Update the scheduling affinity and loop in case the state changes */
+        Thread->Affinity = Affinity;
+        for (;;)
+        {
+            RequestInterrupt = FALSE;
+
+            /* Choose action based on thread's state */
+            if ((Thread->State == Ready) && !(Thread->ProcessReadyQueue))
+            {
+                /* Get the PRCB for the thread and lock it */
+                Processor = Thread->NextProcessor;
+                Prcb = KiProcessorBlock[Processor];
+                KiAcquirePrcbLock(Prcb);
+
+                /* Make sure the thread is still ready and on this CPU */
+                if ((Thread->State != Ready) ||
+                    (Thread->NextProcessor != Prcb->Number))
+                {
+                    /* Release the lock and loop again */
+                    KiReleasePrcbLock(Prcb);
+                    continue;
+                }
+
+                /* Check if it's queued on a CPU it can't run on anymore */
+                if (!(Affinity & Prcb->SetMember))
+                {
+                    /* Remove it from the current queue */
+                    if (RemoveEntryList(&Thread->WaitListEntry))
+                    {
+                        /* Update the ready summary */
+                        Prcb->ReadySummary ^= PRIORITY_MASK(Thread->Priority);
+                    }
+
+                    /* Make it ready again, which will pick a valid CPU */
+                    KiInsertDeferredReadyList(Thread);
+                }
+
+                /* Release the PRCB lock */
+                KiReleasePrcbLock(Prcb);
+            }
+            else if (Thread->State == Standby)
+            {
+                /* Get the PRCB for the thread and lock it */
+                Processor = Thread->NextProcessor;
+                Prcb = KiProcessorBlock[Processor];
+                KiAcquirePrcbLock(Prcb);
+
+                /* Check if we're still the next thread to run */
+                if (Thread != Prcb->NextThread)
+                {
+                    /* Release the lock and try again */
+                    KiReleasePrcbLock(Prcb);
+                    continue;
+                }
+
+                /* Check if it's about to run on a CPU it can't use anymore */
+                if (!(Affinity & Prcb->SetMember))
+                {
+                    /* Find something else for this CPU to run */
+                    NewThread = KiSelectReadyThread(0, Prcb);
+                    if (NewThread)
+                    {
+                        /* Found a new one, set it on standby */
+                        NewThread->State = Standby;
+                    }
+                    else if (Prcb->CurrentThread == Prcb->IdleThread)
+                    {
+                        /* Nothing else to do, so the CPU goes back to idle */
+                        InterlockedOrSetMember(&KiIdleSummary, Prcb->SetMember);
+                    }
+                    Prcb->NextThread = NewThread;
+
+                    /* Dispatch our thread */
+                    KiInsertDeferredReadyList(Thread);
+                }
+
+                /* Release the PRCB lock */
+                KiReleasePrcbLock(Prcb);
+            }
+            else if (Thread->State == Running)
+            {
+                /* Get the PRCB for the thread and lock it */
+                Processor = Thread->NextProcessor;
+                Prcb = KiProcessorBlock[Processor];
+                KiAcquirePrcbLock(Prcb);
+
+                /* Check if we're still the current thread running */
+                if (Thread != Prcb->CurrentThread)
+                {
+                    /* Thread changed, release lock and restart */
+                    KiReleasePrcbLock(Prcb);
+                    continue;
+                }
+
+                /* Check if it's running on a CPU it can't use anymore */
+                if (!(Affinity & Prcb->SetMember) && !(Prcb->NextThread))
+                {
+                    /* Replace it with a ready thread, or the idle thread */
+                    NewThread = KiSelectReadyThread(0, Prcb);
+                    if (!NewThread) NewThread = Prcb->IdleThread;
+
+                    /* Set it on standby and request an interrupt */
+                    NewThread->State = Standby;
+                    Prcb->NextThread = NewThread;
+                    RequestInterrupt = TRUE;
+                }
+
+                /* Release the lock and make the CPU switch if needed */
+                KiReleasePrcbLock(Prcb);
+                KiRescheduleThread(RequestInterrupt, Processor);
+            }
+
+            /* If we got here, then thread state was consistent, so bail out */
+            break;
+        }
 #endif
     }
 
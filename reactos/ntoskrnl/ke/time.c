@@ -178,6 +178,12 @@ KeUpdateRunTime(IN PKTRAP_FRAME TrapFrame,
         {
             /* Handle being in kernel mode */
             Thread->KernelTime++;
+
+            /* Threaded DPCs still count as DPC time for the processor */
+            if ((Prcb->DpcThreadActive) && (Thread == Prcb->DpcThread))
+            {
+                Prcb->DpcTime++;
+            }
         }
         else
         {
@@ -1458,6 +1458,8 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
 {
     ULONG i;
     PPOOL_DESCRIPTOR PoolDesc;
+    PGENERAL_LOOKASIDE Lookaside;
+    PLIST_ENTRY ListEntry;
 
     //
     // Assume all failures
@@ -1503,10 +1505,22 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
 #endif
 
     //
-    // FIXME: Not yet supported
+    // Tally up the hits of the pool lookaside lists, per-processor ones included
     //
-    *NonPagedPoolLookasideHits += 0;
-    *PagedPoolLookasideHits += 0;
+    for (ListEntry = ExPoolLookasideListHead.Flink;
+         ListEntry != &ExPoolLookasideListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Lookaside = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
+        if (Lookaside->Type == NonPagedPool)
+        {
+            *NonPagedPoolLookasideHits += Lookaside->AllocateHits;
+        }
+        else
+        {
+            *PagedPoolLookasideHits += Lookaside->AllocateHits;
+        }
+    }
 }
 
 VOID
@@ -1340,16 +1340,86 @@ MmProbeAndLockProcessPages(IN OUT PMDL MemoryDescriptorList,
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
 MmProbeAndLockSelectedPages(IN OUT PMDL MemoryDescriptorList,
-                            IN LARGE_INTEGER PageList[],
+                            IN PFILE_SEGMENT_ELEMENT SegmentArray,
                             IN KPROCESSOR_MODE AccessMode,
                             IN LOCK_OPERATION Operation)
 {
-    UNIMPLEMENTED;
+    struct
+    {
+        MDL Mdl;
+        PFN_NUMBER Page;
+    } StackMdl;
+    PPFN_NUMBER MdlPages;
+    ULONG PageCount, LockedPages, ByteCount;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* The caller built an MDL whose pages come one per segment */
+    ASSERT(MemoryDescriptorList->ByteCount != 0);
+    ASSERT(MemoryDescriptorList->ByteOffset == 0);
+    ASSERT((MemoryDescriptorList->MdlFlags & (MDL_PAGES_LOCKED |
+                                              MDL_MAPPED_TO_SYSTEM_VA |
+                                              MDL_SOURCE_IS_NONPAGED_POOL |
+                                              MDL_PARTIAL |
+                                              MDL_IO_SPACE)) == 0);
+
+    MdlPages = (PPFN_NUMBER)(MemoryDescriptorList + 1);
+    PageCount = BYTES_TO_PAGES(MemoryDescriptorList->ByteCount);
+
+    /* Lock every segment through a one page MDL and gather its PFN */
+    for (LockedPages = 0; LockedPages < PageCount; LockedPages++)
+    {
+        MmInitializeMdl(&StackMdl.Mdl,
+                        (PVOID)(ULONG_PTR)SegmentArray[LockedPages].Alignment,
+                        PAGE_SIZE);
+
+        _SEH2_TRY
+        {
+            /* Segments must be page aligned */
+            if (StackMdl.Mdl.ByteOffset != 0)
+                ExRaiseStatus(STATUS_DATATYPE_MISALIGNMENT);
+
+            MmProbeAndLockPages(&StackMdl.Mdl, AccessMode, Operation);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = _SEH2_GetExceptionCode();
+        }
+        _SEH2_END;
+
+        if (!NT_SUCCESS(Status))
+            break;
+
+        /* All segments belong to the same process */
+        ASSERT((LockedPages == 0) ||
+               (MemoryDescriptorList->Process == StackMdl.Mdl.Process));
+        MemoryDescriptorList->Process = StackMdl.Mdl.Process;
+        MemoryDescriptorList->MdlFlags |= StackMdl.Mdl.MdlFlags &
+                                          (MDL_PAGES_LOCKED |
+                                           MDL_WRITE_OPERATION |
+                                           MDL_IO_SPACE);
+        MdlPages[LockedPages] = StackMdl.Page;
+    }
+
+    if (NT_SUCCESS(Status))
+        return;
+
+    /* Unlock what we got so far, the accounting matches the pages locked */
+    if (LockedPages != 0)
+    {
+        ByteCount = MemoryDescriptorList->ByteCount;
+        MemoryDescriptorList->ByteCount = LockedPages * PAGE_SIZE;
+        MmUnlockPages(MemoryDescriptorList);
+        MemoryDescriptorList->ByteCount = ByteCount;
+    }
+
+    MemoryDescriptorList->Process = NULL;
+    MemoryDescriptorList->MdlFlags &= ~(MDL_PAGES_LOCKED | MDL_WRITE_OPERATION | MDL_IO_SPACE);
+    ExRaiseStatus(Status);
 }
 
 /*
@@ -512,9 +512,9 @@ MiZeroPfn(IN PFN_NUMBER PageFrameNumber)
     /* Make the system PTE valid with our PFN */
     MI_WRITE_VALID_PTE(ZeroPte, TempPte);
 
-    /* Get the address it maps to, and zero it out */
+    /* Get the address it maps to, and zero it out through the cache since it is about to be used */
     ZeroAddress = MiPteToAddress(ZeroPte);
-    KeZeroPages(ZeroAddress, PAGE_SIZE);
+    RtlZeroMemory(ZeroAddress, PAGE_SIZE);
 
     /* Now get rid of it */
     MiReleaseSystemPtes(ZeroPte, 1, SystemPteSpace);
@@ -125,10 +125,13 @@ MiZeroPhysicalPage(IN PFN_NUMBER PageFrameIndex)
     PVOID VirtualAddress;
     PEPROCESS Process = PsGetCurrentProcess();
 
-    /* Map in hyperspace, then wipe it using XMMI or MEMSET */
+    /*
+     * Map in hyperspace, then wipe it. The page is about to be used, so
+     * do not bypass the cache like KeZeroPages does.
+     */
     VirtualAddress = MiMapPageInHyperSpace(Process, PageFrameIndex, &OldIrql);
     ASSERT(VirtualAddress);
-    KeZeroPages(VirtualAddress, PAGE_SIZE);
+    RtlZeroMemory(VirtualAddress, PAGE_SIZE);
     MiUnmapPageInHyperSpace(Process, VirtualAddress, OldIrql);
 }
 
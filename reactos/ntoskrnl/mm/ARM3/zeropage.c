@@ -17,9 +17,18 @@
 
 /* GLOBALS ********************************************************************/
 
+/* Maximum number of pages the zero page threads map and clear in one go */
+#define MI_ZERO_PAGE_BATCH 16
+C_ASSERT(MI_ZERO_PAGE_BATCH <= (MI_ZERO_PTES - 1));
+
 BOOLEAN MmZeroingPageThreadActive;
 KEVENT MmZeroingPageEvent;
 
+#ifdef CONFIG_SMP
+/* Set while the free list has enough pages for the helpers to join in */
+KEVENT MiZeroingHelperEvent;
+#endif
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
 VOID
@@ -32,6 +41,169 @@ NTAPI
 MiFreeInitializationCode(IN PVOID StartVa,
 IN PVOID EndVa);
 
+static
+PMMPFN
+MiRemoveFreePagesForZeroing(OUT PPFN_NUMBER PageCount)
+{
+    PFN_NUMBER PageIndex, FreePage, Count;
+    PMMPFN Pfn1, FirstPfn;
+
+    /* The PFN lock must be held */
+    ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+    /* Take up to a batch of pages off the free list, chaining them by PFN */
+    FirstPfn = (PMMPFN)LIST_HEAD;
+    Count = 0;
+    while ((Count < MI_ZERO_PAGE_BATCH) && (MmFreePageListHead.Total))
+    {
+        PageIndex = MmFreePageListHead.Flink;
+        ASSERT(PageIndex != LIST_HEAD);
+        Pfn1 = MiGetPfnEntry(PageIndex);
+        MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
+        MI_SET_PROCESS2("Kernel 0 Loop");
+        FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
+
+        /* The first global free page should also be the first on its own list */
+        if (FreePage != PageIndex)
+        {
+            KeBugCheckEx(PFN_LIST_CORRUPT,
+                         0x8F,
+                         FreePage,
+                         PageIndex,
+                         0);
+        }
+
+        Pfn1->u1.Flink = (PFN_NUMBER)FirstPfn;
+        FirstPfn = Pfn1;
+        Count++;
+    }
+
+    *PageCount = Count;
+    return FirstPfn;
+}
+
+static
+VOID
+MiInsertZeroedPages(IN PMMPFN Pfn1)
+{
+    PMMPFN NextPfn;
+
+    /* The PFN lock must be held */
+    ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+    /* Put every page of the chain on the zeroed list */
+    while (Pfn1 != (PMMPFN)LIST_HEAD)
+    {
+        NextPfn = (PMMPFN)Pfn1->u1.Flink;
+        MiInsertPageInList(&MmZeroedPageListHead, MiGetPfnEntryIndex(Pfn1));
+        Pfn1 = NextPfn;
+    }
+}
+
+#ifdef CONFIG_SMP
+static
+VOID
+NTAPI
+MiZeroPageHelperThread(IN PVOID Context)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+    CCHAR Number = (CCHAR)(ULONG_PTR)Context;
+    PMMPTE ZeroPte;
+    PVOID ZeroAddress;
+    MMPTE TempPte;
+    KIRQL OldIrql;
+    PFN_NUMBER PageCount, i;
+    PMMPFN Pfn1, Pfn2;
+
+    /* Stay on our processor, and only run when it has nothing better to do */
+    KeSetSystemAffinityThread(AFFINITY_MASK(Number));
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    /* The zeroing PTEs belong to the primary thread, get our own window */
+    ZeroPte = MiReserveSystemPtes(MI_ZERO_PAGE_BATCH, SystemPteSpace);
+    if (!ZeroPte)
+    {
+        DPRINT1("No system PTEs for the zero page helper on CPU %d\n", Number);
+        PsTerminateSystemThread(STATUS_INSUFFICIENT_RESOURCES);
+    }
+    ZeroAddress = MiPteToAddress(ZeroPte);
+
+    while (TRUE)
+    {
+        KeWaitForSingleObject(&MiZeroingHelperEvent,
+                              WrFreePage,
+                              KernelMode,
+                              FALSE,
+                              NULL);
+
+        OldIrql = KeAcquireQueuedSpinLock(LockQueuePfnLock);
+        Pfn1 = MiRemoveFreePagesForZeroing(&PageCount);
+        if (!PageCount)
+        {
+            /* Nothing left, go back to sleep until the primary thread wakes us */
+            KeClearEvent(&MiZeroingHelperEvent);
+            KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
+            continue;
+        }
+        KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
+
+        /* Map the batch */
+        TempPte = ValidKernelPte;
+        for (i = 0, Pfn2 = Pfn1; i < PageCount; i++, Pfn2 = (PMMPFN)Pfn2->u1.Flink)
+        {
+            TempPte.u.Hard.PageFrameNumber = MiGetPfnEntryIndex(Pfn2);
+            MI_WRITE_VALID_PTE(&ZeroPte[i], TempPte);
+        }
+
+        KeZeroPages(ZeroAddress, PageCount << PAGE_SHIFT);
+
+        /* The window is only ever used on this processor, a local flush is enough */
+        for (i = 0; i < PageCount; i++)
+        {
+            MI_ERASE_PTE(&ZeroPte[i]);
+            KeInvalidateTlbEntry((PCHAR)ZeroAddress + (i << PAGE_SHIFT));
+        }
+
+        OldIrql = KeAcquireQueuedSpinLock(LockQueuePfnLock);
+        MiInsertZeroedPages(Pfn1);
+        KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
+    }
+}
+
+static
+VOID
+MiCreateZeroPageHelpers(VOID)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+    NTSTATUS Status;
+    CCHAR i;
+
+    KeInitializeEvent(&MiZeroingHelperEvent, NotificationEvent, FALSE);
+
+    /* The primary thread covers the boot processor, add one helper for each of the others */
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    for (i = 1; i < KeNumberProcessors; i++)
+    {
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      &ObjectAttributes,
+                                      NULL,
+                                      NULL,
+                                      MiZeroPageHelperThread,
+                                      (PVOID)(ULONG_PTR)i);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to create zero page helper for CPU %d: 0x%lx\n", i, Status);
+            break;
+        }
+
+        ZwClose(ThreadHandle);
+    }
+}
+#endif
+
 VOID
 NTAPI
 MmZeroPageThread(VOID)
@@ -41,7 +213,7 @@ MmZeroPageThread(VOID)
     PVOID WaitObjects[2];
     KIRQL OldIrql;
     PVOID ZeroAddress;
-    PFN_NUMBER PageIndex, FreePage;
+    PFN_NUMBER PageCount;
     PMMPFN Pfn1;
 
     /* Get the discardable sections to free them */
@@ -49,6 +221,11 @@ MmZeroPageThread(VOID)
     if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
     DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
 
+#ifdef CONFIG_SMP
+    /* Let the other processors help out while they are idle */
+    MiCreateZeroPageHelpers();
+#endif
+
     /* Set our priority to 0 */
     Thread->BasePriority = 0;
     KeSetPriorityThread(Thread, 0);
@@ -75,38 +252,34 @@ MmZeroPageThread(VOID)
             if (!MmFreePageListHead.Total)
             {
                 MmZeroingPageThreadActive = FALSE;
+#ifdef CONFIG_SMP
+                KeClearEvent(&MiZeroingHelperEvent);
+#endif
                 KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
                 break;
             }
 
-            PageIndex = MmFreePageListHead.Flink;
-            ASSERT(PageIndex != LIST_HEAD);
-            Pfn1 = MiGetPfnEntry(PageIndex);
-            MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
-            MI_SET_PROCESS2("Kernel 0 Loop");
-            FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
-
-            /* The first global free page should also be the first on its own list */
-            if (FreePage != PageIndex)
+#ifdef CONFIG_SMP
+            /* Wake up the helpers when there is more than one batch to do */
+            if ((MmFreePageListHead.Total >= 2 * MI_ZERO_PAGE_BATCH) &&
+                (KeNumberProcessors > 1))
             {
-                KeBugCheckEx(PFN_LIST_CORRUPT,
-                             0x8F,
-                             FreePage,
-                             PageIndex,
-                             0);
+                KeSetEvent(&MiZeroingHelperEvent, IO_NO_INCREMENT, FALSE);
             }
+#endif
 
-            Pfn1->u1.Flink = LIST_HEAD;
+            /* Grab a batch, and zero it without holding the PFN lock */
+            Pfn1 = MiRemoveFreePagesForZeroing(&PageCount);
             KeReleaseQueuedSpinLock(LockQueuePfnLock, OldIrql);
 
-            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, 1);
+            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, PageCount);
             ASSERT(ZeroAddress);
-            RtlZeroMemory(ZeroAddress, PAGE_SIZE);
-            MiUnmapPagesInZeroSpace(ZeroAddress, 1);
+            KeZeroPages(ZeroAddress, PageCount << PAGE_SHIFT);
+            MiUnmapPagesInZeroSpace(ZeroAddress, PageCount);
 
             OldIrql = KeAcquireQueuedSpinLock(LockQueuePfnLock);
 
-            MiInsertPageInList(&MmZeroedPageListHead, PageIndex);
+            MiInsertZeroedPages(Pfn1);
         }
     }
 }
@@ -203,6 +203,12 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         CurrentPage = NextPage;
     }
 
+    /* Send out whatever the page writer is still gathering */
+    if (*NrFreedPages)
+    {
+        MmFlushSwapPages();
+    }
+
     return STATUS_SUCCESS;
 }
 
@@ -208,6 +208,9 @@ MmAccessFault(IN BOOLEAN StoreInstruction,
 {
     PMEMORY_AREA MemoryArea = NULL;
 
+    /* Account the fault for the performance counters */
+    InterlockedIncrement((PLONG)&KeGetCurrentPrcb()->MmPageFaultCount);
+
     /* Cute little hack for ROS */
     if ((ULONG_PTR)Address >= (ULONG_PTR)MmSystemRangeStart)
     {
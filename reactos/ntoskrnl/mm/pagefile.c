@@ -53,10 +53,42 @@ typedef struct _PAGINGFILE
     PULONG AllocMap;
     KSPIN_LOCK AllocMapLock;
     ULONG AllocMapSize;
+    ULONG AllocHint;
     PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
 }
 PAGINGFILE, *PPAGINGFILE;
 
+/*
+ * A run of consecutive page file pages staged in memory. The write cluster
+ * gathers pages being paged out until they can go to disk in one request,
+ * the read cluster keeps the neighbours of the last page read from disk.
+ *
+ * MiSwapClusterLock is never held across the I/O. A cluster with I/O in
+ * flight keeps its range and buffer as they are: the write cluster can
+ * still be read from, but nothing is staged in it until IoDone is set,
+ * and the read cluster is bypassed. Pages written while it is being read
+ * are remembered in StaleMask, so that their old content is not kept.
+ */
+#define MI_SWAP_WRITE_CLUSTER (32)
+#define MI_SWAP_READ_CLUSTER  (8)
+
+typedef struct _MI_SWAP_CLUSTER
+{
+    ULONG PagingFileIndex;
+    ULONG_PTR FirstOffset;
+    ULONG Count;
+    ULONG ValidMask;
+    ULONG StaleMask;
+    BOOLEAN InFlight;
+    KEVENT IoDone;
+    PUCHAR Buffer;
+    PFN_NUMBER Pages[MI_SWAP_WRITE_CLUSTER];
+}
+MI_SWAP_CLUSTER, *PMI_SWAP_CLUSTER;
+
+C_ASSERT(MI_SWAP_WRITE_CLUSTER <= sizeof(ULONG) * 8);
+C_ASSERT(MI_SWAP_READ_CLUSTER <= MI_SWAP_WRITE_CLUSTER);
+
 typedef struct _RETRIEVEL_DESCRIPTOR_LIST
 {
     struct _RETRIEVEL_DESCRIPTOR_LIST* Next;
@@ -87,6 +119,17 @@ PFN_COUNT MiUsedSwapPages;
 
 BOOLEAN MmZeroPageFile;
 
+/* Pages and requests that went to or came from the paging files */
+ULONG MiPageFileReadCount;
+ULONG MiPageFileReadIoCount;
+ULONG MiPageFileWriteCount;
+ULONG MiPageFileWriteIoCount;
+
+/* Staged page file pages, both protected by MiSwapClusterLock */
+static MI_SWAP_CLUSTER MiSwapWriteCluster;
+static MI_SWAP_CLUSTER MiSwapReadCluster;
+static KGUARDED_MUTEX MiSwapClusterLock;
+
 /*
  * Number of pages that have been reserved for swapping but not yet allocated
  */
@@ -217,18 +260,247 @@ MmGetOffsetPageFile(PRETRIEVAL_POINTERS_BUFFER RetrievalPointers, LARGE_INTEGER
 #endif
 }
 
+static
 NTSTATUS
-NTAPI
-MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+MiPageFileIo(
+    _In_ PPAGINGFILE PagingFile,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG PageCount,
+    _In_ BOOLEAN Write)
 {
-    ULONG i;
-    ULONG_PTR offset;
-    LARGE_INTEGER file_offset;
+    LARGE_INTEGER file_offset, next_offset;
     IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
+    UCHAR MdlBase[sizeof(MDL) + MI_SWAP_WRITE_CLUSTER * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
+    ULONG Run;
+
+    ASSERT(PageCount != 0 && PageCount <= MI_SWAP_WRITE_CLUSTER);
+
+    while (PageCount)
+    {
+        file_offset.QuadPart = PageFileOffset * PAGE_SIZE;
+        file_offset = MmGetOffsetPageFile(PagingFile->RetrievalPointers, file_offset);
+
+        /* Send as many pages as are contiguous on the disk in one request */
+        for (Run = 1; Run < PageCount; Run++)
+        {
+            next_offset.QuadPart = (PageFileOffset + Run) * PAGE_SIZE;
+            next_offset = MmGetOffsetPageFile(PagingFile->RetrievalPointers, next_offset);
+            if (next_offset.QuadPart != file_offset.QuadPart + Run * PAGE_SIZE)
+                break;
+        }
+
+        MmInitializeMdl(Mdl, NULL, Run * PAGE_SIZE);
+        MmBuildMdlFromPages(Mdl, Pages);
+        Mdl->MdlFlags |= MDL_PAGES_LOCKED;
+
+        KeInitializeEvent(&Event, NotificationEvent, FALSE);
+        if (Write)
+        {
+            Status = IoSynchronousPageWrite(PagingFile->FileObject,
+                                            Mdl,
+                                            &file_offset,
+                                            &Event,
+                                            &Iosb);
+        }
+        else
+        {
+            Status = IoPageRead(PagingFile->FileObject,
+                                Mdl,
+                                &file_offset,
+                                &Event,
+                                &Iosb);
+        }
+        if (Status == STATUS_PENDING)
+        {
+            KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+            Status = Iosb.Status;
+        }
+
+        if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+        {
+            MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        }
+
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        /* Only count the transfers that made it */
+        if (Write)
+        {
+            InterlockedIncrement((PLONG)&MiPageFileWriteIoCount);
+            InterlockedExchangeAdd((PLONG)&MiPageFileWriteCount, Run);
+        }
+        else
+        {
+            InterlockedIncrement((PLONG)&MiPageFileReadIoCount);
+            InterlockedExchangeAdd((PLONG)&MiPageFileReadCount, Run);
+        }
+
+        PageFileOffset += Run;
+        Pages += Run;
+        PageCount -= Run;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+BOOLEAN
+MiLookupSwapCluster(
+    _In_ PMI_SWAP_CLUSTER Cluster,
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _Out_ PULONG Slot)
+{
+    if (Cluster->PagingFileIndex != PageFileIndex ||
+        PageFileOffset < Cluster->FirstOffset ||
+        PageFileOffset >= Cluster->FirstOffset + Cluster->Count)
+    {
+        return FALSE;
+    }
+
+    *Slot = (ULONG)(PageFileOffset - Cluster->FirstOffset);
+    return (Cluster->ValidMask & (1 << *Slot)) != 0;
+}
+
+static
+VOID
+MiInvalidateSwapReadCluster(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    PMI_SWAP_CLUSTER Cluster = &MiSwapReadCluster;
+    ULONG Slot;
+
+    /* Whatever the read cluster has or is reading for this page is stale */
+    if (Cluster->PagingFileIndex == PageFileIndex &&
+        PageFileOffset >= Cluster->FirstOffset &&
+        PageFileOffset < Cluster->FirstOffset + Cluster->Count)
+    {
+        Slot = (ULONG)(PageFileOffset - Cluster->FirstOffset);
+        Cluster->ValidMask &= ~(1 << Slot);
+        Cluster->StaleMask |= (1 << Slot);
+    }
+}
+
+static
+VOID
+MiWaitForSwapCluster(
+    _In_ PMI_SWAP_CLUSTER Cluster)
+{
+    /* Called and returns with MiSwapClusterLock held */
+    while (Cluster->InFlight)
+    {
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        KeWaitForSingleObject(&Cluster->IoDone, Executive, KernelMode, FALSE, NULL);
+        KeAcquireGuardedMutex(&MiSwapClusterLock);
+    }
+}
+
+static
+VOID
+MiCopySwapClusterPage(
+    _In_ PMI_SWAP_CLUSTER Cluster,
+    _In_ ULONG Slot,
+    _In_ PFN_NUMBER Page,
+    _In_ BOOLEAN ToCluster)
+{
+    PEPROCESS Process = PsGetCurrentProcess();
+    PVOID Address;
+    KIRQL OldIrql;
+
+    Address = MiMapPageInHyperSpace(Process, Page, &OldIrql);
+    if (ToCluster)
+        RtlCopyMemory(Cluster->Buffer + (Slot << PAGE_SHIFT), Address, PAGE_SIZE);
+    else
+        RtlCopyMemory(Address, Cluster->Buffer + (Slot << PAGE_SHIFT), PAGE_SIZE);
+    MiUnmapPageInHyperSpace(Process, Address, OldIrql);
+}
+
+static
+NTSTATUS
+MiFlushSwapWriteCluster(VOID)
+{
+    PMI_SWAP_CLUSTER Cluster = &MiSwapWriteCluster;
+    NTSTATUS Status;
+
+    /* Called and returns with MiSwapClusterLock held, which is dropped for the I/O */
+    MiWaitForSwapCluster(Cluster);
+    if (Cluster->Count == 0)
+        return STATUS_SUCCESS;
+
+    /* The cluster stays readable while it is written, but is not changed */
+    Cluster->InFlight = TRUE;
+    KeClearEvent(&Cluster->IoDone);
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
+    Status = MiPageFileIo(PagingFileList[Cluster->PagingFileIndex],
+                          Cluster->FirstOffset,
+                          Cluster->Pages,
+                          Cluster->Count,
+                          TRUE);
+
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    Cluster->InFlight = FALSE;
+    if (NT_SUCCESS(Status))
+    {
+        Cluster->Count = 0;
+        Cluster->ValidMask = 0;
+    }
+    else
+    {
+        /* Keep the pages staged, the next flush will try again */
+        DPRINT1("MM: Failed to write %lu pages to the paging file (Status 0x%.8X)\n",
+                Cluster->Count, Status);
+    }
+    KeSetEvent(&Cluster->IoDone, IO_NO_INCREMENT, FALSE);
+
+    return Status;
+}
+
+VOID
+NTAPI
+MmFlushSwapPages(VOID)
+{
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    MiFlushSwapWriteCluster();
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+}
+
+static
+NTSTATUS
+MiInitializeSwapCluster(
+    _Out_ PMI_SWAP_CLUSTER Cluster,
+    _In_ ULONG PageCount)
+{
+    ULONG i;
+
+    RtlZeroMemory(Cluster, sizeof(*Cluster));
+    KeInitializeEvent(&Cluster->IoDone, NotificationEvent, TRUE);
+    Cluster->Buffer = ExAllocatePool(NonPagedPool, PageCount * PAGE_SIZE);
+    if (Cluster->Buffer == NULL)
+        return STATUS_NO_MEMORY;
+
+    for (i = 0; i < PageCount; i++)
+    {
+        Cluster->Pages[i] = (PFN_NUMBER)(MmGetPhysicalAddress(Cluster->Buffer + i * PAGE_SIZE).QuadPart >> PAGE_SHIFT);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+NTAPI
+MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+{
+    PMI_SWAP_CLUSTER Cluster = &MiSwapWriteCluster;
+    ULONG i, Slot;
+    ULONG_PTR offset;
+    NTSTATUS Status;
 
     DPRINT("MmWriteToSwapPage\n");
 
@@ -248,30 +520,58 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
-    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
-
-    file_offset.QuadPart = offset * PAGE_SIZE;
-    file_offset = MmGetOffsetPageFile(PagingFileList[i]->RetrievalPointers, file_offset);
-
-    KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoSynchronousPageWrite(PagingFileList[i]->FileObject,
-                                    Mdl,
-                                    &file_offset,
-                                    &Event,
-                                    &Iosb);
-    if (Status == STATUS_PENDING)
+    /* Without staging buffers, write the page right away */
+    if (Cluster->Buffer == NULL)
     {
-        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
-        Status = Iosb.Status;
+        return MiPageFileIo(PagingFileList[i], offset, &Page, 1, TRUE);
     }
 
-    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+
+    MiInvalidateSwapReadCluster(i, offset);
+
+    /*
+     * Pages paged out one after the other get consecutive page file pages
+     * (see MiAllocPageFromPagingFile), so keep adding them to the cluster
+     * and only write it when the run breaks or the cluster is full. The
+     * lock is dropped while the cluster is written, so check again after.
+     */
+    for (;;)
     {
-        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        MiWaitForSwapCluster(Cluster);
+
+        if (MiLookupSwapCluster(Cluster, i, offset, &Slot))
+            break;
+
+        if (Cluster->Count != 0 &&
+            (Cluster->PagingFileIndex != i ||
+             Cluster->FirstOffset + Cluster->Count != offset ||
+             Cluster->Count == MI_SWAP_WRITE_CLUSTER))
+        {
+            Status = MiFlushSwapWriteCluster();
+            if (!NT_SUCCESS(Status))
+            {
+                KeReleaseGuardedMutex(&MiSwapClusterLock);
+                return Status;
+            }
+            continue;
+        }
+
+        if (Cluster->Count == 0)
+        {
+            Cluster->PagingFileIndex = i;
+            Cluster->FirstOffset = offset;
+        }
+
+        Slot = Cluster->Count++;
+        Cluster->ValidMask |= (1 << Slot);
+        break;
     }
-    return(Status);
+
+    MiCopySwapClusterPage(Cluster, Slot, Page, TRUE);
+
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+    return STATUS_SUCCESS;
 }
 
 
@@ -289,13 +589,11 @@ MiReadPageFile(
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset)
 {
-    LARGE_INTEGER file_offset;
-    IO_STATUS_BLOCK Iosb;
+    PMI_SWAP_CLUSTER Cluster = &MiSwapReadCluster;
     NTSTATUS Status;
-    KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
-    PMDL Mdl = (PMDL)MdlBase;
     PPAGINGFILE PagingFile;
+    ULONG Slot, Count, Pages;
+    ULONG_PTR Offset;
 
     DPRINT("MiReadSwapFile\n");
 
@@ -315,29 +613,80 @@ MiReadPageFile(
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
-    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
+    /* Without staging buffers, read the page right away */
+    if (Cluster->Buffer == NULL)
+    {
+        return MiPageFileIo(PagingFile, PageFileOffset, &Page, 1, FALSE);
+    }
+
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+
+    /* The page may not have made it to the disk yet */
+    if (MiLookupSwapCluster(&MiSwapWriteCluster, PageFileIndex, PageFileOffset, &Slot))
+    {
+        MiCopySwapClusterPage(&MiSwapWriteCluster, Slot, Page, FALSE);
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
+    }
+
+    /* Don't wait for somebody else's read ahead, just read the page */
+    if (Cluster->InFlight)
+    {
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return MiPageFileIo(PagingFile, PageFileOffset, &Page, 1, FALSE);
+    }
 
-    file_offset.QuadPart = PageFileOffset * PAGE_SIZE;
-    file_offset = MmGetOffsetPageFile(PagingFile->RetrievalPointers, file_offset);
+    /* Or it was read along with one of its neighbours */
+    if (MiLookupSwapCluster(Cluster, PageFileIndex, PageFileOffset, &Slot))
+    {
+        MiCopySwapClusterPage(Cluster, Slot, Page, FALSE);
+        Cluster->ValidMask &= ~(1 << Slot);
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
+    }
 
-    KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoPageRead(PagingFile->FileObject,
-                        Mdl,
-                        &file_offset,
-                        &Event,
-                        &Iosb);
-    if (Status == STATUS_PENDING)
+    /*
+     * Read ahead the pages following this one, as long as they are in use
+     * and their current content is on the disk rather than being staged.
+     */
+    Pages = (ULONG)(PagingFile->CurrentSize.QuadPart / PAGE_SIZE);
+    for (Count = 1; Count < MI_SWAP_READ_CLUSTER; Count++)
     {
-        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
-        Status = Iosb.Status;
+        Offset = PageFileOffset + Count;
+        if (Offset >= Pages ||
+            !(PagingFile->AllocMap[Offset / 32] & (1 << (Offset % 32))) ||
+            MiLookupSwapCluster(&MiSwapWriteCluster, PageFileIndex, Offset, &Slot))
+        {
+            break;
+        }
     }
-    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+
+    /* Claim the cluster for the range, and read it without the lock */
+    Cluster->PagingFileIndex = PageFileIndex;
+    Cluster->FirstOffset = PageFileOffset;
+    Cluster->Count = Count;
+    Cluster->ValidMask = 0;
+    Cluster->StaleMask = 0;
+    Cluster->InFlight = TRUE;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
+    Status = MiPageFileIo(PagingFile, PageFileOffset, Cluster->Pages, Count, FALSE);
+
+    /* Keep only the neighbours nobody wrote to in the meantime */
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    Cluster->InFlight = FALSE;
+    if (NT_SUCCESS(Status))
     {
-        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        Cluster->ValidMask = ((1 << Count) - 1) & ~1 & ~Cluster->StaleMask;
+        MiCopySwapClusterPage(Cluster, 0, Page, FALSE);
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
     }
-    return(Status);
+
+    /* Forget about the neighbours and just read the page we need */
+    Cluster->Count = 0;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+    return MiPageFileIo(PagingFile, PageFileOffset, &Page, 1, FALSE);
 }
 
 VOID
@@ -348,6 +697,7 @@ MmInitPagingFile(VOID)
     ULONG i;
 
     KeInitializeSpinLock(&PagingFileListLock);
+    KeInitializeGuardedMutex(&MiSwapClusterLock);
 
     MiFreeSwapPages = 0;
     MiUsedSwapPages = 0;
@@ -364,22 +714,35 @@ static ULONG
 MiAllocPageFromPagingFile(PPAGINGFILE PagingFile)
 {
     KIRQL oldIrql;
-    ULONG i, j;
+    ULONG i, Offset, Pages;
 
     KeAcquireSpinLock(&PagingFile->AllocMapLock, &oldIrql);
 
-    for (i = 0; i < PagingFile->AllocMapSize; i++)
+    /*
+     * Carry on after the page we handed out last, so pages that are paged
+     * out together also end up together in the file and can be written and
+     * read back with a single request.
+     */
+    Pages = (ULONG)(PagingFile->CurrentSize.QuadPart / PAGE_SIZE);
+    for (i = 0; i < Pages; i++)
     {
-        for (j = 0; j < 32; j++)
+        Offset = (PagingFile->AllocHint + i) % Pages;
+
+        /* Skip over fully used words */
+        if (!(Offset % 32) && PagingFile->AllocMap[Offset / 32] == 0xFFFFFFFF)
         {
-            if (!(PagingFile->AllocMap[i] & (1 << j)))
-            {
-                PagingFile->AllocMap[i] |= (1 << j);
-                PagingFile->UsedPages++;
-                PagingFile->FreePages--;
-                KeReleaseSpinLock(&PagingFile->AllocMapLock, oldIrql);
-                return((i * 32) + j);
-            }
+            i += 31;
+            continue;
+        }
+
+        if (!(PagingFile->AllocMap[Offset / 32] & (1 << (Offset % 32))))
+        {
+            PagingFile->AllocMap[Offset / 32] |= (1 << (Offset % 32));
+            PagingFile->UsedPages++;
+            PagingFile->FreePages--;
+            PagingFile->AllocHint = Offset + 1;
+            KeReleaseSpinLock(&PagingFile->AllocMapLock, oldIrql);
+            return Offset;
         }
     }
 
@@ -799,6 +1162,19 @@ NtCreatePagingFile(IN PUNICODE_STRING FileName,
         PagingFile->RetrievalPointers->Extents[i].NextVcn.QuadPart *= BytesPerAllocationUnit;
     }
 
+    /* Set up the staging buffers for clustered paging I/O along with the first file */
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    if (MiSwapWriteCluster.Buffer == NULL &&
+        NT_SUCCESS(MiInitializeSwapCluster(&MiSwapWriteCluster, MI_SWAP_WRITE_CLUSTER)))
+    {
+        if (!NT_SUCCESS(MiInitializeSwapCluster(&MiSwapReadCluster, MI_SWAP_READ_CLUSTER)))
+        {
+            ExFreePool(MiSwapWriteCluster.Buffer);
+            MiSwapWriteCluster.Buffer = NULL;
+        }
+    }
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
     KeAcquireSpinLock(&PagingFileListLock, &oldIrql);
     for (i = 0; i < MAX_PAGING_FILES; i++)
     {
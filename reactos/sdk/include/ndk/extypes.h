@@ -837,6 +837,12 @@ typedef struct _SYSTEM_PERFORMANCE_INFORMATION
     ULONG FirstLevelTbFills;
     ULONG SecondLevelTbFills;
     ULONG SystemCalls;
+#if (NTDDI_VERSION >= NTDDI_WIN10)
+    ULONGLONG CcTotalDirtyPages;
+    ULONGLONG CcDirtyPageThreshold;
+    LONGLONG ResidentAvailablePages;
+    ULONGLONG SharedCommittedPages;
+#endif
 } SYSTEM_PERFORMANCE_INFORMATION, *PSYSTEM_PERFORMANCE_INFORMATION;
 
 // Class 3
@@ -1489,8 +1495,10 @@ typedef struct _SYSTEM_FIRMWARE_TABLE_INFORMATION
     UCHAR TableBuffer[1];
 } SYSTEM_FIRMWARE_TABLE_INFORMATION, *PSYSTEM_FIRMWARE_TABLE_INFORMATION;
 
+#endif // !NTOS_MODE_USER
+
 //
-// Class 81
+// Class 80
 //
 typedef struct _SYSTEM_MEMORY_LIST_INFORMATION
 {
@@ -1504,8 +1512,6 @@ typedef struct _SYSTEM_MEMORY_LIST_INFORMATION
    SIZE_T ModifiedPageCountPageFile;
 } SYSTEM_MEMORY_LIST_INFORMATION, *PSYSTEM_MEMORY_LIST_INFORMATION;
 
-#endif // !NTOS_MODE_USER
-
 #ifdef __cplusplus
 }; // extern "C"
 #endif
@@ -116,6 +116,27 @@
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(DWORD))
          && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
 
+/*
+ * The decoded instruction cache is direct-mapped on the linear address.
+ * Writes are tracked per code line, an instruction is decoded again
+ * once the line holding its prefixes and opcode has been written to.
+ */
+#define FAST486_INST_CACHE_ENTRIES  2048
+#define FAST486_INST_CACHE_LINES    4096
+#define FAST486_INST_LINE_SHIFT     6
+
+C_ASSERT(((FAST486_INST_CACHE_ENTRIES & (FAST486_INST_CACHE_ENTRIES - 1)) == 0)
+         && ((FAST486_INST_CACHE_LINES & (FAST486_INST_CACHE_LINES - 1)) == 0));
+
+/*
+ * The host TLB is direct-mapped on the linear page. It points straight
+ * to the host memory of the pages the MemMapCallback reported as plain
+ * memory, so that accesses within such a page skip the memory callbacks.
+ */
+#define FAST486_HOST_TLB_ENTRIES    256
+
+C_ASSERT((FAST486_HOST_TLB_ENTRIES & (FAST486_HOST_TLB_ENTRIES - 1)) == 0);
+
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
 
@@ -200,6 +221,16 @@ VOID
     ULONG Size
 );
 
+typedef
+BOOLEAN
+(FASTCALL *FAST486_MEM_MAP_PROC)
+(
+    PFAST486_STATE State,
+    ULONG Address,
+    BOOLEAN Writing,
+    PVOID *HostAddress
+);
+
 typedef
 VOID
 (FASTCALL *FAST486_IO_READ_PROC)
@@ -244,6 +275,14 @@ VOID
     PFAST486_STATE State
 );
 
+typedef
+VOID
+(FASTCALL *FAST486_INST_HANDLER_PROC)
+(
+    PFAST486_STATE State,
+    UCHAR Opcode
+);
+
 typedef union _FAST486_REG
 {
     union
@@ -459,6 +498,30 @@ typedef union _FAST486_FLAGS_REG
     };
 } FAST486_FLAGS_REG, *PFAST486_FLAGS_REG;
 
+typedef enum _FAST486_LAZY_OPERATION
+{
+    FAST486_LAZY_NONE,
+    FAST486_LAZY_ADD,
+    FAST486_LAZY_SUB,
+    FAST486_LAZY_LOGIC,
+    FAST486_LAZY_INC,
+    FAST486_LAZY_DEC
+} FAST486_LAZY_OPERATION, *PFAST486_LAZY_OPERATION;
+
+/*
+ * CF, PF, AF, ZF, SF and OF as left by the last arithmetic operation,
+ * they are only computed into the flags register when something reads it.
+ * INC and DEC don't change CF, it is already in the flags register then.
+ */
+typedef struct _FAST486_LAZY_FLAGS
+{
+    FAST486_LAZY_OPERATION Operation;
+    ULONG SignFlag;
+    ULONG FirstValue;
+    ULONG SecondValue;
+    ULONG Result;
+} FAST486_LAZY_FLAGS, *PFAST486_LAZY_FLAGS;
+
 typedef struct _FAST486_FPU_DATA_REG
 {
     ULONGLONG Mantissa;
@@ -511,10 +574,32 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+typedef struct _FAST486_INST_CACHE_ENTRY
+{
+    ULONG Address;      /* Linear address of the first prefix */
+    ULONG Generation;   /* Cache and code line generations when decoded */
+    FAST486_INST_HANDLER_PROC Handler;
+    ULONG PrefixFlags;
+    UCHAR SegmentOverride;
+    UCHAR Opcode;
+    UCHAR Length;       /* Prefixes and opcode bytes */
+    UCHAR Cpl;
+    BOOLEAN KeepsLazyFlags;
+} FAST486_INST_CACHE_ENTRY, *PFAST486_INST_CACHE_ENTRY;
+
+typedef struct _FAST486_HOST_TLB_ENTRY
+{
+    ULONG ReadTag;      /* Linear page and privilege level, 0 if unused */
+    ULONG WriteTag;
+    PUCHAR ReadPage;    /* Host address of the page */
+    PUCHAR WritePage;
+} FAST486_HOST_TLB_ENTRY, *PFAST486_HOST_TLB_ENTRY;
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback;
+    FAST486_MEM_MAP_PROC MemMapCallback;
     FAST486_IO_READ_PROC IoReadCallback;
     FAST486_IO_WRITE_PROC IoWriteCallback;
     FAST486_BOP_PROC BopCallback;
@@ -525,6 +610,7 @@ struct _FAST486_STATE
     FAST486_REG InstPtr, SavedInstPtr;
     FAST486_REG SavedStackPtr;
     FAST486_FLAGS_REG Flags;
+    FAST486_LAZY_FLAGS LazyFlags;
     FAST486_TABLE_REG Gdtr, Idtr;
     FAST486_LDT_REG Ldtr;
     FAST486_TASK_REG TaskReg;
@@ -539,11 +625,19 @@ struct _FAST486_STATE
     BOOLEAN DoNotInterrupt;
     PULONG Tlb;
     BOOLEAN TlbEmpty;
+#ifndef FAST486_NO_HOST_TLB
+    FAST486_HOST_TLB_ENTRY HostTlb[FAST486_HOST_TLB_ENTRIES];
+#endif
 #ifndef FAST486_NO_PREFETCH
     BOOLEAN PrefetchValid;
     ULONG PrefetchAddress;
     UCHAR PrefetchCache[FAST486_CACHE_SIZE];
 #endif
+#ifndef FAST486_NO_INST_CACHE
+    ULONG InstCacheGeneration;
+    ULONG InstLineGeneration[FAST486_INST_CACHE_LINES];
+    FAST486_INST_CACHE_ENTRY InstCache[FAST486_INST_CACHE_ENTRIES];
+#endif
 #ifndef FAST486_NO_FPU
     FAST486_FPU_DATA_REG FpuRegisters[FAST486_NUM_FPU_REGS];
     FAST486_FPU_STATUS_REG FpuStatus;
@@ -563,6 +657,7 @@ NTAPI
 Fast486Initialize(PFAST486_STATE         State,
                   FAST486_MEM_READ_PROC  MemReadCallback,
                   FAST486_MEM_WRITE_PROC MemWriteCallback,
+                  FAST486_MEM_MAP_PROC   MemMapCallback,
                   FAST486_IO_READ_PROC   IoReadCallback,
                   FAST486_IO_WRITE_PROC  IoWriteCallback,
                   FAST486_BOP_PROC       BopCallback,
@@ -619,6 +714,18 @@ VOID
 NTAPI
 Fast486Rewind(PFAST486_STATE State);
 
+VOID
+NTAPI
+Fast486InvalidateCache(PFAST486_STATE State, ULONG Address, ULONG Size);
+
+VOID
+NTAPI
+Fast486UpdateFlags(PFAST486_STATE State);
+
+VOID
+NTAPI
+Fast486FlushMemoryMap(PFAST486_STATE State);
+
 #endif // _FAST486_H_
 
 /* EOF */
@@ -439,6 +439,16 @@ NTAPI
 MmIsNonPagedSystemAddressValid(
   _In_ PVOID VirtualAddress);
 
+_IRQL_requires_max_(APC_LEVEL)
+NTKERNELAPI
+VOID
+NTAPI
+MmProbeAndLockSelectedPages(
+  _Inout_ PMDL MemoryDescriptorList,
+  _In_ PFILE_SEGMENT_ELEMENT SegmentArray,
+  _In_ KPROCESSOR_MODE AccessMode,
+  _In_ LOCK_OPERATION Operation);
+
 _Must_inspect_result_
 _IRQL_requires_max_(APC_LEVEL)
 _Out_writes_bytes_opt_(NumberOfBytes)
@@ -402,6 +402,15 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     /* Couldn't read: assume it's not a hive */
     if (!Result) return NotHive;
 
+    /* An update of the hive file was interrupted, the log has the missing data */
+    if ((BaseBlock->Signature == HV_SIGNATURE) &&
+        (BaseBlock->Sequence1 != BaseBlock->Sequence2))
+    {
+        *HiveBaseBlock = BaseBlock;
+        *TimeStamp = BaseBlock->TimeStamp;
+        return RecoverData;
+    }
+
     /* Do validation */
     if (!HvpVerifyHiveHeader(BaseBlock)) return NotHive;
 
@@ -411,6 +420,134 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     return HiveSuccess;
 }
 
+/**
+ * @name HvpRecoverHiveFromLog
+ *
+ * Internal function to rebuild a hive whose last update did not complete,
+ * by replaying the dirty blocks saved in its log file over the hive file.
+ */
+static NTSTATUS CMAPI
+HvpRecoverHiveFromLog(IN PHHIVE Hive,
+                      IN PCUNICODE_STRING FileName OPTIONAL)
+{
+    NTSTATUS Status;
+    PHBASE_BLOCK LogBase = NULL;
+    PUCHAR Header = NULL;
+    PUCHAR HiveData = NULL;
+    RTL_BITMAP DirtyVector;
+    ULONG Offset, PrimaryOffset, BlockCount, BitmapSize, HeaderSize, FileSize;
+    ULONG BlockIndex, Run;
+    BOOLEAN Dirty, Success;
+
+    /* Read and check the header the log was written with */
+    LogBase = Hive->Allocate(HBLOCK_SIZE, TRUE, TAG_CM);
+    if (!LogBase) return STATUS_INSUFFICIENT_RESOURCES;
+
+    Offset = 0;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, LogBase, HBLOCK_SIZE) ||
+        LogBase->Signature != HV_SIGNATURE ||
+        LogBase->Type != HFILE_TYPE_LOG ||
+        LogBase->Sequence1 != LogBase->Sequence2 ||
+        LogBase->CheckSum != HvpHiveHeaderChecksum(LogBase) ||
+        (LogBase->Length % HBLOCK_SIZE) != 0 ||
+        memcmp((PUCHAR)LogBase + HV_LOG_HEADER_SIZE, "DIRT", 4) != 0)
+    {
+        DPRINT1("No usable log to recover the hive from\n");
+        Status = STATUS_REGISTRY_CORRUPT;
+        goto Quit;
+    }
+
+    /* Now get the whole log header, with the dirty block bitmap */
+    BlockCount = LogBase->Length / HBLOCK_SIZE;
+    BitmapSize = ROUND_UP(BlockCount, sizeof(ULONG) * 8) / 8;
+    HeaderSize = ROUND_UP(HV_LOG_HEADER_SIZE + sizeof(ULONG) + BitmapSize, HBLOCK_SIZE);
+    Header = Hive->Allocate(HeaderSize, TRUE, TAG_CM);
+    FileSize = HBLOCK_SIZE + LogBase->Length;
+    HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
+    if (!Header || !HiveData)
+    {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Quit;
+    }
+
+    Offset = 0;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, Header, HeaderSize))
+    {
+        Status = STATUS_REGISTRY_CORRUPT;
+        goto Quit;
+    }
+    RtlInitializeBitMap(&DirtyVector,
+                        (PULONG)(Header + HV_LOG_HEADER_SIZE + sizeof(ULONG)),
+                        BlockCount);
+
+    /*
+     * Clean blocks come from the hive file, dirty ones from the log. Blocks the
+     * hive grew by are all dirty, so the hive file doesn't need to have them.
+     */
+    RtlZeroMemory(HiveData, FileSize);
+    Offset = HeaderSize;
+    BlockIndex = 0;
+    while (BlockIndex < BlockCount)
+    {
+        Dirty = RtlCheckBit(&DirtyVector, BlockIndex);
+        for (Run = 1; BlockIndex + Run < BlockCount; Run++)
+        {
+            if (RtlCheckBit(&DirtyVector, BlockIndex + Run) != Dirty)
+                break;
+        }
+
+        if (Dirty)
+        {
+            Success = Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset,
+                                     HiveData + (BlockIndex + 1) * HBLOCK_SIZE,
+                                     Run * HBLOCK_SIZE);
+            Offset += Run * HBLOCK_SIZE;
+        }
+        else
+        {
+            PrimaryOffset = (BlockIndex + 1) * HBLOCK_SIZE;
+            Success = Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &PrimaryOffset,
+                                     HiveData + PrimaryOffset,
+                                     Run * HBLOCK_SIZE);
+        }
+        if (!Success)
+        {
+            Status = STATUS_REGISTRY_CORRUPT;
+            goto Quit;
+        }
+
+        BlockIndex += Run;
+    }
+
+    /* The header comes from the log as well */
+    RtlCopyMemory(HiveData, LogBase, HV_LOG_HEADER_SIZE);
+    ((PHBASE_BLOCK)HiveData)->Type = HFILE_TYPE_PRIMARY;
+    ((PHBASE_BLOCK)HiveData)->CheckSum = HvpHiveHeaderChecksum((PHBASE_BLOCK)HiveData);
+
+    Status = HvpInitializeMemoryHive(Hive, (PHBASE_BLOCK)HiveData, FileName);
+    if (!NT_SUCCESS(Status))
+        goto Quit;
+
+    /* Mark what we replayed dirty, so that the next sync fixes the hive file */
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex++)
+    {
+        if (RtlCheckBit(&DirtyVector, BlockIndex))
+        {
+            RtlSetBits(&Hive->DirtyVector, BlockIndex, 1);
+            Hive->DirtyCount++;
+        }
+    }
+
+    DPRINT1("Hive recovered from its log, %lu blocks replayed\n", (unsigned long)Hive->DirtyCount);
+
+Quit:
+    /* HvpInitializeMemoryHive copies what it keeps, none of this is needed anymore */
+    if (HiveData) Hive->Free(HiveData, FileSize);
+    if (Header) Hive->Free(Header, HeaderSize);
+    Hive->Free(LogBase, HBLOCK_SIZE);
+    return Status;
+}
+
 NTSTATUS CMAPI
 HvLoadHive(IN PHHIVE Hive,
            IN PCUNICODE_STRING FileName OPTIONAL)
@@ -441,6 +578,15 @@ HvLoadHive(IN PHHIVE Hive,
 
         /* Has recovery data */
         case RecoverData:
+
+            /* Replay the log over it if we have one */
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            if (Hive->Log)
+                return HvpRecoverHiveFromLog(Hive, FileName);
+
+            /* Without one, this is as good as no hive at all */
+            return STATUS_NOT_REGISTRY_FILE;
+
         case RecoverHeader:
 
             /* Fail */
@@ -480,10 +626,9 @@ HvLoadHive(IN PHHIVE Hive,
     /* Free our base block... it's usless in this implementation */
     Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
 
-    /* Initialize the hive directly from memory */
+    /* Initialize the hive directly from memory, it keeps a copy of the data */
     Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
-    if (!NT_SUCCESS(Status))
-        Hive->Free(HiveData, FileSize);
+    Hive->Free(HiveData, FileSize);
 
     return Status;
 }
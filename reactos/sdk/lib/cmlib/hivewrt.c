@@ -9,9 +9,102 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Number of blocks gathered into a single write when dirty blocks cross bins */
+#define HV_WRITE_CLUSTER_BLOCKS 16
+
+/*
+ * Find the next run of dirty blocks at or after *BlockIndex.
+ * Returns the number of blocks in the run, 0 when there are none left.
+ */
+static ULONG CMAPI
+HvpFindDirtyRun(
+    PHHIVE RegistryHive,
+    PULONG BlockIndex)
+{
+    ULONG Length = RegistryHive->Storage[Stable].Length;
+    ULONG Start, End;
+
+    if (*BlockIndex >= Length)
+    {
+        return 0;
+    }
+
+    Start = RtlFindSetBits(&RegistryHive->DirtyVector, 1, *BlockIndex);
+    if (Start == ~0U || Start < *BlockIndex || Start >= Length)
+    {
+        return 0;
+    }
+
+    End = Start + 1;
+    while (End < Length && RtlCheckBit(&RegistryHive->DirtyVector, End))
+    {
+        End++;
+    }
+
+    *BlockIndex = Start;
+    return End - Start;
+}
+
+/*
+ * Write BlockCount blocks starting at BlockIndex to consecutive offsets of
+ * the given file. Blocks of the same bin follow each other in memory and go
+ * out with one request, blocks of different bins are first gathered in the
+ * staging buffer (if we have one) so that the run still does.
+ */
+static BOOLEAN CMAPI
+HvpWriteBlockRun(
+    PHHIVE RegistryHive,
+    ULONG FileType,
+    ULONG FileOffset,
+    ULONG BlockIndex,
+    ULONG BlockCount,
+    PUCHAR Staging)
+{
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    PUCHAR BlockPtr;
+    ULONG Run, i;
+    BOOLEAN Success;
+
+    while (BlockCount)
+    {
+        BlockPtr = (PUCHAR)BlockList[BlockIndex].BlockAddress;
+        for (Run = 1; Run < BlockCount; Run++)
+        {
+            if ((PUCHAR)BlockList[BlockIndex + Run].BlockAddress != BlockPtr + Run * HBLOCK_SIZE)
+                break;
+        }
+
+        if (Staging && Run < BlockCount && Run < HV_WRITE_CLUSTER_BLOCKS)
+        {
+            Run = (BlockCount < HV_WRITE_CLUSTER_BLOCKS) ? BlockCount : HV_WRITE_CLUSTER_BLOCKS;
+            for (i = 0; i < Run; i++)
+            {
+                RtlCopyMemory(Staging + i * HBLOCK_SIZE,
+                              (PVOID)BlockList[BlockIndex + i].BlockAddress,
+                              HBLOCK_SIZE);
+            }
+            BlockPtr = Staging;
+        }
+
+        Success = RegistryHive->FileWrite(RegistryHive, FileType,
+                                          &FileOffset, BlockPtr, Run * HBLOCK_SIZE);
+        if (!Success)
+        {
+            return FALSE;
+        }
+
+        FileOffset += Run * HBLOCK_SIZE;
+        BlockIndex += Run;
+        BlockCount -= Run;
+    }
+
+    return TRUE;
+}
+
 static BOOLEAN CMAPI
 HvpWriteLog(
-    PHHIVE RegistryHive)
+    PHHIVE RegistryHive,
+    PUCHAR Staging)
 {
     ULONG FileOffset;
     UINT32 BufferSize;
@@ -19,16 +112,8 @@ HvpWriteLog(
     PUCHAR Buffer;
     PUCHAR Ptr;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG BlockCount;
     BOOLEAN Success;
-    static ULONG PrintCount = 0;
-
-    if (PrintCount++ == 0)
-    {
-        UNIMPLEMENTED;
-    }
-    return TRUE;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -42,7 +127,12 @@ HvpWriteLog(
         return FALSE;
     }
 
-    BitmapSize = RegistryHive->DirtyVector.SizeOfBitMap;
+    /*
+     * The log starts with the hive header, followed by the "DIRT" signature
+     * and one bit per hive block. The dirty blocks follow, in block order.
+     */
+    BitmapSize = ROUND_UP(RegistryHive->Storage[Stable].Length,
+                          sizeof(ULONG) * 8) / 8;
     BufferSize = HV_LOG_HEADER_SIZE + sizeof(ULONG) + BitmapSize;
     BufferSize = ROUND_UP(BufferSize, HBLOCK_SIZE);
 
@@ -78,30 +168,20 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Write dirty blocks */
+    /* Write dirty blocks, one request per run */
     FileOffset = BufferSize;
     BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    while ((BlockCount = HvpFindDirtyRun(RegistryHive, &BlockIndex)) != 0)
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
-        {
-            break;
-        }
-
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
-
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
+        Success = HvpWriteBlockRun(RegistryHive, HFILE_TYPE_LOG, FileOffset,
+                                   BlockIndex, BlockCount, Staging);
         if (!Success)
         {
             return FALSE;
         }
 
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
+        BlockIndex += BlockCount;
+        FileOffset += BlockCount * HBLOCK_SIZE;
     }
 
     Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
@@ -146,12 +226,12 @@ HvpWriteLog(
 static BOOLEAN CMAPI
 HvpWriteHive(
     PHHIVE RegistryHive,
-    BOOLEAN OnlyDirty)
+    BOOLEAN OnlyDirty,
+    PUCHAR Staging)
 {
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG BlockCount;
     BOOLEAN Success;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
@@ -182,31 +262,32 @@ HvpWriteHive(
         return FALSE;
     }
 
+    /* Write the blocks in place, a run of them at a time */
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
         if (OnlyDirty)
         {
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~0U || BlockIndex < LastIndex)
+            BlockCount = HvpFindDirtyRun(RegistryHive, &BlockIndex);
+            if (BlockCount == 0)
             {
                 break;
             }
         }
+        else
+        {
+            BlockCount = RegistryHive->Storage[Stable].Length - BlockIndex;
+        }
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
-        FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
-
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
+        Success = HvpWriteBlockRun(RegistryHive, HFILE_TYPE_PRIMARY,
+                                   (BlockIndex + 1) * HBLOCK_SIZE,
+                                   BlockIndex, BlockCount, Staging);
         if (!Success)
         {
             return FALSE;
         }
 
-        BlockIndex++;
+        BlockIndex += BlockCount;
     }
 
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
@@ -243,6 +324,9 @@ BOOLEAN CMAPI
 HvSyncHive(
     PHHIVE RegistryHive)
 {
+    PUCHAR Staging;
+    BOOLEAN Success;
+
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
     if (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) == ~0U)
@@ -253,14 +337,23 @@ HvSyncHive(
     /* Update hive header modification time */
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
-    /* Update log file */
-    if (!HvpWriteLog(RegistryHive))
+    /* Staging buffer for gathering writes, we can do without if it fails */
+    Staging = RegistryHive->Allocate(HV_WRITE_CLUSTER_BLOCKS * HBLOCK_SIZE, TRUE, TAG_CM);
+
+    /*
+     * Update the log file first, so the dirty blocks can be replayed if we
+     * get interrupted while updating the hive file in place.
+     */
+    if (RegistryHive->Log && !HvpWriteLog(RegistryHive, Staging))
     {
+        if (Staging) RegistryHive->Free(Staging, 0);
         return FALSE;
     }
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, TRUE))
+    Success = HvpWriteHive(RegistryHive, TRUE, Staging);
+    if (Staging) RegistryHive->Free(Staging, 0);
+    if (!Success)
     {
         return FALSE;
     }
@@ -291,7 +384,7 @@ HvWriteHive(
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, FALSE))
+    if (!HvpWriteHive(RegistryHive, FALSE, NULL))
     {
         return FALSE;
     }
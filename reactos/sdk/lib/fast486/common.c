@@ -246,6 +246,58 @@ Fast486WriteMemory(PFAST486_STATE State,
     return Fast486WriteLinearMemory(State, LinearAddress, Buffer, Size, TRUE);
 }
 
+#ifndef FAST486_NO_HOST_TLB
+
+BOOLEAN
+FASTCALL
+Fast486FillHostTlb(PFAST486_STATE State,
+                   ULONG Tag,
+                   BOOLEAN Writing)
+{
+    ULONG Address = PAGE_ALIGN(Tag);
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[HOST_TLB_INDEX(Address)];
+    PVOID HostAddress;
+
+    /* The host doesn't give out its memory */
+    if (State->MemMapCallback == NULL) return FALSE;
+
+    if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
+    {
+        FAST486_PAGE_TABLE TableEntry;
+
+        /* Get the table entry, a write marks it as dirty */
+        TableEntry.Value = Fast486GetPageTableEntry(State, Address, Writing);
+
+        /* Leave anything that may fault to the slow path */
+        if (!TableEntry.Present
+            || ((Tag & HOST_TLB_USER) && !TableEntry.Usermode)
+            || (Writing && !TableEntry.Writeable))
+        {
+            return FALSE;
+        }
+
+        Address = TableEntry.Address << 12;
+    }
+
+    /* Check if that physical page is plain memory */
+    if (!State->MemMapCallback(State, Address, Writing, &HostAddress)) return FALSE;
+
+    if (Writing)
+    {
+        Entry->WriteTag = Tag;
+        Entry->WritePage = (PUCHAR)HostAddress;
+    }
+    else
+    {
+        Entry->ReadTag = Tag;
+        Entry->ReadPage = (PUCHAR)HostAddress;
+    }
+
+    return TRUE;
+}
+
+#endif
+
 static inline BOOLEAN
 FASTCALL
 Fast486GetIntVector(PFAST486_STATE State,
@@ -304,9 +356,13 @@ Fast486InterruptInternal(PFAST486_STATE State,
                        (IdtEntry->Type == FAST486_IDT_TRAP_GATE_32);
     USHORT OldCs = State->SegmentRegs[FAST486_REG_CS].Selector;
     ULONG OldEip = State->InstPtr.Long;
-    ULONG OldFlags = State->Flags.Long;
+    ULONG OldFlags;
     UCHAR OldCpl = State->Cpl;
 
+    /* The flags being saved must be up to date */
+    Fast486ResolveFlags(State);
+    OldFlags = State->Flags.Long;
+
     /* Check for protected mode */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PE)
     {
@@ -632,6 +688,9 @@ Fast486TaskSwitch(PFAST486_STATE State, FAST486_TASK_SWITCH_TYPE Type, USHORT Se
     PFAST486_LEGACY_TSS NewLegacyTss = (PFAST486_LEGACY_TSS)&NewTss;
     USHORT NewLdtr, NewEs, NewCs, NewSs, NewDs;
 
+    /* The flags being saved must be up to date */
+    Fast486ResolveFlags(State);
+
     if ((State->TaskReg.Modern && State->TaskReg.Limit < (sizeof(FAST486_TSS) - 1))
         || (!State->TaskReg.Modern && State->TaskReg.Limit < (sizeof(FAST486_LEGACY_TSS) - 1)))
     {
@@ -894,8 +953,9 @@ Fast486TaskSwitch(PFAST486_STATE State, FAST486_TASK_SWITCH_TYPE Type, USHORT Se
         State->ControlRegisters[FAST486_REG_CR3] = NewTss.Cr3;
     }
 
-    /* Flush the TLB */
+    /* Flush the TLB and the decoded instructions */
     Fast486FlushTlb(State);
+    Fast486FlushInstCache(State);
 
     /* Update the CPL */
     if (NewTssDescriptor.Signature == FAST486_BUSY_TSS_SIGNATURE)
@@ -39,6 +39,7 @@
 #define GET_SEGMENT_INDEX(s)        ((s) & 0xFFF8u)
 #define SEGMENT_TABLE_INDICATOR     (1 << 2)
 #define EXCEPTION_HAS_ERROR_CODE(x) (((x) == 8) || ((x) >= 10 && (x) <= 14))
+#define FAST486_MAX_INST_LENGTH     15
 
 #define NO_LOCK_PREFIX()\
 if (State->PrefixFlags & FAST486_PREFIX_LOCK)\
@@ -70,6 +71,9 @@ if (State->PrefixFlags & FAST486_PREFIX_LOCK)\
 #define GET_ADDR_PTE(x) (((x) >> 12) & 0x3FF)
 #define INVALID_TLB_FIELD 0xFFFFFFFF
 #define NUM_TLB_ENTRIES 0x100000
+#define HOST_TLB_INDEX(x) (((x) >> 12) & (FAST486_HOST_TLB_ENTRIES - 1))
+#define HOST_TLB_SUPERVISOR (1 << 0)
+#define HOST_TLB_USER (1 << 1)
 
 typedef struct _FAST486_MOD_REG_RM
 {
@@ -194,6 +198,19 @@ Fast486CallGate
     BOOLEAN Call
 );
 
+#ifndef FAST486_NO_HOST_TLB
+
+BOOLEAN
+FASTCALL
+Fast486FillHostTlb
+(
+    PFAST486_STATE State,
+    ULONG Tag,
+    BOOLEAN Writing
+);
+
+#endif
+
 /* INLINED FUNCTIONS **********************************************************/
 
 #include "common.inl"
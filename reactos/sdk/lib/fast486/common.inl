@@ -145,16 +145,121 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
     return TableEntry.Value;
 }
 
+#ifndef FAST486_NO_HOST_TLB
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushHostTlb(PFAST486_STATE State)
+{
+    RtlZeroMemory(State->HostTlb, sizeof(State->HostTlb));
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486InvalidateHostTlbPage(PFAST486_STATE State, ULONG LinearAddress)
+{
+    PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[HOST_TLB_INDEX(LinearAddress)];
+
+    Entry->ReadTag = 0;
+    Entry->WriteTag = 0;
+}
+
+FORCEINLINE
+ULONG
+FASTCALL
+Fast486GetHostTlbTag(PFAST486_STATE State,
+                     ULONG LinearAddress,
+                     BOOLEAN CheckPrivilege)
+{
+    /* Pages accessible to the supervisor only mustn't be reused for user accesses */
+    return PAGE_ALIGN(LinearAddress)
+           | ((CheckPrivilege && (Fast486GetCurrentPrivLevel(State) > 0))
+              ? HOST_TLB_USER : HOST_TLB_SUPERVISOR);
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486MoveHostMemory(PVOID Destination, const VOID *Source, ULONG Size)
+{
+    /* Most accesses are small, don't go through RtlMoveMemory for those */
+    switch (Size)
+    {
+        case sizeof(UCHAR):
+            *(PUCHAR)Destination = *(const UCHAR *)Source;
+            break;
+
+        case sizeof(USHORT):
+            *(USHORT UNALIGNED *)Destination = *(const USHORT UNALIGNED *)Source;
+            break;
+
+        case sizeof(ULONG):
+            *(ULONG UNALIGNED *)Destination = *(const ULONG UNALIGNED *)Source;
+            break;
+
+        default:
+            RtlMoveMemory(Destination, Source, Size);
+    }
+}
+
+#endif
+
 FORCEINLINE
 VOID
 FASTCALL
 Fast486FlushTlb(PFAST486_STATE State)
 {
+#ifndef FAST486_NO_HOST_TLB
+    /* The host TLB holds translations too */
+    Fast486FlushHostTlb(State);
+#endif
+
     if (!State->Tlb || State->TlbEmpty) return;
     RtlFillMemory(State->Tlb, NUM_TLB_ENTRIES * sizeof(ULONG), 0xFF);
     State->TlbEmpty = TRUE;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushInstCache(PFAST486_STATE State)
+{
+#ifndef FAST486_NO_INST_CACHE
+    /* Every entry was decoded with an older generation */
+    State->InstCacheGeneration++;
+#endif
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486InvalidateCodeLines(PFAST486_STATE State,
+                           ULONG LinearAddress,
+                           ULONG Size)
+{
+#ifndef FAST486_NO_INST_CACHE
+    ULONG Line, LastLine;
+
+    if (Size == 0) return;
+
+    Line = LinearAddress >> FAST486_INST_LINE_SHIFT;
+    LastLine = (LinearAddress + Size - 1) >> FAST486_INST_LINE_SHIFT;
+
+    if ((LastLine - Line) >= FAST486_INST_CACHE_LINES)
+    {
+        /* Too large (or wrapping around), flush everything */
+        Fast486FlushInstCache(State);
+        return;
+    }
+
+    /* Bump the generation of every line written to */
+    do State->InstLineGeneration[Line & (FAST486_INST_CACHE_LINES - 1)]++;
+    while (Line++ != LastLine);
+#endif
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -164,6 +269,21 @@ Fast486ReadLinearMemory(PFAST486_STATE State,
                         ULONG Size,
                         BOOLEAN CheckPrivilege)
 {
+#ifndef FAST486_NO_HOST_TLB
+    if ((PAGE_OFFSET(LinearAddress) + Size) <= FAST486_PAGE_SIZE)
+    {
+        ULONG Tag = Fast486GetHostTlbTag(State, LinearAddress, CheckPrivilege);
+        PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[HOST_TLB_INDEX(LinearAddress)];
+
+        /* Read plain memory directly */
+        if ((Entry->ReadTag == Tag) || Fast486FillHostTlb(State, Tag, FALSE))
+        {
+            Fast486MoveHostMemory(Buffer, &Entry->ReadPage[PAGE_OFFSET(LinearAddress)], Size);
+            return TRUE;
+        }
+    }
+#endif
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -234,6 +354,24 @@ Fast486WriteLinearMemory(PFAST486_STATE State,
                          ULONG Size,
                          BOOLEAN CheckPrivilege)
 {
+    /* Code decoded from there must be decoded again */
+    Fast486InvalidateCodeLines(State, LinearAddress, Size);
+
+#ifndef FAST486_NO_HOST_TLB
+    if ((PAGE_OFFSET(LinearAddress) + Size) <= FAST486_PAGE_SIZE)
+    {
+        ULONG Tag = Fast486GetHostTlbTag(State, LinearAddress, CheckPrivilege);
+        PFAST486_HOST_TLB_ENTRY Entry = &State->HostTlb[HOST_TLB_INDEX(LinearAddress)];
+
+        /* Write plain memory directly */
+        if ((Entry->WriteTag == Tag) || Fast486FillHostTlb(State, Tag, TRUE))
+        {
+            Fast486MoveHostMemory(&Entry->WritePage[PAGE_OFFSET(LinearAddress)], Buffer, Size);
+            return TRUE;
+        }
+    }
+#endif
+
     /* Check if paging is enabled */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
     {
@@ -1013,6 +1151,104 @@ Fast486CalculateParity(UCHAR Number)
     return (0x9669 >> ((Number & 0x0F) ^ (Number >> 4))) & 1;
 }
 
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486LazyCarry(PFAST486_STATE State)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+
+    switch (LazyFlags->Operation)
+    {
+        case FAST486_LAZY_ADD:
+            return (LazyFlags->Result < LazyFlags->FirstValue);
+
+        case FAST486_LAZY_SUB:
+            return (LazyFlags->FirstValue < LazyFlags->SecondValue);
+
+        case FAST486_LAZY_LOGIC:
+            return FALSE;
+
+        default:
+            /* Nothing pending, or INC/DEC which keep CF */
+            return State->Flags.Cf;
+    }
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486ResolveFlags(PFAST486_STATE State)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+    ULONG FirstValue = LazyFlags->FirstValue;
+    ULONG SecondValue = LazyFlags->SecondValue;
+    ULONG Result = LazyFlags->Result;
+
+    if (LazyFlags->Operation == FAST486_LAZY_NONE) return;
+
+    State->Flags.Cf = Fast486LazyCarry(State);
+
+    switch (LazyFlags->Operation)
+    {
+        case FAST486_LAZY_ADD:
+        case FAST486_LAZY_INC:
+        {
+            State->Flags.Of = (((FirstValue ^ Result) & (SecondValue ^ Result) & LazyFlags->SignFlag) != 0);
+            State->Flags.Af = (((FirstValue ^ SecondValue ^ Result) & 0x10) != 0);
+            break;
+        }
+
+        case FAST486_LAZY_SUB:
+        case FAST486_LAZY_DEC:
+        {
+            State->Flags.Of = (((FirstValue ^ SecondValue) & (FirstValue ^ Result) & LazyFlags->SignFlag) != 0);
+            State->Flags.Af = (((FirstValue ^ SecondValue ^ Result) & 0x10) != 0);
+            break;
+        }
+
+        default:
+        {
+            /* AF is undefined after a logical operation, clear it */
+            State->Flags.Of = FALSE;
+            State->Flags.Af = FALSE;
+            break;
+        }
+    }
+
+    State->Flags.Zf = (Result == 0);
+    State->Flags.Sf = ((Result & LazyFlags->SignFlag) != 0);
+    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
+
+    LazyFlags->Operation = FAST486_LAZY_NONE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486SetLazyFlags(PFAST486_STATE State,
+                    FAST486_LAZY_OPERATION Operation,
+                    ULONG FirstValue,
+                    ULONG SecondValue,
+                    ULONG Result,
+                    ULONG SignFlag)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+
+    if ((Operation == FAST486_LAZY_INC) || (Operation == FAST486_LAZY_DEC))
+    {
+        /* These don't change CF, take it from the pending operation */
+        State->Flags.Cf = Fast486LazyCarry(State);
+    }
+
+    /* The values must be truncated to the operand size */
+    LazyFlags->Operation = Operation;
+    LazyFlags->SignFlag = SignFlag;
+    LazyFlags->FirstValue = FirstValue;
+    LazyFlags->SecondValue = SecondValue;
+    LazyFlags->Result = Result;
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
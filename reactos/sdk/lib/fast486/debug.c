@@ -29,6 +29,7 @@
 #include <fast486.h>
 #include "common.h"
 #include "opcodes.h"
+#include "extraops.h"
 #include "fpu.h"
 
 /* DEFINES ********************************************************************/
@@ -43,6 +44,145 @@ typedef enum
 
 /* PRIVATE FUNCTIONS **********************************************************/
 
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486KeepsLazyFlags(UCHAR Opcode)
+{
+    /*
+     * Whether the handler of this one-byte opcode can run with the arithmetic
+     * flags still pending: it either records its own flags lazily or doesn't
+     * touch them at all. Everything else gets the flags computed first.
+     */
+    switch (Opcode)
+    {
+        /* ADD, OR, AND, SUB, XOR, CMP */
+        case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x05:
+        case 0x08: case 0x09: case 0x0A: case 0x0B: case 0x0C: case 0x0D:
+        case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x25:
+        case 0x28: case 0x29: case 0x2A: case 0x2B: case 0x2C: case 0x2D:
+        case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35:
+        case 0x38: case 0x39: case 0x3A: case 0x3B: case 0x3C: case 0x3D:
+
+        /* INC, DEC */
+        case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
+        case 0x48: case 0x49: case 0x4A: case 0x4B: case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+
+        /* Group 1, which computes the flags itself for ADC and SBB, and TEST */
+        case 0x80: case 0x81: case 0x82: case 0x83:
+        case 0x84: case 0x85: case 0xA8: case 0xA9:
+
+        /* Prefixes */
+        case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65: case 0x66: case 0x67:
+        case 0xF0: case 0xF2: case 0xF3:
+
+        /* PUSH, POP */
+        case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17: case 0x1E: case 0x1F:
+        case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+        case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+        case 0x60: case 0x61: case 0x68: case 0x6A: case 0x8F:
+
+        /* XCHG, MOV, LEA, CBW, CWD */
+        case 0x86: case 0x87: case 0x88: case 0x89: case 0x8A: case 0x8B: case 0x8C: case 0x8D: case 0x8E:
+        case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97:
+        case 0x98: case 0x99: case 0xA0: case 0xA1: case 0xA2: case 0xA3:
+        case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+        case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+        case 0xC6: case 0xC7: case 0xD7:
+
+        /* MOVS, STOS, LODS */
+        case 0xA4: case 0xA5: case 0xAA: case 0xAB: case 0xAC: case 0xAD:
+
+        /* Near CALL, RET, JMP, LOOP, JCXZ, ENTER, LEAVE */
+        case 0xC2: case 0xC3: case 0xC8: case 0xC9:
+        case 0xE2: case 0xE3: case 0xE8: case 0xE9: case 0xEB:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+#ifndef FAST486_NO_INST_CACHE
+
+FORCEINLINE
+ULONG
+FASTCALL
+Fast486GetInstCacheGeneration(PFAST486_STATE State, ULONG Address)
+{
+    ULONG Line = (Address >> FAST486_INST_LINE_SHIFT) & (FAST486_INST_CACHE_LINES - 1);
+    return State->InstCacheGeneration + State->InstLineGeneration[Line];
+}
+
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486LookupInstCache(PFAST486_STATE State,
+                       PFAST486_INST_CACHE_ENTRY *Entry,
+                       PULONG Address)
+{
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    ULONG Offset = CodeSegment->Size ? State->InstPtr.Long : State->InstPtr.LowWord;
+    PFAST486_INST_CACHE_ENTRY CacheEntry;
+
+    *Address = CodeSegment->Base + Offset;
+    CacheEntry = &State->InstCache[*Address & (FAST486_INST_CACHE_ENTRIES - 1)];
+    *Entry = CacheEntry;
+
+    if ((CacheEntry->Address != *Address)
+        || (CacheEntry->Generation != Fast486GetInstCacheGeneration(State, *Address))
+        || (CacheEntry->Cpl != State->Cpl))
+    {
+        return FALSE;
+    }
+
+    /* The fetches being skipped must not have faulted */
+    if ((Offset + CacheEntry->Length - 1) > CodeSegment->Limit) return FALSE;
+    if (!CodeSegment->Size && (Offset + CacheEntry->Length) > 0x10000) return FALSE;
+
+    return TRUE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FillInstCache(PFAST486_STATE State,
+                     PFAST486_INST_CACHE_ENTRY Entry,
+                     ULONG Address,
+                     FAST486_OPCODE_HANDLER_PROC Handler,
+                     UCHAR Opcode,
+                     BOOLEAN KeepsLazyFlags)
+{
+    ULONG Length;
+
+    if (Entry == NULL) return;
+
+    if (State->SegmentRegs[FAST486_REG_CS].Size)
+    {
+        Length = State->InstPtr.Long - State->SavedInstPtr.Long;
+    }
+    else
+    {
+        Length = (USHORT)(State->InstPtr.LowWord - State->SavedInstPtr.LowWord);
+    }
+
+    /* Only cache what never wrapped around nor crossed a code line */
+    if ((Length == 0) || (Length > FAST486_MAX_INST_LENGTH)) return;
+    if ((Address >> FAST486_INST_LINE_SHIFT) != ((Address + Length - 1) >> FAST486_INST_LINE_SHIFT)) return;
+
+    Entry->Address = Address;
+    Entry->Generation = Fast486GetInstCacheGeneration(State, Address);
+    Entry->Handler = Handler;
+    Entry->PrefixFlags = State->PrefixFlags;
+    Entry->SegmentOverride = (UCHAR)State->SegmentOverride;
+    Entry->Opcode = Opcode;
+    Entry->Length = (UCHAR)Length;
+    Entry->Cpl = State->Cpl;
+    Entry->KeepsLazyFlags = KeepsLazyFlags;
+}
+
+#endif // FAST486_NO_INST_CACHE
+
 FORCEINLINE
 VOID
 FASTCALL
@@ -51,7 +191,11 @@ Fast486ExecutionControl(PFAST486_STATE State, FAST486_EXEC_CMD Command)
     UCHAR Opcode;
     FAST486_OPCODE_HANDLER_PROC CurrentHandler;
     INT ProcedureCallCount = 0;
-    BOOLEAN Trap;
+    BOOLEAN Trap, KeepsLazyFlags;
+#ifndef FAST486_NO_INST_CACHE
+    PFAST486_INST_CACHE_ENTRY Entry = NULL;
+    ULONG Address = 0;
+#endif
 
     /* Main execution loop */
     do
@@ -66,6 +210,27 @@ NextInst:
             {
                 State->SavedInstPtr = State->InstPtr;
                 State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
+
+#ifndef FAST486_NO_INST_CACHE
+                if (Fast486LookupInstCache(State, &Entry, &Address))
+                {
+                    /* Skip the prefixes and opcode, they were decoded already */
+                    State->PrefixFlags = Entry->PrefixFlags;
+                    State->SegmentOverride = Entry->SegmentOverride;
+
+                    if (State->SegmentRegs[FAST486_REG_CS].Size)
+                        State->InstPtr.Long += Entry->Length;
+                    else
+                        State->InstPtr.LowWord += Entry->Length;
+
+                    if (!Entry->KeepsLazyFlags) Fast486ResolveFlags(State);
+
+                    /* Call the opcode handler directly */
+                    Entry->Handler(State, Entry->Opcode);
+                    State->PrefixFlags = 0;
+                    goto CheckInterrupts;
+                }
+#endif
             }
 
             /* Perform an instruction fetch */
@@ -78,8 +243,34 @@ NextInst:
 
             // TODO: Check for CALL/RET to update ProcedureCallCount.
 
-            /* Call the opcode handler */
             CurrentHandler = Fast486OpcodeHandlers[Opcode];
+            KeepsLazyFlags = Fast486KeepsLazyFlags(Opcode);
+
+#ifndef FAST486_NO_INST_CACHE
+            if (CurrentHandler != Fast486OpcodePrefix)
+            {
+                if (CurrentHandler == Fast486OpcodeExtended)
+                {
+                    /* Resolve the two-byte opcodes as well */
+                    if (!Fast486FetchByte(State, &Opcode))
+                    {
+                        /* Exception occurred */
+                        State->PrefixFlags = 0;
+                        continue;
+                    }
+
+                    CurrentHandler = Fast486ExtendedHandlers[Opcode];
+                }
+
+                /* Remember it before it runs, in case it modifies itself */
+                Fast486FillInstCache(State, Entry, Address, CurrentHandler, Opcode, KeepsLazyFlags);
+            }
+#endif
+
+            /* Compute the flags for the handlers that read or change them */
+            if (!KeepsLazyFlags) Fast486ResolveFlags(State);
+
+            /* Call the opcode handler */
             CurrentHandler(State, Opcode);
 
             /* If this is a prefix, go to the next instruction immediately */
@@ -89,6 +280,9 @@ NextInst:
             State->PrefixFlags = 0;
         }
 
+#ifndef FAST486_NO_INST_CACHE
+CheckInterrupts:
+#endif
         /*
          * Check if there is an interrupt to execute, or a hardware interrupt signal
          * while interrupts are enabled.
@@ -126,6 +320,8 @@ VOID
 NTAPI
 Fast486DumpState(PFAST486_STATE State)
 {
+    Fast486ResolveFlags(State);
+
     DbgPrint("\nFast486DumpState -->\n");
     DbgPrint("\nCPU currently executing in %s mode at %04X:%08X\n",
             (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PE) ? "protected" : "real",
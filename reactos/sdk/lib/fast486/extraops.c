@@ -640,11 +640,21 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeLoadControlReg)
     State->PrefetchValid = FALSE;
 #endif
 
+    /* Same for the decoded instructions, which are cached by linear address */
+    Fast486FlushInstCache(State);
+
     if (ModRegRm.Register == (INT)FAST486_REG_CR3)
     {
         /* Flush the TLB */
         Fast486FlushTlb(State);
     }
+#ifndef FAST486_NO_HOST_TLB
+    else if (ModRegRm.Register == (INT)FAST486_REG_CR0)
+    {
+        /* Paging and write protection decide what the host TLB may map */
+        Fast486FlushHostTlb(State);
+    }
+#endif
 
     /* Load a value to the control register */
     State->ControlRegisters[ModRegRm.Register] = Value;
@@ -103,6 +103,7 @@ NTAPI
 Fast486Initialize(PFAST486_STATE         State,
                   FAST486_MEM_READ_PROC  MemReadCallback,
                   FAST486_MEM_WRITE_PROC MemWriteCallback,
+                  FAST486_MEM_MAP_PROC   MemMapCallback,
                   FAST486_IO_READ_PROC   IoReadCallback,
                   FAST486_IO_WRITE_PROC  IoWriteCallback,
                   FAST486_BOP_PROC       BopCallback,
@@ -119,6 +120,9 @@ Fast486Initialize(PFAST486_STATE         State,
     State->IntAckCallback   = (IntAckCallback   ? IntAckCallback   : Fast486IntAckCallback  );
     State->FpuCallback      = (FpuCallback      ? FpuCallback      : Fast486FpuCallback     );
 
+    /* Without a map callback, all the memory goes through the callbacks above */
+    State->MemMapCallback   = MemMapCallback;
+
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
@@ -135,6 +139,7 @@ Fast486Reset(PFAST486_STATE State)
     /* Save the callbacks and TLB */
     FAST486_MEM_READ_PROC  MemReadCallback  = State->MemReadCallback;
     FAST486_MEM_WRITE_PROC MemWriteCallback = State->MemWriteCallback;
+    FAST486_MEM_MAP_PROC   MemMapCallback   = State->MemMapCallback;
     FAST486_IO_READ_PROC   IoReadCallback   = State->IoReadCallback;
     FAST486_IO_WRITE_PROC  IoWriteCallback  = State->IoWriteCallback;
     FAST486_BOP_PROC       BopCallback      = State->BopCallback;
@@ -189,6 +194,7 @@ Fast486Reset(PFAST486_STATE State)
     /* Restore the callbacks and TLB */
     State->MemReadCallback  = MemReadCallback;
     State->MemWriteCallback = MemWriteCallback;
+    State->MemMapCallback   = MemMapCallback;
     State->IoReadCallback   = IoReadCallback;
     State->IoWriteCallback  = IoWriteCallback;
     State->BopCallback      = BopCallback;
@@ -198,6 +204,11 @@ Fast486Reset(PFAST486_STATE State)
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
+
+#ifndef FAST486_NO_INST_CACHE
+    /* The zeroed entries must not look valid */
+    State->InstCacheGeneration = 1;
+#endif
 }
 
 VOID
@@ -260,4 +271,45 @@ Fast486Rewind(PFAST486_STATE State)
 #endif
 }
 
+VOID
+NTAPI
+Fast486InvalidateCache(PFAST486_STATE State, ULONG Address, ULONG Size)
+{
+    /*
+     * This function is used when the host writes to the guest memory
+     * directly, Address is a linear address.
+     */
+    Fast486InvalidateCodeLines(State, Address, Size);
+
+#ifndef FAST486_NO_PREFETCH
+    State->PrefetchValid = FALSE;
+#endif
+}
+
+VOID
+NTAPI
+Fast486UpdateFlags(PFAST486_STATE State)
+{
+    /*
+     * The arithmetic flags are computed when needed only, this function
+     * must be called before the host reads or changes State->Flags.
+     */
+    Fast486ResolveFlags(State);
+}
+
+VOID
+NTAPI
+Fast486FlushMemoryMap(PFAST486_STATE State)
+{
+    /*
+     * This function must be called when the MemMapCallback would now
+     * answer differently for a page, e.g. a memory hook was installed.
+     */
+#ifndef FAST486_NO_HOST_TLB
+    Fast486FlushHostTlb(State);
+#else
+    UNREFERENCED_PARAMETER(State);
+#endif
+}
+
 /* EOF */
@@ -422,21 +422,13 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeIncrement)
     if (Size)
     {
         Value = ++State->GeneralRegs[Opcode & 0x07].Long;
-
-        State->Flags.Of = (Value == SIGN_FLAG_LONG);
-        State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+        Fast486SetLazyFlags(State, FAST486_LAZY_INC, Value - 1, 1, Value, SIGN_FLAG_LONG);
     }
     else
     {
         Value = ++State->GeneralRegs[Opcode & 0x07].LowWord;
-
-        State->Flags.Of = (Value == SIGN_FLAG_WORD);
-        State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+        Fast486SetLazyFlags(State, FAST486_LAZY_INC, (USHORT)(Value - 1), 1, Value, SIGN_FLAG_WORD);
     }
-
-    State->Flags.Zf = (Value == 0);
-    State->Flags.Af = ((Value & 0x0F) == 0);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeDecrement)
@@ -453,21 +445,13 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeDecrement)
     if (Size)
     {
         Value = --State->GeneralRegs[Opcode & 0x07].Long;
-
-        State->Flags.Of = (Value == (SIGN_FLAG_LONG - 1));
-        State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+        Fast486SetLazyFlags(State, FAST486_LAZY_DEC, Value + 1, 1, Value, SIGN_FLAG_LONG);
     }
     else
     {
         Value = --State->GeneralRegs[Opcode & 0x07].LowWord;
-
-        State->Flags.Of = (Value == (SIGN_FLAG_WORD - 1));
-        State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+        Fast486SetLazyFlags(State, FAST486_LAZY_DEC, (USHORT)(Value + 1), 1, Value, SIGN_FLAG_WORD);
     }
-
-    State->Flags.Zf = (Value == 0);
-    State->Flags.Af = ((Value & 0x0F) == 0x0F);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodePushReg)
@@ -1066,13 +1050,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddByteModrm)
     Result = FirstValue + SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) == (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1119,13 +1097,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddModrm)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) == (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1150,13 +1122,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddModrm)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) == (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1186,13 +1152,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddAl)
     Result = FirstValue + SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) == (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1223,13 +1183,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddEax)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) == (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1249,13 +1203,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddEax)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) == (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1293,11 +1241,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrByteModrm)
     Result = FirstValue | SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1344,11 +1288,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrModrm)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1373,11 +1313,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrModrm)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1407,11 +1343,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrAl)
     Result = FirstValue | SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1442,11 +1374,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrEax)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1466,11 +1394,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrEax)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1508,11 +1432,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndByteModrm)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1559,11 +1479,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1588,11 +1504,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1622,11 +1534,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndAl)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1657,11 +1565,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1681,11 +1585,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1723,11 +1623,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorByteModrm)
     Result = FirstValue ^ SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1774,11 +1670,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorModrm)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1803,11 +1695,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorModrm)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1837,11 +1725,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorAl)
     Result = FirstValue ^ SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1872,11 +1756,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorEax)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1896,11 +1776,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorEax)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1937,11 +1813,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestByteModrm)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
@@ -1982,11 +1854,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
     }
     else
     {
@@ -2005,11 +1873,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
     }
 }
 
@@ -2033,11 +1897,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestAl)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
@@ -2065,11 +1925,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
     }
     else
     {
@@ -2086,11 +1942,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
     }
 }
 
@@ -2872,13 +2724,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubByteModrm)
     Result = FirstValue - SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (FirstValue < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) != (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Check if this is not a CMP */
     if (!(Opcode & 0x10))
@@ -2936,13 +2782,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubModrm)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) != (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -2978,13 +2818,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubModrm)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) != (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -3018,13 +2852,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubAl)
     Result = FirstValue - SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (FirstValue < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) != (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Check if this is not a CMP */
     if (!(Opcode & 0x10))
@@ -3059,13 +2887,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubEax)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) != (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_LONG);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -3089,13 +2911,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubEax)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) != (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_WORD);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -4148,6 +3964,9 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeLdsLes)
             /* Call the BOP handler */
             State->BopCallback(State, BopCode);
 
+            /* The handler may have loaded code behind our back */
+            Fast486FlushInstCache(State);
+
             /*
              * If an interrupt should occur at this time, delay it.
              * We must do this because if an interrupt begins and the BOP callback
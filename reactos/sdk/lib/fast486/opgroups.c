@@ -56,28 +56,26 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 0:
         {
             Result = (FirstValue + SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-
-            break;
+            Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SignFlag);
+            return Result;
         }
 
         /* OR */
         case 1:
         {
             Result = FirstValue | SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
+            return Result;
         }
 
         /* ADC */
         case 2:
         {
-            INT Carry = State->Flags.Cf ? 1 : 0;
+            INT Carry;
+
+            /* The carry is needed now */
+            Fast486ResolveFlags(State);
+            Carry = State->Flags.Cf ? 1 : 0;
 
             Result = (FirstValue + SecondValue + Carry) & MaxValue;
 
@@ -94,7 +92,11 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         /* SBB */
         case 3:
         {
-            INT Carry = State->Flags.Cf ? 1 : 0;
+            INT Carry;
+
+            /* The carry is needed now */
+            Fast486ResolveFlags(State);
+            Carry = State->Flags.Cf ? 1 : 0;
 
             Result = (FirstValue - SecondValue - Carry) & MaxValue;
 
@@ -113,8 +115,8 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 4:
         {
             Result = FirstValue & SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
+            return Result;
         }
 
         /* SUB or CMP */
@@ -122,28 +124,23 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 7:
         {
             Result = (FirstValue - SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (FirstValue < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-
-            break;
+            Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SignFlag);
+            return Result;
         }
 
         /* XOR */
         case 6:
         {
             Result = FirstValue ^ SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
-            break;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
+            return Result;
         }
 
         default:
         {
             /* Shouldn't happen */
             ASSERT(FALSE);
+            return 0;
         }
     }
 
@@ -2259,6 +2256,9 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
         /* INVLPG */
         case 7:
         {
+            FAST486_SEG_REGS Segment = FAST486_REG_DS;
+            ULONG LinearAddress;
+
 #ifndef FAST486_NO_PREFETCH
             /* Invalidate the prefetch */
             State->PrefetchValid = FALSE;
@@ -2278,12 +2278,30 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeGroup0F01)
                 return;
             }
 
+            /* Check for the segment override */
+            if (State->PrefixFlags & FAST486_PREFIX_SEG)
+            {
+                /* Use the override segment instead */
+                Segment = State->SegmentOverride;
+            }
+
+            /* The TLBs are indexed on the linear address */
+            LinearAddress = State->SegmentRegs[Segment].Base + ModRegRm.MemoryAddress;
+
             if (State->Tlb != NULL)
             {
                 /* Clear the TLB entry */
-                State->Tlb[ModRegRm.MemoryAddress >> 12] = INVALID_TLB_FIELD;
+                State->Tlb[LinearAddress >> 12] = INVALID_TLB_FIELD;
             }
 
+#ifndef FAST486_NO_HOST_TLB
+            /* And the host TLB entry */
+            Fast486InvalidateHostTlbPage(State, LinearAddress);
+#endif
+
+            /* The page may now map different code */
+            Fast486FlushInstCache(State);
+
             break;
         }
 
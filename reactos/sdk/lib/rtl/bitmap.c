@@ -65,33 +65,6 @@ typedef ULONG BITMAP_INDEX, *PBITMAP_INDEX;
 typedef ULONG BITMAP_BUFFER, *PBITMAP_BUFFER;
 #endif
 
-/* DATA *********************************************************************/
-
-/* Number of set bits per byte value */
-static const
-UCHAR
-BitCountTable[256] =
-{
-    /* x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF */
-       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, /* 0x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 1x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 2x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 3x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 4x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 5x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 6c */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* 7x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 8x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 9x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* Ax */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Bx */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* Cx */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Dx */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Ex */
-       4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8  /* Fx */
-};
-
-
 /* PRIVATE FUNCTIONS ********************************************************/
 
 static __inline
@@ -202,6 +175,164 @@ RtlpGetLengthOfRunSet(
     return Length;
 }
 
+static __inline
+BITMAP_INDEX
+RtlpBitCount(
+    _In_ BITMAP_BUFFER Value)
+{
+    /* Add up the bits in pairs, then nibbles, then bytes, then sum the bytes */
+    Value = Value - ((Value >> 1) & (MAXINDEX / 3));
+    Value = (Value & (MAXINDEX / 5)) + ((Value >> 2) & (MAXINDEX / 5));
+    Value = (Value + (Value >> 4)) & (MAXINDEX / 17);
+    return (BITMAP_INDEX)((Value * (MAXINDEX / 255)) >> (_BITCOUNT - 8));
+}
+
+/* Finds the first run of NumberToFind clear bits (or set bits) lying
+   between StartingIndex and EndingIndex, a word at a time */
+static
+BITMAP_INDEX
+RtlpFindRun(
+    _In_ PRTL_BITMAP BitMapHeader,
+    _In_ BITMAP_INDEX StartingIndex,
+    _In_ BITMAP_INDEX EndingIndex,
+    _In_ BITMAP_INDEX NumberToFind,
+    _In_ BOOLEAN Set)
+{
+    BITMAP_INDEX Value, Starts, Index, BitPos, Length, Shift, Run = 0;
+    PBITMAP_BUFFER Buffer, MaxBuffer;
+
+    if (StartingIndex >= EndingIndex || EndingIndex - StartingIndex < NumberToFind)
+        return MAXINDEX;
+
+    /* Calculate positions */
+    Buffer = BitMapHeader->Buffer + StartingIndex / _BITCOUNT;
+    MaxBuffer = BitMapHeader->Buffer + (EndingIndex - 1) / _BITCOUNT;
+    Index = StartingIndex & ~(BITMAP_INDEX)(_BITCOUNT - 1);
+
+    /* The bits we are looking for are 1 in Value, leave out those before the start */
+    Value = (Set ? *Buffer : ~*Buffer) & (MAXINDEX << (StartingIndex & (_BITCOUNT - 1)));
+
+    for (;;)
+    {
+        /* And those past the end */
+        if (Buffer == MaxBuffer && (EndingIndex & (_BITCOUNT - 1)))
+            Value &= ~(MAXINDEX << (EndingIndex & (_BITCOUNT - 1)));
+
+        if (Value == MAXINDEX)
+        {
+            /* The whole word belongs to the run */
+            Run += _BITCOUNT;
+            if (Run >= NumberToFind)
+                return Index + _BITCOUNT - Run;
+        }
+        else
+        {
+            /* Does the run from the previous words go on long enough? */
+            if (Run != 0)
+            {
+                BitScanForward(&BitPos, ~Value);
+                if (Run + BitPos >= NumberToFind)
+                    return Index - Run;
+            }
+
+            /* Look for a run within the word: each step leaves the bits
+               that start a run twice as long, up to the wanted length */
+            if (NumberToFind <= _BITCOUNT)
+            {
+                Starts = Value;
+                for (Length = 1; Length < NumberToFind && Starts != 0; Length += Shift)
+                {
+                    Shift = min(Length, NumberToFind - Length);
+                    Starts &= Starts >> Shift;
+                }
+
+                if (Starts != 0)
+                {
+                    BitScanForward(&BitPos, Starts);
+                    return Index + BitPos;
+                }
+            }
+
+            /* Carry on with the run that reaches the end of the word */
+            Run = 0;
+            if (Value >> (_BITCOUNT - 1))
+            {
+                BitScanReverse(&BitPos, ~Value);
+                Run = (_BITCOUNT - 1) - BitPos;
+            }
+        }
+
+        /* Did we reach the end? */
+        if (Buffer == MaxBuffer)
+            return MAXINDEX;
+
+        Buffer++;
+        Index += _BITCOUNT;
+        Value = Set ? *Buffer : ~*Buffer;
+    }
+}
+
+/* Finds the first run of clear bits (or set bits) at or after FromIndex,
+   returns its length or 0 if there is none */
+static __inline
+BITMAP_INDEX
+RtlpFindNextRun(
+    _In_ PRTL_BITMAP BitMapHeader,
+    _In_ BITMAP_INDEX FromIndex,
+    _Out_ PBITMAP_INDEX StartingRunIndex,
+    _In_ BOOLEAN Set)
+{
+    BITMAP_INDEX Value, BitPos, Start, End;
+    PBITMAP_BUFFER Buffer, MaxBuffer;
+
+    ASSERT(FromIndex < BitMapHeader->SizeOfBitMap);
+
+    /* Calculate positions */
+    Buffer = BitMapHeader->Buffer + FromIndex / _BITCOUNT;
+    MaxBuffer = BitMapHeader->Buffer + (BitMapHeader->SizeOfBitMap + _BITCOUNT - 1) / _BITCOUNT;
+
+    /* Skip the words that have none of the bits we are looking for */
+    Value = (Set ? *Buffer : ~*Buffer) & (MAXINDEX << (FromIndex & (_BITCOUNT - 1)));
+    while (Value == 0)
+    {
+        if (++Buffer >= MaxBuffer)
+        {
+            *StartingRunIndex = BitMapHeader->SizeOfBitMap;
+            return 0;
+        }
+
+        Value = Set ? *Buffer : ~*Buffer;
+    }
+
+    BitScanForward(&BitPos, Value);
+    Start = (BITMAP_INDEX)(Buffer - BitMapHeader->Buffer) * _BITCOUNT + BitPos;
+    if (Start >= BitMapHeader->SizeOfBitMap)
+    {
+        *StartingRunIndex = BitMapHeader->SizeOfBitMap;
+        return 0;
+    }
+
+    /* Now look for its end, starting with what is left of the same word */
+    End = BitMapHeader->SizeOfBitMap;
+    Value = ~Value & (MAXINDEX << BitPos);
+    while (Value == 0)
+    {
+        if (++Buffer >= MaxBuffer)
+            break;
+
+        Value = Set ? ~*Buffer : *Buffer;
+    }
+
+    if (Value != 0)
+    {
+        BitScanForward(&BitPos, Value);
+        End = min(End, (BITMAP_INDEX)(Buffer - BitMapHeader->Buffer) * _BITCOUNT + BitPos);
+    }
+
+    *StartingRunIndex = Start;
+    return End - Start;
+}
+
 
 /* PUBLIC FUNCTIONS **********************************************************/
 
@@ -474,22 +605,23 @@ NTAPI
 RtlNumberOfSetBits(
     _In_ PRTL_BITMAP BitMapHeader)
 {
-    PUCHAR Byte, MaxByte;
+    PBITMAP_BUFFER Buffer, MaxBuffer;
     BITMAP_INDEX BitCount = 0;
-    ULONG Shift;
+    ULONG Bits;
 
-    Byte = (PUCHAR)BitMapHeader->Buffer;
-    MaxByte = Byte + BitMapHeader->SizeOfBitMap / 8;
+    Buffer = BitMapHeader->Buffer;
+    MaxBuffer = Buffer + BitMapHeader->SizeOfBitMap / _BITCOUNT;
 
-    while (Byte < MaxByte)
+    while (Buffer < MaxBuffer)
     {
-        BitCount += BitCountTable[*Byte++];
+        BitCount += RtlpBitCount(*Buffer++);
     }
 
-    if (BitMapHeader->SizeOfBitMap & 7)
+    /* Only count the bits of the last one that belong to the bitmap */
+    Bits = BitMapHeader->SizeOfBitMap & (_BITCOUNT - 1);
+    if (Bits)
     {
-        Shift = 8 - (BitMapHeader->SizeOfBitMap & 7);
-        BitCount += BitCountTable[((*Byte) << Shift) & 0xFF];
+        BitCount += RtlpBitCount(*Buffer & ~(MAXINDEX << Bits));
     }
 
     return BitCount;
@@ -511,7 +643,7 @@ RtlFindClearBits(
     _In_ BITMAP_INDEX NumberToFind,
     _In_ BITMAP_INDEX HintIndex)
 {
-    BITMAP_INDEX CurrentBit, Margin, CurrentLength;
+    BITMAP_INDEX Position;
 
     /* Check for valid parameters */
     if (!BitMapHeader || NumberToFind > BitMapHeader->SizeOfBitMap)
@@ -529,47 +661,25 @@ RtlFindClearBits(
         return HintIndex & ~7;
     }
 
-    /* First margin is end of bitmap */
-    Margin = BitMapHeader->SizeOfBitMap;
-
-retry:
-    /* Start with hint index, length is 0 */
-    CurrentBit = HintIndex;
-
-    /* Loop until something is found or the end is reached */
-    while (CurrentBit + NumberToFind < Margin)
-    {
-        /* Search for the next clear run, by skipping a set run */
-        CurrentBit += RtlpGetLengthOfRunSet(BitMapHeader,
-                                            CurrentBit,
-                                            MAXINDEX);
-
-        /* Get length of the clear bit run */
-        CurrentLength = RtlpGetLengthOfRunClear(BitMapHeader,
-                                                CurrentBit,
-                                                NumberToFind);
-
-        /* Is this long enough? */
-        if (CurrentLength >= NumberToFind)
-        {
-            /* It is */
-            return CurrentBit;
-        }
-
-        CurrentBit += CurrentLength;
-    }
+    /* Look from the hint to the end of the bitmap first */
+    Position = RtlpFindRun(BitMapHeader,
+                           HintIndex,
+                           BitMapHeader->SizeOfBitMap,
+                           NumberToFind,
+                           FALSE);
 
     /* Did we start at a hint? */
-    if (HintIndex)
+    if (Position == MAXINDEX && HintIndex)
     {
-        /* Retry at the start */
-        Margin = min(HintIndex + NumberToFind, BitMapHeader->SizeOfBitMap);
-        HintIndex = 0;
-        goto retry;
+        /* Retry at the start, up to the runs that the first pass saw whole */
+        Position = RtlpFindRun(BitMapHeader,
+                               0,
+                               min(HintIndex + NumberToFind - 1, BitMapHeader->SizeOfBitMap),
+                               NumberToFind,
+                               FALSE);
     }
 
-    /* Nothing found */
-    return MAXINDEX;
+    return Position;
 }
 
 BITMAP_INDEX
@@ -579,7 +689,7 @@ RtlFindSetBits(
     _In_ BITMAP_INDEX NumberToFind,
     _In_ BITMAP_INDEX HintIndex)
 {
-    BITMAP_INDEX CurrentBit, Margin, CurrentLength;
+    BITMAP_INDEX Position;
 
     /* Check for valid parameters */
     if (!BitMapHeader || NumberToFind > BitMapHeader->SizeOfBitMap)
@@ -597,47 +707,25 @@ RtlFindSetBits(
         return HintIndex & ~7;
     }
 
-    /* First margin is end of bitmap */
-    Margin = BitMapHeader->SizeOfBitMap;
-
-retry:
-    /* Start with hint index, length is 0 */
-    CurrentBit = HintIndex;
-
-    /* Loop until something is found or the end is reached */
-    while (CurrentBit + NumberToFind <= Margin)
-    {
-        /* Search for the next set run, by skipping a clear run */
-        CurrentBit += RtlpGetLengthOfRunClear(BitMapHeader,
-                                              CurrentBit,
-                                              MAXINDEX);
-
-        /* Get length of the set bit run */
-        CurrentLength = RtlpGetLengthOfRunSet(BitMapHeader,
-                                              CurrentBit,
-                                              NumberToFind);
-
-        /* Is this long enough? */
-        if (CurrentLength >= NumberToFind)
-        {
-            /* It is */
-            return CurrentBit;
-        }
-
-        CurrentBit += CurrentLength;
-    }
+    /* Look from the hint to the end of the bitmap first */
+    Position = RtlpFindRun(BitMapHeader,
+                           HintIndex,
+                           BitMapHeader->SizeOfBitMap,
+                           NumberToFind,
+                           TRUE);
 
     /* Did we start at a hint? */
-    if (HintIndex)
+    if (Position == MAXINDEX && HintIndex)
     {
-        /* Retry at the start */
-        Margin = min(HintIndex + NumberToFind, BitMapHeader->SizeOfBitMap);
-        HintIndex = 0;
-        goto retry;
+        /* Retry at the start, up to the runs that the first pass saw whole */
+        Position = RtlpFindRun(BitMapHeader,
+                               0,
+                               min(HintIndex + NumberToFind - 1, BitMapHeader->SizeOfBitMap),
+                               NumberToFind,
+                               TRUE);
     }
 
-    /* Nothing found */
-    return MAXINDEX;
+    return Position;
 }
 
 BITMAP_INDEX
@@ -693,8 +781,6 @@ RtlFindNextForwardRunClear(
     _In_ BITMAP_INDEX FromIndex,
     _Out_ PBITMAP_INDEX StartingRunIndex)
 {
-    BITMAP_INDEX Length;
-
     /* Check for buffer overrun */
     if (FromIndex >= BitMapHeader->SizeOfBitMap)
     {
@@ -702,12 +788,7 @@ RtlFindNextForwardRunClear(
         return 0;
     }
 
-    /* Assume a set run first, count it's length */
-    Length = RtlpGetLengthOfRunSet(BitMapHeader, FromIndex, MAXINDEX);
-    *StartingRunIndex = FromIndex + Length;
-
-    /* Now return the length of the run */
-    return RtlpGetLengthOfRunClear(BitMapHeader, FromIndex + Length, MAXINDEX);
+    return RtlpFindNextRun(BitMapHeader, FromIndex, StartingRunIndex, FALSE);
 }
 
 BITMAP_INDEX
@@ -717,8 +798,6 @@ RtlFindNextForwardRunSet(
     _In_ BITMAP_INDEX FromIndex,
     _Out_ PBITMAP_INDEX StartingRunIndex)
 {
-    BITMAP_INDEX Length;
-
     /* Check for buffer overrun */
     if (FromIndex >= BitMapHeader->SizeOfBitMap)
     {
@@ -726,12 +805,7 @@ RtlFindNextForwardRunSet(
         return 0;
     }
 
-    /* Assume a clear run first, count it's length */
-    Length = RtlpGetLengthOfRunClear(BitMapHeader, FromIndex, MAXINDEX);
-    *StartingRunIndex = FromIndex + Length;
-
-    /* Now return the length of the run */
-    return RtlpGetLengthOfRunSet(BitMapHeader, FromIndex + Length, MAXINDEX);
+    return RtlpFindNextRun(BitMapHeader, FromIndex, StartingRunIndex, TRUE);
 }
 
 BITMAP_INDEX
@@ -852,12 +926,10 @@ RtlFindClearRuns(
         return Run;
     }
 
-    while (1)
+    while (FromIndex < BitMapHeader->SizeOfBitMap)
     {
         /* Look for a run */
-        NumberOfBits = RtlFindNextForwardRunClear(BitMapHeader,
-                                                  FromIndex,
-                                                  &StartingIndex);
+        NumberOfBits = RtlpFindNextRun(BitMapHeader, FromIndex, &StartingIndex, FALSE);
 
         /* Nothing more found? Quit looping. */
         if (NumberOfBits == 0) break;
@@ -872,8 +944,8 @@ RtlFindClearRuns(
             /* Loop all runs */
             for (Run = 0; Run < SizeOfRunArray; Run++)
             {
-                /*Is this the new smallest run? */
-                if (NumberOfBits < RunArray[SmallestRun].NumberOfBits)
+                /* Is this the new smallest run? */
+                if (RunArray[Run].NumberOfBits < RunArray[SmallestRun].NumberOfBits)
                 {
                     /* Set it as new smallest run */
                     SmallestRun = Run;
@@ -881,11 +953,11 @@ RtlFindClearRuns(
             }
         }
 
-        /* Advance bits */
-        FromIndex += NumberOfBits;
+        /* Continue after it */
+        FromIndex = StartingIndex + NumberOfBits;
     }
 
-    return Run;
+    return SizeOfRunArray;
 }
 
 BITMAP_INDEX
@@ -896,12 +968,10 @@ RtlFindLongestRunClear(
 {
     BITMAP_INDEX NumberOfBits, Index, MaxNumberOfBits = 0, FromIndex = 0;
 
-    while (1)
+    while (FromIndex < BitMapHeader->SizeOfBitMap)
     {
         /* Look for a run */
-        NumberOfBits = RtlFindNextForwardRunClear(BitMapHeader,
-                                                  FromIndex,
-                                                  &Index);
+        NumberOfBits = RtlpFindNextRun(BitMapHeader, FromIndex, &Index, FALSE);
 
         /* Nothing more found? Quit looping. */
         if (NumberOfBits == 0) break;
@@ -914,8 +984,8 @@ RtlFindLongestRunClear(
             *StartingIndex = Index;
         }
 
-        /* Advance bits */
-        FromIndex += NumberOfBits;
+        /* Continue after it */
+        FromIndex = Index + NumberOfBits;
     }
 
     return MaxNumberOfBits;
@@ -929,12 +999,10 @@ RtlFindLongestRunSet(
 {
     BITMAP_INDEX NumberOfBits, Index, MaxNumberOfBits = 0, FromIndex = 0;
 
-    while (1)
+    while (FromIndex < BitMapHeader->SizeOfBitMap)
     {
         /* Look for a run */
-        NumberOfBits = RtlFindNextForwardRunSet(BitMapHeader,
-                                                FromIndex,
-                                                &Index);
+        NumberOfBits = RtlpFindNextRun(BitMapHeader, FromIndex, &Index, TRUE);
 
         /* Nothing more found? Quit looping. */
         if (NumberOfBits == 0) break;
@@ -947,8 +1015,8 @@ RtlFindLongestRunSet(
             *StartingIndex = Index;
         }
 
-        /* Advance bits */
-        FromIndex += NumberOfBits;
+        /* Continue after it */
+        FromIndex = Index + NumberOfBits;
     }
 
     return MaxNumberOfBits;
@@ -20,7 +20,91 @@
 #define COMPRESSION_FORMAT_MASK  0x00FF
 #define COMPRESSION_ENGINE_MASK  0xFF00
 
+#define TAG_COMPRESS             'pmCR'
 
+/* Matches shorter than that don't pay off in any of the formats */
+#define LZ_MIN_MATCH             3
+#define LZ_MAX_MATCH             0xFFFF
+
+#define LZNT1_CHUNK_SIZE         0x1000
+#define LZNT1_HASH_BITS          12
+
+#define XPRESS_WINDOW_SIZE       0x2000
+#define XPRESS_HASH_BITS         13
+
+#define XPRESS_HUFF_BLOCK_SIZE   0x10000
+#define XPRESS_HUFF_WINDOW_SIZE  0x10000
+#define XPRESS_HUFF_HASH_BITS    14
+#define XPRESS_HUFF_SYMBOLS      512
+#define XPRESS_HUFF_TABLE_SIZE   (XPRESS_HUFF_SYMBOLS / 2)
+#define XPRESS_HUFF_END_OF_DATA  256
+#define XPRESS_HUFF_MAX_BITS     15
+#define XPRESS_HUFF_FAST_BITS    10
+
+/* TYPES ********************************************************************/
+
+/* Hash chains over the input, to find earlier occurrences of what follows */
+typedef struct _LZ_MATCHER
+{
+    PUCHAR Buffer;
+    ULONG BufferSize;
+    PULONG Head;            /* Last position + 1 seen for each hash */
+    PULONG Prev;            /* Previous position + 1 with the same hash */
+    ULONG HashShift;
+    ULONG WindowMask;
+    ULONG MaxChain;         /* How many candidates get looked at */
+    ULONG NiceLength;       /* Stop looking once a match is that long */
+} LZ_MATCHER, *PLZ_MATCHER;
+
+typedef struct _LZNT1_WORKSPACE
+{
+    ULONG Head[1 << LZNT1_HASH_BITS];
+    ULONG Prev[LZNT1_CHUNK_SIZE];
+} LZNT1_WORKSPACE, *PLZNT1_WORKSPACE;
+
+typedef struct _XPRESS_WORKSPACE
+{
+    ULONG Head[1 << XPRESS_HASH_BITS];
+    ULONG Prev[XPRESS_WINDOW_SIZE];
+} XPRESS_WORKSPACE, *PXPRESS_WORKSPACE;
+
+typedef struct _XPRESS_HUFF_WORKSPACE
+{
+    ULONG Head[1 << XPRESS_HUFF_HASH_BITS];
+    ULONG Prev[XPRESS_HUFF_WINDOW_SIZE];
+
+    /* The literals and matches of a block, a match is its length << 16 | offset */
+    ULONG Tokens[XPRESS_HUFF_BLOCK_SIZE];
+
+    /* Building the code of a block */
+    ULONG Frequency[XPRESS_HUFF_SYMBOLS];
+    ULONG Weight[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT Parent[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT Sorted[XPRESS_HUFF_SYMBOLS];
+    USHORT Code[XPRESS_HUFF_SYMBOLS];
+    UCHAR Length[XPRESS_HUFF_SYMBOLS];
+} XPRESS_HUFF_WORKSPACE, *PXPRESS_HUFF_WORKSPACE;
+
+typedef struct _XPRESS_HUFF_DECODER
+{
+    USHORT Fast[1 << XPRESS_HUFF_FAST_BITS];    /* Symbol << 4 | length of the short codes */
+    USHORT Symbol[XPRESS_HUFF_SYMBOLS];         /* Symbols in code order */
+    USHORT First[XPRESS_HUFF_MAX_BITS + 1];     /* First code of each length */
+    USHORT Count[XPRESS_HUFF_MAX_BITS + 1];     /* Number of codes of each length */
+    USHORT Index[XPRESS_HUFF_MAX_BITS + 1];     /* Where they start in Symbol */
+} XPRESS_HUFF_DECODER, *PXPRESS_HUFF_DECODER;
+
+/* The Huffman bits go in 16-bit words, with literal bytes in between. The
+ * decompressor reads the word after the one it is in before the bytes that
+ * follow a code, so the next word gets reserved as soon as one is started */
+typedef struct _BIT_WRITER
+{
+    PUCHAR Next;
+    PUSHORT Word;
+    PUSHORT NextWord;
+    ULONG Bits;
+    ULONG Count;
+} BIT_WRITER, *PBIT_WRITER;
 
 
 /* FUNCTIONS ****************************************************************/
@@ -215,30 +299,545 @@ out:
 
 }
 
+/* decompress data encoded with XPRESS ([MS-XCA] 2.4) */
+static NTSTATUS
+RtlpDecompressBufferXpress(PUCHAR Dst,
+                           ULONG DstSize,
+                           PUCHAR Src,
+                           ULONG SrcSize,
+                           PULONG FinalSize)
+{
+    PUCHAR SrcCur = Src, SrcEnd = Src + SrcSize;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize;
+    PUCHAR HalfBytePtr = NULL;
+    ULONG Flags = 0, FlagCount = 0;
+    ULONG Length, Offset;
+
+    while (DstCur < DstEnd)
+    {
+        if (FlagCount == 0)
+        {
+            if (SrcEnd - SrcCur < sizeof(ULONG))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            Flags = *(ULONG UNALIGNED *)SrcCur;
+            SrcCur += sizeof(ULONG);
+            FlagCount = 32;
+        }
+
+        FlagCount--;
+        if (!(Flags & (1U << FlagCount)))
+        {
+            /* literal */
+            if (SrcCur >= SrcEnd)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            *DstCur++ = *SrcCur++;
+            continue;
+        }
+
+        /* a match with no input left marks the end */
+        if (SrcCur == SrcEnd)
+            break;
+
+        if (SrcEnd - SrcCur < sizeof(USHORT))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        Length = *(USHORT UNALIGNED *)SrcCur;
+        SrcCur += sizeof(USHORT);
+        Offset = (Length >> 3) + 1;
+        Length &= 7;
+
+        if (Length == 7)
+        {
+            /* two long matches share a byte for the next 4 bits of length */
+            if (!HalfBytePtr)
+            {
+                if (SrcCur >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                HalfBytePtr = SrcCur++;
+                Length = *HalfBytePtr & 0xF;
+            }
+            else
+            {
+                Length = *HalfBytePtr >> 4;
+                HalfBytePtr = NULL;
+            }
+
+            if (Length == 15)
+            {
+                if (SrcCur >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *SrcCur++;
+                if (Length == 255)
+                {
+                    if (SrcEnd - SrcCur < sizeof(USHORT))
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = *(USHORT UNALIGNED *)SrcCur;
+                    SrcCur += sizeof(USHORT);
+                    if (Length == 0)
+                    {
+                        if (SrcEnd - SrcCur < sizeof(ULONG))
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        Length = *(ULONG UNALIGNED *)SrcCur;
+                        SrcCur += sizeof(ULONG);
+                    }
+                    if (Length < 15 + 7)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15 + 7;
+                }
+                Length += 15;
+            }
+            Length += 7;
+        }
+        Length += LZ_MIN_MATCH;
+
+        if (Offset > DstCur - Dst)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        /* source and dest can be overlapping, copy bytes one by one */
+        Length = min(Length, (ULONG)(DstEnd - DstCur));
+        while (Length--)
+        {
+            *DstCur = *(DstCur - Offset);
+            DstCur++;
+        }
+    }
+
+    if (FinalSize)
+        *FinalSize = DstCur - Dst;
+
+    return STATUS_SUCCESS;
+}
+
+/* Builds the decoding tables from the code lengths at the start of a block */
+static BOOLEAN
+RtlpBuildHuffmanDecoder(PXPRESS_HUFF_DECODER Decoder, PUCHAR Table)
+{
+    USHORT Next[XPRESS_HUFF_MAX_BITS + 1];
+    ULONG Symbol, Bits, Code, Left, Index, i;
+
+    RtlZeroMemory(Decoder->Count, sizeof(Decoder->Count));
+    for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        Decoder->Count[(Table[Symbol / 2] >> (4 * (Symbol & 1))) & 0xF]++;
+    Decoder->Count[0] = 0;
+
+    /* Refuse over-subscribed codes, missing ones only fail when they show up */
+    Left = 1;
+    Code = 0;
+    Index = 0;
+    for (Bits = 1; Bits <= XPRESS_HUFF_MAX_BITS; Bits++)
+    {
+        Left <<= 1;
+        if (Decoder->Count[Bits] > Left)
+            return FALSE;
+        Left -= Decoder->Count[Bits];
+
+        Decoder->First[Bits] = (USHORT)Code;
+        Decoder->Index[Bits] = Next[Bits] = (USHORT)Index;
+        Code = (Code + Decoder->Count[Bits]) << 1;
+        Index += Decoder->Count[Bits];
+    }
+
+    if (Index == 0)
+        return FALSE;
+
+    /* Short codes are looked up directly */
+    RtlZeroMemory(Decoder->Fast, sizeof(Decoder->Fast));
+    for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+    {
+        Bits = (Table[Symbol / 2] >> (4 * (Symbol & 1))) & 0xF;
+        if (Bits == 0)
+            continue;
+
+        Code = Decoder->First[Bits] + Next[Bits] - Decoder->Index[Bits];
+        Decoder->Symbol[Next[Bits]++] = (USHORT)Symbol;
+
+        if (Bits <= XPRESS_HUFF_FAST_BITS)
+        {
+            Code <<= XPRESS_HUFF_FAST_BITS - Bits;
+            for (i = 0; i < (1U << (XPRESS_HUFF_FAST_BITS - Bits)); i++)
+                Decoder->Fast[Code + i] = (USHORT)((Symbol << 4) | Bits);
+        }
+    }
+
+    return TRUE;
+}
+
+/* decompress data encoded with XPRESS_HUFF ([MS-XCA] 2.2) */
+static NTSTATUS
+RtlpDecompressXpressHuff(PXPRESS_HUFF_DECODER Decoder,
+                         PUCHAR Dst,
+                         ULONG DstSize,
+                         PUCHAR Src,
+                         ULONG SrcSize,
+                         PULONG FinalSize)
+{
+    PUCHAR SrcCur = Src, SrcEnd = Src + SrcSize;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize, BlockEnd;
+    ULONG NextBits, Peek, Entry, Symbol, Bits, Code;
+    ULONG Length, Offset, OffsetBits;
+    LONG ExtraBits;
+
+#define CONSUME_BITS(n)                                                     \
+    NextBits <<= (n);                                                       \
+    ExtraBits -= (n);                                                       \
+    if (ExtraBits < 0)                                                      \
+    {                                                                       \
+        if (SrcEnd - SrcCur < sizeof(USHORT))                               \
+            return STATUS_BAD_COMPRESSION_BUFFER;                           \
+        NextBits |= (ULONG)*(USHORT UNALIGNED *)SrcCur << -ExtraBits;       \
+        SrcCur += sizeof(USHORT);                                           \
+        ExtraBits += 16;                                                    \
+    }
+
+    while (DstCur < DstEnd)
+    {
+        /* What follows a full last block can only be its end of data code */
+        if (SrcEnd - SrcCur < XPRESS_HUFF_TABLE_SIZE + 2 * sizeof(USHORT))
+            break;
+
+        if (!RtlpBuildHuffmanDecoder(Decoder, SrcCur))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        SrcCur += XPRESS_HUFF_TABLE_SIZE;
+
+        NextBits = ((ULONG)*(USHORT UNALIGNED *)SrcCur << 16) |
+                   *(USHORT UNALIGNED *)(SrcCur + sizeof(USHORT));
+        SrcCur += 2 * sizeof(USHORT);
+        ExtraBits = 16;
+
+        BlockEnd = DstCur + min(XPRESS_HUFF_BLOCK_SIZE, (ULONG)(DstEnd - DstCur));
+        while (DstCur < BlockEnd)
+        {
+            Peek = NextBits >> (32 - XPRESS_HUFF_MAX_BITS);
+            Entry = Decoder->Fast[Peek >> (XPRESS_HUFF_MAX_BITS - XPRESS_HUFF_FAST_BITS)];
+            if (Entry)
+            {
+                Symbol = Entry >> 4;
+                Bits = Entry & 0xF;
+            }
+            else
+            {
+                for (Bits = XPRESS_HUFF_FAST_BITS + 1; Bits <= XPRESS_HUFF_MAX_BITS; Bits++)
+                {
+                    Code = (Peek >> (XPRESS_HUFF_MAX_BITS - Bits)) - Decoder->First[Bits];
+                    if (Code < Decoder->Count[Bits])
+                        break;
+                }
+                if (Bits > XPRESS_HUFF_MAX_BITS)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Symbol = Decoder->Symbol[Decoder->Index[Bits] + Code];
+            }
+            CONSUME_BITS(Bits);
+
+            if (Symbol < XPRESS_HUFF_END_OF_DATA)
+            {
+                *DstCur++ = (UCHAR)Symbol;
+                continue;
+            }
+
+            if (Symbol == XPRESS_HUFF_END_OF_DATA && SrcCur >= SrcEnd)
+                goto out;
+
+            Symbol -= XPRESS_HUFF_END_OF_DATA;
+            Length = Symbol & 0xF;
+            OffsetBits = Symbol >> 4;
+
+            if (Length == 15)
+            {
+                if (SrcCur >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *SrcCur++;
+                if (Length == 255)
+                {
+                    if (SrcEnd - SrcCur < sizeof(USHORT))
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = *(USHORT UNALIGNED *)SrcCur;
+                    SrcCur += sizeof(USHORT);
+                    if (Length == 0)
+                    {
+                        if (SrcEnd - SrcCur < sizeof(ULONG))
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        Length = *(ULONG UNALIGNED *)SrcCur;
+                        SrcCur += sizeof(ULONG);
+                    }
+                    if (Length < 15)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15;
+                }
+                Length += 15;
+            }
+            Length += LZ_MIN_MATCH;
+
+            Offset = 1 << OffsetBits;
+            if (OffsetBits)
+            {
+                Offset += NextBits >> (32 - OffsetBits);
+                CONSUME_BITS(OffsetBits);
+            }
+
+            if (Offset > DstCur - Dst)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            /* source and dest can be overlapping, copy bytes one by one */
+            Length = min(Length, (ULONG)(DstEnd - DstCur));
+            while (Length--)
+            {
+                *DstCur = *(DstCur - Offset);
+                DstCur++;
+            }
+        }
+    }
+
+#undef CONSUME_BITS
+
+out:
+    if (FinalSize)
+        *FinalSize = DstCur - Dst;
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+RtlpDecompressBufferXpressHuff(PUCHAR Dst,
+                               ULONG DstSize,
+                               PUCHAR Src,
+                               ULONG SrcSize,
+                               PULONG FinalSize)
+{
+    PXPRESS_HUFF_DECODER Decoder;
+    NTSTATUS Status;
+
+    /* The tables are too big for a kernel stack */
+    Decoder = RtlpAllocateMemory(sizeof(*Decoder), TAG_COMPRESS);
+    if (!Decoder)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    Status = RtlpDecompressXpressHuff(Decoder, Dst, DstSize, Src, SrcSize, FinalSize);
+
+    RtlpFreeMemory(Decoder, TAG_COMPRESS);
+    return Status;
+}
+
+
+
+FORCEINLINE
+ULONG
+RtlpLzHash(PLZ_MATCHER Matcher, ULONG Position)
+{
+    PUCHAR Data = Matcher->Buffer + Position;
+
+    return ((ULONG)(Data[0] | (Data[1] << 8) | (Data[2] << 16)) * 0x9E3779B1) >> Matcher->HashShift;
+}
+
+FORCEINLINE
+VOID
+RtlpLzInsert(PLZ_MATCHER Matcher, ULONG Position)
+{
+    ULONG Hash;
+
+    if (Position + LZ_MIN_MATCH > Matcher->BufferSize)
+        return;
+
+    Hash = RtlpLzHash(Matcher, Position);
+    Matcher->Prev[Position & Matcher->WindowMask] = Matcher->Head[Hash];
+    Matcher->Head[Hash] = Position + 1;
+}
+
+static NTSTATUS
+RtlpInitializeLzMatcher(PLZ_MATCHER Matcher,
+                        USHORT Engine,
+                        PUCHAR Buffer,
+                        ULONG BufferSize,
+                        PULONG Head,
+                        ULONG HashBits,
+                        PULONG Prev,
+                        ULONG WindowSize)
+{
+    if (Engine == COMPRESSION_ENGINE_STANDARD)
+    {
+        Matcher->MaxChain = 16;
+        Matcher->NiceLength = 32;
+    }
+    else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
+    {
+        Matcher->MaxChain = 256;
+        Matcher->NiceLength = LZ_MAX_MATCH;
+    }
+    else
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Matcher->Buffer = Buffer;
+    Matcher->BufferSize = BufferSize;
+    Matcher->Head = Head;
+    Matcher->Prev = Prev;
+    Matcher->HashShift = 32 - HashBits;
+    Matcher->WindowMask = WindowSize - 1;
+
+    /* The chains are only followed from the heads, they need no clearing */
+    RtlZeroMemory(Head, sizeof(ULONG) << HashBits);
+    return STATUS_SUCCESS;
+}
+
+/* Finds the longest match for the data at Position that starts no sooner
+ * than Lowest, returns its length or 0 if there is none */
+static ULONG
+RtlpLzFindMatch(PLZ_MATCHER Matcher,
+                ULONG Position,
+                ULONG Lowest,
+                ULONG MaxOffset,
+                ULONG MaxLength,
+                PULONG Offset)
+{
+    PUCHAR Current = Matcher->Buffer + Position, Candidate;
+    ULONG Chain = Matcher->MaxChain;
+    ULONG BestLength = LZ_MIN_MATCH - 1;
+    ULONG Next, Length;
+
+    if (MaxLength < LZ_MIN_MATCH)
+        return 0;
+
+    Next = Matcher->Head[RtlpLzHash(Matcher, Position)];
+    while (Next != 0 && Chain-- != 0)
+    {
+        Next--;
+        if (Next < Lowest || Position - Next > MaxOffset)
+            break;
+
+        /* Only compare what could beat the best match so far */
+        Candidate = Matcher->Buffer + Next;
+        if (Candidate[BestLength] == Current[BestLength] &&
+            Candidate[0] == Current[0] && Candidate[1] == Current[1])
+        {
+            for (Length = 2; Length < MaxLength && Candidate[Length] == Current[Length]; Length++);
+
+            if (Length > BestLength)
+            {
+                BestLength = Length;
+                *Offset = Position - Next;
+                if (Length >= Matcher->NiceLength || Length >= MaxLength)
+                    break;
+            }
+        }
+
+        Next = Matcher->Prev[Next & Matcher->WindowMask];
+    }
+
+    return (BestLength >= LZ_MIN_MATCH) ? BestLength : 0;
+}
+
+/* Compresses a single LZNT1 chunk, returns 0 if it doesn't fit in DstSize */
+static ULONG
+RtlpCompressChunkLZNT1(PLZ_MATCHER Matcher,
+                       ULONG ChunkStart,
+                       ULONG ChunkSize,
+                       PUCHAR Dst,
+                       ULONG DstSize)
+{
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize, FlagsPtr = NULL;
+    ULONG Position = 0, FlagBit = 8;
+    ULONG DisplacementBits, LengthBits, MaxLength, Length, Offset;
+    UCHAR Flags = 0;
+
+    while (Position < ChunkSize)
+    {
+        /* Each group of 8 literals or matches is preceded by their flags */
+        if (FlagBit == 8)
+        {
+            if (FlagsPtr)
+                *FlagsPtr = Flags;
+            if (DstCur >= DstEnd)
+                return 0;
+            FlagsPtr = DstCur++;
+            Flags = 0;
+            FlagBit = 0;
+        }
+
+        /* The longer the chunk so far, the more bits go to the displacement;
+         * this must be worked out the same way the decompressor does */
+        for (DisplacementBits = 12; DisplacementBits > 4; DisplacementBits--)
+            if ((1 << (DisplacementBits - 1)) < Position) break;
+        LengthBits = 16 - DisplacementBits;
+        MaxLength = min((1 << LengthBits) - 1 + LZ_MIN_MATCH, ChunkSize - Position);
+
+        Length = RtlpLzFindMatch(Matcher, ChunkStart + Position, ChunkStart,
+                                 LZNT1_CHUNK_SIZE, MaxLength, &Offset);
+        if (Length)
+        {
+            if (DstCur + sizeof(WORD) > DstEnd)
+                return 0;
+            *(WORD UNALIGNED *)DstCur = (WORD)(((Offset - 1) << LengthBits) | (Length - LZ_MIN_MATCH));
+            DstCur += sizeof(WORD);
+            Flags |= 1 << FlagBit;
+
+            while (Length--)
+                RtlpLzInsert(Matcher, ChunkStart + Position++);
+        }
+        else
+        {
+            if (DstCur >= DstEnd)
+                return 0;
+            *DstCur++ = Matcher->Buffer[ChunkStart + Position];
+            RtlpLzInsert(Matcher, ChunkStart + Position++);
+        }
+
+        FlagBit++;
+    }
+
+    if (FlagsPtr)
+        *FlagsPtr = Flags;
+
+    return DstCur - Dst;
+}
 
 static NTSTATUS
-RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+RtlpCompressBufferLZNT1(USHORT Engine, UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
                         ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
 {
-        UCHAR *src_cur = src, *src_end = src + src_size;
+        PLZNT1_WORKSPACE WorkSpace = (PLZNT1_WORKSPACE)workspace;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        ULONG position = 0, block_size, compressed_size;
+        LZ_MATCHER Matcher;
+        NTSTATUS Status;
+
+        Status = RtlpInitializeLzMatcher(&Matcher, Engine, src, src_size,
+                                         WorkSpace->Head, LZNT1_HASH_BITS,
+                                         WorkSpace->Prev, LZNT1_CHUNK_SIZE);
+        if (!NT_SUCCESS(Status))
+            return Status;
 
-        while (src_cur < src_end)
+        while (position < src_size)
         {
             /* determine size of current chunk */
-            block_size = min(0x1000, src_end - src_cur);
-            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+            block_size = min(LZNT1_CHUNK_SIZE, src_size - position);
+            if (dst_cur + sizeof(WORD) > dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
-            /* write (uncompressed) chunk header */
-            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-            dst_cur += sizeof(WORD);
+            /* the compressed chunk is only kept if it is smaller */
+            compressed_size = RtlpCompressChunkLZNT1(&Matcher, position, block_size,
+                                                     dst_cur + sizeof(WORD),
+                                                     min((ULONG)(dst_end - dst_cur - sizeof(WORD)),
+                                                         block_size - 1));
+            if (compressed_size)
+            {
+                /* write compressed chunk header */
+                *(WORD UNALIGNED *)dst_cur = 0xB000 | (compressed_size - 1);
+                dst_cur += sizeof(WORD) + compressed_size;
+            }
+            else
+            {
+                if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                    return STATUS_BUFFER_TOO_SMALL;
 
-            /* write chunk content */
-            memcpy(dst_cur, src_cur, block_size);
-            dst_cur += block_size;
-            src_cur += block_size;
+                /* write (uncompressed) chunk header */
+                *(WORD UNALIGNED *)dst_cur = 0x3000 | (block_size - 1);
+                dst_cur += sizeof(WORD);
+
+                /* write chunk content */
+                memcpy(dst_cur, src + position, block_size);
+                dst_cur += block_size;
+            }
+
+            position += block_size;
         }
 
         if (final_size)
@@ -248,25 +847,435 @@ RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
 }
 
 
+/* LZ77 as in the XPRESS format of [MS-XCA] 2.3, with 32-bit flags words */
 static NTSTATUS
-RtlpWorkSpaceSizeLZNT1(USHORT Engine,
-                       PULONG BufferAndWorkSpaceSize,
-                       PULONG FragmentWorkSpaceSize)
+RtlpCompressBufferXpress(USHORT Engine,
+                         PUCHAR Src,
+                         ULONG SrcSize,
+                         PUCHAR Dst,
+                         ULONG DstSize,
+                         PULONG FinalSize,
+                         PVOID WorkSpace)
 {
-   if (Engine == COMPRESSION_ENGINE_STANDARD)
-   {
-      *BufferAndWorkSpaceSize = 0x8010;
-      *FragmentWorkSpaceSize = 0x1000;
-      return(STATUS_SUCCESS);
-   }
-   else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
+    PXPRESS_WORKSPACE XpressWorkSpace = WorkSpace;
+    PUCHAR DstCur, DstEnd = Dst + DstSize, FlagsPtr, HalfBytePtr = NULL;
+    ULONG Position = 0, Flags = 0, FlagCount = 0;
+    ULONG Length, Offset, Extra;
+    LZ_MATCHER Matcher;
+    NTSTATUS Status;
+
+    Status = RtlpInitializeLzMatcher(&Matcher, Engine, Src, SrcSize,
+                                     XpressWorkSpace->Head, XPRESS_HASH_BITS,
+                                     XpressWorkSpace->Prev, XPRESS_WINDOW_SIZE);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    if (DstSize < sizeof(ULONG))
+        return STATUS_BUFFER_TOO_SMALL;
+    FlagsPtr = Dst;
+    DstCur = Dst + sizeof(ULONG);
+
+    while (Position < SrcSize)
+    {
+        Length = RtlpLzFindMatch(&Matcher, Position, 0, XPRESS_WINDOW_SIZE,
+                                 min(LZ_MAX_MATCH, SrcSize - Position), &Offset);
+        if (Length)
+        {
+            /* 2 bytes for the match, 4 more for its length at most */
+            if (DstEnd - DstCur < 6)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            Extra = Length - LZ_MIN_MATCH;
+            if (Extra < 7)
+            {
+                *(USHORT UNALIGNED *)DstCur = (USHORT)(((Offset - 1) << 3) | Extra);
+                DstCur += sizeof(USHORT);
+            }
+            else
+            {
+                *(USHORT UNALIGNED *)DstCur = (USHORT)(((Offset - 1) << 3) | 7);
+                DstCur += sizeof(USHORT);
+
+                /* The next 4 bits of length share a byte with those of the next long match */
+                Extra -= 7;
+                if (!HalfBytePtr)
+                {
+                    HalfBytePtr = DstCur++;
+                    *HalfBytePtr = (UCHAR)min(Extra, 15);
+                }
+                else
+                {
+                    *HalfBytePtr |= (UCHAR)(min(Extra, 15) << 4);
+                    HalfBytePtr = NULL;
+                }
+
+                if (Extra >= 15)
+                {
+                    Extra -= 15;
+                    if (Extra < 255)
+                    {
+                        *DstCur++ = (UCHAR)Extra;
+                    }
+                    else
+                    {
+                        *DstCur++ = 255;
+                        *(USHORT UNALIGNED *)DstCur = (USHORT)(Length - LZ_MIN_MATCH);
+                        DstCur += sizeof(USHORT);
+                    }
+                }
+            }
+
+            Flags = (Flags << 1) | 1;
+            while (Length--)
+                RtlpLzInsert(&Matcher, Position++);
+        }
+        else
+        {
+            if (DstCur >= DstEnd)
+                return STATUS_BUFFER_TOO_SMALL;
+            *DstCur++ = Src[Position];
+            RtlpLzInsert(&Matcher, Position++);
+            Flags <<= 1;
+        }
+
+        if (++FlagCount == 32)
+        {
+            *(ULONG UNALIGNED *)FlagsPtr = Flags;
+            if (DstEnd - DstCur < sizeof(ULONG))
+                return STATUS_BUFFER_TOO_SMALL;
+            FlagsPtr = DstCur;
+            DstCur += sizeof(ULONG);
+            Flags = 0;
+            FlagCount = 0;
+        }
+    }
+
+    /* The unused flags are set, the decompressor stops at a match with no input left */
+    if (FlagCount)
+        Flags = (Flags << (32 - FlagCount)) | ((1U << (32 - FlagCount)) - 1);
+    else
+        Flags = MAXULONG;
+    *(ULONG UNALIGNED *)FlagsPtr = Flags;
+
+    if (FinalSize)
+        *FinalSize = DstCur - Dst;
+
+    return STATUS_SUCCESS;
+}
+
+
+FORCEINLINE
+ULONG
+RtlpHighestBit(ULONG Value)
+{
+    ULONG Bit = 0;
+
+    while (Value >>= 1)
+        Bit++;
+
+    return Bit;
+}
+
+/* Works out the length of the code of each symbol from their frequencies */
+static VOID
+RtlpBuildHuffmanLengths(PXPRESS_HUFF_WORKSPACE WorkSpace)
+{
+    PULONG Frequency = WorkSpace->Frequency, Weight = WorkSpace->Weight;
+    PUSHORT Parent = WorkSpace->Parent, Sorted = WorkSpace->Sorted;
+    PUCHAR Length = WorkSpace->Length;
+    ULONG Count, Leaf, Node, Next, Pick, MaxLength, i, j;
+
+    for (;;)
+    {
+        /* Sort the symbols in use by frequency */
+        Count = 0;
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        {
+            Length[i] = 0;
+            if (Frequency[i] == 0)
+                continue;
+
+            for (j = Count; j > 0 && Frequency[Sorted[j - 1]] > Frequency[i]; j--)
+                Sorted[j] = Sorted[j - 1];
+            Sorted[j] = (USHORT)i;
+            Count++;
+        }
+
+        /* It takes two symbols to make a code, make one up if needed */
+        if (Count < 2)
+        {
+            Length[Sorted[0]] = 1;
+            Length[Sorted[0] ? 0 : 1] = 1;
+            return;
+        }
+
+        /* Leaves come first, sorted, and the nodes are created in order of
+         * weight too, so the two lightest are always at the front of either */
+        for (i = 0; i < Count; i++)
+            Weight[i] = Frequency[Sorted[i]];
+
+        Leaf = 0;
+        Node = Count;
+        for (Next = Count; Next < 2 * Count - 1; Next++)
+        {
+            Weight[Next] = 0;
+            for (j = 0; j < 2; j++)
+            {
+                if (Leaf < Count && (Node >= Next || Weight[Leaf] <= Weight[Node]))
+                    Pick = Leaf++;
+                else
+                    Pick = Node++;
+
+                Weight[Next] += Weight[Pick];
+                Parent[Pick] = (USHORT)Next;
+            }
+        }
+
+        /* Parents come after their children, turn them into depths from the root */
+        Parent[2 * Count - 2] = 0;
+        for (i = 2 * Count - 2; i-- > 0; )
+            Parent[i] = Parent[Parent[i]] + 1;
+
+        MaxLength = 0;
+        for (i = 0; i < Count; i++)
+        {
+            Length[Sorted[i]] = (UCHAR)min(Parent[i], 0xFF);
+            MaxLength = max(MaxLength, Parent[i]);
+        }
+
+        if (MaxLength <= XPRESS_HUFF_MAX_BITS)
+            return;
+
+        /* Too long for the format, flatten the frequencies and try again */
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        {
+            if (Frequency[i])
+                Frequency[i] = (Frequency[i] >> 1) | 1;
+        }
+    }
+}
+
+/* Canonical codes: shorter ones first, then by symbol */
+static VOID
+RtlpAssignHuffmanCodes(PUCHAR Length, PUSHORT Code)
+{
+    USHORT Count[XPRESS_HUFF_MAX_BITS + 1], NextCode[XPRESS_HUFF_MAX_BITS + 1];
+    ULONG i, Bits;
+
+    RtlZeroMemory(Count, sizeof(Count));
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        Count[Length[i]]++;
+    Count[0] = 0;
+
+    NextCode[0] = 0;
+    for (Bits = 1; Bits <= XPRESS_HUFF_MAX_BITS; Bits++)
+        NextCode[Bits] = (NextCode[Bits - 1] + Count[Bits - 1]) << 1;
+
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+    {
+        if (Length[i])
+            Code[i] = NextCode[Length[i]]++;
+    }
+}
+
+FORCEINLINE
+VOID
+RtlpWriteBits(PBIT_WRITER Writer, ULONG Value, ULONG Count)
+{
+    ULONG Left;
+
+    if (Writer->Count + Count <= 16)
+    {
+        Writer->Bits = (Writer->Bits << Count) | Value;
+        Writer->Count += Count;
+        return;
+    }
+
+    /* Fill up the current word and start the next one */
+    Left = Writer->Count + Count - 16;
+    *(USHORT UNALIGNED *)Writer->Word = (USHORT)((Writer->Bits << (Count - Left)) | (Value >> Left));
+    Writer->Word = Writer->NextWord;
+    Writer->NextWord = (PUSHORT)Writer->Next;
+    Writer->Next += sizeof(USHORT);
+    Writer->Bits = Value & ((1 << Left) - 1);
+    Writer->Count = Left;
+}
+
+/* LZ77 with Huffman codes as in the XPRESS_HUFF format of [MS-XCA] 2.1 */
+static NTSTATUS
+RtlpCompressBufferXpressHuff(USHORT Engine,
+                             PUCHAR Src,
+                             ULONG SrcSize,
+                             PUCHAR Dst,
+                             ULONG DstSize,
+                             PULONG FinalSize,
+                             PVOID WorkSpace)
+{
+    PXPRESS_HUFF_WORKSPACE HuffWorkSpace = WorkSpace;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize;
+    ULONG Position = 0, BlockEnd, TokenCount, Token;
+    ULONG Length, Offset, OffsetBits, Symbol, i;
+    BIT_WRITER Writer;
+    LZ_MATCHER Matcher;
+    NTSTATUS Status;
+
+    Status = RtlpInitializeLzMatcher(&Matcher, Engine, Src, SrcSize,
+                                     HuffWorkSpace->Head, XPRESS_HUFF_HASH_BITS,
+                                     HuffWorkSpace->Prev, XPRESS_HUFF_WINDOW_SIZE);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    do
+    {
+        /* Find the matches of the block first, its code depends on them */
+        BlockEnd = Position + min(XPRESS_HUFF_BLOCK_SIZE, SrcSize - Position);
+        RtlZeroMemory(HuffWorkSpace->Frequency, sizeof(HuffWorkSpace->Frequency));
+        TokenCount = 0;
+
+        while (Position < BlockEnd)
+        {
+            Length = RtlpLzFindMatch(&Matcher, Position, 0, XPRESS_HUFF_WINDOW_SIZE - 1,
+                                     min(LZ_MAX_MATCH, BlockEnd - Position), &Offset);
+
+            /* The shortest match at offset 1 has the code of the end of data */
+            if (Length == LZ_MIN_MATCH && Offset == 1)
+                Length = 0;
+
+            if (Length)
+            {
+                Symbol = XPRESS_HUFF_END_OF_DATA + (RtlpHighestBit(Offset) << 4) +
+                         min(Length - LZ_MIN_MATCH, 15);
+                HuffWorkSpace->Tokens[TokenCount++] = (Length << 16) | Offset;
+                HuffWorkSpace->Frequency[Symbol]++;
+
+                while (Length--)
+                    RtlpLzInsert(&Matcher, Position++);
+            }
+            else
+            {
+                HuffWorkSpace->Tokens[TokenCount++] = Src[Position];
+                HuffWorkSpace->Frequency[Src[Position]]++;
+                RtlpLzInsert(&Matcher, Position++);
+            }
+        }
+
+        if (Position == SrcSize)
+            HuffWorkSpace->Frequency[XPRESS_HUFF_END_OF_DATA]++;
+
+        RtlpBuildHuffmanLengths(HuffWorkSpace);
+        RtlpAssignHuffmanCodes(HuffWorkSpace->Length, HuffWorkSpace->Code);
+
+        /* The block starts with the code lengths, 4 bits each */
+        if (DstEnd - DstCur < XPRESS_HUFF_TABLE_SIZE + 2 * sizeof(USHORT))
+            return STATUS_BUFFER_TOO_SMALL;
+        for (i = 0; i < XPRESS_HUFF_TABLE_SIZE; i++)
+        {
+            DstCur[i] = HuffWorkSpace->Length[2 * i] |
+                        (HuffWorkSpace->Length[2 * i + 1] << 4);
+        }
+
+        Writer.Word = (PUSHORT)(DstCur + XPRESS_HUFF_TABLE_SIZE);
+        Writer.NextWord = Writer.Word + 1;
+        Writer.Next = (PUCHAR)(Writer.Word + 2);
+        Writer.Bits = 0;
+        Writer.Count = 0;
+
+        for (i = 0; i < TokenCount; i++)
+        {
+            /* 2 new words at most, and 3 bytes of length */
+            if (DstEnd - Writer.Next < 7)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            Token = HuffWorkSpace->Tokens[i];
+            if (Token < 0x100)
+            {
+                RtlpWriteBits(&Writer, HuffWorkSpace->Code[Token], HuffWorkSpace->Length[Token]);
+                continue;
+            }
+
+            Length = (Token >> 16) - LZ_MIN_MATCH;
+            Offset = Token & 0xFFFF;
+            OffsetBits = RtlpHighestBit(Offset);
+            Symbol = XPRESS_HUFF_END_OF_DATA + (OffsetBits << 4) + min(Length, 15);
+            RtlpWriteBits(&Writer, HuffWorkSpace->Code[Symbol], HuffWorkSpace->Length[Symbol]);
+
+            if (Length >= 15)
+            {
+                if (Length - 15 < 255)
+                {
+                    *Writer.Next++ = (UCHAR)(Length - 15);
+                }
+                else
+                {
+                    *Writer.Next++ = 255;
+                    *(USHORT UNALIGNED *)Writer.Next = (USHORT)Length;
+                    Writer.Next += sizeof(USHORT);
+                }
+            }
+
+            if (OffsetBits)
+                RtlpWriteBits(&Writer, Offset - (1 << OffsetBits), OffsetBits);
+        }
+
+        if (Position == SrcSize)
+        {
+            if (DstEnd - Writer.Next < 2 * sizeof(USHORT))
+                return STATUS_BUFFER_TOO_SMALL;
+            RtlpWriteBits(&Writer,
+                          HuffWorkSpace->Code[XPRESS_HUFF_END_OF_DATA],
+                          HuffWorkSpace->Length[XPRESS_HUFF_END_OF_DATA]);
+        }
+
+        /* Flush the bits, the word after them was read ahead and stays empty */
+        *(USHORT UNALIGNED *)Writer.Word = (USHORT)(Writer.Bits << (16 - Writer.Count));
+        *(USHORT UNALIGNED *)Writer.NextWord = 0;
+        DstCur = Writer.Next;
+    }
+    while (Position < SrcSize);
+
+    if (FinalSize)
+        *FinalSize = DstCur - Dst;
+
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS
+RtlpWorkSpaceSize(USHORT Format,
+                  USHORT Engine,
+                  PULONG BufferAndWorkSpaceSize,
+                  PULONG FragmentWorkSpaceSize)
+{
+   ULONG WorkSpaceSize;
+
+   /* Both engines use the same tables, they only search them more or less */
+   switch (Format)
    {
-      *BufferAndWorkSpaceSize = 0x10;
-      *FragmentWorkSpaceSize = 0x1000;
-      return(STATUS_SUCCESS);
+      case COMPRESSION_FORMAT_LZNT1:
+         WorkSpaceSize = sizeof(LZNT1_WORKSPACE);
+         break;
+
+      case COMPRESSION_FORMAT_XPRESS:
+         WorkSpaceSize = sizeof(XPRESS_WORKSPACE);
+         break;
+
+      case COMPRESSION_FORMAT_XPRESS_HUFF:
+         WorkSpaceSize = sizeof(XPRESS_HUFF_WORKSPACE);
+         break;
+
+      default:
+         return(STATUS_UNSUPPORTED_COMPRESSION);
    }
 
-   return(STATUS_NOT_SUPPORTED);
+   if (Engine != COMPRESSION_ENGINE_STANDARD &&
+       Engine != COMPRESSION_ENGINE_MAXIMUM)
+      return(STATUS_NOT_SUPPORTED);
+
+   *BufferAndWorkSpaceSize = WorkSpaceSize;
+
+   /* Only LZNT1 fragments need room to decompress a chunk */
+   *FragmentWorkSpaceSize = (Format == COMPRESSION_FORMAT_LZNT1) ? LZNT1_CHUNK_SIZE : 0;
+   return(STATUS_SUCCESS);
 }
 
 
@@ -284,20 +1293,43 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
       return(STATUS_INVALID_PARAMETER);
 
-   if (Format == COMPRESSION_FORMAT_LZNT1)
-      return(RtlpCompressBufferLZNT1(UncompressedBuffer,
-                                     UncompressedBufferSize,
-                                     CompressedBuffer,
-                                     CompressedBufferSize,
-                                     UncompressedChunkSize,
-                                     FinalCompressedSize,
-                                     WorkSpace));
+   /* LZNT1 always works in chunks of 4 KB, the XPRESS formats don't have any */
+   switch (Format)
+   {
+      case COMPRESSION_FORMAT_LZNT1:
+         return(RtlpCompressBufferLZNT1(Engine,
+                                        UncompressedBuffer,
+                                        UncompressedBufferSize,
+                                        CompressedBuffer,
+                                        CompressedBufferSize,
+                                        UncompressedChunkSize,
+                                        FinalCompressedSize,
+                                        WorkSpace));
+
+      case COMPRESSION_FORMAT_XPRESS:
+         return(RtlpCompressBufferXpress(Engine,
+                                         UncompressedBuffer,
+                                         UncompressedBufferSize,
+                                         CompressedBuffer,
+                                         CompressedBufferSize,
+                                         FinalCompressedSize,
+                                         WorkSpace));
+
+      case COMPRESSION_FORMAT_XPRESS_HUFF:
+         return(RtlpCompressBufferXpressHuff(Engine,
+                                             UncompressedBuffer,
+                                             UncompressedBufferSize,
+                                             CompressedBuffer,
+                                             CompressedBufferSize,
+                                             FinalCompressedSize,
+                                             WorkSpace));
+   }
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
@@ -357,6 +1389,17 @@ RtlDecompressFragment(IN USHORT format,
             return lznt1_decompress(uncompressed, uncompressed_size, compressed,
                                     compressed_size, offset, final_size, workspace);
 
+        /* only whole buffers, there is no telling where an offset starts */
+        case COMPRESSION_FORMAT_XPRESS:
+            if (offset) return STATUS_NOT_SUPPORTED;
+            return RtlpDecompressBufferXpress(uncompressed, uncompressed_size, compressed,
+                                              compressed_size, final_size);
+
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            if (offset) return STATUS_NOT_SUPPORTED;
+            return RtlpDecompressBufferXpressHuff(uncompressed, uncompressed_size, compressed,
+                                                  compressed_size, final_size);
+
         case COMPRESSION_FORMAT_NONE:
         case COMPRESSION_FORMAT_DEFAULT:
             return STATUS_INVALID_PARAMETER;
@@ -398,7 +1441,7 @@ RtlDescribeChunk(IN USHORT CompressionFormat,
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
@@ -412,12 +1455,10 @@ RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
          (Format == COMPRESSION_FORMAT_DEFAULT))
       return(STATUS_INVALID_PARAMETER);
 
-   if (Format == COMPRESSION_FORMAT_LZNT1)
-      return(RtlpWorkSpaceSizeLZNT1(Engine,
-                                    CompressBufferAndWorkSpaceSize,
-                                    CompressFragmentWorkSpaceSize));
-
-   return(STATUS_UNSUPPORTED_COMPRESSION);
+   return(RtlpWorkSpaceSize(Format,
+                            Engine,
+                            CompressBufferAndWorkSpaceSize,
+                            CompressFragmentWorkSpaceSize));
 }
 
 
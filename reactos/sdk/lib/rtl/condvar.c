@@ -12,6 +12,144 @@
 #define NDEBUG
 #include <debug.h>
 
+/* GLOBALS *******************************************************************/
+
+/* The waiters queue up wait blocks on their stacks, like the SRW lock's, and
+   park on the global keyed event with their wait block as the key. The low
+   bit of the condition variable locks the chain the rest of it points to. */
+#define RTL_CONDVAR_LOCKED_BIT  0
+#define RTL_CONDVAR_LOCKED      (1 << RTL_CONDVAR_LOCKED_BIT)
+
+typedef struct _RTLP_CONDVAR_WAITBLOCK
+{
+    /* Last points to the last wait block in the chain. The value
+       is only valid when read from the first wait block. */
+    volatile struct _RTLP_CONDVAR_WAITBLOCK *Last;
+
+    /* Next points to the next wait block in the chain. */
+    volatile struct _RTLP_CONDVAR_WAITBLOCK *Next;
+
+    /* Set once a waker took the block off the chain. The keyed event
+       is then going to be released for it, even if the wait timed out. */
+    BOOLEAN Removed;
+} volatile RTLP_CONDVAR_WAITBLOCK, *PRTLP_CONDVAR_WAITBLOCK;
+
+/* PRIVATE FUNCTIONS *********************************************************/
+
+static PRTLP_CONDVAR_WAITBLOCK
+NTAPI
+RtlpAcquireWaitBlockLock(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable)
+{
+    LONG_PTR CurrentValue;
+
+    while (1)
+    {
+        CurrentValue = *(volatile LONG_PTR *)&ConditionVariable->Ptr;
+        if (!(CurrentValue & RTL_CONDVAR_LOCKED))
+        {
+            if (InterlockedCompareExchangePointer(&ConditionVariable->Ptr,
+                                                  (PVOID)(CurrentValue | RTL_CONDVAR_LOCKED),
+                                                  (PVOID)CurrentValue) == (PVOID)CurrentValue)
+            {
+                /* We own the chain now */
+                return (PRTLP_CONDVAR_WAITBLOCK)CurrentValue;
+            }
+        }
+
+        YieldProcessor();
+    }
+}
+
+
+static VOID
+NTAPI
+RtlpReleaseWaitBlockLock(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
+                         IN PRTLP_CONDVAR_WAITBLOCK FirstWaitBlock  OPTIONAL)
+{
+    (void)InterlockedExchangePointer(&ConditionVariable->Ptr,
+                                     (PVOID)FirstWaitBlock);
+}
+
+
+static VOID
+NTAPI
+RtlpQueueWaitBlock(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
+                   OUT PRTLP_CONDVAR_WAITBLOCK WaitBlock)
+{
+    PRTLP_CONDVAR_WAITBLOCK FirstWaitBlock;
+
+    WaitBlock->Last = WaitBlock;
+    WaitBlock->Next = NULL;
+    WaitBlock->Removed = FALSE;
+
+    FirstWaitBlock = RtlpAcquireWaitBlockLock(ConditionVariable);
+    if (FirstWaitBlock != NULL)
+    {
+        /* Wake the waiters in the order they came */
+        FirstWaitBlock->Last->Next = WaitBlock;
+        FirstWaitBlock->Last = WaitBlock;
+    }
+    else
+    {
+        FirstWaitBlock = WaitBlock;
+    }
+
+    RtlpReleaseWaitBlockLock(ConditionVariable, FirstWaitBlock);
+}
+
+
+static NTSTATUS
+NTAPI
+RtlpWaitForWake(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
+                IN PRTLP_CONDVAR_WAITBLOCK WaitBlock,
+                IN PLARGE_INTEGER TimeOut  OPTIONAL)
+{
+    PRTLP_CONDVAR_WAITBLOCK FirstWaitBlock, Previous, Current;
+    NTSTATUS Status;
+
+    Status = NtWaitForKeyedEvent(NULL,
+                                 (PVOID)WaitBlock,
+                                 FALSE,
+                                 TimeOut);
+    if (Status == STATUS_SUCCESS)
+        return Status;
+
+    FirstWaitBlock = RtlpAcquireWaitBlockLock(ConditionVariable);
+    if (WaitBlock->Removed)
+    {
+        /* We were woken in the meantime. The waker is releasing the
+           keyed event for us, take it or it would wait forever. */
+        RtlpReleaseWaitBlockLock(ConditionVariable, FirstWaitBlock);
+
+        NtWaitForKeyedEvent(NULL, (PVOID)WaitBlock, FALSE, NULL);
+        return STATUS_SUCCESS;
+    }
+
+    /* Take our wait block off the chain */
+    Previous = NULL;
+    for (Current = FirstWaitBlock; Current != WaitBlock; Current = Current->Next)
+    {
+        ASSERT(Current != NULL);
+        Previous = Current;
+    }
+
+    if (Previous == NULL)
+    {
+        FirstWaitBlock = WaitBlock->Next;
+        if (FirstWaitBlock != NULL)
+            FirstWaitBlock->Last = WaitBlock->Last;
+    }
+    else
+    {
+        Previous->Next = WaitBlock->Next;
+        if (FirstWaitBlock->Last == WaitBlock)
+            FirstWaitBlock->Last = Previous;
+    }
+
+    RtlpReleaseWaitBlockLock(ConditionVariable, FirstWaitBlock);
+    return Status;
+}
+
 /* FUNCTIONS *****************************************************************/
 
 VOID
@@ -26,7 +164,28 @@ VOID
 NTAPI
 RtlWakeConditionVariable(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable)
 {
-    UNIMPLEMENTED;
+    PRTLP_CONDVAR_WAITBLOCK FirstWaitBlock, Next = NULL;
+
+    /* Nobody waiting, nothing to do */
+    if (*(volatile PVOID *)&ConditionVariable->Ptr == NULL)
+        return;
+
+    FirstWaitBlock = RtlpAcquireWaitBlockLock(ConditionVariable);
+    if (FirstWaitBlock != NULL)
+    {
+        Next = FirstWaitBlock->Next;
+        if (Next != NULL)
+            Next->Last = FirstWaitBlock->Last;
+
+        FirstWaitBlock->Removed = TRUE;
+    }
+
+    RtlpReleaseWaitBlockLock(ConditionVariable, Next);
+
+    if (FirstWaitBlock != NULL)
+    {
+        NtReleaseKeyedEvent(NULL, (PVOID)FirstWaitBlock, FALSE, NULL);
+    }
 }
 
 
@@ -34,7 +193,27 @@ VOID
 NTAPI
 RtlWakeAllConditionVariable(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable)
 {
-    UNIMPLEMENTED;
+    PRTLP_CONDVAR_WAITBLOCK WaitBlock, Next;
+
+    /* Nobody waiting, nothing to do */
+    if (*(volatile PVOID *)&ConditionVariable->Ptr == NULL)
+        return;
+
+    /* Take the whole chain */
+    WaitBlock = RtlpAcquireWaitBlockLock(ConditionVariable);
+    for (Next = WaitBlock; Next != NULL; Next = Next->Next)
+    {
+        Next->Removed = TRUE;
+    }
+    RtlpReleaseWaitBlockLock(ConditionVariable, NULL);
+
+    while (WaitBlock != NULL)
+    {
+        /* The wait block goes away once its waiter is released */
+        Next = WaitBlock->Next;
+        NtReleaseKeyedEvent(NULL, (PVOID)WaitBlock, FALSE, NULL);
+        WaitBlock = Next;
+    }
 }
 
 
@@ -44,8 +223,17 @@ RtlSleepConditionVariableCS(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
                             IN OUT PRTL_CRITICAL_SECTION CriticalSection,
                             IN PLARGE_INTEGER TimeOut  OPTIONAL)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    RTLP_CONDVAR_WAITBLOCK WaitBlock;
+    NTSTATUS Status;
+
+    /* Queue up before letting go of the lock, so no wake can be missed */
+    RtlpQueueWaitBlock(ConditionVariable, &WaitBlock);
+    RtlLeaveCriticalSection(CriticalSection);
+
+    Status = RtlpWaitForWake(ConditionVariable, &WaitBlock, TimeOut);
+
+    RtlEnterCriticalSection(CriticalSection);
+    return Status;
 }
 
 
@@ -56,6 +244,26 @@ RtlSleepConditionVariableSRW(IN OUT PRTL_CONDITION_VARIABLE ConditionVariable,
                              IN PLARGE_INTEGER TimeOut  OPTIONAL,
                              IN ULONG Flags)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    RTLP_CONDVAR_WAITBLOCK WaitBlock;
+    NTSTATUS Status;
+
+    if (Flags & ~RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+        return STATUS_INVALID_PARAMETER_4;
+
+    /* Queue up before letting go of the lock, so no wake can be missed */
+    RtlpQueueWaitBlock(ConditionVariable, &WaitBlock);
+    if (Flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+        RtlReleaseSRWLockShared(SRWLock);
+    else
+        RtlReleaseSRWLockExclusive(SRWLock);
+
+    Status = RtlpWaitForWake(ConditionVariable, &WaitBlock, TimeOut);
+
+    if (Flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+        RtlAcquireSRWLockShared(SRWLock);
+    else
+        RtlAcquireSRWLockExclusive(SRWLock);
+    return Status;
 }
+
+/* EOF */
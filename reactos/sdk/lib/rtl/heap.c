@@ -1518,7 +1518,9 @@ RtlCreateHeap(ULONG Flags,
     {
         RtlpAddHeapToProcessList(Heap);
 
-        // FIXME: What about lookasides?
+        /* Enable the low fragmentation front end if it's on by default */
+        if (RtlpLowFragHeapEnabled && !(Flags & HEAP_NO_SERIALIZE))
+            RtlpActivateLowFragHeap(Heap);
     }
 
     return Heap;
@@ -1584,6 +1586,9 @@ RtlDestroyHeap(HANDLE HeapPtr) /* [in] Handle of heap */
         RtlpRemoveHeapFromProcessList(Heap);
     }
 
+    /* Release the front end, if any */
+    RtlpDestroyLowFragHeap(Heap);
+
     /* Delete the heap lock */
     if (!(Heap->Flags & HEAP_NO_SERIALIZE))
     {
@@ -1928,6 +1933,7 @@ RtlAllocateHeap(IN PVOID HeapPtr,
     BOOLEAN HeapLocked = FALSE;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
     PHEAP_ENTRY_EXTRA Extra;
+    PVOID FrontEndBlock;
     NTSTATUS Status;
 
     /* Force flags */
@@ -1977,6 +1983,16 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks are served by the front end without taking the lock */
+    if (Heap->FrontEndHeap &&
+        Index < HEAP_LFH_BUCKETS &&
+        !(Flags & HEAP_NO_SERIALIZE) &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        FrontEndBlock = RtlpLowFragHeapAllocate(Heap, Flags, Size, Index, EntryFlags);
+        if (FrontEndBlock) return FrontEndBlock;
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2180,6 +2196,20 @@ BOOLEAN NTAPI RtlFreeHeap(
     if (RtlpHeapIsSpecial(Flags))
         return RtlDebugFreeHeap(Heap, Flags, Ptr);
 
+    /* Give small blocks back to the front end without taking the lock */
+    if (Heap->FrontEndHeap && !(Flags & HEAP_NO_SERIALIZE))
+    {
+        HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+
+        if ((HeapEntry->Flags & HEAP_ENTRY_BUSY) &&
+            (((ULONG_PTR)Ptr & 0x7) == 0) &&
+            (HeapEntry->SegmentOffset < HEAP_SEGMENTS) &&
+            RtlpLowFragHeapFree(Heap, HeapEntry))
+        {
+            return TRUE;
+        }
+    }
+
     /* Lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2190,10 +2220,11 @@ BOOLEAN NTAPI RtlFreeHeap(
     /* Get pointer to the heap entry */
     HeapEntry = (PHEAP_ENTRY)Ptr - 1;
 
-    /* Check this entry, fail if it's invalid */
+    /* Check this entry, fail if it's invalid or held by the front end */
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
         (((ULONG_PTR)Ptr & 0x7) != 0) ||
-        (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+        (HeapEntry->SegmentOffset >= HEAP_SEGMENTS) ||
+        (Heap->FrontEndHeap && HeapEntry->UnusedBytes == HEAP_LFH_CACHED_BLOCK))
     {
         /* This is an invalid block */
         DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -3902,6 +3933,8 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
     /* Setting heap information is not really supported except for enabling LFH */
     if (HeapInformationClass == HeapCompatibilityInformation)
     {
+        if (!HeapHandle) return STATUS_INVALID_PARAMETER;
+
         /* Check buffer length */
         if (HeapInformationLength < sizeof(ULONG))
         {
@@ -3915,8 +3948,8 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        /* Switch the heap to the low fragmentation front end */
+        return RtlpActivateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -55,6 +55,22 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front end heap types */
+#define HEAP_FRONT_END_NONE    0
+#define HEAP_FRONT_END_LFH     2
+
+/* Low fragmentation front end tuning */
+#define HEAP_LFH_BUCKETS        HEAP_FREELISTS
+#define HEAP_LFH_AFFINITY_SLOTS 8
+#define HEAP_LFH_MINIMUM_INDEX  2
+#define HEAP_LFH_MINIMUM_DEPTH  4
+#define HEAP_LFH_MAXIMUM_DEPTH  256
+#define HEAP_LFH_MAXIMUM_REFILL 16
+#define HEAP_LFH_TUNING_PERIOD  512
+
+/* UnusedBytes of a block held by the front end, a busy block never has that many */
+#define HEAP_LFH_CACHED_BLOCK   0xFF
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -269,6 +285,30 @@ typedef struct _HEAP
     HEAP_TUNING_PARAMETERS TuningParameters;
 } HEAP, *PHEAP;
 
+typedef struct _HEAP_LFH_SLOT
+{
+    SLIST_HEADER ListHead;
+    USHORT Depth;
+    ULONG TotalAllocates;
+    ULONG AllocateMisses;
+    ULONG TotalFrees;
+    ULONG FreeMisses;
+    ULONG LastTotalAllocates;
+    ULONG LastAllocateMisses;
+} HEAP_LFH_SLOT, *PHEAP_LFH_SLOT;
+
+typedef struct _HEAP_LFH_BUCKET
+{
+    HEAP_LFH_SLOT Slots[HEAP_LFH_AFFINITY_SLOTS];
+} HEAP_LFH_BUCKET, *PHEAP_LFH_BUCKET;
+
+typedef struct _HEAP_LFH
+{
+    PHEAP Heap;
+    ULONG AffinityMask;
+    HEAP_LFH_BUCKET Buckets[HEAP_LFH_BUCKETS];
+} HEAP_LFH, *PHEAP_LFH;
+
 typedef struct _HEAP_SEGMENT
 {
     HEAP_ENTRY Entry;
@@ -330,6 +370,7 @@ typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
 /* Global variables */
 extern RTL_CRITICAL_SECTION RtlpProcessHeapsListLock;
 extern BOOLEAN RtlpPageHeapEnabled;
+extern BOOLEAN RtlpLowFragHeapEnabled;
 
 /* Functions declarations */
 
@@ -406,6 +447,24 @@ RtlDebugSizeHeap(HANDLE HeapPtr,
                  ULONG Flags,
                  PVOID Ptr);
 
+/* heaplfh.c */
+PVOID NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap);
+
 /* heappage.c */
 
 HANDLE NTAPI
@@ -0,0 +1,348 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Heap low fragmentation front end
+ * PROGRAMMERS:     ReactOS Team
+ */
+
+/* The front end sits in front of the back end free lists and serves small
+   blocks (every size which has a dedicated free list) from per size class
+   buckets. Each bucket is split into several affinity slots, a slot being
+   picked from the current thread id, so that threads hammering the same size
+   class don't fight over the same cache line. Each slot is a lock-free S-List
+   of real back end blocks which are still marked busy, so the back end never
+   coalesces them while they are cached. Their UnusedBytes is set to
+   HEAP_LFH_CACHED_BLOCK though, so that freeing one of them again is caught
+   instead of putting the block twice on the list. The depth of each slot is tuned
+   periodically from its hit ratio and excess blocks are given back to the
+   back end, which keeps the amount of memory held by the front end bounded. */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ******************************************************************/
+
+BOOLEAN RtlpLowFragHeapEnabled = FALSE;
+
+/* FUNCTIONS *****************************************************************/
+
+FORCEINLINE
+PHEAP_LFH_SLOT
+RtlpLowFragHeapGetSlot(PHEAP_LFH FrontEnd,
+                       SIZE_T Index)
+{
+    ULONG Affinity;
+
+    /* Thread ids are multiples of 4, skip the always clear bits */
+    Affinity = HandleToUlong(NtCurrentTeb()->ClientId.UniqueThread) >> 2;
+
+    return &FrontEnd->Buckets[Index].Slots[Affinity & FrontEnd->AffinityMask];
+}
+
+static
+VOID
+RtlpLowFragHeapTrimSlot(PHEAP Heap,
+                        PHEAP_LFH_SLOT Slot)
+{
+    PSLIST_ENTRY ListEntry;
+
+    /* Nothing to do if the slot holds no more than it is allowed to */
+    if (RtlQueryDepthSList(&Slot->ListHead) <= Slot->Depth) return;
+
+    /* Give the excess blocks back to the back end in one go */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    while (RtlQueryDepthSList(&Slot->ListHead) > Slot->Depth)
+    {
+        ListEntry = RtlInterlockedPopEntrySList(&Slot->ListHead);
+        if (!ListEntry) break;
+
+        /* Make it a plain busy block again for the back end */
+        ((PHEAP_ENTRY)ListEntry - 1)->UnusedBytes = sizeof(HEAP_ENTRY);
+        RtlFreeHeap(Heap, HEAP_NO_SERIALIZE, ListEntry);
+    }
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+}
+
+static
+VOID
+RtlpLowFragHeapTuneSlot(PHEAP Heap,
+                        PHEAP_LFH_SLOT Slot)
+{
+    ULONG Allocates, Misses;
+
+    /* Get the activity since the last tuning pass */
+    Allocates = Slot->TotalAllocates - Slot->LastTotalAllocates;
+    Misses = Slot->AllocateMisses - Slot->LastAllocateMisses;
+    Slot->LastTotalAllocates = Slot->TotalAllocates;
+    Slot->LastAllocateMisses = Slot->AllocateMisses;
+
+    if (Misses * 16 > Allocates)
+    {
+        /* More than 1 miss out of 16, this size class is hot: cache more */
+        Slot->Depth = min(Slot->Depth * 2, HEAP_LFH_MAXIMUM_DEPTH);
+    }
+    else if (Misses * 256 < Allocates)
+    {
+        /* Almost no misses, we are probably caching too much */
+        Slot->Depth = max(Slot->Depth - (Slot->Depth / 4), HEAP_LFH_MINIMUM_DEPTH);
+        RtlpLowFragHeapTrimSlot(Heap, Slot);
+    }
+}
+
+static
+PHEAP_ENTRY
+RtlpLowFragHeapRefill(PHEAP Heap,
+                      PHEAP_LFH_SLOT Slot,
+                      SIZE_T Index)
+{
+    PHEAP_ENTRY Entry, Result = NULL;
+    SIZE_T BlockSize;
+    ULONG Count, i;
+    PVOID Block;
+
+    /* Calculate the user size which maps exactly to this size class */
+    if ((Index << HEAP_ENTRY_SHIFT) <= Heap->AlignRound) return NULL;
+    BlockSize = (Index << HEAP_ENTRY_SHIFT) - Heap->AlignRound;
+
+    /* Refill with half of the slot depth, so that blocks of the same size
+       get carved next to each other from the back end */
+    Count = min(max(Slot->Depth / 2, 1), HEAP_LFH_MAXIMUM_REFILL);
+
+    /* Take the heap lock only once for the whole batch */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    for (i = 0; i < Count; i++)
+    {
+        Block = RtlAllocateHeap(Heap, HEAP_NO_SERIALIZE, BlockSize);
+        if (!Block) break;
+
+        Entry = (PHEAP_ENTRY)Block - 1;
+
+        /* The back end couldn't split off an exact block, stop here */
+        if (Entry->Size != Index)
+        {
+            RtlFreeHeap(Heap, HEAP_NO_SERIALIZE, Block);
+            break;
+        }
+
+        /* Give the first block to the caller, cache the others */
+        if (!Result)
+        {
+            Result = Entry;
+        }
+        else
+        {
+            Entry->Flags = HEAP_ENTRY_BUSY | (Entry->Flags & HEAP_ENTRY_LAST_ENTRY);
+            Entry->UnusedBytes = HEAP_LFH_CACHED_BLOCK;
+            RtlInterlockedPushEntrySList(&Slot->ListHead, (PSLIST_ENTRY)Block);
+        }
+    }
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    return Result;
+}
+
+PVOID
+NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        ULONG Flags,
+                        SIZE_T Size,
+                        SIZE_T Index,
+                        UCHAR EntryFlags)
+{
+    PHEAP_LFH FrontEnd = (PHEAP_LFH)Heap->FrontEndHeap;
+    PHEAP_LFH_SLOT Slot;
+    PSLIST_ENTRY ListEntry;
+    PHEAP_ENTRY InUseEntry;
+    ULONG TotalAllocates;
+
+    ASSERT(Index < HEAP_LFH_BUCKETS);
+    ASSERT(!(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT));
+
+    /* Blocks must be able to hold the S-List link while they are cached */
+    if (Index < HEAP_LFH_MINIMUM_INDEX) return NULL;
+
+    Slot = RtlpLowFragHeapGetSlot(FrontEnd, Index);
+    TotalAllocates = InterlockedIncrement((PLONG)&Slot->TotalAllocates);
+
+    /* Try the lock-free path first */
+    ListEntry = RtlInterlockedPopEntrySList(&Slot->ListHead);
+    if (ListEntry)
+    {
+        InUseEntry = (PHEAP_ENTRY)ListEntry - 1;
+    }
+    else
+    {
+        /* Get a batch of blocks from the back end */
+        InterlockedIncrement((PLONG)&Slot->AllocateMisses);
+        InUseEntry = RtlpLowFragHeapRefill(Heap, Slot, Index);
+        if (!InUseEntry) return NULL;
+    }
+
+    /* Retune this slot from time to time */
+    if ((TotalAllocates % HEAP_LFH_TUNING_PERIOD) == 0)
+        RtlpLowFragHeapTuneSlot(Heap, Slot);
+
+    /* Initialize this block */
+    ASSERT(InUseEntry->Size == Index);
+    InUseEntry->Flags = EntryFlags | (InUseEntry->Flags & HEAP_ENTRY_LAST_ENTRY);
+    InUseEntry->UnusedBytes = (UCHAR)((Index << HEAP_ENTRY_SHIFT) - Size);
+    InUseEntry->SmallTagIndex = 0;
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(InUseEntry + 1, Size);
+
+    /* User data starts right after the entry's header */
+    return InUseEntry + 1;
+}
+
+BOOLEAN
+NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH FrontEnd = (PHEAP_LFH)Heap->FrontEndHeap;
+    PHEAP_LFH_SLOT Slot;
+    SIZE_T Index = HeapEntry->Size;
+
+    /* Only plain small blocks are cached */
+    if (Index < HEAP_LFH_MINIMUM_INDEX ||
+        Index >= HEAP_LFH_BUCKETS ||
+        (HeapEntry->Flags & (HEAP_ENTRY_VIRTUAL_ALLOC | HEAP_ENTRY_EXTRA_PRESENT)))
+    {
+        return FALSE;
+    }
+
+    /* This block is cached already, it is being freed twice. Leave it to
+       the back end, which rejects it as an invalid block */
+    if (HeapEntry->UnusedBytes == HEAP_LFH_CACHED_BLOCK)
+    {
+        DPRINT1("HEAP: Trying to free the cached block %p again!\n", HeapEntry + 1);
+        return FALSE;
+    }
+
+    Slot = RtlpLowFragHeapGetSlot(FrontEnd, Index);
+    InterlockedIncrement((PLONG)&Slot->TotalFrees);
+
+    /* Let the back end take it if this slot is full */
+    if (RtlQueryDepthSList(&Slot->ListHead) >= Slot->Depth)
+    {
+        InterlockedIncrement((PLONG)&Slot->FreeMisses);
+        return FALSE;
+    }
+
+    /* Keep the block busy and drop the user flags, then cache it */
+    HeapEntry->Flags = HEAP_ENTRY_BUSY | (HeapEntry->Flags & HEAP_ENTRY_LAST_ENTRY);
+    HeapEntry->UnusedBytes = HEAP_LFH_CACHED_BLOCK;
+    RtlInterlockedPushEntrySList(&Slot->ListHead, (PSLIST_ENTRY)(HeapEntry + 1));
+
+    return TRUE;
+}
+
+NTSTATUS
+NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH FrontEnd = NULL;
+    SIZE_T Size = sizeof(HEAP_LFH);
+    ULONG Processors, Bucket, Slot;
+    NTSTATUS Status;
+
+    /* Nothing to do if it's already active */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH) return STATUS_SUCCESS;
+
+    /* The front end relies on the heap lock and doesn't know about
+       validation, tagging or fill patterns */
+    if (RtlpGetMode() != UserMode ||
+        RtlpHeapIsSpecial(Heap->Flags | Heap->ForceFlags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)) ||
+        Heap->PseudoTagEntries)
+    {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    Status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+                                     (PVOID *)&FrontEnd,
+                                     0,
+                                     &Size,
+                                     MEM_RESERVE | MEM_COMMIT,
+                                     PAGE_READWRITE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("HEAP: Failed to allocate the front end (0x%08X)\n", Status);
+        return Status;
+    }
+
+    /* Use as many affinity slots as there are processors, rounded up to a power of 2 */
+    Processors = min(NtCurrentPeb()->NumberOfProcessors, HEAP_LFH_AFFINITY_SLOTS);
+    FrontEnd->AffinityMask = 0;
+    while (FrontEnd->AffinityMask + 1 < Processors)
+        FrontEnd->AffinityMask = (FrontEnd->AffinityMask << 1) | 1;
+
+    for (Bucket = 0; Bucket < HEAP_LFH_BUCKETS; Bucket++)
+    {
+        for (Slot = 0; Slot < HEAP_LFH_AFFINITY_SLOTS; Slot++)
+        {
+            RtlInitializeSListHead(&FrontEnd->Buckets[Bucket].Slots[Slot].ListHead);
+            FrontEnd->Buckets[Bucket].Slots[Slot].Depth = HEAP_LFH_MINIMUM_DEPTH;
+        }
+    }
+
+    FrontEnd->Heap = Heap;
+
+    /* Publish it, unless somebody was faster */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    if (!Heap->FrontEndHeap)
+    {
+        Heap->FrontEndHeap = FrontEnd;
+        Heap->FrontEndHeapType = HEAP_FRONT_END_LFH;
+        FrontEnd = NULL;
+    }
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    if (FrontEnd)
+    {
+        Size = 0;
+        ZwFreeVirtualMemory(NtCurrentProcess(),
+                            (PVOID *)&FrontEnd,
+                            &Size,
+                            MEM_RELEASE);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap)
+{
+    PVOID FrontEnd = Heap->FrontEndHeap;
+    SIZE_T Size = 0;
+
+    if (!FrontEnd) return;
+
+    /* Cached blocks live in the heap segments, which go away with the heap */
+    Heap->FrontEndHeap = NULL;
+    Heap->FrontEndHeapType = HEAP_FRONT_END_NONE;
+
+    ZwFreeVirtualMemory(NtCurrentProcess(),
+                        &FrontEnd,
+                        &Size,
+                        MEM_RELEASE);
+}
+
+/* EOF */
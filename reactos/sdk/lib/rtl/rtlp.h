@@ -210,13 +210,32 @@ DebugService2(
 #define TAG_ASTR        'RTSA'
 #define TAG_OSTR        'RTSO'
 
-/* Timer Queue */
+/* Thread Pool */
 
 extern HANDLE TimerThreadHandle;
 
 NTSTATUS
 RtlpInitializeTimerThread(VOID);
 
+BOOLEAN
+RtlpIsIoPending(IN HANDLE ThreadHandle OPTIONAL);
+
+/* Internal flags for RtlpTpSetFlags */
+#define RTLP_TP_EXECUTE_INLINE          0x1     /* Run wait callbacks on the waiter thread */
+#define RTLP_TP_REARM_WAIT              0x2     /* Wait again after each callback */
+
+VOID
+RtlpTpSetFlags(IN PVOID Object,
+               IN ULONG Flags);
+
+BOOLEAN
+RtlpTpHasCallbacks(IN PVOID Object);
+
+NTSTATUS
+RtlpTpSetWait(IN PVOID Wait,
+              IN HANDLE Handle OPTIONAL,
+              IN PLARGE_INTEGER Timeout OPTIONAL);
+
 /* bitmap64.c */
 typedef struct _RTL_BITMAP64
 {
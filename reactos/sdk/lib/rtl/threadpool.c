@@ -0,0 +1,2090 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Thread pool built around an I/O completion port
+ * FILE:              lib/rtl/threadpool.c
+ * PROGRAMMER:
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * Every callback object (work, timer, wait, I/O) is posted to its pool's
+ * completion port as a packet whose key is the object. The port is created
+ * with one concurrent thread per processor, so the kernel decides how many
+ * workers run at once; the pool only makes sure a worker is parked on the
+ * port whenever the others are busy, which lets a blocked callback be
+ * replaced without oversubscribing the processors with CPU-bound ones.
+ *
+ * Timers are kept by a single process-wide timer thread, and waits are
+ * batched up to MAXIMUM_WAIT_OBJECTS - 1 per waiter thread. Both only post
+ * packets, the callbacks always run on the pool's workers unless the object
+ * asked to be persistent (or inline for RtlRegisterWait).
+ */
+
+/* TYPES ********************************************************************/
+
+extern PRTL_START_POOL_THREAD RtlpStartThreadFunc;
+extern PRTL_EXIT_POOL_THREAD RtlpExitThreadFunc;
+
+#define RTLP_TP_MAX_THREADS             500
+#define RTLP_TP_IDLE_TIMEOUT            (-20LL * 1000 * 10000) /* 20 seconds */
+#define RTLP_TP_WAITS_PER_THREAD        (MAXIMUM_WAIT_OBJECTS - 1)
+#define RTLP_TP_INFINITE                MAXLONGLONG
+
+/* Object flags, RTLP_TP_EXECUTE_INLINE and RTLP_TP_REARM_WAIT are in rtlp.h */
+#define RTLP_TP_LONG_FUNCTION           0x100
+#define RTLP_TP_PERSISTENT              0x200
+#define RTLP_TP_RELEASED                0x400
+#define RTLP_TP_UNACCOUNTED             0x800
+
+typedef VOID
+(NTAPI *PRTLP_OVERLAPPED_COMPLETION_ROUTINE)(
+    IN ULONG ErrorCode,
+    IN ULONG NumberOfBytesTransferred,
+    IN PVOID Overlapped);
+
+typedef struct _RTLP_TP_POOL
+{
+    LONG RefCount;
+    HANDLE CompletionPort;
+    RTL_CRITICAL_SECTION Lock;
+    ULONG MinThreads;
+    ULONG MaxThreads;
+    LONG Threads;
+    LONG IdleThreads;
+    BOOLEAN Shutdown;
+} RTLP_TP_POOL, *PRTLP_TP_POOL;
+
+typedef struct _RTLP_TP_CLEANUP_GROUP
+{
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY MemberList;
+} RTLP_TP_CLEANUP_GROUP, *PRTLP_TP_CLEANUP_GROUP;
+
+typedef enum _RTLP_TP_OBJECT_TYPE
+{
+    RtlpTpSimpleObject,
+    RtlpTpWorkObject,
+    RtlpTpTimerObject,
+    RtlpTpWaitObject,
+    RtlpTpIoObject
+} RTLP_TP_OBJECT_TYPE;
+
+struct _RTLP_TP_WAITER;
+
+typedef struct _RTLP_TP_OBJECT
+{
+    RTLP_TP_OBJECT_TYPE Type;
+    ULONG Flags;
+    LONG RefCount;
+    LONG Pending;           /* Callbacks queued but not started */
+    LONG Running;           /* Callbacks started and not finished */
+    LONG Waiters;           /* Threads waiting for the callbacks */
+    PRTLP_TP_POOL Pool;
+    PVOID Callback;
+    PVOID Context;
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup;
+    LIST_ENTRY CleanupGroupEntry;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CleanupGroupCancelCallback;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PVOID RaceDll;
+    union
+    {
+        struct
+        {
+            LIST_ENTRY ListEntry;
+            LONGLONG DueTime;
+            ULONG Period;
+            ULONG WindowLength;
+            BOOLEAN Set;
+        } Timer;
+        struct
+        {
+            HANDLE Handle;
+            LONGLONG Timeout;
+            LONGLONG Interval;
+            struct _RTLP_TP_WAITER *Waiter;
+            ULONG Index;
+            ULONG Cookie;
+        } Wait;
+        struct
+        {
+            LONG Lock;
+            LONG Skipped;
+        } Io;
+    } u;
+} RTLP_TP_OBJECT, *PRTLP_TP_OBJECT;
+
+typedef struct _RTLP_TP_WAITER
+{
+    LIST_ENTRY ListEntry;
+    HANDLE Event;
+    ULONG Count;
+    PRTLP_TP_OBJECT Waits[RTLP_TP_WAITS_PER_THREAD];
+} RTLP_TP_WAITER, *PRTLP_TP_WAITER;
+
+typedef struct _RTLP_TP_CALLBACK_INSTANCE
+{
+    PRTLP_TP_OBJECT Object;
+    BOOLEAN Associated;
+    PRTL_CRITICAL_SECTION CriticalSection;
+    HANDLE Mutex;
+    HANDLE Semaphore;
+    LONG SemaphoreReleaseCount;
+    HANDLE Event;
+    PVOID DllHandle;
+} RTLP_TP_CALLBACK_INSTANCE, *PRTLP_TP_CALLBACK_INSTANCE;
+
+typedef struct _RTLP_TP_IO_BINDING
+{
+    LIST_ENTRY ListEntry;
+    PVOID Callback;
+    PRTLP_TP_OBJECT Io;
+} RTLP_TP_IO_BINDING, *PRTLP_TP_IO_BINDING;
+
+/* GLOBALS ******************************************************************/
+
+static LONG RtlpTpInitialized = 0;
+static RTL_CRITICAL_SECTION RtlpTpLock;
+static RTL_CRITICAL_SECTION RtlpTpTimerLock;
+static RTL_CRITICAL_SECTION RtlpTpWaitLock;
+static PRTLP_TP_POOL RtlpTpDefaultPool;
+static LIST_ENTRY RtlpTpTimerList;
+static HANDLE RtlpTpTimerEvent;
+static LONGLONG RtlpTpTimerWakeTime = RTLP_TP_INFINITE;
+static LIST_ENTRY RtlpTpWaiterList;
+static ULONG RtlpTpWaitCookie;
+static LIST_ENTRY RtlpTpBindingList;
+HANDLE TimerThreadHandle = NULL;
+
+#define IsTpInitialized() (*((volatile LONG*)&RtlpTpInitialized) == 1)
+
+static VOID
+RtlpTpGrowPool(IN PRTLP_TP_POOL Pool);
+
+static VOID
+RtlpTpInsertTimer(IN PRTLP_TP_OBJECT Timer);
+
+static NTSTATUS
+RtlpTpPost(IN PRTLP_TP_OBJECT Object,
+           IN NTSTATUS Result);
+
+static VOID
+NTAPI
+RtlpTpApcRoutine(IN PVOID NormalContext,
+                 IN PVOID SystemArgument1,
+                 IN PVOID SystemArgument2);
+
+static VOID
+RtlpTpDispatch(IN PRTLP_TP_OBJECT Object,
+               IN PVOID ApcContext,
+               IN PIO_STATUS_BLOCK IoStatusBlock);
+
+/* PRIVATE FUNCTIONS ********************************************************/
+
+static NTSTATUS
+RtlpTpStartThread(IN PTHREAD_START_ROUTINE StartRoutine,
+                  IN PVOID Parameter,
+                  OUT PHANDLE ThreadHandle OPTIONAL)
+{
+    NTSTATUS Status;
+    HANDLE Handle;
+
+    Status = RtlpStartThreadFunc(StartRoutine, Parameter, &Handle);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    NtResumeThread(Handle, NULL);
+
+    if (ThreadHandle)
+        *ThreadHandle = Handle;
+    else
+        NtClose(Handle);
+
+    return STATUS_SUCCESS;
+}
+
+static BOOLEAN
+RtlpTpTakeCount(IN OUT PLONG Count)
+{
+    LONG Current, Old;
+
+    /* Decrement the count unless it is zero already */
+    Current = *(volatile LONG *)Count;
+    while (Current > 0)
+    {
+        Old = InterlockedCompareExchange(Count, Current - 1, Current);
+        if (Old == Current)
+            return TRUE;
+
+        Current = Old;
+    }
+
+    return FALSE;
+}
+
+static VOID
+RtlpTpAcquireIoLock(IN PRTLP_TP_OBJECT Io)
+{
+    while (InterlockedCompareExchange(&Io->u.Io.Lock, 1, 0) != 0)
+        YieldProcessor();
+}
+
+static VOID
+RtlpTpReleaseIoLock(IN PRTLP_TP_OBJECT Io)
+{
+    InterlockedExchange(&Io->u.Io.Lock, 0);
+}
+
+static NTSTATUS
+RtlpTpCreatePool(OUT PRTLP_TP_POOL *PoolReturn)
+{
+    PRTLP_TP_POOL Pool;
+    NTSTATUS Status;
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RTLP_TP_POOL));
+    if (Pool == NULL)
+        return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&Pool->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    /* Let the port run as many workers as there are processors */
+    Status = NtCreateIoCompletion(&Pool->CompletionPort,
+                                  IO_COMPLETION_ALL_ACCESS,
+                                  NULL,
+                                  NtCurrentPeb()->NumberOfProcessors);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlDeleteCriticalSection(&Pool->Lock);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    Pool->RefCount = 1;
+    Pool->MinThreads = 0;
+    Pool->MaxThreads = RTLP_TP_MAX_THREADS;
+
+    *PoolReturn = Pool;
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpDestroyPool(IN PRTLP_TP_POOL Pool)
+{
+    NtClose(Pool->CompletionPort);
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static VOID
+RtlpTpReleasePool(IN PRTLP_TP_POOL Pool)
+{
+    LONG Threads, i;
+
+    if (InterlockedDecrement(&Pool->RefCount) != 0)
+        return;
+
+    /* Nothing can post anymore, send every worker an exit packet */
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->Shutdown = TRUE;
+    Threads = Pool->Threads;
+    for (i = 0; i < Threads; i++)
+    {
+        if (!NT_SUCCESS(NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0)))
+            DPRINT1("Failed to post the exit packet of pool %p\n", Pool);
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* The last worker frees the pool, unless there is none */
+    if (Threads == 0)
+        RtlpTpDestroyPool(Pool);
+}
+
+static ULONG
+NTAPI
+RtlpTpWorkerThread(IN PVOID Parameter)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)Parameter;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Timeout;
+    PVOID Key, ApcContext;
+    BOOLEAN Exiting, Last;
+    NTSTATUS Status;
+
+    /* We were counted as idle by whoever started us */
+    for (;;)
+    {
+        Timeout.QuadPart = RTLP_TP_IDLE_TIMEOUT;
+        Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                      &Key,
+                                      &ApcContext,
+                                      &IoStatusBlock,
+                                      &Timeout);
+        if (Status == STATUS_TIMEOUT || !NT_SUCCESS(Status))
+        {
+            /* See if we're one worker too many */
+            RtlEnterCriticalSection(&Pool->Lock);
+            Exiting = !Pool->Shutdown &&
+                      (ULONG)Pool->Threads > Pool->MinThreads &&
+                      !RtlpIsIoPending(NULL);
+            if (Exiting)
+                InterlockedDecrement(&Pool->IdleThreads);
+            RtlLeaveCriticalSection(&Pool->Lock);
+
+            if (!Exiting)
+                continue;
+
+            /*
+             * Somebody who saw us idle may have posted just before we left,
+             * so have a last look at the port. Anything posted after this
+             * finds us gone from the idle count and starts a new worker.
+             */
+            Timeout.QuadPart = 0;
+            Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                          &Key,
+                                          &ApcContext,
+                                          &IoStatusBlock,
+                                          &Timeout);
+            if (Status == STATUS_TIMEOUT || !NT_SUCCESS(Status))
+            {
+                RtlEnterCriticalSection(&Pool->Lock);
+                if (!Pool->Shutdown)
+                {
+                    Pool->Threads--;
+                    RtlLeaveCriticalSection(&Pool->Lock);
+                    break;
+                }
+                RtlLeaveCriticalSection(&Pool->Lock);
+
+                /* The pool is going away and counted on us, wait for the exit packet */
+                InterlockedIncrement(&Pool->IdleThreads);
+                continue;
+            }
+        }
+        else
+        {
+            /* Make sure somebody is left to take over if this callback blocks */
+            if (InterlockedDecrement(&Pool->IdleThreads) == 0 && Key != NULL)
+                RtlpTpGrowPool(Pool);
+        }
+
+        if (Key == NULL)
+        {
+            /* Exit packet, the last worker out frees the pool */
+            RtlEnterCriticalSection(&Pool->Lock);
+            Last = (--Pool->Threads == 0);
+            RtlLeaveCriticalSection(&Pool->Lock);
+
+            if (Last)
+                RtlpTpDestroyPool(Pool);
+            break;
+        }
+
+        RtlpTpDispatch((PRTLP_TP_OBJECT)Key, ApcContext, &IoStatusBlock);
+
+        InterlockedIncrement(&Pool->IdleThreads);
+    }
+
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+static VOID
+RtlpTpGrowPool(IN PRTLP_TP_POOL Pool)
+{
+    NTSTATUS Status;
+
+    /* A worker is parked on the port already */
+    if (*(volatile LONG *)&Pool->IdleThreads > 0)
+        return;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (Pool->IdleThreads <= 0 &&
+        (ULONG)Pool->Threads < Pool->MaxThreads &&
+        !Pool->Shutdown)
+    {
+        /* Count the new worker as idle right away, so we don't start two */
+        Pool->Threads++;
+        InterlockedIncrement(&Pool->IdleThreads);
+
+        Status = RtlpTpStartThread(RtlpTpWorkerThread, Pool, NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to start a worker thread! Status: 0x%x\n", Status);
+            InterlockedDecrement(&Pool->IdleThreads);
+            Pool->Threads--;
+        }
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+static ULONG
+NTAPI
+RtlpTpTimerThread(IN PVOID Parameter)
+{
+    PRTLP_TP_OBJECT Timer;
+    PLIST_ENTRY Entry;
+    LARGE_INTEGER Now, Timeout;
+    LONGLONG WakeTime;
+
+    UNREFERENCED_PARAMETER(Parameter);
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&RtlpTpTimerLock);
+        NtQuerySystemTime(&Now);
+
+        /* Queue the callbacks of every timer that is due */
+        while (!IsListEmpty(&RtlpTpTimerList))
+        {
+            Timer = CONTAINING_RECORD(RtlpTpTimerList.Flink, RTLP_TP_OBJECT, u.Timer.ListEntry);
+            if (Timer->u.Timer.DueTime > Now.QuadPart)
+                break;
+
+            RemoveEntryList(&Timer->u.Timer.ListEntry);
+            if (Timer->u.Timer.Period != 0)
+            {
+                /* Don't fire a burst if we fell behind */
+                Timer->u.Timer.DueTime += Timer->u.Timer.Period * 10000LL;
+                if (Timer->u.Timer.DueTime <= Now.QuadPart)
+                    Timer->u.Timer.DueTime = Now.QuadPart + Timer->u.Timer.Period * 10000LL;
+                RtlpTpInsertTimer(Timer);
+            }
+            else
+            {
+                Timer->u.Timer.Set = FALSE;
+            }
+
+            RtlpTpPost(Timer, STATUS_SUCCESS);
+        }
+
+        /*
+         * Sleep until the window of some timer closes, which fires all the
+         * timers that are due by then in one go. The list is sorted by due
+         * time, so nothing after a timer due past the wake time can lower it.
+         */
+        WakeTime = RTLP_TP_INFINITE;
+        for (Entry = RtlpTpTimerList.Flink; Entry != &RtlpTpTimerList; Entry = Entry->Flink)
+        {
+            Timer = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.ListEntry);
+            if (Timer->u.Timer.DueTime >= WakeTime)
+                break;
+
+            WakeTime = min(WakeTime, Timer->u.Timer.DueTime + Timer->u.Timer.WindowLength * 10000LL);
+        }
+        RtlpTpTimerWakeTime = WakeTime;
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+
+        /* Alertable, persistent callbacks are delivered to us as APCs */
+        Timeout.QuadPart = WakeTime;
+        NtWaitForSingleObject(RtlpTpTimerEvent,
+                              TRUE,
+                              (WakeTime == RTLP_TP_INFINITE) ? NULL : &Timeout);
+    }
+
+    return 0;
+}
+
+static VOID
+RtlpTpInsertTimer(IN PRTLP_TP_OBJECT Timer)
+{
+    PRTLP_TP_OBJECT Current;
+    PLIST_ENTRY Entry;
+
+    /* New timers are usually due last, search from the tail */
+    for (Entry = RtlpTpTimerList.Blink; Entry != &RtlpTpTimerList; Entry = Entry->Blink)
+    {
+        Current = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, u.Timer.ListEntry);
+        if (Current->u.Timer.DueTime <= Timer->u.Timer.DueTime)
+            break;
+    }
+
+    InsertHeadList(Entry, &Timer->u.Timer.ListEntry);
+}
+
+static NTSTATUS
+RtlpTpInitializeGlobals(VOID)
+{
+    NTSTATUS Status;
+
+    InitializeListHead(&RtlpTpTimerList);
+    InitializeListHead(&RtlpTpWaiterList);
+    InitializeListHead(&RtlpTpBindingList);
+
+    Status = RtlInitializeCriticalSection(&RtlpTpLock);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlInitializeCriticalSection(&RtlpTpTimerLock);
+    if (!NT_SUCCESS(Status))
+        goto Cleanup1;
+
+    Status = RtlInitializeCriticalSection(&RtlpTpWaitLock);
+    if (!NT_SUCCESS(Status))
+        goto Cleanup2;
+
+    /* The default pool is never released */
+    Status = RtlpTpCreatePool(&RtlpTpDefaultPool);
+    if (NT_SUCCESS(Status))
+        return Status;
+
+    RtlDeleteCriticalSection(&RtlpTpWaitLock);
+Cleanup2:
+    RtlDeleteCriticalSection(&RtlpTpTimerLock);
+Cleanup1:
+    RtlDeleteCriticalSection(&RtlpTpLock);
+    return Status;
+}
+
+static NTSTATUS
+RtlpTpInitialize(VOID)
+{
+    NTSTATUS Status;
+    LONG InitStatus;
+    LARGE_INTEGER Timeout;
+
+    for (;;)
+    {
+        InitStatus = InterlockedCompareExchange(&RtlpTpInitialized, 2, 0);
+        if (InitStatus == 1)
+            return STATUS_SUCCESS;
+
+        if (InitStatus == 0)
+        {
+            /* We're the first thread to get here, allow a retry if we fail */
+            Status = RtlpTpInitializeGlobals();
+            InterlockedExchange(&RtlpTpInitialized, NT_SUCCESS(Status) ? 1 : 0);
+            return Status;
+        }
+
+        /* Another thread is initializing, give it some time */
+        Timeout.QuadPart = -10000LL; /* Wait for 1ms */
+        NtDelayExecution(FALSE, &Timeout);
+    }
+}
+
+NTSTATUS
+RtlpInitializeTimerThread(VOID)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    if (!IsTpInitialized())
+    {
+        Status = RtlpTpInitialize();
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    if (*(HANDLE volatile *)&TimerThreadHandle != NULL)
+        return STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&RtlpTpTimerLock);
+    if (TimerThreadHandle == NULL)
+    {
+        Status = NtCreateEvent(&RtlpTpTimerEvent,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               SynchronizationEvent,
+                               FALSE);
+        if (NT_SUCCESS(Status))
+        {
+            /* The timer thread is persistent, we keep its handle to queue APCs */
+            Status = RtlpTpStartThread(RtlpTpTimerThread, NULL, &TimerThreadHandle);
+            if (!NT_SUCCESS(Status))
+            {
+                NtClose(RtlpTpTimerEvent);
+                RtlpTpTimerEvent = NULL;
+            }
+        }
+    }
+    RtlLeaveCriticalSection(&RtlpTpTimerLock);
+
+    return Status;
+}
+
+static VOID
+RtlpTpWakeWaiters(IN PRTLP_TP_OBJECT Object)
+{
+    LONG Count;
+
+    /* Callers changed the counts with a full barrier, so this is safe to peek */
+    if (*(volatile LONG *)&Object->Waiters == 0)
+        return;
+
+    RtlEnterCriticalSection(&RtlpTpLock);
+    Count = Object->Waiters;
+    Object->Waiters = 0;
+    RtlLeaveCriticalSection(&RtlpTpLock);
+
+    /* Each waiter committed to waiting, so every release finds one */
+    while (Count--)
+        NtReleaseKeyedEvent(NULL, &Object->Waiters, FALSE, NULL);
+}
+
+static VOID
+RtlpTpCallbackDone(IN PRTLP_TP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->Running) == 0)
+        RtlpTpWakeWaiters(Object);
+}
+
+static VOID
+RtlpTpWaitForCallbacks(IN PRTLP_TP_OBJECT Object,
+                       IN BOOLEAN CancelPending)
+{
+    BOOLEAN Done;
+
+    for (;;)
+    {
+        RtlEnterCriticalSection(&RtlpTpLock);
+        InterlockedIncrement(&Object->Waiters);
+        Done = (*(volatile LONG *)&Object->Running == 0) &&
+               (CancelPending || *(volatile LONG *)&Object->Pending == 0);
+        if (Done)
+            Object->Waiters--;
+        RtlLeaveCriticalSection(&RtlpTpLock);
+
+        if (Done)
+            break;
+
+        NtWaitForKeyedEvent(NULL, &Object->Waiters, FALSE, NULL);
+    }
+}
+
+static VOID
+RtlpTpCancelPending(IN PRTLP_TP_OBJECT Object)
+{
+    if (Object->Type == RtlpTpIoObject)
+    {
+        /* The completions will still arrive, they just won't be reported */
+        RtlpTpAcquireIoLock(Object);
+        Object->u.Io.Skipped += Object->Pending;
+        InterlockedExchange(&Object->Pending, 0);
+        RtlpTpReleaseIoLock(Object);
+    }
+    else
+    {
+        /* The packets stay in the port and are dropped when they come out */
+        InterlockedExchange(&Object->Pending, 0);
+    }
+
+    RtlpTpWakeWaiters(Object);
+}
+
+static VOID
+RtlpTpCompleteInstance(IN PRTLP_TP_CALLBACK_INSTANCE Instance)
+{
+    if (Instance->CriticalSection)
+        RtlLeaveCriticalSection(Instance->CriticalSection);
+
+    if (Instance->Mutex)
+        NtReleaseMutant(Instance->Mutex, NULL);
+
+    if (Instance->Semaphore)
+        NtReleaseSemaphore(Instance->Semaphore, Instance->SemaphoreReleaseCount, NULL);
+
+    if (Instance->Event)
+        NtSetEvent(Instance->Event, NULL);
+
+    if (Instance->DllHandle)
+        LdrUnloadDll(Instance->DllHandle);
+}
+
+static VOID
+RtlpTpDestroyObject(IN PRTLP_TP_OBJECT Object)
+{
+    RTLP_TP_CALLBACK_INSTANCE Instance;
+
+    if (Object->FinalizationCallback)
+    {
+        RtlZeroMemory(&Instance, sizeof(Instance));
+        Instance.Object = Object;
+
+        Object->FinalizationCallback((PTP_CALLBACK_INSTANCE)&Instance, Object->Context);
+        RtlpTpCompleteInstance(&Instance);
+    }
+
+    if (Object->RaceDll)
+        LdrUnloadDll(Object->RaceDll);
+
+    RtlpTpReleasePool(Object->Pool);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+}
+
+static VOID
+RtlpTpRelease(IN PRTLP_TP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->RefCount) == 0)
+        RtlpTpDestroyObject(Object);
+}
+
+static BOOLEAN
+RtlpTpRemoveFromCleanupGroup(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup = Object->CleanupGroup;
+    BOOLEAN Removed = FALSE;
+
+    if (CleanupGroup == NULL)
+        return FALSE;
+
+    /* TpReleaseCleanupGroupMembers may have taken the object already */
+    RtlEnterCriticalSection(&CleanupGroup->Lock);
+    if (Object->CleanupGroup != NULL)
+    {
+        RemoveEntryList(&Object->CleanupGroupEntry);
+        Object->CleanupGroup = NULL;
+        Removed = TRUE;
+    }
+    RtlLeaveCriticalSection(&CleanupGroup->Lock);
+
+    return Removed;
+}
+
+static NTSTATUS
+RtlpTpPost(IN PRTLP_TP_OBJECT Object,
+           IN NTSTATUS Result)
+{
+    PRTLP_TP_POOL Pool = Object->Pool;
+    BOOLEAN Persistent = !!(Object->Flags & RTLP_TP_PERSISTENT);
+    NTSTATUS Status;
+
+    /* Every packet holds a reference on its object */
+    InterlockedIncrement(&Object->RefCount);
+    InterlockedIncrement(&Object->Pending);
+
+    if (Persistent)
+    {
+        Status = NtQueueApcThread(TimerThreadHandle,
+                                  RtlpTpApcRoutine,
+                                  Object,
+                                  (PVOID)(ULONG_PTR)Result,
+                                  NULL);
+    }
+    else
+    {
+        Status = NtSetIoCompletion(Pool->CompletionPort,
+                                   Object,
+                                   NULL,
+                                   Result,
+                                   0);
+    }
+
+    /* The packet can be gone already, and the object with it unless the caller holds it */
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to queue a callback of %p! Status: 0x%x\n", Object, Status);
+        RtlpTpTakeCount(&Object->Pending);
+        RtlpTpWakeWaiters(Object);
+        RtlpTpRelease(Object);
+        return Status;
+    }
+
+    if (!Persistent)
+        RtlpTpGrowPool(Pool);
+
+    return STATUS_SUCCESS;
+}
+
+static VOID
+NTAPI
+RtlpTpApcRoutine(IN PVOID NormalContext,
+                 IN PVOID SystemArgument1,
+                 IN PVOID SystemArgument2)
+{
+    IO_STATUS_BLOCK IoStatusBlock;
+
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    IoStatusBlock.Status = (NTSTATUS)(ULONG_PTR)SystemArgument1;
+    IoStatusBlock.Information = 0;
+
+    RtlpTpDispatch((PRTLP_TP_OBJECT)NormalContext, NULL, &IoStatusBlock);
+}
+
+static VOID
+RtlpTpDisarmWait(IN PRTLP_TP_OBJECT Wait)
+{
+    PRTLP_TP_WAITER Waiter = Wait->u.Wait.Waiter;
+    PRTLP_TP_OBJECT Last;
+
+    /* The wait lock is held */
+    if (Waiter == NULL)
+        return;
+
+    Last = Waiter->Waits[--Waiter->Count];
+    Waiter->Waits[Wait->u.Wait.Index] = Last;
+    Last->u.Wait.Index = Wait->u.Wait.Index;
+
+    Wait->u.Wait.Waiter = NULL;
+}
+
+static ULONG
+NTAPI
+RtlpTpWaiterThread(IN PVOID Parameter)
+{
+    PRTLP_TP_WAITER Waiter = (PRTLP_TP_WAITER)Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    PRTLP_TP_OBJECT Objects[MAXIMUM_WAIT_OBJECTS];
+    ULONG Cookies[MAXIMUM_WAIT_OBJECTS];
+    PRTLP_TP_OBJECT Fired[MAXIMUM_WAIT_OBJECTS];
+    NTSTATUS Results[MAXIMUM_WAIT_OBJECTS];
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Timeout, Now, Zero;
+    PRTLP_TP_OBJECT Wait;
+    ULONG Count, FiredCount, Index, i;
+    NTSTATUS Status, Result;
+
+    for (;;)
+    {
+        /* Take a snapshot of the waits, the cookies tell if they changed meanwhile */
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+        Handles[0] = Waiter->Event;
+        Timeout.QuadPart = RTLP_TP_INFINITE;
+        for (i = 0; i < Waiter->Count; i++)
+        {
+            Wait = Waiter->Waits[i];
+            Objects[i + 1] = Wait;
+            Handles[i + 1] = Wait->u.Wait.Handle;
+            Cookies[i + 1] = Wait->u.Wait.Cookie;
+            Timeout.QuadPart = min(Timeout.QuadPart, Wait->u.Wait.Timeout);
+        }
+        Count = Waiter->Count + 1;
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+
+        if (Count == 1)
+        {
+            /* Nothing to wait for, don't stick around forever */
+            Timeout.QuadPart = RTLP_TP_IDLE_TIMEOUT;
+        }
+
+        Status = NtWaitForMultipleObjects(Count,
+                                          Handles,
+                                          WaitAny,
+                                          FALSE,
+                                          (Timeout.QuadPart == RTLP_TP_INFINITE) ? NULL : &Timeout);
+
+        FiredCount = 0;
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+        if (Count == 1 && Status == STATUS_TIMEOUT && Waiter->Count == 0)
+        {
+            RemoveEntryList(&Waiter->ListEntry);
+            RtlLeaveCriticalSection(&RtlpTpWaitLock);
+            break;
+        }
+
+        Index = 0;
+        Result = STATUS_WAIT_0;
+        if (Status > STATUS_WAIT_0 && Status < STATUS_WAIT_0 + Count)
+        {
+            Index = Status - STATUS_WAIT_0;
+        }
+        else if (Status > STATUS_ABANDONED_WAIT_0 && Status < STATUS_ABANDONED_WAIT_0 + Count)
+        {
+            Index = Status - STATUS_ABANDONED_WAIT_0;
+            Result = STATUS_ABANDONED_WAIT_0;
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            /* Some handle went bad, find and drop it instead of spinning on it */
+            Zero.QuadPart = 0;
+            for (i = 0; i < Waiter->Count;)
+            {
+                Wait = Waiter->Waits[i];
+                if (!NT_SUCCESS(NtWaitForSingleObject(Wait->u.Wait.Handle, FALSE, &Zero)))
+                {
+                    DPRINT1("Dropping the wait %p on bad handle %p\n", Wait, Wait->u.Wait.Handle);
+                    RtlpTpDisarmWait(Wait);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+
+        if (Index != 0)
+        {
+            /* Make sure the object still waits on what we waited for */
+            Wait = Objects[Index];
+            for (i = 0; i < Waiter->Count; i++)
+            {
+                if (Waiter->Waits[i] == Wait && Wait->u.Wait.Cookie == Cookies[Index])
+                {
+                    RtlpTpDisarmWait(Wait);
+                    InterlockedIncrement(&Wait->RefCount);
+                    Fired[FiredCount] = Wait;
+                    Results[FiredCount++] = Result;
+                    break;
+                }
+            }
+        }
+
+        /* Time passed for everybody, expire the timeouts */
+        NtQuerySystemTime(&Now);
+        for (i = 0; i < Waiter->Count;)
+        {
+            Wait = Waiter->Waits[i];
+            if (Wait->u.Wait.Timeout <= Now.QuadPart)
+            {
+                RtlpTpDisarmWait(Wait);
+                InterlockedIncrement(&Wait->RefCount);
+                Fired[FiredCount] = Wait;
+                Results[FiredCount++] = STATUS_TIMEOUT;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+
+        for (i = 0; i < FiredCount; i++)
+        {
+            if (Fired[i]->Flags & RTLP_TP_EXECUTE_INLINE)
+            {
+                /* Run it right here, this consumes our reference */
+                InterlockedIncrement(&Fired[i]->Pending);
+                IoStatusBlock.Status = Results[i];
+                IoStatusBlock.Information = 0;
+                RtlpTpDispatch(Fired[i], NULL, &IoStatusBlock);
+            }
+            else
+            {
+                RtlpTpPost(Fired[i], Results[i]);
+                RtlpTpRelease(Fired[i]);
+            }
+        }
+    }
+
+    NtClose(Waiter->Event);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+
+    RtlpExitThreadFunc(STATUS_SUCCESS);
+    return 0;
+}
+
+static NTSTATUS
+RtlpTpArmWait(IN PRTLP_TP_OBJECT Wait)
+{
+    PRTLP_TP_WAITER Waiter = NULL;
+    PLIST_ENTRY Entry;
+    NTSTATUS Status;
+
+    /* The wait lock is held, find a waiter thread with a free slot */
+    for (Entry = RtlpTpWaiterList.Flink; Entry != &RtlpTpWaiterList; Entry = Entry->Flink)
+    {
+        Waiter = CONTAINING_RECORD(Entry, RTLP_TP_WAITER, ListEntry);
+        if (Waiter->Count < RTLP_TP_WAITS_PER_THREAD)
+            break;
+    }
+
+    if (Entry == &RtlpTpWaiterList)
+    {
+        Waiter = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(RTLP_TP_WAITER));
+        if (Waiter == NULL)
+            return STATUS_NO_MEMORY;
+
+        Waiter->Count = 0;
+        Status = NtCreateEvent(&Waiter->Event,
+                               EVENT_ALL_ACCESS,
+                               NULL,
+                               SynchronizationEvent,
+                               FALSE);
+        if (!NT_SUCCESS(Status))
+        {
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+            return Status;
+        }
+
+        Status = RtlpTpStartThread(RtlpTpWaiterThread, Waiter, NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            NtClose(Waiter->Event);
+            RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+            return Status;
+        }
+
+        /* It can't look at the list before we leave the lock */
+        InsertHeadList(&RtlpTpWaiterList, &Waiter->ListEntry);
+    }
+
+    Wait->u.Wait.Waiter = Waiter;
+    Wait->u.Wait.Index = Waiter->Count;
+    Wait->u.Wait.Cookie = ++RtlpTpWaitCookie;
+    Waiter->Waits[Waiter->Count++] = Wait;
+
+    /* Have it pick up the new handle */
+    NtSetEvent(Waiter->Event, NULL);
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpRearmWait(IN PRTLP_TP_OBJECT Wait)
+{
+    LARGE_INTEGER Now;
+
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+    if (!(Wait->Flags & RTLP_TP_RELEASED) &&
+        Wait->u.Wait.Handle != NULL &&
+        Wait->u.Wait.Waiter == NULL)
+    {
+        if (Wait->u.Wait.Interval == RTLP_TP_INFINITE)
+        {
+            Wait->u.Wait.Timeout = RTLP_TP_INFINITE;
+        }
+        else
+        {
+            NtQuerySystemTime(&Now);
+            Wait->u.Wait.Timeout = Now.QuadPart + Wait->u.Wait.Interval;
+        }
+
+        if (!NT_SUCCESS(RtlpTpArmWait(Wait)))
+            DPRINT1("Failed to rearm the wait %p\n", Wait);
+    }
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+}
+
+static VOID
+RtlpTpExecute(IN PRTLP_TP_OBJECT Object,
+              IN PVOID ApcContext,
+              IN PIO_STATUS_BLOCK IoStatusBlock)
+{
+    RTLP_TP_CALLBACK_INSTANCE Instance;
+    PTP_CALLBACK_INSTANCE CallbackInstance = (PTP_CALLBACK_INSTANCE)&Instance;
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    Instance.Associated = TRUE;
+
+    /* Keep a worker ready for the rest of the queue */
+    if (Object->Flags & RTLP_TP_LONG_FUNCTION)
+        RtlpTpGrowPool(Object->Pool);
+
+    switch (Object->Type)
+    {
+        case RtlpTpSimpleObject:
+            ((PTP_SIMPLE_CALLBACK)Object->Callback)(CallbackInstance,
+                                                    Object->Context);
+            break;
+
+        case RtlpTpWorkObject:
+            ((PTP_WORK_CALLBACK)Object->Callback)(CallbackInstance,
+                                                  Object->Context,
+                                                  (PTP_WORK)Object);
+            break;
+
+        case RtlpTpTimerObject:
+            ((PTP_TIMER_CALLBACK)Object->Callback)(CallbackInstance,
+                                                   Object->Context,
+                                                   (PTP_TIMER)Object);
+            break;
+
+        case RtlpTpWaitObject:
+            ((PTP_WAIT_CALLBACK)Object->Callback)(CallbackInstance,
+                                                  Object->Context,
+                                                  (PTP_WAIT)Object,
+                                                  (TP_WAIT_RESULT)IoStatusBlock->Status);
+            break;
+
+        case RtlpTpIoObject:
+            if (Object->Flags & RTLP_TP_UNACCOUNTED)
+            {
+                /* Bound with RtlSetIoCompletionCallback */
+                ((PRTLP_OVERLAPPED_COMPLETION_ROUTINE)Object->Callback)(RtlNtStatusToDosError(IoStatusBlock->Status),
+                                                                        (ULONG)IoStatusBlock->Information,
+                                                                        ApcContext);
+            }
+            else
+            {
+                ((PTP_IO_CALLBACK)Object->Callback)(CallbackInstance,
+                                                    Object->Context,
+                                                    ApcContext,
+                                                    IoStatusBlock,
+                                                    (PTP_IO)Object);
+            }
+            break;
+    }
+
+    RtlpTpCompleteInstance(&Instance);
+
+    /* Registered waits come back for more, unless they were cancelled */
+    if (Object->Flags & RTLP_TP_REARM_WAIT)
+        RtlpTpRearmWait(Object);
+
+    if (Instance.Associated)
+        RtlpTpCallbackDone(Object);
+}
+
+static VOID
+RtlpTpDispatch(IN PRTLP_TP_OBJECT Object,
+               IN PVOID ApcContext,
+               IN PIO_STATUS_BLOCK IoStatusBlock)
+{
+    BOOLEAN Run, Release = TRUE;
+
+    /* Count it as running before it stops being pending, for the waiters */
+    InterlockedIncrement(&Object->Running);
+
+    if (Object->Type != RtlpTpIoObject)
+    {
+        /* A cancelled packet finds no pending count left */
+        Run = RtlpTpTakeCount(&Object->Pending);
+    }
+    else if (Object->Flags & RTLP_TP_UNACCOUNTED)
+    {
+        Run = TRUE;
+        Release = FALSE;
+    }
+    else
+    {
+        RtlpTpAcquireIoLock(Object);
+        if (Object->Pending > 0)
+        {
+            InterlockedDecrement(&Object->Pending);
+            Run = TRUE;
+        }
+        else if (Object->u.Io.Skipped > 0)
+        {
+            Object->u.Io.Skipped--;
+            Run = FALSE;
+        }
+        else
+        {
+            /* Nobody called TpStartAsyncIoOperation, there's no reference to drop */
+            DPRINT1("Unexpected completion for I/O object %p\n", Object);
+            Run = TRUE;
+            Release = FALSE;
+        }
+        RtlpTpReleaseIoLock(Object);
+    }
+
+    if (Run)
+        RtlpTpExecute(Object, ApcContext, IoStatusBlock);
+    else
+        RtlpTpCallbackDone(Object);
+
+    /* Simple callbacks drop the reference their cleanup group held */
+    if (Object->Type == RtlpTpSimpleObject && RtlpTpRemoveFromCleanupGroup(Object))
+        RtlpTpRelease(Object);
+
+    if (Release)
+        RtlpTpRelease(Object);
+}
+
+static NTSTATUS
+RtlpTpAllocObject(OUT PRTLP_TP_OBJECT *ObjectReturn,
+                  IN RTLP_TP_OBJECT_TYPE Type,
+                  IN PVOID Callback,
+                  IN PVOID Context,
+                  IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup = NULL;
+    NTSTATUS Status;
+
+    if (Callback == NULL)
+        return STATUS_INVALID_PARAMETER;
+
+    if (CallbackEnviron && CallbackEnviron->Version != 1 && CallbackEnviron->Version != 3)
+        return STATUS_INVALID_PARAMETER;
+
+    if (!IsTpInitialized())
+    {
+        Status = RtlpTpInitialize();
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    if (CallbackEnviron && CallbackEnviron->u.s.Persistent)
+    {
+        Status = RtlpInitializeTimerThread();
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RTLP_TP_OBJECT));
+    if (Object == NULL)
+        return STATUS_NO_MEMORY;
+
+    /* The caller's reference, and the cleanup group's for simple callbacks */
+    Object->Type = Type;
+    Object->RefCount = 1;
+    if (Type == RtlpTpSimpleObject && CallbackEnviron && CallbackEnviron->CleanupGroup)
+        Object->RefCount++;
+    Object->Callback = Callback;
+    Object->Context = Context;
+    Object->Pool = RtlpTpDefaultPool;
+
+    if (CallbackEnviron)
+    {
+        if (CallbackEnviron->Pool)
+            Object->Pool = (PRTLP_TP_POOL)CallbackEnviron->Pool;
+
+        if (CallbackEnviron->u.s.LongFunction)
+            Object->Flags |= RTLP_TP_LONG_FUNCTION;
+
+        if (CallbackEnviron->u.s.Persistent)
+            Object->Flags |= RTLP_TP_PERSISTENT;
+
+        CleanupGroup = (PRTLP_TP_CLEANUP_GROUP)CallbackEnviron->CleanupGroup;
+        Object->CleanupGroupCancelCallback = CallbackEnviron->CleanupGroupCancelCallback;
+        Object->FinalizationCallback = CallbackEnviron->FinalizationCallback;
+
+        /* Keep the DLL loaded for as long as its callbacks can run */
+        if (CallbackEnviron->RaceDll)
+        {
+            Status = LdrAddRefDll(0, CallbackEnviron->RaceDll);
+            if (!NT_SUCCESS(Status))
+            {
+                RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+                return Status;
+            }
+
+            Object->RaceDll = CallbackEnviron->RaceDll;
+        }
+    }
+
+    InterlockedIncrement(&Object->Pool->RefCount);
+
+    if (Type == RtlpTpTimerObject)
+        InitializeListHead(&Object->u.Timer.ListEntry);
+
+    if (CleanupGroup)
+    {
+        RtlEnterCriticalSection(&CleanupGroup->Lock);
+        InsertTailList(&CleanupGroup->MemberList, &Object->CleanupGroupEntry);
+        Object->CleanupGroup = CleanupGroup;
+        RtlLeaveCriticalSection(&CleanupGroup->Lock);
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static VOID
+RtlpTpShutdownObject(IN PRTLP_TP_OBJECT Object)
+{
+    PRTLP_TP_WAITER Waiter;
+
+    /* Stop anything that could queue more callbacks */
+    if (Object->Type == RtlpTpTimerObject)
+    {
+        RtlEnterCriticalSection(&RtlpTpTimerLock);
+        if (Object->u.Timer.Set)
+        {
+            RemoveEntryList(&Object->u.Timer.ListEntry);
+            Object->u.Timer.Set = FALSE;
+        }
+        Object->Flags |= RTLP_TP_RELEASED;
+        RtlLeaveCriticalSection(&RtlpTpTimerLock);
+    }
+    else if (Object->Type == RtlpTpWaitObject)
+    {
+        RtlEnterCriticalSection(&RtlpTpWaitLock);
+        Waiter = Object->u.Wait.Waiter;
+        RtlpTpDisarmWait(Object);
+        Object->u.Wait.Handle = NULL;
+        Object->Flags |= RTLP_TP_RELEASED;
+        if (Waiter)
+            NtSetEvent(Waiter->Event, NULL);
+        RtlLeaveCriticalSection(&RtlpTpWaitLock);
+    }
+}
+
+static VOID
+RtlpTpReleaseObject(IN PRTLP_TP_OBJECT Object)
+{
+    RtlpTpRemoveFromCleanupGroup(Object);
+    RtlpTpShutdownObject(Object);
+    RtlpTpRelease(Object);
+}
+
+static LONGLONG
+RtlpTpAbsoluteTime(IN PLARGE_INTEGER Time)
+{
+    LARGE_INTEGER Now;
+
+    if (Time->QuadPart >= 0)
+        return Time->QuadPart;
+
+    NtQuerySystemTime(&Now);
+    return Now.QuadPart - Time->QuadPart;
+}
+
+VOID
+RtlpTpSetFlags(IN PVOID Object,
+               IN ULONG Flags)
+{
+    ((PRTLP_TP_OBJECT)Object)->Flags |= Flags & (RTLP_TP_EXECUTE_INLINE | RTLP_TP_REARM_WAIT);
+}
+
+BOOLEAN
+RtlpTpHasCallbacks(IN PVOID ObjectPointer)
+{
+    PRTLP_TP_OBJECT Object = (PRTLP_TP_OBJECT)ObjectPointer;
+
+    return (*(volatile LONG *)&Object->Running != 0) ||
+           (*(volatile LONG *)&Object->Pending != 0);
+}
+
+NTSTATUS
+RtlpTpSetWait(IN PVOID WaitHandle,
+              IN HANDLE Handle OPTIONAL,
+              IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    PRTLP_TP_OBJECT Wait = (PRTLP_TP_OBJECT)WaitHandle;
+    PRTLP_TP_WAITER Waiter;
+    LARGE_INTEGER Now;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&RtlpTpWaitLock);
+
+    /* Let the old waiter thread drop the handle */
+    Waiter = Wait->u.Wait.Waiter;
+    if (Waiter)
+    {
+        RtlpTpDisarmWait(Wait);
+        NtSetEvent(Waiter->Event, NULL);
+    }
+
+    Wait->u.Wait.Handle = NULL;
+    if (Handle != NULL && !(Wait->Flags & RTLP_TP_RELEASED))
+    {
+        Wait->u.Wait.Handle = Handle;
+
+        if (Timeout == NULL)
+        {
+            Wait->u.Wait.Timeout = RTLP_TP_INFINITE;
+            Wait->u.Wait.Interval = RTLP_TP_INFINITE;
+        }
+        else
+        {
+            NtQuerySystemTime(&Now);
+            Wait->u.Wait.Timeout = RtlpTpAbsoluteTime(Timeout);
+            Wait->u.Wait.Interval = max(Wait->u.Wait.Timeout - Now.QuadPart, 0);
+        }
+
+        Status = RtlpTpArmWait(Wait);
+        if (!NT_SUCCESS(Status))
+            Wait->u.Wait.Handle = NULL;
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpWaitLock);
+    return Status;
+}
+
+/* FUNCTIONS ****************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocPool(OUT PTP_POOL *PoolReturn,
+            IN PVOID Reserved)
+{
+    PRTLP_TP_POOL Pool;
+    NTSTATUS Status;
+
+    UNREFERENCED_PARAMETER(Reserved);
+
+    if (!IsTpInitialized())
+    {
+        Status = RtlpTpInitialize();
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    Status = RtlpTpCreatePool(&Pool);
+    if (NT_SUCCESS(Status))
+        *PoolReturn = (PTP_POOL)Pool;
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleasePool(IN OUT PTP_POOL Pool)
+{
+    /* Objects keep it around until they are gone */
+    RtlpTpReleasePool((PRTLP_TP_POOL)Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetPoolMaxThreads(IN OUT PTP_POOL PoolHandle,
+                    IN ULONG MaxThreads)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)PoolHandle;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MaxThreads = max(MaxThreads, 1);
+    Pool->MinThreads = min(Pool->MinThreads, Pool->MaxThreads);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSetPoolMinThreads(IN OUT PTP_POOL PoolHandle,
+                    IN ULONG MinThreads)
+{
+    PRTLP_TP_POOL Pool = (PRTLP_TP_POOL)PoolHandle;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MinThreads = MinThreads;
+    Pool->MaxThreads = max(Pool->MaxThreads, MinThreads);
+
+    while ((ULONG)Pool->Threads < Pool->MinThreads)
+    {
+        Pool->Threads++;
+        InterlockedIncrement(&Pool->IdleThreads);
+
+        Status = RtlpTpStartThread(RtlpTpWorkerThread, Pool, NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            InterlockedDecrement(&Pool->IdleThreads);
+            Pool->Threads--;
+            break;
+        }
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    CleanupGroup = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(RTLP_TP_CLEANUP_GROUP));
+    if (CleanupGroup == NULL)
+        return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&CleanupGroup->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+        return Status;
+    }
+
+    InitializeListHead(&CleanupGroup->MemberList);
+
+    *CleanupGroupReturn = (PTP_CLEANUP_GROUP)CleanupGroup;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroup(IN OUT PTP_CLEANUP_GROUP CleanupGroupHandle)
+{
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup = (PRTLP_TP_CLEANUP_GROUP)CleanupGroupHandle;
+
+    ASSERT(IsListEmpty(&CleanupGroup->MemberList));
+
+    RtlDeleteCriticalSection(&CleanupGroup->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(IN OUT PTP_CLEANUP_GROUP CleanupGroupHandle,
+                             IN BOOLEAN CancelPendingCallbacks,
+                             IN OUT PVOID CleanupParameter OPTIONAL)
+{
+    PRTLP_TP_CLEANUP_GROUP CleanupGroup = (PRTLP_TP_CLEANUP_GROUP)CleanupGroupHandle;
+    PRTLP_TP_OBJECT Object;
+    PLIST_ENTRY Entry;
+    LIST_ENTRY Members;
+
+    /* Take all the members, they can't remove themselves anymore */
+    InitializeListHead(&Members);
+    RtlEnterCriticalSection(&CleanupGroup->Lock);
+    while (!IsListEmpty(&CleanupGroup->MemberList))
+    {
+        Entry = RemoveHeadList(&CleanupGroup->MemberList);
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, CleanupGroupEntry);
+        Object->CleanupGroup = NULL;
+        InsertTailList(&Members, Entry);
+    }
+    RtlLeaveCriticalSection(&CleanupGroup->Lock);
+
+    /* Stop them all first, so the workers don't start what we'd cancel next */
+    for (Entry = Members.Flink; Entry != &Members; Entry = Entry->Flink)
+    {
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, CleanupGroupEntry);
+
+        if (CancelPendingCallbacks)
+            RtlpTpCancelPending(Object);
+
+        RtlpTpShutdownObject(Object);
+    }
+
+    while (!IsListEmpty(&Members))
+    {
+        Entry = RemoveHeadList(&Members);
+        Object = CONTAINING_RECORD(Entry, RTLP_TP_OBJECT, CleanupGroupEntry);
+
+        RtlpTpWaitForCallbacks(Object, CancelPendingCallbacks);
+
+        if (CancelPendingCallbacks && Object->CleanupGroupCancelCallback)
+            Object->CleanupGroupCancelCallback(Object->Context, CleanupParameter);
+
+        /* Release it on behalf of its owner */
+        RtlpTpRelease(Object);
+    }
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback,
+                IN OUT PVOID Context OPTIONAL,
+                IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PRTLP_TP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(&Object, RtlpTpSimpleObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlpTpPost(Object, STATUS_SUCCESS);
+
+    /* Otherwise the cleanup group keeps its reference until the callback ran */
+    if (!NT_SUCCESS(Status) && RtlpTpRemoveFromCleanupGroup(Object))
+        RtlpTpRelease(Object);
+
+    RtlpTpRelease(Object);
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWork(OUT PTP_WORK *WorkReturn,
+            IN PTP_WORK_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return RtlpTpAllocObject((PRTLP_TP_OBJECT *)WorkReturn,
+                             RtlpTpWorkObject,
+                             Callback,
+                             Context,
+                             CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpPostWork(IN OUT PTP_WORK Work)
+{
+    RtlpTpPost((PRTLP_TP_OBJECT)Work, STATUS_SUCCESS);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWork(IN OUT PTP_WORK Work)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Work);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWork(IN OUT PTP_WORK Work,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks)
+        RtlpTpCancelPending((PRTLP_TP_OBJECT)Work);
+
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Work, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocTimer(OUT PTP_TIMER *TimerReturn,
+             IN PTP_TIMER_CALLBACK Callback,
+             IN OUT PVOID Context OPTIONAL,
+             IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    NTSTATUS Status;
+
+    /* Timers need the timer thread */
+    Status = RtlpInitializeTimerThread();
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    return RtlpTpAllocObject((PRTLP_TP_OBJECT *)TimerReturn,
+                             RtlpTpTimerObject,
+                             Callback,
+                             Context,
+                             CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetTimer(IN OUT PTP_TIMER TimerHandle,
+           IN PLARGE_INTEGER DueTime OPTIONAL,
+           IN ULONG Period,
+           IN ULONG WindowLength OPTIONAL)
+{
+    PRTLP_TP_OBJECT Timer = (PRTLP_TP_OBJECT)TimerHandle;
+
+    RtlEnterCriticalSection(&RtlpTpTimerLock);
+
+    if (Timer->u.Timer.Set)
+    {
+        RemoveEntryList(&Timer->u.Timer.ListEntry);
+        Timer->u.Timer.Set = FALSE;
+    }
+
+    /* No due time only cancels it, queued callbacks still run */
+    if (DueTime != NULL && !(Timer->Flags & RTLP_TP_RELEASED))
+    {
+        Timer->u.Timer.DueTime = RtlpTpAbsoluteTime(DueTime);
+        Timer->u.Timer.Period = Period;
+        Timer->u.Timer.WindowLength = WindowLength;
+        Timer->u.Timer.Set = TRUE;
+        RtlpTpInsertTimer(Timer);
+
+        /*
+         * Wake the timer thread if this window closes before it would wake
+         * up. That isn't only for a new first timer, a later one may have
+         * a shorter window.
+         */
+        if (Timer->u.Timer.DueTime + WindowLength * 10000LL < RtlpTpTimerWakeTime)
+        {
+            RtlpTpTimerWakeTime = Timer->u.Timer.DueTime + WindowLength * 10000LL;
+            NtSetEvent(RtlpTpTimerEvent, NULL);
+        }
+    }
+
+    RtlLeaveCriticalSection(&RtlpTpTimerLock);
+}
+
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+TpIsTimerSet(IN PTP_TIMER Timer)
+{
+    return *(volatile BOOLEAN *)&((PRTLP_TP_OBJECT)Timer)->u.Timer.Set;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseTimer(IN OUT PTP_TIMER Timer)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Timer);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForTimer(IN OUT PTP_TIMER Timer,
+               IN BOOLEAN CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks)
+        RtlpTpCancelPending((PRTLP_TP_OBJECT)Timer);
+
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Timer, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWait(OUT PTP_WAIT *WaitReturn,
+            IN PTP_WAIT_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return RtlpTpAllocObject((PRTLP_TP_OBJECT *)WaitReturn,
+                             RtlpTpWaitObject,
+                             Callback,
+                             Context,
+                             CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetWait(IN OUT PTP_WAIT WaitHandle,
+          IN HANDLE Handle OPTIONAL,
+          IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    NTSTATUS Status;
+
+    Status = RtlpTpSetWait(WaitHandle, Handle, Timeout);
+    if (!NT_SUCCESS(Status))
+        DPRINT1("Failed to set the wait %p! Status: 0x%x\n", WaitHandle, Status);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWait(IN OUT PTP_WAIT Wait)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Wait);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWait(IN OUT PTP_WAIT Wait,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks)
+        RtlpTpCancelPending((PRTLP_TP_OBJECT)Wait);
+
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Wait, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocIoCompletion(OUT PTP_IO *IoReturn,
+                    IN HANDLE File,
+                    IN PTP_IO_CALLBACK Callback,
+                    IN OUT PVOID Context OPTIONAL,
+                    IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    FILE_COMPLETION_INFORMATION FileCompletionInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PRTLP_TP_OBJECT Io;
+    NTSTATUS Status;
+
+    Status = RtlpTpAllocObject(&Io, RtlpTpIoObject, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* Completions come straight to the pool's port, keyed by the object */
+    FileCompletionInfo.Port = Io->Pool->CompletionPort;
+    FileCompletionInfo.Key = Io;
+    Status = NtSetInformationFile(File,
+                                  &IoStatusBlock,
+                                  &FileCompletionInfo,
+                                  sizeof(FileCompletionInfo),
+                                  FileCompletionInformation);
+    if (!NT_SUCCESS(Status))
+    {
+        /* The caller never saw the object, it gets no finalization either */
+        Io->FinalizationCallback = NULL;
+        RtlpTpReleaseObject(Io);
+        return Status;
+    }
+
+    *IoReturn = (PTP_IO)Io;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpStartAsyncIoOperation(IN OUT PTP_IO IoHandle)
+{
+    PRTLP_TP_OBJECT Io = (PRTLP_TP_OBJECT)IoHandle;
+
+    /* The completion will consume this reference */
+    InterlockedIncrement(&Io->RefCount);
+
+    RtlpTpAcquireIoLock(Io);
+    InterlockedIncrement(&Io->Pending);
+    RtlpTpReleaseIoLock(Io);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCancelAsyncIoOperation(IN OUT PTP_IO IoHandle)
+{
+    PRTLP_TP_OBJECT Io = (PRTLP_TP_OBJECT)IoHandle;
+    BOOLEAN Cancelled = FALSE;
+
+    /* The operation failed right away, no completion is coming */
+    RtlpTpAcquireIoLock(Io);
+    if (Io->Pending > 0)
+    {
+        InterlockedDecrement(&Io->Pending);
+        Cancelled = TRUE;
+    }
+    RtlpTpReleaseIoLock(Io);
+
+    if (Cancelled)
+    {
+        RtlpTpWakeWaiters(Io);
+        RtlpTpRelease(Io);
+    }
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseIoCompletion(IN OUT PTP_IO Io)
+{
+    RtlpTpReleaseObject((PRTLP_TP_OBJECT)Io);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForIoCompletion(IN OUT PTP_IO Io,
+                      IN BOOLEAN CancelPendingCallbacks)
+{
+    if (CancelPendingCallbacks)
+        RtlpTpCancelPending((PRTLP_TP_OBJECT)Io);
+
+    RtlpTpWaitForCallbacks((PRTLP_TP_OBJECT)Io, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance)
+{
+    PRTLP_TP_CALLBACK_INSTANCE Instance = (PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance;
+    PRTLP_TP_POOL Pool = Instance->Object->Pool;
+
+    /* Make sure another worker can take the queue over */
+    RtlpTpGrowPool(Pool);
+
+    if (*(volatile LONG *)&Pool->IdleThreads > 0)
+        return STATUS_SUCCESS;
+
+    return STATUS_TOO_MANY_THREADS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpDisassociateCallback(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance)
+{
+    PRTLP_TP_CALLBACK_INSTANCE Instance = (PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance;
+
+    /* Whoever waits for the callbacks of the object stops waiting for us */
+    if (Instance->Associated)
+    {
+        Instance->Associated = FALSE;
+        RtlpTpCallbackDone(Instance->Object);
+    }
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance,
+                               IN HANDLE Event)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance)->Event = Event;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance,
+                                       IN HANDLE Semaphore,
+                                       IN LONG ReleaseCount)
+{
+    PRTLP_TP_CALLBACK_INSTANCE Instance = (PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance;
+
+    Instance->Semaphore = Semaphore;
+    Instance->SemaphoreReleaseCount = ReleaseCount;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance,
+                                   IN HANDLE Mutex)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance)->Mutex = Mutex;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance,
+                                           IN OUT PRTL_CRITICAL_SECTION CriticalSection)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance)->CriticalSection = CriticalSection;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(IN OUT PTP_CALLBACK_INSTANCE CallbackInstance,
+                                IN PVOID DllHandle)
+{
+    ((PRTLP_TP_CALLBACK_INSTANCE)CallbackInstance)->DllHandle = DllHandle;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+RtlSetIoCompletionCallback(IN HANDLE FileHandle,
+                           IN PIO_APC_ROUTINE Callback,
+                           IN ULONG Flags)
+{
+    FILE_COMPLETION_INFORMATION FileCompletionInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PRTLP_TP_IO_BINDING Binding;
+    PRTLP_TP_OBJECT Io;
+    PLIST_ENTRY Entry;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    DPRINT("RtlSetIoCompletionCallback(0x%p, 0x%p, 0x%x)\n", FileHandle, Callback, Flags);
+
+    if (!IsTpInitialized())
+    {
+        Status = RtlpTpInitialize();
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    /*
+     * We can't tell when the file handle goes away, so the I/O object that
+     * stands for the callback is shared by every file bound to it and lives
+     * as long as the process.
+     */
+    RtlEnterCriticalSection(&RtlpTpLock);
+    for (Entry = RtlpTpBindingList.Flink; Entry != &RtlpTpBindingList; Entry = Entry->Flink)
+    {
+        Binding = CONTAINING_RECORD(Entry, RTLP_TP_IO_BINDING, ListEntry);
+        if (Binding->Callback == (PVOID)Callback)
+            break;
+    }
+
+    if (Entry == &RtlpTpBindingList)
+    {
+        Binding = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(RTLP_TP_IO_BINDING));
+        if (Binding == NULL)
+        {
+            Status = STATUS_NO_MEMORY;
+        }
+        else
+        {
+            Status = RtlpTpAllocObject(&Io, RtlpTpIoObject, Callback, NULL, NULL);
+            if (NT_SUCCESS(Status))
+            {
+                Io->Flags |= RTLP_TP_UNACCOUNTED;
+                if (Flags & WT_EXECUTELONGFUNCTION)
+                    Io->Flags |= RTLP_TP_LONG_FUNCTION;
+
+                Binding->Callback = (PVOID)Callback;
+                Binding->Io = Io;
+                InsertTailList(&RtlpTpBindingList, &Binding->ListEntry);
+            }
+            else
+            {
+                RtlFreeHeap(RtlGetProcessHeap(), 0, Binding);
+            }
+        }
+    }
+    RtlLeaveCriticalSection(&RtlpTpLock);
+
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    FileCompletionInfo.Port = Binding->Io->Pool->CompletionPort;
+    FileCompletionInfo.Key = Binding->Io;
+
+    Status = NtSetInformationFile(FileHandle,
+                                  &IoStatusBlock,
+                                  &FileCompletionInfo,
+                                  sizeof(FileCompletionInfo),
+                                  FileCompletionInformation);
+
+    return Status;
+}
+
+/* EOF */
@@ -19,35 +19,20 @@
 
 /* FUNCTIONS ***************************************************************/
 
-extern PRTL_START_POOL_THREAD RtlpStartThreadFunc;
-extern PRTL_EXIT_POOL_THREAD RtlpExitThreadFunc;
-HANDLE TimerThreadHandle = NULL;
-
-NTSTATUS
-RtlpInitializeTimerThread(VOID)
-{
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout )
-{
-    if (timeout == INFINITE) return NULL;
-    pTime->QuadPart = (ULONGLONG)timeout * -10000;
-    return pTime;
-}
+/*
+ * Timer queues only group timers for deletion, the timers themselves are
+ * thread pool timers and all fire from the single timer thread in
+ * threadpool.c, whatever the queue they are on.
+ */
 
 struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
-    ULONG runcount;             /* number of callbacks pending execution */
+    PTP_TIMER tp;
     WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
-    DWORD period;
-    ULONG flags;
-    ULONGLONG expire;
-    BOOL destroy;               /* timer should be deleted; once set, never unset */
     HANDLE event;               /* removal event */
 };
 
@@ -55,219 +40,56 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;
     BOOL quit;                  /* queue should be deleted; once set, never unset */
-    HANDLE event;
-    HANDLE thread;
+    LONG refs;                  /* one for the queue, one for each timer */
+    HANDLE event;               /* set once the queue is gone */
 };
 
-#define EXPIRE_NEVER (~(ULONGLONG) 0)
 #define TIMER_QUEUE_MAGIC  0x516d6954   /* TimQ */
 
-static void queue_remove_timer(struct queue_timer *t)
+static void queue_release(struct timer_queue *q)
 {
-    /* We MUST hold the queue cs while calling this function.  This ensures
-       that we cannot queue another callback for this timer.  The runcount
-       being zero makes sure we don't have any already queued.  */
-    struct timer_queue *q = t->q;
-
-    assert(t->runcount == 0);
-    assert(t->destroy);
-
-    list_remove(&t->entry);
-    if (t->event)
-        NtSetEvent(t->event, NULL);
-    RtlFreeHeap(RtlGetProcessHeap(), 0, t);
-
-    if (q->quit && list_empty(&q->timers))
-        NtSetEvent(q->event, NULL);
-}
-
-static void timer_cleanup_callback(struct queue_timer *t)
-{
-    struct timer_queue *q = t->q;
-    RtlEnterCriticalSection(&q->cs);
+    HANDLE event;
 
-    assert(0 < t->runcount);
-    --t->runcount;
+    if (InterlockedDecrement(&q->refs) != 0)
+        return;
 
-    if (t->destroy && t->runcount == 0)
-        queue_remove_timer(t);
+    event = q->event;
+    RtlDeleteCriticalSection(&q->cs);
+    q->magic = 0;
+    RtlFreeHeap(RtlGetProcessHeap(), 0, q);
 
-    RtlLeaveCriticalSection(&q->cs);
+    if (event)
+        NtSetEvent(event, NULL);
 }
 
-static VOID WINAPI timer_callback_wrapper(LPVOID p)
+static VOID NTAPI timer_callback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
 {
-    struct queue_timer *t = p;
+    struct queue_timer *t = context;
     t->callback(t->param, TRUE);
-    timer_cleanup_callback(t);
-}
-
-static inline ULONGLONG queue_current_time(void)
-{
-    LARGE_INTEGER now, freq;
-    NtQueryPerformanceCounter(&now, &freq);
-    return now.QuadPart * 1000 / freq.QuadPart;
 }
 
-static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
-                            BOOL set_event)
+static VOID NTAPI timer_finalize(PTP_CALLBACK_INSTANCE instance, PVOID context)
 {
-    /* We MUST hold the queue cs while calling this function.  */
+    /* Runs once the last callback of the timer is done */
+    struct queue_timer *t = context;
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
-
-    assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
-
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
 
-    t->expire = time;
-
-    /* If we insert at the head of the list, we need to expire sooner
-       than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
-        NtSetEvent(q->event, NULL);
-}
-
-static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
-                                    BOOL set_event)
-{
-    /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
-    queue_add_timer(t, time, set_event);
-}
-
-static void queue_timer_expire(struct timer_queue *q)
-{
-    struct queue_timer *t = NULL;
-
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
-    {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
-        {
-            ++t->runcount;
-            if (t->period)
-            {
-                next = t->expire + t->period;
-                /* avoid trigger cascade if overloaded / hibernated */
-                if (next < now)
-                    next = now + t->period;
-            }
-            else
-                next = EXPIRE_NEVER;
-            queue_move_timer(t, next, FALSE);
-        }
-        else
-            t = NULL;
-    }
-    RtlLeaveCriticalSection(&q->cs);
-
-    if (t)
-    {
-        if (t->flags & WT_EXECUTEINTIMERTHREAD)
-            timer_callback_wrapper(t);
-        else
-        {
-            ULONG flags
-                = (t->flags
-                   & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD
-                      | WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION));
-            NTSTATUS status = RtlQueueWorkItem(timer_callback_wrapper, t, flags);
-            if (status != STATUS_SUCCESS)
-                timer_cleanup_callback(t);
-        }
-    }
-}
-
-static ULONG queue_get_timeout(struct timer_queue *q)
-{
-    struct queue_timer *t;
-    ULONG timeout = INFINITE;
-
-    RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
-    {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : (ULONG)(t->expire - time);
-        }
-    }
-    RtlLeaveCriticalSection(&q->cs);
+    if (t->event)
+        NtSetEvent(t->event, NULL);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, t);
 
-    return timeout;
+    if (q)
+        queue_release(q);
 }
 
-static DWORD WINAPI timer_queue_thread_proc(LPVOID p)
+static inline void timer_set(struct queue_timer *t, DWORD due, DWORD period)
 {
-    struct timer_queue *q = p;
-    ULONG timeout_ms;
-
-    timeout_ms = INFINITE;
-    for (;;)
-    {
-        LARGE_INTEGER timeout;
-        NTSTATUS status;
-        BOOL done = FALSE;
-
-        status = NtWaitForSingleObject(
-            q->event, FALSE, get_nt_timeout(&timeout, timeout_ms));
-
-        if (status == STATUS_WAIT_0)
-        {
-            /* There are two possible ways to trigger the event.  Either
-               we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
-               our timeout.  */
-            RtlEnterCriticalSection(&q->cs);
-            if (q->quit && list_empty(&q->timers))
-                done = TRUE;
-            RtlLeaveCriticalSection(&q->cs);
-        }
-        else if (status == STATUS_TIMEOUT)
-            queue_timer_expire(q);
+    LARGE_INTEGER time;
 
-        if (done)
-            break;
-
-        timeout_ms = queue_get_timeout(q);
-    }
-
-    NtClose(q->event);
-    RtlDeleteCriticalSection(&q->cs);
-    q->magic = 0;
-    RtlFreeHeap(RtlGetProcessHeap(), 0, q);
-    RtlpExitThreadFunc(STATUS_SUCCESS);
-    return 0;
-}
-
-static void queue_destroy_timer(struct queue_timer *t)
-{
-    /* We MUST hold the queue cs while calling this function.  */
-    t->destroy = TRUE;
-    if (t->runcount == 0)
-        /* Ensure a timer is promptly removed.  If callbacks are pending,
-           it will be removed after the last one finishes by the callback
-           cleanup wrapper.  */
-        queue_remove_timer(t);
-    else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
-        queue_move_timer(t, EXPIRE_NEVER, FALSE);
+    time.QuadPart = (LONGLONG)due * -10000;
+    TpSetTimer(t->tp, &time, period, 0);
 }
 
 /***********************************************************************
@@ -289,25 +111,18 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
     if (!q)
         return STATUS_NO_MEMORY;
 
-    RtlInitializeCriticalSection(&q->cs);
-    list_init(&q->timers);
-    q->quit = FALSE;
-    q->magic = TIMER_QUEUE_MAGIC;
-    status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
-    if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap(RtlGetProcessHeap(), 0, q);
-        return status;
-    }
-    status = RtlpStartThreadFunc(timer_queue_thread_proc, q, &q->thread);
+    status = RtlInitializeCriticalSection(&q->cs);
     if (status != STATUS_SUCCESS)
     {
-        NtClose(q->event);
         RtlFreeHeap(RtlGetProcessHeap(), 0, q);
         return status;
     }
+    list_init(&q->timers);
+    q->quit = FALSE;
+    q->refs = 1;
+    q->event = NULL;
+    q->magic = TIMER_QUEUE_MAGIC;
 
-    NtResumeThread(q->thread, NULL);
     *NewTimerQueue = q;
     return STATUS_SUCCESS;
 }
@@ -332,43 +147,47 @@ NTSTATUS WINAPI RtlDeleteTimerQueueEx(HANDLE TimerQueue, HANDLE CompletionEvent)
 {
     struct timer_queue *q = TimerQueue;
     struct queue_timer *t, *temp;
-    HANDLE thread;
+    struct list timers;
+    HANDLE event = NULL;
     NTSTATUS status;
 
     if (!q || q->magic != TIMER_QUEUE_MAGIC)
         return STATUS_INVALID_HANDLE;
 
-    thread = q->thread;
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        status = NtCreateEvent(&event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+        if (status != STATUS_SUCCESS)
+            return status;
+    }
+    else
+        event = CompletionEvent;
 
     RtlEnterCriticalSection(&q->cs);
     q->quit = TRUE;
-    if (list_head(&q->timers))
-        /* When the last timer is removed, it will signal the timer thread to
-           exit...  */
-        LIST_FOR_EACH_ENTRY_SAFE(t, temp, &q->timers, struct queue_timer, entry)
-            queue_destroy_timer(t);
-    else
-        /* However if we have none, we must do it ourselves.  */
-        NtSetEvent(q->event, NULL);
+    list_init(&timers);
+    list_move_tail(&timers, &q->timers);
     RtlLeaveCriticalSection(&q->cs);
 
+    /* The last timer to finish, or we, will free the queue */
+    q->event = event;
+    LIST_FOR_EACH_ENTRY_SAFE(t, temp, &timers, struct queue_timer, entry)
+    {
+        list_remove(&t->entry);
+        TpSetTimer(t->tp, NULL, 0, 0);
+        TpReleaseTimer(t->tp);
+    }
+    queue_release(q);
+
     if (CompletionEvent == INVALID_HANDLE_VALUE)
     {
-        NtWaitForSingleObject(thread, FALSE, NULL);
+        NtWaitForSingleObject(event, FALSE, NULL);
+        NtClose(event);
         status = STATUS_SUCCESS;
     }
     else
-    {
-        if (CompletionEvent)
-        {
-            DPRINT1("asynchronous return on completion event unimplemented\n");
-            NtWaitForSingleObject(thread, FALSE, NULL);
-            NtSetEvent(CompletionEvent, NULL);
-        }
         status = STATUS_PENDING;
-    }
 
-    NtClose(thread);
     return status;
 }
 
@@ -429,6 +248,7 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
 {
     NTSTATUS status;
     struct queue_timer *t;
+    TP_CALLBACK_ENVIRON environment;
     struct timer_queue *q = get_timer_queue(TimerQueue);
 
     if (!q) return STATUS_NO_MEMORY;
@@ -439,26 +259,43 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, PHANDLE NewTimer,
         return STATUS_NO_MEMORY;
 
     t->q = q;
-    t->runcount = 0;
     t->callback = Callback;
     t->param = Parameter;
-    t->period = Period;
-    t->flags = Flags;
-    t->destroy = FALSE;
     t->event = NULL;
 
-    status = STATUS_SUCCESS;
+    TpInitializeCallbackEnviron(&environment);
+    TpSetCallbackFinalizationCallback(&environment, timer_finalize);
+    if (Flags & WT_EXECUTELONGFUNCTION)
+        TpSetCallbackLongFunction(&environment);
+    if (Flags & (WT_EXECUTEINTIMERTHREAD | WT_EXECUTEINPERSISTENTTHREAD))
+        TpSetCallbackPersistent(&environment);
+
+    status = TpAllocTimer(&t->tp, timer_callback, t, &environment);
+    if (status != STATUS_SUCCESS)
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, t);
+        return status;
+    }
+
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
     else
-        queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    {
+        InterlockedIncrement(&q->refs);
+        list_add_tail(&q->timers, &t->entry);
+        timer_set(t, DueTime, (Flags & WT_EXECUTEONLYONCE) ? 0 : Period);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
         *NewTimer = t;
     else
-        RtlFreeHeap(RtlGetProcessHeap(), 0, t);
+    {
+        /* It holds no reference on the queue yet */
+        t->q = NULL;
+        TpReleaseTimer(t->tp);
+    }
 
     return status;
 }
@@ -489,11 +326,8 @@ NTSTATUS WINAPI RtlUpdateTimer(HANDLE TimerQueue, HANDLE Timer,
 
     RtlEnterCriticalSection(&q->cs);
     /* Can't change a timer if it was once-only or destroyed.  */
-    if (t->expire != EXPIRE_NEVER)
-    {
-        t->period = Period;
-        queue_move_timer(t, queue_current_time() + DueTime, TRUE);
-    }
+    if (TpIsTimerSet(t->tp))
+        timer_set(t, DueTime, Period);
     RtlLeaveCriticalSection(&q->cs);
 
     return STATUS_SUCCESS;
@@ -538,20 +372,21 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
         event = CompletionEvent;
 
     RtlEnterCriticalSection(&q->cs);
-    t->event = event;
-    if (t->runcount == 0 && event)
-        status = STATUS_SUCCESS;
-    queue_destroy_timer(t);
+    list_remove(&t->entry);
     RtlLeaveCriticalSection(&q->cs);
 
+    /* Callbacks already queued still run, the event is set after the last */
+    TpSetTimer(t->tp, NULL, 0, 0);
+    if (event && !RtlpTpHasCallbacks(t->tp))
+        status = STATUS_SUCCESS;
+    t->event = event;
+    TpReleaseTimer(t->tp);
+
     if (CompletionEvent == INVALID_HANDLE_VALUE && event)
     {
-        if (status == STATUS_PENDING)
-        {
-            NtWaitForSingleObject(event, FALSE, NULL);
-            status = STATUS_SUCCESS;
-        }
+        NtWaitForSingleObject(event, FALSE, NULL);
         NtClose(event);
+        status = STATUS_SUCCESS;
     }
 
     return status;
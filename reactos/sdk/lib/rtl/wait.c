@@ -18,15 +18,10 @@
 
 typedef struct _RTLP_WAIT
 {
-    HANDLE Object;
-    BOOLEAN CallbackInProgress;
-    HANDLE CancelEvent;
-    LONG DeleteCount;
-    HANDLE CompletionEvent;
-    ULONG Flags;
+    PTP_WAIT Wait;
     WAITORTIMERCALLBACKFUNC Callback;
     PVOID Context;
-    ULONG Milliseconds;
+    HANDLE CompletionEvent;
 } RTLP_WAIT, *PRTLP_WAIT;
 
 /* PRIVATE FUNCTIONS *******************************************************/
@@ -40,62 +35,26 @@ static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout
 
 static VOID
 NTAPI
-Wait_thread_proc(LPVOID Arg)
+Wait_callback(PTP_CALLBACK_INSTANCE Instance,
+              PVOID Context,
+              PTP_WAIT TpWait,
+              TP_WAIT_RESULT WaitResult)
 {
-    PRTLP_WAIT Wait = (PRTLP_WAIT) Arg;
-    NTSTATUS Status;
-    BOOLEAN alertable = (Wait->Flags & WT_EXECUTEINIOTHREAD) != 0;
-    HANDLE handles[2] = { Wait->CancelEvent, Wait->Object };
-    LARGE_INTEGER timeout;
-    HANDLE completion_event;
-
-//    TRACE("\n");
-
-    while (TRUE)
-    {
-        Status = NtWaitForMultipleObjects( 2,
-                                           handles,
-                                           WaitAny,
-                                           alertable,
-                                           get_nt_timeout( &timeout, Wait->Milliseconds ) );
-
-        if (Status == STATUS_WAIT_1 || Status == STATUS_TIMEOUT)
-        {
-            BOOLEAN TimerOrWaitFired;
-
-            if (Status == STATUS_WAIT_1)
-            {
-   //             TRACE( "object %p signaled, calling callback %p with context %p\n",
-   //                 Wait->Object, Wait->Callback,
-   //                 Wait->Context );
-                TimerOrWaitFired = FALSE;
-            }
-            else
-            {
-    //            TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
-    //                Wait->Object, Wait->Callback,
-    //                Wait->Context );
-                TimerOrWaitFired = TRUE;
-            }
-            Wait->CallbackInProgress = TRUE;
-            Wait->Callback( Wait->Context, TimerOrWaitFired );
-            Wait->CallbackInProgress = FALSE;
+    PRTLP_WAIT Wait = (PRTLP_WAIT) Context;
 
-            if (Wait->Flags & WT_EXECUTEONLYONCE)
-                break;
-        }
-        else if (Status != STATUS_USER_APC)
-            break;
-    }
+    Wait->Callback( Wait->Context, WaitResult == STATUS_TIMEOUT );
+}
 
-    completion_event = Wait->CompletionEvent;
-    if (completion_event) NtSetEvent( completion_event, NULL );
+static VOID
+NTAPI
+Wait_finalize(PTP_CALLBACK_INSTANCE Instance,
+              PVOID Context)
+{
+    PRTLP_WAIT Wait = (PRTLP_WAIT) Context;
 
-    if (InterlockedIncrement( &Wait->DeleteCount ) == 2 )
-    {
-       NtClose( Wait->CancelEvent );
-       RtlFreeHeap( RtlGetProcessHeap(), 0, Wait );
-    }
+    /* The last callback is done and the wait is deregistered */
+    if (Wait->CompletionEvent) NtSetEvent( Wait->CompletionEvent, NULL );
+    RtlFreeHeap( RtlGetProcessHeap(), 0, Wait );
 }
 
 
@@ -138,6 +97,8 @@ RtlRegisterWait(PHANDLE NewWaitObject,
 {
     PRTLP_WAIT Wait;
     NTSTATUS Status;
+    TP_CALLBACK_ENVIRON Environment;
+    LARGE_INTEGER Timeout;
 
     //TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
 
@@ -145,38 +106,34 @@ RtlRegisterWait(PHANDLE NewWaitObject,
     if (!Wait)
         return STATUS_NO_MEMORY;
 
-    Wait->Object = Object;
     Wait->Callback = Callback;
     Wait->Context = Context;
-    Wait->Milliseconds = Milliseconds;
-    Wait->Flags = Flags;
-    Wait->CallbackInProgress = FALSE;
-    Wait->DeleteCount = 0;
     Wait->CompletionEvent = NULL;
 
-    Status = NtCreateEvent( &Wait->CancelEvent, 
-                             EVENT_ALL_ACCESS, 
-                             NULL,
-                             NotificationEvent,
-                             FALSE );
+    TpInitializeCallbackEnviron( &Environment );
+    TpSetCallbackFinalizationCallback( &Environment, Wait_finalize );
+    if (Flags & WT_EXECUTELONGFUNCTION)
+        TpSetCallbackLongFunction( &Environment );
+    if (Flags & WT_EXECUTEINPERSISTENTTHREAD)
+        TpSetCallbackPersistent( &Environment );
 
+    Status = TpAllocWait( &Wait->Wait, Wait_callback, Wait, &Environment );
     if (Status != STATUS_SUCCESS)
     {
         RtlFreeHeap( RtlGetProcessHeap(), 0, Wait );
         return Status;
     }
 
-    Flags = Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD |
-                     WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION);
+    /* Waits share the pool's waiter threads instead of taking one each */
+    RtlpTpSetFlags( Wait->Wait,
+                    ((Flags & WT_EXECUTEONLYONCE) ? 0 : RTLP_TP_REARM_WAIT) |
+                    ((Flags & WT_EXECUTEINWAITTHREAD) ? RTLP_TP_EXECUTE_INLINE : 0) );
 
-    Status = RtlQueueWorkItem( Wait_thread_proc,
-                               Wait,
-                               Flags );
-
-    if (Status != STATUS_SUCCESS)
+    Status = RtlpTpSetWait( Wait->Wait, Object, get_nt_timeout( &Timeout, Milliseconds ) );
+    if (!NT_SUCCESS(Status))
     {
-        NtClose( Wait->CancelEvent );
-        RtlFreeHeap( RtlGetProcessHeap(), 0, Wait );
+        /* The finalization callback frees Wait */
+        TpReleaseWait( Wait->Wait );
         return Status;
     }
 
@@ -203,52 +160,26 @@ RtlDeregisterWaitEx(HANDLE WaitHandle,
                     HANDLE CompletionEvent)
 {
     PRTLP_WAIT Wait = (PRTLP_WAIT) WaitHandle;
+    PTP_WAIT TpWait = Wait->Wait;
     NTSTATUS Status = STATUS_SUCCESS;
 
     //TRACE( "(%p)\n", WaitHandle );
 
-    NtSetEvent( Wait->CancelEvent, NULL );
-    if (Wait->CallbackInProgress)
-    {
-        if (CompletionEvent != NULL)
-        {
-            if (CompletionEvent == INVALID_HANDLE_VALUE)
-            {
-                Status = NtCreateEvent( &CompletionEvent,
-                                         EVENT_ALL_ACCESS,
-                                         NULL,
-                                         NotificationEvent,
-                                         FALSE );
-
-                if (Status != STATUS_SUCCESS)
-                    return Status;
-
-                (void)InterlockedExchangePointer( &Wait->CompletionEvent, CompletionEvent );
-
-                if (Wait->CallbackInProgress)
-                    NtWaitForSingleObject( CompletionEvent, FALSE, NULL );
+    TpSetWait( TpWait, NULL, NULL );
 
-                NtClose( CompletionEvent );
-            }
-            else
-            {
-                (void)InterlockedExchangePointer( &Wait->CompletionEvent, CompletionEvent );
-
-                if (Wait->CallbackInProgress)
-                    Status = STATUS_PENDING;
-            }
-        }
-        else
-            Status = STATUS_PENDING;
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+    {
+        TpWaitForWait( TpWait, TRUE );
     }
-
-    if (InterlockedIncrement( &Wait->DeleteCount ) == 2 )
+    else
     {
-        Status = STATUS_SUCCESS;
-        NtClose( Wait->CancelEvent );
-        RtlFreeHeap( RtlGetProcessHeap(), 0, Wait );
+        if (RtlpTpHasCallbacks( TpWait ))
+            Status = STATUS_PENDING;
+
+        Wait->CompletionEvent = CompletionEvent;
     }
 
+    TpReleaseWait( TpWait );
     return Status;
 }
 
@@ -67,10 +67,6 @@ static LONG ThreadPoolInitialized = 0;
 static RTL_CRITICAL_SECTION ThreadPoolLock;
 static PRTLP_IOWORKERTHREAD PersistentIoThread;
 static LIST_ENTRY ThreadPoolIOWorkerThreadsList;
-static HANDLE ThreadPoolCompletionPort;
-static LONG ThreadPoolWorkerThreads;
-static LONG ThreadPoolWorkerThreadsRequests;
-static LONG ThreadPoolWorkerThreadsLongRequests;
 static LONG ThreadPoolIOWorkerThreads;
 static LONG ThreadPoolIOWorkerThreadsRequests;
 static LONG ThreadPoolIOWorkerThreadsLongRequests;
@@ -96,30 +92,13 @@ RtlpInitializeThreadPool(VOID)
 
             PersistentIoThread = NULL;
 
-            ThreadPoolWorkerThreads = 0;
-            ThreadPoolWorkerThreadsRequests = 0;
-            ThreadPoolWorkerThreadsLongRequests = 0;
             ThreadPoolIOWorkerThreads = 0;
             ThreadPoolIOWorkerThreadsRequests = 0;
             ThreadPoolIOWorkerThreadsLongRequests = 0;
 
             /* Initialize the lock */
             Status = RtlInitializeCriticalSection(&ThreadPoolLock);
-            if (!NT_SUCCESS(Status))
-                goto Finish;
-
-            /* Create the complection port */
-            Status = NtCreateIoCompletion(&ThreadPoolCompletionPort,
-                                          IO_COMPLETION_ALL_ACCESS,
-                                          NULL,
-                                          0);
-            if (!NT_SUCCESS(Status))
-            {
-                RtlDeleteCriticalSection(&ThreadPoolLock);
-                goto Finish;
-            }
 
-Finish:
             /* Initialization done */
             InterlockedExchange(&ThreadPoolInitialized,
                                  1);
@@ -191,17 +170,18 @@ RtlpStartWorkerThread(PTHREAD_START_ROUTINE StartRoutine)
 
 static VOID
 NTAPI
-RtlpExecuteWorkItem(IN OUT PVOID NormalContext,
-                    IN OUT PVOID SystemArgument1,
-                    IN OUT PVOID SystemArgument2)
+RtlpExecuteWorkItem(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                    IN OUT PVOID Context)
 {
     NTSTATUS Status;
     BOOLEAN Impersonated = FALSE;
-    RTLP_WORKITEM WorkItem = *(volatile RTLP_WORKITEM *)SystemArgument2;
+    RTLP_WORKITEM WorkItem = *(volatile RTLP_WORKITEM *)Context;
+
+    UNREFERENCED_PARAMETER(Instance);
 
     RtlFreeHeap(RtlGetProcessHeap(),
                 0,
-                SystemArgument2);
+                Context);
 
     if (WorkItem.TokenHandle != NULL)
     {
@@ -243,64 +223,23 @@ RtlpExecuteWorkItem(IN OUT PVOID NormalContext,
             DPRINT1("Failed to revert worker thread to self!!! Status: 0x%x\n", Status);
         }
     }
-
-    /* update the requests counter */
-    InterlockedDecrement(&ThreadPoolWorkerThreadsRequests);
-
-    if (WorkItem.Flags & WT_EXECUTELONGFUNCTION)
-    {
-        InterlockedDecrement(&ThreadPoolWorkerThreadsLongRequests);
-    }
 }
 
-
 static NTSTATUS
 RtlpQueueWorkerThread(IN OUT PRTLP_WORKITEM WorkItem)
 {
-    NTSTATUS Status = STATUS_SUCCESS;
+    TP_CALLBACK_ENVIRON CallbackEnviron;
 
-    InterlockedIncrement(&ThreadPoolWorkerThreadsRequests);
+    /* The thread pool decides when it needs another worker */
+    TpInitializeCallbackEnviron(&CallbackEnviron);
 
     if (WorkItem->Flags & WT_EXECUTELONGFUNCTION)
-    {
-        InterlockedIncrement(&ThreadPoolWorkerThreadsLongRequests);
-    }
+        TpSetCallbackLongFunction(&CallbackEnviron);
 
     if (WorkItem->Flags & WT_EXECUTEINPERSISTENTTHREAD)
-    {
-        Status = RtlpInitializeTimerThread();
-
-        if (NT_SUCCESS(Status))
-        {
-            /* Queue an APC in the timer thread */
-            Status = NtQueueApcThread(TimerThreadHandle,
-                                      RtlpExecuteWorkItem,
-                                      NULL,
-                                      NULL,
-                                      WorkItem);
-        }
-    }
-    else
-    {
-        /* Queue an IO completion message */
-        Status = NtSetIoCompletion(ThreadPoolCompletionPort,
-                                   RtlpExecuteWorkItem,
-                                   WorkItem,
-                                   STATUS_SUCCESS,
-                                   0);
-    }
+        TpSetCallbackPersistent(&CallbackEnviron);
 
-    if (!NT_SUCCESS(Status))
-    {
-        InterlockedDecrement(&ThreadPoolWorkerThreadsRequests);
-
-        if (WorkItem->Flags & WT_EXECUTELONGFUNCTION)
-        {
-            InterlockedDecrement(&ThreadPoolWorkerThreadsLongRequests);
-        }
-    }
-
-    return Status;
+    return TpSimpleTryPost(RtlpExecuteWorkItem, WorkItem, &CallbackEnviron);
 }
 
 static VOID
@@ -513,7 +452,7 @@ RtlpQueueIoWorkerThread(IN OUT PRTLP_WORKITEM WorkItem)
     return Status;
 }
 
-static BOOLEAN
+BOOLEAN
 RtlpIsIoPending(IN HANDLE ThreadHandle  OPTIONAL)
 {
     NTSTATUS Status;
@@ -673,104 +612,6 @@ Wait:
     return 0;
 }
 
-static ULONG
-NTAPI
-RtlpWorkerThreadProc(IN PVOID Parameter)
-{
-    LARGE_INTEGER Timeout;
-    BOOLEAN Terminate;
-    PVOID SystemArgument2;
-    IO_STATUS_BLOCK IoStatusBlock;
-    ULONG TimeoutCount = 0;
-    PKNORMAL_ROUTINE ApcRoutine;
-    NTSTATUS Status = STATUS_SUCCESS;
-
-    if (InterlockedIncrement(&ThreadPoolWorkerThreads) > MAX_WORKERTHREADS)
-    {
-        /* Signal initialization completion */
-        InterlockedExchange((PLONG)Parameter,
-                             1);
-
-        /* Oops, too many worker threads... */
-        RtlpExitThreadFunc(Status);
-        return 0;
-    }
-
-    /* Signal initialization completion */
-    InterlockedExchange((PLONG)Parameter,
-                         1);
-
-    for (;;)
-    {
-        Timeout.QuadPart = -50000000LL; /* Wait for 5 seconds by default */
-
-        /* Dequeue a completion message */
-        Status = NtRemoveIoCompletion(ThreadPoolCompletionPort,
-                                      (PVOID*)&ApcRoutine,
-                                      &SystemArgument2,
-                                      &IoStatusBlock,
-                                      &Timeout);
-
-        if (Status == STATUS_SUCCESS)
-        {
-            TimeoutCount = 0;
-
-            _SEH2_TRY
-            {
-                /* Call the APC routine */
-                ApcRoutine(NULL,
-                           (PVOID)IoStatusBlock.Information,
-                           SystemArgument2);
-            }
-            _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
-            {
-                (void)0;
-            }
-            _SEH2_END;
-        }
-        else
-        {
-            Terminate = FALSE;
-
-            if (!NT_SUCCESS(RtlEnterCriticalSection(&ThreadPoolLock)))
-                continue;
-
-            /* FIXME - this should be optimized, check if there's requests, etc */
-
-            if (Status == STATUS_TIMEOUT)
-            {
-                /* FIXME - we might want to optimize this */
-                if (TimeoutCount++ > 2 &&
-                    *((volatile LONG*)&ThreadPoolWorkerThreads) - *((volatile LONG*)&ThreadPoolWorkerThreadsLongRequests) >= WORKERTHREAD_CREATION_THRESHOLD)
-                {
-                    Terminate = TRUE;
-                }
-            }
-            else
-                Terminate = TRUE;
-
-            RtlLeaveCriticalSection(&ThreadPoolLock);
-
-            if (Terminate)
-            {
-                /* Prevent termination as long as IO is pending */
-                Terminate = !RtlpIsIoPending(NULL);
-            }
-
-            if (Terminate)
-            {
-                InterlockedDecrement(&ThreadPoolWorkerThreads);
-                Status = STATUS_SUCCESS;
-                break;
-            }
-        }
-    }
-
-    RtlpExitThreadFunc(Status);
-    return 0;
-
-}
-
 /*
  * @implemented
  */
@@ -786,15 +627,6 @@ RtlQueueWorkItem(IN WORKERCALLBACKFUNC Function,
 
     DPRINT("RtlQueueWorkItem(0x%p, 0x%p, 0x%x)\n", Function, Context, Flags);
 
-    /* Initialize the thread pool if not already initialized */
-    if (!IsThreadPoolInitialized())
-    {
-        Status = RtlpInitializeThreadPool();
-
-        if (!NT_SUCCESS(Status))
-            return Status;
-    }
-
     /* Allocate a work item */
     WorkItem = RtlAllocateHeap(RtlGetProcessHeap(),
                                0,
@@ -819,10 +651,19 @@ RtlQueueWorkItem(IN WORKERCALLBACKFUNC Function,
     else
         WorkItem->TokenHandle = NULL;
 
-    Status = RtlEnterCriticalSection(&ThreadPoolLock);
-    if (NT_SUCCESS(Status))
+    if (Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINUITHREAD | WT_EXECUTEINPERSISTENTIOTHREAD))
     {
-        if (Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINUITHREAD | WT_EXECUTEINPERSISTENTIOTHREAD))
+        /* These need an alertable thread to complete their I/O on, which
+           the completion port workers are not. Keep them on APC workers */
+        if (!IsThreadPoolInitialized())
+            Status = RtlpInitializeThreadPool();
+        else
+            Status = STATUS_SUCCESS;
+
+        if (NT_SUCCESS(Status))
+            Status = RtlEnterCriticalSection(&ThreadPoolLock);
+
+        if (NT_SUCCESS(Status))
         {
             /* FIXME - We should optimize the algorithm used to determine whether to grow the thread pool! */
 
@@ -855,36 +696,14 @@ RtlQueueWorkItem(IN WORKERCALLBACKFUNC Function,
                 /* Queue a IO worker thread */
                 Status = RtlpQueueIoWorkerThread(WorkItem);
             }
-        }
-        else
-        {
-            /* FIXME - We should optimize the algorithm used to determine whether to grow the thread pool! */
-
-            FreeWorkers = ThreadPoolWorkerThreads - ThreadPoolWorkerThreadsLongRequests;
-
-            /* See if it's a good idea to grow the pool */
-            if (ThreadPoolWorkerThreads < MAX_WORKERTHREADS &&
-                (FreeWorkers <= 0 || ThreadPoolWorkerThreads - ThreadPoolWorkerThreadsRequests < WORKERTHREAD_CREATION_THRESHOLD))
-            {
-                /* Grow the thread pool */
-                Status = RtlpStartWorkerThread(RtlpWorkerThreadProc);
-
-                if (!NT_SUCCESS(Status) && *((volatile LONG*)&ThreadPoolWorkerThreads) != 0)
-                {
-                    /* We failed to create the thread, but there's at least one there so
-                       we can at least queue the request */
-                    Status = STATUS_SUCCESS;
-                }
-            }
 
-            if (NT_SUCCESS(Status))
-            {
-                /* Queue a normal worker thread */
-                Status = RtlpQueueWorkerThread(WorkItem);
-            }
+            RtlLeaveCriticalSection(&ThreadPoolLock);
         }
-
-        RtlLeaveCriticalSection(&ThreadPoolLock);
+    }
+    else
+    {
+        /* Queue it to the thread pool */
+        Status = RtlpQueueWorkerThread(WorkItem);
     }
 
     if (!NT_SUCCESS(Status))
@@ -903,41 +722,6 @@ Cleanup:
     return Status;
 }
 
-/*
- * @unimplemented
- */
-NTSTATUS
-NTAPI
-RtlSetIoCompletionCallback(IN HANDLE FileHandle,
-                           IN PIO_APC_ROUTINE Callback,
-                           IN ULONG Flags)
-{
-    IO_STATUS_BLOCK IoStatusBlock;
-    FILE_COMPLETION_INFORMATION FileCompletionInfo;
-    NTSTATUS Status;
-
-    DPRINT("RtlSetIoCompletionCallback(0x%p, 0x%p, 0x%x)\n", FileHandle, Callback, Flags);
-
-    /* Initialize the thread pool if not already initialized */
-    if (!IsThreadPoolInitialized())
-    {
-        Status = RtlpInitializeThreadPool();
-        if (!NT_SUCCESS(Status))
-            return Status;
-    }
-
-    FileCompletionInfo.Port = ThreadPoolCompletionPort;
-    FileCompletionInfo.Key = (PVOID)Callback;
-
-    Status = NtSetInformationFile(FileHandle,
-                                  &IoStatusBlock,
-                                  &FileCompletionInfo,
-                                  sizeof(FileCompletionInfo),
-                                  FileCompletionInformation);
-
-    return Status;
-}
-
 /*
  * @implemented
  */
@@ -0,0 +1,330 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS bitmap equivalence test
+ * FILE:            tools/bitmaptest/bitmaptest.c
+ * PURPOSE:         Compares the RTL bitmap functions with their old
+ *                  implementation on random bitmaps, and times both
+ */
+
+#include "bitmaptest.h"
+
+static ULONG Seed = 0x12345678;
+static ULONG Checks, OldBugs, Failures;
+
+static ULONG
+BitmapRandom(VOID)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+    return Seed;
+}
+
+static BOOLEAN
+ModelTest(PULONG Buffer, ULONG Index)
+{
+    return (Buffer[Index / 32] >> (Index % 32)) & 1;
+}
+
+/* Bit by bit versions of what the bitmap functions do */
+static ULONG
+ModelFind(PULONG Buffer, ULONG Size, ULONG NumberToFind, ULONG HintIndex, BOOLEAN Set)
+{
+    ULONG Pass, Index, Length;
+
+    if (NumberToFind > Size)
+        return MAXULONG;
+    if (HintIndex >= Size)
+        HintIndex = 0;
+    if (NumberToFind == 0)
+        return HintIndex & ~7;
+
+    /* From the hint on first, then what starts before it */
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        for (Index = Pass ? 0 : HintIndex; Index + NumberToFind <= Size; Index++)
+        {
+            if (Pass && Index >= HintIndex)
+                break;
+
+            for (Length = 0; Length < NumberToFind; Length++)
+            {
+                if (ModelTest(Buffer, Index + Length) != Set)
+                    break;
+            }
+
+            if (Length == NumberToFind)
+                return Index;
+        }
+    }
+
+    return MAXULONG;
+}
+
+static ULONG
+ModelLongestRunClear(PULONG Buffer, ULONG Size, PULONG StartingIndex)
+{
+    ULONG Index, Start, Longest = 0;
+
+    for (Index = 0; Index < Size; )
+    {
+        while (Index < Size && ModelTest(Buffer, Index))
+            Index++;
+
+        Start = Index;
+        while (Index < Size && !ModelTest(Buffer, Index))
+            Index++;
+
+        if (Index - Start > Longest)
+        {
+            Longest = Index - Start;
+            *StartingIndex = Start;
+        }
+    }
+
+    return Longest;
+}
+
+/*
+ * Both have to return the same, and what the model says. The only difference
+ * allowed is the one the new code fixed on purpose: the old RtlFindClearBits
+ * missed the runs that end with the bitmap.
+ */
+static VOID
+Compare(ULONG Old, ULONG New, ULONG Model, BOOLEAN OldBug,
+        PCSTR Function, ULONG Size, ULONG Arg1, ULONG Arg2)
+{
+    ++Checks;
+    if (Old == New && New == Model)
+        return;
+
+    if (OldBug && New == Model)
+    {
+        if (OldBugs++ < 8)
+        {
+            printf("%s(%lu, %lu) on %lu bits: old bug, %lu instead of %lu\n",
+                   Function, (unsigned long)Arg1, (unsigned long)Arg2, (unsigned long)Size,
+                   (unsigned long)Old, (unsigned long)New);
+        }
+        return;
+    }
+
+    ++Failures;
+    printf("%s(%lu, %lu) on %lu bits: old %lu, new %lu, expected %lu\n",
+           Function, (unsigned long)Arg1, (unsigned long)Arg2, (unsigned long)Size,
+           (unsigned long)Old, (unsigned long)New, (unsigned long)Model);
+}
+
+static VOID
+CheckBitmap(PULONG Buffer, ULONG Size)
+{
+    RTL_BITMAP BitMapHeader;
+    ULONG Hints[8], Numbers[10];
+    ULONG Old, New, Model, OldIndex, NewIndex, ModelIndex, Index, i, j;
+    BOOLEAN Set;
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, Size);
+
+    for (Index = 0, Model = 0; Index < Size; Index++)
+        Model += !ModelTest(Buffer, Index);
+    Compare(OldRtlNumberOfClearBits(&BitMapHeader), RtlNumberOfClearBits(&BitMapHeader),
+            Model, FALSE, "RtlNumberOfClearBits", Size, 0, 0);
+
+    /* The index is left alone when there is no clear bit */
+    OldIndex = NewIndex = ModelIndex = 0xcccccccc;
+    Old = OldRtlFindLongestRunClear(&BitMapHeader, &OldIndex);
+    New = RtlFindLongestRunClear(&BitMapHeader, &NewIndex);
+    Model = ModelLongestRunClear(Buffer, Size, &ModelIndex);
+    Compare(Old, New, Model, FALSE, "RtlFindLongestRunClear", Size, 0, 0);
+    Compare(OldIndex, NewIndex, ModelIndex, FALSE, "RtlFindLongestRunClear index", Size, 0, 0);
+
+    /* Hints at the start, anywhere, on word boundaries, at and past the end */
+    Hints[0] = 0;
+    Hints[1] = BitmapRandom() % Size;
+    Hints[2] = (BitmapRandom() % Size) & ~31;
+    Hints[3] = Size - 1;
+    Hints[4] = Size;
+    Hints[5] = Size + 1 + BitmapRandom() % 100;
+    Hints[6] = MAXULONG;
+    Hints[7] = Size / 2;
+
+    Numbers[0] = 0;
+    Numbers[1] = 1;
+    Numbers[2] = 2;
+    Numbers[3] = 1 + BitmapRandom() % 33;
+    Numbers[4] = 1 + BitmapRandom() % 70;
+    Numbers[5] = Model;
+    Numbers[6] = Model + 1;
+    Numbers[7] = Size - BitmapRandom() % min(Size, 8);
+    Numbers[8] = Size;
+    Numbers[9] = Size + 1;
+
+    for (Set = FALSE; Set <= TRUE; Set++)
+    {
+        for (i = 0; i < sizeof(Numbers) / sizeof(Numbers[0]); i++)
+        {
+            for (j = 0; j < sizeof(Hints) / sizeof(Hints[0]); j++)
+            {
+                if (Set)
+                {
+                    Old = OldRtlFindSetBits(&BitMapHeader, Numbers[i], Hints[j]);
+                    New = RtlFindSetBits(&BitMapHeader, Numbers[i], Hints[j]);
+                }
+                else
+                {
+                    Old = OldRtlFindClearBits(&BitMapHeader, Numbers[i], Hints[j]);
+                    New = RtlFindClearBits(&BitMapHeader, Numbers[i], Hints[j]);
+                }
+
+                Model = ModelFind(Buffer, Size, Numbers[i], Hints[j], Set);
+                Compare(Old, New, Model, !Set && New != MAXULONG && New + Numbers[i] == Size,
+                        Set ? "RtlFindSetBits" : "RtlFindClearBits", Size, Numbers[i], Hints[j]);
+            }
+        }
+    }
+}
+
+/* Alternating set and clear runs, the bits past the end are random */
+static VOID
+FillBitmap(PULONG Buffer, ULONG Size, ULONG SetMax, ULONG ClearMax)
+{
+    ULONG Index, Length, Bit;
+    BOOLEAN Set = BitmapRandom() & 1;
+
+    Buffer[(Size - 1) / 32] = BitmapRandom();
+    for (Index = 0; Index < Size; Index += Length, Set = !Set)
+    {
+        Length = 1 + BitmapRandom() % (Set ? SetMax : ClearMax);
+        for (Bit = Index; Bit < Index + Length && Bit < Size; Bit++)
+        {
+            if (Set)
+                Buffer[Bit / 32] |= 1UL << (Bit % 32);
+            else
+                Buffer[Bit / 32] &= ~(1UL << (Bit % 32));
+        }
+    }
+}
+
+static VOID
+Benchmark(VOID)
+{
+    static const PCSTR Names[] =
+    {
+        "RtlNumberOfClearBits", "RtlFindClearBits", "RtlFindSetBits", "RtlFindLongestRunClear"
+    };
+    RTL_BITMAP BitMapHeader;
+    PULONG Buffer;
+    ULONG Size = 1024 * 1024, Function, Round, Index;
+    BOOLEAN New;
+    clock_t Start;
+    double Seconds[2];
+
+    Buffer = malloc(Size / 8);
+    if (!Buffer)
+        return;
+
+    /* A fragmented bitmap with short runs, nothing of 64 clear or set bits in there */
+    Seed = 1;
+    FillBitmap(Buffer, Size, 24, 24);
+    RtlInitializeBitMap(&BitMapHeader, Buffer, Size);
+
+    for (Function = 0; Function < sizeof(Names) / sizeof(Names[0]); Function++)
+    {
+        for (New = FALSE; New <= TRUE; New++)
+        {
+            Start = clock();
+            for (Round = 0; Round < 16; Round++)
+            {
+                switch (Function)
+                {
+                    case 0:
+                        New ? RtlNumberOfClearBits(&BitMapHeader) : OldRtlNumberOfClearBits(&BitMapHeader);
+                        break;
+                    case 1:
+                        New ? RtlFindClearBits(&BitMapHeader, 64, Round) : OldRtlFindClearBits(&BitMapHeader, 64, Round);
+                        break;
+                    case 2:
+                        New ? RtlFindSetBits(&BitMapHeader, 64, Round) : OldRtlFindSetBits(&BitMapHeader, 64, Round);
+                        break;
+                    case 3:
+                        New ? RtlFindLongestRunClear(&BitMapHeader, &Index) : OldRtlFindLongestRunClear(&BitMapHeader, &Index);
+                        break;
+                }
+            }
+            Seconds[New] = (double)(clock() - Start) / CLOCKS_PER_SEC;
+        }
+
+        printf("%-24s old %8.1f Mbit/s, new %8.1f Mbit/s\n", Names[Function],
+               Seconds[0] > 0 ? 16.0 * Size / Seconds[0] / 1000000.0 : 0.0,
+               Seconds[1] > 0 ? 16.0 * Size / Seconds[1] / 1000000.0 : 0.0);
+    }
+
+    free(Buffer);
+}
+
+static VOID
+usage(VOID)
+{
+    printf("Usage: bitmaptest [-b] [iterations [seed]]\n\n"
+           "Compares the RTL bitmap functions with their old implementation\n"
+           "on random bitmaps. -b also times both on a 1 Mbit bitmap.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const ULONG RunLengths[] = { 1, 3, 16, 100, 1000 };
+    PULONG Buffer;
+    ULONG Iterations = 5000, Size, i;
+    BOOLEAN DoBenchmark = FALSE;
+    int Arg = 1;
+
+    if (Arg < argc && strcmp(argv[Arg], "-b") == 0)
+    {
+        DoBenchmark = TRUE;
+        Arg++;
+    }
+    if (Arg < argc)
+    {
+        Iterations = strtoul(argv[Arg++], NULL, 0);
+        if (Iterations == 0)
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (Arg < argc)
+        Seed = strtoul(argv[Arg++], NULL, 0) | 1;
+
+    Buffer = malloc(8192 / 8);
+    if (!Buffer)
+        return 1;
+
+    for (i = 0; i < Iterations; i++)
+    {
+        /* Mostly sizes that end in the middle of a ULONG, some that do not */
+        switch (i % 3)
+        {
+            case 0: Size = 1 + BitmapRandom() % 64; break;
+            case 1: Size = 1 + BitmapRandom() % 1024; break;
+            default: Size = 1 + BitmapRandom() % 8192; break;
+        }
+        if ((i % 8) == 0 && Size > 32)
+            Size &= ~31;
+
+        FillBitmap(Buffer, Size,
+                   RunLengths[BitmapRandom() % (sizeof(RunLengths) / sizeof(RunLengths[0]))],
+                   RunLengths[BitmapRandom() % (sizeof(RunLengths) / sizeof(RunLengths[0]))]);
+        CheckBitmap(Buffer, Size);
+    }
+
+    free(Buffer);
+
+    printf("%lu checks on %lu bitmaps, %lu where the old code was wrong, %lu failures\n",
+           (unsigned long)Checks, (unsigned long)Iterations,
+           (unsigned long)OldBugs, (unsigned long)Failures);
+
+    if (DoBenchmark)
+        Benchmark();
+
+    return Failures ? 1 : 0;
+}
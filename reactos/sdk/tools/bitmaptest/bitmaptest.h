@@ -0,0 +1,87 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS bitmap equivalence test
+ * FILE:            tools/bitmaptest/bitmaptest.h
+ * PURPOSE:         Host build of the RTL bitmap functions
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <typedefs.h>
+
+#if (!defined(_MSC_VER) || (_MSC_VER < 1500))
+#define _In_
+#define _Out_
+#define _In_opt_
+#define _In_range_(x, y)
+#endif
+
+#define __drv_aliasesMem
+
+#ifndef min
+#define min(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+
+unsigned char BitScanForward(ULONG * Index, unsigned long Mask);
+unsigned char BitScanReverse(ULONG * const Index, unsigned long Mask);
+#define RtlFillMemoryUlong(dst, len, val) memset(dst, val, len)
+
+#ifdef _M_AMD64
+#define BitScanForward64 _BitScanForward64
+#define BitScanReverse64 _BitScanReverse64
+#endif
+
+/* rtl.c: the bitmap functions of the RTL */
+VOID NTAPI
+RtlInitializeBitMap(
+    IN PRTL_BITMAP BitMapHeader,
+    IN PULONG BitMapBuffer,
+    IN ULONG SizeOfBitMap);
+
+ULONG NTAPI
+RtlNumberOfClearBits(
+    IN PRTL_BITMAP BitMapHeader);
+
+ULONG NTAPI
+RtlFindClearBits(
+    IN PRTL_BITMAP BitMapHeader,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex);
+
+ULONG NTAPI
+RtlFindSetBits(
+    IN PRTL_BITMAP BitMapHeader,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex);
+
+ULONG NTAPI
+RtlFindLongestRunClear(
+    IN PRTL_BITMAP BitMapHeader,
+    OUT PULONG StartingIndex);
+
+/* oldrtl.c: the same functions before they worked a word at a time */
+ULONG NTAPI
+OldRtlNumberOfClearBits(
+    IN PRTL_BITMAP BitMapHeader);
+
+ULONG NTAPI
+OldRtlFindClearBits(
+    IN PRTL_BITMAP BitMapHeader,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex);
+
+ULONG NTAPI
+OldRtlFindSetBits(
+    IN PRTL_BITMAP BitMapHeader,
+    IN ULONG NumberToFind,
+    IN ULONG HintIndex);
+
+ULONG NTAPI
+OldRtlFindLongestRunClear(
+    IN PRTL_BITMAP BitMapHeader,
+    OUT PULONG StartingIndex);
@@ -0,0 +1,43 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS bitmap equivalence test
+ * FILE:            tools/bitmaptest/oldrtl.c
+ * PURPOSE:         The bitmap functions as they were before they worked a
+ *                  word at a time, renamed so they link next to the new ones
+ */
+
+/* gcc defaults to cdecl */
+#if defined(__GNUC__)
+#undef __cdecl
+#define __cdecl
+#endif
+
+#include "bitmaptest.h"
+
+#define RtlFindMostSignificantBit OldRtlFindMostSignificantBit
+#define RtlFindLeastSignificantBit OldRtlFindLeastSignificantBit
+#define RtlInitializeBitMap OldRtlInitializeBitMap
+#define RtlClearAllBits OldRtlClearAllBits
+#define RtlSetAllBits OldRtlSetAllBits
+#define RtlClearBit OldRtlClearBit
+#define RtlSetBit OldRtlSetBit
+#define RtlClearBits OldRtlClearBits
+#define RtlSetBits OldRtlSetBits
+#define RtlTestBit OldRtlTestBit
+#define RtlAreBitsClear OldRtlAreBitsClear
+#define RtlAreBitsSet OldRtlAreBitsSet
+#define RtlNumberOfSetBits OldRtlNumberOfSetBits
+#define RtlNumberOfClearBits OldRtlNumberOfClearBits
+#define RtlFindClearBits OldRtlFindClearBits
+#define RtlFindSetBits OldRtlFindSetBits
+#define RtlFindClearBitsAndSet OldRtlFindClearBitsAndSet
+#define RtlFindSetBitsAndClear OldRtlFindSetBitsAndClear
+#define RtlFindNextForwardRunClear OldRtlFindNextForwardRunClear
+#define RtlFindNextForwardRunSet OldRtlFindNextForwardRunSet
+#define RtlFindFirstRunClear OldRtlFindFirstRunClear
+#define RtlFindLastBackwardRunClear OldRtlFindLastBackwardRunClear
+#define RtlFindClearRuns OldRtlFindClearRuns
+#define RtlFindLongestRunClear OldRtlFindLongestRunClear
+#define RtlFindLongestRunSet OldRtlFindLongestRunSet
+
+#include "oldbitmap.c"
@@ -0,0 +1,39 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS bitmap equivalence test
+ * FILE:            tools/bitmaptest/rtl.c
+ * PURPOSE:         Runtime Library
+ */
+
+/* gcc defaults to cdecl */
+#if defined(__GNUC__)
+#undef __cdecl
+#define __cdecl
+#endif
+
+#include "bitmaptest.h"
+#include <bitmap.c>
+
+unsigned char BitScanForward(ULONG * Index, unsigned long Mask)
+{
+    *Index = 0;
+    while (Mask && ((Mask & 1) == 0))
+    {
+        Mask >>= 1;
+        ++(*Index);
+    }
+    return Mask ? 1 : 0;
+}
+
+unsigned char BitScanReverse(ULONG * const Index, unsigned long Mask)
+{
+    /* Only the low 32 bits are scanned, like the compiler intrinsic */
+    Mask &= 0xFFFFFFFF;
+    *Index = 0;
+    if (!Mask)
+        return 0;
+
+    while (Mask >>= 1)
+        ++(*Index);
+    return 1;
+}
@@ -0,0 +1,325 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS hive log replay test
+ * FILE:            tools/hivelog/hivelog.c
+ * PURPOSE:         Interrupts a hive sync, then loads the hive back from its log
+ */
+
+#include "hivelog.h"
+
+#define CELL_COUNT          64
+#define GROWN_CELL_COUNT    16
+
+/* A file kept in memory. Once WritesLeft drops to 0, writes tear and fail */
+typedef struct _MEMORY_FILE
+{
+    PUCHAR Data;
+    ULONG Size;
+    LONG WritesLeft;
+} MEMORY_FILE, *PMEMORY_FILE;
+
+typedef struct _TEST_HIVE
+{
+    HHIVE Hive;
+    PMEMORY_FILE Files;
+} TEST_HIVE, *PTEST_HIVE;
+
+static MEMORY_FILE Files[HFILE_TYPE_MAX];
+static HCELL_INDEX Cells[CELL_COUNT + GROWN_CELL_COUNT];
+static UCHAR Generations[CELL_COUNT + GROWN_CELL_COUNT];
+static ULONG Failures;
+
+#define CHECK(Condition, ...)       \
+do {                                \
+    if (!(Condition))               \
+    {                               \
+        printf(__VA_ARGS__);        \
+        Failures++;                 \
+    }                               \
+} while (0)
+
+PVOID
+NTAPI
+CmpAllocate(
+    IN SIZE_T Size,
+    IN BOOLEAN Paged,
+    IN ULONG Tag)
+{
+    return (PVOID)malloc((size_t)Size);
+}
+
+VOID
+NTAPI
+CmpFree(
+    IN PVOID Ptr,
+    IN ULONG Quota)
+{
+    free(Ptr);
+}
+
+static BOOLEAN
+NTAPI
+MemoryFileRead(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    OUT PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    PMEMORY_FILE File = &((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    if (*FileOffset > File->Size || BufferLength > File->Size - *FileOffset)
+        return FALSE;
+
+    memcpy(Buffer, File->Data + *FileOffset, BufferLength);
+    return TRUE;
+}
+
+static BOOLEAN
+NTAPI
+MemoryFileSetSize(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN ULONG FileSize,
+    IN ULONG OldFileSize)
+{
+    PMEMORY_FILE File = &((PTEST_HIVE)RegistryHive)->Files[FileType];
+    PUCHAR Data;
+
+    if (FileSize > File->Size)
+    {
+        Data = realloc(File->Data, FileSize);
+        if (!Data)
+            return FALSE;
+        memset(Data + File->Size, 0, FileSize - File->Size);
+        File->Data = Data;
+    }
+
+    File->Size = FileSize;
+    return TRUE;
+}
+
+static BOOLEAN
+NTAPI
+MemoryFileWrite(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    IN PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    PMEMORY_FILE File = &((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    if (*FileOffset + BufferLength > File->Size &&
+        !MemoryFileSetSize(RegistryHive, FileType, *FileOffset + (ULONG)BufferLength, File->Size))
+    {
+        return FALSE;
+    }
+
+    /* The power went out in the middle of this one */
+    if (File->WritesLeft == 0)
+    {
+        memset(File->Data + *FileOffset, 0xCC, BufferLength / 2);
+        return FALSE;
+    }
+    if (File->WritesLeft > 0)
+        File->WritesLeft--;
+
+    memcpy(File->Data + *FileOffset, Buffer, BufferLength);
+    return TRUE;
+}
+
+static BOOLEAN
+NTAPI
+MemoryFileFlush(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    PLARGE_INTEGER FileOffset,
+    ULONG Length)
+{
+    return TRUE;
+}
+
+static NTSTATUS
+InitializeTestHive(
+    OUT PTEST_HIVE TestHive,
+    IN ULONG OperationType,
+    IN ULONG FileType)
+{
+    memset(TestHive, 0, sizeof(*TestHive));
+    TestHive->Files = Files;
+
+    return HvInitialize(&TestHive->Hive,
+                        OperationType,
+                        0,
+                        FileType,
+                        NULL,
+                        CmpAllocate,
+                        CmpFree,
+                        MemoryFileSetSize,
+                        MemoryFileWrite,
+                        MemoryFileRead,
+                        MemoryFileFlush,
+                        1,
+                        NULL);
+}
+
+static ULONG
+CellSize(
+    IN ULONG Index)
+{
+    /* A mix of small cells and cells of a few blocks */
+    return (Index % 8) ? 16 + Index * 37 % 700 : 5000 + Index * 101;
+}
+
+static VOID
+FillCell(
+    IN PHHIVE Hive,
+    IN ULONG Index,
+    IN UCHAR Generation)
+{
+    PUCHAR Data = HvGetCell(Hive, Cells[Index]);
+    ULONG i;
+
+    for (i = 0; i < CellSize(Index); i++)
+        Data[i] = (UCHAR)(Index * 7 + i + Generation * 0x55);
+
+    HvReleaseCell(Hive, Cells[Index]);
+    Generations[Index] = Generation;
+}
+
+static VOID
+CheckCells(
+    IN PHHIVE Hive,
+    IN ULONG Count,
+    IN PCSTR Step)
+{
+    PUCHAR Data;
+    ULONG Index, i;
+
+    for (Index = 0; Index < Count; Index++)
+    {
+        Data = HvGetCell(Hive, Cells[Index]);
+        for (i = 0; i < CellSize(Index); i++)
+        {
+            if (Data[i] != (UCHAR)(Index * 7 + i + Generations[Index] * 0x55))
+                break;
+        }
+        HvReleaseCell(Hive, Cells[Index]);
+
+        CHECK(i == CellSize(Index),
+              "%s: cell %lu (0x%lx) differs at byte %lu\n",
+              Step, (unsigned long)Index, (unsigned long)Cells[Index], (unsigned long)i);
+    }
+}
+
+static BOOLEAN
+SequenceMatches(VOID)
+{
+    PHBASE_BLOCK BaseBlock = (PHBASE_BLOCK)Files[HFILE_TYPE_PRIMARY].Data;
+
+    return BaseBlock->Sequence1 == BaseBlock->Sequence2;
+}
+
+int main(int argc, char *argv[])
+{
+    TEST_HIVE TestHive, Loaded;
+    NTSTATUS Status;
+    PUCHAR LogCopy;
+    ULONG Index, LogSize, PrimarySize;
+
+    Files[HFILE_TYPE_PRIMARY].WritesLeft = -1;
+    Files[HFILE_TYPE_LOG].WritesLeft = -1;
+
+    /* Build a hive and sync it cleanly */
+    Status = InitializeTestHive(&TestHive, HINIT_CREATE, HFILE_TYPE_LOG);
+    if (!NT_SUCCESS(Status) || !CmCreateRootNode(&TestHive.Hive, L"HIVELOG"))
+    {
+        printf("Could not create the hive (Status 0x%08lx)\n", (unsigned long)Status);
+        return 1;
+    }
+
+    for (Index = 0; Index < CELL_COUNT; Index++)
+    {
+        Cells[Index] = HvAllocateCell(&TestHive.Hive, CellSize(Index), Stable, HCELL_NIL);
+        if (Cells[Index] == HCELL_NIL)
+        {
+            printf("Could not allocate cell %lu\n", (unsigned long)Index);
+            return 1;
+        }
+        FillCell(&TestHive.Hive, Index, 1);
+    }
+
+    CHECK(HvSyncHive(&TestHive.Hive), "The first sync failed\n");
+    CHECK(SequenceMatches(), "The first sync left the sequence numbers apart\n");
+    PrimarySize = Files[HFILE_TYPE_PRIMARY].Size;
+
+    /* Change every other cell, and grow the hive past what its file has */
+    for (Index = 0; Index < CELL_COUNT; Index += 2)
+    {
+        HvMarkCellDirty(&TestHive.Hive, Cells[Index], FALSE);
+        FillCell(&TestHive.Hive, Index, 2);
+    }
+    for (Index = CELL_COUNT; Index < CELL_COUNT + GROWN_CELL_COUNT; Index++)
+    {
+        Cells[Index] = HvAllocateCell(&TestHive.Hive, CellSize(Index), Stable, HCELL_NIL);
+        if (Cells[Index] == HCELL_NIL)
+        {
+            printf("Could not allocate cell %lu\n", (unsigned long)Index);
+            return 1;
+        }
+        FillCell(&TestHive.Hive, Index, 2);
+    }
+    CHECK(TestHive.Hive.BaseBlock->Length + HBLOCK_SIZE > PrimarySize, "The hive did not grow\n");
+
+    /* Interrupt the update of the hive file after its header went out */
+    Files[HFILE_TYPE_PRIMARY].WritesLeft = 1;
+    CHECK(!HvSyncHive(&TestHive.Hive), "The interrupted sync succeeded\n");
+    CHECK(!SequenceMatches(), "The interrupted sync left matching sequence numbers\n");
+    Files[HFILE_TYPE_PRIMARY].WritesLeft = -1;
+    HvFree(&TestHive.Hive);
+
+    /* Without the log the hive can't be trusted */
+    Status = InitializeTestHive(&Loaded, HINIT_FILE, HFILE_TYPE_PRIMARY);
+    CHECK(Status == STATUS_NOT_REGISTRY_FILE, "Loading without the log returned 0x%08lx\n", (unsigned long)Status);
+
+    /* Neither with a log that was damaged */
+    LogSize = Files[HFILE_TYPE_LOG].Size;
+    LogCopy = malloc(LogSize);
+    if (!LogCopy)
+        return 1;
+    memcpy(LogCopy, Files[HFILE_TYPE_LOG].Data, LogSize);
+    ((PHBASE_BLOCK)Files[HFILE_TYPE_LOG].Data)->Length++;
+    Status = InitializeTestHive(&Loaded, HINIT_FILE, HFILE_TYPE_LOG);
+    CHECK(Status == STATUS_REGISTRY_CORRUPT, "Loading with a damaged log returned 0x%08lx\n", (unsigned long)Status);
+    memcpy(Files[HFILE_TYPE_LOG].Data, LogCopy, LogSize);
+    free(LogCopy);
+
+    /* With the log, every change comes back */
+    Status = InitializeTestHive(&Loaded, HINIT_FILE, HFILE_TYPE_LOG);
+    CHECK(Status == STATUS_SUCCESS, "Recovering from the log returned 0x%08lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        CheckCells(&Loaded.Hive, CELL_COUNT + GROWN_CELL_COUNT, "Recovered");
+        CHECK(Loaded.Hive.DirtyCount != 0, "Nothing replayed is dirty\n");
+
+        /* And the next sync repairs the hive file */
+        CHECK(HvSyncHive(&Loaded.Hive), "The sync after the recovery failed\n");
+        HvFree(&Loaded.Hive);
+
+        CHECK(SequenceMatches(), "The repaired hive has its sequence numbers apart\n");
+        Status = InitializeTestHive(&Loaded, HINIT_FILE, HFILE_TYPE_PRIMARY);
+        CHECK(Status == STATUS_SUCCESS, "Loading the repaired hive returned 0x%08lx\n", (unsigned long)Status);
+        if (NT_SUCCESS(Status))
+        {
+            CheckCells(&Loaded.Hive, CELL_COUNT + GROWN_CELL_COUNT, "Repaired");
+            HvFree(&Loaded.Hive);
+        }
+    }
+
+    free(Files[HFILE_TYPE_PRIMARY].Data);
+    free(Files[HFILE_TYPE_LOG].Data);
+
+    printf("Hive log replay: %lu failures\n", (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS hive log replay test
+ * FILE:            tools/hivelog/hivelog.h
+ * PURPOSE:         Host build of the hive library
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <typedefs.h>
+
+unsigned char BitScanForward(ULONG * Index, unsigned long Mask);
+unsigned char BitScanReverse(ULONG * const Index, unsigned long Mask);
+#define RtlFillMemoryUlong(dst, len, val) memset(dst, val, len)
+
+#ifdef _M_AMD64
+#define BitScanForward64 _BitScanForward64
+#define BitScanReverse64 _BitScanReverse64
+#endif
+
+VOID NTAPI
+RtlInitUnicodeString(
+    IN OUT PUNICODE_STRING DestinationString,
+    IN PCWSTR SourceString);
+WCHAR NTAPI
+RtlUpcaseUnicodeChar(
+    IN WCHAR Source);
+
+#define CMLIB_HOST
+#include <cmlib.h>
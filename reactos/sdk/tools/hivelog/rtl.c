@@ -0,0 +1,127 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS hive log replay test
+ * FILE:            tools/hivelog/rtl.c
+ * PURPOSE:         Runtime Library
+ */
+
+#include <stdlib.h>
+#include <stdarg.h>
+
+/* gcc defaults to cdecl */
+#if defined(__GNUC__)
+#undef __cdecl
+#define __cdecl
+#endif
+
+#include "hivelog.h"
+#include <bitmap.c>
+
+VOID NTAPI
+RtlInitUnicodeString(
+    IN OUT PUNICODE_STRING DestinationString,
+    IN PCWSTR SourceString)
+{
+    SIZE_T DestSize;
+
+    if (SourceString)
+    {
+        DestSize = strlenW(SourceString) * sizeof(WCHAR);
+        DestinationString->Length = (USHORT)DestSize;
+        DestinationString->MaximumLength = (USHORT)DestSize + sizeof(WCHAR);
+    }
+    else
+    {
+        DestinationString->Length = 0;
+        DestinationString->MaximumLength = 0;
+    }
+
+    DestinationString->Buffer = (PWCHAR)SourceString;
+}
+
+LONG NTAPI
+RtlCompareUnicodeString(
+    IN PCUNICODE_STRING String1,
+    IN PCUNICODE_STRING String2,
+    IN BOOLEAN CaseInSensitive)
+{
+    USHORT i;
+    WCHAR c1, c2;
+
+    for (i = 0; i <= String1->Length / sizeof(WCHAR) && i <= String2->Length / sizeof(WCHAR); i++)
+    {
+        if (CaseInSensitive)
+        {
+            c1 = RtlUpcaseUnicodeChar(String1->Buffer[i]);
+            c2 = RtlUpcaseUnicodeChar(String2->Buffer[i]);
+        }
+        else
+        {
+            c1 = String1->Buffer[i];
+            c2 = String2->Buffer[i];
+        }
+
+        if (c1 < c2)
+            return -1;
+        else if (c1 > c2)
+            return 1;
+    }
+
+    return 0;
+}
+
+WCHAR NTAPI
+RtlUpcaseUnicodeChar(
+    IN WCHAR Source)
+{
+    if (Source >= 'a' && Source <= 'z')
+        return (Source - ('a' - 'A'));
+
+    return Source;
+}
+
+VOID NTAPI
+KeQuerySystemTime(
+    OUT PLARGE_INTEGER CurrentTime)
+{
+    CurrentTime->QuadPart = 0;
+}
+
+VOID
+NTAPI
+KeBugCheckEx(
+    IN ULONG BugCheckCode,
+    IN ULONG_PTR BugCheckParameter1,
+    IN ULONG_PTR BugCheckParameter2,
+    IN ULONG_PTR BugCheckParameter3,
+    IN ULONG_PTR BugCheckParameter4)
+{
+    printf("*** STOP: 0x%08X (0x%08lX, 0x%08lX, 0x%08lX, 0x%08lX)\n",
+           BugCheckCode, BugCheckParameter1, BugCheckParameter2,
+           BugCheckParameter3, BugCheckParameter4);
+    exit(2);
+}
+
+unsigned char BitScanForward(ULONG * Index, unsigned long Mask)
+{
+    *Index = 0;
+    while (Mask && ((Mask & 1) == 0))
+    {
+        Mask >>= 1;
+        ++(*Index);
+    }
+    return Mask ? 1 : 0;
+}
+
+unsigned char BitScanReverse(ULONG * const Index, unsigned long Mask)
+{
+    /* Only the low 32 bits are scanned, like the compiler intrinsic */
+    Mask &= 0xFFFFFFFF;
+    *Index = 0;
+    if (!Mask)
+        return 0;
+
+    while (Mask >>= 1)
+        ++(*Index);
+    return 1;
+}
@@ -27,6 +27,7 @@
 /* INCLUDES *****************************************************************/
 
 #include <stdio.h>
+#include <time.h>
 
 #include "mkhive.h"
 
@@ -37,9 +38,20 @@ ExportBinaryHive(
 {
     FILE *File;
     BOOL ret;
+    clock_t Start;
+    NTSTATUS Status;
 
     printf ("  Creating binary hive: %s\n", FileName);
 
+    /* Lay out all the keys and values that were collected for this hive */
+    Start = clock();
+    Status = CmiBuildHive(Hive, RegGetHiveRootKey(Hive));
+    if (!NT_SUCCESS(Status))
+    {
+        printf("    Error building the hive (Status 0x%08x)\n", (unsigned int)Status);
+        return FALSE;
+    }
+
     /* Create new hive file */
     File = fopen (FileName, "w+b");
     if (File == NULL)
@@ -53,6 +65,10 @@ ExportBinaryHive(
     Hive->FileHandles[HFILE_TYPE_PRIMARY] = (HANDLE)File;
     ret = HvWriteHive(&Hive->Hive);
     fclose (File);
+
+    printf ("    %lu bytes in %lu ms\n",
+            (unsigned long)(Hive->Hive.Storage[Stable].Length + 1) * HBLOCK_SIZE,
+            (unsigned long)((clock() - Start) * 1000 / CLOCKS_PER_SEC));
     return ret;
 }
 
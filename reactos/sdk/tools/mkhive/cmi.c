@@ -284,165 +284,325 @@ CmiCreateSubKey(
     return STATUS_SUCCESS;
 }
 
-NTSTATUS
-CmiAddSubKey(
-    IN PCMHIVE RegistryHive,
-    IN HCELL_INDEX ParentKeyCellOffset,
-    IN PCUNICODE_STRING SubKeyName,
-    IN BOOLEAN VolatileKey,
-    OUT HCELL_INDEX *pBlockOffset)
+/* Most entries a fast leaf can hold without needing more than a block */
+#define CMI_MAX_FAST_LEAF_ENTRIES                       \
+    ((HBLOCK_SIZE - (sizeof(HBIN) + sizeof(HCELL) +     \
+                     FIELD_OFFSET(CM_KEY_FAST_INDEX, List))) / sizeof(CM_INDEX))
+
+static int
+CmiCompareKeys(
+    const void *Key1,
+    const void *Key2)
 {
-    PCM_KEY_NODE ParentKeyCell;
-    HCELL_INDEX NKBOffset;
-    NTSTATUS Status;
-
-    /* Create the new key */
-    Status = CmiCreateSubKey(RegistryHive, ParentKeyCellOffset, SubKeyName, VolatileKey, &NKBOffset);
-    if (!NT_SUCCESS(Status))
-        return Status;
-
-    /* Mark the parent cell as dirty */
-    HvMarkCellDirty(&RegistryHive->Hive, ParentKeyCellOffset, FALSE);
-
-    if (!CmpAddSubKey(&RegistryHive->Hive, ParentKeyCellOffset, NKBOffset))
-    {
-        /* FIXME: delete newly created cell */
-        // CmpFreeKeyByCell(&RegistryHive->Hive, NewCell /*NKBOffset*/, FALSE);
-        ASSERT(FALSE);
-        return STATUS_UNSUCCESSFUL;
-    }
-
-    /* Get the parent node */
-    ParentKeyCell = (PCM_KEY_NODE)HvGetCell(&RegistryHive->Hive, ParentKeyCellOffset);
-    if (!ParentKeyCell)
+    PCUNICODE_STRING Name1 = &(*(PMEMKEY*)Key1)->Name.Name;
+    PCUNICODE_STRING Name2 = &(*(PMEMKEY*)Key2)->Name.Name;
+    USHORT i, Length;
+    WCHAR Char1, Char2;
+
+    /* Same order as CmpCompareInIndex expects in the index */
+    Length = min(Name1->Length, Name2->Length) / sizeof(WCHAR);
+    for (i = 0; i < Length; i++)
     {
-        /* FIXME: delete newly created cell */
-        return STATUS_UNSUCCESSFUL;
+        Char1 = RtlUpcaseUnicodeChar(Name1->Buffer[i]);
+        Char2 = RtlUpcaseUnicodeChar(Name2->Buffer[i]);
+        if (Char1 != Char2)
+            return (Char1 < Char2) ? -1 : 1;
     }
-    VERIFY_KEY_CELL(ParentKeyCell);
 
-    /* Update the timestamp */
-    KeQuerySystemTime(&ParentKeyCell->LastWriteTime);
-
-    /* Check if we need to update name maximum, update it if so */
-    if (ParentKeyCell->MaxNameLen < SubKeyName->Length)
-        ParentKeyCell->MaxNameLen = SubKeyName->Length;
-
-    /* Release the cell */
-    HvReleaseCell(&RegistryHive->Hive, ParentKeyCellOffset);
-
-    *pBlockOffset = NKBOffset;
-    return STATUS_SUCCESS;
+    return (int)Name1->Length - (int)Name2->Length;
 }
 
-NTSTATUS
-CmiAddValueKey(
+static NTSTATUS
+CmiBuildValues(
     IN PCMHIVE RegistryHive,
-    IN PCM_KEY_NODE Parent,
-    IN PCUNICODE_STRING ValueName,
-    OUT PCM_KEY_VALUE *pValueCell,
-    OUT HCELL_INDEX *pValueCellOffset)
+    IN HCELL_INDEX KeyCellOffset,
+    IN PMEMKEY Key)
 {
+    PHHIVE Hive = &RegistryHive->Hive;
+    PCM_KEY_NODE KeyCell;
     PCELL_DATA ValueListCell;
-    PCM_KEY_VALUE NewValueCell;
+    PCM_KEY_VALUE ValueCell;
     HCELL_INDEX ValueListCellOffset;
-    HCELL_INDEX NewValueCellOffset;
-    ULONG CellSize;
-    HSTORAGE_TYPE Storage;
-
-#ifndef FIELD_SIZE
-#define FIELD_SIZE(type, field) (sizeof(((type *)0)->field))
-#endif
+    HCELL_INDEX ValueCellOffset;
+    HCELL_INDEX DataCellOffset;
+    PMEMVALUE Value;
+    ULONG MaxValueNameLen = 0, MaxValueDataLen = 0;
+    ULONG i;
+
+    if (!Key->Values.Count)
+        return STATUS_SUCCESS;
+
+    /* The value list gets exactly the size it needs */
+    ValueListCellOffset = HvAllocateCell(Hive,
+                                         Key->Values.Count * sizeof(HCELL_INDEX),
+                                         Stable,
+                                         HCELL_NIL);
+    if (ValueListCellOffset == HCELL_NIL)
+        return STATUS_INSUFFICIENT_RESOURCES;
 
-    Storage = (Parent->Flags & KEY_IS_VOLATILE) ? Volatile : Stable;
-    if (Parent->ValueList.List == HCELL_NIL)
+    for (Value = Key->FirstValue, i = 0; Value != NULL; Value = Value->Next, i++)
     {
-        /* Allocate some room for the value list */
-        CellSize = FIELD_SIZE(CELL_DATA, u.KeyList) + (3 * sizeof(HCELL_INDEX));
-        ValueListCellOffset = HvAllocateCell(&RegistryHive->Hive, CellSize, Storage, HCELL_NIL);
-        if (ValueListCellOffset == HCELL_NIL)
+        ValueCellOffset = HvAllocateCell(Hive,
+                                         FIELD_OFFSET(CM_KEY_VALUE, Name) +
+                                         CmpNameSize(Hive, &Value->Name.Name),
+                                         Stable,
+                                         HCELL_NIL);
+        if (ValueCellOffset == HCELL_NIL)
             return STATUS_INSUFFICIENT_RESOURCES;
 
-        ValueListCell = (PCELL_DATA)HvGetCell(&RegistryHive->Hive, ValueListCellOffset);
-        if (!ValueListCell)
+        DataCellOffset = HCELL_NIL;
+        if (Value->DataSize > sizeof(HCELL_INDEX))
         {
-            HvFreeCell(&RegistryHive->Hive, ValueListCellOffset);
-            return STATUS_UNSUCCESSFUL;
+            DataCellOffset = HvAllocateCell(Hive, Value->DataSize, Stable, HCELL_NIL);
+            if (DataCellOffset == HCELL_NIL)
+                return STATUS_INSUFFICIENT_RESOURCES;
+
+            RtlCopyMemory(HvGetCell(Hive, DataCellOffset), Value->Data, Value->DataSize);
+            HvReleaseCell(Hive, DataCellOffset);
         }
 
-        Parent->ValueList.List = ValueListCellOffset;
-    }
-    else
-    {
-        ValueListCell = (PCELL_DATA)HvGetCell(&RegistryHive->Hive, Parent->ValueList.List);
-        if (!ValueListCell)
-            return STATUS_UNSUCCESSFUL;
+        ValueCell = (PCM_KEY_VALUE)HvGetCell(Hive, ValueCellOffset);
+        ValueCell->Signature = CM_KEY_VALUE_SIGNATURE;
+        ValueCell->NameLength = CmpCopyName(Hive,
+                                            ValueCell->Name,
+                                            &Value->Name.Name);
 
-        CellSize = ABS_VALUE(HvGetCellSize(&RegistryHive->Hive, ValueListCell));
+        /* Check for compressed name */
+        if (ValueCell->NameLength < Value->Name.Name.Length)
+        {
+            /* This is a compressed name */
+            ValueCell->Flags = VALUE_COMP_NAME;
+        }
+        else
+        {
+            /* No flags to set */
+            ValueCell->Flags = 0;
+        }
 
-        if (Parent->ValueList.Count >= CellSize / sizeof(HCELL_INDEX))
+        ValueCell->Type = Value->Type;
+        if (DataCellOffset == HCELL_NIL)
         {
-            CellSize *= 2;
-            ValueListCellOffset = HvReallocateCell(&RegistryHive->Hive, Parent->ValueList.List, CellSize);
-            if (ValueListCellOffset == HCELL_NIL)
-                return STATUS_INSUFFICIENT_RESOURCES;
+            /* If data size <= sizeof(HCELL_INDEX) then store data in the data offset */
+            ValueCell->Data = 0;
+            RtlCopyMemory(&ValueCell->Data, Value->Data, Value->DataSize);
+            ValueCell->DataLength = (Value->DataSize | CM_KEY_VALUE_SPECIAL_SIZE);
+        }
+        else
+        {
+            ValueCell->Data = DataCellOffset;
+            ValueCell->DataLength = Value->DataSize;
+        }
+        HvReleaseCell(Hive, ValueCellOffset);
 
-            ValueListCell = (PCELL_DATA)HvGetCell(&RegistryHive->Hive, ValueListCellOffset);
-            if (!ValueListCell)
-                return STATUS_UNSUCCESSFUL;
+        ValueListCell = (PCELL_DATA)HvGetCell(Hive, ValueListCellOffset);
+        ValueListCell->u.KeyList[i] = ValueCellOffset;
+        HvReleaseCell(Hive, ValueListCellOffset);
 
-            Parent->ValueList.List = ValueListCellOffset;
-        }
+        /* Update the maximum value name and data lengths */
+        if (MaxValueNameLen < Value->Name.Name.Length)
+            MaxValueNameLen = Value->Name.Name.Length;
+        if (MaxValueDataLen < Value->DataSize)
+            MaxValueDataLen = Value->DataSize;
     }
 
+    KeyCell = (PCM_KEY_NODE)HvGetCell(Hive, KeyCellOffset);
+    KeyCell->ValueList.List = ValueListCellOffset;
+    KeyCell->ValueList.Count = i;
+    KeyCell->MaxValueNameLen = MaxValueNameLen;
+    KeyCell->MaxValueDataLen = MaxValueDataLen;
+    HvReleaseCell(Hive, KeyCellOffset);
 
-    NewValueCellOffset = HvAllocateCell(&RegistryHive->Hive,
-                               FIELD_OFFSET(CM_KEY_VALUE, Name) +
-                               CmpNameSize(&RegistryHive->Hive, (PUNICODE_STRING)ValueName),
-                               Storage,
-                               HCELL_NIL);
-    if (NewValueCellOffset == HCELL_NIL)
+    return STATUS_SUCCESS;
+}
+
+static HCELL_INDEX
+CmiBuildFastLeaf(
+    IN PHHIVE Hive,
+    IN PMEMKEY *SubKeys,
+    IN PHCELL_INDEX SubKeyCells,
+    IN ULONG Count)
+{
+    PCM_KEY_FAST_INDEX Leaf;
+    HCELL_INDEX LeafCell;
+    PUNICODE_STRING Name;
+    ULONG i, j;
+
+    LeafCell = HvAllocateCell(Hive,
+                              FIELD_OFFSET(CM_KEY_FAST_INDEX, List) +
+                              Count * sizeof(CM_INDEX),
+                              Stable,
+                              HCELL_NIL);
+    if (LeafCell == HCELL_NIL)
+        return HCELL_NIL;
+
+    /*
+     * The subkeys are already sorted. Hash leaves would need a version 1.5
+     * hive, and cmlib still treats the values of those as big values.
+     */
+    Leaf = (PCM_KEY_FAST_INDEX)HvGetCell(Hive, LeafCell);
+    Leaf->Signature = CM_KEY_FAST_LEAF;
+    Leaf->Count = (USHORT)Count;
+    for (i = 0; i < Count; i++)
     {
-        return STATUS_INSUFFICIENT_RESOURCES;
+        Leaf->List[i].Cell = SubKeyCells[i];
+
+        /* The hint is the start of the name, up to the first character that doesn't fit */
+        Name = &SubKeys[i]->Name.Name;
+        RtlZeroMemory(Leaf->List[i].NameHint, sizeof(Leaf->List[i].NameHint));
+        for (j = 0; j < 4 && j < Name->Length / sizeof(WCHAR); j++)
+        {
+            if ((USHORT)Name->Buffer[j] > (UCHAR)-1)
+                break;
+            Leaf->List[i].NameHint[j] = (UCHAR)Name->Buffer[j];
+        }
     }
+    HvReleaseCell(Hive, LeafCell);
+
+    return LeafCell;
+}
 
-    NewValueCell = (PCM_KEY_VALUE)HvGetCell(&RegistryHive->Hive, NewValueCellOffset);
-    if (NewValueCell == NULL)
+static HCELL_INDEX
+CmiBuildIndex(
+    IN PHHIVE Hive,
+    IN PMEMKEY *SubKeys,
+    IN PHCELL_INDEX SubKeyCells,
+    IN ULONG Count)
+{
+    PCM_KEY_INDEX Root;
+    HCELL_INDEX RootCell, LeafCell;
+    ULONG Leaves, PerLeaf, i;
+
+    /* A single leaf if it fits */
+    if (Count <= CMI_MAX_FAST_LEAF_ENTRIES)
+        return CmiBuildFastLeaf(Hive, SubKeys, SubKeyCells, Count);
+
+    /* Otherwise, spread the subkeys evenly over leaves below a root index */
+    Leaves = (Count + CMI_MAX_FAST_LEAF_ENTRIES - 1) / CMI_MAX_FAST_LEAF_ENTRIES;
+    PerLeaf = (Count + Leaves - 1) / Leaves;
+
+    RootCell = HvAllocateCell(Hive,
+                              FIELD_OFFSET(CM_KEY_INDEX, List) +
+                              Leaves * sizeof(HCELL_INDEX),
+                              Stable,
+                              HCELL_NIL);
+    if (RootCell == HCELL_NIL)
+        return HCELL_NIL;
+
+    for (i = 0; i < Leaves; i++)
     {
-        HvFreeCell(&RegistryHive->Hive, NewValueCellOffset);
-        return STATUS_INSUFFICIENT_RESOURCES;
+        LeafCell = CmiBuildFastLeaf(Hive,
+                                    SubKeys + i * PerLeaf,
+                                    SubKeyCells + i * PerLeaf,
+                                    min(PerLeaf, Count - i * PerLeaf));
+        if (LeafCell == HCELL_NIL)
+            return HCELL_NIL;
+
+        Root = (PCM_KEY_INDEX)HvGetCell(Hive, RootCell);
+        Root->List[i] = LeafCell;
+        HvReleaseCell(Hive, RootCell);
     }
 
-    NewValueCell->Signature = CM_KEY_VALUE_SIGNATURE;
-    NewValueCell->NameLength = CmpCopyName(&RegistryHive->Hive,
-                                           NewValueCell->Name,
-                                           (PUNICODE_STRING)ValueName);
+    Root = (PCM_KEY_INDEX)HvGetCell(Hive, RootCell);
+    Root->Signature = CM_KEY_INDEX_ROOT;
+    Root->Count = (USHORT)Leaves;
+    HvReleaseCell(Hive, RootCell);
+
+    return RootCell;
+}
+
+static NTSTATUS
+CmiBuildKey(
+    IN PCMHIVE RegistryHive,
+    IN HCELL_INDEX KeyCellOffset,
+    IN PMEMKEY Key)
+{
+    PHHIVE Hive = &RegistryHive->Hive;
+    PCM_KEY_NODE KeyCell;
+    PMEMKEY *SubKeys = NULL;
+    PHCELL_INDEX SubKeyCells = NULL;
+    HCELL_INDEX IndexCell;
+    PMEMNAME Entry;
+    ULONG Count, MaxNameLen, i;
+    NTSTATUS Status;
+
+    Status = CmiBuildValues(RegistryHive, KeyCellOffset, Key);
+    if (!NT_SUCCESS(Status) || !Key->SubKeys.Count)
+        return Status;
 
-    /* Check for compressed name */
-    if (NewValueCell->NameLength < ValueName->Length)
+    SubKeys = (PMEMKEY*)malloc(Key->SubKeys.Count * sizeof(PMEMKEY));
+    SubKeyCells = (PHCELL_INDEX)malloc(Key->SubKeys.Count * sizeof(HCELL_INDEX));
+    if (!SubKeys || !SubKeyCells)
     {
-        /* This is a compressed name */
-        NewValueCell->Flags = VALUE_COMP_NAME;
+        Status = STATUS_NO_MEMORY;
+        goto Quit;
     }
-    else
+
+    /* Volatile keys are not saved */
+    Count = 0;
+    for (i = 0; i < Key->SubKeys.Size; i++)
     {
-        /* No flags to set */
-        NewValueCell->Flags = 0;
+        for (Entry = Key->SubKeys.Buckets[i]; Entry != NULL; Entry = Entry->HashNext)
+        {
+            if (!CONTAINING_RECORD(Entry, MEMKEY, Name)->Volatile)
+                SubKeys[Count++] = CONTAINING_RECORD(Entry, MEMKEY, Name);
+        }
     }
 
-    NewValueCell->Type = 0;
-    NewValueCell->DataLength = 0;
-    NewValueCell->Data = HCELL_NIL;
+    if (!Count)
+        goto Quit;
+
+    qsort(SubKeys, Count, sizeof(PMEMKEY), CmiCompareKeys);
+
+    /* Lay out the subkey cells next to each other, followed by their index */
+    MaxNameLen = 0;
+    for (i = 0; i < Count; i++)
+    {
+        Status = CmiCreateSubKey(RegistryHive,
+                                 KeyCellOffset,
+                                 &SubKeys[i]->Name.Name,
+                                 FALSE,
+                                 &SubKeyCells[i]);
+        if (!NT_SUCCESS(Status))
+            goto Quit;
+
+        if (MaxNameLen < SubKeys[i]->Name.Name.Length)
+            MaxNameLen = SubKeys[i]->Name.Name.Length;
+    }
 
+    IndexCell = CmiBuildIndex(Hive, SubKeys, SubKeyCells, Count);
+    if (IndexCell == HCELL_NIL)
+    {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Quit;
+    }
 
-    ValueListCell->u.KeyList[Parent->ValueList.Count] = NewValueCellOffset;
-    Parent->ValueList.Count++;
+    KeyCell = (PCM_KEY_NODE)HvGetCell(Hive, KeyCellOffset);
+    KeyCell->SubKeyLists[Stable] = IndexCell;
+    KeyCell->SubKeyCounts[Stable] = Count;
+    KeyCell->MaxNameLen = MaxNameLen;
+    HvReleaseCell(Hive, KeyCellOffset);
 
-    HvMarkCellDirty(&RegistryHive->Hive, Parent->ValueList.List, FALSE);
-    HvMarkCellDirty(&RegistryHive->Hive, NewValueCellOffset, FALSE);
+    /* Then go down one level */
+    for (i = 0; i < Count; i++)
+    {
+        Status = CmiBuildKey(RegistryHive, SubKeyCells[i], SubKeys[i]);
+        if (!NT_SUCCESS(Status))
+            break;
+    }
 
-    *pValueCell = NewValueCell;
-    *pValueCellOffset = NewValueCellOffset;
+Quit:
+    free(SubKeyCells);
+    free(SubKeys);
+    return Status;
+}
 
-    return STATUS_SUCCESS;
+NTSTATUS
+CmiBuildHive(
+    IN PCMHIVE RegistryHive,
+    IN PMEMKEY RootKey)
+{
+    /* Everything goes below the root cell created along with the hive */
+    return CmiBuildKey(RegistryHive,
+                       RegistryHive->Hive.BaseBlock->RootCell,
+                       RootKey);
 }
@@ -39,17 +39,6 @@ CmiCreateSecurityKey(
     IN ULONG DescriptorLength);
 
 NTSTATUS
-CmiAddSubKey(
+CmiBuildHive(
     IN PCMHIVE RegistryHive,
-    IN HCELL_INDEX ParentKeyCellOffset,
-    IN PCUNICODE_STRING SubKeyName,
-    IN BOOLEAN VolatileKey,
-    OUT HCELL_INDEX *pBlockOffset);
-
-NTSTATUS
-CmiAddValueKey(
-    IN PCMHIVE RegistryHive,
-    IN PCM_KEY_NODE Parent,
-    IN PCUNICODE_STRING ValueName,
-    OUT PCM_KEY_VALUE *pValueCell,
-    OUT HCELL_INDEX *pValueCellOffset);
+    IN PMEMKEY RootKey);
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "mkhive.h"
 
@@ -87,6 +88,7 @@ int main (int argc, char *argv[])
 {
     char FileName[PATH_MAX];
     int i;
+    clock_t Start;
 
     if (argc < 3)
     {
@@ -98,11 +100,14 @@ int main (int argc, char *argv[])
 
     RegInitializeRegistry ();
 
+    Start = clock ();
     for (i = 2; i < argc; i++)
     {
         convert_path (FileName, argv[i]);
         ImportRegistryFile (FileName);
     }
+    printf ("  Imported %d file(s) in %lu ms\n", argc - 2,
+            (unsigned long)((clock () - Start) * 1000 / CLOCKS_PER_SEC));
 
     convert_path (FileName, argv[1]);
     strcat (FileName, DIR_SEPARATOR_STRING);
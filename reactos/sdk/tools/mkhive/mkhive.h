@@ -109,8 +109,8 @@ RegOpenKeyW(
 #include <cmlib.h>
 #include <infhost.h>
 #include "reginf.h"
-#include "cmi.h"
 #include "registry.h"
+#include "cmi.h"
 #include "binhive.h"
 
 #define OBJ_NAME_PATH_SEPARATOR           ((WCHAR)L'\\')
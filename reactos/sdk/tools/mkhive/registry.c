@@ -330,23 +330,166 @@ UCHAR SystemSecurity[] =
     0x01, 0x02, 0x00, 0x00
 };
 
+/* Number of hash buckets of a key's first subkey or value table */
+#define MEMNAME_TABLE_MIN_SIZE  8
+
+#define MEMNAME_BUCKET(Table, HashKey) \
+    (((HashKey) ^ ((HashKey) >> 16)) & ((Table)->Size - 1))
+
+static PMEMKEY HiveRootKeys[8];
+static ULONG HiveRootKeyCount;
+
+static BOOLEAN
+RegpEqualNames(
+    IN PCUNICODE_STRING Name1,
+    IN PCUNICODE_STRING Name2)
+{
+    USHORT i;
+
+    if (Name1->Length != Name2->Length)
+        return FALSE;
+
+    for (i = 0; i < Name1->Length / sizeof(WCHAR); i++)
+    {
+        if (RtlUpcaseUnicodeChar(Name1->Buffer[i]) != RtlUpcaseUnicodeChar(Name2->Buffer[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static VOID
+RegpInitializeName(
+    OUT PMEMNAME Entry,
+    IN PCUNICODE_STRING Name,
+    IN PWCHAR Buffer)
+{
+    /* The name is stored right after the entry by the caller */
+    RtlCopyMemory(Buffer, Name->Buffer, Name->Length);
+    Entry->Name.Buffer = Buffer;
+    Entry->Name.Length = Entry->Name.MaximumLength = Name->Length;
+    Entry->HashKey = CmpComputeHashKey(0, Name, TRUE);
+    Entry->HashNext = NULL;
+}
+
+static PMEMNAME
+RegpLookupName(
+    IN PMEMNAME_TABLE Table,
+    IN PCUNICODE_STRING Name)
+{
+    PMEMNAME Entry;
+    ULONG HashKey;
+
+    if (!Table->Count)
+        return NULL;
+
+    HashKey = CmpComputeHashKey(0, Name, TRUE);
+    for (Entry = Table->Buckets[MEMNAME_BUCKET(Table, HashKey)];
+         Entry != NULL;
+         Entry = Entry->HashNext)
+    {
+        if (Entry->HashKey == HashKey && RegpEqualNames(&Entry->Name, Name))
+            return Entry;
+    }
+
+    return NULL;
+}
+
+static BOOL
+RegpInsertName(
+    IN OUT PMEMNAME_TABLE Table,
+    IN PMEMNAME Entry)
+{
+    PMEMNAME *Buckets, Next;
+    ULONG Size, i, Bucket;
+
+    /* Keep the chains short by growing the table as it fills up */
+    if (Table->Count >= Table->Size)
+    {
+        Size = Table->Size ? Table->Size * 4 : MEMNAME_TABLE_MIN_SIZE;
+        Buckets = (PMEMNAME*)calloc(Size, sizeof(PMEMNAME));
+        if (!Buckets)
+            return FALSE;
+
+        for (i = 0; i < Table->Size; i++)
+        {
+            while (Table->Buckets[i])
+            {
+                Next = Table->Buckets[i]->HashNext;
+                Bucket = (Table->Buckets[i]->HashKey ^ (Table->Buckets[i]->HashKey >> 16)) & (Size - 1);
+                Table->Buckets[i]->HashNext = Buckets[Bucket];
+                Buckets[Bucket] = Table->Buckets[i];
+                Table->Buckets[i] = Next;
+            }
+        }
+
+        free(Table->Buckets);
+        Table->Buckets = Buckets;
+        Table->Size = Size;
+    }
+
+    Bucket = MEMNAME_BUCKET(Table, Entry->HashKey);
+    Entry->HashNext = Table->Buckets[Bucket];
+    Table->Buckets[Bucket] = Entry;
+    Table->Count++;
+    return TRUE;
+}
+
 static PMEMKEY
-CreateInMemoryStructure(
+RegpCreateKey(
+    IN PMEMKEY ParentKey OPTIONAL,
+    IN PCUNICODE_STRING KeyName,
     IN PCMHIVE RegistryHive,
-    IN HCELL_INDEX KeyCellOffset)
+    IN BOOL Volatile)
 {
     PMEMKEY Key;
 
-    Key = (PMEMKEY)malloc(sizeof(MEMKEY));
+    Key = (PMEMKEY)calloc(1, sizeof(MEMKEY) + KeyName->Length);
     if (!Key)
         return NULL;
 
+    RegpInitializeName(&Key->Name, KeyName, (PWCHAR)(Key + 1));
+    Key->Parent = ParentKey;
     Key->RegistryHive = RegistryHive;
-    Key->KeyCellOffset = KeyCellOffset;
+    Key->Volatile = (BOOLEAN)Volatile;
+
+    if (ParentKey && !RegpInsertName(&ParentKey->SubKeys, &Key->Name))
+    {
+        free(Key);
+        return NULL;
+    }
+
     return Key;
 }
 
-LIST_ENTRY CmiReparsePointsHead;
+static VOID
+RegpFreeKey(
+    IN PMEMKEY Key)
+{
+    PMEMVALUE Value, NextValue;
+    PMEMNAME Entry, NextEntry;
+    ULONG i;
+
+    for (i = 0; i < Key->SubKeys.Size; i++)
+    {
+        for (Entry = Key->SubKeys.Buckets[i]; Entry != NULL; Entry = NextEntry)
+        {
+            NextEntry = Entry->HashNext;
+            RegpFreeKey(CONTAINING_RECORD(Entry, MEMKEY, Name));
+        }
+    }
+
+    for (Value = Key->FirstValue; Value != NULL; Value = NextValue)
+    {
+        NextValue = Value->Next;
+        free(Value->Data);
+        free(Value);
+    }
+
+    free(Key->SubKeys.Buckets);
+    free(Key->Values.Buckets);
+    free(Key);
+}
 
 static LONG
 RegpOpenOrCreateKey(
@@ -359,33 +502,24 @@ RegpOpenOrCreateKey(
     PWSTR LocalKeyName;
     PWSTR End;
     UNICODE_STRING KeyString;
-    NTSTATUS Status;
-    PREPARSE_POINT CurrentReparsePoint;
+    PMEMKEY ParentKey;
+    PMEMNAME Entry;
     PMEMKEY CurrentKey;
-    PCMHIVE ParentRegistryHive;
-    HCELL_INDEX ParentCellOffset;
-    PCM_KEY_NODE ParentKeyCell;
-    PLIST_ENTRY Ptr;
-    PCM_KEY_NODE SubKeyCell;
-    HCELL_INDEX BlockOffset;
 
     DPRINT("RegpCreateOpenKey('%S')\n", KeyName);
 
     if (*KeyName == OBJ_NAME_PATH_SEPARATOR)
     {
         KeyName++;
-        ParentRegistryHive = RootKey->RegistryHive;
-        ParentCellOffset = RootKey->KeyCellOffset;
+        ParentKey = RootKey;
     }
     else if (hParentKey == NULL)
     {
-        ParentRegistryHive = RootKey->RegistryHive;
-        ParentCellOffset = RootKey->KeyCellOffset;
+        ParentKey = RootKey;
     }
     else
     {
-        ParentRegistryHive = HKEY_TO_MEMKEY(hParentKey)->RegistryHive;
-        ParentCellOffset = HKEY_TO_MEMKEY(hParentKey)->KeyCellOffset;
+        ParentKey = HKEY_TO_MEMKEY(hParentKey);
     }
 
     LocalKeyName = (PWSTR)KeyName;
@@ -408,58 +542,37 @@ RegpOpenOrCreateKey(
             }
         }
 
-        ParentKeyCell = (PCM_KEY_NODE)HvGetCell(&ParentRegistryHive->Hive, ParentCellOffset);
-        if (!ParentKeyCell)
-            return STATUS_UNSUCCESSFUL;
-
-        VERIFY_KEY_CELL(ParentKeyCell);
-
-        BlockOffset = CmpFindSubKeyByName(&ParentRegistryHive->Hive, ParentKeyCell, &KeyString);
-        if (BlockOffset != HCELL_NIL)
+        Entry = RegpLookupName(&ParentKey->SubKeys, &KeyString);
+        if (Entry)
         {
-            Status = STATUS_SUCCESS;
-
-            /* Search for a possible reparse point */
-            Ptr = CmiReparsePointsHead.Flink;
-            while (Ptr != &CmiReparsePointsHead)
-            {
-                CurrentReparsePoint = CONTAINING_RECORD(Ptr, REPARSE_POINT, ListEntry);
-                if (CurrentReparsePoint->SourceHive == ParentRegistryHive &&
-                    CurrentReparsePoint->SourceKeyCellOffset == BlockOffset)
-                {
-                    ParentRegistryHive = CurrentReparsePoint->DestinationHive;
-                    BlockOffset = CurrentReparsePoint->DestinationKeyCellOffset;
-                    break;
-                }
-                Ptr = Ptr->Flink;
-            }
+            CurrentKey = CONTAINING_RECORD(Entry, MEMKEY, Name);
         }
-        else if (AllowCreation) // && (BlockOffset == HCELL_NIL)
+        else if (AllowCreation)
         {
-            Status = CmiAddSubKey(ParentRegistryHive,
-                                  ParentCellOffset,
-                                  &KeyString,
-                                  Volatile,
-                                  &BlockOffset);
+            CurrentKey = RegpCreateKey(ParentKey,
+                                       &KeyString,
+                                       ParentKey->RegistryHive,
+                                       Volatile);
+            if (!CurrentKey)
+                return ERROR_OUTOFMEMORY;
+        }
+        else
+        {
+            return ERROR_FILE_NOT_FOUND;
         }
 
-        HvReleaseCell(&ParentRegistryHive->Hive, ParentCellOffset);
-
-        if (!NT_SUCCESS(Status))
-            return ERROR_UNSUCCESSFUL;
+        /* Follow a possible reparse point */
+        if (CurrentKey->LinkKey)
+            CurrentKey = CurrentKey->LinkKey;
 
-        ParentCellOffset = BlockOffset;
+        ParentKey = CurrentKey;
         if (End)
             LocalKeyName = End + 1;
         else
             break;
     }
 
-    CurrentKey = CreateInMemoryStructure(ParentRegistryHive, ParentCellOffset);
-    if (!CurrentKey)
-        return ERROR_OUTOFMEMORY;
-
-    *Key = MEMKEY_TO_HKEY(CurrentKey);
+    *Key = MEMKEY_TO_HKEY(ParentKey);
 
     return ERROR_SUCCESS;
 }
@@ -521,15 +634,10 @@ RegSetValueExW(
     IN ULONG cbData)
 {
     PMEMKEY Key = HKEY_TO_MEMKEY(hKey); // ParentKey
-    PHHIVE Hive;
-    PCM_KEY_NODE KeyNode; // ParentNode
-    PCM_KEY_VALUE ValueCell;
-    HCELL_INDEX CellIndex;
+    PMEMVALUE Value;
+    PMEMNAME Entry;
     UNICODE_STRING ValueNameString;
-
-    PVOID DataCell;
-    ULONG DataCellSize;
-    NTSTATUS Status;
+    PUCHAR Data;
 
     if (dwType == REG_LINK)
     {
@@ -554,157 +662,55 @@ RegSetValueExW(
     if ((cbData & ~CM_KEY_VALUE_SPECIAL_SIZE) != cbData)
         return STATUS_UNSUCCESSFUL;
 
-    Hive = &Key->RegistryHive->Hive;
-
-    KeyNode = (PCM_KEY_NODE)HvGetCell(Hive, Key->KeyCellOffset);
-    if (!KeyNode)
-        return ERROR_UNSUCCESSFUL;
-
-    ASSERT(KeyNode->Signature == CM_KEY_NODE_SIGNATURE);
-
-    /* Mark the parent as dirty since we are going to create a new value in it */
-    HvMarkCellDirty(Hive, Key->KeyCellOffset, FALSE);
-
     /* Initialize value name string */
     RtlInitUnicodeString(&ValueNameString, lpValueName);
-    CellIndex = CmpFindValueByName(Hive, KeyNode, &ValueNameString);
-    if (CellIndex == HCELL_NIL)
-    {
-        /* The value doesn't exist, create a new one */
-        Status = CmiAddValueKey(Key->RegistryHive,
-                                KeyNode,
-                                &ValueNameString,
-                                &ValueCell,
-                                &CellIndex);
-    }
-    else
-    {
-        /* The value already exists, use it. Get the value cell. */
-        ValueCell = HvGetCell(&Key->RegistryHive->Hive, CellIndex);
-        ASSERT(ValueCell != NULL);
-        Status = STATUS_SUCCESS;
-    }
-
-    // /**/HvReleaseCell(Hive, CellIndex);/**/
-
-    if (!NT_SUCCESS(Status))
-        return ERROR_UNSUCCESSFUL;
-
-    /* Get size of the allocated cell (if any) */
-    if (!(ValueCell->DataLength & CM_KEY_VALUE_SPECIAL_SIZE) &&
-         (ValueCell->DataLength & ~CM_KEY_VALUE_SPECIAL_SIZE) != 0)
+    Entry = RegpLookupName(&Key->Values, &ValueNameString);
+    if (Entry)
     {
-        DataCell = HvGetCell(Hive, ValueCell->Data);
-        if (!DataCell)
-            return ERROR_UNSUCCESSFUL;
-
-        DataCellSize = (ULONG)(-HvGetCellSize(Hive, DataCell));
+        /* The value already exists, use it */
+        Value = CONTAINING_RECORD(Entry, MEMVALUE, Name);
     }
     else
     {
-        DataCell = NULL;
-        DataCellSize = 0;
-    }
+        /* The value doesn't exist, create a new one */
+        Value = (PMEMVALUE)calloc(1, sizeof(MEMVALUE) + ValueNameString.Length);
+        if (!Value)
+            return ERROR_OUTOFMEMORY;
 
-    if (cbData <= sizeof(HCELL_INDEX))
-    {
-        /* If data size <= sizeof(HCELL_INDEX) then store data in the data offset */
-        DPRINT("ValueCell->DataLength %u\n", ValueCell->DataLength);
-        if (DataCell)
-            HvFreeCell(Hive, ValueCell->Data);
-
-        RtlCopyMemory(&ValueCell->Data, lpData, cbData);
-        ValueCell->DataLength = (cbData | CM_KEY_VALUE_SPECIAL_SIZE);
-        ValueCell->Type = dwType;
-    }
-    else
-    {
-        if (cbData > DataCellSize)
+        RegpInitializeName(&Value->Name, &ValueNameString, (PWCHAR)(Value + 1));
+        if (!RegpInsertName(&Key->Values, &Value->Name))
         {
-            /* New data size is larger than the current, destroy current
-             * data block and allocate a new one. */
-            HCELL_INDEX NewOffset;
-
-            DPRINT("ValueCell->DataLength %u\n", ValueCell->DataLength);
-
-            NewOffset = HvAllocateCell(Hive, cbData, Stable, HCELL_NIL);
-            if (NewOffset == HCELL_NIL)
-            {
-                DPRINT("HvAllocateCell() has failed!\n");
-                return ERROR_UNSUCCESSFUL;
-            }
-
-            if (DataCell)
-                HvFreeCell(Hive, ValueCell->Data);
-
-            ValueCell->Data = NewOffset;
-            DataCell = (PVOID)HvGetCell(Hive, NewOffset);
+            free(Value);
+            return ERROR_OUTOFMEMORY;
         }
 
-        /* Copy new contents to cell */
-        RtlCopyMemory(DataCell, lpData, cbData);
-        ValueCell->DataLength = (cbData & ~CM_KEY_VALUE_SPECIAL_SIZE);
-        ValueCell->Type = dwType;
-        HvMarkCellDirty(Hive, ValueCell->Data, FALSE);
+        /* Keep the values in the order they were created */
+        if (Key->LastValue)
+            Key->LastValue->Next = Value;
+        else
+            Key->FirstValue = Value;
+        Key->LastValue = Value;
     }
 
-    HvMarkCellDirty(Hive, CellIndex, FALSE);
-
-    /* Check if the maximum value name length changed, update it if so */
-    if (KeyNode->MaxValueNameLen < ValueNameString.Length)
-        KeyNode->MaxValueNameLen = ValueNameString.Length;
+    /* Copy new contents */
+    Data = NULL;
+    if (cbData)
+    {
+        Data = (PUCHAR)malloc(cbData);
+        if (!Data)
+            return ERROR_OUTOFMEMORY;
 
-    /* Check if the maximum data length changed, update it if so */
-    if (KeyNode->MaxValueDataLen < cbData)
-        KeyNode->MaxValueDataLen = cbData;
+        RtlCopyMemory(Data, lpData, cbData);
+    }
 
-    /* Save the write time */
-    KeQuerySystemTime(&KeyNode->LastWriteTime);
+    free(Value->Data);
+    Value->Data = Data;
+    Value->DataSize = cbData;
+    Value->Type = dwType;
 
     return ERROR_SUCCESS;
 }
 
-
-// Synced with freeldr/windows/registry.c
-static
-VOID
-RepGetValueData(
-    IN PHHIVE Hive,
-    IN PCM_KEY_VALUE ValueCell,
-    OUT ULONG* Type OPTIONAL,
-    OUT PUCHAR Data OPTIONAL,
-    IN OUT ULONG* DataSize OPTIONAL)
-{
-    ULONG DataLength;
-    PVOID DataCell;
-
-    /* Does the caller want the type? */
-    if (Type != NULL)
-        *Type = ValueCell->Type;
-
-    /* Does the caller provide DataSize? */
-    if (DataSize != NULL)
-    {
-        // NOTE: CmpValueToData doesn't support big data (the function will
-        // bugcheck if so), FreeLdr is not supposed to read such data.
-        // If big data is needed, use instead CmpGetValueData.
-        // CmpGetValueData(Hive, ValueCell, DataSize, &DataCell, ...);
-        DataCell = CmpValueToData(Hive, ValueCell, &DataLength);
-
-        /* Does the caller want the data? */
-        if ((Data != NULL) && (*DataSize != 0))
-        {
-            RtlCopyMemory(Data,
-                          DataCell,
-                          min(*DataSize, DataLength));
-        }
-
-        /* Return the actual data length */
-        *DataSize = DataLength;
-    }
-}
-
-// Similar to RegQueryValue in freeldr/windows/registry.c
 LONG WINAPI
 RegQueryValueExW(
     IN HKEY hKey,
@@ -715,31 +721,36 @@ RegQueryValueExW(
     IN OUT PULONG lpcbData OPTIONAL)
 {
     PMEMKEY ParentKey = HKEY_TO_MEMKEY(hKey);
-    PHHIVE Hive = &ParentKey->RegistryHive->Hive;
-    PCM_KEY_NODE KeyNode;
-    PCM_KEY_VALUE ValueCell;
-    HCELL_INDEX CellIndex;
+    PMEMVALUE Value;
+    PMEMNAME Entry;
     UNICODE_STRING ValueNameString;
 
-    KeyNode = (PCM_KEY_NODE)HvGetCell(Hive, ParentKey->KeyCellOffset);
-    if (!KeyNode)
-        return ERROR_UNSUCCESSFUL;
-
-    ASSERT(KeyNode->Signature == CM_KEY_NODE_SIGNATURE);
-
     /* Initialize value name string */
     RtlInitUnicodeString(&ValueNameString, lpValueName);
-    CellIndex = CmpFindValueByName(Hive, KeyNode, &ValueNameString);
-    if (CellIndex == HCELL_NIL)
+    Entry = RegpLookupName(&ParentKey->Values, &ValueNameString);
+    if (!Entry)
         return ERROR_FILE_NOT_FOUND;
 
-    /* Get the value cell */
-    ValueCell = HvGetCell(Hive, CellIndex);
-    ASSERT(ValueCell != NULL);
+    Value = CONTAINING_RECORD(Entry, MEMVALUE, Name);
+
+    /* Does the caller want the type? */
+    if (lpType != NULL)
+        *lpType = Value->Type;
 
-    RepGetValueData(Hive, ValueCell, lpType, lpData, lpcbData);
+    /* Does the caller provide DataSize? */
+    if (lpcbData != NULL)
+    {
+        /* Does the caller want the data? */
+        if ((lpData != NULL) && (*lpcbData != 0))
+        {
+            RtlCopyMemory(lpData,
+                          Value->Data,
+                          min(*lpcbData, Value->DataSize));
+        }
 
-    HvReleaseCell(Hive, CellIndex);
+        /* Return the actual data length */
+        *lpcbData = Value->DataSize;
+    }
 
     return ERROR_SUCCESS;
 }
@@ -763,13 +774,13 @@ ConnectRegistry(
     IN ULONG DescriptorLength,
     IN LPCWSTR Path)
 {
+    UNICODE_STRING EmptyName = RTL_CONSTANT_STRING(L"");
     NTSTATUS Status;
-    PREPARSE_POINT ReparsePoint;
+    PMEMKEY HiveRootKey;
     PMEMKEY NewKey;
     LONG rc;
 
-    ReparsePoint = (PREPARSE_POINT)malloc(sizeof(REPARSE_POINT));
-    if (!ReparsePoint)
+    if (HiveRootKeyCount >= sizeof(HiveRootKeys) / sizeof(HiveRootKeys[0]))
         return FALSE;
 
     /*
@@ -783,7 +794,6 @@ ConnectRegistry(
     if (!NT_SUCCESS(Status))
     {
         DPRINT1("CmiInitializeHive() failed with status 0x%08x\n", Status);
-        free(ReparsePoint);
         return FALSE;
     }
 
@@ -798,6 +808,11 @@ ConnectRegistry(
     if (!NT_SUCCESS(Status))
         DPRINT1("Failed to add security for root key '%S'\n", Path);
 
+    /* The keys of the hive are collected under this one */
+    HiveRootKey = RegpCreateKey(NULL, &EmptyName, HiveToConnect, FALSE);
+    if (!HiveRootKey)
+        return FALSE;
+
     /* Create key */
     rc = RegCreateKeyExW(RootKey,
                          Path,
@@ -810,20 +825,31 @@ ConnectRegistry(
                          NULL);
     if (rc != ERROR_SUCCESS)
     {
-        free(ReparsePoint);
+        RegpFreeKey(HiveRootKey);
         return FALSE;
     }
 
-    ReparsePoint->SourceHive = NewKey->RegistryHive;
-    ReparsePoint->SourceKeyCellOffset = NewKey->KeyCellOffset;
-    NewKey->RegistryHive = HiveToConnect;
-    NewKey->KeyCellOffset = HiveToConnect->Hive.BaseBlock->RootCell;
-    ReparsePoint->DestinationHive = NewKey->RegistryHive;
-    ReparsePoint->DestinationKeyCellOffset = NewKey->KeyCellOffset;
-    InsertTailList(&CmiReparsePointsHead, &ReparsePoint->ListEntry);
+    /* And make it a reparse point to the hive */
+    NewKey->LinkKey = HiveRootKey;
+    HiveRootKeys[HiveRootKeyCount++] = HiveRootKey;
     return TRUE;
 }
 
+PMEMKEY
+RegGetHiveRootKey(
+    IN PCMHIVE RegistryHive)
+{
+    ULONG i;
+
+    for (i = 0; i < HiveRootKeyCount; i++)
+    {
+        if (HiveRootKeys[i]->RegistryHive == RegistryHive)
+            return HiveRootKeys[i];
+    }
+
+    return NULL;
+}
+
 LIST_ENTRY CmiHiveListHead;
 
 VOID
@@ -832,10 +858,8 @@ RegInitializeRegistry(VOID)
     UNICODE_STRING RootKeyName = RTL_CONSTANT_STRING(L"\\");
     NTSTATUS Status;
     PMEMKEY ControlSetKey, CurrentControlSetKey;
-    PREPARSE_POINT ReparsePoint;
 
     InitializeListHead(&CmiHiveListHead);
-    InitializeListHead(&CmiReparsePointsHead);
 
     Status = CmiInitializeHive(&RootHive, L"");
     if (!NT_SUCCESS(Status))
@@ -844,8 +868,7 @@ RegInitializeRegistry(VOID)
         return;
     }
 
-    RootKey = CreateInMemoryStructure(&RootHive,
-                                      RootHive.Hive.BaseBlock->RootCell);
+    RootKey = RegpCreateKey(NULL, &RootKeyName, &RootHive, FALSE);
 
     /* Create DEFAULT key */
     ConnectRegistry(NULL,
@@ -900,20 +923,21 @@ RegInitializeRegistry(VOID)
                     NULL);
 
     /* Connect 'CurrentControlSet' to 'ControlSet001' */
-    ReparsePoint = (PREPARSE_POINT)malloc(sizeof(REPARSE_POINT));
-    ReparsePoint->SourceHive = CurrentControlSetKey->RegistryHive;
-    ReparsePoint->SourceKeyCellOffset = CurrentControlSetKey->KeyCellOffset;
-    ReparsePoint->DestinationHive = ControlSetKey->RegistryHive;
-    ReparsePoint->DestinationKeyCellOffset = ControlSetKey->KeyCellOffset;
-    InsertTailList(&CmiReparsePointsHead, &ReparsePoint->ListEntry);
+    CurrentControlSetKey->LinkKey = ControlSetKey;
 }
 
 VOID
 RegShutdownRegistry(VOID)
 {
+    ULONG i;
+
     /* FIXME: clean up the complete hive */
 
-    free(RootKey);
+    for (i = 0; i < HiveRootKeyCount; i++)
+        RegpFreeKey(HiveRootKeys[i]);
+    HiveRootKeyCount = 0;
+
+    RegpFreeKey(RootKey);
 }
 
 /* EOF */
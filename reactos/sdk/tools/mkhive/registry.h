@@ -7,20 +7,50 @@
 
 #pragma once
 
-typedef struct _REPARSE_POINT
+/*
+ * The keys and values are first collected in memory, and only laid out
+ * into hive cells once all the INF files have been imported.
+ */
+
+typedef struct _MEMNAME
+{
+    /* Next entry in the same hash bucket */
+    struct _MEMNAME *HashNext;
+    /* Same hash as the one stored in hash leaves (see CmpComputeHashKey) */
+    ULONG HashKey;
+    UNICODE_STRING Name;
+} MEMNAME, *PMEMNAME;
+
+typedef struct _MEMNAME_TABLE
+{
+    PMEMNAME *Buckets;
+    ULONG Size;
+    ULONG Count;
+} MEMNAME_TABLE, *PMEMNAME_TABLE;
+
+typedef struct _MEMVALUE
 {
-    LIST_ENTRY ListEntry;
-    PCMHIVE SourceHive;
-    HCELL_INDEX SourceKeyCellOffset;
-    PCMHIVE DestinationHive;
-    HCELL_INDEX DestinationKeyCellOffset;
-} REPARSE_POINT, *PREPARSE_POINT;
+    MEMNAME Name;
+    /* Values are kept in the order they were created */
+    struct _MEMVALUE *Next;
+    ULONG Type;
+    ULONG DataSize;
+    PUCHAR Data;
+} MEMVALUE, *PMEMVALUE;
 
 typedef struct _MEMKEY
 {
-    /* Information on hard disk structure */
-    HCELL_INDEX KeyCellOffset;
+    MEMNAME Name;
+    struct _MEMKEY *Parent;
+    /* Hive this key belongs to */
     PCMHIVE RegistryHive;
+    /* If set, opening this key opens that one instead */
+    struct _MEMKEY *LinkKey;
+    BOOLEAN Volatile;
+    MEMNAME_TABLE SubKeys;
+    MEMNAME_TABLE Values;
+    PMEMVALUE FirstValue;
+    PMEMVALUE LastValue;
 } MEMKEY, *PMEMKEY;
 
 #define HKEY_TO_MEMKEY(hKey) ((PMEMKEY)(hKey))
@@ -62,4 +92,8 @@ RegInitializeRegistry(VOID);
 VOID
 RegShutdownRegistry(VOID);
 
+PMEMKEY
+RegGetHiveRootKey(
+    IN PCMHIVE RegistryHive);
+
 /* EOF */
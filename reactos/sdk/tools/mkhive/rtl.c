@@ -185,11 +185,13 @@ unsigned char BitScanForward(ULONG * Index, unsigned long Mask)
 
 unsigned char BitScanReverse(ULONG * const Index, unsigned long Mask)
 {
+    /* Only the low 32 bits are scanned, like the compiler intrinsic */
+    Mask &= 0xFFFFFFFF;
     *Index = 0;
-    while (Mask && ((Mask & (1 << 31)) == 0))
-    {
-        Mask <<= 1;
+    if (!Mask)
+        return 0;
+
+    while (Mask >>= 1)
         ++(*Index);
-    }
-    return Mask ? 1 : 0;
+    return 1;
 }
@@ -0,0 +1,9 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS compression round trip
+ * FILE:            tools/rtlcompress/rtl.c
+ * PURPOSE:         Runtime Library
+ */
+
+#include "rtlcompress.h"
+#include <compress.c>
@@ -0,0 +1,194 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS compression round trip
+ * FILE:            tools/rtlcompress/rtlcompress.c
+ * PURPOSE:         Round trip of the RTL compression formats on the host
+ */
+
+#include "rtlcompress.h"
+
+#define CORPUS_SIZE         (256 * 1024)
+#define COMPRESSED_SIZE     (CORPUS_SIZE + CORPUS_SIZE / 8 + 1024)
+
+static const struct
+{
+    USHORT Format;
+    PCSTR Name;
+} Formats[] =
+{
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD, "LZNT1" },
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_MAXIMUM, "LZNT1 (max)" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_STANDARD, "XPRESS" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_MAXIMUM, "XPRESS (max)" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_STANDARD, "XPRESS_HUFF" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_MAXIMUM, "XPRESS_HUFF (max)" },
+};
+
+static const PCSTR Words[] =
+{
+    "the", "of", "and", "to", "in", "is", "that", "for", "it", "with",
+    "file", "system", "buffer", "chunk", "compression", "kernel", "driver",
+    "memory", "page", "process", "thread", "registry", "volume", "cache",
+};
+
+static ULONG Seed;
+
+static
+ULONG
+NextRandom(VOID)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return Seed >> 8;
+}
+
+static
+VOID
+MakeText(PUCHAR Buffer)
+{
+    ULONG Position = 0, Length;
+    PCSTR Word;
+
+    while (Position < CORPUS_SIZE)
+    {
+        Word = Words[NextRandom() % (sizeof(Words) / sizeof(Words[0]))];
+        Length = min((ULONG)strlen(Word), CORPUS_SIZE - Position);
+        memcpy(Buffer + Position, Word, Length);
+        Position += Length;
+        if (Position < CORPUS_SIZE)
+            Buffer[Position++] = (NextRandom() % 12) ? ' ' : '\n';
+    }
+}
+
+static
+VOID
+MakeRecords(PUCHAR Buffer)
+{
+    ULONG Position;
+
+    /* Mostly constant 32 byte records, with a counter and a random field */
+    for (Position = 0; Position < CORPUS_SIZE; Position++)
+    {
+        switch (Position % 32)
+        {
+            case 0: Buffer[Position] = (UCHAR)(Position / 32); break;
+            case 1: Buffer[Position] = (UCHAR)(Position / 32 / 256); break;
+            case 4: Buffer[Position] = (UCHAR)(NextRandom() % 4); break;
+            default: Buffer[Position] = (Position % 32 >= 12) ? "file.dat"[Position % 8] : 0; break;
+        }
+    }
+}
+
+static
+VOID
+MakeZeros(PUCHAR Buffer)
+{
+    memset(Buffer, 0, CORPUS_SIZE);
+}
+
+static
+VOID
+MakeNoise(PUCHAR Buffer)
+{
+    ULONG Position;
+
+    for (Position = 0; Position < CORPUS_SIZE; Position++)
+        Buffer[Position] = (UCHAR)NextRandom();
+}
+
+static const struct
+{
+    VOID (*Make)(PUCHAR Buffer);
+    PCSTR Name;
+    BOOLEAN Compressible;
+} Corpus[] =
+{
+    { MakeText, "text", TRUE },
+    { MakeRecords, "records", TRUE },
+    { MakeZeros, "zeros", TRUE },
+    { MakeNoise, "noise", FALSE },
+};
+
+static ULONG Failures;
+
+static
+VOID
+Check(BOOLEAN Condition, PCSTR Format, PCSTR Corpus, PCSTR Message, ULONG Value)
+{
+    if (Condition)
+        return;
+
+    printf("%s, %s: %s (0x%lx)\n", Format, Corpus, Message, (unsigned long)Value);
+    Failures++;
+}
+
+int main(int argc, char *argv[])
+{
+    PUCHAR Data, Compressed, Decompressed;
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize, MaxWorkSpaceSize = 0;
+    ULONG CompressedSize, FinalSize, i, j;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    for (i = 0; i < sizeof(Formats) / sizeof(Formats[0]); i++)
+    {
+        Status = RtlGetCompressionWorkSpaceSize(Formats[i].Format, &WorkSpaceSize, &FragmentWorkSpaceSize);
+        Check(Status == STATUS_SUCCESS, Formats[i].Name, "-", "RtlGetCompressionWorkSpaceSize failed", Status);
+        if (Status == STATUS_SUCCESS)
+            MaxWorkSpaceSize = max(MaxWorkSpaceSize, WorkSpaceSize);
+    }
+
+    Data = malloc(CORPUS_SIZE);
+    Compressed = malloc(COMPRESSED_SIZE);
+    Decompressed = malloc(CORPUS_SIZE + 1);
+    WorkSpace = malloc(MaxWorkSpaceSize);
+    if (!Data || !Compressed || !Decompressed || !WorkSpace)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    for (j = 0; j < sizeof(Corpus) / sizeof(Corpus[0]); j++)
+    {
+        Seed = 0x1234 + j;
+        Corpus[j].Make(Data);
+
+        for (i = 0; i < sizeof(Formats) / sizeof(Formats[0]); i++)
+        {
+            CompressedSize = 0xdeadbeef;
+            Status = RtlCompressBuffer(Formats[i].Format, Data, CORPUS_SIZE, Compressed, COMPRESSED_SIZE,
+                                       4096, &CompressedSize, WorkSpace);
+            Check(Status == STATUS_SUCCESS, Formats[i].Name, Corpus[j].Name, "RtlCompressBuffer failed", Status);
+            if (Status != STATUS_SUCCESS)
+                continue;
+
+            if (Corpus[j].Compressible)
+                Check(CompressedSize < CORPUS_SIZE / 2, Formats[i].Name, Corpus[j].Name, "Poorly compressed", CompressedSize);
+
+            /* A larger buffer must be left alone past the data */
+            memset(Decompressed, 0x11, CORPUS_SIZE + 1);
+            FinalSize = 0xdeadbeef;
+            Status = RtlDecompressBuffer(Formats[i].Format, Decompressed, CORPUS_SIZE + 1,
+                                         Compressed, CompressedSize, &FinalSize);
+            Check(Status == STATUS_SUCCESS, Formats[i].Name, Corpus[j].Name, "RtlDecompressBuffer failed", Status);
+            Check(FinalSize == CORPUS_SIZE, Formats[i].Name, Corpus[j].Name, "Wrong decompressed size", FinalSize);
+            Check(!memcmp(Decompressed, Data, CORPUS_SIZE), Formats[i].Name, Corpus[j].Name, "Wrong decoded data", 0);
+            Check(Decompressed[CORPUS_SIZE] == 0x11, Formats[i].Name, Corpus[j].Name, "Too many bytes written", 0);
+
+            /* Not enough room for the data */
+            Status = RtlCompressBuffer(Formats[i].Format, Data, CORPUS_SIZE, Compressed, CompressedSize / 2,
+                                       4096, &FinalSize, WorkSpace);
+            Check(Status == STATUS_BUFFER_TOO_SMALL, Formats[i].Name, Corpus[j].Name, "Expected STATUS_BUFFER_TOO_SMALL", Status);
+
+            printf("%-18s %-8s %6lu bytes (%3lu%%)\n", Formats[i].Name, Corpus[j].Name,
+                   (unsigned long)CompressedSize, (unsigned long)(CompressedSize * 100 / CORPUS_SIZE));
+        }
+    }
+
+    free(WorkSpace);
+    free(Decompressed);
+    free(Compressed);
+    free(Data);
+
+    printf("%lu failures\n", (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS compression round trip
+ * FILE:            tools/rtlcompress/rtlcompress.h
+ * PURPOSE:         Host build of the RTL compression routines
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <typedefs.h>
+
+// Definitions copied from <ntstatus.h>
+// We only want to include host headers, so we define them manually
+#define STATUS_SUCCESS                   ((NTSTATUS)0x00000000)
+#define STATUS_NOT_IMPLEMENTED           ((NTSTATUS)0xC0000002)
+#define STATUS_ACCESS_VIOLATION          ((NTSTATUS)0xC0000005)
+#define STATUS_INVALID_PARAMETER         ((NTSTATUS)0xC000000D)
+#define STATUS_INSUFFICIENT_RESOURCES    ((NTSTATUS)0xC000009A)
+#define STATUS_NOT_SUPPORTED             ((NTSTATUS)0xC00000BB)
+#define STATUS_BUFFER_TOO_SMALL          ((NTSTATUS)0xC0000023)
+#define STATUS_UNSUPPORTED_COMPRESSION   ((NTSTATUS)0xC000025F)
+#define STATUS_BAD_COMPRESSION_BUFFER    ((NTSTATUS)0xC0000242)
+
+// Definitions copied from <winnt.h>
+#define COMPRESSION_FORMAT_NONE          (0x0000)
+#define COMPRESSION_FORMAT_DEFAULT       (0x0001)
+#define COMPRESSION_FORMAT_LZNT1         (0x0002)
+#define COMPRESSION_FORMAT_XPRESS        (0x0003)
+#define COMPRESSION_FORMAT_XPRESS_HUFF   (0x0004)
+#define COMPRESSION_ENGINE_STANDARD      (0x0000)
+#define COMPRESSION_ENGINE_MAXIMUM       (0x0100)
+
+#ifndef FORCEINLINE
+#define FORCEINLINE static __inline
+#endif
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef UNALIGNED
+#define UNALIGNED
+#endif
+
+/* Only the chunk stubs take it */
+typedef struct _COMPRESSED_DATA_INFO *PCOMPRESSED_DATA_INFO;
+
+#define RtlpAllocateMemory(Bytes, Tag) malloc(Bytes)
+#define RtlpFreeMemory(Mem, Tag)       free(Mem)
+
+NTSTATUS NTAPI
+RtlCompressBuffer(
+    IN USHORT CompressionFormatAndEngine,
+    IN PUCHAR UncompressedBuffer,
+    IN ULONG UncompressedBufferSize,
+    OUT PUCHAR CompressedBuffer,
+    IN ULONG CompressedBufferSize,
+    IN ULONG UncompressedChunkSize,
+    OUT PULONG FinalCompressedSize,
+    IN PVOID WorkSpace);
+
+NTSTATUS NTAPI
+RtlDecompressBuffer(
+    IN USHORT CompressionFormat,
+    OUT PUCHAR UncompressedBuffer,
+    IN ULONG UncompressedBufferSize,
+    IN PUCHAR CompressedBuffer,
+    IN ULONG CompressedBufferSize,
+    OUT PULONG FinalUncompressedSize);
+
+NTSTATUS NTAPI
+RtlDecompressFragment(
+    IN USHORT format,
+    OUT PUCHAR uncompressed,
+    IN ULONG uncompressed_size,
+    IN PUCHAR compressed,
+    IN ULONG compressed_size,
+    IN ULONG offset,
+    OUT PULONG final_size,
+    IN PVOID workspace);
+
+NTSTATUS NTAPI
+RtlGetCompressionWorkSpaceSize(
+    IN USHORT CompressionFormatAndEngine,
+    OUT PULONG CompressBufferWorkSpaceSize,
+    OUT PULONG CompressFragmentWorkSpaceSize);
@@ -226,6 +226,7 @@ BOOLEAN CpuInitialize(VOID)
     Fast486Initialize(&EmulatorContext,
                       EmulatorReadMemory,
                       EmulatorWriteMemory,
+                      EmulatorMapMemory,
                       EmulatorReadIo,
                       EmulatorWriteIo,
                       EmulatorBiosOperation,
@@ -21,6 +21,7 @@
 #include <isvbop.h>
 
 #include "utils.h"
+#include "memory.h"
 
 #include "dem.h"
 #include "dos/dos32krnl/device.h"
@@ -107,6 +108,7 @@ static VOID DemLoadNTDOSKernel(VOID)
                                REAL_TO_PHYS(TO_LINEAR(getDI(), 0x0000)),
                                ulDosKernelSize,
                                &ulDosKernelSize);
+    if (Success) MemInvalidateCode(REAL_TO_PHYS(TO_LINEAR(getDI(), 0x0000)), ulDosKernelSize);
 
     DPRINT1("Windows NT DOS file '%s' loading %s at %04X:%04X, size 0x%X (Error: %u).\n",
             DosKernelFileName,
@@ -1102,6 +1104,7 @@ VOID DosBootsectorInitialize(VOID)
     Address += sizeof(DosKernelFileName);
     RtlCopyMemory((PVOID)Address, Bootsector2, sizeof(Bootsector2));
     Address += sizeof(Bootsector2);
+    MemInvalidateCode((PVOID)StartAddress, Address - StartAddress);
 
     /* Initialize the callback context */
     InitializeContext(&DosContext, 0x0000,
@@ -1160,6 +1163,7 @@ static VOID WINAPI DosInitialize(LPWORD Stack)
                                    REAL_TO_PHYS(TO_LINEAR(0x0070, 0x0000)),
                                    ulDosBiosSize,
                                    &ulDosBiosSize);
+        if (Success) MemInvalidateCode(REAL_TO_PHYS(TO_LINEAR(0x0070, 0x0000)), ulDosBiosSize);
 
         DPRINT1("DOS BIOS file '%s' loading %s at %04X:%04X, size 0x%X (Error: %u).\n",
                 DosBiosFileName,
@@ -1183,6 +1187,7 @@ Quit:
     {
         /* Load the 16-bit startup code for DOS32 and register its Starting BOP */
         RtlCopyMemory(SEG_OFF_TO_PTR(0x0070, 0x0000), Startup, sizeof(Startup));
+        MemInvalidateCode(SEG_OFF_TO_PTR(0x0070, 0x0000), sizeof(Startup));
 
         // This is the equivalent of BOP_LOAD_DOS, function 0x11 "Load the DOS kernel"
         // for the Windows NT DOS.
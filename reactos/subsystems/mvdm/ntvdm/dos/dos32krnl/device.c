@@ -20,6 +20,7 @@
 #include "dos.h"
 #include "dos/dem.h"
 #include "memory.h"
+#include "../../memory.h"
 
 /* PRIVATE VARIABLES **********************************************************/
 
@@ -631,6 +632,7 @@ DWORD DosLoadDriver(LPCSTR DriverFile)
     Driver = MAKELONG(0, Segment);
     DriverHeader = (PDOS_DRIVER)FAR_POINTER(Driver);
     RtlCopyMemory(DriverHeader, Address, FileSize);
+    MemInvalidateCode(DriverHeader, FileSize);
 
     /* Loop through all the drivers in this file */
     while (TRUE)
@@ -242,6 +242,9 @@ static UCHAR EmsMap(USHORT Handle, UCHAR PhysicalPage, USHORT LogicalPage)
     if (PhysicalPage >= EMS_PHYSICAL_PAGES)
         return EMS_STATUS_INV_PHYSICAL_PAGE;
 
+    /* Other memory shows up in the page frame, drop the code decoded from it */
+    MemInvalidateCode(SEG_OFF_TO_PTR(EmsSegment, PhysicalPage * EMS_PAGE_SIZE), EMS_PAGE_SIZE);
+
     if (LogicalPage == 0xFFFF)
     {
         /* Unmap */
@@ -334,6 +337,7 @@ static VOID WINAPI EmsIntHandler(LPWORD Stack)
         {
             // FIXME: This depends on an EMS handle given in DX
             RtlCopyMemory(Mapping, MappingBackup, sizeof(Mapping));
+            MemInvalidateCode(SEG_OFF_TO_PTR(EmsSegment, 0), EMS_PHYSICAL_PAGES * EMS_PAGE_SIZE);
             setAH(EMS_STATUS_SUCCESS);
             break;
         }
@@ -636,6 +640,17 @@ static VOID WINAPI EmsIntHandler(LPWORD Stack)
                 RtlMoveMemory(DestPtr, SourcePtr, Data->RegionLength);
             }
 
+            /*
+             * Drop the code decoded from the conventional memory written to.
+             * Expanded memory can be seen through the page frame, flush it too.
+             */
+            if (!Data->DestType)
+                MemInvalidateCode(DestPtr, Data->RegionLength);
+            if (Exchange && !Data->SourceType)
+                MemInvalidateCode(SourcePtr, Data->RegionLength);
+            if (Data->DestType || (Exchange && Data->SourceType))
+                MemInvalidateCode(SEG_OFF_TO_PTR(EmsSegment, 0), EMS_PHYSICAL_PAGES * EMS_PAGE_SIZE);
+
             setAH(EMS_STATUS_SUCCESS);
             break;
         }
@@ -243,6 +243,8 @@ static UCHAR XmsAlloc(WORD Size, PWORD Handle)
         RtlMoveMemory((PVOID)REAL_TO_PHYS(HandleEntry->Address - RunSize * XMS_BLOCK_SIZE),
                       (PVOID)REAL_TO_PHYS(HandleEntry->Address),
                       RunSize * XMS_BLOCK_SIZE);
+        MemInvalidateCode(REAL_TO_PHYS(HandleEntry->Address - RunSize * XMS_BLOCK_SIZE),
+                          RunSize * XMS_BLOCK_SIZE);
 
         /* Update the address */
         HandleEntry->Address -= RunSize * XMS_BLOCK_SIZE;
@@ -334,6 +336,8 @@ static UCHAR XmsRealloc(WORD Handle, WORD NewSize)
                 RtlMoveMemory((PVOID)REAL_TO_PHYS(XMS_ADDRESS + RunStart * XMS_BLOCK_SIZE),
                               (PVOID)REAL_TO_PHYS(HandleEntry->Address),
                               HandleEntry->Size * XMS_BLOCK_SIZE);
+                MemInvalidateCode(REAL_TO_PHYS(XMS_ADDRESS + RunStart * XMS_BLOCK_SIZE),
+                                  HandleEntry->Size * XMS_BLOCK_SIZE);
 
                 /* Update the handle entry */
                 HandleEntry->Address = XMS_ADDRESS + RunStart * XMS_BLOCK_SIZE;
@@ -644,6 +648,7 @@ static VOID WINAPI XmsBopProcedure(LPWORD Stack)
 
             /* Perform the move */
             RtlMoveMemory(DestAddress, SourceAddress, CopyData->Count);
+            MemInvalidateCode(DestAddress, CopyData->Count);
 
             setAX(1);
             setBL(XMS_STATUS_SUCCESS);
@@ -23,6 +23,7 @@
 #include "handle.h"
 #include "process.h"
 #include "memory.h"
+#include "../../memory.h"
 
 #include "bios/bios.h"
 
@@ -553,6 +554,9 @@ DWORD DosLoadExecutableInternal(IN DOS_EXEC_TYPE LoadType,
             *RelocWord += RelocFactor;
         }
 
+        /* Something else may have run from there before */
+        MemInvalidateCode(SEG_OFF_TO_PTR(LoadSegment, 0), BaseSize << 4);
+
         /* Set the stack to the location from the header */
         FinalSS = LoadSegment + Header->e_ss;
         FinalSP = Header->e_sp;
@@ -608,6 +612,7 @@ DWORD DosLoadExecutableInternal(IN DOS_EXEC_TYPE LoadType,
         /* Copy the program to the code segment */
         RtlCopyMemory(SEG_OFF_TO_PTR(LoadSegment, 0),
                       ExeBuffer, ExeBufferSize);
+        MemInvalidateCode(SEG_OFF_TO_PTR(LoadSegment, 0), ExeBufferSize);
 
         /* Set the stack to the last word of the segment */
         FinalSS = Segment;
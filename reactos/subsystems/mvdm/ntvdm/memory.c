@@ -185,14 +185,18 @@ VOID FASTCALL EmulatorWriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buf
     ULONG i, Offset, Length;
     ULONG FirstPage, LastPage;
 
-    UNREFERENCED_PARAMETER(State);
-
     /* If the A20 line is disabled, mask bit 20 */
     if (!A20Line) Address &= ~(1 << 20);
 
     if (Address >= MAX_ADDRESS) return;
     Size = min(Size, MAX_ADDRESS - Address);
 
+    /*
+     * The host writes here too (DMA, BIOS), drop the code decoded from there.
+     * Paging isn't used by the guests we run, so linear is physical.
+     */
+    Fast486InvalidateCache(State, Address, Size);
+
     FirstPage = Address >> 12;
     LastPage = (Address + Size - 1) >> 12;
 
@@ -213,6 +217,31 @@ VOID FASTCALL EmulatorWriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buf
     }
 }
 
+VOID MemInvalidateCode(PVOID HostAddress, ULONG Size)
+{
+    /*
+     * The BIOS and the DOS write code into the guest memory through host
+     * pointers too (program loading, XMS and EMS moves), the CPU must not
+     * keep running what it decoded there before.
+     */
+    Fast486InvalidateCache(&EmulatorContext, (ULONG)(ULONG_PTR)PHYS_TO_REAL(HostAddress), Size);
+}
+
+BOOLEAN FASTCALL EmulatorMapMemory(PFAST486_STATE State, ULONG Address, BOOLEAN Writing, PVOID *HostAddress)
+{
+    UNREFERENCED_PARAMETER(State);
+    UNREFERENCED_PARAMETER(Writing);
+
+    /* If the A20 line is disabled, mask bit 20 */
+    if (!A20Line) Address &= ~(1 << 20);
+
+    /* Hooked pages and what lies above the RAM must go through the callbacks */
+    if (Address >= MAX_ADDRESS || PageTable[Address >> 12] != NULL) return FALSE;
+
+    *HostAddress = REAL_TO_PHYS(Address);
+    return TRUE;
+}
+
 VOID FASTCALL EmulatorCopyMemory(PFAST486_STATE State, ULONG DestAddress, ULONG SrcAddress, ULONG Size)
 {
     /*
@@ -272,6 +301,9 @@ VOID FASTCALL EmulatorCopyMemory(PFAST486_STATE State, ULONG DestAddress, ULONG
 VOID EmulatorSetA20(BOOLEAN Enabled)
 {
     A20Line = Enabled;
+
+    /* The pages above 1 MB now map elsewhere */
+    Fast486FlushMemoryMap(&EmulatorContext);
 }
 
 BOOLEAN EmulatorGetA20(VOID)
@@ -343,6 +375,9 @@ MemInstallFastMemoryHook(PVOID Address,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    /* The CPU mustn't access these pages directly anymore */
+    Fast486FlushMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
@@ -371,6 +406,9 @@ MemRemoveFastMemoryHook(PVOID Address, ULONG Size)
         PageTable[i] = NULL;
     }
 
+    /* Let the CPU access these pages directly again */
+    Fast486FlushMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
@@ -539,6 +577,9 @@ VDDInstallMemoryHook(IN HANDLE hVdd,
     /* Add the hook entry to the page table */
     for (i = FirstPage; i <= LastPage; i++) PageTable[i] = Hook;
 
+    /* The CPU mustn't access these pages directly anymore */
+    Fast486FlushMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
@@ -595,6 +636,9 @@ VDDDeInstallMemoryHook(IN HANDLE hVdd,
         PageTable[i] = NULL;
     }
 
+    /* Let the CPU access these pages directly again */
+    Fast486FlushMemoryMap(&EmulatorContext);
+
     return TRUE;
 }
 
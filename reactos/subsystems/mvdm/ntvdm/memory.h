@@ -55,6 +55,16 @@ EmulatorWriteMemory
     ULONG Size
 );
 
+BOOLEAN
+FASTCALL
+EmulatorMapMemory
+(
+    PFAST486_STATE State,
+    ULONG Address,
+    BOOLEAN Writing,
+    PVOID *HostAddress
+);
+
 VOID
 FASTCALL
 EmulatorCopyMemory
@@ -65,6 +75,13 @@ EmulatorCopyMemory
     ULONG Size
 );
 
+VOID
+MemInvalidateCode
+(
+    PVOID HostAddress,
+    ULONG Size
+);
+
 VOID EmulatorSetA20(BOOLEAN Enabled);
 BOOLEAN EmulatorGetA20(VOID);
 
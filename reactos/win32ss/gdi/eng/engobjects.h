@@ -118,6 +118,8 @@ typedef struct _SHARED_FACE {
   FT_Face       Face;
   LONG          RefCount;
   PSHARED_MEM   Memory;
+  FT_Long       FaceIndex;      /* To load the face later when it came from the font catalogue */
+  PLIST_ENTRY   GlyphCache;     /* Hash buckets of the cached glyphs, allocated on first use */
 } SHARED_FACE, *PSHARED_FACE;
 
 typedef struct _FONTGDI {
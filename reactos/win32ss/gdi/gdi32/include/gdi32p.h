@@ -314,12 +314,12 @@ BOOL FASTCALL LoadTheSpoolerDrv(VOID);
 
 FORCEINLINE
 PVOID
-GdiAllocBatchCommand(
+GdiAllocBatchCommandEx(
     HDC hdc,
-    USHORT Cmd)
+    USHORT Cmd,
+    ULONG cjSize)
 {
     PTEB pTeb;
-    USHORT cjSize;
     PGDIBATCHHDR pHdr;
 
     /* Get a pointer to the TEB */
@@ -328,40 +328,27 @@ GdiAllocBatchCommand(
     /* Check if we have a valid environment */
     if (!pTeb || !pTeb->Win32ThreadInfo) return NULL;
 
-    /* Do we use a DC? */
-    if (hdc)
-    {
-        /* If the batch DC is NULL, we set this one as the new one */
-        if (!pTeb->GdiTebBatch.HDC) pTeb->GdiTebBatch.HDC = hdc;
+    /* A batch limit of 1 disables batching */
+    if (GDI_BatchLimit <= 1) return NULL;
 
-        /* If not, check if the batch DC equal to our DC */
-        else if (pTeb->GdiTebBatch.HDC != hdc) return NULL;
-    }
+    /* Keep the entries aligned, and check that it fits at all */
+    cjSize = (cjSize + sizeof(ULONG_PTR) - 1) & ~(sizeof(ULONG_PTR) - 1);
+    if ((cjSize == 0) || (cjSize > GDIBATCHBUFSIZE)) return NULL;
 
-    /* Get the size of the entry */
-    if      (Cmd == GdiBCPatBlt) cjSize = 0;
-    else if (Cmd == GdiBCPolyPatBlt) cjSize = 0;
-    else if (Cmd == GdiBCTextOut) cjSize = 0;
-    else if (Cmd == GdiBCExtTextOut) cjSize = 0;
-    else if (Cmd == GdiBCSetBrushOrg) cjSize = sizeof(GDIBSSETBRHORG);
-    else if (Cmd == GdiBCExtSelClipRgn) cjSize = 0;
-    else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
-    else if (Cmd == GdiBCDelRgn) cjSize = sizeof(GDIBSOBJECT);
-    else if (Cmd == GdiBCDelObj) cjSize = sizeof(GDIBSOBJECT);
-    else cjSize = 0;
-
-    /* Unsupported operation */
-    if (cjSize == 0) return NULL;
-
-    /* Check if the buffer is full */
+    /* Check if the buffer is full, or if the batch belongs to another DC */
     if ((pTeb->GdiBatchCount >= GDI_BatchLimit) ||
-        ((pTeb->GdiTebBatch.Offset + cjSize) > GDIBATCHBUFSIZE))
+        ((pTeb->GdiTebBatch.Offset + cjSize) > GDIBATCHBUFSIZE) ||
+        (hdc && pTeb->GdiTebBatch.HDC && (pTeb->GdiTebBatch.HDC != hdc)))
     {
         /* Call win32k, the kernel will call NtGdiFlushUserBatch to flush
            the current batch */
         NtGdiFlush();
     }
 
+    /* If the batch DC is NULL, we set this one as the new one. This must
+       come after the flush, which clears it */
+    if (hdc && !pTeb->GdiTebBatch.HDC) pTeb->GdiTebBatch.HDC = hdc;
+
     /* Get the head of the entry */
     pHdr = (PVOID)((PUCHAR)pTeb->GdiTebBatch.Buffer + pTeb->GdiTebBatch.Offset);
 
@@ -371,11 +358,36 @@ GdiAllocBatchCommand(
 
     /* Fill in the core fields */
     pHdr->Cmd = Cmd;
-    pHdr->Size = cjSize;
+    pHdr->Size = (SHORT)cjSize;
 
     return pHdr;
 }
 
+FORCEINLINE
+PVOID
+GdiAllocBatchCommand(
+    HDC hdc,
+    USHORT Cmd)
+{
+    ULONG cjSize;
+
+    /* Get the size of the entry. GdiBCPolyPatBlt and GdiBCTextOut have a
+       variable size and use GdiAllocBatchCommandEx */
+    if      (Cmd == GdiBCPatBlt) cjSize = sizeof(GDIBSPATBLT);
+    else if (Cmd == GdiBCExtTextOut) cjSize = sizeof(GDIBSEXTTEXTOUT);
+    else if (Cmd == GdiBCSetBrushOrg) cjSize = sizeof(GDIBSSETBRHORG);
+    else if (Cmd == GdiBCExtSelClipRgn) cjSize = 0;
+    else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
+    else if (Cmd == GdiBCDelRgn) cjSize = sizeof(GDIBSOBJECT);
+    else if (Cmd == GdiBCDelObj) cjSize = sizeof(GDIBSOBJECT);
+    else cjSize = 0;
+
+    /* Unsupported operation */
+    if (cjSize == 0) return NULL;
+
+    return GdiAllocBatchCommandEx(hdc, Cmd, cjSize);
+}
+
 FORCEINLINE
 PDC_ATTR
 GdiGetDcAttr(HDC hdc)
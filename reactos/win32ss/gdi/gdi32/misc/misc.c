@@ -867,8 +867,12 @@ GdiSetBatchLimit(DWORD	Limit)
 {
     DWORD OldLimit = GDI_BatchLimit;
 
-    if ( (!Limit) ||
-            (Limit >= GDI_BATCH_LIMIT))
+    /* Zero restores the default, one turns batching off */
+    if (!Limit)
+    {
+        Limit = GDI_BATCH_LIMIT;
+    }
+    else if (Limit > GDI_BATCH_LIMIT)
     {
         return Limit;
     }
@@ -456,9 +456,42 @@ PatBlt(
     _In_ INT nHeight,
     _In_ DWORD dwRop)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, PatBlt, FALSE, hdc, nXLeft, nYLeft, nWidth, nHeight, dwRop);
 
-    /* FIXME some part need be done in user mode */
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+
+    /* Batch it, unless the bits of a DIB section can be looked at directly */
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION) && !ROP_USES_SOURCE(dwRop))
+    {
+        PGDIBSPATBLT pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCPatBlt);
+        if (pgO)
+        {
+            /* Changing the DC state now has to flush the batch first */
+            pdcattr->ulDirty_ |= (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
+
+            pgO->nXLeft = nXLeft;
+            pgO->nYLeft = nYLeft;
+            pgO->nWidth = nWidth;
+            pgO->nHeight = nHeight;
+            pgO->dwRop = dwRop;
+            pgO->hbrush = pdcattr->hbrush;
+            pgO->crForegroundClr = pdcattr->crForegroundClr;
+            pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+            pgO->crBrushClr = pdcattr->crBrushClr;
+            pgO->IcmBrushColor = 0;
+            pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+            pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+            pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+            pgO->ulBrushClr = pdcattr->ulBrushClr;
+            return TRUE;
+        }
+    }
+
     return NtGdiPatBlt( hdc,  nXLeft,  nYLeft,  nWidth,  nHeight,  dwRop);
 }
 
@@ -474,6 +507,7 @@ PolyPatBlt(
     UINT i;
     BOOL bResult;
     HBRUSH hbrOld;
+    PDC_ATTR pdcattr;
 
     /* Handle meta DCs */
     if ((GDI_HANDLE_GET_TYPE(hdc) == GDILoObjType_LO_METADC16_TYPE) ||
@@ -511,7 +545,48 @@ PolyPatBlt(
         return bResult;
     }
 
-    /* FIXME some part need be done in user mode */
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+
+    /* Batch it, if the rectangles fit in the batch */
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION) && !ROP_USES_SOURCE(dwRop) &&
+        (nCount > 0) &&
+        (nCount <= (GDIBATCHBUFSIZE - FIELD_OFFSET(GDIBSPPATBLT, pRect)) / sizeof(PATRECT)))
+    {
+        PGDIBSPPATBLT pgO;
+
+        pgO = GdiAllocBatchCommandEx(hdc,
+                                     GdiBCPolyPatBlt,
+                                     FIELD_OFFSET(GDIBSPPATBLT, pRect[nCount]));
+        if (pgO)
+        {
+            /* Changing the DC state now has to flush the batch first */
+            pdcattr->ulDirty_ |= (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
+
+            pgO->rop4 = dwRop;
+            pgO->Mode = dwMode;
+            pgO->Count = nCount;
+            pgO->crForegroundClr = pdcattr->crForegroundClr;
+            pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+            pgO->crBrushClr = pdcattr->crBrushClr;
+            pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+            pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+            pgO->ulBrushClr = pdcattr->ulBrushClr;
+            pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+
+            /* Same layout as the kernel uses for NtGdiPolyPatBlt */
+            for (i = 0; i < nCount; i++)
+            {
+                pgO->pRect[i].r.left = pPoly[i].nXLeft;
+                pgO->pRect[i].r.top = pPoly[i].nYLeft;
+                pgO->pRect[i].r.right = pPoly[i].nWidth;
+                pgO->pRect[i].r.bottom = pPoly[i].nHeight;
+                pgO->pRect[i].hBrush = pPoly[i].hBrush;
+            }
+            return TRUE;
+        }
+    }
+
     return NtGdiPolyPatBlt(hdc, dwRop, pPoly, nCount, dwMode);
 }
 
@@ -466,6 +466,8 @@ ExtTextOutW(
     _In_ UINT cwc,
     _In_reads_opt_(cwc) const INT *lpDx)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL,
                   ExtTextOut,
                   FALSE,
@@ -478,6 +480,78 @@ ExtTextOutW(
                   cwc,
                   lpDx);
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+
+    /* Batch it, unless the bits of a DIB section can be looked at directly
+       or the current position has to be updated */
+    if (pdcattr &&
+        !(pdcattr->ulDirty_ & DC_DIBSECTION) &&
+        !(pdcattr->lTextAlign & TA_UPDATECP))
+    {
+        if ((cwc == 0) && (fuOptions & ETO_OPAQUE) && lprc)
+        {
+            PGDIBSEXTTEXTOUT pgO;
+
+            /* Only fills the rectangle with the background color */
+            pgO = GdiAllocBatchCommand(hdc, GdiBCExtTextOut);
+            if (pgO)
+            {
+                /* Changing the DC state now has to flush the batch first */
+                pdcattr->ulDirty_ |= (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
+
+                pgO->Count = cwc;
+                pgO->Options = fuOptions;
+                pgO->Rect = *lprc;
+                pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+                pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+                return TRUE;
+            }
+        }
+        else if ((cwc > 0) && lpString)
+        {
+            PGDIBSTEXTOUT pgO;
+            ULONG cjDx, cjSize;
+
+            cjDx = lpDx ? cwc * ((fuOptions & ETO_PDY) ? 2 : 1) * sizeof(INT) : 0;
+            cjSize = FIELD_OFFSET(GDIBSTEXTOUT, String) + cjDx + cwc * sizeof(WCHAR);
+            if ((cwc < GDIBATCHBUFSIZE) && (cjSize <= GDIBATCHBUFSIZE))
+            {
+                pgO = GdiAllocBatchCommandEx(hdc, GdiBCTextOut, cjSize);
+                if (pgO)
+                {
+                    /* Changing the DC state now has to flush the batch first */
+                    pdcattr->ulDirty_ |= (DC_MODE_DIRTY|DC_FONTTEXT_DIRTY);
+
+                    pgO->crForegroundClr = pdcattr->crForegroundClr;
+                    pgO->crBackgroundClr = pdcattr->crBackgroundClr;
+                    pgO->lmBkMode = pdcattr->lBkMode;
+                    pgO->ulForegroundClr = pdcattr->ulForegroundClr;
+                    pgO->ulBackgroundClr = pdcattr->ulBackgroundClr;
+                    pgO->x = x;
+                    pgO->y = y;
+                    pgO->Options = fuOptions;
+                    if (lprc)
+                        pgO->Rect = *lprc;
+                    else
+                        pgO->Options |= GDIBS_NORECT;
+                    pgO->iCS_CP = 0;
+                    pgO->cbCount = cwc;
+                    pgO->Size = cjDx;
+                    pgO->hlfntNew = pdcattr->hlfntNew;
+                    pgO->flTextAlign = pdcattr->lTextAlign;
+                    pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+
+                    /* The Dx array comes first, then the string */
+                    if (cjDx)
+                        RtlCopyMemory(pgO->String, lpDx, cjDx);
+                    RtlCopyMemory((PUCHAR)pgO->String + cjDx, lpString, cwc * sizeof(WCHAR));
+                    return TRUE;
+                }
+            }
+        }
+    }
+
     return NtGdiExtTextOutW(hdc,
                             x,
                             y,
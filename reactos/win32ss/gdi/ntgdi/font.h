@@ -1,12 +1,34 @@
 #pragma once
 
 
+/*
+ * FONT_NAME_... --- the names a face can be requested by
+ */
+#define FONT_NAME_FAMILY            0
+#define FONT_NAME_FULL              1
+#define FONT_NAME_ENGLISH_FAMILY    2
+#define FONT_NAME_ENGLISH_FULL      3
+#define FONT_NAME_COUNT             4
+
+struct _FONT_ENTRY;
+
+typedef struct _FONT_NAME_LINK
+{
+    LIST_ENTRY ListEntry;   /* In the bucket of the font name index */
+    struct _FONT_ENTRY *FontEntry;
+} FONT_NAME_LINK, *PFONT_NAME_LINK;
+
 typedef struct _FONT_ENTRY
 {
     LIST_ENTRY ListEntry;
     FONTGDI *Font;
     UNICODE_STRING FaceName;
     BYTE NotEnum;
+    /* What font matching needs, so that it never has to touch the face */
+    BYTE StyleItalic;
+    TEXTMETRICW TextMetric;
+    UNICODE_STRING Names[FONT_NAME_COUNT];
+    FONT_NAME_LINK NameLinks[FONT_NAME_COUNT];
 } FONT_ENTRY, *PFONT_ENTRY;
 
 typedef struct _FONT_ENTRY_MEM
@@ -24,11 +46,17 @@ typedef struct _FONT_ENTRY_COLL_MEM
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
-    int GlyphIndex;
-    FT_Face Face;
+    LIST_ENTRY ListEntry;   /* In the global LRU list */
+    LIST_ENTRY HashEntry;   /* In the hash bucket of the face */
+    PSHARED_FACE SharedFace;
     FT_BitmapGlyph BitmapGlyph;
-    int Height;
+    SIZE_T Size;
+    int GlyphIndex;
+    FT_Render_Mode RenderMode;
+    FT_Fixed XScale;
+    FT_Fixed YScale;
+    FT_UShort XPpem;
+    FT_UShort YPpem;
     MATRIX mxWorldToDevice;
 } FONT_CACHE_ENTRY, *PFONT_CACHE_ENTRY;
 
@@ -61,3 +89,53 @@ typedef struct GDI_LOAD_FONT
     PFONT_ENTRY_MEM     PrivateEntry;
 } GDI_LOAD_FONT, *PGDI_LOAD_FONT;
 
+/*
+ * FONT_CATALOG_... --- the font catalogue file.
+ * It describes every face of the system font directory, so the faces
+ * do not have to be opened at startup. For each font file it holds a
+ * FONT_CATALOG_FILE followed by the file name, then one FONT_CATALOG_FACE
+ * per font entry, each followed by its face name and FONT_NAME_COUNT names.
+ * Files without any usable face are kept with a FaceCount of zero, so that
+ * they do not make the catalogue look stale at every boot.
+ */
+#define FONT_CATALOG_MAGIC      'CtnF'
+#define FONT_CATALOG_VERSION    1
+
+typedef struct _FONT_CATALOG_HEADER
+{
+    ULONG           Magic;
+    ULONG           Version;
+    ULONG           FileCount;
+    USHORT          LanguageID;
+    USHORT          Reserved;
+} FONT_CATALOG_HEADER, *PFONT_CATALOG_HEADER;
+
+typedef struct _FONT_CATALOG_FILE
+{
+    LARGE_INTEGER   LastWriteTime;
+    LARGE_INTEGER   FileSize;
+    ULONG           FaceCount;
+    USHORT          FileNameLength;
+    USHORT          Reserved;
+} FONT_CATALOG_FILE, *PFONT_CATALOG_FILE;
+
+typedef struct _FONT_CATALOG_FACE
+{
+    LONG            FaceIndex;
+    LONG            OriginalWeight;
+    BYTE            CharSet;
+    BYTE            OriginalItalic;
+    BYTE            StyleItalic;
+    BYTE            Reserved;
+    TEXTMETRICW     TextMetric;
+    USHORT          FaceNameLength;
+    USHORT          NameLengths[FONT_NAME_COUNT];
+} FONT_CATALOG_FACE, *PFONT_CATALOG_FACE;
+
+/* A file of the font directory which did not give any face */
+typedef struct _FONT_CATALOG_EMPTY_FILE
+{
+    LIST_ENTRY      ListEntry;
+    UNICODE_STRING  FileName;
+} FONT_CATALOG_EMPTY_FILE, *PFONT_CATALOG_EMPTY_FILE;
+
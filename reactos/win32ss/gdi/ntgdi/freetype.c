@@ -68,6 +68,16 @@ static LIST_ENTRY FontListHead;
 static PFAST_MUTEX FontListLock;
 static BOOL RenderingEnabled = TRUE;
 
+/* The global fonts, hashed by every name they can be requested by.
+   Protected by the global font lock */
+#define FONT_NAME_HASH_SIZE 256
+static LIST_ENTRY FontNameHash[FONT_NAME_HASH_SIZE];
+
+/* The font catalogue, so that the system fonts are not parsed at every boot */
+static UNICODE_STRING FontCatalogPath =
+    RTL_CONSTANT_STRING(L"\\SystemRoot\\System32\\FNTCACHE.DAT");
+#define MAX_FONT_CATALOG_SIZE   (16 * 1024 * 1024)
+
 #define IntLockGlobalFonts \
   ExEnterCriticalRegionAndAcquireFastMutexUnsafe(FontListLock)
 
@@ -86,10 +96,14 @@ static BOOL RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_HELD() \
   ASSERT(FreeTypeLock->Owner == KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is bounded by the memory its bitmaps take, not by the
+   number of glyphs. Every face hashes its own glyphs, eviction goes through
+   one LRU list shared by all faces. */
+#define MAX_FONT_CACHE_SIZE     (1024 * 1024)
+#define FONT_CACHE_HASH_SIZE    64
 
 static LIST_ENTRY FontCacheListHead;
-static UINT FontCacheNumEntries;
+static SIZE_T FontCacheSize;
 
 static PWCHAR ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -163,6 +177,9 @@ static const CHARSETINFO FontTci[MAXTCIINDEX] =
 /* list head */
 static RTL_STATIC_LIST_HEAD(FontSubstListHead);
 
+static VOID FASTCALL IntGetFontEntryInfo(PFONT_ENTRY Entry);
+static VOID FASTCALL CleanupFontEntry(PFONT_ENTRY FontEntry);
+
 static void
 SharedMem_AddRef(PSHARED_MEM Ptr)
 {
@@ -171,8 +188,9 @@ SharedMem_AddRef(PSHARED_MEM Ptr)
     ++Ptr->RefCount;
 }
 
+/* Face and Memory are NULL for a face from the font catalogue that was not loaded yet */
 static PSHARED_FACE
-SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
+SharedFace_Create(FT_Face Face, PSHARED_MEM Memory, FT_Long FaceIndex)
 {
     PSHARED_FACE Ptr;
     Ptr = ExAllocatePoolWithTag(PagedPool, sizeof(SHARED_FACE), TAG_FONT);
@@ -181,8 +199,13 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Face = Face;
         Ptr->RefCount = 1;
         Ptr->Memory = Memory;
-        SharedMem_AddRef(Memory);
-        DPRINT("Creating SharedFace for %s\n", Face->family_name);
+        Ptr->FaceIndex = FaceIndex;
+        Ptr->GlyphCache = NULL;
+        if (Memory)
+        {
+            SharedMem_AddRef(Memory);
+            DPRINT("Creating SharedFace for %s\n", Face->family_name);
+        }
     }
     return Ptr;
 }
@@ -218,30 +241,37 @@ RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
+    RemoveEntryList(&Entry->HashEntry);
+    ASSERT(FontCacheSize >= Entry->Size);
+    FontCacheSize -= Entry->Size;
     ExFreePoolWithTag(Entry, TAG_FONT);
-    FontCacheNumEntries--;
-    ASSERT(FontCacheNumEntries <= MAX_FONT_CACHE);
 }
 
 static void
-RemoveCacheEntries(FT_Face Face)
+RemoveCacheEntries(PSHARED_FACE SharedFace)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY Bucket;
     PFONT_CACHE_ENTRY FontEntry;
+    UINT i;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    CurrentEntry = FontCacheListHead.Flink;
-    while (CurrentEntry != &FontCacheListHead)
-    {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        CurrentEntry = CurrentEntry->Flink;
+    if (!SharedFace->GlyphCache)
+        return;
 
-        if (FontEntry->Face == Face)
+    /* Only this face's own buckets need to be walked */
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+    {
+        Bucket = &SharedFace->GlyphCache[i];
+        while (!IsListEmpty(Bucket))
         {
+            FontEntry = CONTAINING_RECORD(Bucket->Flink, FONT_CACHE_ENTRY, HashEntry);
             RemoveCachedEntry(FontEntry);
         }
     }
+
+    ExFreePoolWithTag(SharedFace->GlyphCache, TAG_FONT);
+    SharedFace->GlyphCache = NULL;
 }
 
 static void SharedMem_Release(PSHARED_MEM Ptr)
@@ -276,10 +306,13 @@ SharedFace_Release(PSHARED_FACE Ptr)
     --Ptr->RefCount;
     if (Ptr->RefCount == 0)
     {
-        DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name);
-        RemoveCacheEntries(Ptr->Face);
-        FT_Done_Face(Ptr->Face);
-        SharedMem_Release(Ptr->Memory);
+        if (Ptr->Face)
+        {
+            DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name);
+            RemoveCacheEntries(Ptr);
+            FT_Done_Face(Ptr->Face);
+            SharedMem_Release(Ptr->Memory);
+        }
         ExFreePoolWithTag(Ptr, TAG_FONT);
     }
     IntUnLockFreeType;
@@ -431,10 +464,13 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    ULONG i;
 
     InitializeListHead(&FontListHead);
+    for (i = 0; i < FONT_NAME_HASH_SIZE; ++i)
+        InitializeListHead(&FontNameHash[i]);
     InitializeListHead(&FontCacheListHead);
-    FontCacheNumEntries = 0;
+    FontCacheSize = 0;
     /* Fast Mutexes must be allocated from non paged pool */
     FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (FontListLock == NULL)
@@ -595,6 +631,792 @@ SubstituteFontRecurse(PUNICODE_STRING pInOutName, BYTE *pRequestedCharSet)
     return TRUE;    /* success */
 }
 
+/*
+ * IntMapFontFile
+ *
+ * Maps a font file into system space.
+ */
+static PSHARED_MEM
+IntMapFontFile(PUNICODE_STRING FileName)
+{
+    NTSTATUS Status;
+    HANDLE FileHandle;
+    PVOID Buffer = NULL;
+    IO_STATUS_BLOCK Iosb;
+    PVOID SectionObject;
+    ULONG ViewSize = 0;
+    LARGE_INTEGER SectionSize;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    PSHARED_MEM Memory;
+
+    /* Open the font file */
+    InitializeObjectAttributes(&ObjectAttributes, FileName, 0, NULL, NULL);
+    Status = ZwOpenFile(
+                 &FileHandle,
+                 FILE_GENERIC_READ | SYNCHRONIZE,
+                 &ObjectAttributes,
+                 &Iosb,
+                 FILE_SHARE_READ,
+                 FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT("Could not load font file: %wZ\n", FileName);
+        return NULL;
+    }
+
+    SectionSize.QuadPart = 0LL;
+    Status = MmCreateSection(&SectionObject, SECTION_ALL_ACCESS,
+                             NULL, &SectionSize, PAGE_READONLY,
+                             SEC_COMMIT, FileHandle, NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT("Could not map file: %wZ\n", FileName);
+        ZwClose(FileHandle);
+        return NULL;
+    }
+    ZwClose(FileHandle);
+
+    /* The view keeps the section alive */
+    Status = MmMapViewInSystemSpace(SectionObject, &Buffer, &ViewSize);
+    ObDereferenceObject(SectionObject);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT("Could not map file: %wZ\n", FileName);
+        return NULL;
+    }
+
+    Memory = SharedMem_Create(Buffer, ViewSize, TRUE);
+    if (!Memory)
+        MmUnmapViewInSystemSpace(Buffer);
+
+    return Memory;
+}
+
+/*
+ * IntLoadFontFace
+ *
+ * Fonts from the font catalogue only open their face when it is first used.
+ */
+static BOOL FASTCALL
+IntLoadFontFace(PFONTGDI FontGDI)
+{
+    PSHARED_FACE SharedFace = FontGDI->SharedFace;
+    UNICODE_STRING FileName;
+    PSHARED_MEM Memory;
+    FT_Face Face;
+    FT_Error Error;
+    BOOL Loaded;
+
+    IntLockFreeType;
+    Loaded = (SharedFace->Face != NULL);
+    IntUnLockFreeType;
+
+    if (Loaded)
+        return TRUE;
+
+    if (FontGDI->Filename == NULL)
+        return FALSE;
+
+    RtlInitUnicodeString(&FileName, FontGDI->Filename);
+    Memory = IntMapFontFile(&FileName);
+    if (!Memory)
+        return FALSE;
+
+    IntLockFreeType;
+    /* Somebody else may have been faster */
+    if (SharedFace->Face == NULL)
+    {
+        Error = FT_New_Memory_Face(library,
+                                   Memory->Buffer,
+                                   Memory->BufferSize,
+                                   SharedFace->FaceIndex,
+                                   &Face);
+        if (!Error)
+        {
+            SharedFace->Face = Face;
+            SharedFace->Memory = Memory;
+            SharedMem_AddRef(Memory);
+        }
+        else
+        {
+            DPRINT1("Error reading font %wZ (error code: %d)\n", &FileName, Error);
+        }
+    }
+    Loaded = (SharedFace->Face != NULL);
+    SharedMem_Release(Memory);
+    IntUnLockFreeType;
+
+    return Loaded;
+}
+
+static ULONG
+IntHashFontName(PUNICODE_STRING Name)
+{
+    ULONG Hash = 0;
+    USHORT i;
+
+    for (i = 0; i < Name->Length / sizeof(WCHAR); ++i)
+        Hash = Hash * 31 + RtlUpcaseUnicodeChar(Name->Buffer[i]);
+
+    return Hash % FONT_NAME_HASH_SIZE;
+}
+
+static VOID
+IntInitFontEntryNames(PFONT_ENTRY Entry)
+{
+    UINT i;
+
+    for (i = 0; i < FONT_NAME_COUNT; ++i)
+    {
+        RtlInitUnicodeString(&Entry->Names[i], NULL);
+        InitializeListHead(&Entry->NameLinks[i].ListEntry);
+        Entry->NameLinks[i].FontEntry = Entry;
+    }
+}
+
+/* Add a global font to the font name index */
+static VOID
+IntLinkFontEntryNames(PFONT_ENTRY Entry)
+{
+    UINT i;
+
+    ASSERT_GLOBALFONTS_LOCK_HELD();
+
+    for (i = 0; i < FONT_NAME_COUNT; ++i)
+    {
+        if (Entry->Names[i].Length == 0)
+            continue;
+
+        InsertTailList(&FontNameHash[IntHashFontName(&Entry->Names[i])],
+                       &Entry->NameLinks[i].ListEntry);
+    }
+}
+
+static VOID
+IntFreeFontEntryNames(PFONT_ENTRY Entry)
+{
+    UINT i;
+
+    for (i = 0; i < FONT_NAME_COUNT; ++i)
+    {
+        if (!IsListEmpty(&Entry->NameLinks[i].ListEntry))
+            RemoveEntryList(&Entry->NameLinks[i].ListEntry);
+
+        RtlFreeUnicodeString(&Entry->Names[i]);
+    }
+}
+
+static ULONG
+IntGetCatalogFaceSize(PFONT_CATALOG_FACE CatalogFace)
+{
+    ULONG Size;
+    UINT i;
+
+    Size = sizeof(FONT_CATALOG_FACE) + CatalogFace->FaceNameLength;
+    for (i = 0; i < FONT_NAME_COUNT; ++i)
+        Size += CatalogFace->NameLengths[i];
+
+    return ALIGN_UP_BY(Size, sizeof(LARGE_INTEGER));
+}
+
+static ULONG
+IntGetCatalogFileSize(PFONT_CATALOG_FILE CatalogFile)
+{
+    return ALIGN_UP_BY(sizeof(FONT_CATALOG_FILE) + CatalogFile->FileNameLength,
+                       sizeof(LARGE_INTEGER));
+}
+
+/*
+ * IntReadFontCatalog
+ *
+ * Reads the font catalogue and returns the font files it describes, or NULL
+ * when there is no usable catalogue.
+ */
+static PFONT_CATALOG_FILE *
+IntReadFontCatalog(PVOID *pCatalog, ULONG *pFileCount)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    FILE_STANDARD_INFORMATION FileInfo;
+    IO_STATUS_BLOCK Iosb;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+    PFONT_CATALOG_HEADER Header;
+    PFONT_CATALOG_FILE *Files = NULL;
+    PFONT_CATALOG_FACE CatalogFace;
+    PUCHAR Catalog;
+    ULONG Size, Offset, i, j, k;
+
+    InitializeObjectAttributes(&ObjectAttributes, &FontCatalogPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwOpenFile(&FileHandle,
+                        FILE_GENERIC_READ | SYNCHRONIZE,
+                        &ObjectAttributes,
+                        &Iosb,
+                        FILE_SHARE_READ,
+                        FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE);
+    if (!NT_SUCCESS(Status))
+        return NULL;
+
+    Status = ZwQueryInformationFile(FileHandle, &Iosb, &FileInfo, sizeof(FileInfo),
+                                    FileStandardInformation);
+    if (!NT_SUCCESS(Status) ||
+        FileInfo.EndOfFile.QuadPart < sizeof(FONT_CATALOG_HEADER) ||
+        FileInfo.EndOfFile.QuadPart > MAX_FONT_CATALOG_SIZE)
+    {
+        ZwClose(FileHandle);
+        return NULL;
+    }
+
+    Size = FileInfo.EndOfFile.LowPart;
+    Catalog = ExAllocatePoolWithTag(PagedPool, Size, TAG_FONT);
+    if (!Catalog)
+    {
+        ZwClose(FileHandle);
+        return NULL;
+    }
+
+    Status = ZwReadFile(FileHandle, NULL, NULL, NULL, &Iosb, Catalog, Size, NULL, NULL);
+    ZwClose(FileHandle);
+    if (!NT_SUCCESS(Status) || Iosb.Information != Size)
+        goto Invalid;
+
+    /* Localized names depend on the language, rebuild it when that changed */
+    Header = (PFONT_CATALOG_HEADER)Catalog;
+    if (Header->Magic != FONT_CATALOG_MAGIC ||
+        Header->Version != FONT_CATALOG_VERSION ||
+        Header->LanguageID != (USHORT)gusLanguageID ||
+        Header->FileCount == 0 ||
+        Header->FileCount > Size / sizeof(FONT_CATALOG_FILE))
+    {
+        goto Invalid;
+    }
+
+    Files = ExAllocatePoolWithTag(PagedPool, Header->FileCount * sizeof(PFONT_CATALOG_FILE), TAG_FONT);
+    if (!Files)
+        goto Invalid;
+
+    /* Check that everything lies within the file before anybody trusts it */
+    Offset = ALIGN_UP_BY(sizeof(FONT_CATALOG_HEADER), sizeof(LARGE_INTEGER));
+    for (i = 0; i < Header->FileCount; ++i)
+    {
+        if (Offset > Size || Size - Offset < sizeof(FONT_CATALOG_FILE))
+            goto Invalid;
+
+        Files[i] = (PFONT_CATALOG_FILE)(Catalog + Offset);
+        if (Files[i]->FileNameLength == 0 || (Files[i]->FileNameLength & 1))
+            goto Invalid;
+        Offset += IntGetCatalogFileSize(Files[i]);
+
+        for (j = 0; j < Files[i]->FaceCount; ++j)
+        {
+            if (Offset > Size || Size - Offset < sizeof(FONT_CATALOG_FACE))
+                goto Invalid;
+
+            CatalogFace = (PFONT_CATALOG_FACE)(Catalog + Offset);
+            if (CatalogFace->FaceNameLength == 0 || (CatalogFace->FaceNameLength & 1))
+                goto Invalid;
+            for (k = 0; k < FONT_NAME_COUNT; ++k)
+            {
+                if (CatalogFace->NameLengths[k] & 1)
+                    goto Invalid;
+            }
+            Offset += IntGetCatalogFaceSize(CatalogFace);
+        }
+    }
+    if (Offset > Size)
+        goto Invalid;
+
+    *pCatalog = Catalog;
+    *pFileCount = Header->FileCount;
+    return Files;
+
+Invalid:
+    DPRINT1("Ignoring the invalid font catalogue\n");
+    if (Files)
+        ExFreePoolWithTag(Files, TAG_FONT);
+    ExFreePoolWithTag(Catalog, TAG_FONT);
+    return NULL;
+}
+
+/*
+ * IntFindCatalogFile
+ *
+ * The fonts are enumerated in the same order as last time, so the file we
+ * look for is most likely the one after the last one that was found.
+ */
+static PFONT_CATALOG_FILE
+IntFindCatalogFile(PFONT_CATALOG_FILE *Files, ULONG FileCount, ULONG *pNext,
+                   PFILE_DIRECTORY_INFORMATION DirInfo)
+{
+    UNICODE_STRING FileName, CatalogName;
+    PFONT_CATALOG_FILE CatalogFile;
+    ULONG i, Index;
+
+    FileName.Buffer = DirInfo->FileName;
+    FileName.Length = FileName.MaximumLength = (USHORT)DirInfo->FileNameLength;
+
+    for (i = 0; i < FileCount; ++i)
+    {
+        Index = (*pNext + i) % FileCount;
+        CatalogFile = Files[Index];
+
+        CatalogName.Buffer = (PWCHAR)(CatalogFile + 1);
+        CatalogName.Length = CatalogName.MaximumLength = CatalogFile->FileNameLength;
+        if (!RtlEqualUnicodeString(&FileName, &CatalogName, TRUE))
+            continue;
+
+        /* The file changed since, it has to be parsed again */
+        if (CatalogFile->LastWriteTime.QuadPart != DirInfo->LastWriteTime.QuadPart ||
+            CatalogFile->FileSize.QuadPart != DirInfo->EndOfFile.QuadPart)
+        {
+            return NULL;
+        }
+
+        *pNext = Index + 1;
+        return CatalogFile;
+    }
+
+    return NULL;
+}
+
+static BOOL
+IntCopyCatalogString(PUNICODE_STRING String, PUCHAR *pBuffer, USHORT Length)
+{
+    RtlInitUnicodeString(String, NULL);
+    if (Length == 0)
+        return TRUE;
+
+    String->Buffer = ExAllocatePoolWithTag(PagedPool, Length + sizeof(UNICODE_NULL), TAG_USTR);
+    if (!String->Buffer)
+        return FALSE;
+
+    RtlCopyMemory(String->Buffer, *pBuffer, Length);
+    String->Buffer[Length / sizeof(WCHAR)] = UNICODE_NULL;
+    String->Length = Length;
+    String->MaximumLength = Length + sizeof(UNICODE_NULL);
+    *pBuffer += Length;
+    return TRUE;
+}
+
+/* Appends a face name to the registry value name of its font file */
+static BOOL
+IntAppendFontRegValueName(PUNICODE_STRING ValueName, PUNICODE_STRING FaceName)
+{
+    UNICODE_STRING NewString;
+
+    if (ValueName->Length == 0)
+        return RtlCreateUnicodeString(ValueName, FaceName->Buffer);
+
+    NewString.Length = 0;
+    NewString.MaximumLength = ValueName->Length + 3 * sizeof(WCHAR) + FaceName->Length + sizeof(WCHAR);
+    NewString.Buffer = ExAllocatePoolWithTag(PagedPool,
+                                             NewString.MaximumLength,
+                                             TAG_USTR);
+    if (!NewString.Buffer)
+        return FALSE;
+    NewString.Buffer[0] = UNICODE_NULL;
+
+    RtlAppendUnicodeStringToString(&NewString, ValueName);
+    RtlAppendUnicodeToString(&NewString, L" & ");
+    RtlAppendUnicodeStringToString(&NewString, FaceName);
+
+    RtlFreeUnicodeString(ValueName);
+    *ValueName = NewString;
+    return TRUE;
+}
+
+/* Records a loaded font file under the Fonts key, the way Windows lists them */
+static VOID
+IntWriteFontRegValue(PUNICODE_STRING ValueName, BOOL IsTrueType, PUNICODE_STRING FileName)
+{
+    NTSTATUS Status;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE KeyHandle;
+    static const UNICODE_STRING TrueTypePostfix = RTL_CONSTANT_STRING(L" (TrueType)");
+
+    if (IsTrueType)
+    {
+        /* append " (TrueType)" */
+        UNICODE_STRING NewString;
+        USHORT Length;
+
+        Length = ValueName->Length + TrueTypePostfix.Length;
+        NewString.Length = 0;
+        NewString.MaximumLength = Length + sizeof(WCHAR);
+        NewString.Buffer = ExAllocatePoolWithTag(PagedPool,
+                                                 NewString.MaximumLength,
+                                                 TAG_USTR);
+        if (!NewString.Buffer)
+            return;
+        NewString.Buffer[0] = UNICODE_NULL;
+
+        RtlAppendUnicodeStringToString(&NewString, ValueName);
+        RtlAppendUnicodeStringToString(&NewString, &TrueTypePostfix);
+        RtlFreeUnicodeString(ValueName);
+        *ValueName = NewString;
+    }
+
+    /* registry */
+    InitializeObjectAttributes(&ObjectAttributes, &FontRegPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwOpenKey(&KeyHandle, KEY_WRITE, &ObjectAttributes);
+    if (NT_SUCCESS(Status))
+    {
+        ULONG DataSize;
+        LPWSTR pFileName = wcsrchr(FileName->Buffer, L'\\');
+        if (pFileName)
+        {
+            pFileName++;
+            DataSize = (wcslen(pFileName) + 1) * sizeof(WCHAR);
+            ZwSetValueKey(KeyHandle, ValueName, 0, REG_SZ,
+                          pFileName, DataSize);
+        }
+        ZwClose(KeyHandle);
+    }
+}
+
+/*
+ * IntGdiAddFontResourceFromCatalog
+ *
+ * Adds the faces of a system font file as the font catalogue describes them,
+ * without opening the file.
+ */
+static BOOL FASTCALL
+IntGdiAddFontResourceFromCatalog(PUNICODE_STRING FileName, PFONT_CATALOG_FILE CatalogFile)
+{
+    LIST_ENTRY NewEntries;
+    PLIST_ENTRY ListEntry;
+    PFONT_CATALOG_FACE CatalogFace;
+    PFONT_ENTRY Entry, Other;
+    PFONTGDI FontGDI;
+    PSHARED_FACE SharedFace;
+    UNICODE_STRING ValueName;
+    BOOL NewFace, IsTrueType = FALSE;
+    PUCHAR Strings;
+    ULONG i, j;
+
+    /* Nothing usable in there last time, and the file did not change */
+    if (CatalogFile->FaceCount == 0)
+        return TRUE;
+
+    InitializeListHead(&NewEntries);
+    RtlInitUnicodeString(&ValueName, NULL);
+    CatalogFace = (PFONT_CATALOG_FACE)((PUCHAR)CatalogFile + IntGetCatalogFileSize(CatalogFile));
+    for (i = 0; i < CatalogFile->FaceCount; ++i)
+    {
+        /* Entries of the same face only differ by their charset, they share the face */
+        SharedFace = NULL;
+        NewFace = FALSE;
+        for (ListEntry = NewEntries.Flink; ListEntry != &NewEntries; ListEntry = ListEntry->Flink)
+        {
+            Other = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+            if (Other->Font->SharedFace->FaceIndex == CatalogFace->FaceIndex)
+            {
+                SharedFace = Other->Font->SharedFace;
+                IntLockFreeType;
+                SharedFace_AddRef(SharedFace);
+                IntUnLockFreeType;
+                break;
+            }
+        }
+        if (!SharedFace)
+        {
+            SharedFace = SharedFace_Create(NULL, NULL, CatalogFace->FaceIndex);
+            if (!SharedFace)
+                goto Failure;
+            NewFace = TRUE;
+        }
+
+        Entry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_ENTRY), TAG_FONT);
+        if (!Entry)
+        {
+            SharedFace_Release(SharedFace);
+            goto Failure;
+        }
+        RtlZeroMemory(Entry, sizeof(FONT_ENTRY));
+        IntInitFontEntryNames(Entry);
+
+        FontGDI = EngAllocMem(FL_ZERO_MEMORY, sizeof(FONTGDI), GDITAG_RFONT);
+        if (!FontGDI)
+        {
+            SharedFace_Release(SharedFace);
+            ExFreePoolWithTag(Entry, TAG_FONT);
+            goto Failure;
+        }
+        Entry->Font = FontGDI;
+        FontGDI->SharedFace = SharedFace;
+        InsertTailList(&NewEntries, &Entry->ListEntry);
+
+        FontGDI->Filename = ExAllocatePoolWithTag(PagedPool,
+                                                  FileName->Length + sizeof(UNICODE_NULL),
+                                                  GDITAG_PFF);
+        if (!FontGDI->Filename)
+            goto Failure;
+        RtlCopyMemory(FontGDI->Filename, FileName->Buffer, FileName->Length);
+        FontGDI->Filename[FileName->Length / sizeof(WCHAR)] = UNICODE_NULL;
+
+        FontGDI->CharSet = CatalogFace->CharSet;
+        FontGDI->OriginalItalic = CatalogFace->OriginalItalic;
+        FontGDI->RequestItalic = FALSE;
+        FontGDI->OriginalWeight = CatalogFace->OriginalWeight;
+        FontGDI->RequestWeight = FW_NORMAL;
+
+        Entry->NotEnum = FALSE;
+        Entry->StyleItalic = CatalogFace->StyleItalic;
+        Entry->TextMetric = CatalogFace->TextMetric;
+
+        Strings = (PUCHAR)(CatalogFace + 1);
+        if (!IntCopyCatalogString(&Entry->FaceName, &Strings, CatalogFace->FaceNameLength))
+            goto Failure;
+        for (j = 0; j < FONT_NAME_COUNT; ++j)
+        {
+            if (!IntCopyCatalogString(&Entry->Names[j], &Strings, CatalogFace->NameLengths[j]))
+                goto Failure;
+        }
+
+        /* Name the file after its faces, as IntGdiLoadFontsFromMemory does */
+        if (NewFace)
+        {
+            if (!IntAppendFontRegValueName(&ValueName, &Entry->FaceName))
+                goto Failure;
+        }
+        if (Entry->TextMetric.tmPitchAndFamily & TMPF_TRUETYPE)
+            IsTrueType = TRUE;
+
+        CatalogFace = (PFONT_CATALOG_FACE)((PUCHAR)CatalogFace + IntGetCatalogFaceSize(CatalogFace));
+    }
+
+    /* Everything is there, publish the whole file at once */
+    IntLockGlobalFonts;
+    while (!IsListEmpty(&NewEntries))
+    {
+        ListEntry = RemoveHeadList(&NewEntries);
+        Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+        InsertTailList(&FontListHead, &Entry->ListEntry);
+        IntLinkFontEntryNames(Entry);
+    }
+    IntUnLockGlobalFonts;
+
+    /* Same as a full load, the file gets its value under the Fonts key */
+    IntWriteFontRegValue(&ValueName, IsTrueType, FileName);
+    RtlFreeUnicodeString(&ValueName);
+
+    return TRUE;
+
+Failure:
+    while (!IsListEmpty(&NewEntries))
+    {
+        ListEntry = RemoveHeadList(&NewEntries);
+        CleanupFontEntry(CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry));
+    }
+    RtlFreeUnicodeString(&ValueName);
+    return FALSE;
+}
+
+static ULONG
+IntFillCatalogFace(PFONT_CATALOG_FACE CatalogFace, PFONT_ENTRY Entry)
+{
+    PUCHAR Strings;
+    UINT i;
+
+    CatalogFace->FaceIndex = Entry->Font->SharedFace->FaceIndex;
+    CatalogFace->OriginalWeight = Entry->Font->OriginalWeight;
+    CatalogFace->CharSet = Entry->Font->CharSet;
+    CatalogFace->OriginalItalic = Entry->Font->OriginalItalic;
+    CatalogFace->StyleItalic = Entry->StyleItalic;
+    CatalogFace->Reserved = 0;
+    CatalogFace->TextMetric = Entry->TextMetric;
+
+    Strings = (PUCHAR)(CatalogFace + 1);
+    CatalogFace->FaceNameLength = Entry->FaceName.Length;
+    RtlCopyMemory(Strings, Entry->FaceName.Buffer, Entry->FaceName.Length);
+    Strings += Entry->FaceName.Length;
+    for (i = 0; i < FONT_NAME_COUNT; ++i)
+    {
+        CatalogFace->NameLengths[i] = Entry->Names[i].Length;
+        RtlCopyMemory(Strings, Entry->Names[i].Buffer, Entry->Names[i].Length);
+        Strings += Entry->Names[i].Length;
+    }
+
+    return IntGetCatalogFaceSize(CatalogFace);
+}
+
+static VOID
+IntFillCatalogFile(PFONT_CATALOG_FILE CatalogFile, PUNICODE_STRING FileName, PUNICODE_STRING FullName)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    FILE_NETWORK_OPEN_INFORMATION FileInfo;
+    NTSTATUS Status;
+
+    RtlZeroMemory(CatalogFile, sizeof(FONT_CATALOG_FILE));
+    CatalogFile->FileNameLength = FileName->Length;
+    RtlCopyMemory(CatalogFile + 1, FileName->Buffer, FileName->Length);
+
+    InitializeObjectAttributes(&ObjectAttributes, FullName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwQueryFullAttributesFile(&ObjectAttributes, &FileInfo);
+    if (NT_SUCCESS(Status))
+    {
+        CatalogFile->LastWriteTime = FileInfo.LastWriteTime;
+        CatalogFile->FileSize = FileInfo.EndOfFile;
+    }
+}
+
+/*
+ * IntWriteFontCatalog
+ *
+ * Writes the font catalogue from the system fonts that are loaded, plus
+ * the files of the font directory that have no face at all.
+ */
+static VOID FASTCALL
+IntWriteFontCatalog(PUNICODE_STRING Directory, PLIST_ENTRY EmptyFiles)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK Iosb;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+    PLIST_ENTRY ListEntry;
+    PFONT_ENTRY Entry;
+    PFONT_CATALOG_EMPTY_FILE EmptyFile;
+    PFONT_CATALOG_HEADER Header;
+    PFONT_CATALOG_FILE CatalogFile = NULL;
+    UNICODE_STRING FileName, FullName;
+    PCWSTR LastFileName;
+    PUCHAR Catalog;
+    ULONG Size, Offset, i;
+    INT Pass;
+
+    IntLockGlobalFonts;
+
+    /* Measure everything first, then fill it in */
+    Catalog = NULL;
+    Size = 0;
+    for (Pass = 0; Pass < 2; ++Pass)
+    {
+        Offset = ALIGN_UP_BY(sizeof(FONT_CATALOG_HEADER), sizeof(LARGE_INTEGER));
+        LastFileName = NULL;
+        i = 0;
+
+        for (ListEntry = FontListHead.Flink; ListEntry != &FontListHead; ListEntry = ListEntry->Flink)
+        {
+            Entry = CONTAINING_RECORD(ListEntry, FONT_ENTRY, ListEntry);
+            if (Entry->Font->Filename == NULL)
+                continue;
+
+            /* Only the files straight from the font directory */
+            RtlInitUnicodeString(&FileName, Entry->Font->Filename);
+            if (FileName.Length <= Directory->Length ||
+                _wcsnicmp(FileName.Buffer, Directory->Buffer, Directory->Length / sizeof(WCHAR)) != 0 ||
+                wcschr(FileName.Buffer + Directory->Length / sizeof(WCHAR), L'\\') != NULL)
+            {
+                continue;
+            }
+            FileName.Buffer += Directory->Length / sizeof(WCHAR);
+            FileName.Length -= Directory->Length;
+
+            /* The entries of one file follow each other */
+            if (LastFileName == NULL || _wcsicmp(LastFileName, Entry->Font->Filename) != 0)
+            {
+                LastFileName = Entry->Font->Filename;
+                ++i;
+
+                if (Catalog)
+                {
+                    CatalogFile = (PFONT_CATALOG_FILE)(Catalog + Offset);
+                    RtlInitUnicodeString(&FullName, Entry->Font->Filename);
+                    IntFillCatalogFile(CatalogFile, &FileName, &FullName);
+                }
+                Offset += ALIGN_UP_BY(sizeof(FONT_CATALOG_FILE) + FileName.Length,
+                                      sizeof(LARGE_INTEGER));
+            }
+
+            if (Catalog)
+            {
+                Offset += IntFillCatalogFace((PFONT_CATALOG_FACE)(Catalog + Offset), Entry);
+                CatalogFile->FaceCount++;
+            }
+            else
+            {
+                Offset += ALIGN_UP_BY(sizeof(FONT_CATALOG_FACE) + Entry->FaceName.Length +
+                                      Entry->Names[FONT_NAME_FAMILY].Length +
+                                      Entry->Names[FONT_NAME_FULL].Length +
+                                      Entry->Names[FONT_NAME_ENGLISH_FAMILY].Length +
+                                      Entry->Names[FONT_NAME_ENGLISH_FULL].Length,
+                                      sizeof(LARGE_INTEGER));
+            }
+        }
+
+        /* The files without faces are all in the font directory */
+        for (ListEntry = EmptyFiles->Flink; ListEntry != EmptyFiles; ListEntry = ListEntry->Flink)
+        {
+            EmptyFile = CONTAINING_RECORD(ListEntry, FONT_CATALOG_EMPTY_FILE, ListEntry);
+            FileName.Buffer = EmptyFile->FileName.Buffer + Directory->Length / sizeof(WCHAR);
+            FileName.Length = FileName.MaximumLength = EmptyFile->FileName.Length - Directory->Length;
+            ++i;
+
+            if (Catalog)
+                IntFillCatalogFile((PFONT_CATALOG_FILE)(Catalog + Offset), &FileName, &EmptyFile->FileName);
+            Offset += ALIGN_UP_BY(sizeof(FONT_CATALOG_FILE) + FileName.Length,
+                                  sizeof(LARGE_INTEGER));
+        }
+
+        if (Pass == 0)
+        {
+            if (i == 0 || Offset > MAX_FONT_CATALOG_SIZE)
+                break;
+
+            Size = Offset;
+            Catalog = ExAllocatePoolWithTag(PagedPool, Size, TAG_FONT);
+            if (!Catalog)
+                break;
+            RtlZeroMemory(Catalog, Size);
+
+            Header = (PFONT_CATALOG_HEADER)Catalog;
+            Header->Magic = FONT_CATALOG_MAGIC;
+            Header->Version = FONT_CATALOG_VERSION;
+            Header->FileCount = i;
+            Header->LanguageID = (USHORT)gusLanguageID;
+            Header->Reserved = 0;
+        }
+    }
+
+    IntUnLockGlobalFonts;
+
+    if (!Catalog)
+        return;
+
+    ASSERT(Offset == Size);
+    InitializeObjectAttributes(&ObjectAttributes, &FontCatalogPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL, NULL);
+    Status = ZwCreateFile(&FileHandle,
+                          FILE_GENERIC_WRITE | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &Iosb,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          0,
+                          FILE_OVERWRITE_IF,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+                          NULL,
+                          0);
+    if (NT_SUCCESS(Status))
+    {
+        Status = ZwWriteFile(FileHandle, NULL, NULL, NULL, &Iosb, Catalog, Size, NULL, NULL);
+        ZwClose(FileHandle);
+    }
+    if (!NT_SUCCESS(Status))
+    {
+        /* Not fatal, we will just have to parse the fonts again next time */
+        DPRINT1("Could not write the font catalogue (Status 0x%lx)\n", Status);
+    }
+
+    ExFreePoolWithTag(Catalog, TAG_FONT);
+}
+
 /*
  * IntLoadSystemFonts
  *
@@ -611,7 +1433,13 @@ IntLoadSystemFonts(VOID)
     PFILE_DIRECTORY_INFORMATION DirInfo;
     BOOLEAN bRestartScan = TRUE;
     NTSTATUS Status;
-    INT i;
+    INT i, FontCount;
+    PVOID Catalog = NULL;
+    PFONT_CATALOG_FILE *CatalogFiles, CatalogFile;
+    ULONG CatalogFileCount = 0, CatalogHits = 0, CatalogNext = 0;
+    BOOL CatalogDirty;
+    LIST_ENTRY EmptyFiles;
+    PFONT_CATALOG_EMPTY_FILE EmptyFile;
     static UNICODE_STRING SearchPatterns[] =
     {
         RTL_CONSTANT_STRING(L"*.ttf"),
@@ -623,6 +1451,7 @@ IntLoadSystemFonts(VOID)
     };
 
     RtlInitUnicodeString(&Directory, L"\\SystemRoot\\Fonts\\");
+    InitializeListHead(&EmptyFiles);
 
     InitializeObjectAttributes(
         &ObjectAttributes,
@@ -641,21 +1470,22 @@ IntLoadSystemFonts(VOID)
 
     if (NT_SUCCESS(Status))
     {
+        CatalogFiles = IntReadFontCatalog(&Catalog, &CatalogFileCount);
+        CatalogDirty = (CatalogFiles == NULL);
+
         for (i = 0; i < _countof(SearchPatterns); ++i)
         {
             DirInfoBuffer = ExAllocatePoolWithTag(PagedPool, 0x4000, TAG_FONT);
             if (DirInfoBuffer == NULL)
             {
-                ZwClose(hDirectory);
-                return;
+                break;
             }
 
             FileName.Buffer = ExAllocatePoolWithTag(PagedPool, MAX_PATH * sizeof(WCHAR), TAG_FONT);
             if (FileName.Buffer == NULL)
             {
                 ExFreePoolWithTag(DirInfoBuffer, TAG_FONT);
-                ZwClose(hDirectory);
-                return;
+                break;
             }
             FileName.Length = 0;
             FileName.MaximumLength = MAX_PATH * sizeof(WCHAR);
@@ -688,7 +1518,44 @@ IntLoadSystemFonts(VOID)
                         TempString.MaximumLength = DirInfo->FileNameLength;
                     RtlCopyUnicodeString(&FileName, &Directory);
                     RtlAppendUnicodeStringToString(&FileName, &TempString);
-                    IntGdiAddFontResource(&FileName, 0);
+
+                    CatalogFile = NULL;
+                    if (CatalogFiles)
+                    {
+                        CatalogFile = IntFindCatalogFile(CatalogFiles, CatalogFileCount,
+                                                         &CatalogNext, DirInfo);
+                    }
+
+                    if (CatalogFile && IntGdiAddFontResourceFromCatalog(&FileName, CatalogFile))
+                    {
+                        ++CatalogHits;
+                        FontCount = CatalogFile->FaceCount;
+                    }
+                    else
+                    {
+                        /* New or changed font, it has to be parsed */
+                        FontCount = IntGdiAddFontResource(&FileName, 0);
+                        CatalogDirty = TRUE;
+                    }
+
+                    /* Remember the files without faces, they are cataloged too */
+                    if (FontCount == 0)
+                    {
+                        EmptyFile = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_CATALOG_EMPTY_FILE), TAG_FONT);
+                        if (EmptyFile &&
+                            NT_SUCCESS(RtlDuplicateUnicodeString(RTL_DUPLICATE_UNICODE_STRING_NULL_TERMINATE,
+                                                                 &FileName, &EmptyFile->FileName)))
+                        {
+                            InsertTailList(&EmptyFiles, &EmptyFile->ListEntry);
+                        }
+                        else
+                        {
+                            /* Without its entry the catalogue will be rewritten next time, no harm done */
+                            if (EmptyFile)
+                                ExFreePoolWithTag(EmptyFile, TAG_FONT);
+                        }
+                    }
+
                     if (DirInfo->NextEntryOffset == 0)
                         break;
                     DirInfo = (PFILE_DIRECTORY_INFORMATION)((ULONG_PTR)DirInfo + DirInfo->NextEntryOffset);
@@ -701,6 +1568,27 @@ IntLoadSystemFonts(VOID)
             ExFreePoolWithTag(DirInfoBuffer, TAG_FONT);
         }
         ZwClose(hDirectory);
+
+        if (CatalogFiles)
+        {
+            /* Some fonts were removed */
+            if (CatalogHits != CatalogFileCount)
+                CatalogDirty = TRUE;
+
+            ExFreePoolWithTag(CatalogFiles, TAG_FONT);
+            ExFreePoolWithTag(Catalog, TAG_FONT);
+        }
+
+        DPRINT("%lu font files from the font catalogue\n", CatalogHits);
+        if (CatalogDirty)
+            IntWriteFontCatalog(&Directory, &EmptyFiles);
+
+        while (!IsListEmpty(&EmptyFiles))
+        {
+            EmptyFile = CONTAINING_RECORD(RemoveHeadList(&EmptyFiles), FONT_CATALOG_EMPTY_FILE, ListEntry);
+            RtlFreeUnicodeString(&EmptyFile->FileName);
+            ExFreePoolWithTag(EmptyFile, TAG_FONT);
+        }
     }
 }
 
@@ -794,7 +1682,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
                     &Face);
 
         if (!Error)
-            SharedFace = SharedFace_Create(Face, pLoadFont->Memory);
+            SharedFace = SharedFace_Create(Face, pLoadFont->Memory,
+                                           ((FontIndex != -1) ? FontIndex : 0));
 
         IntUnLockFreeType;
 
@@ -829,6 +1718,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
         return 0;   /* failure */
     }
+    RtlZeroMemory(Entry, sizeof(FONT_ENTRY));
+    IntInitFontEntryNames(Entry);
 
     /* allocate a FONTGDI */
     FontGDI = EngAllocMem(FL_ZERO_MEMORY, sizeof(FONTGDI), GDITAG_RFONT);
@@ -981,6 +1872,9 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     Entry->Font = FontGDI;
     Entry->NotEnum = (Characteristics & FR_NOT_ENUM);
 
+    /* Remember what font matching needs */
+    IntGetFontEntryInfo(Entry);
+
     if (Characteristics & FR_PRIVATE)
     {
         /* private font */
@@ -994,6 +1888,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         /* global font */
         IntLockGlobalFonts;
         InsertTailList(&FontListHead, &Entry->ListEntry);
+        IntLinkFontEntryNames(Entry);
         IntUnLockGlobalFonts;
     }
 
@@ -1018,28 +1913,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     {
         INT i;
 
-        if (pLoadFont->RegValueName.Length == 0)
-        {
-            RtlCreateUnicodeString(pValueName, Entry->FaceName.Buffer);
-        }
-        else
-        {
-            UNICODE_STRING NewString;
-            USHORT Length = pValueName->Length + 3 * sizeof(WCHAR) + Entry->FaceName.Length;
-            NewString.Length = 0;
-            NewString.MaximumLength = Length + sizeof(WCHAR);
-            NewString.Buffer = ExAllocatePoolWithTag(PagedPool,
-                                                     NewString.MaximumLength,
-                                                     TAG_USTR);
-            NewString.Buffer[0] = UNICODE_NULL;
-
-            RtlAppendUnicodeStringToString(&NewString, pValueName);
-            RtlAppendUnicodeToString(&NewString, L" & ");
-            RtlAppendUnicodeStringToString(&NewString, &Entry->FaceName);
-
-            RtlFreeUnicodeString(pValueName);
-            *pValueName = NewString;
-        }
+        IntAppendFontRegValueName(pValueName, &Entry->FaceName);
 
         for (i = 1; i < CharSetCount; ++i)
         {
@@ -1060,63 +1934,19 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
 INT FASTCALL
 IntGdiAddFontResource(PUNICODE_STRING FileName, DWORD Characteristics)
 {
-    NTSTATUS Status;
-    HANDLE FileHandle;
-    PVOID Buffer = NULL;
-    IO_STATUS_BLOCK Iosb;
-    PVOID SectionObject;
-    ULONG ViewSize = 0;
-    LARGE_INTEGER SectionSize;
-    OBJECT_ATTRIBUTES ObjectAttributes;
     GDI_LOAD_FONT   LoadFont;
     INT FontCount;
-    HANDLE KeyHandle;
-    static const UNICODE_STRING TrueTypePostfix = RTL_CONSTANT_STRING(L" (TrueType)");
-
-    /* Open the font file */
-    InitializeObjectAttributes(&ObjectAttributes, FileName, 0, NULL, NULL);
-    Status = ZwOpenFile(
-                 &FileHandle,
-                 FILE_GENERIC_READ | SYNCHRONIZE,
-                 &ObjectAttributes,
-                 &Iosb,
-                 FILE_SHARE_READ,
-                 FILE_SYNCHRONOUS_IO_NONALERT);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT("Could not load font file: %wZ\n", FileName);
-        return 0;
-    }
-
-    SectionSize.QuadPart = 0LL;
-    Status = MmCreateSection(&SectionObject, SECTION_ALL_ACCESS,
-                             NULL, &SectionSize, PAGE_READONLY,
-                             SEC_COMMIT, FileHandle, NULL);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT("Could not map file: %wZ\n", FileName);
-        ZwClose(FileHandle);
-        return 0;
-    }
-    ZwClose(FileHandle);
-
-    Status = MmMapViewInSystemSpace(SectionObject, &Buffer, &ViewSize);
-    if (!NT_SUCCESS(Status))
-    {
-        DPRINT("Could not map file: %wZ\n", FileName);
-        ObDereferenceObject(SectionObject);
-        return 0;
-    }
 
     LoadFont.pFileName          = FileName;
-    LoadFont.Memory             = SharedMem_Create(Buffer, ViewSize, TRUE);
+    LoadFont.Memory             = IntMapFontFile(FileName);
     LoadFont.Characteristics    = Characteristics;
     RtlInitUnicodeString(&LoadFont.RegValueName, NULL);
     LoadFont.IsTrueType         = FALSE;
     LoadFont.PrivateEntry       = NULL;
-    FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
+    if (!LoadFont.Memory)
+        return 0;
 
-    ObDereferenceObject(SectionObject);
+    FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
 
     /* Release our copy */
     IntLockFreeType;
@@ -1124,46 +1954,7 @@ IntGdiAddFontResource(PUNICODE_STRING FileName, DWORD Characteristics)
     IntUnLockFreeType;
 
     if (FontCount > 0)
-    {
-        if (LoadFont.IsTrueType)
-        {
-            /* append " (TrueType)" */
-            UNICODE_STRING NewString;
-            USHORT Length;
-
-            Length = LoadFont.RegValueName.Length + TrueTypePostfix.Length;
-            NewString.Length = 0;
-            NewString.MaximumLength = Length + sizeof(WCHAR);
-            NewString.Buffer = ExAllocatePoolWithTag(PagedPool,
-                                                     NewString.MaximumLength,
-                                                     TAG_USTR);
-            NewString.Buffer[0] = UNICODE_NULL;
-
-            RtlAppendUnicodeStringToString(&NewString, &LoadFont.RegValueName);
-            RtlAppendUnicodeStringToString(&NewString, &TrueTypePostfix);
-            RtlFreeUnicodeString(&LoadFont.RegValueName);
-            LoadFont.RegValueName = NewString;
-        }
-
-        /* registry */
-        InitializeObjectAttributes(&ObjectAttributes, &FontRegPath,
-                                   OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
-                                   NULL, NULL);
-        Status = ZwOpenKey(&KeyHandle, KEY_WRITE, &ObjectAttributes);
-        if (NT_SUCCESS(Status))
-        {
-            ULONG DataSize;
-            LPWSTR pFileName = wcsrchr(FileName->Buffer, L'\\');
-            if (pFileName)
-            {
-                pFileName++;
-                DataSize = (wcslen(pFileName) + 1) * sizeof(WCHAR);
-                ZwSetValueKey(KeyHandle, &LoadFont.RegValueName, 0, REG_SZ,
-                              pFileName, DataSize);
-            }
-            ZwClose(KeyHandle);
-        }
-    }
+        IntWriteFontRegValue(&LoadFont.RegValueName, LoadFont.IsTrueType, FileName);
     RtlFreeUnicodeString(&LoadFont.RegValueName);
 
     return FontCount;
@@ -1231,6 +2022,8 @@ CleanupFontEntry(PFONT_ENTRY FontEntry)
     if (FontGDI->Filename)
         ExFreePoolWithTag(FontGDI->Filename, GDITAG_PFF);
 
+    IntFreeFontEntryNames(FontEntry);
+    RtlFreeUnicodeString(&FontEntry->FaceName);
     EngFreeMem(FontGDI);
     SharedFace_Release(SharedFace);
     ExFreePoolWithTag(FontEntry, TAG_FONT);
@@ -1918,10 +2711,8 @@ FindFaceNameInList(PUNICODE_STRING FaceName, PLIST_ENTRY Head)
 {
     PLIST_ENTRY Entry;
     PFONT_ENTRY CurrentEntry;
-    ANSI_STRING EntryFaceNameA;
     UNICODE_STRING EntryFaceNameW;
     FONTGDI *FontGDI;
-    NTSTATUS status;
 
     Entry = Head->Flink;
     while (Entry != Head)
@@ -1931,26 +2722,18 @@ FindFaceNameInList(PUNICODE_STRING FaceName, PLIST_ENTRY Head)
         FontGDI = CurrentEntry->Font;
         ASSERT(FontGDI);
 
-        RtlInitAnsiString(&EntryFaceNameA, FontGDI->SharedFace->Face->family_name);
-        status = RtlAnsiStringToUnicodeString(&EntryFaceNameW, &EntryFaceNameA, TRUE);
-        if (!NT_SUCCESS(status))
-        {
-            break;
-        }
-
+        EntryFaceNameW = CurrentEntry->FaceName;
         if ((LF_FACESIZE - 1) * sizeof(WCHAR) < EntryFaceNameW.Length)
         {
             EntryFaceNameW.Length = (LF_FACESIZE - 1) * sizeof(WCHAR);
-            EntryFaceNameW.Buffer[LF_FACESIZE - 1] = L'\0';
         }
 
-        if (RtlEqualUnicodeString(FaceName, &EntryFaceNameW, TRUE))
+        if (RtlEqualUnicodeString(FaceName, &EntryFaceNameW, TRUE) &&
+            IntLoadFontFace(FontGDI))
         {
-            RtlFreeUnicodeString(&EntryFaceNameW);
             return FontGDI;
         }
 
-        RtlFreeUnicodeString(&EntryFaceNameW);
         Entry = Entry->Flink;
     }
 
@@ -2111,6 +2894,57 @@ IntGetFontLocalizedName(PUNICODE_STRING pNameW, FT_Face Face,
     return Status;
 }
 
+/*
+ * IntGetFontEntryInfo
+ *
+ * Collects the names and metrics font matching looks at, so that it does not
+ * have to ask FreeType for every candidate again.
+ */
+static VOID FASTCALL
+IntGetFontEntryInfo(PFONT_ENTRY Entry)
+{
+    FT_Face Face = Entry->Font->SharedFace->Face;
+    OUTLINETEXTMETRICW *Otm;
+    UINT OtmSize, i, j;
+
+    IntLockFreeType;
+    Entry->StyleItalic = ItalicFromStyle(Face->style_name);
+    IntGetFontLocalizedName(&Entry->Names[FONT_NAME_FAMILY], Face,
+                            TT_NAME_ID_FONT_FAMILY, gusLanguageID);
+    IntGetFontLocalizedName(&Entry->Names[FONT_NAME_FULL], Face,
+                            TT_NAME_ID_FULL_NAME, gusLanguageID);
+    if (gusLanguageID != gusEnglishUS)
+    {
+        IntGetFontLocalizedName(&Entry->Names[FONT_NAME_ENGLISH_FAMILY], Face,
+                                TT_NAME_ID_FONT_FAMILY, gusEnglishUS);
+        IntGetFontLocalizedName(&Entry->Names[FONT_NAME_ENGLISH_FULL], Face,
+                                TT_NAME_ID_FULL_NAME, gusEnglishUS);
+    }
+    IntUnLockFreeType;
+
+    /* A name only has to be found once */
+    for (i = 1; i < FONT_NAME_COUNT; ++i)
+    {
+        for (j = 0; j < i; ++j)
+        {
+            if (RtlEqualUnicodeString(&Entry->Names[i], &Entry->Names[j], TRUE))
+            {
+                RtlFreeUnicodeString(&Entry->Names[i]);
+                break;
+            }
+        }
+    }
+
+    OtmSize = IntGetOutlineTextMetrics(Entry->Font, 0, NULL);
+    Otm = (OtmSize ? ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT) : NULL);
+    if (Otm)
+    {
+        IntGetOutlineTextMetrics(Entry->Font, OtmSize, Otm);
+        Entry->TextMetric = Otm->otmTextMetrics;
+        ExFreePoolWithTag(Otm, GDITAG_TEXT);
+    }
+}
+
 static void FASTCALL
 FontFamilyFillInfo(PFONTFAMILYINFO Info, LPCWSTR FaceName,
                    LPCWSTR FullName, PFONTGDI FontGDI)
@@ -2354,10 +3188,9 @@ GetFontFamilyInfoForList(LPLOGFONTW LogFont,
 {
     PLIST_ENTRY Entry;
     PFONT_ENTRY CurrentEntry;
-    ANSI_STRING EntryFaceNameA;
     UNICODE_STRING EntryFaceNameW;
+    WCHAR FaceName[LF_FACESIZE];
     FONTGDI *FontGDI;
-    NTSTATUS status;
 
     Entry = Head->Flink;
     while (Entry != Head)
@@ -2367,29 +3200,24 @@ GetFontFamilyInfoForList(LPLOGFONTW LogFont,
         FontGDI = CurrentEntry->Font;
         ASSERT(FontGDI);
 
-        RtlInitAnsiString(&EntryFaceNameA, FontGDI->SharedFace->Face->family_name);
-        status = RtlAnsiStringToUnicodeString(&EntryFaceNameW, &EntryFaceNameA, TRUE);
-        if (!NT_SUCCESS(status))
-        {
-            return FALSE;
-        }
-
-        if ((LF_FACESIZE - 1) * sizeof(WCHAR) < EntryFaceNameW.Length)
-        {
-            EntryFaceNameW.Length = (LF_FACESIZE - 1) * sizeof(WCHAR);
-            EntryFaceNameW.Buffer[LF_FACESIZE - 1] = L'\0';
-        }
+        RtlInitEmptyUnicodeString(&EntryFaceNameW, FaceName, sizeof(FaceName) - sizeof(UNICODE_NULL));
+        RtlCopyUnicodeString(&EntryFaceNameW, &CurrentEntry->FaceName);
+        FaceName[EntryFaceNameW.Length / sizeof(WCHAR)] = UNICODE_NULL;
 
         if (FontFamilyInclude(LogFont, &EntryFaceNameW, Info, min(*Count, Size)))
         {
             if (*Count < Size)
             {
+                if (!IntLoadFontFace(FontGDI))
+                {
+                    Entry = Entry->Flink;
+                    continue;
+                }
                 FontFamilyFillInfo(Info + *Count, EntryFaceNameW.Buffer,
                                    NULL, FontGDI);
             }
             (*Count)++;
         }
-        RtlFreeUnicodeString(&EntryFaceNameW);
         Entry = Entry->Flink;
     }
 
@@ -2533,38 +3361,62 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
+/*
+ * The glyphs are keyed by the size the face is currently scaled to rather
+ * than by the requested LOGFONT, so every DC that ends up with the same
+ * scaling and transformation shares the same bitmaps.
+ */
+static
+ULONG
+GlyphCacheHash(
+    INT GlyphIndex,
+    const FT_Size_Metrics *Metrics,
+    FT_Render_Mode RenderMode)
+{
+    ULONG Hash = GlyphIndex;
+
+    Hash = Hash * 31 + Metrics->x_ppem;
+    Hash = Hash * 31 + Metrics->y_ppem;
+    Hash = Hash * 31 + RenderMode;
+    return Hash % FONT_CACHE_HASH_SIZE;
+}
+
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheGet(
-    FT_Face Face,
+    PSHARED_FACE SharedFace,
     INT GlyphIndex,
-    INT Height,
-    PMATRIX pmx)
+    PMATRIX pmx,
+    FT_Render_Mode RenderMode)
 {
-    PLIST_ENTRY CurrentEntry;
+    const FT_Size_Metrics *Metrics;
+    PLIST_ENTRY Bucket, CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    CurrentEntry = FontCacheListHead.Flink;
-    while (CurrentEntry != &FontCacheListHead)
-    {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        if ((FontEntry->Face == Face) &&
-            (FontEntry->GlyphIndex == GlyphIndex) &&
-            (FontEntry->Height == Height) &&
-            (SameScaleMatrix(&FontEntry->mxWorldToDevice, pmx)))
-            break;
-        CurrentEntry = CurrentEntry->Flink;
-    }
-
-    if (CurrentEntry == &FontCacheListHead)
-    {
+    if (!SharedFace->GlyphCache)
         return NULL;
+
+    Metrics = &SharedFace->Face->size->metrics;
+    Bucket = &SharedFace->GlyphCache[GlyphCacheHash(GlyphIndex, Metrics, RenderMode)];
+    for (CurrentEntry = Bucket->Flink; CurrentEntry != Bucket; CurrentEntry = CurrentEntry->Flink)
+    {
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
+        if ((FontEntry->GlyphIndex == GlyphIndex) &&
+            (FontEntry->RenderMode == RenderMode) &&
+            (FontEntry->XScale == Metrics->x_scale) &&
+            (FontEntry->YScale == Metrics->y_scale) &&
+            (FontEntry->XPpem == Metrics->x_ppem) &&
+            (FontEntry->YPpem == Metrics->y_ppem) &&
+            (SameScaleMatrix(&FontEntry->mxWorldToDevice, pmx)))
+        {
+            RemoveEntryList(&FontEntry->ListEntry);
+            InsertHeadList(&FontCacheListHead, &FontEntry->ListEntry);
+            return FontEntry->BitmapGlyph;
+        }
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&FontCacheListHead, CurrentEntry);
-    return FontEntry->BitmapGlyph;
+    return NULL;
 }
 
 /* no cache */
@@ -2611,21 +3463,37 @@ ftGdiGlyphSet(
 
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheSet(
-    FT_Face Face,
+    PSHARED_FACE SharedFace,
     INT GlyphIndex,
-    INT Height,
     PMATRIX pmx,
     FT_GlyphSlot GlyphSlot,
     FT_Render_Mode RenderMode)
 {
+    const FT_Size_Metrics *Metrics;
     FT_Glyph GlyphCopy;
     INT error;
     PFONT_CACHE_ENTRY NewEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
+    UINT i;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
+    if (!SharedFace->GlyphCache)
+    {
+        SharedFace->GlyphCache = ExAllocatePoolWithTag(PagedPool,
+                                                       FONT_CACHE_HASH_SIZE * sizeof(LIST_ENTRY),
+                                                       TAG_FONT);
+        if (!SharedFace->GlyphCache)
+        {
+            DPRINT1("Alloc failure caching glyph.\n");
+            return NULL;
+        }
+
+        for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+            InitializeListHead(&SharedFace->GlyphCache[i]);
+    }
+
     error = FT_Get_Glyph(GlyphSlot, &GlyphCopy);
     if (error)
     {
@@ -2663,17 +3531,29 @@ ftGdiGlyphCacheSet(
     FT_Bitmap_Done(GlyphSlot->library, &BitmapGlyph->bitmap);
     BitmapGlyph->bitmap = AlignedBitmap;
 
-    NewEntry->GlyphIndex = GlyphIndex;
-    NewEntry->Face = Face;
+    Metrics = &SharedFace->Face->size->metrics;
+    NewEntry->SharedFace = SharedFace;
     NewEntry->BitmapGlyph = BitmapGlyph;
-    NewEntry->Height = Height;
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) + sizeof(FT_BitmapGlyphRec) +
+                     abs(AlignedBitmap.pitch) * AlignedBitmap.rows;
+    NewEntry->GlyphIndex = GlyphIndex;
+    NewEntry->RenderMode = RenderMode;
+    NewEntry->XScale = Metrics->x_scale;
+    NewEntry->YScale = Metrics->y_scale;
+    NewEntry->XPpem = Metrics->x_ppem;
+    NewEntry->YPpem = Metrics->y_ppem;
     NewEntry->mxWorldToDevice = *pmx;
 
     InsertHeadList(&FontCacheListHead, &NewEntry->ListEntry);
-    if (++FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(&SharedFace->GlyphCache[GlyphCacheHash(GlyphIndex, Metrics, RenderMode)],
+                   &NewEntry->HashEntry);
+    FontCacheSize += NewEntry->Size;
+
+    /* Drop the least recently used glyphs until we fit again, but keep the new one */
+    while (FontCacheSize > MAX_FONT_CACHE_SIZE &&
+           FontCacheListHead.Blink != &NewEntry->ListEntry)
     {
-        NewEntry = CONTAINING_RECORD(FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        RemoveCachedEntry(CONTAINING_RECORD(FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry));
     }
 
     return BitmapGlyph;
@@ -3530,8 +4410,8 @@ TextIntGetTextExtentPoint(PDC dc,
         if (EmuBold || EmuItalic)
             realglyph = NULL;
         else
-            realglyph = ftGdiGlyphCacheGet(face, glyph_index,
-                                           plf->lfHeight, pmxWorldToDevice);
+            realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index,
+                                           pmxWorldToDevice, RenderMode);
 
         if (EmuBold || EmuItalic || !realglyph)
         {
@@ -3553,9 +4433,8 @@ TextIntGetTextExtentPoint(PDC dc,
             }
             else
             {
-                realglyph = ftGdiGlyphCacheSet(face,
+                realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                glyph_index,
-                                               plf->lfHeight,
                                                pmxWorldToDevice,
                                                glyph,
                                                RenderMode);
@@ -3926,20 +4805,15 @@ ftGdiGetFontData(
 static UINT FASTCALL
 GetFontPenalty(LOGFONTW *               LogFont,
                PUNICODE_STRING          RequestedNameW,
-               PUNICODE_STRING          ActualNameW,
-               PUNICODE_STRING          FullFaceNameW,
                BYTE                     RequestedCharSet,
-               PFONTGDI                 FontGDI,
-               OUTLINETEXTMETRICW *     Otm,
-               TEXTMETRICW *            TM,
-               const char *             style_name)
+               PFONT_ENTRY              FontEntry)
 {
     ULONG   Penalty = 0;
     BYTE    Byte;
     LONG    Long;
     BOOL    fFixedSys = FALSE, fNeedScaling = FALSE;
     const BYTE UserCharSet = CharSetFromLangID(gusLanguageID);
-    NTSTATUS Status;
+    TEXTMETRICW *TM = &FontEntry->TextMetric;
 
     /* FIXME: Aspect Penalty 30 */
     /* FIXME: IntSizeSynth Penalty 20 */
@@ -4076,50 +4950,12 @@ GetFontPenalty(LOGFONTW *               LogFont,
     if (RequestedNameW->Buffer[0])
     {
         BOOL Found = FALSE;
-        FT_Face Face = FontGDI->SharedFace->Face;
+        UINT i;
 
-        /* localized family name */
-        if (!Found)
-        {
-            Status = IntGetFontLocalizedName(ActualNameW, Face, TT_NAME_ID_FONT_FAMILY,
-                                             gusLanguageID);
-            if (NT_SUCCESS(Status))
-            {
-                Found = RtlEqualUnicodeString(RequestedNameW, ActualNameW, TRUE);
-            }
-        }
-        /* localized full name */
-        if (!Found)
-        {
-            Status = IntGetFontLocalizedName(ActualNameW, Face, TT_NAME_ID_FULL_NAME,
-                                             gusLanguageID);
-            if (NT_SUCCESS(Status))
-            {
-                Found = RtlEqualUnicodeString(RequestedNameW, ActualNameW, TRUE);
-            }
-        }
-        if (gusLanguageID != gusEnglishUS)
+        /* localized and English family and full names */
+        for (i = 0; i < FONT_NAME_COUNT && !Found; ++i)
         {
-            /* English family name */
-            if (!Found)
-            {
-                Status = IntGetFontLocalizedName(ActualNameW, Face, TT_NAME_ID_FONT_FAMILY,
-                                                 gusEnglishUS);
-                if (NT_SUCCESS(Status))
-                {
-                    Found = RtlEqualUnicodeString(RequestedNameW, ActualNameW, TRUE);
-                }
-            }
-            /* English full name */
-            if (!Found)
-            {
-                Status = IntGetFontLocalizedName(ActualNameW, Face, TT_NAME_ID_FULL_NAME,
-                                                 gusEnglishUS);
-                if (NT_SUCCESS(Status))
-                {
-                    Found = RtlEqualUnicodeString(RequestedNameW, ActualNameW, TRUE);
-                }
-            }
+            Found = RtlEqualUnicodeString(RequestedNameW, &FontEntry->Names[i], TRUE);
         }
         if (!Found)
         {
@@ -4209,7 +5045,12 @@ GetFontPenalty(LOGFONTW *               LogFont,
             break;
     }
 
-    if (LogFont->lfWidth != 0)
+    /*
+     * Like the height, the width only matters for raster fonts. The others
+     * are scaled to any width, and the metrics cached with their font entry
+     * were taken before any size was selected.
+     */
+    if (LogFont->lfWidth != 0 && !(TM->tmPitchAndFamily & (TMPF_TRUETYPE | TMPF_VECTOR)))
     {
         if (LogFont->lfWidth != TM->tmAveCharWidth)
         {
@@ -4217,9 +5058,7 @@ GetFontPenalty(LOGFONTW *               LogFont,
             /* Requested a nonzero width, but the candidate's width
                doesn't match. Penalty * width difference */
             Penalty += 50 * labs(LogFont->lfWidth - TM->tmAveCharWidth);
-
-            if (!(TM->tmPitchAndFamily & (TMPF_TRUETYPE | TMPF_VECTOR)))
-                fNeedScaling = TRUE;
+            fNeedScaling = TRUE;
         }
     }
 
@@ -4232,7 +5071,7 @@ GetFontPenalty(LOGFONTW *               LogFont,
 
     if (!!LogFont->lfItalic != !!TM->tmItalic)
     {
-        if (!LogFont->lfItalic && ItalicFromStyle(style_name))
+        if (!LogFont->lfItalic && FontEntry->StyleItalic)
         {
             /* Italic Penalty 4 */
             /* Requested font and candidate font do not agree on italic status,
@@ -4240,7 +5079,7 @@ GetFontPenalty(LOGFONTW *               LogFont,
             /* Adjusted to 40 to satisfy (Oblique Penalty > Book Penalty). */
             Penalty += 40;
         }
-        else if (LogFont->lfItalic && !ItalicFromStyle(style_name))
+        else if (LogFont->lfItalic && !FontEntry->StyleItalic)
         {
             /* ItalicSim Penalty 1 */
             /* Requested italic font but the candidate is not italic,
@@ -4318,7 +5157,7 @@ GetFontPenalty(LOGFONTW *               LogFont,
         DPRINT("WARNING: Penalty:%ld < 200: RequestedNameW:%ls, "
             "ActualNameW:%ls, lfCharSet:%d, lfWeight:%ld, "
             "tmCharSet:%d, tmWeight:%ld\n",
-            Penalty, RequestedNameW->Buffer, ActualNameW->Buffer,
+            Penalty, RequestedNameW->Buffer, FontEntry->FaceName.Buffer,
             LogFont->lfCharSet, LogFont->lfWeight,
             TM->tmCharSet, TM->tmWeight);
     }
@@ -4326,24 +5165,33 @@ GetFontPenalty(LOGFONTW *               LogFont,
     return Penalty;     /* success */
 }
 
+static BOOL
+IntMatchFontEntry(PFONT_ENTRY FontEntry, FONTOBJ **FontObj, ULONG *MatchPenalty,
+                  LOGFONTW *LogFont, PUNICODE_STRING pRequestedNameW,
+                  BYTE RequestedCharSet)
+{
+    ULONG Penalty;
+
+    Penalty = GetFontPenalty(LogFont, pRequestedNameW, RequestedCharSet, FontEntry);
+    if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty)
+    {
+        DPRINT("%ls Penalty: %lu\n", FontEntry->FaceName.Buffer, Penalty);
+        *FontObj = GDIToObj(FontEntry->Font, FONT);
+        *MatchPenalty = Penalty;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 static __inline VOID
 FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty, LOGFONTW *LogFont,
                      PUNICODE_STRING pRequestedNameW,
                      PUNICODE_STRING pActualNameW, BYTE RequestedCharSet,
                      PLIST_ENTRY Head)
 {
-    ULONG Penalty;
-    NTSTATUS Status;
     PLIST_ENTRY Entry;
     PFONT_ENTRY CurrentEntry;
-    FONTGDI *FontGDI;
-    ANSI_STRING ActualNameA;
-    UNICODE_STRING ActualNameW, FullFaceNameW;
-    OUTLINETEXTMETRICW *Otm = NULL;
-    UINT OtmSize, OldOtmSize = 0;
-    TEXTMETRICW *TM;
-    FT_Face Face;
-    LPBYTE pb;
 
     ASSERT(FontObj);
     ASSERT(MatchPenalty);
@@ -4352,77 +5200,74 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty, LOGFONTW *LogFont,
     ASSERT(Head);
 
     /* get the FontObj of lowest penalty */
-    Entry = Head->Flink;
-    while (Entry != Head)
+    for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
     {
         CurrentEntry = CONTAINING_RECORD(Entry, FONT_ENTRY, ListEntry);
-        FontGDI = CurrentEntry->Font;
-        ASSERT(FontGDI);
-        Face = FontGDI->SharedFace->Face;
+        ASSERT(CurrentEntry->Font);
 
-        /* create actual name */
-        RtlInitAnsiString(&ActualNameA, Face->family_name);
-        Status = RtlAnsiStringToUnicodeString(&ActualNameW, &ActualNameA, TRUE);
-        if (!NT_SUCCESS(Status))
-        {
-            /* next entry */
-            Entry = Entry->Flink;
-            continue;
-        }
-
-        /* get text metrics */
-        OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL);
-        if (OtmSize > OldOtmSize)
+        if (IntMatchFontEntry(CurrentEntry, FontObj, MatchPenalty, LogFont,
+                              pRequestedNameW, RequestedCharSet))
         {
-            if (Otm)
-                ExFreePoolWithTag(Otm, GDITAG_TEXT);
-            Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+            RtlFreeUnicodeString(pActualNameW);
+            RtlCreateUnicodeString(pActualNameW, CurrentEntry->FaceName.Buffer);
         }
+    }
+}
 
-        /* update FontObj if lowest penalty */
-        if (Otm)
-        {
-            IntGetOutlineTextMetrics(FontGDI, OtmSize, Otm);
-            TM = &Otm->otmTextMetrics;
-            OldOtmSize = OtmSize;
+/*
+ * FindBestFontFromIndex
+ *
+ * Only looks at the global fonts that have the requested name. Any other
+ * font gets the FaceName penalty of 10000, so when one of those scores
+ * below it, it is the very font the whole list would have given.
+ * Returns FALSE when the whole list has to be searched.
+ */
+static BOOL
+FindBestFontFromIndex(FONTOBJ **FontObj, ULONG *MatchPenalty, LOGFONTW *LogFont,
+                      PUNICODE_STRING pRequestedNameW,
+                      PUNICODE_STRING pActualNameW, BYTE RequestedCharSet)
+{
+    PLIST_ENTRY Bucket, Entry;
+    PFONT_NAME_LINK Link;
+    PFONT_ENTRY BestEntry = NULL;
+    FONTOBJ *Font = *FontObj;
+    ULONG Penalty = *MatchPenalty;
 
-            /* create full name */
-            pb = (LPBYTE)Otm + (WORD)(DWORD_PTR)Otm->otmpFullName;
-            Status = RtlCreateUnicodeString(&FullFaceNameW, (LPWSTR)pb);
-            if (!NT_SUCCESS(Status))
-            {
-                RtlFreeUnicodeString(&ActualNameW);
-                RtlFreeUnicodeString(&FullFaceNameW);
-                /* next entry */
-                Entry = Entry->Flink;
-                continue;
-            }
+    ASSERT_GLOBALFONTS_LOCK_HELD();
 
-            Penalty = GetFontPenalty(LogFont, pRequestedNameW, &ActualNameW,
-                                     &FullFaceNameW, RequestedCharSet,
-                                     FontGDI, Otm, TM, Face->style_name);
-            if (*MatchPenalty == 0xFFFFFFFF || Penalty < *MatchPenalty)
-            {
-                DPRINT("%ls Penalty: %lu\n", FullFaceNameW.Buffer, Penalty);
-                RtlFreeUnicodeString(pActualNameW);
-                RtlCreateUnicodeString(pActualNameW, ActualNameW.Buffer);
+    if (!pRequestedNameW->Buffer[0])
+        return FALSE;
 
-                *FontObj = GDIToObj(FontGDI, FONT);
-                *MatchPenalty = Penalty;
-            }
+    Bucket = &FontNameHash[IntHashFontName(pRequestedNameW)];
+    for (Entry = Bucket->Flink; Entry != Bucket; Entry = Entry->Flink)
+    {
+        Link = CONTAINING_RECORD(Entry, FONT_NAME_LINK, ListEntry);
+        if (!RtlEqualUnicodeString(pRequestedNameW,
+                                   &Link->FontEntry->Names[Link - Link->FontEntry->NameLinks],
+                                   TRUE))
+        {
+            continue;
+        }
 
-            RtlFreeUnicodeString(&FullFaceNameW);
+        if (IntMatchFontEntry(Link->FontEntry, &Font, &Penalty, LogFont,
+                              pRequestedNameW, RequestedCharSet))
+        {
+            BestEntry = Link->FontEntry;
         }
+    }
 
-        /* free strings */
-        RtlFreeUnicodeString(&ActualNameW);
+    if (Penalty >= 10000)
+        return FALSE;
 
-        /* next entry */
-        Entry = Entry->Flink;
+    if (BestEntry)
+    {
+        *FontObj = Font;
+        *MatchPenalty = Penalty;
+        RtlFreeUnicodeString(pActualNameW);
+        RtlCreateUnicodeString(pActualNameW, BestEntry->FaceName.Buffer);
     }
 
-    if (Otm)
-        ExFreePoolWithTag(Otm, GDITAG_TEXT);
+    return TRUE;
 }
 
 static
@@ -4517,13 +5362,23 @@ TextIntRealizeFont(HFONT FontHandle, PTEXTOBJ pTextObj)
                          &Win32Process->PrivateFontListHead);
     IntUnLockProcessPrivateFonts(Win32Process);
 
-    /* Search system fonts */
+    /* Search system fonts, the ones with the requested name first */
     IntLockGlobalFonts;
-    FindBestFontFromList(&TextObj->Font, &MatchPenalty, pLogFont,
-                         &RequestedNameW, &ActualNameW, RequestedCharSet,
-                         &FontListHead);
+    if (!FindBestFontFromIndex(&TextObj->Font, &MatchPenalty, pLogFont,
+                               &RequestedNameW, &ActualNameW, RequestedCharSet))
+    {
+        FindBestFontFromList(&TextObj->Font, &MatchPenalty, pLogFont,
+                             &RequestedNameW, &ActualNameW, RequestedCharSet,
+                             &FontListHead);
+    }
     IntUnLockGlobalFonts;
 
+    if (TextObj->Font && !IntLoadFontFace(ObjToGDI(TextObj->Font, FONT)))
+    {
+        DPRINT1("Could not load font %ls\n", ActualNameW.Buffer);
+        TextObj->Font = NULL;
+    }
+
     if (NULL == TextObj->Font)
     {
         DPRINT1("Request font %S not found, no fonts loaded at all\n",
@@ -4727,6 +5582,9 @@ IntGdiGetFontResourceInfo(
         if (!RtlEqualUnicodeString(&NameInfo1->Name, &NameInfo2->Name, FALSE))
             continue;
 
+        if (!IntLoadFontFace(FontEntry->Font))
+            continue;
+
         IsEqual = FALSE;
         FontFamilyFillInfo(&FamInfo[Count], FontEntry->FaceName.Buffer,
                            NULL, FontEntry->Font);
@@ -5361,8 +6219,8 @@ GreExtTextOutW(
             if (EmuBold || EmuItalic)
                 realglyph = NULL;
             else
-                realglyph = ftGdiGlyphCacheGet(face, glyph_index,
-                                               plf->lfHeight, pmxWorldToDevice);
+                realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index,
+                                               pmxWorldToDevice, RenderMode);
             if (!realglyph)
             {
                 error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
@@ -5382,9 +6240,8 @@ GreExtTextOutW(
                 }
                 else
                 {
-                    realglyph = ftGdiGlyphCacheSet(face,
+                    realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                    glyph_index,
-                                                   plf->lfHeight,
                                                    pmxWorldToDevice,
                                                    glyph,
                                                    RenderMode);
@@ -5586,8 +6443,8 @@ GreExtTextOutW(
         if (EmuBold || EmuItalic)
             realglyph = NULL;
         else
-            realglyph = ftGdiGlyphCacheGet(face, glyph_index,
-                                           plf->lfHeight, pmxWorldToDevice);
+            realglyph = ftGdiGlyphCacheGet(FontGDI->SharedFace, glyph_index,
+                                           pmxWorldToDevice, RenderMode);
         if (!realglyph)
         {
             error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
@@ -5610,9 +6467,8 @@ GreExtTextOutW(
             }
             else
             {
-                realglyph = ftGdiGlyphCacheSet(face,
+                realglyph = ftGdiGlyphCacheSet(FontGDI->SharedFace,
                                                glyph_index,
-                                               plf->lfHeight,
                                                pmxWorldToDevice,
                                                glyph,
                                                RenderMode);
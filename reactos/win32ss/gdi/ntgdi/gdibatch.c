@@ -60,53 +60,302 @@ SynchonizeDriver(FLONG Flags)
 }
 
 //
-// Process the batch.
+// Fill a batched rectangle, with the colors the DC had when it was recorded.
 //
-ULONG
+static
+BOOL
 FASTCALL
-GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
+IntBatchPatBlt(
+    PDC dc,
+    HBRUSH hbrush,
+    INT XLeft,
+    INT YLeft,
+    INT Width,
+    INT Height,
+    DWORD dwRop,
+    COLORREF crForegroundClr,
+    COLORREF crBackgroundClr,
+    COLORREF crBrushClr)
 {
-  ULONG Cmd = 0, Size = 0;
-  PDC_ATTR pdcattr = NULL;
+  PBRUSH pbrush;
+  EBRUSHOBJ eboFill;
+  BOOL bResult;
 
-  if (dc)
+  pbrush = BRUSH_ShareLockBrush(hbrush);
+  if (!pbrush) return FALSE;
+
+  EBRUSHOBJ_vInit(&eboFill, pbrush, dc->dclevel.pSurface,
+                  crBackgroundClr, crForegroundClr, dc->dclevel.ppal);
+
+  if (hbrush == StockObjects[DC_BRUSH])
   {
-     pdcattr = dc->pdcattr;
+     EBRUSHOBJ_vSetSolidRGBColor(&eboFill, crBrushClr);
   }
 
+  bResult = IntPatBlt(dc, XLeft, YLeft, Width, Height, dwRop, &eboFill);
+
+  EBRUSHOBJ_vCleanup(&eboFill);
+  BRUSH_ShareUnlockBrush(pbrush);
+  return bResult;
+}
+
+//
+// Copy a batch entry, or a part of it, out of the TEB. User mode can change
+// or unmap the batch at any time, so nothing is used from there directly.
+//
+static
+BOOL
+FASTCALL
+IntCaptureBatch(PVOID Destination, CONST VOID *Source, SIZE_T Length)
+{
   _SEH2_TRY
   {
-     Cmd = pHdr->Cmd;
-     Size = pHdr->Size; // Return the full size of the structure.
+     RtlCopyMemory(Destination, Source, Length);
   }
   _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
   {
      DPRINT1("WARNING! GdiBatch Fault!\n");
-     _SEH2_YIELD(return 0;)
+     _SEH2_YIELD(return FALSE;)
   }
   _SEH2_END;
 
+  return TRUE;
+}
+
+//
+// Process the batch.
+//
+// gdi32 flushes the batch before it changes the mapping or the clipping of
+// the DC, so those are still the ones of the time a command was recorded.
+// The colors, the brush and the font are not, they come with the command.
+//
+ULONG
+FASTCALL
+GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
+{
+  GDIBATCHHDR Hdr;
+  ULONG Cmd, Size;
+  PDC_ATTR pdcattr = NULL;
+
+  if (dc)
+  {
+     pdcattr = dc->pdcattr;
+  }
+
+  if (!IntCaptureBatch(&Hdr, pHdr, sizeof(Hdr))) return 0;
+  Cmd = Hdr.Cmd;
+  Size = Hdr.Size; // Return the full size of the structure.
+
+  /* The entry must fit in what is left of the buffer */
+  if ((LONG)Size < (LONG)sizeof(GDIBATCHHDR) ||
+      (PCHAR)pHdr + Size > (PCHAR)&NtCurrentTeb()->GdiTebBatch.Buffer[0] + GDIBATCHBUFSIZE)
+  {
+     return 0;
+  }
+
   switch(Cmd)
   {
      case GdiBCPatBlt:
+     {
+        GDIBSPATBLT PatBlt;
+        DWORD dwRop;
+
+        if (!dc || Size < sizeof(GDIBSPATBLT)) break;
+        if (!IntCaptureBatch(&PatBlt, pHdr, sizeof(PatBlt))) return 0;
+
+        /* Convert the ROP3 to a ROP4 */
+        dwRop = MAKEROP4(PatBlt.dwRop & 0xFF0000, PatBlt.dwRop);
+
+        /* Check if the rop uses a source, or if there is nothing to draw on */
+        if (WIN32_ROP4_USES_SOURCE(dwRop) || !dc->dclevel.pSurface) break;
+
+        IntBatchPatBlt(dc,
+                       PatBlt.hbrush,
+                       PatBlt.nXLeft,
+                       PatBlt.nYLeft,
+                       PatBlt.nWidth,
+                       PatBlt.nHeight,
+                       dwRop,
+                       PatBlt.crForegroundClr,
+                       PatBlt.crBackgroundClr,
+                       PatBlt.crBrushClr);
         break;
+     }
 
      case GdiBCPolyPatBlt:
+     {
+        PGDIBSPPATBLT pgDPB;
+        GDIBSPPATBLT PolyPatBlt;
+        PATRECT Rect;
+        ULONG i;
+
+        if (!dc || Size < FIELD_OFFSET(GDIBSPPATBLT, pRect)) break;
+        pgDPB = (PGDIBSPPATBLT) pHdr;
+        if (!IntCaptureBatch(&PolyPatBlt, pgDPB, FIELD_OFFSET(GDIBSPPATBLT, pRect))) return 0;
+
+        /* The rectangles must all be in the entry */
+        if (PolyPatBlt.Count > (Size - FIELD_OFFSET(GDIBSPPATBLT, pRect)) / sizeof(PATRECT)) break;
+
+        if (dc->dctype == DC_TYPE_INFO || !dc->dclevel.pSurface) break;
+
+        for (i = 0; i < PolyPatBlt.Count; i++)
+        {
+            if (!IntCaptureBatch(&Rect, &pgDPB->pRect[i], sizeof(Rect))) return 0;
+
+            IntBatchPatBlt(dc,
+                           Rect.hBrush,
+                           Rect.r.left,
+                           Rect.r.top,
+                           Rect.r.right,
+                           Rect.r.bottom,
+                           PolyPatBlt.rop4,
+                           PolyPatBlt.crForegroundClr,
+                           PolyPatBlt.crBackgroundClr,
+                           PolyPatBlt.crBrushClr);
+        }
         break;
+     }
 
      case GdiBCTextOut:
+     {
+        PGDIBSTEXTOUT pgO;
+        GDIBSTEXTOUT TextOut;
+        UINT Options, cbCount, cjDx, cjData;
+        ULONG aulData[64]; // Most runs are short, keep them off the pool
+        PUCHAR pjData = (PUCHAR)aulData;
+        RECTL rcl;
+        COLORREF crForegroundClr, crBackgroundClr;
+        ULONG ulForegroundClr, ulBackgroundClr;
+        LONG lBkMode, lTextAlign;
+        BYTE jBkMode;
+        HANDLE hlfntNew;
+        FLONG flDirty = 0;
+
+        if (!dc || Size < FIELD_OFFSET(GDIBSTEXTOUT, String)) break;
+        pgO = (PGDIBSTEXTOUT) pHdr;
+
+        cjData = Size - FIELD_OFFSET(GDIBSTEXTOUT, String);
+        if (cjData > sizeof(aulData))
+        {
+            pjData = ExAllocatePoolWithTag(PagedPool, cjData, GDITAG_TEXT);
+            if (!pjData) break;
+        }
+        if (!IntCaptureBatch(&TextOut, pgO, FIELD_OFFSET(GDIBSTEXTOUT, String)) ||
+            !IntCaptureBatch(pjData, pgO->String, cjData))
+        {
+            if (pjData != (PUCHAR)aulData) ExFreePoolWithTag(pjData, GDITAG_TEXT);
+            return 0;
+        }
+        pgO = &TextOut;
+
+        /* The Dx array and the string must both be in the entry */
+        Options = pgO->Options;
+        cbCount = pgO->cbCount;
+        cjDx = pgO->Size;
+        if (cjDx > cjData ||
+            cbCount > (cjData - cjDx) / sizeof(WCHAR) ||
+            (cjDx && cjDx < cbCount * ((Options & ETO_PDY) ? 2 : 1) * sizeof(INT)))
+        {
+            if (pjData != (PUCHAR)aulData) ExFreePoolWithTag(pjData, GDITAG_TEXT);
+            break;
+        }
+        rcl = *(PRECTL)&pgO->Rect;
+
+        /* Save the attributes and set the ones of the time of the call */
+        crForegroundClr = pdcattr->crForegroundClr;
+        ulForegroundClr = pdcattr->ulForegroundClr;
+        crBackgroundClr = pdcattr->crBackgroundClr;
+        ulBackgroundClr = pdcattr->ulBackgroundClr;
+        lBkMode = pdcattr->lBkMode;
+        jBkMode = pdcattr->jBkMode;
+        lTextAlign = pdcattr->lTextAlign;
+        hlfntNew = pdcattr->hlfntNew;
+
+        if (pgO->crForegroundClr != crForegroundClr)
+            flDirty |= DIRTY_TEXT;
+        if (pgO->crBackgroundClr != crBackgroundClr)
+            flDirty |= DIRTY_BACKGROUND;
+
+        pdcattr->crForegroundClr = pgO->crForegroundClr;
+        pdcattr->ulForegroundClr = pgO->ulForegroundClr;
+        pdcattr->crBackgroundClr = pgO->crBackgroundClr;
+        pdcattr->ulBackgroundClr = pgO->ulBackgroundClr;
+        pdcattr->lBkMode = pgO->lmBkMode;
+        pdcattr->jBkMode = (BYTE)pgO->lmBkMode;
+        pdcattr->lTextAlign = pgO->flTextAlign;
+        pdcattr->hlfntNew = pgO->hlfntNew;
+        pdcattr->ulDirty_ |= flDirty;
+
+        GreExtTextOutW(dc->BaseObject.hHmgr,
+                       pgO->x,
+                       pgO->y,
+                       Options & ~GDIBS_NORECT,
+                       (Options & GDIBS_NORECT) ? NULL : &rcl,
+                       (LPCWSTR)(pjData + cjDx),
+                       cbCount,
+                       cjDx ? (LPINT)pjData : NULL,
+                       pgO->iCS_CP);
+        if (pjData != (PUCHAR)aulData) ExFreePoolWithTag(pjData, GDITAG_TEXT);
+
+        /* Restore the attributes, the brushes have to follow them again */
+        pdcattr->crForegroundClr = crForegroundClr;
+        pdcattr->ulForegroundClr = ulForegroundClr;
+        pdcattr->crBackgroundClr = crBackgroundClr;
+        pdcattr->ulBackgroundClr = ulBackgroundClr;
+        pdcattr->lBkMode = lBkMode;
+        pdcattr->jBkMode = jBkMode;
+        pdcattr->lTextAlign = lTextAlign;
+        pdcattr->hlfntNew = hlfntNew;
+        pdcattr->ulDirty_ |= flDirty;
         break;
+     }
 
      case GdiBCExtTextOut:
+     {
+        GDIBSEXTTEXTOUT ExtTextOut;
+        COLORREF crBackgroundClr;
+        ULONG ulBackgroundClr;
+        RECTL rcl;
+        FLONG flDirty = 0;
+
+        if (!dc || Size < sizeof(GDIBSEXTTEXTOUT)) break;
+        if (!IntCaptureBatch(&ExtTextOut, pHdr, sizeof(ExtTextOut))) return 0;
+        rcl = *(PRECTL)&ExtTextOut.Rect;
+
+        /* This only fills the rectangle with the background color */
+        crBackgroundClr = pdcattr->crBackgroundClr;
+        ulBackgroundClr = pdcattr->ulBackgroundClr;
+        if (ExtTextOut.ulBackgroundClr != crBackgroundClr)
+            flDirty |= DIRTY_BACKGROUND;
+
+        pdcattr->crBackgroundClr = ExtTextOut.ulBackgroundClr;
+        pdcattr->ulBackgroundClr = ExtTextOut.ulBackgroundClr;
+        pdcattr->ulDirty_ |= flDirty;
+
+        GreExtTextOutW(dc->BaseObject.hHmgr,
+                       0,
+                       0,
+                       ExtTextOut.Options,
+                       &rcl,
+                       NULL,
+                       0,
+                       NULL,
+                       0);
+
+        pdcattr->crBackgroundClr = crBackgroundClr;
+        pdcattr->ulBackgroundClr = ulBackgroundClr;
+        pdcattr->ulDirty_ |= flDirty;
         break;
+     }
 
      case GdiBCSetBrushOrg:
      {
-        PGDIBSSETBRHORG pgSBO;
-        if (!dc) break;
-        pgSBO = (PGDIBSSETBRHORG) pHdr;
-        pdcattr->ptlBrushOrigin = pgSBO->ptlBrushOrigin;
-        DC_vSetBrushOrigin(dc, pgSBO->ptlBrushOrigin.x, pgSBO->ptlBrushOrigin.y);
+        GDIBSSETBRHORG SetBrushOrg;
+
+        if (!dc || Size < sizeof(GDIBSSETBRHORG)) break;
+        if (!IntCaptureBatch(&SetBrushOrg, pHdr, sizeof(SetBrushOrg))) return 0;
+        pdcattr->ptlBrushOrigin = SetBrushOrg.ptlBrushOrigin;
+        DC_vSetBrushOrigin(dc, SetBrushOrg.ptlBrushOrigin.x, SetBrushOrg.ptlBrushOrigin.y);
         break;
      }
 
@@ -115,12 +364,12 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
 
      case GdiBCSelObj:
      {
-        PGDIBSOBJECT pgO;
+        GDIBSOBJECT Object;
 
-        if (!dc) break;
-        pgO = (PGDIBSOBJECT) pHdr;
+        if (!dc || Size < sizeof(GDIBSOBJECT)) break;
+        if (!IntCaptureBatch(&Object, pHdr, sizeof(Object))) return 0;
 
-        DC_hSelectFont(dc, (HFONT)pgO->hgdiobj);
+        DC_hSelectFont(dc, (HFONT)Object.hgdiobj);
         break;
      }
 
@@ -129,8 +378,11 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
         /* Fall through */
      case GdiBCDelObj:
      {
-        PGDIBSOBJECT pgO = (PGDIBSOBJECT) pHdr;
-        GreDeleteObject( pgO->hgdiobj );
+        GDIBSOBJECT Object;
+
+        if (Size < sizeof(GDIBSOBJECT)) break;
+        if (!IntCaptureBatch(&Object, pHdr, sizeof(Object))) return 0;
+        GreDeleteObject(Object.hgdiobj);
         break;
      }
 
@@ -168,11 +420,17 @@ APIENTRY
 NtGdiFlushUserBatch(VOID)
 {
   PTEB pTeb = NtCurrentTeb();
-  ULONG GdiBatchCount = pTeb->GdiBatchCount;
+  ULONG GdiBatchCount;
+  HDC hDC;
+
+  if (!IntCaptureBatch(&GdiBatchCount, &pTeb->GdiBatchCount, sizeof(GdiBatchCount)) ||
+      !IntCaptureBatch(&hDC, &pTeb->GdiTebBatch.HDC, sizeof(hDC)))
+  {
+    return STATUS_SUCCESS;
+  }
 
   if( (GdiBatchCount > 0) && (GdiBatchCount <= (GDIBATCHBUFSIZE/4)))
   {
-    HDC hDC = (HDC) pTeb->GdiTebBatch.HDC;
 
     /*  If hDC is zero and the buffer fills up with delete objects we need
         to run anyway.
@@ -191,6 +449,11 @@ NtGdiFlushUserBatch(VOID)
        for (; GdiBatchCount > 0; GdiBatchCount--)
        {
            ULONG Size;
+
+           // The entry header must be in the buffer.
+           if (pHdr + sizeof(GDIBATCHHDR) > (PCHAR)&pTeb->GdiTebBatch.Buffer[0] + GDIBATCHBUFSIZE)
+               break;
+
            // Process Gdi Batch!
            Size = GdiFlushUserBatch(pDC, (PGDIBATCHHDR) pHdr);
            if (!Size) break;
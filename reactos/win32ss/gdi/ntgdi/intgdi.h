@@ -11,6 +11,15 @@
 
 /* Brush functions */
 
+BOOL FASTCALL
+IntPatBlt(PDC pdc,
+          INT XLeft,
+          INT YLeft,
+          INT Width,
+          INT Height,
+          DWORD dwRop3,
+          PEBRUSHOBJ pebo);
+
 extern HDC hSystemBM;
 extern HSEMAPHORE hsemDriverMgmt;
 
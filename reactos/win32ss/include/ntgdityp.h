@@ -489,6 +489,11 @@ typedef struct _GDIBSPPATBLT
   PATRECT pRect[1]; // POLYPATBLT
 } GDIBSPPATBLT, *PGDIBSPPATBLT;
 
+/* GdiBCTextOut: Options has no rectangle */
+#define GDIBS_NORECT 0x80000000
+
+/* GdiBCTextOut: String holds the Size bytes of the Dx array first, if any,
+   followed by the cbCount characters */
 typedef struct _GDIBSTEXTOUT
 {
   GDIBATCHHDR gbHdr;
@@ -0,0 +1,153 @@
+/*
+ * PROJECT:         ReactOS API tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for flushing large registry changes
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <winreg.h>
+#include <strsafe.h>
+
+#define TEST_KEY    L"Software\\ReactOS-apitest-RegFlushKey"
+#define SUBKEYS     64
+#define VALUES      64
+
+static
+ULONG
+WriteValues(HKEY Key, ULONG Subkeys, ULONG Values, DWORD Seed)
+{
+    WCHAR Name[32];
+    HKEY Subkey;
+    DWORD Data;
+    ULONG i, j, Failures = 0;
+    LONG Error;
+
+    for (i = 0; i < Subkeys; i++)
+    {
+        StringCchPrintfW(Name, _countof(Name), L"Key%lu", i);
+        Error = RegCreateKeyExW(Key, Name, 0, NULL, 0, KEY_SET_VALUE, NULL, &Subkey, NULL);
+        if (Error != ERROR_SUCCESS)
+        {
+            Failures++;
+            continue;
+        }
+
+        for (j = 0; j < Values; j++)
+        {
+            StringCchPrintfW(Name, _countof(Name), L"Value%lu", j);
+            Data = Seed + i * Values + j;
+            if (RegSetValueExW(Subkey, Name, 0, REG_DWORD, (PBYTE)&Data, sizeof(Data)) != ERROR_SUCCESS)
+                Failures++;
+        }
+
+        RegCloseKey(Subkey);
+    }
+
+    return Failures;
+}
+
+static
+ULONG
+CheckValues(HKEY Key, ULONG Subkeys, ULONG Values, DWORD Seed)
+{
+    WCHAR Name[32];
+    HKEY Subkey;
+    DWORD Data, Size, Type;
+    ULONG i, j, Mismatches = 0;
+
+    for (i = 0; i < Subkeys; i++)
+    {
+        StringCchPrintfW(Name, _countof(Name), L"Key%lu", i);
+        if (RegOpenKeyExW(Key, Name, 0, KEY_QUERY_VALUE, &Subkey) != ERROR_SUCCESS)
+        {
+            Mismatches += Values;
+            continue;
+        }
+
+        for (j = 0; j < Values; j++)
+        {
+            StringCchPrintfW(Name, _countof(Name), L"Value%lu", j);
+            Size = sizeof(Data);
+            if (RegQueryValueExW(Subkey, Name, NULL, &Type, (PBYTE)&Data, &Size) != ERROR_SUCCESS ||
+                Type != REG_DWORD || Data != Seed + i * Values + j)
+            {
+                Mismatches++;
+            }
+        }
+
+        RegCloseKey(Subkey);
+    }
+
+    return Mismatches;
+}
+
+static
+VOID
+DeleteTestKey(VOID)
+{
+    WCHAR Name[32];
+    HKEY Key;
+    ULONG i;
+
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, TEST_KEY, 0, KEY_ALL_ACCESS, &Key) != ERROR_SUCCESS)
+        return;
+
+    for (i = 0; i < SUBKEYS; i++)
+    {
+        StringCchPrintfW(Name, _countof(Name), L"Key%lu", i);
+        RegDeleteKeyW(Key, Name);
+    }
+
+    RegCloseKey(Key);
+    RegDeleteKeyW(HKEY_CURRENT_USER, TEST_KEY);
+}
+
+START_TEST(RegFlushKey)
+{
+    HKEY Key;
+    LONG Error;
+    DWORD Start, WriteTicks, FlushTicks, SmallTicks, CleanTicks;
+
+    DeleteTestKey();
+    Error = RegCreateKeyExW(HKEY_CURRENT_USER, TEST_KEY, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &Key, NULL);
+    ok_long(Error, ERROR_SUCCESS);
+    if (Error != ERROR_SUCCESS)
+    {
+        skip("Could not create the test key\n");
+        return;
+    }
+
+    /* Write a lot of data and push all of it out */
+    Start = GetTickCount();
+    ok_long(WriteValues(Key, SUBKEYS, VALUES, 0), 0);
+    WriteTicks = GetTickCount() - Start;
+
+    Start = GetTickCount();
+    ok_long(RegFlushKey(Key), ERROR_SUCCESS);
+    FlushTicks = GetTickCount() - Start;
+
+    /* Touch only a handful of values, the flush should only write those bins */
+    ok_long(WriteValues(Key, 2, VALUES, 0x1000), 0);
+    Start = GetTickCount();
+    ok_long(RegFlushKey(Key), ERROR_SUCCESS);
+    SmallTicks = GetTickCount() - Start;
+
+    /* Nothing changed since, there is nothing to write */
+    Start = GetTickCount();
+    ok_long(RegFlushKey(Key), ERROR_SUCCESS);
+    CleanTicks = GetTickCount() - Start;
+
+    /* Everything we wrote must still be there, only the first two keys were changed */
+    ok_long(CheckValues(Key, 2, VALUES, 0x1000), 0);
+    ok_long(CheckValues(Key, SUBKEYS, VALUES, 0), 2 * VALUES);
+
+    trace("%u values written in %lu ms\n", SUBKEYS * VALUES, WriteTicks);
+    trace("Flush after %u values: %lu ms, after %u values: %lu ms, clean: %lu ms\n",
+          SUBKEYS * VALUES, FlushTicks, 2 * VALUES, SmallTicks, CleanTicks);
+
+    RegCloseKey(Key);
+    DeleteTestKey();
+}
@@ -0,0 +1,391 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Correctness and speed of the Fast486 instruction dispatch and memory access
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <fast486.h>
+
+#define MEMORY_SIZE     0x110000
+#define CODE_SEGMENT    0x1000
+#define CODE_BASE       (CODE_SEGMENT << 4)
+#define LOOP_COUNT      0xFFFF
+#define BENCHMARK_RUNS  32
+#define DATA_SEGMENT    0x2000
+#define DATA_BASE       (DATA_SEGMENT << 4)
+#define GDT_BASE        0x0500
+#define CODE_SELECTOR   0x08
+#define DATA_SELECTOR   0x10
+
+static PUCHAR Memory;
+
+/* Reads from that page return 0x5A and writes are dropped, like a ROM */
+static ULONG HookedPage;
+static ULONG HookedReads;
+
+static
+VOID
+FASTCALL
+MemReadCallback(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if ((Address >> 12) == HookedPage)
+    {
+        RtlFillMemory(Buffer, Size, 0x5A);
+        HookedReads++;
+    }
+    else if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        RtlCopyMemory(Buffer, &Memory[Address], Size);
+    else
+        RtlFillMemory(Buffer, Size, 0xFF);
+}
+
+static
+VOID
+FASTCALL
+MemWriteCallback(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if ((Address >> 12) == HookedPage)
+        return;
+
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        RtlCopyMemory(&Memory[Address], Buffer, Size);
+}
+
+static
+BOOLEAN
+FASTCALL
+MemMapCallback(PFAST486_STATE State, ULONG Address, BOOLEAN Writing, PVOID *HostAddress)
+{
+    if ((Address >> 12) == HookedPage || Address >= (MEMORY_SIZE & ~0xFFF))
+        return FALSE;
+
+    *HostAddress = &Memory[Address];
+    return TRUE;
+}
+
+static
+ULONG
+StepUntilHalted(PFAST486_STATE State)
+{
+    ULONG Instructions = 0;
+
+    /* Step like NTVDM does, the host gets control between instructions */
+    State->Halted = FALSE;
+    while (!State->Halted && Instructions < 0x10000000)
+    {
+        Fast486StepInto(State);
+        Instructions++;
+    }
+
+    return Instructions;
+}
+
+static
+ULONG
+RunCode(PFAST486_STATE State, const UCHAR *Code, ULONG CodeSize)
+{
+    RtlCopyMemory(&Memory[CODE_BASE], Code, CodeSize);
+    Fast486InvalidateCache(State, CODE_BASE, CodeSize);
+
+    Fast486SetSegment(State, FAST486_REG_DS, CODE_SEGMENT);
+    Fast486SetStack(State, CODE_SEGMENT, 0xFFFE);
+    Fast486ExecuteAt(State, CODE_SEGMENT, 0);
+
+    return StepUntilHalted(State);
+}
+
+/* Runs the code at CODE_BASE in flat 32-bit protected mode */
+static
+ULONG
+RunCode32(PFAST486_STATE State, const UCHAR *Code, ULONG CodeSize)
+{
+    PFAST486_GDT_ENTRY Gdt = (PFAST486_GDT_ENTRY)&Memory[GDT_BASE];
+    ULONG i;
+
+    /* A null descriptor, then 4 GB code and data segments */
+    RtlZeroMemory(Gdt, 3 * sizeof(*Gdt));
+    for (i = 1; i < 3; i++)
+    {
+        Gdt[i].Limit = 0xFFFF;
+        Gdt[i].LimitHigh = 0xF;
+        Gdt[i].ReadWrite = 1;
+        Gdt[i].Executable = (i == CODE_SELECTOR / sizeof(*Gdt));
+        Gdt[i].SystemType = 1;
+        Gdt[i].Present = 1;
+        Gdt[i].Size = 1;
+        Gdt[i].Granularity = 1;
+    }
+
+    State->Gdtr.Address = GDT_BASE;
+    State->Gdtr.Size = 3 * sizeof(*Gdt) - 1;
+    State->ControlRegisters[FAST486_REG_CR0] |= FAST486_CR0_PE;
+    Fast486FlushMemoryMap(State);
+
+    RtlCopyMemory(&Memory[CODE_BASE], Code, CodeSize);
+    Fast486InvalidateCache(State, CODE_BASE, CodeSize);
+
+    Fast486SetSegment(State, FAST486_REG_DS, DATA_SELECTOR);
+    Fast486SetStack(State, DATA_SELECTOR, CODE_BASE + 0xFFFC);
+    Fast486ExecuteAt(State, CODE_SELECTOR, CODE_BASE);
+
+    return StepUntilHalted(State);
+}
+
+/* A mix of ALU, prefixed and looping instructions */
+static const UCHAR LoopCode[] =
+{
+    0xB9, 0xFF, 0xFF,                   /* 00: mov cx, LOOP_COUNT */
+    0x31, 0xC0,                         /* 03: xor ax, ax */
+    0x31, 0xDB,                         /* 05: xor bx, bx */
+    0x40,                               /* 07: inc ax */
+    0x01, 0xC3,                         /* 08: add bx, ax */
+    0x66, 0x83, 0xC2, 0x03,             /* 0A: add edx, 3 */
+    0x2E, 0x8B, 0x36, 0x40, 0x00,       /* 0E: mov si, cs:[0x40] */
+    0x0F, 0xB6, 0xFB,                   /* 13: movzx di, bl */
+    0xE2, 0xEF,                         /* 16: loop 07 */
+    0xF4,                               /* 18: hlt */
+};
+
+/* The same mix in 32-bit code, with a 16-bit operand size prefix instead */
+static const UCHAR LoopCode32[] =
+{
+    0xB9, 0xFF, 0xFF, 0x00, 0x00,       /* 00: mov ecx, LOOP_COUNT */
+    0x31, 0xC0,                         /* 05: xor eax, eax */
+    0x31, 0xDB,                         /* 07: xor ebx, ebx */
+    0x40,                               /* 09: inc eax */
+    0x01, 0xC3,                         /* 0A: add ebx, eax */
+    0x66, 0x83, 0xC2, 0x03,             /* 0C: add dx, 3 */
+    0x2E, 0x8B, 0x35,
+        0x40, 0x00, 0x01, 0x00,         /* 10: mov esi, cs:[CODE_BASE + 0x40] */
+    0x0F, 0xB6, 0xFB,                   /* 17: movzx edi, bl */
+    0xE2, 0xED,                         /* 1A: loop 09 */
+    0xF4,                               /* 1C: hlt */
+};
+
+/* Patches its own opcode, mov al, 0x11 becomes mov ah, 0x11 */
+static const UCHAR PatchCode[] =
+{
+    0xB9, 0x02, 0x00,                   /* 00: mov cx, 2 */
+    0xB0, 0x11,                         /* 03: mov al, 0x11 */
+    0xC6, 0x06, 0x03, 0x00, 0xB4,       /* 05: mov byte [0x03], 0xB4 */
+    0xE2, 0xF7,                         /* 0A: loop 03 */
+    0xF4,                               /* 0C: hlt */
+};
+
+/* Reads a hooked and a plain page, then writes the plain one */
+static const UCHAR AccessCode[] =
+{
+    0x26, 0xA1, 0x10, 0x00,             /* 00: mov ax, es:[0x0010] */
+    0x26, 0x8B, 0x1E, 0x10, 0x10,       /* 04: mov bx, es:[0x1010] */
+    0x26, 0xA3, 0x20, 0x10,             /* 09: mov es:[0x1020], ax */
+    0xF4,                               /* 0D: hlt */
+};
+
+static
+VOID
+TestLoop(PFAST486_STATE State, PCSTR Description)
+{
+    LARGE_INTEGER Start, End, Frequency;
+    ULONGLONG Instructions = 0;
+    ULONG i;
+    double Seconds;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCHMARK_RUNS; i++)
+    {
+        State->GeneralRegs[FAST486_REG_EDX].Long = 0;
+        *(PUSHORT)&Memory[CODE_BASE + 0x40] = (USHORT)i;
+        Instructions += RunCode(State, LoopCode, sizeof(LoopCode));
+
+        ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == LOOP_COUNT,
+           "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+        ok(State->GeneralRegs[FAST486_REG_EBX].LowWord == (USHORT)((ULONG)LOOP_COUNT * (LOOP_COUNT + 1) / 2),
+           "BX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EBX].LowWord);
+        ok(State->GeneralRegs[FAST486_REG_EDX].Long == LOOP_COUNT * 3,
+           "EDX = 0x%08lx\n", State->GeneralRegs[FAST486_REG_EDX].Long);
+        ok(State->GeneralRegs[FAST486_REG_ESI].LowWord == (USHORT)i,
+           "SI = 0x%04x\n", State->GeneralRegs[FAST486_REG_ESI].LowWord);
+        ok(State->GeneralRegs[FAST486_REG_EDI].LowWord == State->GeneralRegs[FAST486_REG_EBX].LowByte,
+           "DI = 0x%04x\n", State->GeneralRegs[FAST486_REG_EDI].LowWord);
+    }
+    QueryPerformanceCounter(&End);
+
+    ok(Instructions == BENCHMARK_RUNS * (3 + 6 * LOOP_COUNT + 1ULL),
+       "%I64u instructions executed\n", Instructions);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("%s: %I64u instructions in %.3f s, %.2f MIPS\n",
+              Description, Instructions, Seconds, Instructions / Seconds / 1000000);
+    }
+}
+
+static
+VOID
+TestLoop32(PFAST486_STATE State, PCSTR Description)
+{
+    LARGE_INTEGER Start, End, Frequency;
+    ULONGLONG Instructions = 0;
+    ULONG i;
+    double Seconds;
+
+    C_ASSERT(CODE_BASE == 0x10000);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCHMARK_RUNS; i++)
+    {
+        State->GeneralRegs[FAST486_REG_EDX].Long = 0;
+        *(PULONG)&Memory[CODE_BASE + 0x40] = i << 16 | i;
+        Instructions += RunCode32(State, LoopCode32, sizeof(LoopCode32));
+
+        ok(State->GeneralRegs[FAST486_REG_EAX].Long == LOOP_COUNT,
+           "EAX = 0x%08lx\n", State->GeneralRegs[FAST486_REG_EAX].Long);
+        ok(State->GeneralRegs[FAST486_REG_EBX].Long == (ULONG)LOOP_COUNT * (LOOP_COUNT + 1) / 2,
+           "EBX = 0x%08lx\n", State->GeneralRegs[FAST486_REG_EBX].Long);
+        ok(State->GeneralRegs[FAST486_REG_EDX].Long == (USHORT)(LOOP_COUNT * 3),
+           "EDX = 0x%08lx\n", State->GeneralRegs[FAST486_REG_EDX].Long);
+        ok(State->GeneralRegs[FAST486_REG_ESI].Long == (i << 16 | i),
+           "ESI = 0x%08lx\n", State->GeneralRegs[FAST486_REG_ESI].Long);
+        ok(State->GeneralRegs[FAST486_REG_EDI].Long == State->GeneralRegs[FAST486_REG_EBX].LowByte,
+           "EDI = 0x%08lx\n", State->GeneralRegs[FAST486_REG_EDI].Long);
+    }
+    QueryPerformanceCounter(&End);
+
+    ok(Instructions == BENCHMARK_RUNS * (3 + 6 * LOOP_COUNT + 1ULL),
+       "%I64u instructions executed\n", Instructions);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("%s, 32-bit: %I64u instructions in %.3f s, %.2f MIPS\n",
+              Description, Instructions, Seconds, Instructions / Seconds / 1000000);
+    }
+}
+
+static
+VOID
+TestSelfModifying(PFAST486_STATE State)
+{
+    static const UCHAR MovCode[] =
+    {
+        0xB0, 0x33,                     /* 00: mov al, 0x33 */
+        0xF4,                           /* 02: hlt */
+    };
+
+    /* Written by the guest */
+    State->GeneralRegs[FAST486_REG_EAX].Long = 0;
+    RunCode(State, PatchCode, sizeof(PatchCode));
+    ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == 0x1111,
+       "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+
+    /* Written by the host, once the code has run */
+    State->GeneralRegs[FAST486_REG_EAX].Long = 0;
+    RunCode(State, MovCode, sizeof(MovCode));
+    ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == 0x0033,
+       "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+
+    State->GeneralRegs[FAST486_REG_EAX].Long = 0;
+    Memory[CODE_BASE] = 0xB4;
+    Fast486InvalidateCache(State, CODE_BASE, 1);
+    Fast486ExecuteAt(State, CODE_SEGMENT, 0);
+    State->Halted = FALSE;
+    while (!State->Halted) Fast486StepInto(State);
+    ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == 0x3300,
+       "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+}
+
+static
+VOID
+TestMemoryMap(PFAST486_STATE State)
+{
+    HookedPage = DATA_BASE >> 12;
+    HookedReads = 0;
+    Fast486FlushMemoryMap(State);
+
+    *(PUSHORT)&Memory[DATA_BASE + 0x1010] = 0x1234;
+    *(PUSHORT)&Memory[DATA_BASE + 0x1020] = 0;
+    Fast486SetSegment(State, FAST486_REG_ES, DATA_SEGMENT);
+    RunCode(State, AccessCode, sizeof(AccessCode));
+    ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == 0x5A5A,
+       "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+    ok(State->GeneralRegs[FAST486_REG_EBX].LowWord == 0x1234,
+       "BX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EBX].LowWord);
+    ok(*(PUSHORT)&Memory[DATA_BASE + 0x1020] == 0x5A5A,
+       "Wrote 0x%04x\n", *(PUSHORT)&Memory[DATA_BASE + 0x1020]);
+    ok(HookedReads == 1, "%lu hooked reads\n", HookedReads);
+
+    /* Hook the page that was accessed directly */
+    HookedPage = (DATA_BASE + 0x1000) >> 12;
+    HookedReads = 0;
+    Fast486FlushMemoryMap(State);
+
+    *(PUSHORT)&Memory[DATA_BASE + 0x1020] = 0;
+    Fast486SetSegment(State, FAST486_REG_ES, DATA_SEGMENT);
+    RunCode(State, AccessCode, sizeof(AccessCode));
+    ok(State->GeneralRegs[FAST486_REG_EAX].LowWord == 0x0000,
+       "AX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EAX].LowWord);
+    ok(State->GeneralRegs[FAST486_REG_EBX].LowWord == 0x5A5A,
+       "BX = 0x%04x\n", State->GeneralRegs[FAST486_REG_EBX].LowWord);
+    ok(*(PUSHORT)&Memory[DATA_BASE + 0x1020] == 0,
+       "Wrote 0x%04x\n", *(PUSHORT)&Memory[DATA_BASE + 0x1020]);
+    ok(HookedReads == 1, "%lu hooked reads\n", HookedReads);
+
+    HookedPage = MAXULONG;
+    Fast486FlushMemoryMap(State);
+}
+
+START_TEST(Benchmark)
+{
+    PFAST486_STATE State;
+
+    Memory = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, MEMORY_SIZE);
+    State = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*State));
+    if (!Memory || !State)
+    {
+        skip("No memory\n");
+        goto Cleanup;
+    }
+
+    HookedPage = MAXULONG;
+    Fast486Initialize(State,
+                      MemReadCallback,
+                      MemWriteCallback,
+                      MemMapCallback,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL);
+
+    TestSelfModifying(State);
+    TestMemoryMap(State);
+    TestLoop(State, "Direct memory access");
+    TestLoop32(State, "Direct memory access");
+
+    /* Everything through the callbacks, for comparison */
+    Fast486Initialize(State,
+                      MemReadCallback,
+                      MemWriteCallback,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL);
+
+    TestSelfModifying(State);
+    TestLoop(State, "Memory callbacks");
+    TestLoop32(State, "Memory callbacks");
+
+Cleanup:
+    if (State) HeapFree(GetProcessHeap(), 0, State);
+    if (Memory) HeapFree(GetProcessHeap(), 0, Memory);
+}
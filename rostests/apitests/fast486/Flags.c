@@ -0,0 +1,215 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for the arithmetic flags computed by Fast486
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <fast486.h>
+
+#define MEMORY_SIZE     0x110000
+#define CODE_SEGMENT    0x1000
+#define CODE_BASE       (CODE_SEGMENT << 4)
+#define ISR_OFFSET      0x100
+
+#define FLAGS_MASK      (0x0001 | 0x0004 | 0x0010 | 0x0040 | 0x0080 | 0x0800)
+
+typedef struct _FLAGS_TEST
+{
+    UCHAR Code[8];
+    ULONG CodeLength;
+    ULONG Eax;
+    ULONG Ebx;
+    ULONG Result;
+    USHORT Flags;
+} FLAGS_TEST;
+
+static const FLAGS_TEST Tests[] =
+{
+    /* add ax, bx */
+    { { 0x01, 0xD8 }, 2, 0xFFFF, 0x0001, 0x0000, 0x0055 },
+    /* add eax, ebx */
+    { { 0x66, 0x01, 0xD8 }, 3, 0x7FFFFFFF, 0x00000001, 0x80000000, 0x0894 },
+    /* add al, 0x80 */
+    { { 0x04, 0x80 }, 2, 0x1280, 0, 0x1200, 0x0845 },
+    /* add ax, 1 */
+    { { 0x83, 0xC0, 0x01 }, 3, 0x000F, 0, 0x0010, 0x0010 },
+    /* sub ax, bx */
+    { { 0x29, 0xD8 }, 2, 0x0000, 0x0001, 0xFFFF, 0x0095 },
+    /* cmp eax, ebx */
+    { { 0x66, 0x39, 0xD8 }, 3, 0x80000000, 0x00000001, 0x80000000, 0x0814 },
+    /* sub al, 1 */
+    { { 0x2C, 0x01 }, 2, 0x0000, 0, 0x00FF, 0x0095 },
+    /* cmp bl, 0x10 */
+    { { 0x80, 0xFB, 0x10 }, 3, 0, 0x10, 0, 0x0044 },
+    /* and ax, bx */
+    { { 0x21, 0xD8 }, 2, 0xF0F0, 0x0FF0, 0x00F0, 0x0004 },
+    /* or al, bl */
+    { { 0x08, 0xD8 }, 2, 0x0080, 0x0001, 0x0081, 0x0084 },
+    /* xor eax, ebx */
+    { { 0x66, 0x31, 0xD8 }, 3, 0x12345678, 0x12345678, 0x00000000, 0x0044 },
+    /* test ax, bx */
+    { { 0x85, 0xD8 }, 2, 0x8001, 0x8000, 0x8001, 0x0084 },
+    /* add ax, bx, inc ax: CF comes from the ADD */
+    { { 0x01, 0xD8, 0x40 }, 3, 0xFFFF, 0x0001, 0x0001, 0x0001 },
+    /* dec eax */
+    { { 0x66, 0x48 }, 2, 0x80000000, 0, 0x7FFFFFFF, 0x0814 },
+    /* inc ax, inc ax: CF is still the one set by the host */
+    { { 0xF9, 0x40, 0x40 }, 3, 0x7FFE, 0, 0x8000, 0x0895 },
+    /* cmp ax, bx, adc ax, 0 */
+    { { 0x39, 0xD8, 0x83, 0xD0, 0x00 }, 5, 0x0001, 0x0002, 0x0002, 0x0000 },
+    /* inc ax, sbb ax, bx */
+    { { 0x40, 0x1B, 0xC3 }, 3, 0x0000, 0x0001, 0x0000, 0x0044 },
+};
+
+static PUCHAR Memory;
+
+static
+VOID
+FASTCALL
+MemReadCallback(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        RtlCopyMemory(Buffer, &Memory[Address], Size);
+    else
+        RtlFillMemory(Buffer, Size, 0xFF);
+}
+
+static
+VOID
+FASTCALL
+MemWriteCallback(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    if (Address < MEMORY_SIZE && Size <= MEMORY_SIZE - Address)
+        RtlCopyMemory(&Memory[Address], Buffer, Size);
+}
+
+static
+VOID
+LoadTest(PFAST486_STATE State, const FLAGS_TEST *Test, BOOLEAN Interrupt, PULONG Length)
+{
+    PUCHAR Code = &Memory[CODE_BASE];
+    ULONG i = 0;
+
+    /* mov eax, Eax */
+    Code[i++] = 0x66;
+    Code[i++] = 0xB8;
+    *(PULONG)&Code[i] = Test->Eax;
+    i += sizeof(ULONG);
+
+    /* mov ebx, Ebx */
+    Code[i++] = 0x66;
+    Code[i++] = 0xBB;
+    *(PULONG)&Code[i] = Test->Ebx;
+    i += sizeof(ULONG);
+
+    RtlCopyMemory(&Code[i], Test->Code, Test->CodeLength);
+    i += Test->CodeLength;
+    *Length = i;
+
+    if (Interrupt)
+    {
+        /* int 0x80 */
+        Code[i++] = 0xCD;
+        Code[i++] = 0x80;
+    }
+    else
+    {
+        /* pushf, pop dx, hlt */
+        Code[i++] = 0x9C;
+        Code[i++] = 0x5A;
+        Code[i++] = 0xF4;
+    }
+    Fast486InvalidateCache(State, CODE_BASE, i);
+
+    /* Start with all the flags clear */
+    Fast486UpdateFlags(State);
+    State->Flags.Long = 0x0002;
+    State->Halted = FALSE;
+    Fast486SetSegment(State, FAST486_REG_DS, CODE_SEGMENT);
+    Fast486SetStack(State, CODE_SEGMENT, 0xFFFE);
+    Fast486ExecuteAt(State, CODE_SEGMENT, 0);
+}
+
+static
+VOID
+RunUntil(PFAST486_STATE State, ULONG Offset)
+{
+    ULONG Steps = 0;
+
+    while (!State->Halted && State->InstPtr.LowWord != Offset && Steps++ < 100)
+        Fast486StepInto(State);
+}
+
+static
+VOID
+TestFlags(PFAST486_STATE State)
+{
+    ULONG i, Length;
+    USHORT Flags;
+
+    for (i = 0; i < sizeof(Tests) / sizeof(Tests[0]); i++)
+    {
+        /* Read by the host right after the operation */
+        LoadTest(State, &Tests[i], FALSE, &Length);
+        RunUntil(State, Length);
+        ok(State->GeneralRegs[FAST486_REG_EAX].Long == Tests[i].Result,
+           "Test %lu: EAX = 0x%08lx\n", i, State->GeneralRegs[FAST486_REG_EAX].Long);
+        Fast486UpdateFlags(State);
+        Flags = State->Flags.LowWord & FLAGS_MASK;
+        ok(Flags == Tests[i].Flags, "Test %lu: flags 0x%04x, expected 0x%04x\n", i, Flags, Tests[i].Flags);
+
+        /* Read by the guest */
+        RunUntil(State, (ULONG)-1);
+        ok(State->Halted, "Test %lu: not halted\n", i);
+        Flags = State->GeneralRegs[FAST486_REG_EDX].LowWord & FLAGS_MASK;
+        ok(Flags == Tests[i].Flags, "Test %lu: pushed flags 0x%04x, expected 0x%04x\n", i, Flags, Tests[i].Flags);
+
+        /* Pushed by an interrupt, the handler saves them in DX */
+        LoadTest(State, &Tests[i], TRUE, &Length);
+        RunUntil(State, (ULONG)-1);
+        ok(State->Halted, "Test %lu: not halted\n", i);
+        Flags = State->GeneralRegs[FAST486_REG_EDX].LowWord & FLAGS_MASK;
+        ok(Flags == Tests[i].Flags, "Test %lu: interrupt flags 0x%04x, expected 0x%04x\n", i, Flags, Tests[i].Flags);
+    }
+}
+
+START_TEST(Flags)
+{
+    PFAST486_STATE State;
+
+    Memory = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, MEMORY_SIZE);
+    State = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*State));
+    if (!Memory || !State)
+    {
+        skip("No memory\n");
+        goto Cleanup;
+    }
+
+    /* The interrupt handler pops IP, CS and the flags */
+    *(PUSHORT)&Memory[0x80 * 4] = ISR_OFFSET;
+    *(PUSHORT)&Memory[0x80 * 4 + 2] = CODE_SEGMENT;
+    Memory[CODE_BASE + ISR_OFFSET] = 0x5B;
+    Memory[CODE_BASE + ISR_OFFSET + 1] = 0x59;
+    Memory[CODE_BASE + ISR_OFFSET + 2] = 0x5A;
+    Memory[CODE_BASE + ISR_OFFSET + 3] = 0xF4;
+
+    Fast486Initialize(State,
+                      MemReadCallback,
+                      MemWriteCallback,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL,
+                      NULL);
+
+    TestFlags(State);
+
+Cleanup:
+    if (State) HeapFree(GetProcessHeap(), 0, State);
+    if (Memory) HeapFree(GetProcessHeap(), 0, Memory);
+}
@@ -0,0 +1,12 @@
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_Benchmark(void);
+extern void func_Flags(void);
+
+const struct test winetest_testlist[] =
+{
+    { "Benchmark", func_Benchmark },
+    { "Flags", func_Flags },
+    { 0, 0 }
+};
@@ -167,6 +167,224 @@ Test_CreateFontIndirectExW(void)
     ok(elfedva.elfEnumLogfontEx.elfFullName[LF_FULLFACESIZE-1] == 0, "\n");
 }
 
+static
+int
+CALLBACK
+FontExistsProc(const LOGFONTW *lplf, const TEXTMETRICW *lptm, DWORD FontType, LPARAM lParam)
+{
+    *(PBOOL)lParam = TRUE;
+    return 0;
+}
+
+static
+HFONT
+CreateNamedFont(PCWSTR FaceName)
+{
+    LOGFONTW logfont;
+
+    ZeroMemory(&logfont, sizeof(logfont));
+    logfont.lfHeight = -16;
+    logfont.lfCharSet = DEFAULT_CHARSET;
+    lstrcpynW(logfont.lfFaceName, FaceName, LF_FACESIZE);
+    return CreateFontIndirectW(&logfont);
+}
+
+/* Every new font has to be matched against the installed ones */
+void
+Test_FontMatching(void)
+{
+    static const PCWSTR FaceNames[] = { L"Tahoma", L"Courier New", L"Marlett", L"Symbol" };
+    WCHAR Face[LF_FACESIZE];
+    TEXTMETRICW tm;
+    HFONT hFont;
+    HGDIOBJ hOldFont;
+    HDC hdc;
+    BOOL Exists;
+    DWORD Start, Ticks;
+    ULONG i, Realized, Failures;
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    if (!hdc)
+        return;
+
+    for (i = 0; i < _countof(FaceNames); i++)
+    {
+        Exists = FALSE;
+        EnumFontFamiliesW(hdc, FaceNames[i], FontExistsProc, (LPARAM)&Exists);
+        if (!Exists)
+        {
+            skip("%ls is not installed\n", FaceNames[i]);
+            continue;
+        }
+
+        hFont = CreateNamedFont(FaceNames[i]);
+        hOldFont = SelectObject(hdc, hFont);
+        ok(GetTextFaceW(hdc, _countof(Face), Face) != 0, "GetTextFaceW failed\n");
+        ok(lstrcmpiW(Face, FaceNames[i]) == 0, "Expected %ls, got %ls\n", FaceNames[i], Face);
+        SelectObject(hdc, hOldFont);
+        DeleteObject(hFont);
+    }
+
+    /* A name nobody has still gets a font */
+    hFont = CreateNamedFont(L"ReactOS No Such Font");
+    hOldFont = SelectObject(hdc, hFont);
+    ok(GetTextFaceW(hdc, _countof(Face), Face) != 0, "GetTextFaceW failed\n");
+    ok(Face[0] != UNICODE_NULL, "Expected a face name\n");
+    SelectObject(hdc, hOldFont);
+    DeleteObject(hFont);
+
+    Failures = 0;
+    Realized = 0;
+    Start = GetTickCount();
+    for (i = 0; i < 500; i++)
+    {
+        hFont = CreateNamedFont((i % 5) ? FaceNames[i % _countof(FaceNames)] : L"ReactOS No Such Font");
+        hOldFont = SelectObject(hdc, hFont);
+        if (!GetTextMetricsW(hdc, &tm))
+            Failures++;
+        else
+            Realized++;
+        SelectObject(hdc, hOldFont);
+        DeleteObject(hFont);
+    }
+    Ticks = GetTickCount() - Start;
+    ok_long(Failures, 0);
+    trace("%lu fonts realized in %lu ms\n", Realized, Ticks);
+
+    DeleteDC(hdc);
+}
+
+typedef struct _ENUMERATED_FONTS
+{
+    ULONG Count;
+    ENUMLOGFONTEXW Logfont[16];
+    TEXTMETRICW TextMetric[16];
+    DWORD FontType[16];
+} ENUMERATED_FONTS, *PENUMERATED_FONTS;
+
+static
+int
+CALLBACK
+CollectFontsProc(const LOGFONTW *lplf, const TEXTMETRICW *lptm, DWORD FontType, LPARAM lParam)
+{
+    PENUMERATED_FONTS Fonts = (PENUMERATED_FONTS)lParam;
+
+    if (Fonts->Count < _countof(Fonts->Logfont))
+    {
+        Fonts->Logfont[Fonts->Count] = *(const ENUMLOGFONTEXW *)lplf;
+        Fonts->TextMetric[Fonts->Count] = *lptm;
+        Fonts->FontType[Fonts->Count] = FontType;
+    }
+    Fonts->Count++;
+    return 1;
+}
+
+static
+VOID
+EnumerateFonts(HDC hdc, PCWSTR FaceName, PENUMERATED_FONTS Fonts)
+{
+    LOGFONTW logfont;
+
+    ZeroMemory(&logfont, sizeof(logfont));
+    logfont.lfCharSet = DEFAULT_CHARSET;
+    lstrcpynW(logfont.lfFaceName, FaceName, LF_FACESIZE);
+    ZeroMemory(Fonts, sizeof(*Fonts));
+    EnumFontFamiliesExW(hdc, &logfont, CollectFontsProc, (LPARAM)Fonts, 0);
+}
+
+static
+BOOL
+IsEnumeratedFont(PENUMERATED_FONTS Fonts, ULONG Index, PENUMERATED_FONTS Other)
+{
+    ULONG i;
+
+    for (i = 0; i < min(Other->Count, _countof(Other->Logfont)); i++)
+    {
+        if (memcmp(&Fonts->Logfont[Index], &Other->Logfont[i], sizeof(ENUMLOGFONTEXW)) == 0 &&
+            memcmp(&Fonts->TextMetric[Index], &Other->TextMetric[i], sizeof(TEXTMETRICW)) == 0 &&
+            Fonts->FontType[Index] == Other->FontType[i])
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* The system fonts come from the font catalogue and are only loaded when first used,
+   they have to look exactly like the same file loaded the usual way */
+void
+Test_CatalogedFont(void)
+{
+    WCHAR szFileName[MAX_PATH], Face[LF_FACESIZE], PrivateFace[LF_FACESIZE];
+    ENUMERATED_FONTS Fonts, PrivateFonts;
+    TEXTMETRICW tm, PrivateTm;
+    HFONT hFont;
+    HGDIOBJ hOldFont;
+    HDC hdc;
+    ULONG i;
+    int result;
+
+    GetEnvironmentVariableW(L"systemroot", szFileName, MAX_PATH);
+    wcscat(szFileName, L"\\Fonts\\cour.ttf");
+    if (GetFileAttributesW(szFileName) == INVALID_FILE_ATTRIBUTES)
+    {
+        skip("%ls is not installed\n", szFileName);
+        return;
+    }
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    if (!hdc)
+        return;
+
+    /* The installed font, its names and metrics are the ones from the catalogue */
+    EnumerateFonts(hdc, L"Courier New", &Fonts);
+    ok(Fonts.Count != 0, "Courier New is not enumerated\n");
+    ok(Fonts.Count <= _countof(Fonts.Logfont), "Too many fonts: %lu\n", Fonts.Count);
+
+    hFont = CreateNamedFont(L"Courier New");
+    hOldFont = SelectObject(hdc, hFont);
+    ok(GetTextMetricsW(hdc, &tm), "GetTextMetricsW failed\n");
+    ok(GetTextFaceW(hdc, _countof(Face), Face) != 0, "GetTextFaceW failed\n");
+    SelectObject(hdc, hOldFont);
+    DeleteObject(hFont);
+
+    /* The same file, parsed now */
+    result = AddFontResourceExW(szFileName, FR_PRIVATE, 0);
+    ok(result == 1, "AddFontResourceExW failed, result==%d\n", result);
+    if (result == 0)
+    {
+        DeleteDC(hdc);
+        return;
+    }
+
+    EnumerateFonts(hdc, L"Courier New", &PrivateFonts);
+    ok(PrivateFonts.Count == 2 * Fonts.Count, "Expected %lu fonts, got %lu\n",
+       2 * Fonts.Count, PrivateFonts.Count);
+    for (i = 0; i < min(PrivateFonts.Count, _countof(PrivateFonts.Logfont)); i++)
+    {
+        ok(IsEnumeratedFont(&PrivateFonts, i, &Fonts), "Font %lu (%ls, charset %u) differs\n",
+           i, PrivateFonts.Logfont[i].elfLogFont.lfFaceName, PrivateFonts.Logfont[i].elfLogFont.lfCharSet);
+    }
+
+    /* The private font is realized first */
+    hFont = CreateNamedFont(L"Courier New");
+    hOldFont = SelectObject(hdc, hFont);
+    ok(GetTextMetricsW(hdc, &PrivateTm), "GetTextMetricsW failed\n");
+    ok(GetTextFaceW(hdc, _countof(PrivateFace), PrivateFace) != 0, "GetTextFaceW failed\n");
+    SelectObject(hdc, hOldFont);
+    DeleteObject(hFont);
+
+    ok(memcmp(&tm, &PrivateTm, sizeof(tm)) == 0, "Text metrics differ\n");
+    ok_long(tm.tmHeight, PrivateTm.tmHeight);
+    ok_long(tm.tmAveCharWidth, PrivateTm.tmAveCharWidth);
+    ok_long(tm.tmWeight, PrivateTm.tmWeight);
+    ok(lstrcmpW(Face, PrivateFace) == 0, "Expected %ls, got %ls\n", Face, PrivateFace);
+
+    ok(RemoveFontResourceExW(szFileName, FR_PRIVATE, 0), "RemoveFontResourceExW failed\n");
+    DeleteDC(hdc);
+}
 
 START_TEST(CreateFontIndirect)
 {
@@ -174,5 +392,7 @@ START_TEST(CreateFontIndirect)
     Test_CreateFontIndirectW();
     Test_CreateFontIndirectExA();
     Test_CreateFontIndirectExW();
+    Test_FontMatching();
+    Test_CatalogedFont();
 }
 
@@ -0,0 +1,211 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for ExtTextOutW and the glyph cache
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <wingdi.h>
+#include <winuser.h>
+
+#define WIDTH       640
+#define HEIGHT      64
+#define ITERATIONS  200
+#define SIZES       8
+
+static const WCHAR Text[] = L"The quick brown fox jumps over the lazy dog 0123456789";
+
+static
+HDC
+CreateTextDC(PULONG *Bits)
+{
+    BITMAPINFO bmi;
+    HBITMAP hbmp;
+    HDC hdc;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = WIDTH;
+    bmi.bmiHeader.biHeight = -HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    if (!hdc)
+        return NULL;
+
+    hbmp = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (PVOID *)Bits, NULL, 0);
+    ok(hbmp != NULL, "CreateDIBSection failed\n");
+    if (!hbmp)
+    {
+        DeleteDC(hdc);
+        return NULL;
+    }
+
+    SelectObject(hdc, hbmp);
+    SetTextColor(hdc, RGB(0, 0, 0));
+    SetBkColor(hdc, RGB(255, 255, 255));
+    SetBkMode(hdc, OPAQUE);
+    return hdc;
+}
+
+static
+VOID
+DeleteTextDC(HDC hdc)
+{
+    HGDIOBJ hbmp = GetCurrentObject(hdc, OBJ_BITMAP);
+
+    DeleteDC(hdc);
+    DeleteObject(hbmp);
+}
+
+static
+HFONT
+CreateTestFont(LONG Height, BYTE Quality)
+{
+    LOGFONTW lf;
+
+    ZeroMemory(&lf, sizeof(lf));
+    lf.lfHeight = Height;
+    lf.lfCharSet = ANSI_CHARSET;
+    lf.lfQuality = Quality;
+    wcscpy(lf.lfFaceName, L"Tahoma");
+    return CreateFontIndirectW(&lf);
+}
+
+static
+VOID
+DrawTestText(HDC hdc, HFONT hFont)
+{
+    RECT rc = { 0, 0, WIDTH, HEIGHT };
+    HGDIOBJ hOldFont;
+
+    hOldFont = SelectObject(hdc, hFont);
+    ok(ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, Text, _countof(Text) - 1, NULL),
+       "ExtTextOutW failed\n");
+    SelectObject(hdc, hOldFont);
+    GdiFlush();
+}
+
+static
+VOID
+TestGlyphCache(VOID)
+{
+    HDC hdc1, hdc2;
+    PULONG Bits1, Bits2;
+    HFONT hSmooth, hMono, hMono2;
+    ULONG i, Differences, Others;
+
+    hdc1 = CreateTextDC(&Bits1);
+    hdc2 = CreateTextDC(&Bits2);
+    hSmooth = CreateTestFont(-24, DEFAULT_QUALITY);
+    hMono = CreateTestFont(-24, NONANTIALIASED_QUALITY);
+    hMono2 = CreateTestFont(-24, NONANTIALIASED_QUALITY);
+    if (!hdc1 || !hdc2 || !hSmooth || !hMono || !hMono2)
+    {
+        skip("Could not set up the test\n");
+        goto Cleanup;
+    }
+
+    /* Fill the cache with smoothed glyphs first, the monochrome ones must not reuse them */
+    DrawTestText(hdc1, hSmooth);
+    DrawTestText(hdc1, hMono);
+
+    Others = 0;
+    for (i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        if ((Bits1[i] & 0xFFFFFF) != 0 && (Bits1[i] & 0xFFFFFF) != 0xFFFFFF)
+            Others++;
+    }
+    ok_long(Others, 0);
+
+    /* Another DC with another font of the same size must render the very same bits */
+    DrawTestText(hdc2, hMono2);
+    Differences = 0;
+    for (i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        if ((Bits1[i] & 0xFFFFFF) != (Bits2[i] & 0xFFFFFF))
+            Differences++;
+    }
+    ok_long(Differences, 0);
+
+Cleanup:
+    if (hMono2) DeleteObject(hMono2);
+    if (hMono) DeleteObject(hMono);
+    if (hSmooth) DeleteObject(hSmooth);
+    if (hdc2) DeleteTextDC(hdc2);
+    if (hdc1) DeleteTextDC(hdc1);
+}
+
+static
+VOID
+BenchmarkExtTextOut(VOID)
+{
+    HFONT Fonts[SIZES];
+    HDC hdc;
+    PULONG Bits;
+    DWORD Start, WarmTicks, MixedTicks;
+    ULONG i, j, Failures;
+    RECT rc = { 0, 0, WIDTH, HEIGHT };
+
+    hdc = CreateTextDC(&Bits);
+    if (!hdc)
+        return;
+
+    for (i = 0; i < SIZES; i++)
+        Fonts[i] = CreateTestFont(-(LONG)(10 + 2 * i), DEFAULT_QUALITY);
+
+    /* The same font over and over, everything comes out of the cache */
+    Failures = 0;
+    SelectObject(hdc, Fonts[0]);
+    Start = GetTickCount();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        if (!ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, Text, _countof(Text) - 1, NULL))
+            Failures++;
+    }
+    GdiFlush();
+    WarmTicks = GetTickCount() - Start;
+    ok_long(Failures, 0);
+
+    /* Cycle through several sizes, which together hold more glyphs than the cache used to */
+    Failures = 0;
+    Start = GetTickCount();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        for (j = 0; j < SIZES; j++)
+        {
+            SelectObject(hdc, Fonts[j]);
+            if (!ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, Text, _countof(Text) - 1, NULL))
+                Failures++;
+        }
+    }
+    GdiFlush();
+    MixedTicks = GetTickCount() - Start;
+    ok_long(Failures, 0);
+
+    trace("%u calls with one font: %lu ms\n", ITERATIONS, WarmTicks);
+    trace("%u calls over %u sizes: %lu ms\n", ITERATIONS * SIZES, SIZES, MixedTicks);
+    if (WarmTicks && MixedTicks)
+    {
+        trace("%lu glyphs/s with one font, %lu glyphs/s over %u sizes\n",
+              (ULONG)((ULONGLONG)ITERATIONS * (_countof(Text) - 1) * 1000 / WarmTicks),
+              (ULONG)((ULONGLONG)ITERATIONS * SIZES * (_countof(Text) - 1) * 1000 / MixedTicks),
+              SIZES);
+    }
+
+    SelectObject(hdc, GetStockObject(SYSTEM_FONT));
+    for (i = 0; i < SIZES; i++)
+        DeleteObject(Fonts[i]);
+    DeleteTextDC(hdc);
+}
+
+START_TEST(ExtTextOut)
+{
+    TestGlyphCache();
+    BenchmarkExtTextOut();
+}
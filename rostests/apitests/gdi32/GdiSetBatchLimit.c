@@ -0,0 +1,210 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for batched PatBlt and ExtTextOut
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <wingdi.h>
+#include <winuser.h>
+#include <ndk/exfuncs.h>
+
+#define WIDTH       256
+#define HEIGHT      256
+#define CELL        8
+#define ITERATIONS  16
+
+static const WCHAR Text[] = L"ReactOS";
+
+static
+ULONG
+GetSystemCalls(VOID)
+{
+    SYSTEM_PERFORMANCE_INFORMATION Performance;
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemPerformanceInformation,
+                                      &Performance,
+                                      sizeof(Performance),
+                                      NULL);
+    if (!NT_SUCCESS(Status))
+        return 0;
+    return Performance.SystemCalls;
+}
+
+/* A device bitmap, the DIB sections are never batched */
+static
+HDC
+CreateBatchDC(VOID)
+{
+    HDC hdcScreen, hdc;
+    HBITMAP hbmp;
+
+    hdcScreen = GetDC(NULL);
+    hdc = CreateCompatibleDC(hdcScreen);
+    hbmp = CreateCompatibleBitmap(hdcScreen, WIDTH, HEIGHT);
+    ReleaseDC(NULL, hdcScreen);
+    if (!hdc || !hbmp)
+    {
+        if (hdc) DeleteDC(hdc);
+        if (hbmp) DeleteObject(hbmp);
+        return NULL;
+    }
+
+    SelectObject(hdc, hbmp);
+    return hdc;
+}
+
+static
+VOID
+DeleteBatchDC(HDC hdc)
+{
+    HGDIOBJ hbmp = GetCurrentObject(hdc, OBJ_BITMAP);
+
+    DeleteDC(hdc);
+    DeleteObject(hbmp);
+}
+
+static
+ULONG
+DrawCells(HDC hdc)
+{
+    ULONG x, y, i, Failures = 0;
+
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        for (y = 0; y < HEIGHT; y += CELL)
+        {
+            for (x = 0; x < WIDTH; x += CELL)
+            {
+                SelectObject(hdc, ((x + y) / CELL) & 1 ? GetStockObject(BLACK_BRUSH) : GetStockObject(WHITE_BRUSH));
+                if (!PatBlt(hdc, x, y, CELL, CELL, PATCOPY))
+                    Failures++;
+            }
+        }
+    }
+
+    return Failures;
+}
+
+static
+ULONG
+DrawRuns(HDC hdc)
+{
+    ULONG y, i, Failures = 0;
+
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        for (y = 0; y < HEIGHT; y += 16)
+        {
+            if (!ExtTextOutW(hdc, 0, y, 0, NULL, Text, _countof(Text) - 1, NULL))
+                Failures++;
+        }
+    }
+
+    return Failures;
+}
+
+/* Returns the system calls the drawing took, or 0 if it could not be measured */
+static
+ULONG
+TestBatch(DWORD Limit)
+{
+    HDC hdc;
+    DWORD Start, CellTicks, TextTicks;
+    ULONG Calls, CellCalls, TextCalls, x, y, Mismatches;
+    RECT rc = { 0, 0, WIDTH, HEIGHT };
+    COLORREF Color;
+    HBRUSH hbr;
+
+    hdc = CreateBatchDC();
+    if (!hdc)
+    {
+        skip("Could not create the test DC\n");
+        return 0;
+    }
+
+    GdiSetBatchLimit(Limit);
+    ok_long(GdiGetBatchLimit(), Limit);
+
+    /* A checkerboard, with a brush switch before every cell */
+    Calls = GetSystemCalls();
+    Start = GetTickCount();
+    ok_long(DrawCells(hdc), 0);
+    ok(GdiFlush(), "GdiFlush failed\n");
+    CellTicks = GetTickCount() - Start;
+    CellCalls = GetSystemCalls() - Calls;
+
+    Mismatches = 0;
+    for (y = 0; y < HEIGHT; y += CELL)
+    {
+        for (x = 0; x < WIDTH; x += CELL)
+        {
+            Color = GetPixel(hdc, x + CELL / 2, y + CELL / 2);
+            if (Color != (((x + y) / CELL) & 1 ? RGB(0, 0, 0) : GetNearestColor(hdc, RGB(255, 255, 255))))
+                Mismatches++;
+        }
+    }
+    ok_long(Mismatches, 0);
+
+    /* The text must come out with the colors of the time of the call */
+    hbr = CreateSolidBrush(RGB(0, 0, 255));
+    FillRect(hdc, &rc, hbr);
+    DeleteObject(hbr);
+    SetBkMode(hdc, OPAQUE);
+    SetBkColor(hdc, RGB(255, 0, 0));
+    SetTextColor(hdc, RGB(0, 255, 0));
+
+    Calls = GetSystemCalls();
+    Start = GetTickCount();
+    ok_long(DrawRuns(hdc), 0);
+    SetBkColor(hdc, RGB(0, 0, 0));
+    SetTextColor(hdc, RGB(0, 0, 0));
+    ok(GdiFlush(), "GdiFlush failed\n");
+    TextTicks = GetTickCount() - Start;
+    TextCalls = GetSystemCalls() - Calls;
+
+    /* Only the colors of the runs, never the black of after them */
+    Mismatches = 0;
+    for (x = 0; x < WIDTH; x++)
+    {
+        Color = GetPixel(hdc, x, 0);
+        if (Color != GetNearestColor(hdc, RGB(255, 0, 0)) &&
+            Color != GetNearestColor(hdc, RGB(0, 255, 0)) &&
+            Color != GetNearestColor(hdc, RGB(0, 0, 255)))
+        {
+            Mismatches++;
+        }
+    }
+    ok_long(Mismatches, 0);
+
+    trace("Batch limit %lu: %u PatBlt in %lu ms, %lu system calls\n",
+          Limit, ITERATIONS * (WIDTH / CELL) * (HEIGHT / CELL), CellTicks, CellCalls);
+    trace("Batch limit %lu: %u ExtTextOutW in %lu ms, %lu system calls\n",
+          Limit, ITERATIONS * (HEIGHT / 16), TextTicks, TextCalls);
+
+    DeleteBatchDC(hdc);
+    return CellCalls + TextCalls;
+}
+
+START_TEST(GdiSetBatchLimit)
+{
+    DWORD Limit;
+    ULONG Unbatched, Batched;
+
+    Limit = GdiGetBatchLimit();
+
+    Unbatched = TestBatch(1);
+    Batched = TestBatch(20);
+
+    /* Twenty calls to a batch must go down to a fraction of the transitions */
+    if (!Unbatched || !Batched)
+        skip("No system call counts\n");
+    else
+        ok(Batched * 4 < Unbatched, "Batched drawing took %lu system calls, unbatched %lu\n", Batched, Unbatched);
+
+    GdiSetBatchLimit(Limit);
+}
@@ -0,0 +1,328 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and producer/consumer benchmark for condition variables
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define QUEUE_SIZE          64
+#define ITEMS_PER_PRODUCER  50000
+#define PRODUCERS           2
+#define CONSUMERS           2
+#define WAITERS             8
+
+static VOID (WINAPI *pInitializeConditionVariable)(PRTL_CONDITION_VARIABLE);
+static BOOL (WINAPI *pSleepConditionVariableCS)(PRTL_CONDITION_VARIABLE, PCRITICAL_SECTION, DWORD);
+static BOOL (WINAPI *pSleepConditionVariableSRW)(PRTL_CONDITION_VARIABLE, PRTL_SRWLOCK, DWORD, ULONG);
+static VOID (WINAPI *pWakeConditionVariable)(PRTL_CONDITION_VARIABLE);
+static VOID (WINAPI *pWakeAllConditionVariable)(PRTL_CONDITION_VARIABLE);
+static VOID (WINAPI *pInitializeSRWLock)(PRTL_SRWLOCK);
+static VOID (WINAPI *pAcquireSRWLockExclusive)(PRTL_SRWLOCK);
+static VOID (WINAPI *pReleaseSRWLockExclusive)(PRTL_SRWLOCK);
+static VOID (WINAPI *pAcquireSRWLockShared)(PRTL_SRWLOCK);
+static VOID (WINAPI *pReleaseSRWLockShared)(PRTL_SRWLOCK);
+
+/* A bounded queue, guarded by a critical section or an SRW lock */
+typedef struct _TEST_QUEUE
+{
+    BOOL UseSRWLock;
+    CRITICAL_SECTION CriticalSection;
+    RTL_SRWLOCK SRWLock;
+    RTL_CONDITION_VARIABLE NotEmpty;
+    RTL_CONDITION_VARIABLE NotFull;
+    ULONG Items[QUEUE_SIZE];
+    ULONG Head;
+    ULONG Count;
+    ULONG Consumed;
+    ULONGLONG Sum;
+    LONG Waiting;
+} TEST_QUEUE, *PTEST_QUEUE;
+
+static
+VOID
+LockQueue(PTEST_QUEUE Queue)
+{
+    if (Queue->UseSRWLock)
+        pAcquireSRWLockExclusive(&Queue->SRWLock);
+    else
+        EnterCriticalSection(&Queue->CriticalSection);
+}
+
+static
+VOID
+UnlockQueue(PTEST_QUEUE Queue)
+{
+    if (Queue->UseSRWLock)
+        pReleaseSRWLockExclusive(&Queue->SRWLock);
+    else
+        LeaveCriticalSection(&Queue->CriticalSection);
+}
+
+static
+BOOL
+WaitQueue(PTEST_QUEUE Queue, PRTL_CONDITION_VARIABLE ConditionVariable, DWORD Timeout)
+{
+    if (Queue->UseSRWLock)
+        return pSleepConditionVariableSRW(ConditionVariable, &Queue->SRWLock, Timeout, 0);
+    else
+        return pSleepConditionVariableCS(ConditionVariable, &Queue->CriticalSection, Timeout);
+}
+
+static
+DWORD
+WINAPI
+ProducerThread(PVOID Parameter)
+{
+    PTEST_QUEUE Queue = Parameter;
+    ULONG i;
+
+    for (i = 1; i <= ITEMS_PER_PRODUCER; i++)
+    {
+        LockQueue(Queue);
+        while (Queue->Count == QUEUE_SIZE)
+            WaitQueue(Queue, &Queue->NotFull, INFINITE);
+
+        Queue->Items[(Queue->Head + Queue->Count) % QUEUE_SIZE] = i;
+        Queue->Count++;
+        UnlockQueue(Queue);
+
+        pWakeConditionVariable(&Queue->NotEmpty);
+    }
+
+    return 0;
+}
+
+static
+DWORD
+WINAPI
+ConsumerThread(PVOID Parameter)
+{
+    PTEST_QUEUE Queue = Parameter;
+
+    for (;;)
+    {
+        LockQueue(Queue);
+        while (Queue->Count == 0 && Queue->Consumed < PRODUCERS * ITEMS_PER_PRODUCER)
+            WaitQueue(Queue, &Queue->NotEmpty, INFINITE);
+
+        if (Queue->Consumed == PRODUCERS * ITEMS_PER_PRODUCER)
+        {
+            UnlockQueue(Queue);
+            break;
+        }
+
+        Queue->Sum += Queue->Items[Queue->Head];
+        Queue->Head = (Queue->Head + 1) % QUEUE_SIZE;
+        Queue->Count--;
+        Queue->Consumed++;
+
+        /* Let the other consumers see the end */
+        if (Queue->Consumed == PRODUCERS * ITEMS_PER_PRODUCER)
+            pWakeAllConditionVariable(&Queue->NotEmpty);
+        UnlockQueue(Queue);
+
+        pWakeConditionVariable(&Queue->NotFull);
+    }
+
+    return 0;
+}
+
+static
+VOID
+TestProducerConsumer(BOOL UseSRWLock)
+{
+    TEST_QUEUE Queue;
+    HANDLE Threads[PRODUCERS + CONSUMERS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i;
+    double Seconds;
+
+    ZeroMemory(&Queue, sizeof(Queue));
+    Queue.UseSRWLock = UseSRWLock;
+    InitializeCriticalSection(&Queue.CriticalSection);
+    pInitializeSRWLock(&Queue.SRWLock);
+    pInitializeConditionVariable(&Queue.NotEmpty);
+    pInitializeConditionVariable(&Queue.NotFull);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < PRODUCERS + CONSUMERS; i++)
+    {
+        Threads[i] = CreateThread(NULL, 0,
+                                  i < PRODUCERS ? ProducerThread : ConsumerThread,
+                                  &Queue, 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Threads[i])
+        {
+            skip("Not enough threads\n");
+            return;
+        }
+    }
+
+    ok(WaitForMultipleObjects(PRODUCERS + CONSUMERS, Threads, TRUE, 60000) == WAIT_OBJECT_0,
+       "Threads did not finish\n");
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+
+    for (i = 0; i < PRODUCERS + CONSUMERS; i++)
+        CloseHandle(Threads[i]);
+
+    ok(Queue.Consumed == PRODUCERS * ITEMS_PER_PRODUCER, "Consumed %lu\n", Queue.Consumed);
+    ok(Queue.Sum == PRODUCERS * (ULONGLONG)ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER + 1) / 2,
+       "Sum is %I64u\n", Queue.Sum);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("%s: %.0f items/s\n", UseSRWLock ? "SRW lock" : "Critical section",
+              Queue.Consumed / Seconds);
+    }
+
+    DeleteCriticalSection(&Queue.CriticalSection);
+}
+
+static
+DWORD
+WINAPI
+WaiterThread(PVOID Parameter)
+{
+    PTEST_QUEUE Queue = Parameter;
+
+    LockQueue(Queue);
+    InterlockedIncrement(&Queue->Waiting);
+    while (Queue->Count == 0)
+        WaitQueue(Queue, &Queue->NotEmpty, INFINITE);
+    Queue->Consumed++;
+    UnlockQueue(Queue);
+
+    return 0;
+}
+
+static
+VOID
+TestWakeAndTimeout(VOID)
+{
+    TEST_QUEUE Queue;
+    HANDLE Threads[WAITERS];
+    DWORD Start;
+    BOOL Ret;
+    ULONG i;
+
+    ZeroMemory(&Queue, sizeof(Queue));
+    InitializeCriticalSection(&Queue.CriticalSection);
+    pInitializeSRWLock(&Queue.SRWLock);
+    pInitializeConditionVariable(&Queue.NotEmpty);
+    ok(Queue.NotEmpty.Ptr == NULL, "Ptr is %p\n", Queue.NotEmpty.Ptr);
+
+    /* Nobody to wake */
+    pWakeConditionVariable(&Queue.NotEmpty);
+    pWakeAllConditionVariable(&Queue.NotEmpty);
+
+    /* Time out, and come back with the lock */
+    EnterCriticalSection(&Queue.CriticalSection);
+    Start = GetTickCount();
+    SetLastError(0xdeadbeef);
+    Ret = pSleepConditionVariableCS(&Queue.NotEmpty, &Queue.CriticalSection, 50);
+    ok(!Ret, "SleepConditionVariableCS returned %d\n", Ret);
+    ok(GetLastError() == ERROR_TIMEOUT, "Error %lu\n", GetLastError());
+    ok(GetTickCount() - Start >= 40, "Waited %lu ms\n", GetTickCount() - Start);
+    ok(Queue.CriticalSection.OwningThread == UlongToHandle(GetCurrentThreadId()), "Not owned\n");
+    LeaveCriticalSection(&Queue.CriticalSection);
+    ok(Queue.NotEmpty.Ptr == NULL, "Ptr is %p\n", Queue.NotEmpty.Ptr);
+
+    pAcquireSRWLockShared(&Queue.SRWLock);
+    SetLastError(0xdeadbeef);
+    Ret = pSleepConditionVariableSRW(&Queue.NotEmpty, &Queue.SRWLock, 0, RTL_CONDITION_VARIABLE_LOCKMODE_SHARED);
+    ok(!Ret, "SleepConditionVariableSRW returned %d\n", Ret);
+    ok(GetLastError() == ERROR_TIMEOUT, "Error %lu\n", GetLastError());
+    pReleaseSRWLockShared(&Queue.SRWLock);
+
+    pAcquireSRWLockExclusive(&Queue.SRWLock);
+    Ret = pSleepConditionVariableSRW(&Queue.NotEmpty, &Queue.SRWLock, 10, 0);
+    ok(!Ret, "SleepConditionVariableSRW returned %d\n", Ret);
+    pReleaseSRWLockExclusive(&Queue.SRWLock);
+    ok(Queue.NotEmpty.Ptr == NULL, "Ptr is %p\n", Queue.NotEmpty.Ptr);
+
+    /* Wake them one by one, then all at once */
+    for (Queue.UseSRWLock = FALSE; Queue.UseSRWLock <= TRUE; Queue.UseSRWLock++)
+    {
+        Queue.Count = 0;
+        Queue.Consumed = 0;
+        Queue.Waiting = 0;
+        for (i = 0; i < WAITERS; i++)
+        {
+            Threads[i] = CreateThread(NULL, 0, WaiterThread, &Queue, 0, NULL);
+            ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+            if (!Threads[i])
+            {
+                skip("Not enough threads\n");
+                return;
+            }
+        }
+
+        while (Queue.Waiting < WAITERS)
+            Sleep(10);
+        Sleep(50);
+
+        LockQueue(&Queue);
+        Queue.Count = 1;
+        UnlockQueue(&Queue);
+        for (i = 0; i < WAITERS / 2; i++)
+            pWakeConditionVariable(&Queue.NotEmpty);
+        Sleep(100);
+        ok(Queue.Consumed == WAITERS / 2, "%lu woken instead of %u\n", Queue.Consumed, WAITERS / 2);
+
+        pWakeAllConditionVariable(&Queue.NotEmpty);
+        ok(WaitForMultipleObjects(WAITERS, Threads, TRUE, 10000) == WAIT_OBJECT_0,
+           "Waiters did not finish\n");
+        ok(Queue.Consumed == WAITERS, "%lu woken instead of %u\n", Queue.Consumed, WAITERS);
+        ok(Queue.NotEmpty.Ptr == NULL, "Ptr is %p\n", Queue.NotEmpty.Ptr);
+
+        for (i = 0; i < WAITERS; i++)
+            CloseHandle(Threads[i]);
+    }
+
+    DeleteCriticalSection(&Queue.CriticalSection);
+}
+
+START_TEST(ConditionVariable)
+{
+    HMODULE hKernel32;
+
+    hKernel32 = GetModuleHandleW(L"kernel32.dll");
+    pInitializeConditionVariable = (PVOID)GetProcAddress(hKernel32, "InitializeConditionVariable");
+    if (!pInitializeConditionVariable)
+    {
+        hKernel32 = LoadLibraryW(L"kernel32_vista.dll");
+        if (!hKernel32)
+        {
+            skip("Condition variables are not available\n");
+            return;
+        }
+        pInitializeConditionVariable = (PVOID)GetProcAddress(hKernel32, "InitializeConditionVariable");
+    }
+
+    pSleepConditionVariableCS = (PVOID)GetProcAddress(hKernel32, "SleepConditionVariableCS");
+    pSleepConditionVariableSRW = (PVOID)GetProcAddress(hKernel32, "SleepConditionVariableSRW");
+    pWakeConditionVariable = (PVOID)GetProcAddress(hKernel32, "WakeConditionVariable");
+    pWakeAllConditionVariable = (PVOID)GetProcAddress(hKernel32, "WakeAllConditionVariable");
+    pInitializeSRWLock = (PVOID)GetProcAddress(hKernel32, "InitializeSRWLock");
+    pAcquireSRWLockExclusive = (PVOID)GetProcAddress(hKernel32, "AcquireSRWLockExclusive");
+    pReleaseSRWLockExclusive = (PVOID)GetProcAddress(hKernel32, "ReleaseSRWLockExclusive");
+    pAcquireSRWLockShared = (PVOID)GetProcAddress(hKernel32, "AcquireSRWLockShared");
+    pReleaseSRWLockShared = (PVOID)GetProcAddress(hKernel32, "ReleaseSRWLockShared");
+    if (!pInitializeConditionVariable || !pSleepConditionVariableCS ||
+        !pSleepConditionVariableSRW || !pWakeConditionVariable ||
+        !pWakeAllConditionVariable || !pInitializeSRWLock ||
+        !pAcquireSRWLockExclusive || !pReleaseSRWLockExclusive ||
+        !pAcquireSRWLockShared || !pReleaseSRWLockShared)
+    {
+        skip("Condition variables are not available\n");
+        return;
+    }
+
+    TestWakeAndTimeout();
+    TestProducerConsumer(FALSE);
+    TestProducerConsumer(TRUE);
+}
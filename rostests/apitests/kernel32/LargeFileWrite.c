@@ -0,0 +1,213 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Benchmark for growing large files on a clean and a fragmented volume
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <stdio.h>
+
+#define CHUNK_SIZE          (1024 * 1024)
+#define LARGE_FILE_SIZE     (64 * CHUNK_SIZE)
+#define SMALL_FILE_SIZE     (64 * 1024)
+#define SMALL_FILE_COUNT    512
+
+static CHAR TestDir[MAX_PATH];
+
+static
+VOID
+BuildFileName(PSTR FileName, PCSTR Name, ULONG Index)
+{
+    sprintf(FileName, "%s\\%s%lu.tmp", TestDir, Name, Index);
+}
+
+static
+ULONGLONG
+GetFreeBytes(VOID)
+{
+    ULARGE_INTEGER FreeBytes;
+
+    if (!GetDiskFreeSpaceExA(TestDir, &FreeBytes, NULL, NULL))
+        return 0;
+
+    return FreeBytes.QuadPart;
+}
+
+static
+double
+ElapsedSeconds(LARGE_INTEGER Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+}
+
+static
+BOOL
+WriteLargeFile(PCSTR Description, PUCHAR Buffer)
+{
+    CHAR FileName[MAX_PATH];
+    LARGE_INTEGER Start, Size;
+    ULONGLONG FreeBefore, FreeAfter;
+    ULONG Chunk;
+    DWORD Bytes;
+    HANDLE hFile;
+    BOOL Ret;
+    double Seconds;
+
+    BuildFileName(FileName, "large", 0);
+    FreeBefore = GetFreeBytes();
+
+    /* Grow it chunk by chunk, like a copy does */
+    hFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFile failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    QueryPerformanceCounter(&Start);
+    for (Chunk = 0; Chunk < LARGE_FILE_SIZE / CHUNK_SIZE; Chunk++)
+    {
+        *(PULONG)Buffer = Chunk;
+        Ret = WriteFile(hFile, Buffer, CHUNK_SIZE, &Bytes, NULL);
+        ok(Ret && Bytes == CHUNK_SIZE, "%s: write %lu failed with %lu\n", Description, Chunk, GetLastError());
+        if (!Ret)
+            break;
+    }
+    FlushFileBuffers(hFile);
+    Seconds = ElapsedSeconds(Start);
+    if (Seconds > 0)
+    {
+        trace("%s: %u MB written in %.3f s, %.1f MB/s\n",
+              Description, LARGE_FILE_SIZE / CHUNK_SIZE, Seconds,
+              (LARGE_FILE_SIZE / CHUNK_SIZE) / Seconds);
+    }
+
+    /* The free space must account for what was allocated */
+    FreeAfter = GetFreeBytes();
+    ok(FreeAfter + LARGE_FILE_SIZE <= FreeBefore,
+       "%s: free space went from %I64u to %I64u\n", Description, FreeBefore, FreeAfter);
+
+    /* Check the data made it to the right clusters */
+    SetFilePointer(hFile, 0, NULL, FILE_BEGIN);
+    for (Chunk = 0; Chunk < LARGE_FILE_SIZE / CHUNK_SIZE; Chunk++)
+    {
+        Ret = ReadFile(hFile, Buffer, CHUNK_SIZE, &Bytes, NULL);
+        ok(Ret && Bytes == CHUNK_SIZE, "%s: read %lu failed with %lu\n", Description, Chunk, GetLastError());
+        if (!Ret)
+            break;
+        ok(*(PULONG)Buffer == Chunk, "%s: chunk %lu holds %lu\n", Description, Chunk, *(PULONG)Buffer);
+    }
+    CloseHandle(hFile);
+    DeleteFileA(FileName);
+
+    /* Allocate all of it at once this time */
+    hFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFile failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    QueryPerformanceCounter(&Start);
+    Size.QuadPart = LARGE_FILE_SIZE;
+    Ret = SetFilePointerEx(hFile, Size, NULL, FILE_BEGIN) && SetEndOfFile(hFile);
+    ok(Ret, "%s: SetEndOfFile failed with %lu\n", Description, GetLastError());
+    Seconds = ElapsedSeconds(Start);
+    trace("%s: %u MB allocated in %.3f s\n", Description, LARGE_FILE_SIZE / CHUNK_SIZE, Seconds);
+
+    CloseHandle(hFile);
+    DeleteFileA(FileName);
+
+    /* And everything must be given back */
+    FreeAfter = GetFreeBytes();
+    ok(FreeAfter >= FreeBefore - CHUNK_SIZE,
+       "%s: free space went from %I64u to %I64u\n", Description, FreeBefore, FreeAfter);
+
+    return TRUE;
+}
+
+static
+VOID
+FragmentVolume(PUCHAR Buffer)
+{
+    CHAR FileName[MAX_PATH];
+    DWORD Bytes;
+    HANDLE hFile;
+    ULONG i;
+
+    /* Fill some space with small files and free every other one */
+    for (i = 0; i < SMALL_FILE_COUNT; i++)
+    {
+        BuildFileName(FileName, "small", i);
+        hFile = CreateFileA(FileName, GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+            break;
+        WriteFile(hFile, Buffer, SMALL_FILE_SIZE, &Bytes, NULL);
+        CloseHandle(hFile);
+    }
+
+    for (i = 0; i < SMALL_FILE_COUNT; i += 2)
+    {
+        BuildFileName(FileName, "small", i);
+        DeleteFileA(FileName);
+    }
+}
+
+static
+VOID
+CleanupVolume(VOID)
+{
+    CHAR FileName[MAX_PATH];
+    ULONG i;
+
+    for (i = 1; i < SMALL_FILE_COUNT; i += 2)
+    {
+        BuildFileName(FileName, "small", i);
+        DeleteFileA(FileName);
+    }
+}
+
+START_TEST(LargeFileWrite)
+{
+    PUCHAR Buffer;
+    ULONG i;
+
+    if (!GetTempPathA(MAX_PATH, TestDir))
+    {
+        skip("No temporary directory\n");
+        return;
+    }
+
+    /* Drop the trailing backslash */
+    i = lstrlenA(TestDir);
+    if (i > 3 && TestDir[i - 1] == '\\')
+        TestDir[i - 1] = ANSI_NULL;
+
+    if (GetFreeBytes() < 2 * LARGE_FILE_SIZE + SMALL_FILE_COUNT * SMALL_FILE_SIZE)
+    {
+        skip("Not enough free space in %s\n", TestDir);
+        return;
+    }
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        return;
+    }
+    FillMemory(Buffer, CHUNK_SIZE, 0x55);
+
+    if (WriteLargeFile("Clean volume", Buffer))
+    {
+        FragmentVolume(Buffer);
+        WriteLargeFile("Fragmented volume", Buffer);
+        CleanupVolume();
+    }
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+}
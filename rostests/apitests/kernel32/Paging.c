@@ -0,0 +1,135 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Stress test for paging to and from the paging file
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <ndk/exfuncs.h>
+
+static
+BOOL
+QueryPerformance(PSYSTEM_PERFORMANCE_INFORMATION Performance)
+{
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemPerformanceInformation,
+                                      Performance,
+                                      sizeof(*Performance),
+                                      NULL);
+    ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+    return NT_SUCCESS(Status);
+}
+
+static
+VOID
+ReportPaging(PCSTR Pass, PSYSTEM_PERFORMANCE_INFORMATION Before, PSYSTEM_PERFORMANCE_INFORMATION After, DWORD Ticks)
+{
+    ULONG Reads, ReadIos, Writes, WriteIos;
+
+    Reads = After->PageReadCount - Before->PageReadCount;
+    ReadIos = After->PageReadIoCount - Before->PageReadIoCount;
+    Writes = After->DirtyPagesWriteCount - Before->DirtyPagesWriteCount;
+    WriteIos = After->DirtyWriteIoCount - Before->DirtyWriteIoCount;
+
+    trace("%s: %lu ms, %lu page faults\n", Pass, Ticks, After->PageFaultCount - Before->PageFaultCount);
+    trace("%s: %lu pages read in %lu requests, %lu pages written in %lu requests\n",
+          Pass, Reads, ReadIos, Writes, WriteIos);
+    if (ReadIos)
+        trace("%s: %lu.%02lu pages per read\n", Pass, Reads / ReadIos, (Reads % ReadIos) * 100 / ReadIos);
+    if (WriteIos)
+        trace("%s: %lu.%02lu pages per write\n", Pass, Writes / WriteIos, (Writes % WriteIos) * 100 / WriteIos);
+
+    /* Every request carries at least one page */
+    ok(Reads >= ReadIos, "%lu pages read in %lu requests\n", Reads, ReadIos);
+    ok(Writes >= WriteIos, "%lu pages written in %lu requests\n", Writes, WriteIos);
+}
+
+START_TEST(Paging)
+{
+    MEMORYSTATUSEX MemoryStatus;
+    SYSTEM_INFO SystemInfo;
+    SYSTEM_PERFORMANCE_INFORMATION Start, Filled, Checked;
+    ULONGLONG Size;
+    SIZE_T Pages, i;
+    ULONG Mismatches;
+    DWORD Ticks, FillTicks, CheckTicks;
+    HANDLE Section;
+    PUCHAR Buffer;
+
+    GetSystemInfo(&SystemInfo);
+    MemoryStatus.dwLength = sizeof(MemoryStatus);
+    ok(GlobalMemoryStatusEx(&MemoryStatus), "GlobalMemoryStatusEx failed with %lu\n", GetLastError());
+
+    /* Ask for a quarter more than there is RAM, so a good part has to go to the paging file */
+    Size = MemoryStatus.ullTotalPhys + MemoryStatus.ullTotalPhys / 4;
+    if (Size > MemoryStatus.ullAvailVirtual - 64 * 1024 * 1024 ||
+        Size > MemoryStatus.ullAvailPageFile - 64 * 1024 * 1024)
+    {
+        skip("Not enough address space or page file (%I64u MB RAM, %I64u MB page file, %I64u MB address space)\n",
+             MemoryStatus.ullTotalPhys >> 20, MemoryStatus.ullAvailPageFile >> 20, MemoryStatus.ullAvailVirtual >> 20);
+        return;
+    }
+
+    /* A section backed by the paging file, so that its pages can only go there */
+    Section = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(Size >> 32), (DWORD)Size, NULL);
+    if (!Section)
+    {
+        skip("Could not create a %I64u MB section (%lu)\n", Size >> 20, GetLastError());
+        return;
+    }
+    Buffer = MapViewOfFile(Section, FILE_MAP_WRITE, 0, 0, (SIZE_T)Size);
+    if (!Buffer)
+    {
+        skip("Could not map %I64u MB (%lu)\n", Size >> 20, GetLastError());
+        CloseHandle(Section);
+        return;
+    }
+    Pages = (SIZE_T)(Size / SystemInfo.dwPageSize);
+    trace("Touching %Iu pages (%I64u MB) with %I64u MB of RAM\n", Pages, Size >> 20, MemoryStatus.ullTotalPhys >> 20);
+
+    if (!QueryPerformance(&Start))
+    {
+        UnmapViewOfFile(Buffer);
+        CloseHandle(Section);
+        return;
+    }
+
+    /* Write a signature to every page, forcing the older ones out */
+    Ticks = GetTickCount();
+    for (i = 0; i < Pages; i++)
+    {
+        *(PSIZE_T)(Buffer + i * SystemInfo.dwPageSize) = i;
+        *(PSIZE_T)(Buffer + (i + 1) * SystemInfo.dwPageSize - sizeof(SIZE_T)) = ~i;
+    }
+    FillTicks = GetTickCount() - Ticks;
+    QueryPerformance(&Filled);
+
+    /* And read everything back in, in the same order */
+    Mismatches = 0;
+    Ticks = GetTickCount();
+    for (i = 0; i < Pages; i++)
+    {
+        if (*(PSIZE_T)(Buffer + i * SystemInfo.dwPageSize) != i ||
+            *(PSIZE_T)(Buffer + (i + 1) * SystemInfo.dwPageSize - sizeof(SIZE_T)) != ~i)
+        {
+            Mismatches++;
+        }
+    }
+    CheckTicks = GetTickCount() - Ticks;
+    QueryPerformance(&Checked);
+    ok_long(Mismatches, 0);
+
+    ReportPaging("Fill", &Start, &Filled, FillTicks);
+    ReportPaging("Check", &Filled, &Checked, CheckTicks);
+
+    /* More than RAM was touched, so some of it must have made the round trip */
+    ok(Checked.DirtyPagesWriteCount > Start.DirtyPagesWriteCount, "No page was written to the paging file\n");
+    ok(Checked.PageReadCount > Filled.PageReadCount, "No page was read back from the paging file\n");
+
+    UnmapViewOfFile(Buffer);
+    CloseHandle(Section);
+}
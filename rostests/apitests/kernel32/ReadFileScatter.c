@@ -0,0 +1,250 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for ReadFileScatter/WriteFileGather
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define PAGES       16
+#define ITERATIONS  200
+
+static SYSTEM_INFO SystemInfo;
+
+static
+BOOL
+WaitForTransfer(HANDLE File, LPOVERLAPPED Overlapped, BOOL Ret, DWORD Expected)
+{
+    DWORD Transferred = 0;
+
+    if (!Ret && GetLastError() != ERROR_IO_PENDING)
+        return FALSE;
+
+    if (!GetOverlappedResult(File, Overlapped, &Transferred, TRUE))
+        return FALSE;
+
+    return Transferred == Expected;
+}
+
+static
+VOID
+TestScatterGather(HANDLE File, PUCHAR Pages)
+{
+    FILE_SEGMENT_ELEMENT Segments[PAGES + 1];
+    ULONG PageSize = SystemInfo.dwPageSize;
+    OVERLAPPED Overlapped;
+    ULONG i, Mismatches;
+    BOOL Ret;
+
+    /* Write page i from the buffer page (i * 5) % PAGES, to mix them up */
+    for (i = 0; i < PAGES; i++)
+    {
+        FillMemory(Pages + i * PageSize, PageSize, (UCHAR)(0x10 + i));
+        Segments[i].Alignment = (ULONG_PTR)(Pages + ((i * 5) % PAGES) * PageSize);
+    }
+    Segments[PAGES].Alignment = 0;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    Ret = WriteFileGather(File, Segments, PAGES * PageSize, NULL, &Overlapped);
+    ok(WaitForTransfer(File, &Overlapped, Ret, PAGES * PageSize),
+       "WriteFileGather failed with %lu\n", GetLastError());
+
+    /* Read it back in order, every page must be where we expect */
+    ZeroMemory(Pages, PAGES * PageSize);
+    for (i = 0; i < PAGES; i++)
+        Segments[i].Alignment = (ULONG_PTR)(Pages + i * PageSize);
+
+    ResetEvent(Overlapped.hEvent);
+    Ret = ReadFileScatter(File, Segments, PAGES * PageSize, NULL, &Overlapped);
+    ok(WaitForTransfer(File, &Overlapped, Ret, PAGES * PageSize),
+       "ReadFileScatter failed with %lu\n", GetLastError());
+
+    Mismatches = 0;
+    for (i = 0; i < PAGES; i++)
+    {
+        if (Pages[i * PageSize] != (UCHAR)(0x10 + (i * 5) % PAGES) ||
+            Pages[i * PageSize + PageSize - 1] != (UCHAR)(0x10 + (i * 5) % PAGES))
+        {
+            Mismatches++;
+        }
+    }
+    ok_long(Mismatches, 0);
+
+    /* Segments must be page aligned */
+    Segments[0].Alignment = (ULONG_PTR)(Pages + 512);
+    ResetEvent(Overlapped.hEvent);
+    Ret = ReadFileScatter(File, Segments, PageSize, NULL, &Overlapped);
+    ok(!Ret && GetLastError() != ERROR_IO_PENDING, "ReadFileScatter succeeded\n");
+
+    CloseHandle(Overlapped.hEvent);
+}
+
+/* Segment I/O and plain I/O on the same non buffered handle must see each other's data */
+static
+VOID
+TestCoherency(HANDLE File, PUCHAR Pages)
+{
+    FILE_SEGMENT_ELEMENT Segments[PAGES + 1];
+    ULONG PageSize = SystemInfo.dwPageSize;
+    OVERLAPPED Overlapped;
+    ULONG i, Mismatches;
+    BOOL Ret;
+
+    for (i = 0; i < PAGES; i++)
+        Segments[i].Alignment = (ULONG_PTR)(Pages + i * PageSize);
+    Segments[PAGES].Alignment = 0;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    /* WriteFileGather, then ReadFile */
+    for (i = 0; i < PAGES; i++)
+        FillMemory(Pages + i * PageSize, PageSize, (UCHAR)(0x40 + i));
+    Ret = WriteFileGather(File, Segments, PAGES * PageSize, NULL, &Overlapped);
+    ok(WaitForTransfer(File, &Overlapped, Ret, PAGES * PageSize),
+       "WriteFileGather failed with %lu\n", GetLastError());
+
+    ZeroMemory(Pages, PAGES * PageSize);
+    Mismatches = 0;
+    for (i = 0; i < PAGES; i++)
+    {
+        Overlapped.Offset = i * PageSize;
+        ResetEvent(Overlapped.hEvent);
+        Ret = ReadFile(File, Pages + i * PageSize, PageSize, NULL, &Overlapped);
+        ok(WaitForTransfer(File, &Overlapped, Ret, PageSize),
+           "ReadFile failed with %lu\n", GetLastError());
+        if (Pages[i * PageSize] != (UCHAR)(0x40 + i) ||
+            Pages[i * PageSize + PageSize - 1] != (UCHAR)(0x40 + i))
+        {
+            Mismatches++;
+        }
+    }
+    ok_long(Mismatches, 0);
+
+    /* WriteFile, then ReadFileScatter */
+    for (i = 0; i < PAGES; i++)
+    {
+        FillMemory(Pages + i * PageSize, PageSize, (UCHAR)(0x80 + i));
+        Overlapped.Offset = i * PageSize;
+        ResetEvent(Overlapped.hEvent);
+        Ret = WriteFile(File, Pages + i * PageSize, PageSize, NULL, &Overlapped);
+        ok(WaitForTransfer(File, &Overlapped, Ret, PageSize),
+           "WriteFile failed with %lu\n", GetLastError());
+    }
+
+    ZeroMemory(Pages, PAGES * PageSize);
+    Overlapped.Offset = 0;
+    ResetEvent(Overlapped.hEvent);
+    Ret = ReadFileScatter(File, Segments, PAGES * PageSize, NULL, &Overlapped);
+    ok(WaitForTransfer(File, &Overlapped, Ret, PAGES * PageSize),
+       "ReadFileScatter failed with %lu\n", GetLastError());
+
+    Mismatches = 0;
+    for (i = 0; i < PAGES; i++)
+    {
+        if (Pages[i * PageSize] != (UCHAR)(0x80 + i) ||
+            Pages[i * PageSize + PageSize - 1] != (UCHAR)(0x80 + i))
+        {
+            Mismatches++;
+        }
+    }
+    ok_long(Mismatches, 0);
+
+    CloseHandle(Overlapped.hEvent);
+}
+
+static
+VOID
+BenchmarkScatter(HANDLE File, PUCHAR Pages)
+{
+    FILE_SEGMENT_ELEMENT Segments[PAGES + 1];
+    ULONG PageSize = SystemInfo.dwPageSize;
+    OVERLAPPED Overlapped;
+    DWORD Start, ScatterTicks, ReadTicks;
+    ULONG i, j, Failures;
+    BOOL Ret;
+
+    for (i = 0; i < PAGES; i++)
+        Segments[i].Alignment = (ULONG_PTR)(Pages + i * PageSize);
+    Segments[PAGES].Alignment = 0;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    /* One scatter read per batch of pages */
+    Failures = 0;
+    Start = GetTickCount();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        ResetEvent(Overlapped.hEvent);
+        Ret = ReadFileScatter(File, Segments, PAGES * PageSize, NULL, &Overlapped);
+        if (!WaitForTransfer(File, &Overlapped, Ret, PAGES * PageSize))
+            Failures++;
+    }
+    ScatterTicks = GetTickCount() - Start;
+    ok_long(Failures, 0);
+
+    /* The same pages, one ReadFile each */
+    Failures = 0;
+    Start = GetTickCount();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        for (j = 0; j < PAGES; j++)
+        {
+            Overlapped.Offset = j * PageSize;
+            ResetEvent(Overlapped.hEvent);
+            Ret = ReadFile(File, Pages + j * PageSize, PageSize, NULL, &Overlapped);
+            if (!WaitForTransfer(File, &Overlapped, Ret, PageSize))
+                Failures++;
+        }
+    }
+    ReadTicks = GetTickCount() - Start;
+    ok_long(Failures, 0);
+
+    trace("%u pages x %u: ReadFileScatter %lu ms (%lu requests), ReadFile %lu ms (%lu requests)\n",
+          PAGES, ITERATIONS, ScatterTicks, (ULONG)ITERATIONS, ReadTicks, (ULONG)(ITERATIONS * PAGES));
+    if (ScatterTicks && ReadTicks)
+    {
+        trace("%lu pages/s with ReadFileScatter, %lu pages/s with ReadFile\n",
+              (ULONG)((ULONGLONG)PAGES * ITERATIONS * 1000 / ScatterTicks),
+              (ULONG)((ULONGLONG)PAGES * ITERATIONS * 1000 / ReadTicks));
+    }
+
+    CloseHandle(Overlapped.hEvent);
+}
+
+START_TEST(ReadFileScatter)
+{
+    WCHAR TempPath[MAX_PATH], FileName[MAX_PATH];
+    PUCHAR Pages;
+    HANDLE File;
+
+    GetSystemInfo(&SystemInfo);
+
+    GetTempPathW(MAX_PATH, TempPath);
+    GetTempFileNameW(TempPath, L"sca", 0, FileName);
+    File = CreateFileW(FileName,
+                       GENERIC_READ | GENERIC_WRITE,
+                       0,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE,
+                       NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    Pages = VirtualAlloc(NULL, PAGES * SystemInfo.dwPageSize, MEM_COMMIT, PAGE_READWRITE);
+    ok(Pages != NULL, "VirtualAlloc failed with %lu\n", GetLastError());
+    if (Pages)
+    {
+        TestScatterGather(File, Pages);
+        TestCoherency(File, Pages);
+        BenchmarkScatter(File, Pages);
+        VirtualFree(Pages, 0, MEM_RELEASE);
+    }
+
+    CloseHandle(File);
+}
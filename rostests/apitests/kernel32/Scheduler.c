@@ -0,0 +1,168 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Benchmark for thread scheduling across processors
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WAKEUPS     500
+#define MAX_THREADS 32
+
+typedef struct _SLEEPER
+{
+    HANDLE Thread;
+    HANDLE WakeEvent;
+    HANDLE DoneEvent;
+    LARGE_INTEGER SentAt;
+    LONGLONG TotalLatency;
+    LONGLONG MaxLatency;
+    ULONG Wakeups;
+} SLEEPER, *PSLEEPER;
+
+static volatile LONG StopSpinning;
+static volatile LONG StopSleeping;
+static LONGLONG Spins[MAX_THREADS];
+
+static
+DWORD
+WINAPI
+SpinThread(PVOID Parameter)
+{
+    LONGLONG *Count = Parameter;
+    LONGLONG Local = 0;
+
+    /* Burn CPU until told to stop, counting how much work we got done */
+    while (!StopSpinning)
+    {
+        Local++;
+        if (!(Local & 0xFFFF))
+            *Count = Local;
+    }
+
+    *Count = Local;
+    return 0;
+}
+
+static
+DWORD
+WINAPI
+SleepThread(PVOID Parameter)
+{
+    PSLEEPER Sleeper = Parameter;
+    LARGE_INTEGER Now;
+    LONGLONG Latency;
+
+    for (;;)
+    {
+        WaitForSingleObject(Sleeper->WakeEvent, INFINITE);
+        QueryPerformanceCounter(&Now);
+        if (StopSleeping)
+            break;
+
+        /* How long did it take between the signal and us running? */
+        Latency = Now.QuadPart - Sleeper->SentAt.QuadPart;
+        Sleeper->TotalLatency += Latency;
+        if (Latency > Sleeper->MaxLatency)
+            Sleeper->MaxLatency = Latency;
+        Sleeper->Wakeups++;
+
+        SetEvent(Sleeper->DoneEvent);
+    }
+
+    return 0;
+}
+
+START_TEST(Scheduler)
+{
+    SYSTEM_INFO SystemInfo;
+    HANDLE Spinners[MAX_THREADS];
+    SLEEPER Sleepers[MAX_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    LONGLONG TotalSpins, TotalLatency, MaxLatency, Elapsed;
+    ULONG Threads, TotalWakeups, Timeouts, i, j;
+
+    GetSystemInfo(&SystemInfo);
+    QueryPerformanceFrequency(&Frequency);
+    Threads = min(SystemInfo.dwNumberOfProcessors, MAX_THREADS);
+    trace("Running with %lu CPU-bound and %lu waking threads\n", Threads, Threads);
+
+    /* Keep every processor busy */
+    StopSpinning = FALSE;
+    for (i = 0; i < Threads; i++)
+    {
+        Spins[i] = 0;
+        Spinners[i] = CreateThread(NULL, 0, SpinThread, &Spins[i], 0, NULL);
+        ok(Spinners[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    /* And add the same number of threads that keep waiting and waking up */
+    StopSleeping = FALSE;
+    for (i = 0; i < Threads; i++)
+    {
+        ZeroMemory(&Sleepers[i], sizeof(Sleepers[i]));
+        Sleepers[i].WakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+        Sleepers[i].DoneEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+        Sleepers[i].Thread = CreateThread(NULL, 0, SleepThread, &Sleepers[i], 0, NULL);
+        ok(Sleepers[i].Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    /* Wake them one after the other and wait for each to answer */
+    Timeouts = 0;
+    QueryPerformanceCounter(&Start);
+    for (j = 0; j < WAKEUPS; j++)
+    {
+        for (i = 0; i < Threads; i++)
+        {
+            QueryPerformanceCounter(&Sleepers[i].SentAt);
+            SetEvent(Sleepers[i].WakeEvent);
+            if (WaitForSingleObject(Sleepers[i].DoneEvent, 5000) != WAIT_OBJECT_0)
+                Timeouts++;
+        }
+    }
+    QueryPerformanceCounter(&End);
+    ok_long(Timeouts, 0);
+
+    /* Stop everything */
+    StopSpinning = TRUE;
+    StopSleeping = TRUE;
+    for (i = 0; i < Threads; i++)
+    {
+        SetEvent(Sleepers[i].WakeEvent);
+        WaitForSingleObject(Sleepers[i].Thread, INFINITE);
+        WaitForSingleObject(Spinners[i], INFINITE);
+        CloseHandle(Sleepers[i].Thread);
+        CloseHandle(Sleepers[i].WakeEvent);
+        CloseHandle(Sleepers[i].DoneEvent);
+        CloseHandle(Spinners[i]);
+    }
+
+    /* Sum up what we got */
+    TotalSpins = TotalLatency = MaxLatency = 0;
+    TotalWakeups = 0;
+    for (i = 0; i < Threads; i++)
+    {
+        TotalSpins += Spins[i];
+        TotalLatency += Sleepers[i].TotalLatency;
+        TotalWakeups += Sleepers[i].Wakeups;
+        if (Sleepers[i].MaxLatency > MaxLatency)
+            MaxLatency = Sleepers[i].MaxLatency;
+    }
+    ok_long(TotalWakeups, WAKEUPS * Threads);
+
+    /* Every spinning thread must have gotten some CPU time */
+    for (i = 0; i < Threads; i++)
+        ok(Spins[i] != 0, "Thread %lu never ran\n", i);
+
+    Elapsed = (End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart;
+    trace("%lu wakeups in %I64d ms, %I64d spins\n", TotalWakeups, Elapsed, TotalSpins);
+    if (Elapsed)
+        trace("CPU-bound throughput: %I64d spins/ms\n", TotalSpins / Elapsed);
+    if (TotalWakeups)
+    {
+        trace("Wake-up latency: average %I64d us, worst %I64d us\n",
+              TotalLatency * 1000000 / Frequency.QuadPart / TotalWakeups,
+              MaxLatency * 1000000 / Frequency.QuadPart);
+    }
+}
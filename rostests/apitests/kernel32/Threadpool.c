@@ -0,0 +1,444 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for the Vista thread pool
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WORK_ITEMS  1000
+#define WAITS       200
+
+typedef VOID (WINAPI *PTEST_IO_CALLBACK)(PTP_CALLBACK_INSTANCE, PVOID, PVOID, ULONG, ULONG_PTR, PTP_IO);
+
+static PTP_POOL (WINAPI *pCreateThreadpool)(PVOID);
+static VOID (WINAPI *pCloseThreadpool)(PTP_POOL);
+static VOID (WINAPI *pSetThreadpoolThreadMaximum)(PTP_POOL, DWORD);
+static BOOL (WINAPI *pSetThreadpoolThreadMinimum)(PTP_POOL, DWORD);
+static PTP_CLEANUP_GROUP (WINAPI *pCreateThreadpoolCleanupGroup)(VOID);
+static VOID (WINAPI *pCloseThreadpoolCleanupGroup)(PTP_CLEANUP_GROUP);
+static VOID (WINAPI *pCloseThreadpoolCleanupGroupMembers)(PTP_CLEANUP_GROUP, BOOL, PVOID);
+static BOOL (WINAPI *pTrySubmitThreadpoolCallback)(PTP_SIMPLE_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static PTP_WORK (WINAPI *pCreateThreadpoolWork)(PTP_WORK_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSubmitThreadpoolWork)(PTP_WORK);
+static VOID (WINAPI *pWaitForThreadpoolWorkCallbacks)(PTP_WORK, BOOL);
+static VOID (WINAPI *pCloseThreadpoolWork)(PTP_WORK);
+static PTP_TIMER (WINAPI *pCreateThreadpoolTimer)(PTP_TIMER_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSetThreadpoolTimer)(PTP_TIMER, PFILETIME, DWORD, DWORD);
+static BOOL (WINAPI *pIsThreadpoolTimerSet)(PTP_TIMER);
+static VOID (WINAPI *pWaitForThreadpoolTimerCallbacks)(PTP_TIMER, BOOL);
+static VOID (WINAPI *pCloseThreadpoolTimer)(PTP_TIMER);
+static PTP_WAIT (WINAPI *pCreateThreadpoolWait)(PTP_WAIT_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSetThreadpoolWait)(PTP_WAIT, HANDLE, PFILETIME);
+static VOID (WINAPI *pWaitForThreadpoolWaitCallbacks)(PTP_WAIT, BOOL);
+static VOID (WINAPI *pCloseThreadpoolWait)(PTP_WAIT);
+static PTP_IO (WINAPI *pCreateThreadpoolIo)(HANDLE, PTEST_IO_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pStartThreadpoolIo)(PTP_IO);
+static VOID (WINAPI *pCancelThreadpoolIo)(PTP_IO);
+static VOID (WINAPI *pWaitForThreadpoolIoCallbacks)(PTP_IO, BOOL);
+static VOID (WINAPI *pCloseThreadpoolIo)(PTP_IO);
+static VOID (WINAPI *pSetEventWhenCallbackReturns)(PTP_CALLBACK_INSTANCE, HANDLE);
+
+static LONG WorkCount;
+static LONG TimerCount;
+static LONG WaitCount;
+static LONG TimeoutCount;
+static LONG IoCount;
+static ULONG IoResult;
+static ULONG_PTR IoBytes;
+static PVOID IoOverlapped;
+
+static
+VOID
+NTAPI
+WorkCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work)
+{
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+SimpleCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context)
+{
+    pSetEventWhenCallbackReturns(Instance, Context);
+}
+
+static
+VOID
+NTAPI
+TimerCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    if (InterlockedIncrement(&TimerCount) == 3)
+        SetEvent(Context);
+}
+
+static
+VOID
+NTAPI
+WindowCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    SetEvent(Context);
+}
+
+static
+VOID
+NTAPI
+WaitCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult)
+{
+    if (WaitResult == WAIT_TIMEOUT)
+        InterlockedIncrement(&TimeoutCount);
+    else if (WaitResult == WAIT_OBJECT_0)
+        InterlockedIncrement(&WaitCount);
+}
+
+static
+VOID
+WINAPI
+IoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PVOID Overlapped,
+           ULONG Result, ULONG_PTR NumberOfBytesTransferred, PTP_IO Io)
+{
+    IoResult = Result;
+    IoBytes = NumberOfBytesTransferred;
+    IoOverlapped = Overlapped;
+    InterlockedIncrement(&IoCount);
+    pSetEventWhenCallbackReturns(Instance, Context);
+}
+
+static
+VOID
+TestWork(VOID)
+{
+    PTP_WORK Work;
+    HANDLE Event;
+    DWORD Start, Ticks;
+    ULONG i;
+
+    Work = pCreateThreadpoolWork(WorkCallback, NULL, NULL);
+    ok(Work != NULL, "CreateThreadpoolWork failed with %lu\n", GetLastError());
+    if (!Work)
+        return;
+
+    WorkCount = 0;
+    Start = GetTickCount();
+    for (i = 0; i < WORK_ITEMS; i++)
+        pSubmitThreadpoolWork(Work);
+    pWaitForThreadpoolWorkCallbacks(Work, FALSE);
+    Ticks = GetTickCount() - Start;
+    ok_long(WorkCount, WORK_ITEMS);
+    trace("%u work callbacks in %lu ms\n", WORK_ITEMS, Ticks);
+
+    pCloseThreadpoolWork(Work);
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ok(pTrySubmitThreadpoolCallback(SimpleCallback, Event, NULL), "TrySubmitThreadpoolCallback failed\n");
+    ok_long(WaitForSingleObject(Event, 5000), WAIT_OBJECT_0);
+    CloseHandle(Event);
+}
+
+static
+VOID
+TestTimer(VOID)
+{
+    PTP_TIMER Timer;
+    LARGE_INTEGER DueTime;
+    HANDLE Event;
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    Timer = pCreateThreadpoolTimer(TimerCallback, Event, NULL);
+    ok(Timer != NULL, "CreateThreadpoolTimer failed with %lu\n", GetLastError());
+    if (!Timer)
+    {
+        CloseHandle(Event);
+        return;
+    }
+
+    ok(!pIsThreadpoolTimerSet(Timer), "Timer is set\n");
+
+    /* Every 20 ms, starting in 10 ms */
+    TimerCount = 0;
+    DueTime.QuadPart = -10 * 10000;
+    pSetThreadpoolTimer(Timer, (PFILETIME)&DueTime, 20, 5);
+    ok(pIsThreadpoolTimerSet(Timer), "Timer is not set\n");
+    ok_long(WaitForSingleObject(Event, 5000), WAIT_OBJECT_0);
+
+    pSetThreadpoolTimer(Timer, NULL, 0, 0);
+    pWaitForThreadpoolTimerCallbacks(Timer, TRUE);
+    ok(!pIsThreadpoolTimerSet(Timer), "Timer is still set\n");
+    ok(TimerCount >= 3, "Timer fired %ld times\n", TimerCount);
+
+    pCloseThreadpoolTimer(Timer);
+    CloseHandle(Event);
+}
+
+static
+VOID
+TestTimerWindow(VOID)
+{
+    PTP_TIMER LazyTimer, SharpTimer;
+    LARGE_INTEGER DueTime;
+    HANDLE LazyEvent, SharpEvent;
+    DWORD Start, Ticks;
+
+    LazyEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    SharpEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    LazyTimer = pCreateThreadpoolTimer(WindowCallback, LazyEvent, NULL);
+    SharpTimer = pCreateThreadpoolTimer(WindowCallback, SharpEvent, NULL);
+    ok(LazyTimer != NULL && SharpTimer != NULL, "CreateThreadpoolTimer failed with %lu\n", GetLastError());
+    if (!LazyTimer || !SharpTimer)
+        goto Cleanup;
+
+    /* The first timer may wait for 5 s, the one due after it may not */
+    Start = GetTickCount();
+    DueTime.QuadPart = -50 * 10000;
+    pSetThreadpoolTimer(LazyTimer, (PFILETIME)&DueTime, 0, 5000);
+    DueTime.QuadPart = -100 * 10000;
+    pSetThreadpoolTimer(SharpTimer, (PFILETIME)&DueTime, 0, 0);
+
+    ok_long(WaitForSingleObject(SharpEvent, 10000), WAIT_OBJECT_0);
+    Ticks = GetTickCount() - Start;
+    ok(Ticks < 2000, "The timer fired after %lu ms\n", Ticks);
+    ok_long(WaitForSingleObject(LazyEvent, 10000), WAIT_OBJECT_0);
+
+Cleanup:
+    if (SharpTimer) pCloseThreadpoolTimer(SharpTimer);
+    if (LazyTimer) pCloseThreadpoolTimer(LazyTimer);
+    CloseHandle(SharpEvent);
+    CloseHandle(LazyEvent);
+}
+
+static
+VOID
+TestWait(VOID)
+{
+    PTP_WAIT Waits[WAITS];
+    HANDLE Events[WAITS];
+    LARGE_INTEGER Timeout;
+    ULONG i;
+
+    /* More waits than one thread can ever wait for */
+    WaitCount = 0;
+    TimeoutCount = 0;
+    for (i = 0; i < WAITS; i++)
+    {
+        Events[i] = CreateEventW(NULL, TRUE, FALSE, NULL);
+        Waits[i] = pCreateThreadpoolWait(WaitCallback, NULL, NULL);
+        ok(Waits[i] != NULL, "CreateThreadpoolWait failed with %lu\n", GetLastError());
+        if (Waits[i])
+            pSetThreadpoolWait(Waits[i], Events[i], NULL);
+    }
+
+    for (i = 0; i < WAITS; i++)
+        SetEvent(Events[i]);
+
+    for (i = 0; i < WAITS; i++)
+    {
+        if (!Waits[i])
+            continue;
+
+        pWaitForThreadpoolWaitCallbacks(Waits[i], FALSE);
+    }
+
+    /* The callbacks might not have been queued yet when we checked */
+    for (i = 0; i < 500 && WaitCount != WAITS; i++)
+        Sleep(10);
+    ok_long(WaitCount, WAITS);
+    ok_long(TimeoutCount, 0);
+
+    /* A wait that times out */
+    ResetEvent(Events[0]);
+    Timeout.QuadPart = -20 * 10000;
+    pSetThreadpoolWait(Waits[0], Events[0], (PFILETIME)&Timeout);
+    for (i = 0; i < 500 && TimeoutCount == 0; i++)
+        Sleep(10);
+    ok_long(TimeoutCount, 1);
+
+    for (i = 0; i < WAITS; i++)
+    {
+        if (Waits[i])
+        {
+            pSetThreadpoolWait(Waits[i], NULL, NULL);
+            pWaitForThreadpoolWaitCallbacks(Waits[i], TRUE);
+            pCloseThreadpoolWait(Waits[i]);
+        }
+        CloseHandle(Events[i]);
+    }
+}
+
+static
+VOID
+TestCleanupGroup(VOID)
+{
+    TP_CALLBACK_ENVIRON CallbackEnviron;
+    PTP_CLEANUP_GROUP CleanupGroup;
+    PTP_POOL Pool;
+    PTP_WORK Work;
+    ULONG i;
+
+    Pool = pCreateThreadpool(NULL);
+    ok(Pool != NULL, "CreateThreadpool failed with %lu\n", GetLastError());
+    CleanupGroup = pCreateThreadpoolCleanupGroup();
+    ok(CleanupGroup != NULL, "CreateThreadpoolCleanupGroup failed with %lu\n", GetLastError());
+    if (!Pool || !CleanupGroup)
+        return;
+
+    pSetThreadpoolThreadMaximum(Pool, 2);
+    ok(pSetThreadpoolThreadMinimum(Pool, 1), "SetThreadpoolThreadMinimum failed\n");
+
+    TpInitializeCallbackEnviron(&CallbackEnviron);
+    TpSetCallbackThreadpool(&CallbackEnviron, Pool);
+    TpSetCallbackCleanupGroup(&CallbackEnviron, CleanupGroup, NULL);
+
+    Work = pCreateThreadpoolWork(WorkCallback, NULL, &CallbackEnviron);
+    ok(Work != NULL, "CreateThreadpoolWork failed with %lu\n", GetLastError());
+    if (Work)
+    {
+        WorkCount = 0;
+        for (i = 0; i < WORK_ITEMS; i++)
+            pSubmitThreadpoolWork(Work);
+    }
+
+    /* This waits for the callbacks and closes the work object for us */
+    pCloseThreadpoolCleanupGroupMembers(CleanupGroup, FALSE, NULL);
+    if (Work)
+        ok_long(WorkCount, WORK_ITEMS);
+
+    pCloseThreadpoolCleanupGroup(CleanupGroup);
+    pCloseThreadpool(Pool);
+}
+
+static
+VOID
+TestIo(VOID)
+{
+    WCHAR TempPath[MAX_PATH], FileName[MAX_PATH];
+    CHAR Buffer[512];
+    OVERLAPPED Overlapped;
+    HANDLE File, Event;
+    DWORD Written;
+    PTP_IO Io;
+    BOOL Ret;
+
+    GetTempPathW(MAX_PATH, TempPath);
+    GetTempFileNameW(TempPath, L"tpi", 0, FileName);
+    File = CreateFileW(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    Io = pCreateThreadpoolIo(File, IoCallback, Event, NULL);
+    ok(Io != NULL, "CreateThreadpoolIo failed with %lu\n", GetLastError());
+    if (!Io)
+    {
+        CloseHandle(Event);
+        CloseHandle(File);
+        return;
+    }
+
+    FillMemory(Buffer, sizeof(Buffer), 0x55);
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    IoCount = 0;
+
+    pStartThreadpoolIo(Io);
+    Ret = WriteFile(File, Buffer, sizeof(Buffer), &Written, &Overlapped);
+    ok(Ret || GetLastError() == ERROR_IO_PENDING, "WriteFile failed with %lu\n", GetLastError());
+    ok_long(WaitForSingleObject(Event, 5000), WAIT_OBJECT_0);
+    ok_long(IoCount, 1);
+    ok_long(IoResult, ERROR_SUCCESS);
+    ok(IoBytes == sizeof(Buffer), "Got %lu bytes\n", (ULONG)IoBytes);
+    ok(IoOverlapped == &Overlapped, "Got overlapped %p\n", IoOverlapped);
+
+    /* Reading past the end fails, possibly without a completion */
+    Overlapped.Offset = 4096;
+    pStartThreadpoolIo(Io);
+    Ret = ReadFile(File, Buffer, sizeof(Buffer), NULL, &Overlapped);
+    if (!Ret && GetLastError() == ERROR_IO_PENDING)
+    {
+        ok_long(WaitForSingleObject(Event, 5000), WAIT_OBJECT_0);
+        ok_long(IoResult, ERROR_HANDLE_EOF);
+        ok_long(IoCount, 2);
+    }
+    else
+    {
+        ok(!Ret, "ReadFile succeeded\n");
+        ok_long(GetLastError(), ERROR_HANDLE_EOF);
+        pCancelThreadpoolIo(Io);
+        ok_long(IoCount, 1);
+    }
+
+    pWaitForThreadpoolIoCallbacks(Io, FALSE);
+    pCloseThreadpoolIo(Io);
+    CloseHandle(Event);
+    CloseHandle(File);
+}
+
+START_TEST(Threadpool)
+{
+    HMODULE hKernel32;
+
+    hKernel32 = GetModuleHandleW(L"kernel32.dll");
+    pCreateThreadpoolWork = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolWork");
+    if (!pCreateThreadpoolWork)
+    {
+        hKernel32 = LoadLibraryW(L"kernel32_vista.dll");
+        if (!hKernel32)
+        {
+            skip("The thread pool is not available\n");
+            return;
+        }
+        pCreateThreadpoolWork = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolWork");
+    }
+
+    pCreateThreadpool = (PVOID)GetProcAddress(hKernel32, "CreateThreadpool");
+    pCloseThreadpool = (PVOID)GetProcAddress(hKernel32, "CloseThreadpool");
+    pSetThreadpoolThreadMaximum = (PVOID)GetProcAddress(hKernel32, "SetThreadpoolThreadMaximum");
+    pSetThreadpoolThreadMinimum = (PVOID)GetProcAddress(hKernel32, "SetThreadpoolThreadMinimum");
+    pCreateThreadpoolCleanupGroup = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolCleanupGroup");
+    pCloseThreadpoolCleanupGroup = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolCleanupGroup");
+    pCloseThreadpoolCleanupGroupMembers = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolCleanupGroupMembers");
+    pTrySubmitThreadpoolCallback = (PVOID)GetProcAddress(hKernel32, "TrySubmitThreadpoolCallback");
+    pSubmitThreadpoolWork = (PVOID)GetProcAddress(hKernel32, "SubmitThreadpoolWork");
+    pWaitForThreadpoolWorkCallbacks = (PVOID)GetProcAddress(hKernel32, "WaitForThreadpoolWorkCallbacks");
+    pCloseThreadpoolWork = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolWork");
+    pCreateThreadpoolTimer = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolTimer");
+    pSetThreadpoolTimer = (PVOID)GetProcAddress(hKernel32, "SetThreadpoolTimer");
+    pIsThreadpoolTimerSet = (PVOID)GetProcAddress(hKernel32, "IsThreadpoolTimerSet");
+    pWaitForThreadpoolTimerCallbacks = (PVOID)GetProcAddress(hKernel32, "WaitForThreadpoolTimerCallbacks");
+    pCloseThreadpoolTimer = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolTimer");
+    pCreateThreadpoolWait = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolWait");
+    pSetThreadpoolWait = (PVOID)GetProcAddress(hKernel32, "SetThreadpoolWait");
+    pWaitForThreadpoolWaitCallbacks = (PVOID)GetProcAddress(hKernel32, "WaitForThreadpoolWaitCallbacks");
+    pCloseThreadpoolWait = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolWait");
+    pCreateThreadpoolIo = (PVOID)GetProcAddress(hKernel32, "CreateThreadpoolIo");
+    pStartThreadpoolIo = (PVOID)GetProcAddress(hKernel32, "StartThreadpoolIo");
+    pCancelThreadpoolIo = (PVOID)GetProcAddress(hKernel32, "CancelThreadpoolIo");
+    pWaitForThreadpoolIoCallbacks = (PVOID)GetProcAddress(hKernel32, "WaitForThreadpoolIoCallbacks");
+    pCloseThreadpoolIo = (PVOID)GetProcAddress(hKernel32, "CloseThreadpoolIo");
+    pSetEventWhenCallbackReturns = (PVOID)GetProcAddress(hKernel32, "SetEventWhenCallbackReturns");
+    if (!pCreateThreadpoolWork || !pCreateThreadpool || !pCloseThreadpool ||
+        !pSetThreadpoolThreadMaximum || !pSetThreadpoolThreadMinimum ||
+        !pCreateThreadpoolCleanupGroup || !pCloseThreadpoolCleanupGroup ||
+        !pCloseThreadpoolCleanupGroupMembers || !pTrySubmitThreadpoolCallback ||
+        !pSubmitThreadpoolWork || !pWaitForThreadpoolWorkCallbacks ||
+        !pCloseThreadpoolWork || !pCreateThreadpoolTimer || !pSetThreadpoolTimer ||
+        !pIsThreadpoolTimerSet || !pWaitForThreadpoolTimerCallbacks ||
+        !pCloseThreadpoolTimer || !pCreateThreadpoolWait || !pSetThreadpoolWait ||
+        !pWaitForThreadpoolWaitCallbacks || !pCloseThreadpoolWait ||
+        !pCreateThreadpoolIo || !pStartThreadpoolIo || !pCancelThreadpoolIo ||
+        !pWaitForThreadpoolIoCallbacks || !pCloseThreadpoolIo ||
+        !pSetEventWhenCallbackReturns)
+    {
+        skip("The thread pool is not available\n");
+        return;
+    }
+
+    TestWork();
+    TestTimer();
+    TestTimerWindow();
+    TestWait();
+    TestCleanupGroup();
+    TestIo();
+}
@@ -3,6 +3,7 @@
 #define STANDALONE
 #include <apitest.h>
 
+extern void func_ConditionVariable(void);
 extern void func_dosdev(void);
 extern void func_FindFiles(void);
 extern void func_GetComputerNameEx(void);
@@ -10,19 +11,25 @@ extern void func_GetCurrentDirectory(void);
 extern void func_GetDriveType(void);
 extern void func_GetModuleFileName(void);
 extern void func_interlck(void);
+extern void func_LargeFileWrite(void);
 extern void func_lstrcpynW(void);
 extern void func_Mailslot(void);
 extern void func_MultiByteToWideChar(void);
+extern void func_Paging(void);
 extern void func_PrivMoveFileIdentityW(void);
+extern void func_ReadFileScatter(void);
+extern void func_Scheduler(void);
 extern void func_SetConsoleWindowInfo(void);
 extern void func_SetCurrentDirectory(void);
 extern void func_SetUnhandledExceptionFilter(void);
 extern void func_TerminateProcess(void);
+extern void func_Threadpool(void);
 extern void func_TunnelCache(void);
 extern void func_WideCharToMultiByte(void);
 
 const struct test winetest_testlist[] =
 {
+    { "ConditionVariable",           func_ConditionVariable },
     { "dosdev",                      func_dosdev },
     { "FindFiles",                   func_FindFiles },
     { "GetComputerNameEx",           func_GetComputerNameEx },
@@ -30,14 +37,19 @@ const struct test winetest_testlist[] =
     { "GetDriveType",                func_GetDriveType },
     { "GetModuleFileName",           func_GetModuleFileName },
     { "interlck",                    func_interlck },
+    { "LargeFileWrite",              func_LargeFileWrite },
     { "lstrcpynW",                   func_lstrcpynW },
     { "MailslotRead",                func_Mailslot },
     { "MultiByteToWideChar",         func_MultiByteToWideChar },
+    { "Paging",                      func_Paging },
     { "PrivMoveFileIdentityW",       func_PrivMoveFileIdentityW },
+    { "ReadFileScatter",             func_ReadFileScatter },
+    { "Scheduler",                   func_Scheduler },
     { "SetConsoleWindowInfo",        func_SetConsoleWindowInfo },
     { "SetCurrentDirectory",         func_SetCurrentDirectory },
     { "SetUnhandledExceptionFilter", func_SetUnhandledExceptionFilter },
     { "TerminateProcess",            func_TerminateProcess },
+    { "Threadpool",                  func_Threadpool },
     { "TunnelCache",                 func_TunnelCache },
     { "WideCharToMultiByte",         func_WideCharToMultiByte },
     { 0, 0 }
@@ -1,6 +1,8 @@
 
 #include <apitest.h>
 
+#include <stdio.h>
+
 #define WIN32_NO_STATUS
 #include <ndk/mmfuncs.h>
 #include <ndk/rtlfuncs.h>
@@ -612,13 +614,328 @@ Test_RtlFindLastBackwardRunClear(void)
 void
 Test_RtlFindClearRuns(void)
 {
+    RTL_BITMAP BitMapHeader;
+    RTL_BITMAP_RUN Runs[4];
+    ULONG *Buffer;
+
+    Buffer = AllocateGuarded(2 * sizeof(*Buffer));
+    Buffer[0] = 0xF9F078B2;
+    Buffer[1] = 0x3F303F30;
+
+    /* Clear runs: 0, 2-3, 6, 8-10, 15-19, 25-26, 32-35, 38-39, 46-51, 54-55, 62-63 */
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 64);
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 4, FALSE), 4);
+    ok_int(Runs[0].StartingIndex, 0);
+    ok_int(Runs[0].NumberOfBits, 1);
+    ok_int(Runs[1].StartingIndex, 2);
+    ok_int(Runs[1].NumberOfBits, 2);
+    ok_int(Runs[2].StartingIndex, 6);
+    ok_int(Runs[2].NumberOfBits, 1);
+    ok_int(Runs[3].StartingIndex, 8);
+    ok_int(Runs[3].NumberOfBits, 3);
+
+    /* The smallest run gets replaced until only the longest are left */
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 2, TRUE), 2);
+    ok_int(Runs[0].StartingIndex + Runs[1].StartingIndex, 15 + 46);
+    ok_int(Runs[0].NumberOfBits + Runs[1].NumberOfBits, 5 + 6);
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 20);
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 4, TRUE), 4);
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 1, TRUE), 1);
+    ok_int(Runs[0].StartingIndex, 15);
+    ok_int(Runs[0].NumberOfBits, 5);
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 0);
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 4, FALSE), 0);
+
+    Buffer[0] = 0xFFFFFFFF;
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 32);
+    ok_int(RtlFindClearRuns(&BitMapHeader, Runs, 4, TRUE), 0);
+    FreeGuarded(Buffer);
 }
 
 void
 Test_RtlFindLongestRunClear(void)
 {
+    RTL_BITMAP BitMapHeader;
+    ULONG *Buffer;
+    ULONG Index;
+
+    Buffer = AllocateGuarded(2 * sizeof(*Buffer));
+    Buffer[0] = 0xF9F078B2;
+    Buffer[1] = 0x3F303F30;
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 64);
+    ok_int(RtlFindLongestRunClear(&BitMapHeader, &Index), 6);
+    ok_int(Index, 46);
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, 48);
+    ok_int(RtlFindLongestRunClear(&BitMapHeader, &Index), 5);
+    ok_int(Index, 15);
+
+    /* Runs across the ULONGs */
+    Buffer[0] = 0x0000FFFF;
+    Buffer[1] = 0xFFFF0000;
+    ok_int(RtlFindLongestRunClear(&BitMapHeader, &Index), 32);
+    ok_int(Index, 16);
+
+    Buffer[0] = 0;
+    Buffer[1] = 0;
+    ok_int(RtlFindLongestRunClear(&BitMapHeader, &Index), 48);
+    ok_int(Index, 0);
+
+    Index = 0xcccccccc;
+    Buffer[0] = 0xFFFFFFFF;
+    Buffer[1] = 0xFFFFFFFF;
+    ok_int(RtlFindLongestRunClear(&BitMapHeader, &Index), 0);
+    ok_hex(Index, 0xcccccccc);
+    FreeGuarded(Buffer);
+}
+
+static ULONG BitmapSeed;
+
+static
+ULONG
+BitmapRandom(VOID)
+{
+    BitmapSeed = BitmapSeed * 1103515245 + 12345;
+    return BitmapSeed >> 8;
+}
+
+static
+BOOLEAN
+BitmapModelTest(PULONG Buffer, ULONG Index)
+{
+    return (Buffer[Index / 32] >> (Index % 32)) & 1;
+}
+
+/* Bit by bit versions of what the bitmap functions do */
+static
+ULONG
+BitmapModelFind(PULONG Buffer, ULONG Size, ULONG NumberToFind, ULONG HintIndex, BOOLEAN Set)
+{
+    ULONG Pass, Index, Length, Bit;
+
+    if (NumberToFind > Size)
+        return MAXULONG;
+    if (HintIndex >= Size)
+        HintIndex = 0;
+    if (NumberToFind == 0)
+        return HintIndex & ~7;
+
+    /* From the hint on first, then what starts before it */
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        for (Index = Pass ? 0 : HintIndex; Index + NumberToFind <= Size; Index++)
+        {
+            if (Pass && Index >= HintIndex)
+                break;
+
+            for (Length = 0, Bit = Index; Length < NumberToFind; Length++, Bit++)
+            {
+                if (BitmapModelTest(Buffer, Bit) != Set)
+                    break;
+            }
+
+            if (Length == NumberToFind)
+                return Index;
+        }
+    }
+
+    return MAXULONG;
+}
+
+static
+ULONG
+BitmapModelNextRun(PULONG Buffer, ULONG Size, ULONG FromIndex, PULONG StartingIndex, BOOLEAN Set)
+{
+    ULONG Index = FromIndex;
+
+    while (Index < Size && BitmapModelTest(Buffer, Index) != Set)
+        Index++;
+
+    *StartingIndex = Index;
+    while (Index < Size && BitmapModelTest(Buffer, Index) == Set)
+        Index++;
+
+    return Index - *StartingIndex;
+}
+
+static
+VOID
+BitmapCheck(PULONG Buffer, ULONG Size, PCSTR Description)
+{
+    RTL_BITMAP BitMapHeader;
+    RTL_BITMAP_RUN Runs[8], ModelRuns[8];
+    ULONG Index, ModelIndex, Length, ModelLength, Count, ModelCount, Run, i;
+    ULONG NumberToFind, HintIndex, Bits;
+    BOOLEAN Set;
+
+    RtlInitializeBitMap(&BitMapHeader, Buffer, Size);
+
+    for (Index = 0, Bits = 0; Index < Size; Index++)
+        Bits += BitmapModelTest(Buffer, Index);
+    ok(RtlNumberOfSetBits(&BitMapHeader) == Bits, "%s: %lu set bits instead of %lu\n",
+       Description, RtlNumberOfSetBits(&BitMapHeader), Bits);
+
+    for (Set = FALSE; Set <= TRUE; Set++)
+    {
+        for (NumberToFind = 0; NumberToFind <= min(Size, 70); NumberToFind += 1 + NumberToFind / 8)
+        {
+            for (HintIndex = 0; HintIndex <= Size; HintIndex += 1 + Size / 16)
+            {
+                Index = Set ? RtlFindSetBits(&BitMapHeader, NumberToFind, HintIndex)
+                            : RtlFindClearBits(&BitMapHeader, NumberToFind, HintIndex);
+                ModelIndex = BitmapModelFind(Buffer, Size, NumberToFind, HintIndex, Set);
+                ok(Index == ModelIndex, "%s: RtlFind%sBits(%lu, %lu) returned %lu instead of %lu\n",
+                   Description, Set ? "Set" : "Clear", NumberToFind, HintIndex, Index, ModelIndex);
+            }
+        }
+    }
+
+    for (Index = 0; Index < Size; Index += 1 + Size / 32)
+    {
+        Length = RtlFindNextForwardRunClear(&BitMapHeader, Index, &Run);
+        ModelLength = BitmapModelNextRun(Buffer, Size, Index, &ModelIndex, FALSE);
+        ok(Length == ModelLength && (Length == 0 || Run == ModelIndex),
+           "%s: next clear run from %lu is %lu at %lu instead of %lu at %lu\n",
+           Description, Index, Length, Run, ModelLength, ModelIndex);
+    }
+
+    /* The first of the longest runs */
+    ModelLength = 0;
+    ModelIndex = 0;
+    for (Index = 0; Index < Size; Index = Run + Length)
+    {
+        Length = BitmapModelNextRun(Buffer, Size, Index, &Run, FALSE);
+        if (Length > ModelLength)
+        {
+            ModelLength = Length;
+            ModelIndex = Run;
+        }
+    }
+
+    Run = 0;
+    Length = RtlFindLongestRunClear(&BitMapHeader, &Run);
+    ok(Length == ModelLength && (Length == 0 || Run == ModelIndex),
+       "%s: longest clear run is %lu at %lu instead of %lu at %lu\n",
+       Description, Length, Run, ModelLength, ModelIndex);
+
+    /* The first clear runs */
+    ModelCount = 0;
+    for (Index = 0; Index < Size && ModelCount < ARRAYSIZE(ModelRuns); Index = Run + Length)
+    {
+        Length = BitmapModelNextRun(Buffer, Size, Index, &Run, FALSE);
+        if (Length == 0)
+            break;
+        ModelRuns[ModelCount].StartingIndex = Run;
+        ModelRuns[ModelCount].NumberOfBits = Length;
+        ModelCount++;
+    }
+
+    Count = RtlFindClearRuns(&BitMapHeader, Runs, ARRAYSIZE(Runs), FALSE);
+    ok(Count == ModelCount, "%s: %lu clear runs instead of %lu\n", Description, Count, ModelCount);
+    for (i = 0; i < min(Count, ModelCount); i++)
+    {
+        ok(Runs[i].StartingIndex == ModelRuns[i].StartingIndex &&
+           Runs[i].NumberOfBits == ModelRuns[i].NumberOfBits,
+           "%s: clear run %lu is %lu at %lu instead of %lu at %lu\n",
+           Description, i, Runs[i].NumberOfBits, Runs[i].StartingIndex,
+           ModelRuns[i].NumberOfBits, ModelRuns[i].StartingIndex);
+    }
+
+    /* The longest ones, in no particular order: count how many runs of
+       each of the lengths returned are longer than the shortest one */
+    Count = RtlFindClearRuns(&BitMapHeader, Runs, 3, TRUE);
+    ok(Count == min(ModelCount, 3), "%s: %lu longest clear runs\n", Description, Count);
+    for (i = 0, Length = MAXULONG; i < Count; i++)
+    {
+        ModelLength = BitmapModelNextRun(Buffer, Size, Runs[i].StartingIndex, &ModelIndex, FALSE);
+        ok(ModelIndex == Runs[i].StartingIndex && ModelLength == Runs[i].NumberOfBits &&
+           (Runs[i].StartingIndex == 0 || BitmapModelTest(Buffer, Runs[i].StartingIndex - 1)),
+           "%s: %lu at %lu is not a clear run\n", Description, Runs[i].NumberOfBits, Runs[i].StartingIndex);
+        Length = min(Length, Runs[i].NumberOfBits);
+    }
+
+    if (Count == 3)
+    {
+        for (Index = 0, ModelCount = 0; Index < Size; Index = Run + ModelLength)
+        {
+            ModelLength = BitmapModelNextRun(Buffer, Size, Index, &Run, FALSE);
+            if (ModelLength > Length)
+                ModelCount++;
+        }
+
+        for (i = 0, Count = 0; i < 3; i++)
+        {
+            if (Runs[i].NumberOfBits > Length)
+                Count++;
+        }
+
+        ok(Count == ModelCount, "%s: %lu runs longer than %lu instead of %lu\n",
+           Description, Count, Length, ModelCount);
+    }
 }
 
+void
+Test_RtlBitmapModel(void)
+{
+    RTL_BITMAP BitMapHeader;
+    CHAR Description[64];
+    ULONG *Buffer;
+    ULONG Pattern, Size, Offset, Index, Length, i;
+    BOOLEAN Set;
+
+    Buffer = AllocateGuarded(128 * sizeof(*Buffer));
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        return;
+    }
+
+    /* Every 10 bit pattern, moved around the ULONG boundaries, with
+       the bits around it and past the end of the bitmap set or clear */
+    for (Pattern = 0; Pattern < (1 << 10); Pattern++)
+    {
+        for (Offset = 22 + (Pattern % 3) * 6; Offset <= 54; Offset += 16)
+        {
+            RtlFillMemory(Buffer, 3 * sizeof(*Buffer), (Pattern & 1) ? 0xFF : 0x00);
+            for (i = 0; i < 10; i++)
+            {
+                if (Pattern & (1 << i))
+                    Buffer[(Offset + i) / 32] |= 1UL << ((Offset + i) % 32);
+                else
+                    Buffer[(Offset + i) / 32] &= ~(1UL << ((Offset + i) % 32));
+            }
+
+            Size = Offset + 10 - (Pattern >> 8);
+            sprintf(Description, "pattern %03lx at %lu", Pattern, Offset);
+            BitmapCheck(Buffer, Size, Description);
+        }
+    }
+
+    /* And random runs in larger ones */
+    BitmapSeed = 0x12345678;
+    for (i = 0; i < 64; i++)
+    {
+        Size = 1 + BitmapRandom() % (128 * 32);
+        for (Index = 0, Set = FALSE; Index < 128 * 32; Index += Length, Set = !Set)
+        {
+            Length = 1 + BitmapRandom() % ((i & 1) ? 8 : 100);
+            Length = min(Length, 128 * 32 - Index);
+            RtlInitializeBitMap(&BitMapHeader, Buffer, 128 * 32);
+            if (Set)
+                RtlSetBits(&BitMapHeader, Index, Length);
+            else
+                RtlClearBits(&BitMapHeader, Index, Length);
+        }
+
+        sprintf(Description, "random bitmap %lu", i);
+        BitmapCheck(Buffer, Size, Description);
+    }
+
+    FreeGuarded(Buffer);
+}
 
 START_TEST(RtlBitmap)
 {
@@ -642,5 +959,6 @@ START_TEST(RtlBitmap)
     Test_RtlFindLastBackwardRunClear();
     Test_RtlFindClearRuns();
     Test_RtlFindLongestRunClear();
+    Test_RtlBitmapModel();
 }
 
@@ -0,0 +1,316 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Round trip and benchmark for RtlCompressBuffer
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <ndk/rtlfuncs.h>
+
+#include <stdio.h>
+
+#define CORPUS_SIZE         (256 * 1024)
+#define COMPRESSED_SIZE     (CORPUS_SIZE + CORPUS_SIZE / 8 + 1024)
+#define ROUNDS              4
+
+typedef struct _TEST_FORMAT
+{
+    USHORT Format;
+    PCSTR Name;
+} TEST_FORMAT;
+
+static const TEST_FORMAT Formats[] =
+{
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_STANDARD, "LZNT1" },
+    { COMPRESSION_FORMAT_LZNT1 | COMPRESSION_ENGINE_MAXIMUM, "LZNT1 (max)" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_STANDARD, "XPRESS" },
+    { COMPRESSION_FORMAT_XPRESS | COMPRESSION_ENGINE_MAXIMUM, "XPRESS (max)" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_STANDARD, "XPRESS_HUFF" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF | COMPRESSION_ENGINE_MAXIMUM, "XPRESS_HUFF (max)" },
+};
+
+static const PCSTR Words[] =
+{
+    "the", "of", "and", "to", "in", "is", "that", "for", "it", "with",
+    "file", "system", "buffer", "chunk", "compression", "kernel", "driver",
+    "memory", "page", "process", "thread", "registry", "volume", "cache",
+};
+
+static ULONG Seed;
+
+static
+ULONG
+NextRandom(VOID)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return Seed >> 8;
+}
+
+static
+VOID
+MakeText(PUCHAR Buffer)
+{
+    ULONG Position = 0, Length;
+    PCSTR Word;
+
+    while (Position < CORPUS_SIZE)
+    {
+        Word = Words[NextRandom() % ARRAYSIZE(Words)];
+        Length = min((ULONG)strlen(Word), CORPUS_SIZE - Position);
+        memcpy(Buffer + Position, Word, Length);
+        Position += Length;
+        if (Position < CORPUS_SIZE)
+            Buffer[Position++] = (NextRandom() % 12) ? ' ' : '\n';
+    }
+}
+
+static
+VOID
+MakeRecords(PUCHAR Buffer)
+{
+    struct
+    {
+        ULONG Id;
+        USHORT Type;
+        USHORT Flags;
+        ULONG Size;
+        CHAR Name[20];
+    } Record;
+    ULONG Position;
+
+    for (Position = 0; Position + sizeof(Record) <= CORPUS_SIZE; Position += sizeof(Record))
+    {
+        ZeroMemory(&Record, sizeof(Record));
+        Record.Id = Position / sizeof(Record);
+        Record.Type = NextRandom() % 4;
+        Record.Flags = (Record.Id & 7) ? 0 : 0x8000;
+        Record.Size = NextRandom() % 65536;
+        sprintf(Record.Name, "file%05lu.dat", Record.Id);
+        memcpy(Buffer + Position, &Record, sizeof(Record));
+    }
+    ZeroMemory(Buffer + Position, CORPUS_SIZE - Position);
+}
+
+static
+VOID
+MakeZeros(PUCHAR Buffer)
+{
+    ZeroMemory(Buffer, CORPUS_SIZE);
+}
+
+static
+VOID
+MakeNoise(PUCHAR Buffer)
+{
+    ULONG Position;
+
+    for (Position = 0; Position < CORPUS_SIZE; Position++)
+        Buffer[Position] = (UCHAR)NextRandom();
+}
+
+static const struct
+{
+    VOID (*Make)(PUCHAR Buffer);
+    PCSTR Name;
+    BOOLEAN Compressible;
+} Corpus[] =
+{
+    { MakeText, "text", TRUE },
+    { MakeRecords, "records", TRUE },
+    { MakeZeros, "zeros", TRUE },
+    { MakeNoise, "noise", FALSE },
+};
+
+static
+double
+ElapsedSeconds(LARGE_INTEGER Start)
+{
+    LARGE_INTEGER Frequency, End;
+
+    QueryPerformanceCounter(&End);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+}
+
+static
+VOID
+TestRoundTrip(const TEST_FORMAT *Format,
+              PCSTR CorpusName,
+              BOOLEAN Compressible,
+              PUCHAR Data,
+              PUCHAR Compressed,
+              PUCHAR Decompressed,
+              PVOID WorkSpace)
+{
+    LARGE_INTEGER Start;
+    double CompressTime, DecompressTime;
+    ULONG CompressedSize, FinalSize, Round;
+    NTSTATUS Status;
+
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < ROUNDS; Round++)
+    {
+        CompressedSize = 0xdeadbeef;
+        Status = RtlCompressBuffer(Format->Format, Data, CORPUS_SIZE, Compressed, COMPRESSED_SIZE,
+                                   4096, &CompressedSize, WorkSpace);
+    }
+    CompressTime = ElapsedSeconds(Start);
+    ok(Status == STATUS_SUCCESS, "%s, %s: RtlCompressBuffer returned 0x%lx\n", Format->Name, CorpusName, Status);
+    if (Status != STATUS_SUCCESS)
+        return;
+
+    if (Compressible)
+        ok(CompressedSize < CORPUS_SIZE / 2, "%s, %s: compressed to %lu\n", Format->Name, CorpusName, CompressedSize);
+    else
+        ok(CompressedSize <= COMPRESSED_SIZE, "%s, %s: compressed to %lu\n", Format->Name, CorpusName, CompressedSize);
+
+    /* A larger buffer must be left alone past the data */
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < ROUNDS; Round++)
+    {
+        FillMemory(Decompressed, CORPUS_SIZE + 1, 0x11);
+        FinalSize = 0xdeadbeef;
+        Status = RtlDecompressBuffer(Format->Format, Decompressed, CORPUS_SIZE + 1,
+                                     Compressed, CompressedSize, &FinalSize);
+    }
+    DecompressTime = ElapsedSeconds(Start);
+    ok(Status == STATUS_SUCCESS, "%s, %s: RtlDecompressBuffer returned 0x%lx\n", Format->Name, CorpusName, Status);
+    ok(FinalSize == CORPUS_SIZE, "%s, %s: decompressed to %lu\n", Format->Name, CorpusName, FinalSize);
+    ok(!memcmp(Decompressed, Data, CORPUS_SIZE), "%s, %s: got wrong decoded data\n", Format->Name, CorpusName);
+    ok(Decompressed[CORPUS_SIZE] == 0x11, "%s, %s: too many bytes written\n", Format->Name, CorpusName);
+
+    if (CompressTime > 0 && DecompressTime > 0)
+    {
+        trace("%-18s %-8s %6lu bytes (%3lu%%), compress %6.1f MB/s, decompress %6.1f MB/s\n",
+              Format->Name, CorpusName, CompressedSize, CompressedSize * 100 / CORPUS_SIZE,
+              ROUNDS * (CORPUS_SIZE / 1048576.0) / CompressTime,
+              ROUNDS * (CORPUS_SIZE / 1048576.0) / DecompressTime);
+    }
+
+    /* Not enough room for the data */
+    Status = RtlCompressBuffer(Format->Format, Data, CORPUS_SIZE, Compressed, CompressedSize / 2,
+                               4096, &FinalSize, WorkSpace);
+    ok(Status == STATUS_BUFFER_TOO_SMALL, "%s, %s: RtlCompressBuffer returned 0x%lx\n", Format->Name, CorpusName, Status);
+}
+
+static
+VOID
+TestFragment(PUCHAR Data, PUCHAR Compressed, PUCHAR Decompressed, PVOID WorkSpace)
+{
+    ULONG CompressedSize, FinalSize, FragmentWorkSpaceSize, BufferWorkSpaceSize;
+    PVOID FragmentWorkSpace;
+    NTSTATUS Status;
+
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &BufferWorkSpaceSize, &FragmentWorkSpaceSize);
+    ok(Status == STATUS_SUCCESS, "RtlGetCompressionWorkSpaceSize returned 0x%lx\n", Status);
+    ok(FragmentWorkSpaceSize == 0x1000, "Got %lu\n", FragmentWorkSpaceSize);
+
+    FragmentWorkSpace = HeapAlloc(GetProcessHeap(), 0, FragmentWorkSpaceSize);
+    if (!FragmentWorkSpace)
+    {
+        skip("No memory\n");
+        return;
+    }
+
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1, Data, CORPUS_SIZE, Compressed, COMPRESSED_SIZE,
+                               4096, &CompressedSize, WorkSpace);
+    ok(Status == STATUS_SUCCESS, "RtlCompressBuffer returned 0x%lx\n", Status);
+
+    /* Starting in the middle of a compressed chunk */
+    FinalSize = 0xdeadbeef;
+    Status = RtlDecompressFragment(COMPRESSION_FORMAT_LZNT1, Decompressed, 0x1000, Compressed, CompressedSize,
+                                   0x1800, &FinalSize, FragmentWorkSpace);
+    ok(Status == STATUS_SUCCESS, "RtlDecompressFragment returned 0x%lx\n", Status);
+    ok(FinalSize == 0x1000, "Got %lu\n", FinalSize);
+    ok(!memcmp(Decompressed, Data + 0x1800, 0x1000), "Got wrong decoded data\n");
+
+    /* The XPRESS formats have no chunks to start from */
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_XPRESS, Data, CORPUS_SIZE, Compressed, COMPRESSED_SIZE,
+                               4096, &CompressedSize, WorkSpace);
+    ok(Status == STATUS_SUCCESS, "RtlCompressBuffer returned 0x%lx\n", Status);
+    Status = RtlDecompressFragment(COMPRESSION_FORMAT_XPRESS, Decompressed, 0x1000, Compressed, CompressedSize,
+                                   0x1800, &FinalSize, FragmentWorkSpace);
+    ok(Status == STATUS_NOT_SUPPORTED, "RtlDecompressFragment returned 0x%lx\n", Status);
+
+    HeapFree(GetProcessHeap(), 0, FragmentWorkSpace);
+}
+
+static
+VOID
+TestEmpty(const TEST_FORMAT *Format, PUCHAR Compressed, PUCHAR Decompressed, PVOID WorkSpace)
+{
+    ULONG CompressedSize, FinalSize;
+    NTSTATUS Status;
+
+    CompressedSize = 0xdeadbeef;
+    Status = RtlCompressBuffer(Format->Format, Decompressed, 0, Compressed, COMPRESSED_SIZE,
+                               4096, &CompressedSize, WorkSpace);
+    ok(Status == STATUS_SUCCESS, "%s: RtlCompressBuffer returned 0x%lx\n", Format->Name, Status);
+    ok(CompressedSize < 512, "%s: compressed to %lu\n", Format->Name, CompressedSize);
+
+    FinalSize = 0xdeadbeef;
+    Status = RtlDecompressBuffer(Format->Format, Decompressed, CORPUS_SIZE,
+                                 Compressed, CompressedSize, &FinalSize);
+    ok(Status == STATUS_SUCCESS || Status == STATUS_BAD_COMPRESSION_BUFFER,
+       "%s: RtlDecompressBuffer returned 0x%lx\n", Format->Name, Status);
+    if (Status == STATUS_SUCCESS)
+        ok(FinalSize == 0, "%s: decompressed to %lu\n", Format->Name, FinalSize);
+}
+
+START_TEST(RtlCompressBuffer)
+{
+    PUCHAR Data, Compressed, Decompressed;
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize, MaxWorkSpaceSize = 0;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+    ULONG i, j;
+
+    for (i = 0; i < ARRAYSIZE(Formats); i++)
+    {
+        WorkSpaceSize = FragmentWorkSpaceSize = 0xdeadbeef;
+        Status = RtlGetCompressionWorkSpaceSize(Formats[i].Format, &WorkSpaceSize, &FragmentWorkSpaceSize);
+        ok(Status == STATUS_SUCCESS, "%s: RtlGetCompressionWorkSpaceSize returned 0x%lx\n", Formats[i].Name, Status);
+        ok(WorkSpaceSize != 0 && WorkSpaceSize != 0xdeadbeef, "%s: got %lu\n", Formats[i].Name, WorkSpaceSize);
+        ok(FragmentWorkSpaceSize != 0xdeadbeef, "%s: got %lu\n", Formats[i].Name, FragmentWorkSpaceSize);
+        if (Status == STATUS_SUCCESS)
+            MaxWorkSpaceSize = max(MaxWorkSpaceSize, WorkSpaceSize);
+    }
+
+    Data = HeapAlloc(GetProcessHeap(), 0, CORPUS_SIZE);
+    Compressed = HeapAlloc(GetProcessHeap(), 0, COMPRESSED_SIZE);
+    Decompressed = HeapAlloc(GetProcessHeap(), 0, CORPUS_SIZE + 1);
+    WorkSpace = HeapAlloc(GetProcessHeap(), 0, MaxWorkSpaceSize);
+    if (!Data || !Compressed || !Decompressed || !WorkSpace)
+    {
+        skip("No memory\n");
+        goto Cleanup;
+    }
+
+    for (j = 0; j < ARRAYSIZE(Corpus); j++)
+    {
+        Seed = 0x1234 + j;
+        Corpus[j].Make(Data);
+
+        for (i = 0; i < ARRAYSIZE(Formats); i++)
+        {
+            TestRoundTrip(&Formats[i], Corpus[j].Name, Corpus[j].Compressible,
+                          Data, Compressed, Decompressed, WorkSpace);
+        }
+    }
+
+    for (i = 0; i < ARRAYSIZE(Formats); i++)
+        TestEmpty(&Formats[i], Compressed, Decompressed, WorkSpace);
+
+    Seed = 0x1234;
+    MakeText(Data);
+    TestFragment(Data, Compressed, Decompressed, WorkSpace);
+
+Cleanup:
+    if (WorkSpace) HeapFree(GetProcessHeap(), 0, WorkSpace);
+    if (Decompressed) HeapFree(GetProcessHeap(), 0, Decompressed);
+    if (Compressed) HeapFree(GetProcessHeap(), 0, Compressed);
+    if (Data) HeapFree(GetProcessHeap(), 0, Data);
+}
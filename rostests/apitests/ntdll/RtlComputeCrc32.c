@@ -0,0 +1,164 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for RtlComputeCrc32
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <ndk/rtlfuncs.h>
+
+#define BUFFER_SIZE     (1024 * 1024)
+
+/* One bit at a time, straight from the definition */
+static
+ULONG
+ReferenceCrc32(ULONG Initial, PUCHAR Data, ULONG Length)
+{
+    ULONG Crc = ~Initial;
+    ULONG i;
+
+    while (Length--)
+    {
+        Crc ^= *Data++;
+        for (i = 0; i < 8; i++)
+            Crc = (Crc >> 1) ^ (0xEDB88320 & (0 - (Crc & 1)));
+    }
+
+    return ~Crc;
+}
+
+static
+VOID
+TestKnownValues(VOID)
+{
+    UCHAR Digits[] = "123456789";
+    UCHAR Zeros[32] = { 0 };
+
+    ok_hex(RtlComputeCrc32(0, Digits, 9), 0xCBF43926);
+    ok_hex(RtlComputeCrc32(0, Digits, 0), 0);
+    ok_hex(RtlComputeCrc32(0x12345678, Digits, 0), 0x12345678);
+    ok_hex(RtlComputeCrc32(0, Zeros, sizeof(Zeros)), 0x190A55AD);
+
+    /* Chaining gives the CRC of the whole */
+    ok_hex(RtlComputeCrc32(RtlComputeCrc32(0, Digits, 4), Digits + 4, 5), 0xCBF43926);
+}
+
+static
+VOID
+TestAllPaths(PUCHAR Buffer)
+{
+    ULONG Offset, Length, Crc, Expected, Split;
+    ULONG Seed = 1;
+
+    for (Length = 0; Length < 4096; Length++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Buffer[Length] = (UCHAR)(Seed >> 16);
+    }
+
+    /* Every alignment with every length around the eight byte blocks,
+       and around the 64 bytes from which the folding path takes over */
+    for (Offset = 0; Offset < 16; Offset++)
+    {
+        for (Length = 0; Length < 300; Length++)
+        {
+            Crc = RtlComputeCrc32(Offset * 0x01010101, Buffer + Offset, Length);
+            Expected = ReferenceCrc32(Offset * 0x01010101, Buffer + Offset, Length);
+            ok(Crc == Expected, "Offset %lu, length %lu: 0x%08lx instead of 0x%08lx\n",
+               Offset, Length, Crc, Expected);
+        }
+    }
+
+    /* Splitting a buffer anywhere doesn't change the result */
+    Expected = ReferenceCrc32(0, Buffer + 3, 4000);
+    for (Split = 0; Split <= 4000; Split += 37)
+    {
+        Crc = RtlComputeCrc32(0, Buffer + 3, Split);
+        Crc = RtlComputeCrc32(Crc, Buffer + 3 + Split, 4000 - Split);
+        ok(Crc == Expected, "Split at %lu: 0x%08lx instead of 0x%08lx\n", Split, Crc, Expected);
+    }
+}
+
+static
+VOID
+TestRandom(PUCHAR Buffer)
+{
+    ULONG Offset, Length, Initial, Crc, Expected, i;
+    ULONG Seed = 0x1234;
+    int CpuInfo[4];
+
+    __cpuid(CpuInfo, 1);
+    trace("PCLMULQDQ is %savailable\n", (CpuInfo[2] & 0x2) ? "" : "not ");
+
+    for (i = 0; i < 16384 + 32; i++)
+        Buffer[i] = (UCHAR)RtlRandom(&Seed);
+
+    /* Random buffers, short ones go through the tables only, long ones
+       are folded with the tables for the head and the tail */
+    for (i = 0; i < 2000; i++)
+    {
+        Offset = RtlRandom(&Seed) % 32;
+        Length = (i & 1) ? RtlRandom(&Seed) % 256 : RtlRandom(&Seed) % 16384;
+        Initial = RtlRandom(&Seed);
+        Crc = RtlComputeCrc32(Initial, Buffer + Offset, Length);
+        Expected = ReferenceCrc32(Initial, Buffer + Offset, Length);
+        ok(Crc == Expected, "Offset %lu, length %lu: 0x%08lx instead of 0x%08lx\n",
+           Offset, Length, Crc, Expected);
+    }
+}
+
+static
+VOID
+TestPerformance(PUCHAR Buffer)
+{
+    static const ULONG Sizes[] = { 64, 512, 4096, 65536, BUFFER_SIZE };
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i, Rounds, Round;
+    double Seconds;
+
+    for (i = 0; i < BUFFER_SIZE; i++)
+        Buffer[i] = (UCHAR)(i * 7);
+
+    QueryPerformanceFrequency(&Frequency);
+    for (i = 0; i < ARRAYSIZE(Sizes); i++)
+    {
+        /* Hash 64 MB in total for every size */
+        Rounds = 64 * 1024 * 1024 / Sizes[i];
+
+        QueryPerformanceCounter(&Start);
+        for (Round = 0; Round < Rounds; Round++)
+        {
+            RtlComputeCrc32(Round, Buffer + (Round & 7), Sizes[i] - 8);
+        }
+        QueryPerformanceCounter(&End);
+
+        Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+        if (Seconds > 0)
+        {
+            trace("%lu bytes: %.2f GB/s\n", Sizes[i],
+                  (double)Rounds * (Sizes[i] - 8) / Seconds / 1e9);
+        }
+    }
+}
+
+START_TEST(RtlComputeCrc32)
+{
+    PUCHAR Buffer;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, BUFFER_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        return;
+    }
+
+    TestKnownValues();
+    TestAllPaths(Buffer);
+    TestRandom(Buffer);
+    TestPerformance(Buffer);
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+}
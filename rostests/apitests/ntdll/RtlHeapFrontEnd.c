@@ -0,0 +1,200 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Stress test and benchmark for the low fragmentation heap front end
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <ndk/rtlfuncs.h>
+
+#define MAX_THREADS         8
+#define BLOCKS_PER_THREAD   256
+#define ROUNDS_PER_THREAD   200
+
+typedef struct _HEAP_STRESS_CONTEXT
+{
+    HANDLE Heap;
+    ULONG Seed;
+    ULONG Operations;
+    ULONG Corruptions;
+    ULONG Failures;
+} HEAP_STRESS_CONTEXT, *PHEAP_STRESS_CONTEXT;
+
+static
+DWORD
+WINAPI
+HeapStressThread(LPVOID Parameter)
+{
+    PHEAP_STRESS_CONTEXT Context = Parameter;
+    PUCHAR Blocks[BLOCKS_PER_THREAD];
+    SIZE_T Sizes[BLOCKS_PER_THREAD];
+    ULONG Round, i;
+    SIZE_T j;
+
+    RtlZeroMemory(Blocks, sizeof(Blocks));
+
+    for (Round = 0; Round < ROUNDS_PER_THREAD; Round++)
+    {
+        for (i = 0; i < BLOCKS_PER_THREAD; i++)
+        {
+            /* Check and release what was left in this slot by the previous round */
+            if (Blocks[i])
+            {
+                for (j = 0; j < Sizes[i]; j++)
+                {
+                    if (Blocks[i][j] != (UCHAR)(i + Sizes[i]))
+                    {
+                        Context->Corruptions++;
+                        break;
+                    }
+                }
+
+                RtlFreeHeap(Context->Heap, 0, Blocks[i]);
+                Blocks[i] = NULL;
+                Context->Operations++;
+            }
+
+            /* Mostly small sizes, with a few larger ones mixed in */
+            Sizes[i] = (RtlRandom(&Context->Seed) % 8) ? (RtlRandom(&Context->Seed) % 256) + 1
+                                                       : (RtlRandom(&Context->Seed) % 4096) + 1;
+
+            Blocks[i] = RtlAllocateHeap(Context->Heap, 0, Sizes[i]);
+            Context->Operations++;
+            if (!Blocks[i])
+            {
+                Context->Failures++;
+                continue;
+            }
+
+            RtlFillMemory(Blocks[i], Sizes[i], (UCHAR)(i + Sizes[i]));
+        }
+    }
+
+    for (i = 0; i < BLOCKS_PER_THREAD; i++)
+    {
+        if (Blocks[i]) RtlFreeHeap(Context->Heap, 0, Blocks[i]);
+    }
+
+    return 0;
+}
+
+static
+VOID
+RunHeapStress(HANDLE Heap, ULONG ThreadCount, PCSTR Description)
+{
+    HEAP_STRESS_CONTEXT Contexts[MAX_THREADS];
+    HANDLE Threads[MAX_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Operations = 0, Corruptions = 0, Failures = 0;
+    ULONG i;
+    double Seconds;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        Contexts[i].Heap = Heap;
+        Contexts[i].Seed = 0x1234 + i;
+        Contexts[i].Operations = 0;
+        Contexts[i].Corruptions = 0;
+        Contexts[i].Failures = 0;
+    }
+
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        Threads[i] = CreateThread(NULL, 0, HeapStressThread, &Contexts[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Threads[i]) ThreadCount = i;
+    }
+
+    WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+
+    QueryPerformanceCounter(&End);
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        CloseHandle(Threads[i]);
+        Operations += Contexts[i].Operations;
+        Corruptions += Contexts[i].Corruptions;
+        Failures += Contexts[i].Failures;
+    }
+
+    ok(Corruptions == 0, "%s, %lu threads: %lu corrupted blocks\n", Description, ThreadCount, Corruptions);
+    ok(Failures == 0, "%s, %lu threads: %lu failed allocations\n", Description, ThreadCount, Failures);
+    ok(RtlValidateHeap(Heap, 0, NULL), "%s, %lu threads: heap is corrupted\n", Description, ThreadCount);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("%s, %lu threads: %lu operations in %.3f s, %.0f operations/s\n",
+              Description, ThreadCount, Operations, Seconds, Operations / Seconds);
+    }
+}
+
+START_TEST(RtlHeapFrontEnd)
+{
+    RTL_HEAP_PARAMETERS Parameters = {0};
+    HANDLE BackEndHeap, FrontEndHeap;
+    ULONG HeapType, ThreadCount;
+    SIZE_T ReturnLength;
+    PVOID Block, Block2, Block3;
+    NTSTATUS Status;
+
+    Parameters.Length = sizeof(Parameters);
+
+    BackEndHeap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, &Parameters);
+    FrontEndHeap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, &Parameters);
+    ok(BackEndHeap != NULL && FrontEndHeap != NULL, "RtlCreateHeap failed\n");
+    if (!BackEndHeap || !FrontEndHeap)
+    {
+        skip("No heaps\n");
+        return;
+    }
+
+    /* Switch the second heap to the low fragmentation front end */
+    HeapType = 2;
+    Status = RtlSetHeapInformation(FrontEndHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType));
+    ok(Status == STATUS_SUCCESS, "RtlSetHeapInformation failed with 0x%08lx\n", Status);
+
+    HeapType = 0;
+    Status = RtlQueryHeapInformation(FrontEndHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType), &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "RtlQueryHeapInformation failed with 0x%08lx\n", Status);
+    ok(HeapType == 2, "Expected the LFH front end, got %lu\n", HeapType);
+
+    /* Asking twice is fine, any other value isn't */
+    HeapType = 2;
+    Status = RtlSetHeapInformation(FrontEndHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType));
+    ok(Status == STATUS_SUCCESS, "RtlSetHeapInformation failed with 0x%08lx\n", Status);
+    HeapType = 1;
+    Status = RtlSetHeapInformation(FrontEndHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType));
+    ok(Status == STATUS_UNSUCCESSFUL, "Expected STATUS_UNSUCCESSFUL, got 0x%08lx\n", Status);
+
+    /* A block the front end holds must not be taken back a second time */
+    Block = RtlAllocateHeap(FrontEndHeap, 0, 32);
+    ok(Block != NULL, "RtlAllocateHeap failed\n");
+    if (Block)
+    {
+        ok(RtlFreeHeap(FrontEndHeap, 0, Block) != FALSE, "RtlFreeHeap failed\n");
+        ok(RtlFreeHeap(FrontEndHeap, 0, Block) == FALSE, "Double free succeeded\n");
+        Block2 = RtlAllocateHeap(FrontEndHeap, 0, 32);
+        Block3 = RtlAllocateHeap(FrontEndHeap, 0, 32);
+        ok(Block2 != Block3, "Got the same block twice\n");
+        RtlFreeHeap(FrontEndHeap, 0, Block3);
+        RtlFreeHeap(FrontEndHeap, 0, Block2);
+    }
+
+    /* Compare both heaps from 1 to MAX_THREADS threads */
+    for (ThreadCount = 1; ThreadCount <= MAX_THREADS; ThreadCount *= 2)
+    {
+        RunHeapStress(BackEndHeap, ThreadCount, "Back end");
+        RunHeapStress(FrontEndHeap, ThreadCount, "LFH front end");
+    }
+
+    RtlDestroyHeap(FrontEndHeap);
+    RtlDestroyHeap(BackEndHeap);
+}
@@ -319,6 +319,49 @@ Test_KernelDebugger(void)
     ok(Status == STATUS_INVALID_INFO_CLASS, "NtSetSystemInformation returned %lx\n", Status);
 }
 
+static
+void
+Test_MemoryList(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength;
+    SYSTEM_BASIC_INFORMATION BasicInfo;
+    SYSTEM_MEMORY_LIST_INFORMATION MemoryList;
+    SIZE_T Standby;
+    ULONG i;
+
+    Status = NtQuerySystemInformation(SystemBasicInformation, &BasicInfo, sizeof(BasicInfo), NULL);
+    ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+
+    /* Query */
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemMemoryListInformation, &MemoryList, sizeof(MemoryList) - 1, &ReturnLength);
+    ok(Status == STATUS_INFO_LENGTH_MISMATCH, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength == sizeof(MemoryList), "ReturnLength = %lu\n", ReturnLength);
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemMemoryListInformation, &MemoryList, sizeof(MemoryList), &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "NtQuerySystemInformation returned %lx\n", Status);
+    ok(ReturnLength == sizeof(MemoryList), "ReturnLength = %lu\n", ReturnLength);
+    if (Status != STATUS_SUCCESS)
+        return;
+
+    /* None of the lists can hold more pages than the machine has */
+    Standby = 0;
+    for (i = 0; i < RTL_NUMBER_OF(MemoryList.PageCountByPriority); i++)
+        Standby += MemoryList.PageCountByPriority[i];
+    ok(MemoryList.ZeroPageCount + MemoryList.FreePageCount + Standby <= BasicInfo.NumberOfPhysicalPages,
+       "Zeroed %Iu, free %Iu, standby %Iu, physical %lu\n",
+       MemoryList.ZeroPageCount, MemoryList.FreePageCount, Standby, BasicInfo.NumberOfPhysicalPages);
+    trace("Zeroed %Iu, free %Iu, modified %Iu, standby %Iu pages\n",
+          MemoryList.ZeroPageCount, MemoryList.FreePageCount, MemoryList.ModifiedPageCount, Standby);
+
+    /* Set - not supported */
+    Status = NtSetSystemInformation(SystemMemoryListInformation, &MemoryList, sizeof(MemoryList));
+    ok(Status == STATUS_INVALID_INFO_CLASS ||
+       Status == STATUS_PRIVILEGE_NOT_HELD, "NtSetSystemInformation returned %lx\n", Status);
+}
+
 START_TEST(NtSystemInformation)
 {
     NTSTATUS Status;
@@ -360,4 +403,5 @@ START_TEST(NtSystemInformation)
     Test_Flags();
     Test_TimeAdjustment();
     Test_KernelDebugger();
+    Test_MemoryList();
 }
@@ -15,6 +15,7 @@ typedef struct _TEST_FCB
     FSRTL_ADVANCED_FCB_HEADER Header;
     SECTION_OBJECT_POINTERS SectionObjectPointers;
     FAST_MUTEX HeaderMutex;
+    BOOLEAN HugeFile;
 } TEST_FCB, *PTEST_FCB;
 
 static PFILE_OBJECT TestFileObject;
@@ -195,6 +196,15 @@ TestIrpHandler(
             Fcb->Header.FileSize.QuadPart = 1004;
             Fcb->Header.ValidDataLength.QuadPart = 1004;
         }
+        else if (IoStack->FileObject->FileName.Length >= 2 * sizeof(WCHAR) &&
+                 IoStack->FileObject->FileName.Buffer[1] == 'H')
+        {
+            /* 4GB, each page being filled with its page number */
+            Fcb->Header.AllocationSize.QuadPart = 0x100000000LL;
+            Fcb->Header.FileSize.QuadPart = 0x100000000LL;
+            Fcb->Header.ValidDataLength.QuadPart = 0x100000000LL;
+            Fcb->HugeFile = TRUE;
+        }
         else if (IoStack->FileObject->FileName.Length >= 2 * sizeof(WCHAR) &&
                  IoStack->FileObject->FileName.Buffer[1] == 'R')
         {
@@ -255,7 +265,11 @@ TestIrpHandler(
 
             Status = Irp->IoStatus.Status;
 
-            if (NT_SUCCESS(Status))
+            if (NT_SUCCESS(Status) && Fcb->HugeFile)
+            {
+                ok_eq_ulong(*(PULONG)Buffer, (ULONG)(Offset.QuadPart / PAGE_SIZE));
+            }
+            else if (NT_SUCCESS(Status))
             {
                 if (Offset.QuadPart <= 1000LL && Offset.QuadPart + Length > 1000LL)
                 {
@@ -275,10 +289,23 @@ TestIrpHandler(
             ok(Irp->AssociatedIrp.SystemBuffer == NULL, "A SystemBuffer was allocated!\n");
             Buffer = MapAndLockUserBuffer(Irp, Length);
             ok(Buffer != NULL, "Null pointer!\n");
-            RtlFillMemory(Buffer, Length, 0xBA);
 
             Status = STATUS_SUCCESS;
-            if (Offset.QuadPart <= 1000LL && Offset.QuadPart + Length > 1000LL)
+            if (Fcb->HugeFile)
+            {
+                ULONG i;
+
+                for (i = 0; i < Length / sizeof(ULONG); i++)
+                {
+                    ((PULONG)Buffer)[i] = (ULONG)((Offset.QuadPart + i * sizeof(ULONG)) / PAGE_SIZE);
+                }
+            }
+            else
+            {
+                RtlFillMemory(Buffer, Length, 0xBA);
+            }
+
+            if (!Fcb->HugeFile && Offset.QuadPart <= 1000LL && Offset.QuadPart + Length > 1000LL)
             {
                 *(PUSHORT)((ULONG_PTR)Buffer + (ULONG_PTR)(1000LL - Offset.QuadPart)) = 0xFFFF;
             }
@@ -7,6 +7,84 @@
 
 #include <kmt_test.h>
 
+#define HUGE_FILE_VIEWS     (0x100000000LL / 0x40000)
+#define HUGE_WORKING_SET    256
+#define HUGE_WARM_READS     4096
+#define HUGE_READ_LENGTH    64
+
+static
+LONGLONG
+RandomOffsetInView(
+    _In_ ULONG View,
+    _Inout_ PULONG Seed)
+{
+    /* A ULONG aligned offset inside a random page of the view, never page aligned */
+    return View * 0x40000LL +
+           (RtlRandom(Seed) % (0x40000 / PAGE_SIZE)) * PAGE_SIZE +
+           (1 + RtlRandom(Seed) % (PAGE_SIZE / sizeof(ULONG) - HUGE_READ_LENGTH / sizeof(ULONG))) * sizeof(ULONG);
+}
+
+static
+VOID
+TestHugeFileThroughput(
+    _In_ HANDLE Handle)
+{
+    NTSTATUS Status;
+    LARGE_INTEGER ByteOffset;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Views[HUGE_WORKING_SET];
+    ULONG Buffer[HUGE_READ_LENGTH / sizeof(ULONG)];
+    ULONG Seed = 0x5EED;
+    ULONG Errors, i;
+    double Seconds;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    /* Cold pass: every read needs a new view, all over the file */
+    Errors = 0;
+    for (i = 0; i < HUGE_WORKING_SET; i++)
+    {
+        Views[i] = RtlRandom(&Seed) % HUGE_FILE_VIEWS;
+        ByteOffset.QuadPart = RandomOffsetInView(Views[i], &Seed);
+        Status = NtReadFile(Handle, NULL, NULL, NULL, &IoStatusBlock, Buffer, sizeof(Buffer), &ByteOffset, NULL);
+        if (!NT_SUCCESS(Status) || Buffer[0] != (ULONG)(ByteOffset.QuadPart / PAGE_SIZE))
+            Errors++;
+    }
+
+    QueryPerformanceCounter(&End);
+    ok_eq_ulong(Errors, 0LU);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("Cold random reads: %lu reads in %.3f s, %.0f reads/s\n",
+              HUGE_WORKING_SET, Seconds, HUGE_WORKING_SET / Seconds);
+    }
+
+    QueryPerformanceCounter(&Start);
+
+    /* Warm pass: the views are already there, this is all about finding them */
+    Errors = 0;
+    for (i = 0; i < HUGE_WARM_READS; i++)
+    {
+        ByteOffset.QuadPart = RandomOffsetInView(Views[RtlRandom(&Seed) % HUGE_WORKING_SET], &Seed);
+        Status = NtReadFile(Handle, NULL, NULL, NULL, &IoStatusBlock, Buffer, sizeof(Buffer), &ByteOffset, NULL);
+        if (!NT_SUCCESS(Status) || Buffer[0] != (ULONG)(ByteOffset.QuadPart / PAGE_SIZE))
+            Errors++;
+    }
+
+    QueryPerformanceCounter(&End);
+    ok_eq_ulong(Errors, 0LU);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+    if (Seconds > 0)
+    {
+        trace("Warm random reads: %lu reads in %.3f s, %.0f reads/s, %.2f MB/s\n",
+              HUGE_WARM_READS, Seconds, HUGE_WARM_READS / Seconds,
+              (HUGE_WARM_READS * (double)HUGE_READ_LENGTH) / (Seconds * 1024 * 1024));
+    }
+}
+
 START_TEST(CcCopyRead)
 {
     HANDLE Handle;
@@ -18,6 +96,7 @@ START_TEST(CcCopyRead)
     UNICODE_STRING BigAlignmentTest = RTL_CONSTANT_STRING(L"\\Device\\Kmtest-CcCopyRead\\BigAlignmentTest");
     UNICODE_STRING SmallAlignmentTest = RTL_CONSTANT_STRING(L"\\Device\\Kmtest-CcCopyRead\\SmallAlignmentTest");
     UNICODE_STRING ReallySmallAlignmentTest = RTL_CONSTANT_STRING(L"\\Device\\Kmtest-CcCopyRead\\ReallySmallAlignmentTest");
+    UNICODE_STRING HugeRandomReadTest = RTL_CONSTANT_STRING(L"\\Device\\Kmtest-CcCopyRead\\HugeRandomReadTest");
     
     KmtLoadDriver(L"CcCopyRead", FALSE);
     KmtOpenDriver();
@@ -89,6 +168,15 @@ START_TEST(CcCopyRead)
 
     NtClose(Handle);
 
+    InitializeObjectAttributes(&ObjectAttributes, &HugeRandomReadTest, OBJ_CASE_INSENSITIVE, NULL, NULL);
+    Status = NtOpenFile(&Handle, FILE_ALL_ACCESS, &ObjectAttributes, &IoStatusBlock, 0, FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+    {
+        TestHugeFileThroughput(Handle);
+        NtClose(Handle);
+    }
+
     RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
     KmtCloseDriver();
     KmtUnloadDriver();
@@ -102,6 +102,21 @@ static VOID FsRtlLargeMcbTest()
 
     ok(FsRtlLookupLargeMcbEntry(&LargeMcb, 3073, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, &Index) == FALSE, "expected FALSE, got TRUE\n");
 
+    /* Same lookups without the index */
+    ok(FsRtlLookupLargeMcbEntry(&LargeMcb, 2560, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, NULL) == TRUE, "expected TRUE, got FALSE\n");
+    ok(Lbn == 514, "Expected Lbn 514, got: %I64d\n", Lbn);
+    ok(SectorCount == 512, "Expected SectorCount 512, got: %I64d\n", SectorCount);
+    ok(StartingLbn == 2, "Expected StartingLbn 2, got: %I64d\n", StartingLbn);
+    ok(CountFromStartingLbn == 1024, "Expected CountFromStartingLbn 1024, got: %I64d\n", CountFromStartingLbn);
+
+    ok(FsRtlLookupLargeMcbEntry(&LargeMcb, 1536, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, NULL) == TRUE, "expected TRUE, got FALSE\n");
+    ok(Lbn == -1, "Expected Lbn -1, got: %I64d\n", Lbn);
+    ok(SectorCount == 512, "Expected SectorCount 512, got: %I64d\n", SectorCount);
+    ok(StartingLbn == -1, "Expected StartingLbn -1, got: %I64d\n", StartingLbn);
+    ok(CountFromStartingLbn == 1023, "Expected CountFromStartingLbn 1023, got: %I64d\n", CountFromStartingLbn);
+
+    ok(FsRtlLookupLargeMcbEntry(&LargeMcb, 3072, &Lbn, NULL, NULL, NULL, NULL) == FALSE, "expected FALSE, got TRUE\n");
+
     FsRtlRemoveLargeMcbEntry(&LargeMcb, 1, 1024);
     NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
     ok(NbRuns == 2, "Expected 2 runs, got: %lu\n", NbRuns);
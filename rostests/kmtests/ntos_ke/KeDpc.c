@@ -60,6 +60,72 @@ DpcHandler(
     ok_eq_pointer(Prcb->DpcData[DPC_NORMAL].DpcListHead.Blink, Dpc->DpcListEntry.Blink);
 }
 
+static KDPC ThreadedDpc;
+static KEVENT ThreadedDpcEvent;
+static volatile KIRQL ThreadedDpcIrql;
+
+static KDEFERRED_ROUTINE ThreadedDpcHandler;
+
+static
+VOID
+NTAPI
+ThreadedDpcHandler(
+    IN PRKDPC Dpc,
+    IN PVOID DeferredContext,
+    IN PVOID SystemArgument1,
+    IN PVOID SystemArgument2)
+{
+    ThreadedDpcIrql = KeGetCurrentIrql();
+    ok_eq_uint(Dpc->Type, ThreadedDpcObject);
+    ok_eq_pointer(SystemArgument1, (PVOID)0xabc123);
+    ok_eq_pointer(Dpc->DpcData, NULL);
+    KeSetEvent(&ThreadedDpcEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+VOID
+TestThreadedDpc(VOID)
+{
+    PKDPC Dpc = &ThreadedDpc;
+    PKPRCB Prcb;
+    BOOLEAN ThreadDpcEnable;
+    ULONG DpcCount;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+    KIRQL Irql;
+    BOOLEAN Ret;
+
+    KeInitializeEvent(&ThreadedDpcEvent, NotificationEvent, FALSE);
+    KeInitializeThreadedDpc(Dpc, ThreadedDpcHandler, NULL);
+    ok_eq_uint(Dpc->Type, ThreadedDpcObject);
+    ok_eq_pointer(Dpc->DpcData, NULL);
+
+    /* Queue it from DISPATCH_LEVEL, so that we stay on the same CPU */
+    ThreadedDpcIrql = HIGH_LEVEL;
+    KeRaiseIrql(DISPATCH_LEVEL, &Irql);
+      Prcb = KeGetCurrentPrcb();
+      ThreadDpcEnable = Prcb->ThreadDpcEnable;
+      DpcCount = Prcb->DpcData[ThreadDpcEnable ? DPC_THREADED : DPC_NORMAL].DpcCount;
+      Ret = KeInsertQueueDpc(Dpc, (PVOID)0xabc123, NULL);
+      ok_bool_true(Ret, "KeInsertQueueDpc returned");
+      ok_eq_ulong(Prcb->DpcData[ThreadDpcEnable ? DPC_THREADED : DPC_NORMAL].DpcCount, DpcCount + 1);
+    KeLowerIrql(Irql);
+
+    Timeout.QuadPart = -5 * 1000 * 1000 * 10LL;
+    Status = KeWaitForSingleObject(&ThreadedDpcEvent, Executive, KernelMode, FALSE, &Timeout);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    /* Don't leave with the DPC still queued if the wait timed out */
+    KeFlushQueuedDpcs();
+
+    /* With threaded DPCs enabled the routine runs in the DPC thread */
+    if (ThreadDpcEnable)
+        ok_eq_uint(ThreadedDpcIrql, PASSIVE_LEVEL);
+    else
+        ok_eq_uint(ThreadedDpcIrql, DISPATCH_LEVEL);
+    trace("Threaded DPCs are %s\n", ThreadDpcEnable ? "enabled" : "disabled");
+}
+
 START_TEST(KeDpc)
 {
     NTSTATUS Status = STATUS_SUCCESS;
@@ -175,6 +241,8 @@ START_TEST(KeDpc)
     Ret = KeInsertQueueDpc(NULL, NULL, NULL);
     Ret = KeRemoveQueueDpc(NULL);*/
 
+    TestThreadedDpc();
+
     ok_dpccount();
     ok_irql(PASSIVE_LEVEL);
     trace("Final Dpc count: %ld, expected %ld\n", DpcCount, ExpectedDpcCount);